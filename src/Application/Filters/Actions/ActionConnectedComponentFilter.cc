@@ -26,17 +26,18 @@
  DEALINGS IN THE SOFTWARE.
  */
 
-// ITK includes
-#include <itkConnectedComponentImageFilter.h>
+// Boost includes
+#include <boost/bind.hpp>
 
-#include <Core/DataBlock/StdDataBlock.h>
-#include <Core/DataBlock/ITKDataBlock.h>
+// Core includes
+#include <Core/Math/MathFunctions.h>
 #include <Core/DataBlock/MaskDataBlockManager.h>
+#include <Core/DataBlock/MaskDataBlockOperations.h>
 
 // Application includes
 #include <Application/Layer/LayerManager.h>
 #include <Application/StatusBar/StatusBar.h>
-#include <Application/Filters/ITKFilter.h>
+#include <Application/Filters/LayerFilter.h>
 #include <Application/Filters/Actions/ActionConnectedComponentFilter.h>
 
 // REGISTER ACTION:
@@ -97,7 +98,7 @@ bool ActionConnectedComponentFilter::validate( Core::ActionContextHandle& contex
 // NOTE: The separation of the algorithm into a private class is for the purpose of running the
 // filter on a separate thread.
 
-class ConnectedComponentFilterAlgo : public ITKFilter
+class ConnectedComponentFilterAlgo : public LayerFilter
 {
 
 public:
@@ -109,279 +110,60 @@ public:
   bool invert_mask_;
   
 public:
-  // NOTE: The macro needs a data type to select which version to run. This needs to be
-  // a member variable of the algorithm class.
-  SCI_BEGIN_ITK_RUN()
-  {
-    // Define the type of filter that we use.
-    typedef itk::ConnectedComponentImageFilter< 
-      UCHAR_IMAGE_TYPE, USHORT_IMAGE_TYPE > filter_type;
-
-    // Retrieve the image as an itk image from the underlying data structure
-    // NOTE: This only does wrapping and does not regenerate the data.
-    Core::ITKImageDataT<unsigned char>::Handle input_image; 
-    this->get_itk_image_from_layer<unsigned char>( this->src_layer_, input_image );
-        
-    // Create a new ITK filter instantiation. 
-    filter_type::Pointer filter = filter_type::New();
-
-    // Relay abort and progress information to the layer that is executing the filter.
-    this->forward_abort_to_filter( filter, this->dst_layer_ );
-    this->observe_itk_progress( filter, this->dst_layer_, 0.0, 0.75 );
-    
-    // Setup the filter parameters that we do not want to change.
-    filter->SetInput( input_image->get_image() );
-
-    // Ensure we will have some threads left for doing something else
-    this->limit_number_of_itk_threads( filter );
-
-    // Run the actual ITK filter.
-    // This needs to be in a try/catch statement as certain filters throw exceptions when they
-    // are aborted. In that case we will relay a message to the status bar for information.
-
-    bool need_32bits = false;
-    try 
-    { 
-      filter->Update(); 
-    } 
-    catch ( ... ) 
-    {
-      if ( this->check_abort() )
-      {
-        this->report_error( "Filter was aborted." );
-        return;
-      }
-      if (  filter->GetObjectCount() > static_cast<unsigned long int>(
-        itk::NumericTraits<unsigned short>::max() ) )
-      {
-        need_32bits = true;
-      }
-      else
-      {
-        this->report_error( "ITK filter failed to complete." );
-        return;
-      }
-    }
-
-    // As ITK filters generate an inconsistent abort behavior, we record our own abort flag
-    // This one is set when the abort button is pressed and an abort is sent to ITK.
-    if ( this->check_abort() ) return;
-
-    Core::DataBlockHandle output_datablock;
+  // RUN:
+  // Implementation of run of the Runnable base class, this function is called when the thread
+  // is launched.
 
-    if ( need_32bits )
-    {
-      filter = 0;
-    
-      // Define the type of filter that we use.
-      typedef itk::ConnectedComponentImageFilter< 
-        UCHAR_IMAGE_TYPE, UINT_IMAGE_TYPE > filter32_type;
-
-      // Retrieve the image as an itk image from the underlying data structure
-      // NOTE: This only does wrapping and does not regenerate the data.
-      Core::ITKImageDataT<unsigned char>::Handle input_image; 
-      this->get_itk_image_from_layer<unsigned char>( this->src_layer_, input_image );
-          
-      // Create a new ITK filter instantiation. 
-      filter32_type::Pointer filter32 = filter32_type::New();
-
-      // Relay abort and progress information to the layer that is executing the filter.
-      this->forward_abort_to_filter( filter32, this->dst_layer_ );
-      this->observe_itk_progress( filter32, this->dst_layer_, 0.0, 0.75 );
-      
-      // Setup the filter parameters that we do not want to change.
-      filter32->SetInput( input_image->get_image() );
-
-      // Ensure we will have some threads left for doing something else
-      this->limit_number_of_itk_threads( filter32 );
-
-      // Run the actual ITK filter.
-      // This needs to be in a try/catch statement as certain filters throw exceptions when they
-      // are aborted. In that case we will relay a message to the status bar for information.     
-      
-      try 
-      { 
-        filter32->Update(); 
-      } 
-      catch ( ... ) 
-      {
-        if ( this->check_abort() )
-        {
-          this->report_error( "Filter was aborted." );
-          return;
-        }
-        this->report_error( "ITK filter failed to complete." );
-        return;
-      }
-    
-      // As ITK filters generate an inconsistent abort behavior, we record our own abort flag
-      // This one is set when the abort button is pressed and an abort is sent to ITK.
-      if ( this->check_abort() ) return;
-
-      output_datablock = Core::ITKDataBlock::New( filter32->GetOutput() );
-
-      if ( ! output_datablock )
-      {
-        this->report_error("Could not allocate enough memory.");
-        return;
-      }
-      
-      unsigned int max_label = filter32->GetObjectCount();
-      std::vector<unsigned int> lut( max_label + 1, 0 );
-      
-      Core::GridTransform grid = input_image->get_grid_transform();
-      Core::Transform trans = grid.get_inverse();
-      int nx = static_cast<int>( grid.get_nx() ); 
-      int ny = static_cast<int>( grid.get_ny() ); 
-      int nz = static_cast<int>( grid.get_nz() ); 
-      
-      unsigned int* data = reinterpret_cast<unsigned int*>( output_datablock->get_data() );
-      for ( size_t i = 0; i < this->seeds_.size(); ++i )
-      {   
-        Core::Point location = trans * seeds_[ i ];
-        int x = static_cast<int>( Core::Round( location.x() ) );
-        int y = static_cast<int>( Core::Round( location.y() ) );
-        int z = static_cast<int>( Core::Round( location.z() ) );
-        
-        if ( x >= 0 && y >= 0 && z >= 0 && x < nx && y < ny && z < nz )
-        {
-          unsigned int val = data[ output_datablock->to_index( static_cast<size_t>( x ), 
-            static_cast<size_t>( y ), static_cast<size_t>( z ) ) ];
-          if ( val ) lut[ val ] = 1;
-        }
-      }
+  SCI_BEGIN_RUN( )
+  {
+    MaskLayerHandle input_mask = boost::dynamic_pointer_cast<MaskLayer>( this->src_layer_ );
+    Core::MaskDataBlockHandle input_mask_block = input_mask->get_mask_volume()->
+      get_mask_data_block();
+
+    // Convert the seed points into voxel indices
+    Core::GridTransform grid = this->src_layer_->get_grid_transform();
+    Core::Transform trans = grid.get_inverse();
+    int nx = static_cast<int>( grid.get_nx() ); 
+    int ny = static_cast<int>( grid.get_ny() ); 
+    int nz = static_cast<int>( grid.get_nz() ); 
+
+    Core::MaskDataBlockOperations::seed_list_type seeds;
+    for ( size_t i = 0; i < this->seeds_.size(); ++i )
+    {   
+      Core::Point location = trans * this->seeds_[ i ];
+      int x = static_cast<int>( Core::Round( location.x() ) );
+      int y = static_cast<int>( Core::Round( location.y() ) );
+      int z = static_cast<int>( Core::Round( location.z() ) );
       
-      if ( this->mask_layer_ )
-      {
-        Core::MaskDataBlockHandle mask_handle = 
-          dynamic_cast<MaskLayer*>( this->mask_layer_.get() )->
-          get_mask_volume()->get_mask_data_block();
-          
-        unsigned char mask_value = mask_handle->get_mask_value();
-        size_t size = mask_handle->get_size();
-        unsigned char* mask_data = mask_handle->get_mask_data();
-        
-        Core::DataBlock::shared_lock_type lock( mask_handle->get_mutex() );
-        if ( this->invert_mask_ )
-        {
-          for ( size_t j = 0; j < size; j++ )
-          {
-            if ( ! ( mask_data[ j ] & mask_value ) && data[ j ] ) lut[ data[ j ] ] = 1;
-          }     
-        }
-        else
-        {
-          for ( size_t j = 0; j < size; j++ )
-          {
-            if ( ( mask_data[ j ] & mask_value ) && data[ j ] ) lut[ data[ j ] ] = 1;
-          }           
-        
-        }
-      }
-
-      this->dst_layer_->update_progress_signal_( 0.80 );
-      if ( this->check_abort() )
+      if ( x >= 0 && y >= 0 && z >= 0 && x < nx && y < ny && z < nz )
       {
-        return;
-      }
-
-      size_t size = output_datablock->get_size();
-      for ( size_t j = 0; j < size; j++ )
-      {
-        data[ j ] = lut[ data[ j ] ];
+        seeds.push_back( static_cast<Core::MaskDataBlock::index_type>( 
+          input_mask_block->to_index( static_cast<size_t>( x ), 
+          static_cast<size_t>( y ), static_cast<size_t>( z ) ) ) );
       }
     }
-    else
-    {
-      // As ITK filters generate an inconsistent abort behavior, we record our own abort flag
-      // This one is set when the abort button is pressed and an abort is sent to ITK.
-      if ( this->check_abort() ) return;
 
-      output_datablock = Core::ITKDataBlock::New( filter->GetOutput() );    
-    
-      if ( ! output_datablock )
-      {
-        this->report_error("Could not allocate enough memory.");
-        return;
-      }
-      
-      unsigned int max_label = filter->GetObjectCount();
-      std::vector<unsigned short> lut( max_label + 1, 0 );
-      
-      Core::GridTransform grid = input_image->get_grid_transform();
-      Core::Transform trans = grid.get_inverse();
-      int nx = static_cast<int>( grid.get_nx() ); 
-      int ny = static_cast<int>( grid.get_ny() ); 
-      int nz = static_cast<int>( grid.get_nz() ); 
-      
-      unsigned short* data = reinterpret_cast<unsigned short*>( output_datablock->get_data() );
-      for ( size_t i = 0; i < this->seeds_.size(); ++i )
-      {   
-        Core::Point location = trans * seeds_[ i ];
-        int x = static_cast<int>( Core::Round( location.x() ) );
-        int y = static_cast<int>( Core::Round( location.y() ) );
-        int z = static_cast<int>( Core::Round( location.z() ) );
-        
-        if ( x >= 0 && y >= 0 && z >= 0 && x < nx && y < ny && z < nz )
-        {
-          unsigned short val = data[ output_datablock->to_index( static_cast<size_t>( x ), 
-            static_cast<size_t>( y ), static_cast<size_t>( z ) ) ];
-          if ( val ) lut[ val ] = 1;
-        }
-      }
-      
-      if ( this->mask_layer_ )
-      {
-        Core::MaskDataBlockHandle mask_handle = 
-          dynamic_cast<MaskLayer*>( this->mask_layer_.get() )->
-          get_mask_volume()->get_mask_data_block();
-          
-        unsigned char mask_value = mask_handle->get_mask_value();
-        size_t size = mask_handle->get_size();
-        unsigned char* mask_data = mask_handle->get_mask_data();
-        
-        Core::DataBlock::shared_lock_type lock( mask_handle->get_mutex() );
-        if ( this->invert_mask_ )
-        {
-          for ( size_t j = 0; j < size; j++ )
-          {
-            if ( ! ( mask_data[ j ] & mask_value && data[ j ] ) ) lut[ data[ j ] ] = 1;
-          }     
-        }
-        else
-        {
-          for ( size_t j = 0; j < size; j++ )
-          {
-            if ( ( mask_data[ j ] & mask_value && data[ j ] ) ) lut[ data[ j ] ] = 1;
-          }           
-        
-        }
-      }
-
-      this->dst_layer_->update_progress_signal_( 0.80 );
-      if ( this->check_abort() )
-      {
-        return;
-      }
-
-      size_t size = output_datablock->get_size();
-      for ( size_t j = 0; j < size; j++ )
-      {
-        data[ j ] = lut[ data[ j ] ];
-      }
+    // Every component that overlaps with the mask is kept as well
+    Core::MaskDataBlockHandle seed_mask_block;
+    if ( this->mask_layer_ )
+    {
+      MaskLayerHandle mask_layer = boost::dynamic_pointer_cast<MaskLayer>( this->mask_layer_ );
+      if ( mask_layer ) seed_mask_block = mask_layer->get_mask_volume()->get_mask_data_block();
     }
 
-    this->dst_layer_->update_progress_signal_( .90 );
-    if ( this->check_abort() )
+    Core::MaskDataBlockHandle output_mask;
+    if ( !( Core::MaskDataBlockManager::Instance()->create( 
+      this->dst_layer_->get_grid_transform(), output_mask ) ) )
     {
-      return;
+      this->report_error( "Could not allocate enough memory." );
+      return; 
     }
-    
-    Core::MaskDataBlockHandle mask_datablock;
-    if ( ! ( Core::MaskDataBlockManager::Convert( output_datablock, 
-      this->dst_layer_->get_grid_transform(), mask_datablock ) ) )  
+
+    // NOTE: The components are flood filled directly on the bitplanes, hence no label volume
+    // is needed.
+    if ( !Core::MaskDataBlockOperations::FloodFill( input_mask_block, true, seeds, output_mask,
+      seed_mask_block, this->invert_mask_, boost::bind( &LayerFilter::check_abort, this ) ) )
     {
-      this->report_error("Could not allocate enough memory.");
       return;
     }
       
@@ -389,10 +171,9 @@ public:
     
     this->dispatch_insert_mask_volume_into_layer( this->dst_layer_,
       Core::MaskVolumeHandle( new Core::MaskVolume(
-      this->dst_layer_->get_grid_transform(), mask_datablock ) ) );
-      
+      this->dst_layer_->get_grid_transform(), output_mask ) ) );
   }
-  SCI_END_ITK_RUN()
+  SCI_END_RUN()
 
   // GET_FITLER_NAME:
   // The name of the filter, this information is used for generating new layer labels.
@@ -121,7 +121,7 @@ template< class T >
 void CropAlgo::crop_typed_data( Core::DataBlockHandle src, Core::DataBlockHandle dst,
                  LayerHandle dst_layer )
 {
-  T* src_data = reinterpret_cast< T* >( src->get_data() );
+  const T* src_data = reinterpret_cast< const T* >( src->get_const_data() );
   T* dst_data = reinterpret_cast< T* >( dst->get_data() );
   size_t current_index = src->to_index( 0, 0, 0 );
   size_t stride_x = src->to_index( 1, 0, 0 ) - current_index;
@@ -26,9 +26,12 @@
  DEALINGS IN THE SOFTWARE.
  */
 
+// Boost includes
+#include <boost/bind.hpp>
+
 // Core includes
-#include <Core/DataBlock/StdDataBlock.h>
 #include <Core/DataBlock/MaskDataBlockManager.h>
+#include <Core/DataBlock/MaskDataBlockOperations.h>
 
 // Application includes
 #include <Application/Layer/LayerManager.h>
@@ -124,249 +127,41 @@ public:
   virtual void run_filter()
   {
     MaskLayerHandle input_mask = boost::dynamic_pointer_cast<MaskLayer>( this->src_layer_ );
-    Core::MaskVolumeHandle input_volume = input_mask->get_mask_volume();
-    Core::DataBlockHandle input_data_block;
-    
-    if ( ! ( Core::MaskDataBlockManager::Convert( input_volume->get_mask_data_block(), 
-      input_data_block, Core::DataType::UCHAR_E ) ) )
-    {
-      this->report_error( "Could not allocate enough memory." );
-      return;
-    }   
-    
-    Core::DataBlock::index_type nx = input_data_block->get_nx();
-    Core::DataBlock::index_type ny = input_data_block->get_ny();
-    Core::DataBlock::index_type nz = input_data_block->get_nz();
-    Core::DataBlock::index_type nxy = nx * ny;
-    Core::DataBlock::index_type size = input_data_block->get_size();
-    
-    unsigned char* data = reinterpret_cast<unsigned char*>( input_data_block->get_data() );
-  
-    Core::SliceType slice_type = static_cast<Core::SliceType::enum_type>( this->slice_type_ );
-    std::vector< std::vector<Core::DataBlock::index_type> > neighbors;
-    try
-    {
-      neighbors.resize( 0x40 );
-      Core::DataBlock::index_type nxy = nx * ny;
-
-      for ( size_t k = 0; k < neighbors.size(); k++ )
-      {
-        if ( !( this->only2d_ ) || ( slice_type != Core::SliceType::SAGITTAL_E ) )
-        {
-          if ( ! ( k & 0x1 ) ) neighbors[ k ].push_back( -1 );
-          if ( ! ( k & 0x2 ) ) neighbors[ k ].push_back( 1 );
-        }
-        
-        if ( !( this->only2d_ ) || ( slice_type != Core::SliceType::CORONAL_E ) )
-        {
-          if ( ! ( k & 0x4 ) ) neighbors[ k ].push_back( -nx );
-          if ( ! ( k & 0x8 ) ) neighbors[ k ].push_back( nx );
-        }
-        
-        if ( !( this->only2d_  ) || ( slice_type != Core::SliceType::AXIAL_E ) )
-        {
-          if ( ! ( k & 0x10 ) ) neighbors[ k ].push_back( -nxy );
-          if ( ! ( k & 0x20 ) ) neighbors[ k ].push_back( nxy );
-        }
-      }
-    }
-    catch ( ... )
-    {
-      this->report_error( "Could not allocate enough memory." );
-      return;   
-    }
+    Core::MaskDataBlockHandle input_mask_block = input_mask->get_mask_volume()->
+      get_mask_data_block();
 
-
-    // Inscribe mask
+    // The mask that constrains which voxels can change
+    Core::MaskDataBlockHandle constraint_mask_block;
     if ( this->mask_layer_ )
     {
       MaskLayerHandle mask_layer = boost::dynamic_pointer_cast<MaskLayer>( this->mask_layer_ );
-      if ( mask_layer )
-      {
-        Core::MaskDataBlockHandle mask_data_block = mask_layer->get_mask_volume()->
-          get_mask_data_block();      
-        Core::MaskDataBlock::shared_lock_type lock( mask_data_block->get_mutex() );
-        
-        unsigned char* mask_data = mask_data_block->get_mask_data();
-        unsigned char mask_value = mask_data_block->get_mask_value();
-        
-        if ( this->invert_mask_ )
-        {
-          for ( Core::DataBlock::index_type j = 0; j < size; j++ )
-          {
-            if ( data[ j ] == 1 && ( mask_data[ j ] & mask_value ) ) data[ j ] = 255;
-          }       
-        }
-        else
-        {
-          for ( Core::DataBlock::index_type j = 0; j < size; j++ )
-          {
-            if ( data[ j ] == 1 && !( mask_data[ j ] & mask_value ) ) data[ j ] = 255;
-          }
-        }
-      }
-    }
-      
-    // Detect Edge
-    float current_progress = 0.0f;
-    float progress_multiplier = 0.1f / static_cast<float>( nz );
-
-    size_t k = 0;
-    int border = 0;   
-    for ( Core::DataBlock::index_type z = 0; z < nz; z++ )
-    {
-      if ( z == 0 ) border |= 0x10; else border &= ~( 0x10 );
-      if ( z == nz - 1 ) border |= 0x20; else border &= ~( 0x20 );
-      
-      for ( Core::DataBlock::index_type y = 0; y < ny; y++ )
-      {
-        if ( y == 0 ) border |= 0x04; else border &= ~( 0x04 );
-        if ( y == ny - 1 ) border |= 0x08; else border &= ~( 0x08 );
-
-        for ( Core::DataBlock::index_type x = 0; x < nx; x++, k++ )
-        {
-          if ( data[ k ] == 0 || data[ k ] == 2 ) continue;
-          
-          int border_x = border;
-          if ( x == 0 ) border_x |= 0x1;
-          if ( x == nx - 1 ) border_x |= 0x2;
-
-          const std::vector<Core::DataBlock::index_type>& neigh = neighbors[ border_x ];
-          for ( size_t m = 0; m < neigh.size(); m++ )
-          {
-            Core::DataBlock::index_type index = k + neigh[ m ];
-            if ( data[ index ] == 0 ) data[ index ] = 2;
-          }
-        }
-      }
-      
-      float progress = static_cast<float>( z ) * progress_multiplier;
-    
-      if ( current_progress + 0.02f < progress )
-      {
-        current_progress = progress;
-        this->dst_layer_->update_progress( current_progress );
-        if ( this->check_abort() ) return;
-      }
+      if ( mask_layer ) constraint_mask_block = mask_layer->get_mask_volume()->
+        get_mask_data_block();
     }
     
-    // Build pattern
-    Core::DataBlock::index_type xr = this->radius_;
-    Core::DataBlock::index_type yr = this->radius_;
-    Core::DataBlock::index_type zr = this->radius_;
-    
-    if ( this->only2d_ )
-    {
-      if ( this->slice_type_ == Core::SliceType::AXIAL_E ) zr = 0;
-      if ( this->slice_type_ == Core::SliceType::CORONAL_E ) yr = 0;
-      if ( this->slice_type_ == Core::SliceType::SAGITTAL_E ) xr = 0;
-    }
-    
-    Core::DataBlock::index_type xs = 2 * xr + 1;
-    Core::DataBlock::index_type ys = 2 * yr + 1;
-    Core::DataBlock::index_type zs = 2 * zr + 1;
+    Core::SliceType slice_type = static_cast<Core::SliceType::enum_type>( this->slice_type_ );
 
-    Core::DataBlockHandle pattern = 
-      Core::StdDataBlock::New( xs, ys, zs, Core::DataType::UCHAR_E );
-    
-    if ( !pattern )
+    Core::MaskDataBlockHandle output_mask;
+    if ( !( Core::MaskDataBlockManager::Instance()->create( 
+      this->src_layer_->get_grid_transform(), output_mask ) ) )
     {
       this->report_error( "Could not allocate enough memory." );
-      return;
-    }   
-    
-    unsigned char* pdata = reinterpret_cast<unsigned char *>( pattern->get_data() );
-    
-    k = 0;
-    for ( Core::DataBlock::index_type z = -zr; z <= zr; z++ )
-    {
-      for ( Core::DataBlock::index_type y = -yr; y <= yr; y++ )
-      {
-        for ( Core::DataBlock::index_type x = -xr; x <= xr; x++, k++ )
-        {
-          if ( sqrt( static_cast<double>( x*x + y*y + z*z ) ) <= this->radius_ ) 
-          {
-            pdata[ k ] = 1;
-          }
-          else
-          {
-            pdata[ k ] = 0;
-          } 
-        }
-      }
-    }     
-      
-
-    // Fill in erosion
-    
-    progress_multiplier = 0.9f / static_cast<float>( nz );    
-    
-    Core::DataBlock::index_type idx = 0;
-    for ( Core::DataBlock::index_type z = 0; z < nz; z++ )
-    {     
-      for ( Core::DataBlock::index_type y = 0; y < ny; y++ )
-      {
-        for ( Core::DataBlock::index_type x = 0; x < nx; x++, idx++ )
-        {
-          if ( data[ idx ] != 2 ) continue;
-          
-          Core::DataBlock::index_type idx2 = 0;
-          for ( Core::DataBlock::index_type zz = -zr; zz <= zr; zz++ )
-          {
-            for ( Core::DataBlock::index_type yy = -yr; yy <= yr; yy++ )
-            {
-              for ( Core::DataBlock::index_type xx = -xr; xx <= xr; xx++, idx2++ )
-              {         
-                if ( pdata[ idx2 ] )
-                {
-                  Core::DataBlock::index_type px = x - xx;
-                  if ( px < 0 || px >= nx ) continue;
-                  Core::DataBlock::index_type py = y - yy;
-                  if ( py < 0 || py >= ny ) continue;
-                  Core::DataBlock::index_type pz = z - zz;
-                  if ( pz < 0 || pz >= nz ) continue;
-                  Core::DataBlock::index_type fidx = px + py * nx + pz * nxy;
-                  if ( data[ fidx ] == 1 )
-                  {
-                    data[ fidx ] = 0;
-                  }
-                }
-              }
-            }
-          }
-        }
-      }
-        
-      float progress = static_cast<float>( z ) * progress_multiplier + 0.1f;
-      
-      if ( current_progress + 0.02f < progress )
-      {
-        current_progress = progress;
-        this->dst_layer_->update_progress( current_progress );
-        if ( this->check_abort() ) return;
-      }
+      return; 
     }
 
-    if ( this->mask_layer_ )
+    // NOTE: The operation works directly on the bitplanes, hence the mask does not need to be 
+    // expanded into a full data block.
+    if ( !Core::MaskDataBlockOperations::Erode( input_mask_block, output_mask, this->radius_,
+      this->only2d_, slice_type, constraint_mask_block, this->invert_mask_, 
+      boost::bind( &Layer::update_progress, this->dst_layer_, _1, 0.0, 1.0 ),
+      boost::bind( &LayerFilter::check_abort, this ) ) )
     {
-      for ( Core::DataBlock::index_type j = 0; j < size; j++ )
-      {
-        if ( data[ j ] == 255 ) data[ j ] = 1;
-      }
-    }
-  
-    Core::MaskDataBlockHandle output_mask;
-
-    if (!( Core::MaskDataBlockManager::ConvertLabel( input_data_block, 
-      this->src_layer_->get_grid_transform(), output_mask, 1.0 ) ) )
-    {
-      this->report_error( "Could not allocate enough memory." );
-      return; 
+      return;
     }
 
     Core::MaskVolumeHandle mask_volume( new Core::MaskVolume( 
       this->src_layer_->get_grid_transform(), output_mask ) );
-
+      
     if ( !mask_volume )
     {
       this->report_error( "Could not allocate enough memory." );
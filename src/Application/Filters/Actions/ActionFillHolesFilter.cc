@@ -26,17 +26,18 @@
  DEALINGS IN THE SOFTWARE.
  */
 
-// ITK includes
-#include <itkConnectedComponentImageFilter.h>
+// Boost includes
+#include <boost/bind.hpp>
 
-#include <Core/DataBlock/StdDataBlock.h>
-#include <Core/DataBlock/ITKDataBlock.h>
+// Core includes
+#include <Core/Math/MathFunctions.h>
 #include <Core/DataBlock/MaskDataBlockManager.h>
+#include <Core/DataBlock/MaskDataBlockOperations.h>
 
 // Application includes
 #include <Application/Layer/LayerManager.h>
 #include <Application/StatusBar/StatusBar.h>
-#include <Application/Filters/ITKFilter.h>
+#include <Application/Filters/LayerFilter.h>
 #include <Application/Filters/Actions/ActionFillHolesFilter.h>
 
 // REGISTER ACTION:
@@ -71,7 +72,7 @@ bool ActionFillHolesFilter::validate( Core::ActionContextHandle& context )
 // NOTE: The separation of the algorithm into a private class is for the purpose of running the
 // filter on a separate thread.
 
-class FillHolesFilterAlgo : public ITKFilter
+class FillHolesFilterAlgo : public LayerFilter
 {
 
 public:
@@ -81,289 +82,62 @@ public:
   std::vector< Core::Point > seeds_;
   
 public:
-  // NOTE: The macro needs a data type to select which version to run. This needs to be
-  // a member variable of the algorithm class.
-  SCI_BEGIN_ITK_RUN()
-  {
-    // Define the type of filter that we use.
-    typedef itk::ConnectedComponentImageFilter< 
-      UCHAR_IMAGE_TYPE, USHORT_IMAGE_TYPE > filter_type;
-
-    // Retrieve the image as an itk image from the underlying data structure
-    // NOTE: This only does wrapping and does not regenerate the data.
-    Core::ITKImageDataT<unsigned char>::Handle input_image; 
-    // NOTE: Get the inverted version f the mask
-    this->get_itk_image_from_layer<unsigned char>( this->src_layer_, input_image, true );
-        
-    // Create a new ITK filter instantiation. 
-    filter_type::Pointer filter = filter_type::New();
-
-    // Relay abort and progress information to the layer that is executing the filter.
-    this->forward_abort_to_filter( filter, this->dst_layer_ );
-    this->observe_itk_progress( filter, this->dst_layer_, 0.0, 0.75 );
-  
-    // Setup the filter parameters that we do not want to change.
-    filter->SetInput( input_image->get_image() );
-
-    // Ensure we will have some threads left for doing something else
-    this->limit_number_of_itk_threads( filter );
-
-    // Run the actual ITK filter.
-    // This needs to be in a try/catch statement as certain filters throw exceptions when they
-    // are aborted. In that case we will relay a message to the status bar for information.
-
-    bool need_32bits = false;
-    try 
-    { 
-      filter->Update(); 
-    } 
-    catch ( ... ) 
-    {
-      if ( this->check_abort() )
-      {
-        this->report_error( "Filter was aborted." );
-        return;
-      }
-      if (  filter->GetObjectCount() > static_cast<unsigned long int>(
-        itk::NumericTraits<unsigned short>::max() ) )
-      {
-        need_32bits = true;
-      }
-      else
-      {
-        this->report_error( "ITK filter failed to complete." );
-        return;
-      }
-    }
-
-    Core::DataBlockHandle output_datablock;
-
-    // As ITK filters generate an inconsistent abort behavior, we record our own abort flag
-    // This one is set when the abort button is pressed and an abort is sent to ITK.
-    if ( this->check_abort() ) return;
+  // RUN:
+  // Implementation of run of the Runnable base class, this function is called when the thread
+  // is launched.
 
-    if ( need_32bits )
-    {
-      filter = 0;
-      // Define the type of filter that we use.
-      typedef itk::ConnectedComponentImageFilter< 
-        UCHAR_IMAGE_TYPE, UINT_IMAGE_TYPE > filter32_type;
-
-      // Retrieve the image as an itk image from the underlying data structure
-      // NOTE: This only does wrapping and does not regenerate the data.
-      Core::ITKImageDataT<unsigned char>::Handle input_image; 
-      // NOTE: Get the invertedd version f the mask
-      this->get_itk_image_from_layer<unsigned char>( this->src_layer_, input_image, true );
-          
-      // Create a new ITK filter instantiation. 
-      filter32_type::Pointer filter32 = filter32_type::New();
-
-      // Relay abort and progress information to the layer that is executing the filter.
-      this->forward_abort_to_filter( filter32, this->dst_layer_ );
-      this->observe_itk_progress( filter32, this->dst_layer_, 0.0, 0.75 );
-            
-      // Setup the filter parameters that we do not want to change.
-      filter32->SetInput( input_image->get_image() );
-
-      // Ensure we will have some threads left for doing something else
-      this->limit_number_of_itk_threads( filter32 );
-
-      // Run the actual ITK filter.
-      // This needs to be in a try/catch statement as certain filters throw exceptions when they
-      // are aborted. In that case we will relay a message to the status bar for information.
-      try 
-      { 
-        filter32->Update(); 
-      } 
-      catch ( ... ) 
-      {
-        if ( this->check_abort() )
-        {
-          this->report_error( "Filter was aborted." );
-          return;
-        }
-  
-        this->report_error( "ITK filter failed to complete." );
-        return;
-      }
-
-      // As ITK filters generate an inconsistent abort behavior, we record our own abort flag
-      // This one is set when the abort button is pressed and an abort is sent to ITK.
-      if ( this->check_abort() ) return;
-
-
-      output_datablock = Core::ITKDataBlock::New( filter32->GetOutput() );
-      
-      unsigned int max_label = filter32->GetObjectCount();
-      std::vector<unsigned int> lut;
-
-      try
-      {
-        lut.resize( max_label + 1, 1 );
-      }
-      catch( ... )
-      {
-        this->report_error( "Could not allocate enough memory." );
-        return;   
-      }
-      
-      Core::GridTransform grid = input_image->get_grid_transform();
-      Core::Transform trans = grid.get_inverse();
-      int nx = static_cast<int>( grid.get_nx() ); 
-      int ny = static_cast<int>( grid.get_ny() ); 
-      int nz = static_cast<int>( grid.get_nz() ); 
-      
-      unsigned int* data = reinterpret_cast<unsigned int*>( output_datablock->get_data() );
-      unsigned int val;
-      for ( size_t i = 0; i < this->seeds_.size(); ++i )
-      {   
-        Core::Point location = trans * seeds_[ i ];
-        int x = static_cast<int>( Core::Round( location.x() ) );
-        int y = static_cast<int>( Core::Round( location.y() ) );
-        int z = static_cast<int>( Core::Round( location.z() ) );
-        
-        if ( x >= 0 && y >= 0 && z >= 0 && x < nx && y < ny && z < nz )
-        {
-          val = data[ output_datablock->to_index( static_cast<size_t>( x ), 
-            static_cast<size_t>( y ), static_cast<size_t>( z ) ) ];
-          if ( val ) lut[ val ] = 0;
-        }
-      }
-
-      // Ensure that anything connected to the corners is not removed
-      val = data[ output_datablock->to_index( 0, 0, 0 ) ]; 
-      if ( val ) lut[ val ] = 0;
-      val = data[ output_datablock->to_index( static_cast<size_t>( nx -1 ), 0, 0 ) ];
-      if ( val ) lut[ val ] = 0;
-      val = data[ output_datablock->to_index( 0, static_cast<size_t>( ny -1 ), 0 ) ]; 
-      if ( val ) lut[ val ] = 0;
-      val = data[ output_datablock->to_index( static_cast<size_t>( nx -1 ), 
-        static_cast<size_t>( ny -1 ), 0 ) ];
-      if ( val ) lut[ val ] = 0;
-      val = data[ output_datablock->to_index( 0, 0, static_cast<size_t>( nz -1 ) ) ]; 
-      if ( val ) lut[ val ] = 0;
-      val = data[ output_datablock->to_index( static_cast<size_t>( nx -1 ), 0, 
-        static_cast<size_t>( nz -1 ) ) ];
-      if ( val ) lut[ val ] = 0;
-      val = data[ output_datablock->to_index( 0, static_cast<size_t>( ny -1 ), 
-        static_cast<size_t>( nz -1 ) ) ]; 
-      if ( val ) lut[ val ] = 0;
-      val = data[ output_datablock->to_index( static_cast<size_t>( nx -1 ), 
-        static_cast<size_t>( ny -1 ), static_cast<size_t>( nz -1 ) ) ];
-      if ( val ) lut[ val ] = 0;
-      
-      lut[ 0 ] = 1;
+  SCI_BEGIN_RUN( )
+  {
+    MaskLayerHandle input_mask = boost::dynamic_pointer_cast<MaskLayer>( this->src_layer_ );
+    Core::MaskDataBlockHandle input_mask_block = input_mask->get_mask_volume()->
+      get_mask_data_block();
+
+    // Convert the seed points into voxel indices
+    Core::GridTransform grid = this->src_layer_->get_grid_transform();
+    Core::Transform trans = grid.get_inverse();
+    int nx = static_cast<int>( grid.get_nx() ); 
+    int ny = static_cast<int>( grid.get_ny() ); 
+    int nz = static_cast<int>( grid.get_nz() ); 
+
+    Core::MaskDataBlockOperations::seed_list_type seeds;
+    for ( size_t i = 0; i < this->seeds_.size(); ++i )
+    {   
+      Core::Point location = trans * this->seeds_[ i ];
+      int x = static_cast<int>( Core::Round( location.x() ) );
+      int y = static_cast<int>( Core::Round( location.y() ) );
+      int z = static_cast<int>( Core::Round( location.z() ) );
       
-      this->dst_layer_->update_progress_signal_( 0.80 );
-      if ( this->check_abort() )
-      {
-        return;
-      }
-
-      size_t size = output_datablock->get_size();
-      for ( size_t j = 0; j < size; j++ )
+      if ( x >= 0 && y >= 0 && z >= 0 && x < nx && y < ny && z < nz )
       {
-        data[ j ] = lut[ data[ j ] ];
+        seeds.push_back( static_cast<Core::MaskDataBlock::index_type>( 
+          input_mask_block->to_index( static_cast<size_t>( x ), 
+          static_cast<size_t>( y ), static_cast<size_t>( z ) ) ) );
       }
     }
-    else
-    {
-      output_datablock = Core::ITKDataBlock::New( filter->GetOutput() );
-      
-      unsigned int max_label = filter->GetObjectCount();
-      std::vector<unsigned short> lut;
 
-      try
-      {
-        lut.resize( max_label + 1, 1 );
-      }
-      catch( ... )
-      {
-        this->report_error( "Could not allocate enough memory." );
-        return;   
-      }
-      
-      Core::GridTransform grid = input_image->get_grid_transform();
-      Core::Transform trans = grid.get_inverse();
-      int nx = static_cast<int>( grid.get_nx() ); 
-      int ny = static_cast<int>( grid.get_ny() ); 
-      int nz = static_cast<int>( grid.get_nz() ); 
-      
-      unsigned short* data = reinterpret_cast<unsigned short*>( output_datablock->get_data() );
-      unsigned short val;
-      for ( size_t i = 0; i < this->seeds_.size(); ++i )
-      {   
-        Core::Point location = trans * seeds_[ i ];
-        int x = static_cast<int>( Core::Round( location.x() ) );
-        int y = static_cast<int>( Core::Round( location.y() ) );
-        int z = static_cast<int>( Core::Round( location.z() ) );
-        
-        if ( x >= 0 && y >= 0 && z >= 0 && x < nx && y < ny && z < nz )
-        {
-          val = data[ output_datablock->to_index( static_cast<size_t>( x ), 
-            static_cast<size_t>( y ), static_cast<size_t>( z ) ) ];
-          if ( val ) lut[ val ] = 0;
-        }
-      }
-
-      // Ensure that anything connected to the corners is not removed
-      val = data[ output_datablock->to_index( 0, 0, 0 ) ]; 
-      if ( val ) lut[ val ] = 0;
-      val = data[ output_datablock->to_index( static_cast<size_t>( nx -1 ), 0, 0 ) ];
-      if ( val ) lut[ val ] = 0;
-      val = data[ output_datablock->to_index( 0, static_cast<size_t>( ny -1 ), 0 ) ]; 
-      if ( val ) lut[ val ] = 0;
-      val = data[ output_datablock->to_index( static_cast<size_t>( nx -1 ), 
-        static_cast<size_t>( ny -1 ), 0 ) ];
-      if ( val ) lut[ val ] = 0;
-      val = data[ output_datablock->to_index( 0, 0, static_cast<size_t>( nz -1 ) ) ]; 
-      if ( val ) lut[ val ] = 0;
-      val = data[ output_datablock->to_index( static_cast<size_t>( nx -1 ), 0, 
-        static_cast<size_t>( nz -1 ) ) ];
-      if ( val ) lut[ val ] = 0;
-      val = data[ output_datablock->to_index( 0, static_cast<size_t>( ny -1 ), 
-        static_cast<size_t>( nz -1 ) ) ]; 
-      if ( val ) lut[ val ] = 0;
-      val = data[ output_datablock->to_index( static_cast<size_t>( nx -1 ), 
-        static_cast<size_t>( ny -1 ), static_cast<size_t>( nz -1 ) ) ];
-      if ( val ) lut[ val ] = 0;
-      
-      lut[ 0 ] = 1;
-      
-      this->dst_layer_->update_progress_signal_( 0.80 );
-      if ( this->check_abort() )
-      {
-        return;
-      }
-
-      size_t size = output_datablock->get_size();
-      for ( size_t j = 0; j < size; j++ )
-      {
-        data[ j ] = lut[ data[ j ] ];
-      }   
+    Core::MaskDataBlockHandle output_mask;
+    if ( !( Core::MaskDataBlockManager::Instance()->create( 
+      this->dst_layer_->get_grid_transform(), output_mask ) ) )
+    {
+      this->report_error( "Could not allocate enough memory." );
+      return; 
     }
 
-    this->dst_layer_->update_progress_signal_( .90 );
-    if ( this->check_abort() )
+    // NOTE: The background that is connected to the corners of the volume or to one of the 
+    // seeds is flood filled directly on the bitplanes, everything else is a hole.
+    if ( !Core::MaskDataBlockOperations::FillHoles( input_mask_block, seeds, output_mask,
+      boost::bind( &LayerFilter::check_abort, this ) ) )
     {
       return;
     }
-    
-    Core::MaskDataBlockHandle mask_datablock;
-    if ( !( Core::MaskDataBlockManager::Convert( output_datablock, 
-      this->dst_layer_->get_grid_transform(), mask_datablock ) ) )
-    {
-      this->report_error( "Could not allocate enough memory." );
-      return;       
-    }
-    
+
     this->dst_layer_->update_progress_signal_( 1.0 );
     
     this->dispatch_insert_mask_volume_into_layer( this->dst_layer_,
       Core::MaskVolumeHandle( new Core::MaskVolume(
-      this->dst_layer_->get_grid_transform(), mask_datablock ) ) );
+      this->dst_layer_->get_grid_transform(), output_mask ) ) );
   }
-  SCI_END_ITK_RUN()
+  SCI_END_RUN()
 
   // GET_FITLER_NAME:
   // The name of the filter, this information is used for generating new layer labels.
@@ -206,7 +206,6 @@ public:
           }
         }
       }
-      dstDataBlock->update_histogram();
 
       // TODO: threshold from 0 to dataset max to get mask layer
       this->dispatch_insert_data_volume_into_layer(
@@ -26,8 +26,13 @@
  DEALINGS IN THE SOFTWARE.
  */
 
+// Boost includes
+#include <boost/bind.hpp>
+
+// Core includes
 #include <Core/DataBlock/StdDataBlock.h>
 #include <Core/DataBlock/MaskDataBlockManager.h>
+#include <Core/DataBlock/MaskDataBlockOperations.h>
 
 // Application includes
 #include <Application/Layer/LayerManager.h>
@@ -111,47 +116,21 @@ public:
   {
     Core::MaskDataBlockHandle mask_datablock = input->get_mask_volume()->
       get_mask_data_block();
-    const unsigned char* src_data = mask_datablock->get_mask_data();
-    unsigned char mask_value = mask_datablock->get_mask_value();
-    Core::DataBlockHandle output_datablock = Core::StdDataBlock::New(
-      output->get_grid_transform(), Core::DataType::UCHAR_E );
-    if ( !output_datablock )
+
+    Core::MaskDataBlockHandle output_mask;
+    if ( !( Core::MaskDataBlockManager::Instance()->create( 
+      output->get_grid_transform(), output_mask ) ) )
     {
       this->report_error( "Could not allocate enough memory." );
       return;
     }
-    
-    Core::MaskDataBlock::shared_lock_type lock( mask_datablock->get_mutex() );
-    unsigned char* dst_data = reinterpret_cast< unsigned char* >( output_datablock->get_data() );
-    size_t z_plane_size = mask_datablock->get_nx() * mask_datablock->get_ny();
-    size_t nz = mask_datablock->get_nz();
-    size_t tenth_nz = nz / 10;
-    size_t index = 0;
-    for ( size_t z = 0; z < nz; ++z )
-    {
-      for ( size_t i = 0; i < z_plane_size; ++i, ++index )
-      {
-        dst_data[ index ] = !( src_data[ index ] & mask_value );
-      }
-      if ( this->check_abort() )
-      {
-        return;
-      }
-      if ( z > 0 && z % tenth_nz == 0 )
-      {
-        output->update_progress_signal_( ( z * 1.0 ) / nz );
-      }
-    }
-    output->update_progress_signal_( 1.0 );
-
-    lock.unlock();
 
-    Core::MaskDataBlockHandle output_mask;
-    Core::MaskDataBlockManager::Convert( output_datablock, 
-      output->get_grid_transform(), output_mask );
-    if ( !output_mask )
+    if ( !Core::MaskDataBlockOperations::Invert( mask_datablock, output_mask, 
+      boost::bind( &Layer::update_progress, output, _1, 0.0, 1.0 ),
+      boost::bind( &LayerFilter::check_abort, this ) ) )
     {
-      this->report_error( "Could not allocate enough memory." );
+      if ( this->check_abort() ) return;
+      this->report_error( "The mask does not have the same size as the output." );
       return;
     }
     
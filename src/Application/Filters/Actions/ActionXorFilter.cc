@@ -26,9 +26,12 @@
  DEALINGS IN THE SOFTWARE.
  */
 
+// Boost includes
+#include <boost/bind.hpp>
+
 // Core includes
-#include <Core/Math/MathFunctions.h>
 #include <Core/DataBlock/MaskDataBlockManager.h>
+#include <Core/DataBlock/MaskDataBlockOperations.h>
 
 // Application includes
 #include <Application/Layer/LayerManager.h>
@@ -123,85 +126,15 @@ public:
       return;   
     } 
 
-    unsigned char* mask1_data = mask1_data_block->get_mask_data();
-    unsigned char* mask2_data = mask2_data_block->get_mask_data();
-    unsigned char* mask_data = output_mask_data_block->get_mask_data();
-
-    unsigned char mask1_value = mask1_data_block->get_mask_value();
-    unsigned char mask2_value = mask2_data_block->get_mask_value();
-    unsigned char mask_value = output_mask_data_block->get_mask_value();
-
-    { 
-      // NOTE: As this filters works directly on the mask data blocks, one needs to lock
-      // them carefully as they share locks between layers in the same memory space 
-      // eight layers can share one datablock hence we need to be careful.
-      Core::MaskDataBlock::lock_type wlock( output_mask_data_block->get_mutex() );
-      
-      Core::MaskDataBlock::shared_lock_type slock1;
-      Core::MaskDataBlock::shared_lock_type slock2;
-
-      // NOTE: As a shared lock is not recursive the write lock may have already locked the
-      // layers we need for reading hence only lock the underlying data if the write
-      // lock does not cover it
-      if ( mask1_data_block->get_data_block() != output_mask_data_block->get_data_block() )
-      {
-        Core::MaskDataBlock::shared_lock_type mutex(mask1_data_block->get_mutex() );
-        slock1.swap(mutex);
-      }
-    
-      if ( mask2_data_block->get_data_block() != output_mask_data_block->get_data_block() )
-      {
-        Core::MaskDataBlock::shared_lock_type mutex(mask2_data_block->get_mutex() );
-        slock2.swap(mutex);
-      }
-    
-      size_t size = mask1_data_block->get_size();
-      size_t size8 = Core::RemoveRemainder8( size );
-      size_t progress_count = 0;
-      for ( size_t j = 0; j < size8; j+=8 )
-      {
-        if ( ( ( mask1_data[ j ] & mask1_value ) && !( mask2_data[ j ] & mask2_value ) ) ||
-          ( !( mask1_data[ j ] & mask1_value ) && ( mask2_data[ j ] & mask2_value ) ) )
-          mask_data[ j ] |= mask_value;
-        if ( ( ( mask1_data[ j + 1 ] & mask1_value ) && !( mask2_data[ j + 1 ] & mask2_value ) ) ||
-          ( !( mask1_data[ j + 1 ] & mask1_value ) && ( mask2_data[ j + 1 ] & mask2_value ) ) )
-          mask_data[ j + 1 ] |= mask_value;
-        if ( ( ( mask1_data[ j + 2 ] & mask1_value ) && !( mask2_data[ j + 2 ] & mask2_value ) ) ||
-          ( !( mask1_data[ j + 2 ] & mask1_value ) && ( mask2_data[ j + 2 ] & mask2_value ) ) )
-          mask_data[ j + 2 ] |= mask_value;
-        if ( ( ( mask1_data[ j + 3 ] & mask1_value ) && !( mask2_data[ j + 3 ] & mask2_value ) ) ||
-          ( !( mask1_data[ j + 3 ] & mask1_value ) && ( mask2_data[ j + 3 ] & mask2_value ) ) )
-          mask_data[ j + 3 ] |= mask_value;
-        if ( ( ( mask1_data[ j + 4 ] & mask1_value ) && !( mask2_data[ j + 4 ] & mask2_value ) ) ||
-          ( !( mask1_data[ j + 4 ] & mask1_value ) && ( mask2_data[ j + 4 ] & mask2_value ) ) )
-          mask_data[ j + 4 ] |= mask_value;
-        if ( ( ( mask1_data[ j + 5 ] & mask1_value ) && !( mask2_data[ j + 5 ] & mask2_value ) ) ||
-          ( !( mask1_data[ j + 5 ] & mask1_value ) && ( mask2_data[ j + 5 ] & mask2_value ) ) )
-          mask_data[ j + 5 ] |= mask_value;
-        if ( ( ( mask1_data[ j + 6 ] & mask1_value ) && !( mask2_data[ j + 6 ] & mask2_value ) ) ||
-          ( !( mask1_data[ j + 6 ] & mask1_value ) && ( mask2_data[ j + 6 ] & mask2_value ) ) )
-          mask_data[ j + 6 ] |= mask_value;
-        if ( ( ( mask1_data[ j + 7 ] & mask1_value ) && !( mask2_data[ j + 7 ] & mask2_value ) ) ||
-          ( !( mask1_data[ j + 7 ] & mask1_value ) && ( mask2_data[ j + 7 ] & mask2_value ) ) )
-          mask_data[ j + 7 ] |= mask_value;
-        progress_count++;
-        if ( progress_count == 1000 )
-        {
-          progress_count = 0;
-          this->dst_layer_->update_progress( 
-            static_cast<float>( j )/static_cast<float>( size ) );
-          if ( this->check_abort() ) return;
-        }     
-      }
-      
-      for ( size_t j = size8; j < size; j++ )
-      {
-        if ( ( ( mask1_data[ j ] & mask1_value ) && !( mask2_data[ j ] & mask2_value ) ) ||
-          ( !( mask1_data[ j ] & mask1_value ) && ( mask2_data[ j ] & mask2_value ) ) )
-          mask_data[ j ] |= mask_value;     
-      }     
-
+    // NOTE: The operation works directly on the bitplanes and takes care of locking the
+    // mask data blocks, which may be shared between the masks.
+    if ( !Core::MaskDataBlockOperations::Xor( mask1_data_block, mask2_data_block, 
+      output_mask_data_block, boost::bind( &Layer::update_progress, this->dst_layer_, _1, 
+      0.0, 1.0 ), boost::bind( &LayerFilter::check_abort, this ) ) )
+    {
       if ( this->check_abort() ) return;
+      this->report_error( "The masks do not have the same size." );
+      return;
     }
       
     this->dispatch_insert_mask_volume_into_layer( this->dst_layer_, mask_volume );
@@ -877,10 +877,9 @@ bool LayerFilter::dispatch_insert_data_volume_into_layer( LayerHandle layer,
   DataLayerHandle data_layer = boost::dynamic_pointer_cast<DataLayer>( layer );
   if ( ! data_layer ) return false;
 
-  // Update the data volume if needed.
-  // NOTE: We assume that this data volume is not shared by any other thread yet
-  // Hence we can update the histogram on the calling thread.
-  if ( update_histogram ) data->get_data_block()->update_histogram();
+  // Mark the histogram as out of date if needed. It is computed lazily, either when the
+  // layer requests it or when the range of the data is first queried.
+  if ( update_histogram ) data->get_data_block()->invalidate_histogram();
   
   // Find the provenance id that this layer will use
   ProvenanceID prov_id = -1;
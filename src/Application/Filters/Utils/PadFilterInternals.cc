@@ -108,7 +108,7 @@ void PadFilterInternals::pad_and_crop_typed_data( DataBlockHandle src,
   int dst_nz = static_cast< int >( dst_trans_.get_nz() );
   int dst_nxy = dst_nx * dst_ny;
 
-  const T* src_data = reinterpret_cast< T* >( src->get_data() );
+  const T* src_data = reinterpret_cast< const T* >( src->get_const_data() );
   T* dst_data = reinterpret_cast< T* >( dst->get_data() );
 
   T padding_val;
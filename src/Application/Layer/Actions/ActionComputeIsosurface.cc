@@ -61,6 +61,18 @@ bool ActionComputeIsosurface::validate( Core::ActionContextHandle& context )
     return false;
   }
 
+  if ( this->target_faces_ < 0 || this->max_error_ < 0.0 )
+  {
+    context->report_error( "The decimation bounds cannot be negative." );
+    return false;
+  }
+
+  if ( this->num_levels_ < 1 )
+  {
+    context->report_error( "The isosurface needs at least one level of detail." );
+    return false;
+  }
+
   return true; // validated
 }
 
@@ -68,7 +80,9 @@ bool ActionComputeIsosurface::run( Core::ActionContextHandle& context,
   Core::ActionResultHandle& result )
 {
   MaskLayerHandle mask_layer = LayerManager::FindMaskLayer( this->layer_id_ );
-  mask_layer->compute_isosurface( this->quality_factor_, this->capping_enabled_ );
+  mask_layer->compute_isosurface( this->quality_factor_, this->capping_enabled_,
+    static_cast< size_t >( this->target_faces_ ), this->max_error_, 
+    static_cast< size_t >( this->num_levels_ ) );
 
   /*
   Hide the abort message (if aborted).  This is a workaround for the fact that this action is
@@ -100,7 +114,8 @@ bool ActionComputeIsosurface::run( Core::ActionContextHandle& context,
 }
 
 void ActionComputeIsosurface::Dispatch( Core::ActionContextHandle context, 
-  MaskLayerHandle mask_layer, double quality_factor, bool capping_enabled, bool show )
+  MaskLayerHandle mask_layer, double quality_factor, bool capping_enabled, bool show,
+  int target_faces, double max_error, int num_levels )
 {
   ActionComputeIsosurface* action = new ActionComputeIsosurface;
 
@@ -108,6 +123,9 @@ void ActionComputeIsosurface::Dispatch( Core::ActionContextHandle context,
   action->quality_factor_ = quality_factor;
   action->capping_enabled_ = capping_enabled;
   action->show_ = show;
+  action->target_faces_ = target_faces;
+  action->max_error_ = max_error;
+  action->num_levels_ = num_levels;
 
   Core::ActionDispatcher::PostAction( Core::ActionHandle( action ), context );
 }
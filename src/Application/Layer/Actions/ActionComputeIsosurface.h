@@ -48,6 +48,9 @@ CORE_ACTION(
   CORE_ACTION_OPTIONAL_ARGUMENT( "quality_factor", "1.0", "The quality factor for mask downsampling prior to isosurface computation." )
   CORE_ACTION_OPTIONAL_ARGUMENT( "capping", "false", "Whether isosurfaces will be capped." )
   CORE_ACTION_OPTIONAL_ARGUMENT( "show", "true", "Whether isosurfaces will automatically made visible." )
+  CORE_ACTION_OPTIONAL_ARGUMENT( "target_triangles", "0", "Decimate the isosurface to at most this number of triangles, 0 to not limit the number of triangles." )
+  CORE_ACTION_OPTIONAL_ARGUMENT( "max_error", "0", "Maximum error of the decimation in world units, 0 to not limit the error." )
+  CORE_ACTION_OPTIONAL_ARGUMENT( "levels_of_detail", "1", "Number of levels of detail, each with a quarter of the triangles of the previous one." )
   CORE_ACTION_CHANGES_PROJECT_DATA()
 )
   
@@ -59,6 +62,9 @@ public:
     this->add_parameter( this->quality_factor_ );
     this->add_parameter( this->capping_enabled_ );
     this->add_parameter( this->show_ );
+    this->add_parameter( this->target_faces_ );
+    this->add_parameter( this->max_error_ );
+    this->add_parameter( this->num_levels_ );
   }
   
 // -- Functions that describe action --
@@ -78,6 +84,15 @@ private:
 
   /// THis parameter describes whether the isosurface will be shown at the end of the computation
   bool show_;
+
+  /// This parameter describes the maximum number of triangles of the decimated isosurface
+  int target_faces_;
+
+  /// This parameter describes the maximum error of the decimation
+  double max_error_;
+
+  /// This parameter describes the number of levels of detail of the isosurface
+  int num_levels_;
   
   // -- Dispatch this action from the interface --
 public:
@@ -85,7 +100,8 @@ public:
   /// DISPATCH
   /// Create and dispatch action that computes the isosurface for the selected layer
   static void Dispatch( Core::ActionContextHandle context, MaskLayerHandle mask_layer, 
-    double quality_factor, bool capping_enabled, bool show = false );
+    double quality_factor, bool capping_enabled, bool show = false, int target_faces = 0,
+    double max_error = 0.0, int num_levels = 1 );
 
   /// DISPATCH:
   /// Create and dispatch action that computes the isosurface for the active layer.
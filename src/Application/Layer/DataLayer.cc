@@ -34,6 +34,9 @@
 
 // Core includes
 #include <Core/Application/Application.h>
+#include <Core/DataBlock/NrrdData.h>
+#include <Core/DataBlock/StdDataBlock.h>
+#include <Core/LargeVolume/ChunkedVolumeFile.h>
 #include <Core/State/StateIO.h>
 #include <Core/Utils/ScopedCounter.h>
 #include <Core/Utils/Log.h>
@@ -41,11 +44,15 @@
 // Application includes
 #include <Application/ProjectManager/ProjectManager.h>
 #include <Application/Layer/DataLayer.h>
+#include <Application/Layer/LayerDataLoader.h>
 #include <Application/PreferencesManager/PreferencesManager.h>
 
 namespace Seg3D
 {
 
+class DataLayerPrivate;
+typedef boost::weak_ptr< DataLayerPrivate > DataLayerPrivateWeakHandle;
+
 class DataLayerPrivate
 {
 public:
@@ -55,10 +62,104 @@ public:
   void handle_contrast_brightness_changed();
   void handle_display_value_range_changed();
 
+  // HAS_HISTOGRAM:
+  // Check whether the histogram of the data is available. If not, it is computed on the
+  // thread pool and the data info is updated once it is done.
+  bool has_histogram();
+
+  // HANDLEHISTOGRAMCHANGED:
+  // Called from the thread that computed the histogram.
+  static void HandleHistogramChanged( DataLayerPrivateWeakHandle layer_private );
+
+  // LOAD_CHUNKED_VOLUME:
+  // Create the data volume from a chunked volume file and read its data in the background.
+  bool load_chunked_volume( const boost::filesystem::path& filename, std::string& error );
+
+  // LOAD_NRRD_VOLUME:
+  // Create the data volume from the header of a NRRD file and read its data in the background.
+  bool load_nrrd_volume( const boost::filesystem::path& filename, std::string& error );
+
+  // CREATE_EMPTY_VOLUME:
+  // Create a data volume of which the data still needs to be read. The layer is processing
+  // until all of its data has been read, actions that need the data wait for it.
+  Core::DataBlockHandle create_empty_volume( const Core::GridTransform& grid_transform,
+    Core::DataType data_type, const Core::Histogram& histogram, 
+    const boost::filesystem::path& filename, std::string& error );
+
   DataLayer* layer_;
   size_t signal_block_count_;
+
+  // The data block whose histogram is being waited for
+  Core::DataBlock* histogram_data_block_;
+  boost::signals2::connection histogram_connection_;
 };
 
+bool DataLayerPrivate::load_chunked_volume( const boost::filesystem::path& filename, 
+  std::string& error )
+{
+  Core::ChunkedVolumeFileHandle file( new Core::ChunkedVolumeFile );
+  if ( !file->open( filename, error ) ) return false;
+
+  // Without a histogram the display range cannot be set up before the data has been read
+  Core::Histogram histogram;
+  if ( !file->get_histogram( histogram ) )
+  {
+    Core::DataBlockHandle data_block;
+    if ( !file->read( data_block, error ) ) return false;
+    this->layer_->data_volume_.reset( new Core::DataVolume( file->get_grid_transform(), 
+      data_block ) );
+    return true;
+  }
+
+  Core::DataBlockHandle data_block = this->create_empty_volume( file->get_grid_transform(),
+    file->get_data_type(), histogram, filename, error );
+  if ( !data_block ) return false;
+
+  LayerDataLoader::Instance()->load_layer( this->layer_->get_layer_id(), file, data_block );
+  return true;
+}
+
+bool DataLayerPrivate::load_nrrd_volume( const boost::filesystem::path& filename, 
+  std::string& error )
+{
+  Core::NrrdDataHandle nrrd;
+  if ( !Core::NrrdData::LoadNrrd( filename.string(), nrrd, error, false ) ) return false;
+
+  // Without a histogram the display range cannot be set up before the data has been read
+  Core::Histogram histogram;
+  if ( nrrd->get_data_type() == Core::DataType::UNKNOWN_E ||
+    !nrrd->get_stored_histogram( histogram ) )
+  {
+    return Core::DataVolume::LoadDataVolume( filename, this->layer_->data_volume_, error );
+  }
+
+  Core::DataBlockHandle data_block = this->create_empty_volume( nrrd->get_grid_transform(),
+    nrrd->get_data_type(), histogram, filename, error );
+  if ( !data_block ) return false;
+
+  LayerDataLoader::Instance()->load_layer( this->layer_->get_layer_id(), filename, data_block );
+  return true;
+}
+
+Core::DataBlockHandle DataLayerPrivate::create_empty_volume( 
+  const Core::GridTransform& grid_transform, Core::DataType data_type, 
+  const Core::Histogram& histogram, const boost::filesystem::path& filename, 
+  std::string& error )
+{
+  Core::DataBlockHandle data_block = Core::StdDataBlock::New( grid_transform, data_type );
+  if ( !data_block )
+  {
+    error = "Could not allocate enough memory to read file '" + filename.string() + "'.";
+    return data_block;
+  }
+  data_block->clear();
+  data_block->set_histogram( histogram );
+
+  this->layer_->data_volume_.reset( new Core::DataVolume( grid_transform, data_block ) );
+  this->layer_->data_state_->set( Layer::PROCESSING_C );
+  return data_block;
+}
+
 void DataLayerPrivate::update_data_info()
 {
   if ( !this->layer_->data_volume_ ||
@@ -101,13 +202,16 @@ void DataLayerPrivate::update_data_info()
     break;
   }
   
+  // The range is filled in once the histogram has been computed
+  if ( !this->has_histogram() ) return;
+
   this->layer_->min_value_state_->set( this->layer_->data_volume_->get_min() );
   this->layer_->max_value_state_->set( this->layer_->data_volume_->get_max() );
 }
 
 void DataLayerPrivate::update_display_value_range()
 {
-  if ( !this->layer_->has_valid_data() )  return;
+  if ( !this->layer_->has_valid_data() || !this->has_histogram() )  return;
   
   {
     Core::ScopedCounter signal_block( this->signal_block_count_ );
@@ -120,6 +224,47 @@ void DataLayerPrivate::update_display_value_range()
   this->handle_contrast_brightness_changed();
 }
 
+bool DataLayerPrivate::has_histogram()
+{
+  Core::DataBlockHandle data_block = this->layer_->data_volume_->get_data_block();
+  if ( data_block->has_histogram() ) return true;
+
+  if ( this->histogram_data_block_ != data_block.get() )
+  {
+    this->histogram_connection_.disconnect();
+    this->histogram_data_block_ = data_block.get();
+    this->histogram_connection_ = data_block->histogram_changed_signal_.connect( boost::bind(
+      &DataLayerPrivate::HandleHistogramChanged, 
+      DataLayerPrivateWeakHandle( this->layer_->private_ ) ) );
+
+    // The histogram may have been computed before the connection was made
+    if ( data_block->has_histogram() ) return true;
+  }
+
+  Core::DataBlock::RequestHistogram( data_block );
+  return false;
+}
+
+void DataLayerPrivate::HandleHistogramChanged( DataLayerPrivateWeakHandle layer_private )
+{
+  if ( !Core::Application::IsApplicationThread() )
+  {
+    Core::Application::PostEvent( boost::bind( &DataLayerPrivate::HandleHistogramChanged,
+      layer_private ) );
+    return;
+  }
+
+  DataLayerPrivateHandle private_handle = layer_private.lock();
+  if ( !private_handle || !private_handle->layer_ ) return;
+
+  DataLayer* layer = private_handle->layer_;
+  Layer::lock_type lock( Layer::GetMutex() );
+  if ( !layer->data_volume_ ) return;
+  
+  private_handle->update_data_info();
+  private_handle->update_display_value_range();
+}
+
 void DataLayerPrivate::handle_contrast_brightness_changed()
 {
   if ( this->signal_block_count_ > 0 || !this->layer_->has_valid_data() )
@@ -174,6 +319,7 @@ DataLayer::DataLayer( const std::string& name, const Core::DataVolumeHandle& vol
   this->data_volume_->register_data();
   this->private_->layer_ = this;
   this->private_->signal_block_count_ = 0;
+  this->private_->histogram_data_block_ = 0;
   this->initialize_states();
   this->private_->update_display_value_range();
 }
@@ -184,6 +330,7 @@ DataLayer::DataLayer( const std::string& state_id ) :
 {
   this->private_->layer_ = this;
   this->private_->signal_block_count_ = 0;
+  this->private_->histogram_data_block_ = 0;
   this->initialize_states();
 }
 
@@ -191,6 +338,8 @@ DataLayer::~DataLayer()
 {
   // Disconnect all current connections
   this->disconnect_all();
+  this->private_->histogram_connection_.disconnect();
+  this->private_->layer_ = 0;
   if ( this->data_volume_ )
   {
     this->data_volume_->unregister_data();
@@ -356,28 +505,10 @@ bool DataLayer::pre_save_states( Core::StateIO& state_io )
     // Add the number to the project so it can be recorded into the session database
     ProjectManager::Instance()->get_current_project()->add_generation_number( generation_number );
     
-    std::string data_file_name = this->generation_state_->export_to_string() + ".nrrd";
-    boost::filesystem::path full_data_file_name = ProjectManager::Instance()->
-      get_current_project()->get_project_data_path() / data_file_name;
-    
-    if ( boost::filesystem::exists( full_data_file_name ) )
-    {
-      // File has already been saved
-      return true;
-    }
-      
-    bool compress = PreferencesManager::Instance()->compression_state_->get();
-    int level = PreferencesManager::Instance()->compression_level_state_->get();
-    
-    std::string error;
-    if ( ! Core::DataVolume::SaveDataVolume( full_data_file_name.string(), this->data_volume_, 
-      error, compress, level ) )
-    {
-      CORE_LOG_ERROR( error );
-      return false;   
-    }
-
-    return true;
+    // The project writes the data file once all the states of the session have been saved
+    return ProjectManager::Instance()->get_current_project()->save_data_file( 
+      generation_number, this->data_volume_->get_data_block(), 
+      this->data_volume_->get_grid_transform(), true );
   }
   
   return true;
@@ -387,12 +518,25 @@ bool DataLayer::post_load_states( const Core::StateIO& state_io )
 {
   if ( this->generation_state_->get() >= 0 )
   {
-    std::string generation = this->generation_state_->export_to_string() + ".nrrd";
-    boost::filesystem::path volume_path = ProjectManager::Instance()->get_current_project()->
-      get_project_data_path() / generation;
+    boost::filesystem::path volume_path;
     std::string error;
+    bool success = false;
     
-    if( Core::DataVolume::LoadDataVolume( volume_path, this->data_volume_, error ) )
+    if ( !ProjectManager::Instance()->get_current_project()->find_data_file( 
+      this->generation_state_->get(), volume_path ) )
+    {
+      error = "Could not find data file '" + volume_path.string() + "'.";
+    }
+    else if ( volume_path.extension().string() == Core::ChunkedVolumeFile::GetFileExtension() )
+    {
+      success = this->private_->load_chunked_volume( volume_path, error );
+    }
+    else
+    {
+      success = this->private_->load_nrrd_volume( volume_path, error );
+    }
+
+    if ( success )
     {
       this->data_volume_->register_data( this->generation_state_->get() );
       this->private_->update_data_info();
@@ -416,6 +560,9 @@ void DataLayer::clean_up()
 {
   // Abort any filter still using this layer
   this->abort_signal_();
+
+  // Stop reading the data of this layer
+  LayerDataLoader::Instance()->cancel_layer( this->get_layer_id() );
   
   // Clean up the data that is still associated with this layer
   {
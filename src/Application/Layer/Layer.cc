@@ -133,6 +133,7 @@ const std::string Layer::CREATING_C( "creating" );
 const std::string Layer::PROCESSING_C( "processing" );
 const std::string Layer::AVAILABLE_C( "available" );
 const std::string Layer::IN_USE_C( "inuse" );
+const std::string Layer::INVALID_C( "invalid" );
 
 Layer::Layer( const std::string& name, bool creating ) :
   StateHandler( "layer",  true ),
@@ -234,7 +235,7 @@ void Layer::initialize_states( const std::string& name, bool creating )
   
   // == The layer state indicating whether data is bein processed ==
   this->add_state( "data", this->data_state_,  creating ? CREATING_C : AVAILABLE_C  , 
-    AVAILABLE_C + "|" + CREATING_C + "|" + PROCESSING_C + "|" + IN_USE_C );
+    AVAILABLE_C + "|" + CREATING_C + "|" + PROCESSING_C + "|" + IN_USE_C + "|" + INVALID_C );
   this->data_state_->set_is_project_data( false );
   
   // == Centering (node vs. cell) ==
@@ -353,6 +353,8 @@ public:
   const static std::string PROCESSING_C;
   const static std::string AVAILABLE_C;
   const static std::string IN_USE_C;
+  // The data of the layer could not be read, the layer can only be deleted
+  const static std::string INVALID_C;
 };
 
 } // end namespace Seg3D
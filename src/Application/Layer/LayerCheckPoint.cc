@@ -32,14 +32,21 @@
 #include <Core/DataBlock/DataBlock.h>
 #include <Core/DataBlock/MaskDataBlock.h>
 #include <Core/DataBlock/MaskDataBlockManager.h>
+#include <Core/DataBlock/MaskDataDelta.h>
+#include <Core/Utils/Log.h>
+#include <Core/Utils/ThreadPool.h>
 
 // Application includes
 #include <Application/Provenance/Provenance.h>
 #include <Application/Layer/LayerCheckPoint.h>
+#include <Application/Layer/LayerCheckPointData.h>
 #include <Application/Layer/LayerManager.h>
+#include <Application/PreferencesManager/PreferencesManager.h>
 
 // Boost includes
 #include <boost/smart_ptr.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread/mutex.hpp>
 
 namespace Seg3D
 {
@@ -47,8 +54,32 @@ namespace Seg3D
 class LayerCheckPointPrivate : public boost::noncopyable
 {
 public:
-  // Check point consisting of a full volume
+  LayerCheckPointPrivate() :
+    volume_type_( Core::VolumeType::DATA_E ),
+    compressing_( false ),
+    edit_count_( 0 )
+  {
+  }
+
+  // RECORD_MASK_DATA_BLOCK:
+  // Remember which mask the slices were taken from and how often it had been edited
+  void record_mask_data_block( MaskLayerHandle mask );
+
+  // COMPRESS_VOLUME:
+  // Compress the volume and release it once done. This runs on the thread pool.
+  void compress_volume();
+
+  // Check point consisting of a full volume, this one is released once it has been compressed
   Core::VolumeHandle volume_;
+
+  // Compressed copy of the volume
+  LayerCheckPointDataHandle data_;
+  Core::VolumeType volume_type_;
+  Core::GridTransform grid_transform_;
+
+  // Whether the volume is being compressed
+  bool compressing_;
+  boost::mutex mutex_;
   
   // Check point consisting of a slice
   typedef std::vector<Core::DataSliceHandle> data_slice_vector_type;
@@ -56,10 +87,54 @@ public:
 
   typedef std::vector<Core::MaskDataSliceHandle> mask_slice_vector_type;
   mask_slice_vector_type mask_slices_;
+
+  // Mask block the slices were extracted from and its edit count at that time
+  Core::MaskDataBlockWeakHandle mask_data_block_;
+  size_t edit_count_;
+
+  // Once the edit has been made, the mask slices are replaced by the voxels that changed
+  typedef std::vector<Core::MaskDataDeltaHandle> mask_delta_vector_type;
+  mask_delta_vector_type mask_deltas_;
   
   ProvenanceID provenance_id_;
 };
 
+void LayerCheckPointPrivate::compress_volume()
+{
+  Core::VolumeHandle volume;
+  {
+    boost::mutex::scoped_lock lock( this->mutex_ );
+    volume = this->volume_;
+  }
+
+  LayerCheckPointDataHandle data;
+  if ( this->volume_type_ == Core::VolumeType::MASK_E )
+  {
+    data = LayerCheckPointData::CompressMask( 
+      boost::dynamic_pointer_cast<Core::MaskVolume>( volume )->get_mask_data_block() );
+  }
+  else
+  {
+    data = LayerCheckPointData::CompressData( 
+      boost::dynamic_pointer_cast<Core::DataVolume>( volume )->get_data_block() );
+  }
+
+  boost::mutex::scoped_lock lock( this->mutex_ );
+  // If compression failed the volume itself is kept
+  if ( data )
+  {
+    this->data_ = data;
+    this->volume_.reset();
+  }
+  this->compressing_ = false;
+}
+
+void LayerCheckPointPrivate::record_mask_data_block( MaskLayerHandle mask )
+{
+  Core::MaskDataBlockHandle mask_data_block = mask->get_mask_volume()->get_mask_data_block();
+  this->mask_data_block_ = mask_data_block;
+  this->edit_count_ = mask_data_block->get_edit_count();
+}
 
 LayerCheckPoint::LayerCheckPoint( LayerHandle layer ) :
   private_( new LayerCheckPointPrivate )
@@ -87,10 +162,38 @@ LayerCheckPoint::~LayerCheckPoint()
   
 bool LayerCheckPoint::apply( LayerHandle layer ) const
 {
+  Core::VolumeHandle volume;
+  LayerCheckPointDataHandle data;
+  {
+    boost::mutex::scoped_lock lock( this->private_->mutex_ );
+    volume = this->private_->volume_;
+    data = this->private_->data_;
+  }
+
+  // If the volume was compressed, restore it into a new volume
+  if ( !volume && data )
+  {
+    if ( this->private_->volume_type_ == Core::VolumeType::MASK_E )
+    {
+      Core::MaskDataBlockHandle mask_data_block;
+      if ( !data->decompress_mask( this->private_->grid_transform_, mask_data_block ) )
+      {
+        return false;
+      }
+      volume.reset( new Core::MaskVolume( this->private_->grid_transform_, mask_data_block ) );
+    }
+    else
+    {
+      Core::DataBlockHandle data_block;
+      if ( !data->decompress_data( data_block ) ) return false;
+      volume.reset( new Core::DataVolume( this->private_->grid_transform_, data_block ) );
+    }
+  }
+
   // If there is a full volume in the check point insert it into the layer
-  if ( this->private_->volume_ )
+  if ( volume )
   {
-    LayerManager::DispatchInsertVolumeIntoLayer( layer, this->private_->volume_, 
+    LayerManager::DispatchInsertVolumeIntoLayer( layer, volume, 
       this->private_->provenance_id_ );
     return true;
   }
@@ -115,6 +218,16 @@ bool LayerCheckPoint::apply( LayerHandle layer ) const
     return false;
   }
 
+  if ( !( this->private_->mask_deltas_.empty() ) )
+  {
+    MaskLayerHandle mask_layer = boost::dynamic_pointer_cast<MaskLayer>( layer );
+    if ( ! mask_layer ) return false;
+
+    LayerManager::DispatchApplyMaskDeltasToLayer( mask_layer, 
+      this->private_->mask_deltas_, this->private_->provenance_id_ );
+    return false;
+  }
+
   return false;
 }
   
@@ -123,6 +236,21 @@ bool LayerCheckPoint::create_volume( LayerHandle layer )
   this->private_->provenance_id_ = layer->provenance_id_state_->get();
 
   this->private_->volume_ = layer->get_volume();
+
+  // Compress data and mask volumes on the thread pool, until that is done the volume itself
+  // is kept
+  Core::VolumeHandle volume = this->private_->volume_;
+  if ( volume && volume->is_valid() && 
+    ( volume->get_type() == Core::VolumeType::DATA_E || 
+    volume->get_type() == Core::VolumeType::MASK_E ) &&
+    PreferencesManager::Instance()->compress_undo_state_->get() )
+  {
+    this->private_->volume_type_ = volume->get_type();
+    this->private_->grid_transform_ = volume->get_grid_transform();
+    this->private_->compressing_ = true;
+    Core::ThreadPool::Instance()->post( boost::bind( &LayerCheckPointPrivate::compress_volume,
+      this->private_ ) );
+  }
   return false;
 }
 
@@ -140,6 +268,7 @@ bool LayerCheckPoint::create_slice( LayerHandle layer, Core::SliceType type,
     if ( !( mask->get_mask_volume()->extract_slice( type, index, slice ) ) ) return false;
     
     this->private_->mask_slices_.push_back( slice );
+    this->private_->record_mask_data_block( mask );
     return true;
   }
   else if ( layer->get_type() == Core::VolumeType::DATA_E )
@@ -174,6 +303,7 @@ bool LayerCheckPoint::create_slice( LayerHandle layer, Core::SliceType type,
       if ( !( mask->get_mask_volume()->extract_slice( type, j, slice ) ) ) return false;
       
       this->private_->mask_slices_.push_back( slice );
+      this->private_->record_mask_data_block( mask );
     }
     return true;
   }
@@ -198,7 +328,12 @@ bool LayerCheckPoint::create_slice( LayerHandle layer, Core::SliceType type,
 size_t LayerCheckPoint::get_byte_size() const
 {
   size_t size = 0;
-  if ( this->private_->volume_ ) size += this->private_->volume_->get_byte_size();
+  {
+    boost::mutex::scoped_lock lock( this->private_->mutex_ );
+    // While the volume is being compressed, the volume itself is still in memory
+    if ( this->private_->volume_ ) size += this->private_->volume_->get_byte_size();
+    else if ( this->private_->data_ ) size += this->private_->data_->get_byte_size();
+  }
 
   {
     LayerCheckPointPrivate::data_slice_vector_type::iterator it = this->private_->data_slices_.begin();
@@ -220,9 +355,58 @@ size_t LayerCheckPoint::get_byte_size() const
       ++it;
     }
   }
+  {
+    LayerCheckPointPrivate::mask_delta_vector_type::iterator it = this->private_->mask_deltas_.begin();
+    LayerCheckPointPrivate::mask_delta_vector_type::iterator it_end = this->private_->mask_deltas_.end();
+
+    while ( it != it_end )
+    {
+      size += (*it)->get_byte_size();
+      ++it;
+    }
+  }
   
   return size;
 }
 
+void LayerCheckPoint::compact( LayerHandle layer )
+{
+  if ( this->private_->mask_slices_.empty() ) return;
+
+  MaskLayerHandle mask_layer = boost::dynamic_pointer_cast<MaskLayer>( layer );
+  if ( !mask_layer || !mask_layer->has_valid_data() ) return;
+
+  // The deltas are only valid against the mask the slices were taken from, and only once the
+  // edit has been made to it
+  Core::MaskDataBlockHandle mask_data_block = 
+    mask_layer->get_mask_volume()->get_mask_data_block();
+  if ( mask_data_block != this->private_->mask_data_block_.lock() ) return;
+  if ( mask_data_block->get_edit_count() == this->private_->edit_count_ ) return;
+
+  LayerCheckPointPrivate::mask_delta_vector_type deltas;
+  for ( size_t j = 0; j < this->private_->mask_slices_.size(); j++ )
+  {
+    Core::MaskDataDeltaHandle delta = Core::MaskDataDelta::Create( 
+      this->private_->mask_slices_[ j ], mask_data_block );
+    if ( !delta ) return;
+    deltas.push_back( delta );
+  }
+
+  this->private_->mask_deltas_.swap( deltas );
+  this->private_->mask_slices_.clear();
+}
+
+bool LayerCheckPoint::spill( const boost::filesystem::path& directory, std::string& error )
+{
+  boost::mutex::scoped_lock lock( this->private_->mutex_ );
+  // Do not wait for the compression to finish, the data can be spilled the next time the
+  // undo buffer runs out of memory
+  if ( this->private_->compressing_ ) return true;
+
+  // Only compressed data can be moved out of memory
+  if ( !this->private_->data_ ) return true;
+  return this->private_->data_->spill( directory, error );
+}
+
   
 } // end namespace Seg3D
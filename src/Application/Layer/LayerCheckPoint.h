@@ -32,6 +32,7 @@
 // Boost includes
 #include <boost/smart_ptr.hpp> 
 #include <boost/utility.hpp> 
+#include <boost/filesystem/path.hpp>
  
 // Core includes
 #include <Core/Volume/VolumeSlice.h>
@@ -90,9 +91,22 @@ public:
   bool create_slice( LayerHandle layer, Core::SliceType type,
     Core::DataBlock::index_type start, Core::DataBlock::index_type end );
   
+  /// COMPACT:
+  /// Replace the mask slices of the check point by deltas that only record the voxels that
+  /// changed. This needs to be called once the edit has been made to the layer and before any
+  /// other edit is made. Nothing is done if the mask has not been edited since the check point
+  /// was made.
+  void compact( LayerHandle layer );
+
   /// GET_BYTE_SIZE:
-  /// Get the size of the check point
+  /// Get the size of the check point in memory
   size_t get_byte_size() const;
+
+  /// SPILL:
+  /// Move the compressed data of a volume check point into a scratch file in the given
+  /// directory. A volume that is still being compressed is skipped, it stays in memory and
+  /// counts towards the size of the check point until it has been compressed.
+  bool spill( const boost::filesystem::path& directory, std::string& error );
   
         // -- internals --
 private:
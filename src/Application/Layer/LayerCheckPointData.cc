@@ -0,0 +1,514 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+// STL includes
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <set>
+
+// Boost includes
+#include <boost/bind.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/unordered_map.hpp>
+
+// Core includes
+#include <Core/DataBlock/StdDataBlock.h>
+#include <Core/DataBlock/MaskDataBlockManager.h>
+#include <Core/LargeVolume/LargeVolumeCodec.h>
+#include <Core/Utils/Parallel.h>
+
+// Application includes
+#include <Application/Layer/LayerCheckPointData.h>
+
+namespace Seg3D
+{
+
+// Number of bytes of uncompressed data in one chunk, a chunk of a mask covers 8 times as many
+// voxels as the bits are packed.
+static const size_t CHUNK_SIZE_C = 1 << 18;
+
+//////////////////////////////////////////////////////////////////////////
+// Class LayerCheckPointFile
+//////////////////////////////////////////////////////////////////////////
+
+// Scratch file with chunks that were moved out of memory. The file is removed when the last
+// chunk that refers to it is destroyed.
+class LayerCheckPointFile : public boost::noncopyable
+{
+public:
+  explicit LayerCheckPointFile( const boost::filesystem::path& filename ) :
+    filename_( filename )
+  {
+  }
+
+  ~LayerCheckPointFile()
+  {
+    boost::system::error_code ec;
+    boost::filesystem::remove( this->filename_, ec );
+  }
+
+  bool read( long long offset, size_t length, std::vector<char>& buffer ) const
+  {
+    std::ifstream file( this->filename_.string().c_str(), std::ios::binary );
+    if ( !file ) return false;
+    buffer.resize( length );
+    file.seekg( offset );
+    file.read( &buffer[ 0 ], length );
+    return !file.fail();
+  }
+
+  boost::filesystem::path filename_;
+};
+
+typedef boost::shared_ptr<LayerCheckPointFile> LayerCheckPointFileHandle;
+
+//////////////////////////////////////////////////////////////////////////
+// Class LayerCheckPointChunk
+//////////////////////////////////////////////////////////////////////////
+
+class LayerCheckPointChunk : public boost::noncopyable
+{
+public:
+  LayerCheckPointChunk( boost::uint64_t key, Core::DataType data_type, size_t size ) :
+    key_( key ),
+    data_type_( data_type ),
+    size_( size ),
+    offset_( 0 ),
+    length_( 0 )
+  {
+  }
+
+  ~LayerCheckPointChunk();
+
+  // Decode the chunk into size_ bytes of output
+  bool decode( char* output ) const;
+
+  // Append the encoded data to a scratch file, returns the number of bytes written
+  size_t write( std::ofstream& stream ) const;
+
+  // Release the memory once the data that was written is on disk
+  void move_to_file( const LayerCheckPointFileHandle& file, long long offset, size_t length );
+
+  // Number of bytes kept in memory
+  size_t get_byte_size() const;
+
+public:
+  // Hash of the uncompressed data
+  const boost::uint64_t key_;
+  const Core::DataType data_type_;
+
+  // Number of bytes of uncompressed data
+  const size_t size_;
+
+private:
+  friend LayerCheckPointChunkHandle CreateChunk( const char* data, size_t size, 
+    Core::DataType data_type, Core::BrickFilter filter );
+
+  mutable boost::mutex mutex_;
+
+  // Encoded data, empty once the chunk has been moved to a scratch file
+  std::vector<char> buffer_;
+
+  // Location of the encoded data in the scratch file
+  LayerCheckPointFileHandle file_;
+  long long offset_;
+  size_t length_;
+};
+
+// Index of all the chunks that exist, so check points can share chunks with the same data.
+// NOTE: The pool is never destroyed, as chunks may outlive static objects at exit.
+class LayerCheckPointChunkPool
+{
+public:
+  typedef boost::unordered_map< boost::uint64_t, boost::weak_ptr<LayerCheckPointChunk> > 
+    chunk_map_type;
+
+  boost::mutex mutex_;
+  chunk_map_type chunks_;
+};
+
+static LayerCheckPointChunkPool& GetChunkPool()
+{
+  static LayerCheckPointChunkPool* pool = new LayerCheckPointChunkPool;
+  return *pool;
+}
+
+LayerCheckPointChunk::~LayerCheckPointChunk()
+{
+  LayerCheckPointChunkPool& pool = GetChunkPool();
+  boost::mutex::scoped_lock lock( pool.mutex_ );
+  LayerCheckPointChunkPool::chunk_map_type::iterator it = pool.chunks_.find( this->key_ );
+  if ( it != pool.chunks_.end() && it->second.expired() ) pool.chunks_.erase( it );
+}
+
+bool LayerCheckPointChunk::decode( char* output ) const
+{
+  std::string error;
+  boost::mutex::scoped_lock lock( this->mutex_ );
+  if ( !this->buffer_.empty() )
+  {
+    return Core::LargeVolumeCodec::DecodeBrick( &this->buffer_[ 0 ], this->buffer_.size(), 
+      output, this->size_, this->data_type_, Core::DataBlock::IsLittleEndian(), error );
+  }
+
+  std::vector<char> buffer;
+  if ( !this->file_ || !this->file_->read( this->offset_, this->length_, buffer ) ) return false;
+  return Core::LargeVolumeCodec::DecodeBrick( &buffer[ 0 ], buffer.size(), output, this->size_, 
+    this->data_type_, Core::DataBlock::IsLittleEndian(), error );
+}
+
+size_t LayerCheckPointChunk::write( std::ofstream& stream ) const
+{
+  boost::mutex::scoped_lock lock( this->mutex_ );
+  if ( this->buffer_.empty() ) return 0;
+  stream.write( &this->buffer_[ 0 ], this->buffer_.size() );
+  return this->buffer_.size();
+}
+
+void LayerCheckPointChunk::move_to_file( const LayerCheckPointFileHandle& file, long long offset,
+  size_t length )
+{
+  boost::mutex::scoped_lock lock( this->mutex_ );
+  this->file_ = file;
+  this->offset_ = offset;
+  this->length_ = length;
+  std::vector<char>().swap( this->buffer_ );
+}
+
+size_t LayerCheckPointChunk::get_byte_size() const
+{
+  boost::mutex::scoped_lock lock( this->mutex_ );
+  return this->buffer_.size();
+}
+
+static boost::uint64_t HashChunk( const char* data, size_t size, Core::DataType data_type )
+{
+  // FNV-1a on 64 bit words
+  const boost::uint64_t prime = 1099511628211ULL;
+  boost::uint64_t hash = 14695981039346656037ULL;
+  hash = ( hash ^ static_cast<boost::uint64_t>( size ) ) * prime;
+  hash = ( hash ^ static_cast<boost::uint64_t>( static_cast<int>( data_type ) ) ) * prime;
+
+  size_t num_words = size / sizeof( boost::uint64_t );
+  for ( size_t j = 0; j < num_words; j++ )
+  {
+    boost::uint64_t word;
+    std::memcpy( &word, data + j * sizeof( boost::uint64_t ), sizeof( boost::uint64_t ) );
+    hash = ( hash ^ word ) * prime;
+  }
+  for ( size_t j = num_words * sizeof( boost::uint64_t ); j < size; j++ )
+  {
+    hash = ( hash ^ static_cast<unsigned char>( data[ j ] ) ) * prime;
+  }
+  return hash;
+}
+
+LayerCheckPointChunkHandle CreateChunk( const char* data, size_t size, 
+  Core::DataType data_type, Core::BrickFilter filter )
+{
+  boost::uint64_t key = HashChunk( data, size, data_type );
+  LayerCheckPointChunkPool& pool = GetChunkPool();
+
+  // Reuse a chunk with the same data if there is one, the data is compared as different data
+  // can have the same hash.
+  LayerCheckPointChunkHandle chunk;
+  {
+    boost::mutex::scoped_lock lock( pool.mutex_ );
+    LayerCheckPointChunkPool::chunk_map_type::iterator it = pool.chunks_.find( key );
+    if ( it != pool.chunks_.end() ) chunk = it->second.lock();
+  }
+
+  if ( chunk && chunk->data_type_ == data_type && chunk->size_ == size )
+  {
+    std::vector<char> buffer( size );
+    if ( chunk->decode( &buffer[ 0 ] ) && std::memcmp( &buffer[ 0 ], data, size ) == 0 )
+    {
+      return chunk;
+    }
+  }
+
+  chunk.reset( new LayerCheckPointChunk( key, data_type, size ) );
+  std::string error;
+  if ( !Core::LargeVolumeCodec::EncodeBrick( data, size, data_type, 
+    Core::DataBlock::IsLittleEndian(), Core::BrickCodec::LZ4_E, filter, chunk->buffer_, error ) )
+  {
+    return LayerCheckPointChunkHandle();
+  }
+  
+  // The encoder sizes its buffer for the worst case, only keep what is used
+  std::vector<char>( chunk->buffer_ ).swap( chunk->buffer_ );
+
+  {
+    boost::mutex::scoped_lock lock( pool.mutex_ );
+    LayerCheckPointChunkPool::chunk_map_type::iterator it = pool.chunks_.find( key );
+    if ( it == pool.chunks_.end() || it->second.expired() ) pool.chunks_[ key ] = chunk;
+  }
+
+  return chunk;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Chunk kernels
+//////////////////////////////////////////////////////////////////////////
+
+static void CompressDataChunks( const Core::DataBlockHandle& data_block, 
+  std::vector<LayerCheckPointChunkHandle>& chunks, size_t begin, size_t end )
+{
+  size_t byte_size = data_block->get_byte_size();
+  for ( size_t j = begin; j < end; j++ )
+  {
+    size_t start = j * CHUNK_SIZE_C;
+    Core::DataBlock::shared_lock_type lock( data_block->get_mutex() );
+    const char* data = static_cast<const char*>( data_block->get_const_data() );
+    chunks[ j ] = CreateChunk( data + start, std::min( CHUNK_SIZE_C, byte_size - start ), 
+      data_block->get_data_type(), Core::BrickFilter::SHUFFLE_E );
+  }
+}
+
+static void CompressMaskChunks( const Core::MaskDataBlockHandle& mask, 
+  std::vector<LayerCheckPointChunkHandle>& chunks, size_t begin, size_t end )
+{
+  size_t size = mask->get_size();
+  std::vector<char> bits;
+  for ( size_t j = begin; j < end; j++ )
+  {
+    size_t start = j * CHUNK_SIZE_C * 8;
+    size_t stop = std::min( start + CHUNK_SIZE_C * 8, size );
+    bits.assign( ( stop - start + 7 ) / 8, 0 );
+    {
+      Core::MaskDataBlock::shared_lock_type lock( mask->get_mutex() );
+      for ( size_t k = start; k < stop; k++ )
+      {
+        if ( mask->get_mask_at( k ) ) bits[ ( k - start ) >> 3 ] |= 1 << ( ( k - start ) & 7 );
+      }
+    }
+    chunks[ j ] = CreateChunk( &bits[ 0 ], bits.size(), Core::DataType::UCHAR_E, 
+      Core::BrickFilter::NONE_E );
+  }
+}
+
+static void DecompressDataChunks( const std::vector<LayerCheckPointChunkHandle>& chunks, 
+  char* data, std::vector<unsigned char>& success, size_t begin, size_t end )
+{
+  for ( size_t j = begin; j < end; j++ )
+  {
+    success[ j ] = chunks[ j ]->decode( data + j * CHUNK_SIZE_C );
+  }
+}
+
+static void DecompressMaskChunks( const std::vector<LayerCheckPointChunkHandle>& chunks, 
+  unsigned char* data, unsigned char mask_value, size_t size, 
+  std::vector<unsigned char>& success, size_t begin, size_t end )
+{
+  unsigned char not_mask_value = ~mask_value;
+  std::vector<char> bits;
+  for ( size_t j = begin; j < end; j++ )
+  {
+    bits.resize( chunks[ j ]->size_ );
+    success[ j ] = chunks[ j ]->decode( &bits[ 0 ] );
+    if ( !success[ j ] ) continue;
+
+    size_t start = j * CHUNK_SIZE_C * 8;
+    size_t stop = std::min( start + CHUNK_SIZE_C * 8, size );
+    for ( size_t k = start; k < stop; k++ )
+    {
+      if ( bits[ ( k - start ) >> 3 ] & ( 1 << ( ( k - start ) & 7 ) ) ) data[ k ] |= mask_value;
+      else data[ k ] &= not_mask_value;
+    }
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Class LayerCheckPointData
+//////////////////////////////////////////////////////////////////////////
+
+LayerCheckPointData::LayerCheckPointData() :
+  mask_( false ),
+  data_type_( Core::DataType::UNKNOWN_E ),
+  nx_( 0 ),
+  ny_( 0 ),
+  nz_( 0 )
+{
+}
+
+LayerCheckPointData::~LayerCheckPointData()
+{
+}
+
+LayerCheckPointDataHandle LayerCheckPointData::CompressData( 
+  const Core::DataBlockHandle& data_block )
+{
+  LayerCheckPointDataHandle data( new LayerCheckPointData );
+  data->data_type_ = data_block->get_data_type();
+  data->nx_ = data_block->get_nx();
+  data->ny_ = data_block->get_ny();
+  data->nz_ = data_block->get_nz();
+
+  size_t num_chunks = ( data_block->get_byte_size() + CHUNK_SIZE_C - 1 ) / CHUNK_SIZE_C;
+  data->chunks_.resize( num_chunks );
+  Core::Parallel::For( 0, num_chunks, boost::bind( &CompressDataChunks, 
+    boost::cref( data_block ), boost::ref( data->chunks_ ), _1, _2 ), 1 );
+
+  for ( size_t j = 0; j < num_chunks; j++ )
+  {
+    if ( !data->chunks_[ j ] ) return LayerCheckPointDataHandle();
+  }
+  return data;
+}
+
+LayerCheckPointDataHandle LayerCheckPointData::CompressMask( 
+  const Core::MaskDataBlockHandle& mask )
+{
+  LayerCheckPointDataHandle data( new LayerCheckPointData );
+  data->mask_ = true;
+  data->nx_ = mask->get_nx();
+  data->ny_ = mask->get_ny();
+  data->nz_ = mask->get_nz();
+
+  size_t num_chunks = ( mask->get_size() + CHUNK_SIZE_C * 8 - 1 ) / ( CHUNK_SIZE_C * 8 );
+  data->chunks_.resize( num_chunks );
+  Core::Parallel::For( 0, num_chunks, boost::bind( &CompressMaskChunks, 
+    boost::cref( mask ), boost::ref( data->chunks_ ), _1, _2 ), 1 );
+
+  for ( size_t j = 0; j < num_chunks; j++ )
+  {
+    if ( !data->chunks_[ j ] ) return LayerCheckPointDataHandle();
+  }
+  return data;
+}
+
+bool LayerCheckPointData::decompress_data( Core::DataBlockHandle& data_block ) const
+{
+  if ( this->mask_ ) return false;
+
+  data_block = Core::StdDataBlock::New( this->nx_, this->ny_, this->nz_, this->data_type_ );
+  if ( !data_block ) return false;
+
+  std::vector<unsigned char> success( this->chunks_.size(), 0 );
+  Core::Parallel::For( 0, this->chunks_.size(), boost::bind( &DecompressDataChunks, 
+    boost::cref( this->chunks_ ), static_cast<char*>( data_block->get_data() ), 
+    boost::ref( success ), _1, _2 ), 1 );
+
+  if ( std::find( success.begin(), success.end(), 0 ) != success.end() )
+  {
+    data_block.reset();
+    return false;
+  }
+  return true;
+}
+
+bool LayerCheckPointData::decompress_mask( const Core::GridTransform& grid_transform, 
+  Core::MaskDataBlockHandle& mask ) const
+{
+  if ( !this->mask_ ) return false;
+  if ( !Core::MaskDataBlockManager::Create( grid_transform, mask ) ) return false;
+
+  std::vector<unsigned char> success( this->chunks_.size(), 0 );
+  {
+    Core::MaskDataBlock::lock_type lock( mask->get_mutex() );
+    Core::Parallel::For( 0, this->chunks_.size(), boost::bind( &DecompressMaskChunks, 
+      boost::cref( this->chunks_ ), mask->get_mask_data(), mask->get_mask_value(), 
+      mask->get_size(), boost::ref( success ), _1, _2 ), 1 );
+  }
+
+  if ( std::find( success.begin(), success.end(), 0 ) != success.end() )
+  {
+    mask.reset();
+    return false;
+  }
+
+  mask->increase_generation();
+  return true;
+}
+
+bool LayerCheckPointData::spill( const boost::filesystem::path& directory, std::string& error )
+{
+  // Collect the chunks that are still in memory, chunks that occur more than once are
+  // written once
+  std::vector<LayerCheckPointChunkHandle> chunks;
+  std::set<LayerCheckPointChunk*> seen;
+  for ( size_t j = 0; j < this->chunks_.size(); j++ )
+  {
+    if ( this->chunks_[ j ]->get_byte_size() == 0 ) continue;
+    if ( seen.insert( this->chunks_[ j ].get() ).second ) chunks.push_back( this->chunks_[ j ] );
+  }
+  if ( chunks.empty() ) return true;
+
+  LayerCheckPointFileHandle file;
+  try
+  {
+    boost::filesystem::create_directories( directory );
+    file.reset( new LayerCheckPointFile( directory / 
+      boost::filesystem::unique_path( "checkpoint-%%%%-%%%%-%%%%.dat" ) ) );
+  }
+  catch ( ... )
+  {
+    error = "Could not create scratch directory '" + directory.string() + "'.";
+    return false;
+  }
+
+  std::vector<size_t> lengths( chunks.size() );
+  {
+    std::ofstream stream( file->filename_.string().c_str(), std::ios::binary | std::ios::trunc );
+    for ( size_t j = 0; j < chunks.size() && stream; j++ )
+    {
+      lengths[ j ] = chunks[ j ]->write( stream );
+    }
+    stream.close();
+    if ( stream.fail() )
+    {
+      error = "Could not write scratch file '" + file->filename_.string() + "'.";
+      return false;
+    }
+  }
+
+  // Only release the memory once all the data made it to disk
+  long long offset = 0;
+  for ( size_t j = 0; j < chunks.size(); j++ )
+  {
+    chunks[ j ]->move_to_file( file, offset, lengths[ j ] );
+    offset += static_cast<long long>( lengths[ j ] );
+  }
+  return true;
+}
+
+size_t LayerCheckPointData::get_byte_size() const
+{
+  size_t size = 0;
+  for ( size_t j = 0; j < this->chunks_.size(); j++ )
+  {
+    // NOTE: The chunk handle is shared by every check point that uses the chunk
+    size += this->chunks_[ j ]->get_byte_size() / this->chunks_[ j ].use_count();
+  }
+  return size;
+}
+
+} // end namespace Seg3D
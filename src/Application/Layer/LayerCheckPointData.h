@@ -0,0 +1,119 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef APPLICATION_LAYER_LAYERCHECKPOINTDATA_H 
+#define APPLICATION_LAYER_LAYERCHECKPOINTDATA_H 
+
+// STL includes
+#include <string>
+#include <vector>
+
+// Boost includes
+#include <boost/smart_ptr.hpp> 
+#include <boost/utility.hpp> 
+#include <boost/filesystem/path.hpp>
+
+// Core includes
+#include <Core/DataBlock/DataBlock.h>
+#include <Core/DataBlock/MaskDataBlock.h>
+#include <Core/Geometry/GridTransform.h>
+
+namespace Seg3D
+{
+
+class LayerCheckPointData;
+class LayerCheckPointChunk;
+
+typedef boost::shared_ptr<LayerCheckPointData> LayerCheckPointDataHandle;
+typedef boost::shared_ptr<LayerCheckPointChunk> LayerCheckPointChunkHandle;
+
+/// CLASS LAYERCHECKPOINTDATA:
+/// Compressed copy of the data of a layer that is kept for undo. The data is cut into chunks
+/// that are compressed with LZ4 in parallel. Chunks with the same contents are shared by all
+/// check points, hence a check point of a layer only adds the chunks that differ from the
+/// check points that were made of it before. To free memory the chunks can be moved into a 
+/// scratch file.
+
+class LayerCheckPointData : public boost::noncopyable
+{
+  // -- constructor / destructor -- 
+private:
+  LayerCheckPointData();
+
+public:
+  ~LayerCheckPointData();
+
+  // -- compressing data --
+public:
+  /// COMPRESSDATA:
+  /// Compress the contents of a data block. Returns an empty handle if compression failed.
+  static LayerCheckPointDataHandle CompressData( const Core::DataBlockHandle& data_block );
+
+  /// COMPRESSMASK:
+  /// Compress the bits of a mask. Returns an empty handle if compression failed.
+  static LayerCheckPointDataHandle CompressMask( const Core::MaskDataBlockHandle& mask );
+
+  // -- restoring data --
+public:
+  /// DECOMPRESS_DATA:
+  /// Restore compressed data into a new data block
+  bool decompress_data( Core::DataBlockHandle& data_block ) const;
+
+  /// DECOMPRESS_MASK:
+  /// Restore compressed mask bits into a new mask
+  bool decompress_mask( const Core::GridTransform& grid_transform, 
+    Core::MaskDataBlockHandle& mask ) const;
+
+  // -- memory management --
+public:
+  /// SPILL:
+  /// Move the chunks that are still in memory into a new scratch file in the given directory.
+  /// The file is removed when none of its chunks are in use anymore.
+  bool spill( const boost::filesystem::path& directory, std::string& error );
+
+  /// GET_BYTE_SIZE:
+  /// Get the number of bytes kept in memory. Chunks that are shared with other check points
+  /// only count for their share.
+  size_t get_byte_size() const;
+
+  // -- internals --
+private:
+  // Whether the chunks contain packed mask bits
+  bool mask_;
+
+  Core::DataType data_type_;
+  size_t nx_;
+  size_t ny_;
+  size_t nz_;
+
+  std::vector<LayerCheckPointChunkHandle> chunks_;
+};
+
+} // end namespace Seg3D
+
+#endif
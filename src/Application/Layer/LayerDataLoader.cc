@@ -0,0 +1,592 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+// STL includes
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <list>
+#include <vector>
+
+// Boost includes
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+// Core includes
+#include <Core/Action/ActionDispatcher.h>
+#include <Core/Application/Application.h>
+#include <Core/DataBlock/NrrdData.h>
+#include <Core/Utils/ConnectionHandler.h>
+#include <Core/Utils/Log.h>
+#include <Core/Utils/Parallel.h>
+#include <Core/Volume/VolumeSlice.h>
+
+// Application includes
+#include <Application/Layer/DataLayer.h>
+#include <Application/Layer/LayerDataLoader.h>
+#include <Application/Layer/LayerManager.h>
+#include <Application/Viewer/Viewer.h>
+#include <Application/ViewerManager/ViewerManager.h>
+
+namespace Seg3D
+{
+
+// Time to wait before checking again whether the user is idle, in milliseconds
+static const int YIELD_TIME_C = 100;
+
+// Minimum time between progress updates of a layer, in milliseconds
+static const int UPDATE_TIME_C = 250;
+
+//////////////////////////////////////////////////////////////////////////
+// Class LayerLoadJob
+//////////////////////////////////////////////////////////////////////////
+
+class LayerLoadJob;
+typedef boost::shared_ptr< LayerLoadJob > LayerLoadJobHandle;
+
+// A layer of which the data is being read
+class LayerLoadJob
+{
+public:
+  LayerLoadJob() :
+    num_loaded_( 0 ),
+    next_chunk_( 0 ),
+    urgent_( false ),
+    cancelled_( false )
+  {
+  }
+
+  // READ_CHUNKS:
+  // Read chunks of the file into the data block. A NRRD file is read as a single chunk.
+  bool read_chunks( const std::vector< size_t >& chunks, std::string& error );
+
+  // GET_SLICE_CHUNKS:
+  // Get the chunks that hold a slice of the data.
+  void get_slice_chunks( Core::SliceType type, size_t slice, std::vector< size_t >& chunks );
+
+  std::string layer_id_;
+  Core::DataBlockHandle data_block_;
+
+  // The file is either a chunked volume file or a NRRD file
+  Core::ChunkedVolumeFileHandle file_;
+  boost::filesystem::path nrrd_file_;
+
+  // Chunks that have been read
+  std::vector< bool > loaded_;
+  size_t num_loaded_;
+
+  // Next chunk to read when the chunks are read in order
+  size_t next_chunk_;
+
+  // Chunks of slices shown in the viewers, these are read before anything else
+  std::deque< size_t > priority_chunks_;
+
+  // Whether the layer is needed and is read without yielding to the user
+  bool urgent_;
+
+  bool cancelled_;
+
+  // Time the layer was last updated
+  boost::posix_time::ptime last_update_;
+};
+
+bool LayerLoadJob::read_chunks( const std::vector< size_t >& chunks, std::string& error )
+{
+  if ( this->file_ ) return this->file_->read_chunks( chunks, this->data_block_, error );
+
+  size_t data_size = this->data_block_->get_byte_size();
+  char* data = reinterpret_cast< char* >( this->data_block_->get_data() );
+
+  // Raw data is read straight into the data block
+  boost::filesystem::path data_file;
+  long long offset = 0;
+  if ( Core::NrrdData::FindRawData( this->nrrd_file_.string(), data_size, data_file, offset ) )
+  {
+    std::ifstream file( data_file.string().c_str(), std::ios_base::in | std::ios_base::binary );
+    file.seekg( offset );
+    file.read( data, data_size );
+    if ( !file )
+    {
+      error = "Could not read file '" + data_file.string() + "'.";
+      return false;
+    }
+    return true;
+  }
+
+  // Other files are decoded by Teem and copied
+  Core::NrrdDataHandle nrrd;
+  if ( !Core::NrrdData::LoadNrrd( this->nrrd_file_.string(), nrrd, error ) ) return false;
+  if ( nrrd->get_data_type() != this->data_block_->get_data_type() ||
+    nrrd->get_size() != this->data_block_->get_size() )
+  {
+    error = "File '" + this->nrrd_file_.string() + "' changed while it was being read.";
+    return false;
+  }
+  std::memcpy( data, nrrd->get_data(), data_size );
+  return true;
+}
+
+void LayerLoadJob::get_slice_chunks( Core::SliceType type, size_t slice, 
+  std::vector< size_t >& chunks )
+{
+  if ( this->file_ ) this->file_->get_slice_chunks( type, slice, chunks );
+  else chunks.push_back( 0 );
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Class LayerDataLoaderPrivate
+//////////////////////////////////////////////////////////////////////////
+
+class LayerDataLoaderPrivate : public Core::ConnectionHandler
+{
+public:
+  LayerDataLoaderPrivate() :
+    running_( false ),
+    stopping_( false )
+  {
+  }
+
+  ~LayerDataLoaderPrivate()
+  {
+    this->disconnect_all();
+  }
+
+  // RUN:
+  // Read chunks until the loader is stopped. This function runs on its own thread.
+  void run();
+
+  // STOP:
+  // Cancel all the jobs and wait for the thread to finish. This is called when the
+  // application stops.
+  void stop();
+
+  // SELECT_CHUNKS:
+  // Select the job and chunks to read next. Returns an empty handle if nothing should be read
+  // until the user is idle. Refresh is set if the chunks are shown in a viewer.
+  // NOTE: The mutex needs to be locked.
+  LayerLoadJobHandle select_chunks( std::vector< size_t >& chunks, bool& refresh );
+
+  // FIND_JOB:
+  // Find the job of a layer.
+  // NOTE: The mutex needs to be locked.
+  LayerLoadJobHandle find_job( const std::string& layer_id );
+
+  // ADD_JOB:
+  // Replace the job of the layer, if any, and start reading.
+  void add_job( LayerLoadJobHandle job );
+
+  // HANDLE_ACTIVE_LAYER_CHANGED:
+  // The active layer is read first, as it is the layer that the user is about to work on.
+  void handle_active_layer_changed( LayerHandle layer );
+
+  // HANDLECHUNKSLOADED:
+  // Update the layer once chunks have been read. This function runs on the application thread.
+  static void HandleChunksLoaded( std::string layer_id, Core::DataBlockHandle data_block, 
+    double progress, bool refresh, bool done );
+
+  // HANDLELOADFAILED:
+  // Mark a layer as invalid and tell the user, as its data could not be read. This function
+  // runs on the application thread.
+  static void HandleLoadFailed( std::string layer_id, Core::DataBlockHandle data_block, 
+    std::string error );
+
+  LayerDataLoader* loader_;
+
+  std::list< LayerLoadJobHandle > jobs_;
+  boost::mutex mutex_;
+  boost::condition_variable jobs_changed_;
+
+  // The thread that reads the chunks
+  boost::thread thread_;
+  bool running_;
+
+  // Set when the application stops, no chunks are read anymore
+  bool stopping_;
+};
+
+void LayerDataLoaderPrivate::run()
+{
+  boost::mutex::scoped_lock lock( this->mutex_ );
+  while ( !this->stopping_ )
+  {
+    if ( this->jobs_.empty() )
+    {
+      this->jobs_changed_.wait( lock );
+      continue;
+    }
+
+    std::vector< size_t > chunks;
+    bool refresh = false;
+    LayerLoadJobHandle job = this->select_chunks( chunks, refresh );
+    if ( !job )
+    {
+      // Yield to the user and check again in a little while
+      this->jobs_changed_.timed_wait( lock, boost::posix_time::milliseconds( YIELD_TIME_C ) );
+      continue;
+    }
+
+    std::string error;
+    bool success = false;
+    lock.unlock();
+    {
+      Core::DataBlock::lock_type data_lock( job->data_block_->get_mutex() );
+      success = job->read_chunks( chunks, error );
+    }
+    lock.lock();
+
+    if ( job->cancelled_ ) continue;
+
+    // The data of the layer is incomplete, so it cannot be used
+    if ( !success )
+    {
+      this->jobs_.remove( job );
+      Core::Application::PostEvent( boost::bind( &LayerDataLoaderPrivate::HandleLoadFailed,
+        job->layer_id_, job->data_block_, error ) );
+      continue;
+    }
+
+    for ( size_t j = 0; j < chunks.size(); j++ )
+    {
+      if ( !job->loaded_[ chunks[ j ] ] )
+      {
+        job->loaded_[ chunks[ j ] ] = true;
+        job->num_loaded_++;
+      }
+    }
+
+    bool done = job->num_loaded_ == job->loaded_.size();
+    if ( done ) this->jobs_.remove( job );
+
+    boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+    if ( refresh || done || 
+      now - job->last_update_ > boost::posix_time::milliseconds( UPDATE_TIME_C ) )
+    {
+      job->last_update_ = now;
+      double progress = static_cast< double >( job->num_loaded_ ) / job->loaded_.size();
+      Core::Application::PostEvent( boost::bind( &LayerDataLoaderPrivate::HandleChunksLoaded,
+        job->layer_id_, job->data_block_, progress, refresh, done ) );
+    }
+  }
+}
+
+void LayerDataLoaderPrivate::stop()
+{
+  {
+    boost::mutex::scoped_lock lock( this->mutex_ );
+    std::list< LayerLoadJobHandle >::iterator it = this->jobs_.begin();
+    for ( ; it != this->jobs_.end(); ++it ) ( *it )->cancelled_ = true;
+    this->jobs_.clear();
+    this->stopping_ = true;
+    this->jobs_changed_.notify_all();
+  }
+
+  // NOTE: The thread finishes the chunks it is reading, it does not wait for anything else
+  if ( this->thread_.joinable() ) this->thread_.join();
+}
+
+LayerLoadJobHandle LayerDataLoaderPrivate::select_chunks( std::vector< size_t >& chunks,
+  bool& refresh )
+{
+  size_t num_threads = static_cast< size_t >( Core::Parallel::GetNumThreads() );
+
+  // Chunks of slices that are shown come first
+  std::list< LayerLoadJobHandle >::iterator it = this->jobs_.begin();
+  for ( ; it != this->jobs_.end(); ++it )
+  {
+    LayerLoadJobHandle job = *it;
+    while ( !job->priority_chunks_.empty() )
+    {
+      size_t chunk = job->priority_chunks_.front();
+      job->priority_chunks_.pop_front();
+      if ( !job->loaded_[ chunk ] ) chunks.push_back( chunk );
+    }
+
+    if ( !chunks.empty() )
+    {
+      refresh = true;
+      return job;
+    }
+  }
+
+  // Layers that are needed are read next, other layers wait until the user is idle
+  LayerLoadJobHandle job;
+  size_t batch_size = 8 * num_threads;
+  for ( it = this->jobs_.begin(); it != this->jobs_.end() && !job; ++it )
+  {
+    if ( ( *it )->urgent_ ) job = *it;
+  }
+
+  if ( !job )
+  {
+    // A paint stroke is a single action that runs while the mouse is pressed, hence the
+    // viewers need to be checked as well as the action dispatcher.
+    if ( Core::ActionDispatcher::Instance()->is_busy() || 
+      ViewerManager::Instance()->is_busy() )
+    {
+      return LayerLoadJobHandle();
+    }
+
+    job = this->jobs_.front();
+    batch_size = 2 * num_threads;
+  }
+
+  while ( chunks.size() < batch_size && job->next_chunk_ < job->loaded_.size() )
+  {
+    if ( !job->loaded_[ job->next_chunk_ ] ) chunks.push_back( job->next_chunk_ );
+    job->next_chunk_++;
+  }
+  
+  return job;
+}
+
+LayerLoadJobHandle LayerDataLoaderPrivate::find_job( const std::string& layer_id )
+{
+  std::list< LayerLoadJobHandle >::iterator it = this->jobs_.begin();
+  for ( ; it != this->jobs_.end(); ++it )
+  {
+    if ( ( *it )->layer_id_ == layer_id ) return *it;
+  }
+  return LayerLoadJobHandle();
+}
+
+void LayerDataLoaderPrivate::add_job( LayerLoadJobHandle job )
+{
+  if ( job->loaded_.empty() )
+  {
+    Core::Application::PostEvent( boost::bind( &LayerDataLoaderPrivate::HandleChunksLoaded,
+      job->layer_id_, job->data_block_, 1.0, true, true ) );
+    return;
+  }
+
+  {
+    boost::mutex::scoped_lock lock( this->mutex_ );
+    LayerLoadJobHandle old_job = this->find_job( job->layer_id_ );
+    if ( old_job )
+    {
+      old_job->cancelled_ = true;
+      this->jobs_.remove( old_job );
+    }
+    if ( this->stopping_ ) return;
+    this->jobs_.push_back( job );
+
+    if ( !this->running_ )
+    {
+      this->thread_ = boost::thread( boost::bind( &LayerDataLoaderPrivate::run, this ) );
+      this->running_ = true;
+    }
+    this->jobs_changed_.notify_all();
+  }
+
+  // The viewers show the layer once the session has been loaded completely
+  Core::Application::PostEvent( boost::bind( &LayerDataLoader::request_visible_slices, 
+    this->loader_ ) );
+}
+
+void LayerDataLoaderPrivate::handle_active_layer_changed( LayerHandle layer )
+{
+  if ( layer ) this->loader_->request_layer( layer->get_layer_id() );
+}
+
+void LayerDataLoaderPrivate::HandleChunksLoaded( std::string layer_id, 
+  Core::DataBlockHandle data_block, double progress, bool refresh, bool done )
+{
+  // Make sure the layer still holds the data block that was read
+  LayerHandle layer = LayerManager::FindLayer( layer_id );
+  DataLayer* data_layer = dynamic_cast< DataLayer* >( layer.get() );
+  if ( !data_layer || !data_layer->get_data_volume() || 
+    data_layer->get_data_volume()->get_data_block() != data_block )
+  {
+    return;
+  }
+
+  if ( refresh || done )
+  {
+    data_block->data_changed_signal_();
+    layer->layer_updated_signal_();
+  }
+
+  if ( done )
+  {
+    // Actions that are waiting for the layer are notified through its data state
+    if ( layer->data_state_->get() == Layer::PROCESSING_C )
+    {
+      layer->data_state_->set( Layer::AVAILABLE_C );
+    }
+  }
+  else
+  {
+    layer->update_progress_signal_( progress );
+  }
+}
+
+void LayerDataLoaderPrivate::HandleLoadFailed( std::string layer_id, 
+  Core::DataBlockHandle data_block, std::string error )
+{
+  // Make sure the layer still holds the data block that was read
+  LayerHandle layer = LayerManager::FindLayer( layer_id );
+  DataLayer* data_layer = dynamic_cast< DataLayer* >( layer.get() );
+  if ( !data_layer || !data_layer->get_data_volume() || 
+    data_layer->get_data_volume()->get_data_block() != data_block )
+  {
+    return;
+  }
+
+  CORE_LOG_CRITICAL_ERROR( "Could not read the data of layer '" + layer->get_layer_name() + 
+    "': " + error + " The layer cannot be used and should be deleted." );
+
+  // Actions that are waiting for the layer are notified through its data state and fail
+  layer->data_state_->set( Layer::INVALID_C );
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Class LayerDataLoader
+//////////////////////////////////////////////////////////////////////////
+
+CORE_SINGLETON_IMPLEMENTATION( LayerDataLoader );
+
+LayerDataLoader::LayerDataLoader() :
+  private_( new LayerDataLoaderPrivate )
+{
+  this->private_->loader_ = this;
+
+  // Slices that are brought into view are read first
+  for ( size_t j = 0; j < ViewerManager::Instance()->number_of_viewers(); j++ )
+  {
+    ViewerHandle viewer = ViewerManager::Instance()->get_viewer( j );
+    this->private_->add_connection( viewer->slice_number_state_->state_changed_signal_.connect(
+      boost::bind( &LayerDataLoader::request_visible_slices, this ) ) );
+    this->private_->add_connection( viewer->view_mode_state_->state_changed_signal_.connect(
+      boost::bind( &LayerDataLoader::request_visible_slices, this ) ) );
+    this->private_->add_connection( viewer->viewer_visible_state_->state_changed_signal_.connect(
+      boost::bind( &LayerDataLoader::request_visible_slices, this ) ) );
+  }
+
+  this->private_->add_connection( LayerManager::Instance()->active_layer_changed_signal_.connect(
+    boost::bind( &LayerDataLoaderPrivate::handle_active_layer_changed, this->private_, _1 ) ) );
+
+  // The thread needs to be finished before the data blocks and files are destroyed
+  this->private_->add_connection( Core::Application::Instance()->application_stop_signal_.
+    connect( boost::bind( &LayerDataLoaderPrivate::stop, this->private_ ) ) );
+}
+
+LayerDataLoader::~LayerDataLoader()
+{
+  this->private_->stop();
+}
+
+void LayerDataLoader::load_layer( const std::string& layer_id, 
+  Core::ChunkedVolumeFileHandle file, Core::DataBlockHandle data_block )
+{
+  LayerLoadJobHandle job( new LayerLoadJob );
+  job->layer_id_ = layer_id;
+  job->file_ = file;
+  job->data_block_ = data_block;
+  job->loaded_.resize( file->get_num_chunks(), false );
+  this->private_->add_job( job );
+}
+
+void LayerDataLoader::load_layer( const std::string& layer_id, 
+  const boost::filesystem::path& nrrd_file, Core::DataBlockHandle data_block )
+{
+  LayerLoadJobHandle job( new LayerLoadJob );
+  job->layer_id_ = layer_id;
+  job->nrrd_file_ = nrrd_file;
+  job->data_block_ = data_block;
+  job->loaded_.resize( 1, false );
+  this->private_->add_job( job );
+}
+
+void LayerDataLoader::request_layer( const std::string& layer_id )
+{
+  boost::mutex::scoped_lock lock( this->private_->mutex_ );
+  LayerLoadJobHandle job = this->private_->find_job( layer_id );
+  if ( job && !job->urgent_ )
+  {
+    job->urgent_ = true;
+    this->private_->jobs_changed_.notify_all();
+  }
+}
+
+void LayerDataLoader::request_visible_slices()
+{
+  ASSERT_IS_APPLICATION_THREAD();
+
+  std::list< LayerLoadJobHandle > jobs;
+  {
+    boost::mutex::scoped_lock lock( this->private_->mutex_ );
+    jobs = this->private_->jobs_;
+  }
+  if ( jobs.empty() ) return;
+
+  std::list< LayerLoadJobHandle >::iterator it = jobs.begin();
+  for ( ; it != jobs.end(); ++it )
+  {
+    LayerLoadJobHandle job = *it;
+    LayerHandle layer = LayerManager::FindLayer( job->layer_id_ );
+    if ( !layer || !layer->master_visible_state_->get() ) continue;
+
+    std::vector< size_t > chunks;
+    for ( size_t j = 0; j < ViewerManager::Instance()->number_of_viewers(); j++ )
+    {
+      ViewerHandle viewer = ViewerManager::Instance()->get_viewer( j );
+      if ( !viewer->viewer_visible_state_->get() || viewer->is_volume_view() ||
+        !layer->visible_state_[ j ]->get() )
+      {
+        continue;
+      }
+
+      Core::VolumeSliceHandle volume_slice = viewer->get_volume_slice( job->layer_id_ );
+      if ( !volume_slice || volume_slice->out_of_boundary() ) continue;
+
+      std::vector< size_t > slice_chunks;
+      job->get_slice_chunks( volume_slice->get_slice_type(), 
+        volume_slice->get_slice_number(), slice_chunks );
+      chunks.insert( chunks.end(), slice_chunks.begin(), slice_chunks.end() );
+    }
+
+    if ( chunks.empty() ) continue;
+
+    boost::mutex::scoped_lock lock( this->private_->mutex_ );
+    job->priority_chunks_.insert( job->priority_chunks_.begin(), chunks.begin(), chunks.end() );
+    this->private_->jobs_changed_.notify_all();
+  }
+}
+
+void LayerDataLoader::cancel_layer( const std::string& layer_id )
+{
+  boost::mutex::scoped_lock lock( this->private_->mutex_ );
+  LayerLoadJobHandle job = this->private_->find_job( layer_id );
+  if ( job )
+  {
+    job->cancelled_ = true;
+    this->private_->jobs_.remove( job );
+  }
+}
+
+} // end namespace Seg3D
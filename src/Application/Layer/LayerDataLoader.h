@@ -0,0 +1,104 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef APPLICATION_LAYER_LAYERDATALOADER_H
+#define APPLICATION_LAYER_LAYERDATALOADER_H
+
+// STL includes
+#include <string>
+
+// Boost includes
+#include <boost/smart_ptr.hpp>
+#include <boost/filesystem/path.hpp>
+
+// Core includes
+#include <Core/Utils/Singleton.h>
+#include <Core/DataBlock/DataBlock.h>
+#include <Core/LargeVolume/ChunkedVolumeFile.h>
+
+namespace Seg3D
+{
+
+class LayerDataLoader;
+class LayerDataLoaderPrivate;
+typedef boost::shared_ptr< LayerDataLoaderPrivate > LayerDataLoaderPrivateHandle;
+
+// CLASS LAYERDATALOADER:
+/// Reads the data of layers from chunked volume files and NRRD files in the background. When a
+/// session is loaded the data layers get an empty data block and are marked as processing, so
+/// the session can be used right away. The chunks of the slices that are shown in the viewers
+/// are read first, the remainder of the data is read while no actions are running and the mouse
+/// is not pressed in any of the viewers. A layer that is needed by an action, or that is made
+/// the active layer, is read before any other layer without waiting for the user. NRRD files
+/// are not split in chunks, hence they are read as a whole.
+
+class LayerDataLoader : public boost::noncopyable
+{
+  CORE_SINGLETON( LayerDataLoader );
+
+  // -- Constructor/Destructor --
+private:
+  LayerDataLoader();
+  virtual ~LayerDataLoader();
+
+  // -- Loading layers --
+public:
+  /// LOAD_LAYER:
+  /// Read the chunks of a file into the data block of a layer in the background. The data block
+  /// needs to have the size and type of the file. The layer is set to available once all the 
+  /// chunks have been read.
+  void load_layer( const std::string& layer_id, Core::ChunkedVolumeFileHandle file,
+    Core::DataBlockHandle data_block );
+
+  /// LOAD_LAYER:
+  /// Read a NRRD file into the data block of a layer in the background. The file is read as a
+  /// whole, once the user is idle or as soon as the layer is shown or needed.
+  void load_layer( const std::string& layer_id, const boost::filesystem::path& nrrd_file,
+    Core::DataBlockHandle data_block );
+
+  /// REQUEST_LAYER:
+  /// Read the remainder of a layer before any other layer, without yielding to the user.
+  /// This function is called when the data of a layer that is still being read is needed.
+  void request_layer( const std::string& layer_id );
+
+  /// REQUEST_VISIBLE_SLICES:
+  /// Read the chunks of the slices of the layers that are shown in the viewers first.
+  /// NOTE: This function needs to be called on the application thread.
+  void request_visible_slices();
+
+  /// CANCEL_LAYER:
+  /// Stop reading the data of a layer, as the layer is being deleted.
+  void cancel_layer( const std::string& layer_id );
+
+private:
+  LayerDataLoaderPrivateHandle private_;
+};
+
+} // end namespace Seg3D
+
+#endif
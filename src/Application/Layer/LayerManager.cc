@@ -36,6 +36,7 @@
 #include <Core/State/StateIO.h>
 #include <Core/Utils/ScopedCounter.h>
 #include <Core/Utils/Exception.h>
+#include <Core/Utils/Log.h>
 
 // Application includes
 #include <Application/Layer/LayerGroup.h>
@@ -44,6 +45,7 @@
 #include <Application/Layer/DataLayer.h>
 #include <Application/Layer/LayerScene.h>
 #include <Application/Layer/LayerAvailabilityNotifier.h>
+#include <Application/Layer/LayerDataLoader.h>
 #include <Application/Layer/LayerManager.h>
 #include <Application/ProjectManager/ProjectManager.h>
 #include <Application/PreferencesManager/PreferencesManager.h>
@@ -1391,8 +1393,18 @@ bool LayerManager::CheckLayerAvailabilityForProcessing( const std::string& layer
   {
     return true;
   }
+  else if ( layer_state == Layer::INVALID_C )
+  {
+    // The layer will never become available, so do not wait for it
+    context->report_error( "The data of layer '" + layer->get_layer_name() + 
+      "' could not be read." );
+    return false;
+  }
   else
   {
+    // A layer of which the data is still being read is read before any other layer
+    LayerDataLoader::Instance()->request_layer( layer_id );
+
     // This notifier will inform the calling process when the layer will be available again.
     Core::NotifierHandle notifier = Core::NotifierHandle( 
       new LayerAvailabilityNotifier( layer ) );
@@ -1429,8 +1441,18 @@ bool LayerManager::CheckLayerAvailabilityForUse( const std::string& layer_id,
   {
     return true;
   }
+  else if ( layer_state == Layer::INVALID_C )
+  {
+    // The layer will never become available, so do not wait for it
+    context->report_error( "The data of layer '" + layer->get_layer_name() + 
+      "' could not be read." );
+    return false;
+  }
   else
   {
+    // A layer of which the data is still being read is read before any other layer
+    LayerDataLoader::Instance()->request_layer( layer_id );
+
     // This notifier will inform the calling process when the layer will be available again.
     Core::NotifierHandle notifier = Core::NotifierHandle( 
       new LayerAvailabilityNotifier( layer ) );
@@ -1939,6 +1961,46 @@ void LayerManager::DispatchInsertMaskSlicesIntoLayer( MaskLayerHandle layer,
   }
 }
 
+void LayerManager::DispatchApplyMaskDeltasToLayer( MaskLayerHandle layer,
+    std::vector<Core::MaskDataDeltaHandle> deltas, ProvenanceID prov_id, 
+    filter_key_type key, SandboxID sandbox )
+{
+  // Move this request to the Application thread
+  if ( !( Core::Application::IsApplicationThread() ) )
+  {
+    Core::Application::PostEvent( boost::bind( 
+      &LayerManager::DispatchApplyMaskDeltasToLayer, layer, deltas, prov_id, key, sandbox ) );
+    return;
+  }
+  
+  // Only do work if the unique key is a match
+  if ( layer->check_filter_key( key ) )
+  {
+    Core::MaskVolumeHandle mask_volume = layer->get_mask_volume();
+    if ( !mask_volume ) return;
+    
+    std::vector<Core::MaskDataDeltaHandle>::iterator it = deltas.begin();
+    std::vector<Core::MaskDataDeltaHandle>::iterator it_end = deltas.end();
+  
+    while( it != it_end )
+    {
+      if ( !( (*it)->apply( mask_volume->get_mask_data_block() ) ) )
+      {
+        CORE_LOG_ERROR( "Mask delta does not match the dimensions of layer '" + 
+          layer->get_layer_name() + "'" );
+      }
+      ++it; 
+    }
+  
+    layer->provenance_id_state_->set( prov_id );
+    if ( sandbox == -1 )
+    {
+      LayerManager::Instance()->layer_volume_changed_signal_( layer );
+      LayerManager::Instance()->layers_changed_signal_();
+    }
+  }
+}
+
 LayerManager::id_count_type LayerManager::GetLayerIdCount()
 {
   id_count_type id_count;
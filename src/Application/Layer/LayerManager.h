@@ -41,6 +41,7 @@
 #include <Core/Utils/Singleton.h>
 #include <Core/Volume/Volume.h>
 #include <Core/Geometry/BBox.h>
+#include <Core/DataBlock/MaskDataDelta.h>
 
 // Application includes
 #include <Application/Layer/Layer.h>
@@ -565,6 +566,12 @@ public:
     std::vector<Core::MaskDataSliceHandle> mask, ProvenanceID provid, 
     filter_key_type key = filter_key_type( 0 ), SandboxID sandbox = -1 );
 
+  /// DISPATCHAPPLYMASKDELTASTOLAYER:
+  /// Flip the voxels recorded in mask deltas in a mask layer.
+  static void DispatchApplyMaskDeltasToLayer( MaskLayerHandle layer,
+    std::vector<Core::MaskDataDeltaHandle> deltas, ProvenanceID provid, 
+    filter_key_type key = filter_key_type( 0 ), SandboxID sandbox = -1 );
+
   // -- functions for obtaining the current layer and group id counters --
   typedef std::vector<int> id_count_type;
   
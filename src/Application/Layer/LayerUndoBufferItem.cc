@@ -26,6 +26,9 @@
  DEALINGS IN THE SOFTWARE.
  */
 
+// Core includes
+#include <Core/Utils/Log.h>
+
 // Application includes
 #include <Application/Layer/LayerGroup.h>
 #include <Application/Layer/LayerUndoBufferItem.h>
@@ -364,6 +367,33 @@ void LayerUndoBufferItem::compute_size()
   this->private_->size_ = size;
 }
 
+void LayerUndoBufferItem::compact()
+{
+  // When the next item is inserted the edit of this item has been made, and the mask slices
+  // can be replaced by the voxels that changed. Later on other edits may have been made.
+  for ( size_t j = 0; j < this->private_->layers_to_restore_.size(); j++ )
+  {
+    this->private_->layers_to_restore_[ j ].second->compact( 
+      this->private_->layers_to_restore_[ j ].first );
+  }
+}
+
+bool LayerUndoBufferItem::spill( const boost::filesystem::path& directory )
+{
+  for ( size_t j = 0; j < this->private_->layers_to_restore_.size(); j++ )
+  {
+    std::string error;
+    if ( !this->private_->layers_to_restore_[ j ].second->spill( directory, error ) )
+    {
+      CORE_LOG_ERROR( error );
+      return false;
+    }
+  }
+
+  this->compute_size();
+  return true;
+}
+
 void LayerUndoBufferItem::add_id_count_to_restore( LayerManager::id_count_type id_count )
 {
     this->private_->id_count_ = id_count;
@@ -116,6 +116,14 @@ public:
   /// Compute the size of the item
   virtual void compute_size();
 
+  /// SPILL:
+  /// Move the compressed check points out of memory into scratch files
+  virtual bool spill( const boost::filesystem::path& directory );
+
+  /// COMPACT:
+  /// Replace the mask slices of the check points by the voxels that the edit changed
+  virtual void compact();
+
   // -- internals --
 private:
   LayerUndoBufferItemPrivateHandle private_;
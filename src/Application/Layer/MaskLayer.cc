@@ -33,6 +33,7 @@
 // Core includes
 #include <Core/Application/Application.h>
 #include <Core/DataBlock/MaskDataBlockManager.h>
+#include <Core/DataBlock/MaskDataBlockOperations.h>
 #include <Core/Utils/AtomicCounter.h>
 #include <Core/Utils/StringUtil.h>
 #include <Core/Utils/Log.h>
@@ -54,6 +55,8 @@ class MaskLayerPrivate
 public:
   void initialize_states();
   void handle_mask_data_changed();
+  void handle_data_state_changed( std::string data_state );
+  void sparsify_mask();
   void handle_isosurface_update_progress( double progress );
   void update_mask_info();
 
@@ -127,6 +130,25 @@ void MaskLayerPrivate::handle_mask_data_changed()
   this->layer_->layer_updated_signal_();
 }
 
+void MaskLayerPrivate::handle_data_state_changed( std::string data_state )
+{
+  if ( data_state == Layer::AVAILABLE_C ) this->sparsify_mask();
+}
+
+void MaskLayerPrivate::sparsify_mask()
+{
+  // NOTE: Moving the mask out of its bitplane invalidates pointers into the bitplane, hence
+  // this is only done on the application thread once no filter or tool uses the layer.
+  if ( !Core::Application::IsApplicationThread() ) return;
+  if ( !this->mask_volume_ || !PreferencesManager::Instance()->sparse_masks_state_->get() ||
+    this->layer_->data_state_->get() != Layer::AVAILABLE_C )
+  {
+    return;
+  }
+
+  this->mask_volume_->get_mask_data_block()->sparsify();
+}
+
 void MaskLayerPrivate::handle_isosurface_update_progress( double progress )
 {
   this->layer_->update_progress_signal_( progress );
@@ -274,6 +296,12 @@ bool MaskLayer::set_mask_volume( Core::MaskVolumeHandle volume )
 
       this->add_connection( this->private_->mask_volume_->get_mask_data_block()->mask_updated_signal_.
         connect( boost::bind( &MaskLayerPrivate::handle_mask_data_changed, this->private_ ) ) );
+
+      // Once the filter that generated the mask releases the layer, the mask can be moved out
+      // of its bitplane. It is moved back as soon as a filter or tool needs the bitplane.
+      this->add_connection( this->data_state_->value_changed_signal_.connect( boost::bind( 
+        &MaskLayerPrivate::handle_data_state_changed, this->private_, _1 ) ) );
+      this->private_->sparsify_mask();
     }
 
     this->private_->update_mask_info();
@@ -284,36 +312,47 @@ bool MaskLayer::set_mask_volume( Core::MaskVolumeHandle volume )
 
 bool MaskLayer::pre_save_states( Core::StateIO& state_io )
 {
+  Core::MaskDataBlockHandle mask_data_block = this->get_mask_volume()->get_mask_data_block();
   long long generation_number = this->get_mask_volume()->get_generation();
-  this->generation_state_->set( generation_number );
-
-  // Add the number to the project so it can be recorded into the session database
-  ProjectManager::Instance()->get_current_project()->add_generation_number( generation_number );
   
-  boost::filesystem::path data_file = ProjectManager::Instance()->get_current_project()->
-    get_project_data_path() / ( this->generation_state_->export_to_string() + ".nrrd" );
-  if ( boost::filesystem::exists( data_file ) )
+  // NOTE: A sparse mask keeps the generation number of the datablock it was stored in. If that
+  // datablock has not been saved, the mask needs to be moved back into a datablock, which
+  // gives it a new generation number and bit.
+  ProjectHandle project = ProjectManager::Instance()->get_current_project();
+  boost::filesystem::path data_file;
+  bool file_exists = project->find_data_file( generation_number, data_file );
+  if ( mask_data_block->is_sparse() && !file_exists )
   {
-    // File has already been saved
-    return true;
+    mask_data_block->densify();
+    generation_number = this->get_mask_volume()->get_generation();
+    file_exists = project->find_data_file( generation_number, data_file );
   }
-  
-  bool compress = PreferencesManager::Instance()->compression_state_->get();
-  int level = PreferencesManager::Instance()->compression_level_state_->get();
 
-  Core::DataBlockHandle data_block = this->get_mask_volume()->
-    get_mask_data_block()->get_data_block();
-  Core::NrrdDataHandle nrrd( new Core::NrrdData( data_block, this->get_grid_transform() ) );
+  this->generation_state_->set( generation_number );
+  if ( !mask_data_block->is_sparse() )
+  {
+    this->private_->bit_state_->set( static_cast< int >( mask_data_block->get_mask_bit() ) );
+  }
 
-  std::string error;
-  Core::DataBlock::shared_lock_type slock( data_block->get_mutex() );
-  if ( !Core::NrrdData::SaveNrrd( data_file.string(), nrrd, error, compress, level ) )
+  // Add the number to the project so it can be recorded into the session database
+  project->add_generation_number( generation_number );
+
+  // NOTE: The datablock is only accessed if its file needs to be written, as that moves a 
+  // sparse mask back into a bitplane.
+  if ( file_exists ) return true;
+  
+  // The project writes the data file once all the states of the session have been saved.
+  // NOTE: The masks write directly into the memory of their data block, hence the file is
+  // written from a copy that is not affected by edits made while the session is saved.
+  Core::DataBlockHandle data_block;
+  if ( !Core::DataBlock::Duplicate( mask_data_block->get_data_block(), data_block ) )
   {
-    CORE_LOG_ERROR( error );
+    CORE_LOG_ERROR( "Could not copy the data of mask layer '" + this->get_layer_name() + "'." );
     return false;
   }
-  
-  return true;
+
+  return project->save_data_file( generation_number, data_block, 
+    this->get_grid_transform(), false );
 }
 
 bool MaskLayer::post_load_states( const Core::StateIO& state_io )
@@ -327,11 +366,11 @@ bool MaskLayer::post_load_states( const Core::StateIO& state_io )
   if ( !success )
   {
     Core::DataVolumeHandle data_volume;
-    boost::filesystem::path volume_path = ProjectManager::Instance()->get_current_project()->
-      get_project_data_path() / ( this->generation_state_->export_to_string() + ".nrrd" );
+    boost::filesystem::path volume_path;
     std::string error;
 
-    if( Core::DataVolume::LoadDataVolume( volume_path, data_volume, error ) )
+    if ( ProjectManager::Instance()->get_current_project()->find_data_file( generation, 
+      volume_path ) && Core::DataVolume::LoadDataVolume( volume_path, data_volume, error ) )
     {
       data_volume->register_data( generation );
       Core::MaskDataBlockManager::Instance()->register_data_block( 
@@ -387,12 +426,13 @@ Core::IsosurfaceHandle MaskLayer::get_isosurface()
   return this->private_->isosurface_;
 }
 
-void MaskLayer::compute_isosurface( double quality_factor, bool capping_enabled )
+void MaskLayer::compute_isosurface( double quality_factor, bool capping_enabled,
+  size_t target_faces, double max_error, size_t num_levels )
 {
   if ( !Core::Application::IsApplicationThread() )
   {
     Core::Application::PostEvent( boost::bind( &MaskLayer::compute_isosurface, 
-      this, quality_factor, capping_enabled ) );
+      this, quality_factor, capping_enabled, target_faces, max_error, num_levels ) );
     return;
   }
   
@@ -400,6 +440,8 @@ void MaskLayer::compute_isosurface( double quality_factor, bool capping_enabled
   if ( !iso )
   {
     iso.reset( new Core::Isosurface( this->private_->mask_volume_ ) );
+    // Edits to the mask only recompute the part of the isosurface around the change
+    iso->set_incremental( true );
     this->add_connection( iso->update_progress_signal_.connect(
       boost::bind( &MaskLayerPrivate::handle_isosurface_update_progress, this->private_, _1 ) ) );
   }
@@ -408,6 +450,8 @@ void MaskLayer::compute_isosurface( double quality_factor, bool capping_enabled
   this->data_state_->set( Layer::PROCESSING_C );
 
   this->reset_abort();
+  iso->set_decimation( target_faces, max_error );
+  iso->set_num_levels_of_detail( num_levels );
   iso->compute( quality_factor, capping_enabled, boost::bind( &Layer::check_abort, this ) );
 
   this->data_state_->set( Layer::AVAILABLE_C );
@@ -456,14 +500,7 @@ void MaskLayer::calculate_volume()
   Core::MaskDataBlockHandle mask_block = this->get_mask_volume()->
     get_mask_data_block();
     
-  size_t voxel_count = 0;
-  for( size_t j = 0; j < mask_block->get_size(); ++j )
-  {
-    if( mask_block->get_mask_at( j ) )
-    {
-      voxel_count++;
-    }
-  }
+  size_t voxel_count = Core::MaskDataBlockOperations::Count( mask_block );
   
   double calculated_mask_volume = ( this->get_grid_transform().spacing_x() * 
     this->get_grid_transform().spacing_y() * this->get_grid_transform().spacing_z() )
@@ -115,7 +115,10 @@ public:
   /// COMPUTE_ISOSURFACE
   /// Compute the isosurface for this layer using the given quality factor.
   /// Quality factor must be one of: 1.0, 0.5, 0.25, 0.125
-  void compute_isosurface( double quality_factor, bool capping_enabled );
+  /// The isosurface is decimated to at most target_faces faces or up to an error of max_error,
+  /// zero disables either bound. num_levels is the number of levels of detail to keep.
+  void compute_isosurface( double quality_factor, bool capping_enabled, 
+    size_t target_faces = 0, double max_error = 0.0, size_t num_levels = 1 );
   
   /// CALCULATE_VOLUME:
   /// function that is called by the calculate volume action that calculate the volume of the mask
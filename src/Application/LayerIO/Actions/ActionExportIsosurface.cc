@@ -67,6 +67,13 @@ bool ActionExportIsosurface::validate( Core::ActionContextHandle& context )
     context->report_error( std::string( "Isosurface is empty." ) );
     return false;
   }
+
+  if ( this->level_of_detail_ < 0 || static_cast< size_t >( this->level_of_detail_ ) >= 
+    mask_layer->get_isosurface()->get_num_levels_of_detail() )
+  {
+    context->report_error( std::string( "The isosurface does not have this level of detail." ) );
+    return false;
+  }
   
   boost::filesystem::path isosurface_path( this->file_path_ );
   if ( ! boost::filesystem::exists ( isosurface_path.parent_path() ) )
@@ -83,11 +90,15 @@ bool ActionExportIsosurface::validate( Core::ActionContextHandle& context )
           (extension == ".pts") ||
           (extension == ".val") ||
           (extension == ".stl") ||
-          (extension == ".vtk") ) )
+          (extension == ".vtk") ||
+          (extension == ".vtp") ||
+          (extension == ".ply") ||
+          (extension == ".obj") ) )
   {
     std::ostringstream error;
     error << extension << " is not supported for isosurface export.";
     context->report_error( error.str() );
+    return false;
   }
   
   if (this->name_ == "<none>")
@@ -109,31 +120,17 @@ bool ActionExportIsosurface::run( Core::ActionContextHandle& context, Core::Acti
   progress->begin_progress_reporting();
   
   boost::filesystem::path filename_and_path = boost::filesystem::path( this->file_path_ );
-  boost::filesystem::path extension = filename_and_path.extension();
   
   LayerHandle temp_handle = LayerManager::Instance()->find_layer_by_id( this->layer_ );
   MaskLayer* mask_layer = dynamic_cast< MaskLayer* >( temp_handle.get() );
-  
-  if ( (extension == ".fac") || (extension == ".pts") || (extension == ".val") )
-  {
-    boost::filesystem::path file_path = filename_and_path.parent_path();
-    boost::filesystem::path file_prefix = filename_and_path.stem();
-    mask_layer->get_isosurface()->export_legacy_isosurface(file_path, file_prefix.string());
-  }
-  else if (extension == ".stl")
-  {
-    if (this->binary_file_export_)
-    {
-      mask_layer->get_isosurface()->export_stl_binary_isosurface( filename_and_path, this->name_ );
-    }
-    else
-    {
-      mask_layer->get_isosurface()->export_stl_ascii_isosurface( filename_and_path, this->name_ );
-    }
-  }
-  else
+  bool success = mask_layer->get_isosurface()->export_isosurface( filename_and_path, 
+    this->name_, this->binary_file_export_, this->compress_, this->level_of_detail_ );
+
+  if ( ! success )
   {
-    mask_layer->get_isosurface()->export_vtk_isosurface( filename_and_path );
+    progress->end_progress_reporting();
+    context->report_error( "Could not write isosurface to file '" + this->file_path_ + "'." );
+    return false;
   }
   
   ProjectManager::Instance()->current_file_folder_state_->set( filename_and_path.parent_path().string() );
@@ -153,7 +150,9 @@ void ActionExportIsosurface::Dispatch( Core::ActionContextHandle context,
                                        const std::string& layer_id,
                                        const std::string& file_path,
                                        const std::string& name,
-                                       const bool binary_file_export )
+                                       const bool binary_file_export,
+                                       const int level_of_detail,
+                                       const bool compress )
 {
   // Create new action
   ActionExportIsosurface* action = new ActionExportIsosurface;
@@ -162,6 +161,8 @@ void ActionExportIsosurface::Dispatch( Core::ActionContextHandle context,
   action->file_path_ = file_path;
   action->name_ = name;
   action->binary_file_export_ = binary_file_export;
+  action->level_of_detail_ = level_of_detail;
+  action->compress_ = compress;
   
   Core::ActionDispatcher::PostAction( Core::ActionHandle( action ), context );
 }
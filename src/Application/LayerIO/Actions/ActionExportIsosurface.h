@@ -46,7 +46,9 @@ CORE_ACTION(
   CORE_ACTION_ARGUMENT( "layer", "layer to be exported." )
   CORE_ACTION_ARGUMENT( "file_path", "A path, including the name of the file where the layer should be exported to." )
   CORE_ACTION_OPTIONAL_ARGUMENT( "name", "<none>", "Optional dataset name. Currently only used for STL files (defaults to layer ID if name is not set)." )
-  CORE_ACTION_OPTIONAL_ARGUMENT( "binary", "false", "Optionally export binary file. Currently only available for STL files.")
+  CORE_ACTION_OPTIONAL_ARGUMENT( "binary", "false", "Optionally export binary file. Currently only available for STL and VTK files. VTK XML and PLY files are always binary.")
+  CORE_ACTION_OPTIONAL_ARGUMENT( "compress", "true", "Optionally compress the data. Currently only available for VTK XML files.")
+  CORE_ACTION_OPTIONAL_ARGUMENT( "level_of_detail", "0", "Level of detail of the isosurface to export, 0 is the most detailed one.")
   CORE_ACTION_CHANGES_PROJECT_DATA()
 )
   
@@ -58,6 +60,8 @@ public:
     this->add_parameter( this->file_path_ );
     this->add_parameter( this->name_ );
     this->add_parameter( this->binary_file_export_ );
+    this->add_parameter( this->compress_ );
+    this->add_parameter( this->level_of_detail_ );
   }
   
   // -- Functions that describe action --
@@ -92,6 +96,12 @@ private:
   // Optionally export binary file format
   bool binary_file_export_;
 
+  // Optionally compress the exported data
+  bool compress_;
+
+  // Level of detail of the isosurface to export
+  int level_of_detail_;
+
   // -- Dispatch this action from the interface --
 public:
 
@@ -100,7 +110,9 @@ public:
                        const std::string& layer_id, 
                        const std::string& file_path,
                        const std::string& name = "<none>",
-                       const bool binary_file_export = false );
+                       const bool binary_file_export = false,
+                       const int level_of_detail = 0,
+                       const bool compress = true );
 };
 
 } // end namespace Seg3D
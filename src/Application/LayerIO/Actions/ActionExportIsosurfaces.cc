@@ -0,0 +1,374 @@
+/*
+For more information, please see: http://software.sci.utah.edu
+
+The MIT License
+
+Copyright (c) 2016 Scientific Computing and Imaging Institute,
+University of Utah.
+
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+// STL includes
+#include <algorithm>
+#include <set>
+#include <sstream>
+
+// Boost includes
+#include <boost/filesystem.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+// Core includes
+#include <Core/Isosurface/Isosurface.h>
+#include <Core/Utils/Parallel.h>
+
+// Application includes
+#include <Application/LayerIO/Actions/ActionExportIsosurfaces.h>
+#include <Application/Layer/MaskLayer.h>
+#include <Application/Layer/LayerManager.h>
+#include <Application/ProjectManager/ProjectManager.h>
+
+// REGISTER ACTION:
+// Define a function that registers the action. The action also needs to be
+// registered in the CMake file.
+CORE_REGISTER_ACTION( Seg3D, ExportIsosurfaces )
+
+namespace Seg3D
+{
+
+namespace
+{
+
+// Replace the characters of a layer name that are not safe in a file name
+std::string SanitizeFileName( const std::string& name )
+{
+  std::string file_name( name );
+  for ( size_t j = 0; j < file_name.size(); j++ )
+  {
+    char c = file_name[ j ];
+    if ( !( ( c >= 'a' && c <= 'z' ) || ( c >= 'A' && c <= 'Z' ) || 
+      ( c >= '0' && c <= '9' ) || c == '-' || c == '_' || c == '.' ) )
+    {
+      file_name[ j ] = '_';
+    }
+  }
+  if ( file_name.empty() ) file_name = "isosurface";
+  return file_name;
+}
+
+// Rough estimate of the memory of an isosurface before any isosurface of the batch has been
+// computed: a surface crossing the bounding box twice in each direction, with a point, a
+// normal and two faces per boundary voxel.
+size_t EstimateIsosurfaceMemory( const Core::MaskVolumeHandle& volume )
+{
+  size_t nx = volume->get_nx();
+  size_t ny = volume->get_ny();
+  size_t nz = volume->get_nz();
+  return 2 * ( nx * ny + ny * nz + nx * nz ) * ( 12 + 12 + 24 );
+}
+
+} // end anonymous namespace
+
+class ExportIsosurfacesBatch
+{
+public:
+  // Input of the batch
+  std::vector< Core::MaskVolumeHandle > volumes_;
+  std::vector< std::string > names_;
+  std::vector< boost::filesystem::path > files_;
+
+  double quality_factor_;
+  bool capping_enabled_;
+  size_t target_faces_;
+  double max_error_;
+  bool binary_;
+  bool compress_;
+  size_t max_memory_;
+  int threads_per_isosurface_;
+
+  Core::ActionProgressHandle progress_;
+
+  // Scheduling state, protected by mutex_
+  boost::mutex mutex_;
+  boost::condition_variable job_done_;
+  size_t next_job_;
+  size_t num_running_;
+  size_t num_finished_;
+  size_t live_memory_;
+  // Largest isosurface seen so far, used as the reservation of a job that has not finished yet
+  size_t largest_isosurface_;
+  std::vector< std::string > errors_;
+
+public:
+  ExportIsosurfacesBatch() :
+    next_job_( 0 ),
+    num_running_( 0 ),
+    num_finished_( 0 ),
+    live_memory_( 0 ),
+    largest_isosurface_( 0 )
+  {
+  }
+
+  // RUN_WORKER:
+  // Take jobs until all isosurfaces have been exported. A job is only started if its
+  // reservation fits in the memory budget, or if no other job is running.
+  void run_worker( int thread, int num_threads, Core::Barrier& barrier )
+  {
+    boost::mutex::scoped_lock lock( this->mutex_ );
+    while ( true )
+    {
+      while ( this->next_job_ < this->volumes_.size() && this->max_memory_ != 0 &&
+        this->num_running_ != 0 && 
+        this->live_memory_ + this->largest_isosurface_ > this->max_memory_ )
+      {
+        this->job_done_.wait( lock );
+      }
+      if ( this->next_job_ >= this->volumes_.size() || this->progress_->get_interrupt() ) return;
+
+      size_t job = this->next_job_++;
+      size_t reserved = this->largest_isosurface_;
+      this->num_running_++;
+      this->live_memory_ += reserved;
+      lock.unlock();
+
+      size_t used = this->export_isosurface( job );
+
+      lock.lock();
+      this->live_memory_ -= reserved;
+      this->largest_isosurface_ = std::max( this->largest_isosurface_, used );
+      this->num_running_--;
+      this->num_finished_++;
+      this->progress_->set_progress( static_cast< double >( this->num_finished_ ) / 
+        static_cast< double >( this->volumes_.size() ) );
+      this->job_done_.notify_all();
+    }
+  }
+
+  // EXPORT_ISOSURFACE:
+  // Compute and write one isosurface, returns the memory the isosurface used.
+  size_t export_isosurface( size_t job )
+  {
+    // A standalone isosurface is used so the isosurfaces shown in the viewers are not touched
+    Core::IsosurfaceHandle iso( new Core::Isosurface( this->volumes_[ job ] ) );
+    iso->set_num_threads( this->threads_per_isosurface_ );
+    iso->set_decimation( this->target_faces_, this->max_error_ );
+    iso->compute( this->quality_factor_, this->capping_enabled_, 
+      boost::bind( &Core::ActionProgress::get_interrupt, this->progress_ ) );
+    if ( this->progress_->get_interrupt() ) return 0;
+
+    size_t used = iso->get_points().size() * sizeof( Core::PointF ) +
+      iso->get_normals().size() * sizeof( Core::VectorF ) +
+      iso->get_faces().size() * sizeof( unsigned int );
+
+    if ( iso->get_faces().empty() )
+    {
+      boost::mutex::scoped_lock lock( this->mutex_ );
+      this->errors_.push_back( "The isosurface of layer '" + this->names_[ job ] + 
+        "' is empty and was not exported." );
+      return used;
+    }
+
+    if ( !iso->export_isosurface( this->files_[ job ], this->names_[ job ], this->binary_,
+      this->compress_ ) )
+    {
+      boost::mutex::scoped_lock lock( this->mutex_ );
+      this->errors_.push_back( "Could not write isosurface to file '" + 
+        this->files_[ job ].string() + "'." );
+    }
+    return used;
+  }
+};
+
+bool ActionExportIsosurfaces::validate( Core::ActionContextHandle& context )
+{
+  if ( this->layers_.empty() )
+  {
+    context->report_error( "No layers were given." );
+    return false;
+  }
+
+  for ( size_t j = 0; j < this->layers_.size(); j++ )
+  {
+    if ( !( LayerManager::CheckLayerExistenceAndType( this->layers_[ j ], 
+      Core::VolumeType::MASK_E, context ) ) ) return false;
+
+    if ( !( LayerManager::CheckLayerAvailabilityForUse( this->layers_[ j ], 
+      context ) ) ) return false;
+  }
+
+  boost::filesystem::path export_path( this->file_path_ );
+  if ( !boost::filesystem::is_directory( export_path ) )
+  {
+    std::ostringstream error;
+    error << "The directory '" << this->file_path_ << "' does not exist.";
+    context->report_error( error.str() );
+    return false;
+  }
+
+  if ( !this->extension_.empty() && this->extension_[ 0 ] != '.' )
+  {
+    this->extension_ = "." + this->extension_;
+  }
+
+  if ( ! ( ( this->extension_ == ".fac" ) ||
+           ( this->extension_ == ".stl" ) ||
+           ( this->extension_ == ".vtk" ) ||
+           ( this->extension_ == ".vtp" ) ||
+           ( this->extension_ == ".ply" ) ||
+           ( this->extension_ == ".obj" ) ) )
+  {
+    std::ostringstream error;
+    error << this->extension_ << " is not supported for isosurface export.";
+    context->report_error( error.str() );
+    return false;
+  }
+
+  double quality_factor = this->quality_factor_;
+  if( !( quality_factor == 1.0 || quality_factor == 0.5 || 
+    quality_factor == 0.25 || quality_factor == 0.125 ) )
+  {
+    context->report_error( "The quality factor needs to be 1.0, 0.5, 0.25 or 0.125." );
+    return false;
+  }
+
+  if ( this->target_faces_ < 0 || this->max_error_ < 0.0 )
+  {
+    context->report_error( "The decimation bounds cannot be negative." );
+    return false;
+  }
+
+  if ( this->max_memory_ < 0 || this->max_concurrent_ < 0 )
+  {
+    context->report_error( "The memory and concurrency limits cannot be negative." );
+    return false;
+  }
+
+  return true; // validated
+}
+
+bool ActionExportIsosurfaces::run( Core::ActionContextHandle& context, 
+  Core::ActionResultHandle& result )
+{
+  boost::filesystem::path export_path( this->file_path_ );
+
+  ExportIsosurfacesBatch batch;
+  batch.quality_factor_ = this->quality_factor_;
+  batch.capping_enabled_ = this->capping_enabled_;
+  batch.target_faces_ = static_cast< size_t >( this->target_faces_ );
+  batch.max_error_ = this->max_error_;
+  batch.binary_ = this->binary_file_export_;
+  batch.compress_ = this->compress_;
+  batch.max_memory_ = static_cast< size_t >( this->max_memory_ ) << 20;
+
+  std::set< std::string > used_names;
+  for ( size_t j = 0; j < this->layers_.size(); j++ )
+  {
+    MaskLayerHandle mask_layer = LayerManager::FindMaskLayer( this->layers_[ j ] );
+    std::string name = mask_layer->get_layer_name();
+    std::string file_name = SanitizeFileName( name );
+    // Layer names are not unique, hence fall back to the layer id on a clash
+    if ( used_names.count( file_name ) )
+    {
+      file_name += "_" + SanitizeFileName( mask_layer->get_layer_id() );
+    }
+    used_names.insert( file_name );
+
+    batch.volumes_.push_back( mask_layer->get_mask_volume() );
+    batch.names_.push_back( name );
+    batch.files_.push_back( export_path / ( file_name + this->extension_ ) );
+    batch.largest_isosurface_ = std::max( batch.largest_isosurface_, 
+      EstimateIsosurfaceMemory( batch.volumes_.back() ) );
+  }
+
+  // Several small isosurfaces are computed at the same time, each on a share of the workers,
+  // so that the slice by slice parts of the computation do not oversubscribe the thread pool.
+  int num_workers = Core::Parallel::GetNumThreads();
+  int num_concurrent = this->max_concurrent_ > 0 ? this->max_concurrent_ : num_workers;
+  num_concurrent = std::max( 1, std::min( num_concurrent, 
+    static_cast< int >( batch.volumes_.size() ) ) );
+  batch.threads_per_isosurface_ = std::max( 1, num_workers / num_concurrent );
+
+  std::string message = std::string( "Exporting isosurfaces." );
+  batch.progress_ = Core::ActionProgressHandle( new Core::ActionProgress( message, true, true ) );
+  batch.progress_->begin_progress_reporting();
+
+  Core::Parallel parallel_export( boost::bind( &ExportIsosurfacesBatch::run_worker, 
+    &batch, _1, _2, _3 ), num_concurrent );
+  parallel_export.run();
+
+  bool interrupted = batch.progress_->get_interrupt();
+  batch.progress_->end_progress_reporting();
+
+  if ( interrupted )
+  {
+    context->report_error( "Isosurface export was interrupted." );
+    return false;
+  }
+
+  for ( size_t j = 0; j < batch.errors_.size(); j++ )
+  {
+    context->report_error( batch.errors_[ j ] );
+  }
+
+  std::vector< std::string > files;
+  for ( size_t j = 0; j < batch.files_.size(); j++ )
+  {
+    if ( boost::filesystem::exists( batch.files_[ j ] ) )
+    {
+      files.push_back( batch.files_[ j ].string() );
+    }
+  }
+  result.reset( new Core::ActionResult( files ) );
+
+  ProjectManager::Instance()->current_file_folder_state_->set( export_path.string() );
+  ProjectManager::Instance()->checkpoint_projectmanager();
+
+  return batch.errors_.empty();
+}
+
+void ActionExportIsosurfaces::Dispatch( Core::ActionContextHandle context,
+                                        const std::vector< std::string >& layer_ids,
+                                        const std::string& file_path,
+                                        const std::string& extension,
+                                        double quality_factor,
+                                        bool capping_enabled,
+                                        bool binary_file_export,
+                                        bool compress )
+{
+  // Create new action
+  ActionExportIsosurfaces* action = new ActionExportIsosurfaces;
+  
+  action->layers_ = layer_ids;
+  action->file_path_ = file_path;
+  action->extension_ = extension;
+  action->quality_factor_ = quality_factor;
+  action->capping_enabled_ = capping_enabled;
+  action->target_faces_ = 0;
+  action->max_error_ = 0.0;
+  action->binary_file_export_ = binary_file_export;
+  action->compress_ = compress;
+  action->max_memory_ = 0;
+  action->max_concurrent_ = 0;
+  
+  Core::ActionDispatcher::PostAction( Core::ActionHandle( action ), context );
+}
+
+} // end namespace Seg3D
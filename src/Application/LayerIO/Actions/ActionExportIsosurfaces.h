@@ -0,0 +1,140 @@
+/*
+For more information, please see: http://software.sci.utah.edu
+
+The MIT License
+
+Copyright (c) 2016 Scientific Computing and Imaging Institute,
+University of Utah.
+
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef APPLICATION_LAYERIO_ACTIONS_ACTIONEXPORTISOSURFACES_H
+#define APPLICATION_LAYERIO_ACTIONS_ACTIONEXPORTISOSURFACES_H
+
+// Core includes
+#include <Core/Action/Actions.h>
+#include <Core/Interface/Interface.h>
+
+namespace Seg3D
+{
+
+class ActionExportIsosurfaces : public Core::Action
+{
+  
+CORE_ACTION( 
+  CORE_ACTION_TYPE( "ExportIsosurfaces", "This action computes and exports the isosurfaces of a list of mask layers.")
+  CORE_ACTION_ARGUMENT( "layers", "The layerids of the mask layers whose isosurfaces are exported." )
+  CORE_ACTION_ARGUMENT( "file_path", "The directory the isosurfaces are written to, one file per layer named after the layer." )
+  CORE_ACTION_OPTIONAL_ARGUMENT( "extension", ".vtp", "File extension that selects the file format (.vtp, .vtk, .stl, .ply, .obj or .fac)." )
+  CORE_ACTION_OPTIONAL_ARGUMENT( "quality_factor", "1.0", "The quality factor for mask downsampling prior to isosurface computation." )
+  CORE_ACTION_OPTIONAL_ARGUMENT( "capping", "false", "Whether isosurfaces will be capped." )
+  CORE_ACTION_OPTIONAL_ARGUMENT( "target_triangles", "0", "Decimate each isosurface to at most this number of triangles, 0 to not limit the number of triangles." )
+  CORE_ACTION_OPTIONAL_ARGUMENT( "max_error", "0", "Maximum error of the decimation in world units, 0 to not limit the error." )
+  CORE_ACTION_OPTIONAL_ARGUMENT( "binary", "true", "Optionally export binary files. Currently only used for STL and VTK files." )
+  CORE_ACTION_OPTIONAL_ARGUMENT( "compress", "true", "Optionally compress the data. Currently only used for VTK XML files." )
+  CORE_ACTION_OPTIONAL_ARGUMENT( "max_memory", "0", "Maximum amount of memory in MB the isosurfaces that are computed at the same time may use, 0 to not limit the memory." )
+  CORE_ACTION_OPTIONAL_ARGUMENT( "max_concurrent", "0", "Maximum number of isosurfaces that are computed at the same time, 0 to use one per worker thread." )
+  CORE_ACTION_CHANGES_PROJECT_DATA()
+)
+  
+  // -- Constructor/Destructor --
+public:
+  ActionExportIsosurfaces()
+  {
+    this->add_parameter( this->layers_ );
+    this->add_parameter( this->file_path_ );
+    this->add_parameter( this->extension_ );
+    this->add_parameter( this->quality_factor_ );
+    this->add_parameter( this->capping_enabled_ );
+    this->add_parameter( this->target_faces_ );
+    this->add_parameter( this->max_error_ );
+    this->add_parameter( this->binary_file_export_ );
+    this->add_parameter( this->compress_ );
+    this->add_parameter( this->max_memory_ );
+    this->add_parameter( this->max_concurrent_ );
+  }
+  
+  // -- Functions that describe action --
+public:
+  // VALIDATE:
+  // Each action needs to be validated just before it is posted. This way we
+  // enforce that every action that hits the main post_action signal will be
+  // a valid action to execute.
+  virtual bool validate( Core::ActionContextHandle& context ) override;
+  
+  // RUN:
+  // Each action needs to have this piece implemented. It spells out how the
+  // action is run. It returns whether the action was successful or not.
+  virtual bool run( Core::ActionContextHandle& context, Core::ActionResultHandle& result ) override;
+  
+  // -- Action parameters --
+private:
+  
+  // The mask layers to be exported
+  std::vector< std::string > layers_;
+
+  // Directory where the isosurfaces should be exported
+  std::string file_path_;
+
+  // Extension of the exported files
+  std::string extension_;
+
+  // Quality factor of the isosurfaces
+  double quality_factor_;
+
+  // Whether the isosurfaces are capped
+  bool capping_enabled_;
+
+  // Maximum number of triangles per isosurface, 0 for no limit
+  int target_faces_;
+
+  // Maximum decimation error, 0 for no limit
+  double max_error_;
+
+  // Optionally export binary file format
+  bool binary_file_export_;
+
+  // Optionally compress the exported data
+  bool compress_;
+
+  // Memory budget in MB of the isosurfaces in flight, 0 for no limit
+  int max_memory_;
+
+  // Maximum number of isosurfaces computed at the same time, 0 for one per worker
+  int max_concurrent_;
+
+  // -- Dispatch this action from the interface --
+public:
+
+  // DISPATCH:
+  static void Dispatch( Core::ActionContextHandle context,
+                        const std::vector< std::string >& layer_ids, 
+                        const std::string& file_path,
+                        const std::string& extension = ".vtp",
+                        double quality_factor = 1.0,
+                        bool capping_enabled = false,
+                        bool binary_file_export = true,
+                        bool compress = true );
+};
+
+} // end namespace Seg3D
+
+#endif
@@ -135,9 +135,9 @@ bool LayerImporterFileData::convert_to_layers( const std::string& mode,
 
   if ( mode == LayerIO::DATA_MODE_C )
   {
-    // Data Layers use the histogram. Hence update the histogram, so it is present when needed
-    // in the user interface.
-    canonical_vol->get_data_block()->update_histogram();
+    // Data Layers use the histogram. Start computing it on the thread pool, so it is likely
+    // present when needed in the user interface.
+    Core::DataBlock::RequestHistogram( canonical_vol->get_data_block() );
 
     // This mode only generates 1 layer.
     layers.resize( 1 );
@@ -308,7 +308,7 @@ bool MRCLayerExporter::export_mrc( const std::string& file_path )
       return false;
     }
     out.write(reinterpret_cast<char*>(&header), MRC_HEADER_LENGTH);
-    out.write(reinterpret_cast<char*>(data_block_handle->get_data()), length);
+    out.write(reinterpret_cast<const char*>(data_block_handle->get_const_data()), length);
   }
   catch (...)
   {
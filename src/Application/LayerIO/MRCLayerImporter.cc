@@ -37,12 +37,14 @@
 #include <iostream>
 
 // Core includes
+#include <Core/DataBlock/MappedDataBlock.h>
 #include <Core/DataBlock/StdDataBlock.h>
 
 // Application includes
 #include <Application/Layer/DataLayer.h> 
 #include <Application/LayerIO/MRCLayerImporter.h>
 #include <Application/LayerIO/LayerIO.h>
+#include <Application/PreferencesManager/PreferencesManager.h>
 
 #include <mrcheader.h>
 #include <MRCUtil.h>
@@ -308,6 +310,24 @@ namespace Seg3D
       this->importer_->set_error( "Failed to read header of MRC file." );
       return false;
     }
+
+    // Map the data straight from the file if the user prefers that. Data that needs its
+    // byte order swapped still has to be read.
+    if ( PreferencesManager::Instance()->memory_map_files_state_->get() &&
+      !this->mrcutil_.swap_endian() )
+    {
+      std::string error;
+      this->data_block_ = Core::MappedDataBlock::New( this->importer_->get_filename(),
+        MRC_HEADER_LENGTH, this->grid_transform_.get_nx(), this->grid_transform_.get_ny(),
+        this->grid_transform_.get_nz(), this->data_type_, false, error );
+      if ( this->data_block_ )
+      {
+        this->read_data_ = true;
+        return true;
+      }
+      CORE_LOG_WARNING( error );
+    }
+
     // Generate a new data block
     this->data_block_ = Core::StdDataBlock::New( this->grid_transform_.get_nx(), 
                                                  this->grid_transform_.get_ny(),
@@ -374,8 +394,7 @@ namespace Seg3D
     }
     
     // We move the reader's position back to the front of the file and then to the start of the data
-    //char* data = reinterpret_cast<char *>( this->data_block_->get_data() );
-    char* data = new char[length];
+    char* data = reinterpret_cast<char *>( this->data_block_->get_data() );
     
 #ifdef _WIN32
     offset.QuadPart = MRC_HEADER_LENGTH;
@@ -412,8 +431,6 @@ namespace Seg3D
     data_file.close();
 #endif
 
-    this->data_block_->set_data(data);
-
     // MRC data is always stored as big endian data
     // Hence we need to swap if we are on a little endian system.
     if ( this->mrcutil_.swap_endian() )
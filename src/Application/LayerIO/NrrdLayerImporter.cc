@@ -32,8 +32,12 @@
 // Boost includes
 #include <boost/filesystem.hpp>
 
+// Core includes
+#include <Core/DataBlock/MappedDataBlock.h>
+
 // Application includes
 #include <Application/LayerIO/NrrdLayerImporter.h>
+#include <Application/PreferencesManager/PreferencesManager.h>
 
 #ifdef _WIN32
 #define snprintf _snprintf
@@ -47,10 +51,58 @@ namespace Seg3D
 // Private implementation
 class NrrdLayerImporterPrivate
 {
+public:
+  // LOAD_NRRD:
+  // Load the nrrd file if it has not been loaded yet. If read_data is false only the header
+  // is read, which is enough to describe the file and to map its data.
+  bool load_nrrd( const std::string& filename, bool read_data, std::string& error );
+
+  // MAP_DATA:
+  // Map the data of the nrrd file into memory. Returns an empty handle if the data is
+  // compressed, split over multiple files or not in native byte order.
+  Core::DataBlockHandle map_data( const std::string& filename );
+
 public:
   Core::NrrdDataHandle nrrd_data_;
 };
 
+bool NrrdLayerImporterPrivate::load_nrrd( const std::string& filename, bool read_data, 
+  std::string& error )
+{
+  if ( this->nrrd_data_ && ( !read_data || this->nrrd_data_->get_data() ) ) return true;
+  return Core::NrrdData::LoadNrrd( filename, this->nrrd_data_, error, read_data );
+}
+
+Core::DataBlockHandle NrrdLayerImporterPrivate::map_data( const std::string& filename )
+{
+  Core::DataType data_type = this->nrrd_data_->get_data_type();
+  if ( data_type == Core::DataType::UNKNOWN_E || this->nrrd_data_->nrrd()->dim > 3 )
+  {
+    return Core::DataBlockHandle();
+  }
+
+  size_t nx = this->nrrd_data_->get_nx();
+  size_t ny = this->nrrd_data_->get_ny();
+  size_t nz = this->nrrd_data_->get_nz();
+
+  boost::filesystem::path data_file;
+  long long offset = 0;
+  if ( !Core::NrrdData::FindRawData( filename, nx * ny * nz * Core::GetSizeDataType( data_type ),
+    data_file, offset ) )
+  {
+    return Core::DataBlockHandle();
+  }
+
+  std::string error;
+  Core::DataBlockHandle data_block = Core::MappedDataBlock::New( data_file, offset, 
+    nx, ny, nz, data_type, false, error );
+  if ( !data_block )
+  {
+    CORE_LOG_WARNING( error );
+  }
+  return data_block;
+}
+
 
 NrrdLayerImporter::NrrdLayerImporter() :
   private_( new NrrdLayerImporterPrivate )
@@ -63,16 +115,13 @@ NrrdLayerImporter::~NrrdLayerImporter()
 
 bool NrrdLayerImporter::get_file_info( LayerImporterFileInfoHandle& info )
 {
-  if ( !this->private_->nrrd_data_ )
+  // NOTE: Only the header is needed to describe the file, the data is read or mapped when
+  // the file is imported.
+  std::string error;
+  if ( !this->private_->load_nrrd( this->get_filename(), false, error ) )
   {
-    // NOTE: We load the full data set, as Teem does not support reading headers only.
-    // Hence we need to read the full file
-    std::string error;
-    if ( ! ( Core::NrrdData::LoadNrrd( get_filename() , this->private_->nrrd_data_, error ) ) )
-    {
-      this->set_error( error );
-      return false;
-    } 
+    this->set_error( error );
+    return false;
   }
   
   info = LayerImporterFileInfoHandle( new LayerImporterFileInfo );
@@ -87,22 +136,35 @@ bool NrrdLayerImporter::get_file_info( LayerImporterFileInfoHandle& info )
 
 bool NrrdLayerImporter::get_file_data( LayerImporterFileDataHandle& data )
 {
-  if ( !this->private_->nrrd_data_ )
+  std::string error;
+  Core::DataBlockHandle data_block;
+
+  // Map raw data straight from the file if the user prefers that, the pages are then only
+  // read from disk when they are accessed.
+  if ( PreferencesManager::Instance()->memory_map_files_state_->get() )
   {
-    // NOTE: We load the full data set, as Teem does not support reading headers only.
-    // Hence we need to read the full file
-    std::string error;
-    if ( ! ( Core::NrrdData::LoadNrrd( get_filename() , this->private_->nrrd_data_, error ) ) )
+    if ( !this->private_->load_nrrd( this->get_filename(), false, error ) )
     {
       this->set_error( error );
       return false;
-    } 
+    }
+    data_block = this->private_->map_data( this->get_filename() );
+  }
+
+  if ( !data_block )
+  {
+    if ( !this->private_->load_nrrd( this->get_filename(), true, error ) )
+    {
+      this->set_error( error );
+      return false;
+    }
+    data_block = Core::NrrdDataBlock::New( this->private_->nrrd_data_ );
   }
   
   data = LayerImporterFileDataHandle( new LayerImporterFileData );
   data->set_grid_transform( this->private_->nrrd_data_->get_grid_transform() );
   
-  data->set_data_block( Core::NrrdDataBlock::New( this->private_->nrrd_data_ ) );
+  data->set_data_block( data_block );
   data->set_name( this->get_file_tag() );
     
   // Done
@@ -154,6 +154,15 @@ void PreferencesManager::initialize_states()
   }
   boost::filesystem::path desktop_path;
   Core::Application::Instance()->get_user_desktop_directory( desktop_path );
+  boost::filesystem::path temp_path;
+  try
+  {
+    temp_path = boost::filesystem::temp_directory_path();
+  }
+  catch ( ... )
+  {
+    temp_path = user_path;
+  }
 
   //General Preferences
   this->add_state( "project_path", this->project_path_state_, user_path.string() );
@@ -188,8 +197,19 @@ void PreferencesManager::initialize_states()
   this->add_state( "percent_of_memory", this->percent_of_memory_state_, 
     percent_of_memory, 0.0, 0.5, 0.01 );
 
+  // Undo check points are compressed in memory and moved to the scratch path once they
+  // exceed the memory that is set aside for undo
+  this->add_state( "compress_undo", this->compress_undo_state_, true );
+  this->add_state( "undo_scratch_path", this->undo_scratch_path_state_, temp_path.string() );
+
   this->add_state( "embed_input_files_state", this->embed_input_files_state_, true );
   this->add_state( "generate_osx_project_bundle_state", this->generate_osx_project_bundle_state_, true );
+  this->add_state( "sparse_masks", this->sparse_masks_state_, false );
+  this->add_state( "memory_map_files", this->memory_map_files_state_, false );
+
+  // Layers can be saved into the project as chunked volumes, which are compressed and loaded on
+  // all cores, but cannot be read by older versions. NRRD data files can always be read.
+  this->add_state( "chunked_data_files", this->chunked_data_files_state_, false );
 
   this->add_state( "reverse_slice_navigation", this->reverse_slice_navigation_state_, false );
   this->add_state( "zero_based_slice_numbers", this->zero_based_slice_numbers_state_, false );
@@ -83,8 +83,13 @@ public:
 
   Core::StateBoolHandle enable_undo_state_;
   Core::StateRangedDoubleHandle percent_of_memory_state_;
+  Core::StateBoolHandle compress_undo_state_;
+  Core::StateStringHandle undo_scratch_path_state_;
   Core::StateBoolHandle embed_input_files_state_;
   Core::StateBoolHandle generate_osx_project_bundle_state_;
+  Core::StateBoolHandle sparse_masks_state_;
+  Core::StateBoolHandle memory_map_files_state_;
+  Core::StateBoolHandle chunked_data_files_state_;
 
   Core::StateBoolHandle export_dicom_headers_state_;
   Core::StateBoolHandle export_nrrd0005_state_;
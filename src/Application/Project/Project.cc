@@ -32,8 +32,11 @@
 #include <vector>
 
 // Boost includes
+#include <boost/bind.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/foreach.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
 #include <boost/date_time/c_local_time_adjustor.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/lexical_cast.hpp>
@@ -46,6 +49,10 @@
 #include <Core/Utils/StringUtil.h>
 #include <Core/Utils/Log.h>
 #include <Core/DataBlock/DataBlockManager.h>
+#include <Core/DataBlock/NrrdData.h>
+#include <Core/DataBlock/StdDataBlock.h>
+#include <Core/LargeVolume/ChunkedVolumeFile.h>
+#include <Core/Utils/ThreadPool.h>
 
 // Application includes
 #include <Application/Project/Project.h>
@@ -76,6 +83,72 @@ static const boost::filesystem::path NOTE_DATABASE_C( "notes.sqlite" );
 
 static const std::string AUTO_SESSION_NAME_C( "Auto Save" );
 
+// CLASS SESSIONDATAFILE:
+// A data file that is written when a session is saved
+class SessionDataFile
+{
+public:
+  // Where the file is written
+  boost::filesystem::path file_;
+
+  // The data to write, and whether it is the data block of the layer itself, which is locked
+  // while it is written, instead of a copy that shares its memory
+  Core::DataBlockHandle data_block_;
+  bool locked_;
+  long long generation_;
+
+  Core::GridTransform grid_transform_;
+  bool save_histogram_;
+};
+
+class SessionSaveJob;
+typedef boost::shared_ptr< SessionSaveJob > SessionSaveJobHandle;
+typedef boost::weak_ptr< SessionSaveJob > SessionSaveJobWeakHandle;
+
+// CLASS SESSIONSAVEJOB:
+// A session that is being saved. The data files are written concurrently on the thread pool,
+// the session is only added to the project once all of them have been written.
+class SessionSaveJob : public boost::noncopyable
+{
+public:
+  SessionSaveJob() :
+    asynchronous_( false ),
+    chunked_( true ),
+    compress_( true ),
+    level_( 0 ),
+    started_( false ),
+    num_pending_( 0 ),
+    success_( true )
+  {
+  }
+
+  // Session information that is added to the project
+  std::string session_name_;
+  std::string user_id_;
+  boost::shared_ptr< Core::StateIO > state_io_;
+  std::set< long long > generation_numbers_;
+  bool asynchronous_;
+
+  // Data files that need to be written
+  std::vector< SessionDataFile > data_files_;
+  bool chunked_;
+  bool compress_;
+  int level_;
+
+  // Whether the data files are being written
+  bool started_;
+
+  // Number of data files that still need to be written
+  boost::mutex mutex_;
+  boost::condition_variable written_condition_;
+  size_t num_pending_;
+  bool success_;
+  std::string error_;
+};
+
+class ProjectPrivate;
+typedef boost::weak_ptr< ProjectPrivate > ProjectPrivateWeakHandle;
+
 class ProjectPrivate
 {
   // -- constructor/destructor --
@@ -196,6 +269,19 @@ public:
   // try to copy all the files into the project
   bool process_inputfile_importers(); 
 
+  // START_SESSION_SAVE:
+  // Write the data files of the session that is being saved on the thread pool.
+  void start_session_save( ProjectPrivateWeakHandle project_private );
+
+  // FINISH_SESSION_SAVE:
+  // Wait until the data files of the session that is being saved have been written and add the
+  // session to the project.
+  bool finish_session_save();
+
+  // COMMIT_SESSION_SAVE:
+  // Add a session whose data files have been written to the session database.
+  bool commit_session_save( SessionSaveJobHandle job );
+
   // INSERT_NOTE_INTO_DATABASE:
   // Add a note into the note database. If the timestamp is empty, the database will use the
   // current timestamp.
@@ -270,11 +356,25 @@ public:
   // Whether data needs to be anonymized on the next save
   bool need_anonymize_;
 
+  // The session that is being saved
+  SessionSaveJobHandle session_save_job_;
+
   // -- static helper functions --
 public:
   // UPDATE_PROJECT_DIRECTORY:
   // Generate all the required directories for the project
   static bool UpdateProjectDirectory( const boost::filesystem::path& project_directory );
+
+  // WRITEDATAFILE:
+  // Write a data file of a session that is being saved. This runs on the thread pool.
+  static void WriteDataFile( ProjectPrivateWeakHandle project_private, 
+    SessionSaveJobHandle job, size_t index );
+
+  // COMMITSESSIONSAVE:
+  // Add the session to the project once all the data files have been written. This runs on
+  // the application thread.
+  static void CommitSessionSave( ProjectPrivateWeakHandle project_private, 
+    SessionSaveJobWeakHandle job );
 };
 
 
@@ -558,8 +658,12 @@ void ProjectPrivate::clean_up_data_files()
     
     // Skip directories
     if ( !boost::filesystem::is_regular_file( file_path ) ) continue;
-    // Skip non-nrrd files
-    if ( Core::StringToLower( file_path.extension().string() ) != ".nrrd" ) continue;
+    // Skip files that are not data files
+    std::string extension = Core::StringToLower( file_path.extension().string() );
+    if ( extension != ".nrrd" && extension != Core::ChunkedVolumeFile::GetFileExtension() ) 
+    {
+      continue;
+    }
 
     std::string file_name = file_path.stem().string();
     try
@@ -1444,6 +1548,204 @@ bool ProjectPrivate::process_inputfile_importers()
   return true;
 }
 
+void ProjectPrivate::start_session_save( ProjectPrivateWeakHandle project_private )
+{
+  SessionSaveJobHandle job = this->session_save_job_;
+  job->started_ = true;
+  job->num_pending_ = job->data_files_.size();
+
+  for ( size_t j = 0; j < job->data_files_.size(); j++ )
+  {
+    Core::ThreadPool::Instance()->post( boost::bind( &ProjectPrivate::WriteDataFile, 
+      project_private, job, j ) );
+  }
+}
+
+bool ProjectPrivate::finish_session_save()
+{
+  SessionSaveJobHandle job = this->session_save_job_;
+  if ( !job ) return true;
+
+  {
+    boost::mutex::scoped_lock lock( job->mutex_ );
+    while ( job->num_pending_ > 0 ) job->written_condition_.wait( lock );
+  }
+
+  this->session_save_job_.reset();
+  return this->commit_session_save( job );
+}
+
+bool ProjectPrivate::commit_session_save( SessionSaveJobHandle job )
+{
+  bool success = job->success_;
+  if ( !success )
+  {
+    CORE_LOG_ERROR( job->error_ );
+  }
+
+  // Convert the old session files if necessary
+  if ( success && this->conversion_needed_ )
+  {
+    this->rename_version1_session_files();
+    this->conversion_needed_ = false;
+  }
+
+  // Add the entry to the session database
+  SessionID session_id = -1;
+  if ( success )
+  {
+    session_id = this->insert_session_into_database( job->session_name_, job->user_id_ );
+    if ( session_id < 0 )
+    {
+      CORE_LOG_ERROR( "Failed to added a new session record to the database." );
+      success = false;
+    }
+  }
+
+  // Write the XML file in the session directory
+  if ( success )
+  {
+    boost::filesystem::path session_path = 
+      boost::filesystem::path( this->project_->project_path_state_->get() ) / SESSION_DIR_C / 
+      ( Core::ExportToString( session_id ) + ".xml" );
+    if ( !job->state_io_->export_to_file( session_path ) )
+    {
+      CORE_LOG_ERROR( std::string( "Could not save session file '" ) + 
+        session_path.string() + "'." );
+      
+      // NOTE: We need to delete it when saving fails
+      this->delete_session_from_database( session_id );
+      success = false;
+    }
+  }
+
+  // NOTE: These generation numbers were filled out by the saving function of each layer
+  if ( success && !this->set_session_data( session_id, job->generation_numbers_ ) )
+  {
+    this->delete_session_from_database( session_id );
+    success = false;
+  }
+
+  if ( !success )
+  {
+    // The changes still need to be saved
+    {
+      Core::Application::lock_type lock( Core::Application::GetMutex() );
+      this->changed_ = true;
+    }
+
+    if ( job->asynchronous_ )
+    {
+      // Draw the users attention to this problem.
+      CORE_LOG_CRITICAL_ERROR( "Save FAILED for project: '" 
+        + this->project_->project_name_state_->get() 
+        + "'. Please perform a 'Save Project As' as soon as possible to preserve your data." );
+    }
+    return false;
+  }
+
+  // Save the state of the project to disk
+  this->project_->save_state();
+
+  // Update the size of the project
+  this->update_project_size();
+  
+  // Add a timestamp of when the last session was saved for auto save functionality
+  this->set_last_saved_session_time_stamp();
+
+  // Signal the user interface the new session list
+  SessionInfoListHandle session_list( new SessionInfoList );
+  this->get_all_sessions( *session_list );
+  this->project_->session_list_changed_signal_( session_list );
+
+  if ( job->asynchronous_ )
+  {
+    CORE_LOG_SUCCESS( "Successfully saved session '" + job->session_name_ + 
+      "' for project: '" + this->project_->project_name_state_->get() + "'." );
+  }
+
+  return true;
+}
+
+void ProjectPrivate::WriteDataFile( ProjectPrivateWeakHandle project_private, 
+  SessionSaveJobHandle job, size_t index )
+{
+  const SessionDataFile& data_file = job->data_files_[ index ];
+  Core::DataBlockHandle data_block = data_file.data_block_;
+
+  // Write into a temporary file first, so a partially written file is never mistaken for data
+  // that has been saved
+  boost::filesystem::path temp_file( data_file.file_.string() + ".part" );
+  std::string error;
+  bool success = false;
+  {
+    Core::DataBlock::shared_lock_type lock( data_block->get_mutex(), boost::defer_lock );
+    if ( data_file.locked_ ) lock.lock();
+
+    if ( data_file.locked_ && data_block->get_generation() != data_file.generation_ )
+    {
+      error = "Data file '" + data_file.file_.string() + "' changed while it was being saved.";
+    }
+    else if ( job->chunked_ )
+    {
+      success = Core::ChunkedVolumeFile::Save( temp_file, data_block, 
+        data_file.grid_transform_, job->compress_, data_file.save_histogram_, error );
+    }
+    else
+    {
+      Core::NrrdDataHandle nrrd( new Core::NrrdData( data_block, data_file.grid_transform_ ) );
+      if ( data_file.save_histogram_ ) nrrd->set_histogram( data_block->get_histogram() );
+      success = Core::NrrdData::SaveNrrd( temp_file.string(), nrrd, error, job->compress_, 
+        job->level_ );
+    }
+  }
+
+  try
+  {
+    if ( success ) boost::filesystem::rename( temp_file, data_file.file_ );
+    else boost::filesystem::remove( temp_file );
+  }
+  catch ( ... )
+  {
+    error = "Could not move data file '" + temp_file.string() + "' into place.";
+    success = false;
+  }
+
+  bool done = false;
+  {
+    boost::mutex::scoped_lock lock( job->mutex_ );
+    if ( !success )
+    {
+      job->success_ = false;
+      job->error_ = error;
+    }
+    job->num_pending_--;
+    done = job->num_pending_ == 0;
+    job->written_condition_.notify_all();
+  }
+
+  if ( done && job->asynchronous_ )
+  {
+    Core::Application::PostEvent( boost::bind( &ProjectPrivate::CommitSessionSave, 
+      project_private, SessionSaveJobWeakHandle( job ) ) );
+  }
+}
+
+void ProjectPrivate::CommitSessionSave( ProjectPrivateWeakHandle project_private, 
+  SessionSaveJobWeakHandle job )
+{
+  ProjectPrivateHandle private_handle = project_private.lock();
+  SessionSaveJobHandle job_handle = job.lock();
+
+  // The session may have been added to the project already by finish_session_save
+  if ( !private_handle || !job_handle || private_handle->session_save_job_ != job_handle )
+  {
+    return;
+  }
+
+  private_handle->finish_session_save();
+}
+
 bool ProjectPrivate::get_all_notes( ProjectNoteList& notes )
 {
   ASSERT_IS_APPLICATION_THREAD();
@@ -2005,6 +2307,9 @@ bool Project::save_project( const boost::filesystem::path& project_path,
 {
   // This function sets state variables directly, hence we need to be on the application thread.
   ASSERT_IS_APPLICATION_THREAD();
+
+  // A session that is being saved belongs to the current location of the project
+  this->private_->finish_session_save();
   
   // Ensure that we have the full path
   boost::filesystem::path full_path;
@@ -2314,6 +2619,19 @@ boost::filesystem::path Project::get_project_data_path() const
   return project_path / DATA_DIR_C;
 }
 
+bool Project::find_data_file( long long generation_number, 
+  boost::filesystem::path& data_file ) const
+{
+  boost::filesystem::path data_path = this->get_project_data_path();
+  std::string generation = Core::ExportToString( generation_number );
+
+  data_file = data_path / ( generation + Core::ChunkedVolumeFile::GetFileExtension() );
+  if ( boost::filesystem::exists( data_file ) ) return true;
+
+  data_file = data_path / ( generation + ".nrrd" );
+  return boost::filesystem::exists( data_file );
+}
+
 boost::filesystem::path Project::get_project_sessions_path() const
 {
   Core::StateEngine::lock_type lock( Core::StateEngine::GetMutex() );
@@ -2359,6 +2677,9 @@ bool Project::export_project( const boost::filesystem::path& export_path,
   // This function sets state variables directly, hence we need to be on the application thread.
   ASSERT_IS_APPLICATION_THREAD();
 
+  // The session may still be being saved
+  this->private_->finish_session_save();
+
   if ( !this->is_session( session_id ) )
   {
     CORE_LOG_ERROR( Core::ExportToString( session_id ) + "is not a valid session ID." );
@@ -2443,15 +2764,14 @@ bool Project::export_project( const boost::filesystem::path& export_path,
   // Copy those data files
   BOOST_FOREACH( Core::DataBlock::generation_type generation, generations )
   {
-    boost::filesystem::path src_file = project_path / DATA_DIR_C / 
-      ( Core::ExportToString( generation ) + ".nrrd" );
-    boost::filesystem::path dst_file = export_path / DATA_DIR_C /
-      ( Core::ExportToString( generation ) + ".nrrd" );
-    if ( !boost::filesystem::exists( src_file ) )
+    boost::filesystem::path src_file;
+    if ( !this->find_data_file( generation, src_file ) )
     {
-      CORE_LOG_ERROR( "Missing data file '" + src_file.string() + "'." );
+      CORE_LOG_ERROR( "Missing data file '" + ( project_path / DATA_DIR_C / 
+        Core::ExportToString( generation ) ).string() + "'." );
       return false;
     }
+    boost::filesystem::path dst_file = export_path / DATA_DIR_C / src_file.filename();
     try
     {
       boost::filesystem::copy_file( src_file, dst_file );
@@ -2678,11 +2998,14 @@ bool Project::load_last_session()
   return false;
 }
 
-bool Project::save_session( const std::string& name )
+bool Project::save_session( const std::string& name, bool asynchronous )
 {
   // This function sets state variables directly, hence we need to be on the application thread
   ASSERT_IS_APPLICATION_THREAD();
 
+  // Only one session is saved at a time
+  this->private_->finish_session_save();
+
   std::string session_name = name;
   // Update the session name if needed
   if ( session_name.empty() ) 
@@ -2705,77 +3028,51 @@ bool Project::save_session( const std::string& name )
   // Copy all the input files into the project directory
   this->private_->process_inputfile_importers();
 
+  // NOTE: The layers add the data files that need to be written to the job while their states
+  // are saved.
+  SessionSaveJobHandle job( new SessionSaveJob );
+  job->session_name_ = session_name;
+  job->asynchronous_ = asynchronous;
+  job->chunked_ = PreferencesManager::Instance()->chunked_data_files_state_->get();
+  job->compress_ = PreferencesManager::Instance()->compression_state_->get();
+  job->level_ = PreferencesManager::Instance()->compression_level_state_->get();
+  job->state_io_.reset( new Core::StateIO );
+  job->state_io_->initialize();
+  this->private_->session_save_job_ = job;
+
   // NOTE: We need to save first before making an entry into the database to be sure it will succeed.
-  Core::StateIO state_io;
-  state_io.initialize();
-  if ( !Core::StateEngine::Instance()->save_states( state_io ) )
+  if ( !Core::StateEngine::Instance()->save_states( *job->state_io_ ) )
   {
+    this->private_->session_save_job_.reset();
     std::string error = "Could not extract all the session information from the project.";
     CORE_LOG_ERROR( error );
     return false;
   }
+  job->generation_numbers_ = this->private_->session_generation_numbers_;
 
   // Get the user name, as session information contains the name of the user that saved the session.
-  std::string user_id;
-  if ( !Core::Application::Instance()->get_user_name( user_id ) )
+  if ( !Core::Application::Instance()->get_user_name( job->user_id_ ) )
   {
-    user_id = "unknown";
-  }
-  
-  // Convert the old session files if necessary
-  if ( this->private_->conversion_needed_ )
-  {
-    this->private_->rename_version1_session_files();
-    this->private_->conversion_needed_ = false;
-  }
-
-  // Add the entry to the session database
-  SessionID session_id = this->private_->insert_session_into_database( session_name, user_id );
-  if ( session_id < 0 )
-  {
-    CORE_LOG_ERROR( "Failed to added a new session record to the database." );
-    return false;
+    job->user_id_ = "unknown";
   }
 
-  // Write the XML file in the session directory
-  boost::filesystem::path session_path = project_path / SESSION_DIR_C / 
-    ( Core::ExportToString( session_id ) + ".xml" );
-  if ( !state_io.export_to_file( session_path ) )
-  {
-    std::string error = std::string( "Could not save session file '" ) + 
-      session_path.string() + "'.";
-    CORE_LOG_ERROR( error );
-    
-    // NOTE: We need to delete it when saving fails
-    this->private_->delete_session_from_database( session_id );
-    return false;
-  }
-
-  // NOTE: This variable was filled out by the saving function of each layer
-  if ( !this->private_->set_session_data( session_id, this->private_->session_generation_numbers_ ) )
-  {
-    this->private_->delete_session_from_database( session_id );
-    return false;
-  }
+  // The session records the project as it is now, edits made while the data files are
+  // written need to be saved again
+  this->reset_project_changed();
 
-  // Save the state of the project to disk
-  this->save_state();
+  // Write the data files on the thread pool
+  this->private_->start_session_save( this->private_ );
 
-  // Update the size of the project
-  this->private_->update_project_size();
-  
-  // Add a timestamp of when the last session was saved for auto save functionality
-  this->private_->set_last_saved_session_time_stamp();
+  if ( asynchronous && !job->data_files_.empty() ) return true;
+  return this->private_->finish_session_save();
+}
 
-  // Tell program that project does not yet need to be saved.
-  this->reset_project_changed();
-  
-  // Signal the user interface the new session list
-  SessionInfoListHandle session_list( new SessionInfoList );
-  this->private_->get_all_sessions( *session_list );
-  this->session_list_changed_signal_( session_list );
+bool Project::finish_session_save()
+{
+  // This function sets state variables directly, hence we need to be on the application thread
+  ASSERT_IS_APPLICATION_THREAD();
 
-  return true;
+  return this->private_->finish_session_save();
 }
 
 
@@ -2784,6 +3081,9 @@ bool Project::delete_session( SessionID session_id )
   // This function sets state variables directly, hence we need to be on the application thread
   ASSERT_IS_APPLICATION_THREAD();
 
+  // The data files of a session that is being saved must not be cleaned up
+  this->private_->finish_session_save();
+
   std::string error;
   boost::filesystem::path session_file;
   if ( this->private_->get_session_file( session_id, session_file, error ) )
@@ -3170,6 +3470,53 @@ void Project::add_generation_number( const long long generation_number )
   this->private_->session_generation_numbers_.insert( generation_number );
 }
 
+bool Project::save_data_file( long long generation_number, Core::DataBlockHandle data_block,
+  const Core::GridTransform& grid_transform, bool save_histogram )
+{
+  SessionSaveJobHandle job = this->private_->session_save_job_;
+  if ( !job || job->started_ )
+  {
+    CORE_LOG_ERROR( "Data files can only be added while the session is being saved." );
+    return false;
+  }
+
+  // File has already been saved
+  boost::filesystem::path data_file;
+  if ( this->find_data_file( generation_number, data_file ) ) return true;
+
+  data_file = this->get_project_data_path() / ( Core::ExportToString( generation_number ) + 
+    ( job->chunked_ ? Core::ChunkedVolumeFile::GetFileExtension() : ".nrrd" ) );
+
+  // Mask layers that share a data block share the data file
+  for ( size_t j = 0; j < job->data_files_.size(); j++ )
+  {
+    if ( job->data_files_[ j ].file_ == data_file ) return true;
+  }
+
+  SessionDataFile file;
+  file.file_ = data_file;
+  file.generation_ = generation_number;
+  file.grid_transform_ = grid_transform;
+  file.save_histogram_ = save_histogram;
+  {
+    Core::DataBlock::shared_lock_type lock( data_block->get_mutex() );
+    file.data_block_ = Core::StdDataBlock::NewShared( data_block );
+  }
+
+  file.locked_ = !file.data_block_;
+  if ( file.locked_ )
+  {
+    file.data_block_ = data_block;
+  }
+  else if ( save_histogram && data_block->has_histogram() )
+  {
+    file.data_block_->set_histogram( data_block->get_histogram() );
+  }
+
+  job->data_files_.push_back( file );
+  return true;
+}
+
 bool Project::execute_or_add_inputfiles_importer( const InputFilesImporterHandle& importer )
 {
   // Add the importer to the list
@@ -43,6 +43,8 @@
 
 // Core includes
 #include <Core/Action/Action.h>
+#include <Core/DataBlock/DataBlockFWD.h>
+#include <Core/Geometry/GridTransform.h>
 #include <Core/State/StateHandler.h>
 
 // Application includes
@@ -188,8 +190,17 @@ public:
   
   /// SAVE_SESSION:
   /// This function will be called from the project manager to save a session
+  /// The data files of the layers are written concurrently on the thread pool. If asynchronous
+  /// is true, this function returns as soon as the state of the session has been recorded, and
+  /// the session is added to the project once all its data files have been written.
   /// NOTE: This function can only can called from the application thread.
-  bool save_session( const std::string& name );
+  bool save_session( const std::string& name, bool asynchronous = false );
+
+  /// FINISH_SESSION_SAVE:
+  /// Wait for a session that is being saved in the background and add it to the project.
+  /// Returns false if the session could not be saved.
+  /// NOTE: This function can only can called from the application thread.
+  bool finish_session_save();
   
   /// DELETE_SESSION:
   /// This function will be called by the project manager to delete a session
@@ -226,6 +237,12 @@ public:
   /// GET_PROJECT_DATA_PATH:
   /// Get the data path of this project
   boost::filesystem::path get_project_data_path() const;
+
+  /// FIND_DATA_FILE:
+  /// Find the file in the data path that stores a data generation. Data files are either
+  /// chunked volumes or NRRD files. Returns false if neither exists.
+  bool find_data_file( long long generation_number, 
+    boost::filesystem::path& data_file ) const;
   
   /// GET_PROJECT_SESSION_PATH:
   /// Get the session path of this project
@@ -321,6 +338,15 @@ public:
   /// Tell the project which generation numbers are part of the project
   void add_generation_number( const long long generation_number );
 
+  /// SAVE_DATA_FILE:
+  /// Write a data block into the data directory of the project as part of the session that is
+  /// being saved, unless the file of this generation exists already. The file is written after
+  /// all the states have been saved, hence the data block is shared with a copy that is not
+  /// affected by later edits. Data that cannot be shared is locked while it is written.
+  /// NOTE: This function is called by the layers while their states are saved.
+  bool save_data_file( long long generation_number, Core::DataBlockHandle data_block,
+    const Core::GridTransform& grid_transform, bool save_histogram );
+
   //-- input file directory handling --
 public:
   /// Add a file list of files to import to the project and execute if it already resides on
@@ -88,9 +88,7 @@ bool ActionAutoSave::run( Core::ActionContextHandle& context,
   {
     // TODO: Check whether this call is still needed here
     ProjectManager::Instance()->get_current_project()->reset_project_changed();
-    std::string message = std::string( "Successfully autosaved session for project: '" ) + 
-      ProjectManager::Instance()->get_current_project()->project_name_state_->get() + "'.";
-    CORE_LOG_SUCCESS( message );
+    // NOTE: The project reports when the session has been written to disk
     return true;
   }
   else 
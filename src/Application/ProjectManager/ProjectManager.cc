@@ -93,6 +93,10 @@ public:
   // Reset the current project folder variable to the one the preference
   void reset_current_project_folder();
 
+  // FINISH_SESSION_SAVE:
+  // Wait for the session of the current project that is being saved in the background.
+  void finish_session_save();
+
 public:
   // public handle to the current project
   ProjectHandle current_project_;
@@ -259,6 +263,19 @@ void ProjectManagerPrivate::reset_current_project_folder()
     PreferencesManager::Instance()->project_path_state_->get() );
 }
 
+void ProjectManagerPrivate::finish_session_save()
+{
+  // This one is called when the application stops, which happens on a different thread
+  if ( !Core::Application::IsApplicationThread() )
+  {
+    Core::Application::PostAndWaitEvent( boost::bind( 
+      &ProjectManagerPrivate::finish_session_save, this ) );
+    return;
+  }
+
+  if ( this->current_project_ ) this->current_project_->finish_session_save();
+}
+
 bool ProjectManagerPrivate::insert_or_update_project_entry( const boost::filesystem::path& project_file )
 {
   std::ostringstream sql_str;
@@ -429,6 +446,11 @@ ProjectManager::ProjectManager() :
   PreferencesManager::Instance()->project_path_state_->state_changed_signal_.connect(
     boost::bind( &ProjectManagerPrivate::reset_current_project_folder, this->private_ ) );
 
+  // Sessions that are being saved in the background need to be finished before the 
+  // application stops
+  Core::Application::Instance()->application_stop_signal_.connect(
+    boost::bind( &ProjectManagerPrivate::finish_session_save, this->private_ ) );
+
   this->set_initializing( false );
 }
 
@@ -538,6 +560,9 @@ bool ProjectManager::new_project( const std::string& project_location,
       return false;
     }
   }
+
+  // Finish saving the current project before it is replaced
+  this->private_->finish_session_save();
   
   // Reset the application.
   Core::Application::Reset();
@@ -602,6 +627,9 @@ bool ProjectManager::open_project( const std::string& project_file )
     CORE_LOG_ERROR( error.str() );
     return false;
   }
+
+  // Finish saving the current project before it is replaced
+  this->private_->finish_session_save();
   
   // Reset the application.
   Core::Application::Reset();
@@ -721,7 +749,7 @@ bool ProjectManager::save_project_session( const std::string& session_name  )
   // This function sets state variables directly, hence we need to be on the application thread
   ASSERT_IS_APPLICATION_THREAD();
 
-  if ( this->get_current_project()->save_session( session_name ) )
+  if ( this->get_current_project()->save_session( session_name, true ) )
   {
     // Ensure it is not auto saving a project with no new data
     this->get_current_project()->reset_project_changed();
@@ -94,6 +94,8 @@ public:
       
   /// SAVE_PROJECT_SESSION:
   /// this function saves the current session to disk
+  /// NOTE: The data files are written in the background, the session is added to the project
+  /// once all of them have been written.
   bool save_project_session( const std::string& session_name ); 
   
   /// LOAD_PROJECT_SESSION:
@@ -915,12 +915,12 @@ void RendererPrivate::draw_isosurfaces( const IsosurfaceArray& isosurfaces )
       Core::Texture1DHandle colormap_tex = colormap->get_texture();
       Core::Texture::lock_type tex_lock( colormap_tex->get_mutex() );
       colormap_tex->bind();
-      iso->redraw( true );
+      iso->redraw( true, iso->get_render_level_of_detail() );
       colormap_tex->unbind();
     }
     else
     {
-      iso->redraw( false );
+      iso->redraw( false, iso->get_render_level_of_detail() );
     }
     CORE_CHECK_OPENGL_ERROR();
   }
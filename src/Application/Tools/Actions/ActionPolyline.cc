@@ -288,6 +288,9 @@ bool ActionPolyline::run( Core::ActionContextHandle& context, Core::ActionResult
   unsigned char not_mask_value = ~mask_value;
   bool erase = this->private_->erase_;
   const size_t x_stride = volume_slice->to_index( 1, 0 ) - volume_slice->to_index( 0, 0 );
+  // Range of pixels along the scanlines that were filled
+  int fill_min_x = static_cast< int >( nx );
+  int fill_max_x = -1;
   for ( int y = min_y; y <= max_y; ++y )
   {
     std::vector< int > intersections;
@@ -317,6 +320,8 @@ bool ActionPolyline::run( Core::ActionContextHandle& context, Core::ActionResult
       {
         continue;
       }
+      fill_min_x = Core::Min( fill_min_x, x0 );
+      fill_max_x = Core::Max( fill_max_x, x1 );
       
       size_t start = volume_slice->to_index( static_cast< size_t >( x0 ), 
         static_cast< size_t >( y ) );
@@ -337,7 +342,26 @@ bool ActionPolyline::run( Core::ActionContextHandle& context, Core::ActionResult
   }
   
   mask_data_lock.unlock();
-  mask_data_block->increase_generation();
+
+  // Only the filled part of the slice changed
+  Core::IndexVector region_min( 0, 0, 0 );
+  Core::IndexVector region_max( -1, -1, -1 );
+  if ( fill_min_x <= fill_max_x )
+  {
+    Core::Point corner0, corner1;
+    volume_slice->to_index( static_cast< size_t >( fill_min_x ), 
+      static_cast< size_t >( min_y ), corner0 );
+    volume_slice->to_index( static_cast< size_t >( fill_max_x ), 
+      static_cast< size_t >( max_y ), corner1 );
+    for ( int k = 0; k < 3; k++ )
+    {
+      region_min[ k ] = static_cast< Core::IndexVector::index_type >( 
+        Core::Min( corner0[ k ], corner1[ k ] ) );
+      region_max[ k ] = static_cast< Core::IndexVector::index_type >( 
+        Core::Max( corner0[ k ], corner1[ k ] ) );
+    }
+  }
+  mask_data_block->increase_generation( region_min, region_max );
   mask_data_block->mask_updated_signal_();
 
   result.reset( new Core::ActionResult( this->private_->target_layer_id_ ) );
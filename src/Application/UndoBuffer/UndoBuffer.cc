@@ -29,6 +29,9 @@
 // STL includes
 #include <deque>
 
+// Boost includes
+#include <boost/filesystem.hpp>
+
 // Core includes
 #include <Core/Action/ActionContextContainer.h>
 
@@ -75,8 +78,15 @@ public:
   
   UndoBuffer* buffer_;
   long long max_mem_;
+
+  // Directory for check points that are moved out of memory
+  boost::filesystem::path scratch_directory_;
   
   void handle_enable( bool enable );
+
+  // GET_SCRATCH_DIRECTORY:
+  // Get the directory for this session inside the undo scratch path
+  const boost::filesystem::path& get_scratch_directory();
 };
 
 
@@ -88,6 +98,19 @@ void UndoBufferPrivate::handle_enable( bool enable )
   }
 }
 
+const boost::filesystem::path& UndoBufferPrivate::get_scratch_directory()
+{
+  // Every session uses its own directory, so instances of the program do not share files
+  if ( this->scratch_directory_.empty() )
+  {
+    this->scratch_directory_ = boost::filesystem::path( 
+      PreferencesManager::Instance()->undo_scratch_path_state_->get() ) / 
+      boost::filesystem::unique_path( Core::Application::GetApplicationName() + 
+      "-Undo-%%%%-%%%%-%%%%" );
+  }
+  return this->scratch_directory_;
+}
+
 UndoBuffer::UndoBuffer() :
   private_( new UndoBufferPrivate )
 {
@@ -105,6 +128,12 @@ UndoBuffer::UndoBuffer() :
 UndoBuffer::~UndoBuffer()
 {
   this->disconnect_all();
+
+  if ( !this->private_->scratch_directory_.empty() )
+  {
+    boost::system::error_code ec;
+    boost::filesystem::remove_all( this->private_->scratch_directory_, ec );
+  }
 }
 
 void UndoBuffer::insert_undo_item( Core::ActionContextHandle context, 
@@ -121,6 +150,12 @@ void UndoBuffer::insert_undo_item( Core::ActionContextHandle context,
     this->update_redo_tag_signal_( this->get_redo_tag() );
   }
 
+  // The action of the previous item has been completed by now
+  if ( !this->private_->undo_list_.empty() )
+  {
+    this->private_->undo_list_.front()->compact();
+  }
+
   size_t max_size = static_cast<size_t> ( this->private_->max_mem_ * 
     PreferencesManager::Instance()->percent_of_memory_state_->get() );
 
@@ -132,12 +167,23 @@ void UndoBuffer::insert_undo_item( Core::ActionContextHandle context,
 
   size_t max_num_undos = 0;
 
+  // Items that do not fit in the memory set aside for undo are moved to scratch files. Only
+  // items that cannot be moved out of memory are dropped, together with all older items.
   while ( it != it_end )
   {
-    size += (*it)->get_byte_size();
+    // NOTE: Check points are compressed in the background, hence sizes change over time
+    (*it)->compute_size();
+    size_t item_size = (*it)->get_byte_size();
+    if ( item_size > 0 && size + item_size > max_size &&
+      (*it)->spill( this->private_->get_scratch_directory() ) )
+    {
+      item_size = (*it)->get_byte_size();
+    }
+
     max_num_undos++;
-    if ( size > max_size ) break;
+    if ( item_size > 0 && size + item_size > max_size ) break;
     if ( max_num_undos >= 100 ) break;
+    size += item_size;
     ++it;
   }
 
@@ -82,6 +82,15 @@ bool UndoBufferItem::apply_redo( Core::ActionContextHandle& context )
   return true;
 }
 
+bool UndoBufferItem::spill( const boost::filesystem::path& directory )
+{
+  return false;
+}
+
+void UndoBufferItem::compact()
+{
+}
+
 std::string UndoBufferItem::get_tag() const
 {
   return this->private_->tag_;
@@ -29,6 +29,9 @@
 #ifndef APPLICATION_UNDOBUFFER_UNDOBUFFERITEM_H
 #define APPLICATION_UNDOBUFFER_UNDOBUFFERITEM_H
 
+// Boost includes
+#include <boost/filesystem/path.hpp>
+
 // Core includes
 #include <Core/Action/Action.h>
 
@@ -78,6 +81,16 @@ public:
   /// Compute the size of the item
   virtual void compute_size() = 0;
 
+  /// SPILL:
+  /// Move the data of the item out of memory into scratch files in the given directory.
+  /// Returns false if the item cannot do so.
+  virtual bool spill( const boost::filesystem::path& directory );
+
+  /// COMPACT:
+  /// Reduce the data of the item once the action it belongs to has been completed. This is
+  /// called when the next item is inserted into the undo buffer.
+  virtual void compact();
+
   /// GET_TAG:
   /// Tag that appears in the menu for this item
   std::string get_tag() const;
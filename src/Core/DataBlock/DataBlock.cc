@@ -26,9 +26,23 @@
  DEALINGS IN THE SOFTWARE.
 */
 
+// STL includes
+#include <algorithm>
+#include <limits>
+#include <type_traits>
+
+// Boost includes
+#include <boost/bind.hpp>
+#include <boost/checked_delete.hpp>
+#include <boost/filesystem/operations.hpp>
+
 #include <Core/DataBlock/DataBlock.h>
 #include <Core/DataBlock/DataBlockManager.h>
+#include <Core/DataBlock/MappedDataBlock.h>
 #include <Core/DataBlock/StdDataBlock.h>
+#include <Core/Utils/Log.h>
+#include <Core/Utils/Parallel.h>
+#include <Core/Utils/ThreadPool.h>
 
 namespace Core
 {
@@ -39,6 +53,9 @@ DataBlock::DataBlock() :
   nz_( 0 ), 
   data_type_( DataType::UNKNOWN_E ), 
   data_( 0 ),
+  sharing_disabled_( false ),
+  data_stamp_( 1 ),
+  histogram_stamp_( 0 ),
   generation_( -1 )
 {
 }
@@ -116,49 +133,49 @@ void DataBlock::set_data_at( index_type index, double value )
   {
     case DataType::CHAR_E:
     {
-      signed char* data = reinterpret_cast<signed char*>( this->data_ );
+      signed char* data = reinterpret_cast<signed char*>( this->get_data() );
       data[ index ] = static_cast<signed char>( value );
       return;
     }     
     case DataType::UCHAR_E:
     {
-      unsigned char* data = reinterpret_cast<unsigned char*>( this->data_ );
+      unsigned char* data = reinterpret_cast<unsigned char*>( this->get_data() );
       data[ index ] = static_cast<unsigned char>( value );
       return;
     }     
     case DataType::SHORT_E:
     {
-      short* data = reinterpret_cast<short*>( this->data_ );
+      short* data = reinterpret_cast<short*>( this->get_data() );
       data[ index ] = static_cast<short>( value );
       return;
     }     
     case DataType::USHORT_E:
     {
-      unsigned short* data = reinterpret_cast<unsigned short*>( this->data_ );
+      unsigned short* data = reinterpret_cast<unsigned short*>( this->get_data() );
       data[ index ] = static_cast<unsigned short>( value );
       return;
     } 
     case DataType::INT_E:
     {
-      int* data = reinterpret_cast<int*>( this->data_ );
+      int* data = reinterpret_cast<int*>( this->get_data() );
       data[ index ] = static_cast<int>( value );
       return;
     }     
     case DataType::UINT_E:
     {
-      unsigned int* data = reinterpret_cast<unsigned int*>( this->data_ );
+      unsigned int* data = reinterpret_cast<unsigned int*>( this->get_data() );
       data[ index ] = static_cast<unsigned int>( value );
       return;
     } 
     case DataType::FLOAT_E:
     {
-      float* data = reinterpret_cast<float*>( this->data_ );
+      float* data = reinterpret_cast<float*>( this->get_data() );
       data[ index ] = static_cast<float>( value );
       return;
     }     
     case DataType::DOUBLE_E:
     {
-      double* data = reinterpret_cast<double*>( this->data_ );
+      double* data = reinterpret_cast<double*>( this->get_data() );
       data[ index ] = value;
       return;
     }
@@ -189,43 +206,223 @@ void DataBlock::set_nz( size_t nz )
 
 void DataBlock::set_data( void* data )
 {
-  // TODO: this leaks memory
-  // Make unit tests before attempting to correct
   // TODO: no updates to size, type etc, data structure can be corrupted
-  this->data_ = data;
+  {
+    boost::mutex::scoped_lock lock( this->data_mutex_ );
+    this->shared_data_.reset();
+    this->data_ = data;
+  }
+  this->invalidate_histogram();
+}
+
+template< class T >
+static boost::shared_ptr< void > AllocateTypedData( size_t size )
+{
+  return boost::shared_ptr< void >( new T[ size ], boost::checked_array_deleter< T >() );
+}
+
+static boost::shared_ptr< void > AllocateData( DataType type, size_t size )
+{
+  switch( type )
+  {
+    case DataType::CHAR_E:
+      return AllocateTypedData< signed char >( size );
+    case DataType::UCHAR_E:
+      return AllocateTypedData< unsigned char >( size );
+    case DataType::SHORT_E:
+      return AllocateTypedData< short >( size );
+    case DataType::USHORT_E:
+      return AllocateTypedData< unsigned short >( size );
+    case DataType::INT_E:
+      return AllocateTypedData< int >( size );
+    case DataType::UINT_E:
+      return AllocateTypedData< unsigned int >( size );
+    case DataType::FLOAT_E:
+      return AllocateTypedData< float >( size );
+    case DataType::DOUBLE_E:
+      return AllocateTypedData< double >( size );
+    default:
+      return boost::shared_ptr< void >();
+  }
+}
+
+void DataBlock::allocate_data()
+{
+  boost::shared_ptr< void > data = AllocateData( this->data_type_, this->get_size() );
+
+  boost::mutex::scoped_lock lock( this->data_mutex_ );
+  this->shared_data_ = data;
+  this->data_ = data.get();
+}
+
+bool DataBlock::share_data( const DataBlock& src )
+{
+  boost::shared_ptr< void > data;
+  {
+    boost::mutex::scoped_lock src_lock( src.data_mutex_ );
+    if ( !src.shared_data_ || src.sharing_disabled_ ) return false;
+    data = src.shared_data_;
+  }
+
+  boost::mutex::scoped_lock lock( this->data_mutex_ );
+  this->shared_data_ = data;
+  this->data_ = data.get();
+  return true;
+}
+
+void* DataBlock::get_data()
+{
+  boost::mutex::scoped_lock lock( this->data_mutex_ );
+  if ( this->shared_data_ && this->shared_data_.use_count() > 1 )
+  {
+    // The data is shared with a duplicate, copy it before it is written to. The shared
+    // memory stays with the other data blocks.
+    boost::shared_ptr< void > data = AllocateData( this->data_type_, this->get_size() );
+    std::memcpy( data.get(), this->data_, this->get_byte_size() );
+    this->shared_data_ = data;
+    this->data_ = data.get();
+  }
+  return this->data_;
+}
+
+bool DataBlock::is_shared() const
+{
+  boost::mutex::scoped_lock lock( this->data_mutex_ );
+  return this->shared_data_ && this->shared_data_.use_count() > 1;
+}
+
+void DataBlock::disable_sharing()
+{
+  boost::mutex::scoped_lock lock( this->data_mutex_ );
+  this->sharing_disabled_ = true;
 }
 
-// TODO: how do we know histogram is correct for data???
 void DataBlock::set_histogram( const Histogram& histogram )
 {
-  this->histogram_ = histogram;
+  {
+    boost::mutex::scoped_lock lock( this->histogram_mutex_ );
+    this->histogram_ = histogram;
+    this->histogram_stamp_ = this->data_stamp_;
+  }
+  this->histogram_changed_signal_();
 }
 
 double DataBlock::get_max() const
 {
+  this->compute_histogram();
+  boost::mutex::scoped_lock lock( this->histogram_mutex_ );
   return this->histogram_.get_max();
 }
 
 double DataBlock::get_min() const
 {
+  this->compute_histogram();
+  boost::mutex::scoped_lock lock( this->histogram_mutex_ );
   return this->histogram_.get_min();
 }
 
 double DataBlock::get_range() const
 {
+  this->compute_histogram();
+  boost::mutex::scoped_lock lock( this->histogram_mutex_ );
   return this->histogram_.get_max() - this->histogram_.get_min();
 }
 
-const Histogram& DataBlock::get_histogram() const
+Histogram DataBlock::get_histogram() const
 {
+  this->compute_histogram();
+  boost::mutex::scoped_lock lock( this->histogram_mutex_ );
   return this->histogram_;
 }
 
+bool DataBlock::has_histogram() const
+{
+  boost::mutex::scoped_lock lock( this->histogram_mutex_ );
+  return this->histogram_stamp_ == this->data_stamp_;
+}
+
+void DataBlock::invalidate_histogram()
+{
+  boost::mutex::scoped_lock lock( this->histogram_mutex_ );
+  this->data_stamp_++;
+}
+
+bool DataBlock::compute_histogram() const
+{
+  // NOTE: The data is read without locking it, as the callers may already hold a lock on it.
+  // Writers invalidate the histogram, so a histogram computed while the data was changing is
+  // not used.
+  boost::mutex::scoped_lock compute_lock( this->histogram_compute_mutex_ );
+
+  size_t stamp;
+  {
+    boost::mutex::scoped_lock lock( this->histogram_mutex_ );
+    if ( this->histogram_stamp_ == this->data_stamp_ ) return false;
+    stamp = this->data_stamp_;
+  }
+
+  Histogram histogram;
+  void* data = this->data_;
+  switch( this->data_type_ )
+  {
+    case DataType::CHAR_E:
+      histogram.compute( reinterpret_cast<signed char*>( data ), this->get_size() );
+      break;
+    case DataType::UCHAR_E:
+      histogram.compute( reinterpret_cast<unsigned char*>( data ), this->get_size() );
+      break;
+    case DataType::SHORT_E:
+      histogram.compute( reinterpret_cast<short*>( data ), this->get_size() );
+      break;
+    case DataType::USHORT_E:
+      histogram.compute( reinterpret_cast<unsigned short*>( data ), this->get_size() );
+      break;
+    case DataType::INT_E:
+      histogram.compute( reinterpret_cast<int*>( data ), this->get_size() );
+      break;
+    case DataType::UINT_E:
+      histogram.compute( reinterpret_cast<unsigned int*>( data ), this->get_size() );
+      break;
+    case DataType::FLOAT_E:
+      histogram.compute( reinterpret_cast<float*>( data ), this->get_size() );
+      break;
+    case DataType::DOUBLE_E:
+      histogram.compute( reinterpret_cast<double*>( data ), this->get_size() );
+      break;
+  }
+
+  {
+    boost::mutex::scoped_lock lock( this->histogram_mutex_ );
+    this->histogram_ = histogram;
+    this->histogram_stamp_ = stamp;
+  }
+
+  compute_lock.unlock();
+  this->histogram_changed_signal_();
+  return true;
+}
+
+static void ComputeRequestedHistogram( DataBlockHandle data_block )
+{
+  data_block->get_histogram();
+}
+
+void DataBlock::RequestHistogram( const DataBlockHandle& data_block )
+{
+  if ( !data_block ) return;
+  {
+    boost::mutex::scoped_lock lock( data_block->histogram_mutex_ );
+    if ( data_block->histogram_stamp_ == data_block->data_stamp_ ) return;
+  }
+  ThreadPool::Instance()->post( boost::bind( &ComputeRequestedHistogram, data_block ) );
+}
+
 void DataBlock::clear()
 {
   lock_type lock( this->get_mutex() );
-  memset( this->data_, 0, Core::GetSizeDataType( this->data_type_ ) * this->get_size() );
+  memset( this->get_data(), 0, Core::GetSizeDataType( this->data_type_ ) * this->get_size() );
   this->generation_ = DataBlockManager::Instance()->increase_generation( this->generation_ );
+  this->invalidate_histogram();
 }
 
 DataBlock::generation_type DataBlock::get_generation() const
@@ -247,35 +444,17 @@ void DataBlock::increase_generation()
 
 bool DataBlock::update_histogram()
 {
-  lock_type lock( this->get_mutex() );
-
-  switch( this->data_type_ )
-  {
-    case DataType::CHAR_E:
-      return this->histogram_.compute( reinterpret_cast<signed char*>( get_data() ), get_size() );
-    case DataType::UCHAR_E:
-      return this->histogram_.compute( reinterpret_cast<unsigned char*>( get_data() ), get_size() );
-    case DataType::SHORT_E:
-      return this->histogram_.compute( reinterpret_cast<short*>( get_data() ), get_size() );
-    case DataType::USHORT_E:
-      return this->histogram_.compute( reinterpret_cast<unsigned short*>( get_data() ), get_size() );
-    case DataType::INT_E:
-      return this->histogram_.compute( reinterpret_cast<int*>( get_data() ), get_size() );
-    case DataType::UINT_E:
-      return this->histogram_.compute( reinterpret_cast<unsigned int*>( get_data() ), get_size() );
-    case DataType::FLOAT_E:
-      return this->histogram_.compute( reinterpret_cast<float*>( get_data() ), get_size() );
-    case DataType::DOUBLE_E:
-      return this->histogram_.compute( reinterpret_cast<double*>( get_data() ), get_size() );
-  }
-
-  return false;
+  shared_lock_type lock( this->get_mutex() );
+  this->invalidate_histogram();
+  this->compute_histogram();
+  return this->get_histogram().is_valid();
 }
 
 // same as set_type()
 void DataBlock::update_data_type( DataType type )
 {
   this->data_type_ = type;
+  this->invalidate_histogram();
 }
 
 size_t DataBlock::get_elem_size() const
@@ -470,191 +649,88 @@ void DataBlock::swap_endian()
       SwapEndian( get_data(), get_size(), 8 );
       break;
   }
+
+  this->invalidate_histogram();
 }
 
 
-template<class DATA>
-static bool ConvertDataTypeInternal( DATA* src, DataBlockHandle& dst_data_block )
+// Minimum number of values handled by one chunk of the kernels below, splitting up less data
+// costs more in thread synchronization than it gains
+static const size_t KERNEL_GRAIN_SIZE_C = 0x40000;
+
+// Number of items of the given size that make up one chunk of work
+static size_t GetGrainSize( size_t item_size )
+{
+  return std::max< size_t >( 1, KERNEL_GRAIN_SIZE_C / std::max< size_t >( item_size, 1 ) );
+}
+
+// CLASS CONVERTKERNEL:
+// Casts each value to the destination type. The loop has no branches and the pointers do not
+// alias, hence the compiler generates SIMD conversions for every pair of types.
+template< class SRC, class DST >
+class ConvertKernel
+{
+public:
+  ConvertKernel( const SRC* src, DST* dst ) :
+    src_( src ),
+    dst_( dst )
+  {
+  }
+
+  void process( size_t begin, size_t end ) const
+  {
+    const SRC* __restrict src = this->src_;
+    DST* __restrict dst = this->dst_;
+    for ( size_t j = begin; j < end; j++ )
+    {
+      dst[ j ] = static_cast< DST >( src[ j ] );
+    }
+  }
+
+private:
+  const SRC* src_;
+  DST* dst_;
+};
+
+template< class SRC, class DST >
+static void ConvertValues( const SRC* src, DST* dst, size_t size )
+{
+  ConvertKernel< SRC, DST > kernel( src, dst );
+  Parallel::For( 0, size, boost::bind( &ConvertKernel< SRC, DST >::process, &kernel, _1, _2 ),
+    KERNEL_GRAIN_SIZE_C );
+}
+
+template< class SRC >
+static bool ConvertDataTypeInternal( const SRC* src, DataBlockHandle& dst_data_block )
 {
   size_t size = dst_data_block->get_size();
+  void* dst = dst_data_block->get_data();
   switch ( dst_data_block->get_data_type() )
   {
-    case DataType::CHAR_E:  
-    {
-      signed char* dst = reinterpret_cast<signed char*>( dst_data_block->get_data() );
-      size_t size8 = size & ~(0x7);
-      size_t j = 0;
-      for ( ; j < size8; j+=8 )
-      {
-        dst[ j ] = static_cast<signed char>( src[ j ] );
-        dst[ j + 1 ] = static_cast<signed char>( src[ j + 1 ] );
-        dst[ j + 2 ] = static_cast<signed char>( src[ j + 2 ] );
-        dst[ j + 3 ] = static_cast<signed char>( src[ j + 3 ] );
-        dst[ j + 4 ] = static_cast<signed char>( src[ j + 4 ] );
-        dst[ j + 5 ] = static_cast<signed char>( src[ j + 5 ] );
-        dst[ j + 6 ] = static_cast<signed char>( src[ j + 6 ] );
-        dst[ j + 7 ] = static_cast<signed char>( src[ j + 7 ] );
-      }
-      for ( ; j < size; j++ )
-      {
-        dst[ j ] = static_cast<signed char>( src[ j ] );
-      }
+    case DataType::CHAR_E:
+      ConvertValues( src, reinterpret_cast< signed char* >( dst ), size );
       return true;
-    }
-    case DataType::UCHAR_E: 
-    {
-      unsigned char* dst = reinterpret_cast<unsigned char*>( dst_data_block->get_data() );
-      size_t size8 = size & ~(0x7);
-      size_t j = 0;
-      for ( ; j < size8; j+=8 )
-      {
-        dst[ j ] = static_cast<unsigned char>( src[ j ] );
-        dst[ j + 1 ] = static_cast<unsigned char>( src[ j + 1 ] );
-        dst[ j + 2 ] = static_cast<unsigned char>( src[ j + 2 ] );
-        dst[ j + 3 ] = static_cast<unsigned char>( src[ j + 3 ] );
-        dst[ j + 4 ] = static_cast<unsigned char>( src[ j + 4 ] );
-        dst[ j + 5 ] = static_cast<unsigned char>( src[ j + 5 ] );
-        dst[ j + 6 ] = static_cast<unsigned char>( src[ j + 6 ] );
-        dst[ j + 7 ] = static_cast<unsigned char>( src[ j + 7 ] );
-      }
-      for ( ; j < size; j++ )
-      {
-        dst[ j ] = static_cast<unsigned char>( src[ j ] );
-      }     
+    case DataType::UCHAR_E:
+      ConvertValues( src, reinterpret_cast< unsigned char* >( dst ), size );
       return true;
-    }
-    case DataType::SHORT_E: 
-    {
-      short* dst = reinterpret_cast<short*>( dst_data_block->get_data() );
-      size_t size8 = size & ~(0x7);
-      size_t j = 0;
-      for ( ; j < size8; j+=8 )
-      {
-        dst[ j ] = static_cast<short>( src[ j ] );
-        dst[ j + 1 ] = static_cast<short>( src[ j + 1 ] );
-        dst[ j + 2 ] = static_cast<short>( src[ j + 2 ] );
-        dst[ j + 3 ] = static_cast<short>( src[ j + 3 ] );
-        dst[ j + 4 ] = static_cast<short>( src[ j + 4 ] );
-        dst[ j + 5 ] = static_cast<short>( src[ j + 5 ] );
-        dst[ j + 6 ] = static_cast<short>( src[ j + 6 ] );
-        dst[ j + 7 ] = static_cast<short>( src[ j + 7 ] );
-      }
-      for ( ; j < size; j++ )
-      {
-        dst[ j ] = static_cast<short>( src[ j ] );
-      }     
+    case DataType::SHORT_E:
+      ConvertValues( src, reinterpret_cast< short* >( dst ), size );
       return true;
-    }
-    case DataType::USHORT_E:  
-    {
-      unsigned short* dst = reinterpret_cast<unsigned short*>( dst_data_block->get_data() );
-      size_t size8 = size & ~(0x7);
-      size_t j = 0;
-      for ( ; j < size8; j+=8 )
-      {
-        dst[ j ] = static_cast<unsigned short>( src[ j ] );
-        dst[ j + 1 ] = static_cast<unsigned short>( src[ j + 1 ] );
-        dst[ j + 2 ] = static_cast<unsigned short>( src[ j + 2 ] );
-        dst[ j + 3 ] = static_cast<unsigned short>( src[ j + 3 ] );
-        dst[ j + 4 ] = static_cast<unsigned short>( src[ j + 4 ] );
-        dst[ j + 5 ] = static_cast<unsigned short>( src[ j + 5 ] );
-        dst[ j + 6 ] = static_cast<unsigned short>( src[ j + 6 ] );
-        dst[ j + 7 ] = static_cast<unsigned short>( src[ j + 7 ] );
-      }
-      for ( ; j < size; j++ )
-      {
-        dst[ j ] = static_cast<unsigned short>( src[ j ] );
-      } 
+    case DataType::USHORT_E:
+      ConvertValues( src, reinterpret_cast< unsigned short* >( dst ), size );
       return true;
-    }
-    case DataType::INT_E: 
-    {
-      int* dst = reinterpret_cast<int*>( dst_data_block->get_data() );
-      size_t size8 = size & ~(0x7);
-      size_t j = 0;
-      for ( ; j < size8; j+=8 )
-      {
-        dst[ j ] = static_cast<int>( src[ j ] );
-        dst[ j + 1 ] = static_cast<int>( src[ j + 1 ] );
-        dst[ j + 2 ] = static_cast<int>( src[ j + 2 ] );
-        dst[ j + 3 ] = static_cast<int>( src[ j + 3 ] );
-        dst[ j + 4 ] = static_cast<int>( src[ j + 4 ] );
-        dst[ j + 5 ] = static_cast<int>( src[ j + 5 ] );
-        dst[ j + 6 ] = static_cast<int>( src[ j + 6 ] );
-        dst[ j + 7 ] = static_cast<int>( src[ j + 7 ] );
-      }
-      for ( ; j < size; j++ )
-      {
-        dst[ j ] = static_cast<int>( src[ j ] );
-      }   
+    case DataType::INT_E:
+      ConvertValues( src, reinterpret_cast< int* >( dst ), size );
       return true;
-    }
-    case DataType::UINT_E:  
-    {
-      unsigned int* dst = reinterpret_cast<unsigned int*>( dst_data_block->get_data() );
-      size_t size8 = size & ~(0x7);
-      size_t j = 0;
-      for ( ; j < size8; j+=8 )
-      {
-        dst[ j ] = static_cast<unsigned int>( src[ j ] );
-        dst[ j + 1 ] = static_cast<unsigned int>( src[ j + 1 ] );
-        dst[ j + 2 ] = static_cast<unsigned int>( src[ j + 2 ] );
-        dst[ j + 3 ] = static_cast<unsigned int>( src[ j + 3 ] );
-        dst[ j + 4 ] = static_cast<unsigned int>( src[ j + 4 ] );
-        dst[ j + 5 ] = static_cast<unsigned int>( src[ j + 5 ] );
-        dst[ j + 6 ] = static_cast<unsigned int>( src[ j + 6 ] );
-        dst[ j + 7 ] = static_cast<unsigned int>( src[ j + 7 ] );
-      }
-      for ( ; j < size; j++ )
-      {
-        dst[ j ] = static_cast<unsigned int>( src[ j ] );
-      } 
+    case DataType::UINT_E:
+      ConvertValues( src, reinterpret_cast< unsigned int* >( dst ), size );
       return true;
-    }
-    case DataType::FLOAT_E: 
-    {
-      float* dst = reinterpret_cast<float*>( dst_data_block->get_data() );
-      size_t size8 = size & ~(0x7);
-      size_t j = 0;
-      for ( ; j < size8; j+=8 )
-      {
-        dst[ j ] = static_cast<float>( src[ j ] );
-        dst[ j + 1 ] = static_cast<float>( src[ j + 1 ] );
-        dst[ j + 2 ] = static_cast<float>( src[ j + 2 ] );
-        dst[ j + 3 ] = static_cast<float>( src[ j + 3 ] );
-        dst[ j + 4 ] = static_cast<float>( src[ j + 4 ] );
-        dst[ j + 5 ] = static_cast<float>( src[ j + 5 ] );
-        dst[ j + 6 ] = static_cast<float>( src[ j + 6 ] );
-        dst[ j + 7 ] = static_cast<float>( src[ j + 7 ] );
-      }
-      for ( ; j < size; j++ )
-      {
-        dst[ j ] = static_cast<float>( src[ j ] );
-      }       
+    case DataType::FLOAT_E:
+      ConvertValues( src, reinterpret_cast< float* >( dst ), size );
       return true;
-    }
-    case DataType::DOUBLE_E:  
-    {
-      double* dst = reinterpret_cast<double*>( dst_data_block->get_data() );
-            size_t size8 = size & ~(0x7);
-      size_t j = 0;
-      for ( ; j < size8; j+=8 )
-      {
-        dst[ j ] = static_cast<double>( src[ j ] );
-        dst[ j + 1 ] = static_cast<double>( src[ j + 1 ] );
-        dst[ j + 2 ] = static_cast<double>( src[ j + 2 ] );
-        dst[ j + 3 ] = static_cast<double>( src[ j + 3 ] );
-        dst[ j + 4 ] = static_cast<double>( src[ j + 4 ] );
-        dst[ j + 5 ] = static_cast<double>( src[ j + 5 ] );
-        dst[ j + 6 ] = static_cast<double>( src[ j + 6 ] );
-        dst[ j + 7 ] = static_cast<double>( src[ j + 7 ] );
-      }
-      for ( ; j < size; j++ )
-      {
-        dst[ j ] = static_cast<double>( src[ j ] );
-      } 
+    case DataType::DOUBLE_E:
+      ConvertValues( src, reinterpret_cast< double* >( dst ), size );
       return true;
-    }
     default:
     {
       dst_data_block.reset();
@@ -684,45 +760,139 @@ bool DataBlock::ConvertDataType( const DataBlockHandle& src_data_block,
   {
     case DataType::CHAR_E:
       return ConvertDataTypeInternal<signed char>( 
-        reinterpret_cast<signed char*>( src_data_block->get_data() ), dst_data_block );
+        reinterpret_cast<const signed char*>( src_data_block->get_const_data() ), dst_data_block );
     case DataType::UCHAR_E:
       return ConvertDataTypeInternal<unsigned char>( 
-        reinterpret_cast<unsigned char*>( src_data_block->get_data() ), dst_data_block );
+        reinterpret_cast<const unsigned char*>( src_data_block->get_const_data() ), dst_data_block );
     case DataType::SHORT_E:
       return ConvertDataTypeInternal<short>( 
-        reinterpret_cast<short*>( src_data_block->get_data() ), dst_data_block );
+        reinterpret_cast<const short*>( src_data_block->get_const_data() ), dst_data_block );
     case DataType::USHORT_E:
       return ConvertDataTypeInternal<unsigned short>( 
-        reinterpret_cast<unsigned short*>( src_data_block->get_data() ), dst_data_block );
+        reinterpret_cast<const unsigned short*>( src_data_block->get_const_data() ), dst_data_block );
     case DataType::INT_E:
       return ConvertDataTypeInternal<int>( 
-        reinterpret_cast<int*>( src_data_block->get_data() ), dst_data_block );
+        reinterpret_cast<const int*>( src_data_block->get_const_data() ), dst_data_block );
     case DataType::UINT_E:
       return ConvertDataTypeInternal<unsigned int>( 
-        reinterpret_cast<unsigned int*>( src_data_block->get_data() ), dst_data_block );
+        reinterpret_cast<const unsigned int*>( src_data_block->get_const_data() ), dst_data_block );
     case DataType::FLOAT_E:
       return ConvertDataTypeInternal<float>( 
-        reinterpret_cast<float*>( src_data_block->get_data() ), dst_data_block );
+        reinterpret_cast<const float*>( src_data_block->get_const_data() ), dst_data_block );
     case DataType::DOUBLE_E:
       return ConvertDataTypeInternal<double>( 
-        reinterpret_cast<double*>( src_data_block->get_data() ), dst_data_block );
+        reinterpret_cast<const double*>( src_data_block->get_const_data() ), dst_data_block );
     default:
       dst_data_block.reset();
       return false;
   }
 }
 
+// Edge length of the cubic tiles that PermuteData copies at once. A tile of doubles takes up
+// 32kB in both the source and the destination and stays in the cache while it is transposed.
+static const DataBlock::index_type PERMUTE_TILE_SIZE_C = 16;
+
+// CLASS PERMUTEKERNEL:
+// Copies the source into the permuted destination. When the destination rows map onto source
+// rows the rows are copied as a whole, otherwise the copy is done tile by tile, so the strided
+// reads do not evict the data that is still needed.
+template< class DATA >
+class PermuteKernel
+{
+public:
+  typedef DataBlock::index_type index_type;
+
+  PermuteKernel( const DATA* src, DATA* dst, const index_type start[ 3 ], 
+    const index_type stride[ 3 ], index_type dnx, index_type dny, index_type dnz ) :
+    src_( src + start[ 0 ] + start[ 1 ] + start[ 2 ] ),
+    dst_( dst ),
+    dnx_( dnx ),
+    dny_( dny ),
+    dnz_( dnz ),
+    num_tiles_y_( ( dny + PERMUTE_TILE_SIZE_C - 1 ) / PERMUTE_TILE_SIZE_C )
+  {
+    for ( int j = 0; j < 3; j++ ) this->stride_[ j ] = stride[ j ];
+  }
+
+  size_t get_num_tile_rows() const
+  {
+    index_type num_tiles_z = ( this->dnz_ + PERMUTE_TILE_SIZE_C - 1 ) / PERMUTE_TILE_SIZE_C;
+    return static_cast< size_t >( this->num_tiles_y_ * num_tiles_z );
+  }
+
+  size_t get_tile_row_size() const
+  {
+    return static_cast< size_t >( this->dnx_ * PERMUTE_TILE_SIZE_C * PERMUTE_TILE_SIZE_C );
+  }
+
+  // PROCESS:
+  // Each index in [begin, end) is a row of tiles along the x axis of the destination.
+  void process( size_t begin, size_t end ) const
+  {
+    index_type dnxy = this->dnx_ * this->dny_;
+    for ( size_t t = begin; t < end; t++ )
+    {
+      index_type y_begin = ( static_cast< index_type >( t ) % this->num_tiles_y_ ) * 
+        PERMUTE_TILE_SIZE_C;
+      index_type z_begin = ( static_cast< index_type >( t ) / this->num_tiles_y_ ) * 
+        PERMUTE_TILE_SIZE_C;
+      index_type y_end = std::min( y_begin + PERMUTE_TILE_SIZE_C, this->dny_ );
+      index_type z_end = std::min( z_begin + PERMUTE_TILE_SIZE_C, this->dnz_ );
+
+      if ( this->stride_[ 0 ] == 1 )
+      {
+        for ( index_type z = z_begin; z < z_end; z++ )
+        {
+          for ( index_type y = y_begin; y < y_end; y++ )
+          {
+            const DATA* src = this->src_ + y * this->stride_[ 1 ] + z * this->stride_[ 2 ];
+            std::copy( src, src + this->dnx_, this->dst_ + y * this->dnx_ + z * dnxy );
+          }
+        }
+        continue;
+      }
+
+      for ( index_type x_begin = 0; x_begin < this->dnx_; x_begin += PERMUTE_TILE_SIZE_C )
+      {
+        index_type x_end = std::min( x_begin + PERMUTE_TILE_SIZE_C, this->dnx_ );
+        for ( index_type z = z_begin; z < z_end; z++ )
+        {
+          for ( index_type y = y_begin; y < y_end; y++ )
+          {
+            const DATA* src = this->src_ + y * this->stride_[ 1 ] + z * this->stride_[ 2 ];
+            DATA* dst = this->dst_ + y * this->dnx_ + z * dnxy;
+            index_type sx_stride = this->stride_[ 0 ];
+            for ( index_type x = x_begin; x < x_end; x++ )
+            {
+              dst[ x ] = src[ x * sx_stride ];
+            }
+          }
+        }
+      }
+    }
+  }
+
+private:
+  const DATA* src_;
+  DATA* dst_;
+  index_type stride_[ 3 ];
+  index_type dnx_;
+  index_type dny_;
+  index_type dnz_;
+  index_type num_tiles_y_;
+};
+
 template<class DATA>
 static bool PermuteDataInternal( const DataBlockHandle& src_data_block, 
   DataBlockHandle& dst_data_block, std::vector<int>& permutation )
 {
-  DATA* src = reinterpret_cast<DATA*>( src_data_block->get_data() );
+  const DATA* src = reinterpret_cast<const DATA*>( src_data_block->get_const_data() );
   DATA* dst = reinterpret_cast<DATA*>( dst_data_block->get_data() );
 
   typedef DataBlock::index_type index_type;
 
-  std::vector<index_type> start(3);
-  std::vector<index_type> stride(3);
+  index_type start[ 3 ] = { 0, 0, 0 };
+  index_type stride[ 3 ] = { 0, 0, 0 };
   
   index_type nx = static_cast<index_type>( src_data_block->get_nx() );
   index_type ny = static_cast<index_type>( src_data_block->get_ny() );
@@ -764,34 +934,17 @@ static bool PermuteDataInternal( const DataBlockHandle& src_data_block,
     }
   }
   
-  index_type dnx = static_cast<index_type>( dst_data_block->get_nx() );
-  index_type dny = static_cast<index_type>( dst_data_block->get_ny() );
-  index_type dnz = static_cast<index_type>( dst_data_block->get_nz() );
-  index_type dnxy = dnx * dny;
-  index_type dnxyz = dnx * dny * dnz;
-  index_type sz = start[ 2 ];
-  index_type sz_stride = stride[ 2 ];
-  for ( index_type dz = 0; dz < dnxyz; dz += dnxy )
-  {
-    index_type sy = start[ 1 ];
-    index_type sy_stride = stride[ 1 ];
-    for ( index_type dy = 0; dy < dnxy; dy += dnx )
-    {
-      index_type sx = start[ 0 ];
-      index_type sx_stride = stride[ 0 ];
-      for ( index_type dx = 0; dx < dnx; dx++ )
-      {
-        dst[ dx + dy + dz ] = src[ sx + sy + sz ];
-        sx += sx_stride;
-      }
-      sy += sy_stride;
-    }
-    sz += sz_stride;
-  }
+  PermuteKernel< DATA > kernel( src, dst, start, stride, 
+    static_cast<index_type>( dst_data_block->get_nx() ), 
+    static_cast<index_type>( dst_data_block->get_ny() ),
+    static_cast<index_type>( dst_data_block->get_nz() ) );
+  Parallel::For( 0, kernel.get_num_tile_rows(), boost::bind( &PermuteKernel< DATA >::process, 
+    &kernel, _1, _2 ), GetGrainSize( kernel.get_tile_row_size() ) );
   
   return true;
 }
 
+
 bool DataBlock::PermuteData( const DataBlockHandle& src_data_block, 
   DataBlockHandle& dst_data_block, std::vector<int> permutation )
 {
@@ -855,110 +1008,114 @@ bool DataBlock::PermuteData( const DataBlockHandle& src_data_block,
 }
 
 
-template<class DATA>
-static bool QuantizeDataInternal( double min, double max, DATA* src, DataBlockHandle& dst_data_block )
+// The arithmetic of the quantization is done in float for 8 and 16 bit results and in double
+// for 32 bit results, which need the extra precision.
+template< class DST >
+struct QuantizeTraits
 {
-  float fmin = static_cast<float>( min );
-  float fmax = static_cast<float>( max );
-  
-  size_t size = dst_data_block->get_size();
-  switch ( dst_data_block->get_data_type() )
+  typedef float compute_type;
+};
+
+template<>
+struct QuantizeTraits< int >
+{
+  typedef double compute_type;
+};
+
+template<>
+struct QuantizeTraits< unsigned int >
+{
+  typedef double compute_type;
+};
+
+// CLASS QUANTIZEKERNEL:
+// Maps [min, max] linearly onto the full range of the integer type DST. The value is quantized
+// as an offset from the lowest value of DST, which is never negative, hence the cast rounds down
+// for signed types as well. The scaled value is clamped before the cast, as the maximum itself
+// maps just past the end of the range. Like the conversion kernel the loop has no branches and
+// is vectorized.
+template< class SRC, class DST >
+class QuantizeKernel
+{
+public:
+  typedef typename QuantizeTraits< DST >::compute_type compute_type;
+  typedef typename std::make_unsigned< DST >::type unsigned_type;
+
+  QuantizeKernel( double min, double max, const SRC* src, DST* dst ) :
+    src_( src ),
+    dst_( dst ),
+    min_( static_cast< compute_type >( min ) ),
+    multiplier_( 0 ),
+    range_( static_cast< compute_type >( std::numeric_limits< unsigned_type >::max() ) ),
+    lowest_( static_cast< unsigned_type >( std::numeric_limits< DST >::min() ) )
   {
-    case DataType::CHAR_E:  
+    compute_type cmax = static_cast< compute_type >( max );
+    if ( cmax > this->min_ ) 
     {
-      signed char* dst = reinterpret_cast<signed char*>( dst_data_block->get_data() );
-
-      float offset = 0.5f - static_cast<float>( 0x80 );
-      float multiplier = 0.0f;
-      if ( fmax > fmin ) multiplier = static_cast<float>( 0x100 ) / (fmax - fmin);
-      
-      for ( size_t j = 0 ; j < size; j++ )
-      {
-        dst[ j ] = static_cast<signed char>( multiplier * 
-          (static_cast<float>( src[ j ] ) - fmin)  + offset );
-      }
-      
-      return true;
+      this->multiplier_ = ( this->range_ + 1 ) / ( cmax - this->min_ );
     }
-    case DataType::UCHAR_E: 
+  }
+
+  void process( size_t begin, size_t end ) const
+  {
+    const SRC* __restrict src = this->src_;
+    DST* __restrict dst = this->dst_;
+    const compute_type zero = 0;
+    const compute_type half = static_cast< compute_type >( 0.5 );
+    for ( size_t j = begin; j < end; j++ )
     {
-      unsigned char* dst = reinterpret_cast<unsigned char*>( dst_data_block->get_data() );
-      
-      float offset = 0.5f;
-      float multiplier = 0.0f;
-      if ( fmax > fmin ) multiplier = static_cast<float>( 0x100 ) / (fmax - fmin);
-             
-      for ( size_t j = 0 ; j < size; j++ )
-      {
-        dst[ j ] = static_cast<unsigned char>( multiplier * 
-          (static_cast<float>( src[ j ] ) - fmin)  + offset );
-      }
-      return true;
+      compute_type value = this->multiplier_ * ( static_cast< compute_type >( src[ j ] ) - 
+        this->min_ ) + half;
+      value = value > zero ? value : zero;
+      value = value < this->range_ ? value : this->range_;
+      // Adding the lowest value wraps around for signed types
+      dst[ j ] = static_cast< DST >( static_cast< unsigned_type >( 
+        static_cast< unsigned_type >( value ) + this->lowest_ ) );
     }
-    case DataType::SHORT_E: 
-    {
-      short* dst = reinterpret_cast<short*>( dst_data_block->get_data() );
+  }
 
-      float offset = 0.5f - static_cast<float>( 0x8000 );
-      float multiplier = 0.0f;
-      if ( fmax > fmin ) multiplier = static_cast<float>( 0x10000 ) / (fmax - fmin);
-      
-      for ( size_t j = 0 ; j < size; j++ )
-      {
-        dst[ j ] = static_cast<short>( multiplier * 
-          (static_cast<float>( src[ j ] ) - fmin)  + offset );
-      }
-      
-      return true;
-    }
-    case DataType::USHORT_E:  
-    {
-      unsigned short* dst = reinterpret_cast<unsigned short*>( dst_data_block->get_data() );
+private:
+  const SRC* src_;
+  DST* dst_;
+  compute_type min_;
+  compute_type multiplier_;
+  compute_type range_;
+  unsigned_type lowest_;
+};
+
+template< class SRC, class DST >
+static void QuantizeValues( double min, double max, const SRC* src, DST* dst, size_t size )
+{
+  QuantizeKernel< SRC, DST > kernel( min, max, src, dst );
+  Parallel::For( 0, size, boost::bind( &QuantizeKernel< SRC, DST >::process, &kernel, _1, _2 ),
+    KERNEL_GRAIN_SIZE_C );
+}
 
-      float offset = 0.5f;
-      float multiplier = 0.0f;
-      if ( fmax > fmin ) multiplier = static_cast<float>( 0x10000 ) / (fmax - fmin);
-      
-      for ( size_t j = 0 ; j < size; j++ )
-      {
-        dst[ j ] = static_cast<unsigned short>( multiplier * 
-          (static_cast<float>( src[ j ] ) - fmin)  + offset);
-      }
-      
+template<class DATA>
+static bool QuantizeDataInternal( double min, double max, const DATA* src, DataBlockHandle& dst_data_block )
+{
+  size_t size = dst_data_block->get_size();
+  void* dst = dst_data_block->get_data();
+  switch ( dst_data_block->get_data_type() )
+  {
+    case DataType::CHAR_E:
+      QuantizeValues( min, max, src, reinterpret_cast< signed char* >( dst ), size );
       return true;
-    }
-    case DataType::INT_E: 
-    {
-      int* dst = reinterpret_cast<int*>( dst_data_block->get_data() );
-
-      double offset = 0.5 -  static_cast<double>( 0x80000000 );
-      double multiplier = 0.0;
-      if ( max > min ) multiplier = static_cast<double>( 0x100000000ull ) / (max - min);
-      
-      for ( size_t j = 0 ; j < size; j++ )
-      {
-        dst[ j ] = static_cast<int>( multiplier * 
-          (static_cast<double>( src[ j ] ) - min)  + offset);
-      }
-      
+    case DataType::UCHAR_E:
+      QuantizeValues( min, max, src, reinterpret_cast< unsigned char* >( dst ), size );
       return true;
-    }
-    case DataType::UINT_E:  
-    {
-      unsigned int* dst = reinterpret_cast<unsigned int*>( dst_data_block->get_data() );
-
-      double offset = 0.5;
-      double multiplier = 0.0;
-      if ( max > min ) multiplier = static_cast<double>( 0x100000000ull ) / (max - min);
-      
-      for ( size_t j = 0 ; j < size; j++ )
-      {
-        dst[ j ] = static_cast<unsigned int>( multiplier * 
-          (static_cast<double>( src[ j ] ) - min)  + offset);
-      }
-      
+    case DataType::SHORT_E:
+      QuantizeValues( min, max, src, reinterpret_cast< short* >( dst ), size );
+      return true;
+    case DataType::USHORT_E:
+      QuantizeValues( min, max, src, reinterpret_cast< unsigned short* >( dst ), size );
+      return true;
+    case DataType::INT_E:
+      QuantizeValues( min, max, src, reinterpret_cast< int* >( dst ), size );
+      return true;
+    case DataType::UINT_E:
+      QuantizeValues( min, max, src, reinterpret_cast< unsigned int* >( dst ), size );
       return true;
-    }
     default:
     {
       dst_data_block.reset();
@@ -967,6 +1124,7 @@ static bool QuantizeDataInternal( double min, double max, DATA* src, DataBlockHa
   }
 }
 
+
 bool DataBlock::QuantizeData( const DataBlockHandle& src_data_block, 
   DataBlockHandle& dst_data_block, DataType new_data_type )
 {
@@ -997,28 +1155,28 @@ bool DataBlock::QuantizeData( const DataBlockHandle& src_data_block,
   {
     case DataType::CHAR_E:
       return QuantizeDataInternal<signed char>( min, max, 
-        reinterpret_cast<signed char*>( src_data_block->get_data() ), dst_data_block );
+        reinterpret_cast<const signed char*>( src_data_block->get_const_data() ), dst_data_block );
     case DataType::UCHAR_E:
       return QuantizeDataInternal<unsigned char>( min, max, 
-        reinterpret_cast<unsigned char*>( src_data_block->get_data() ), dst_data_block );
+        reinterpret_cast<const unsigned char*>( src_data_block->get_const_data() ), dst_data_block );
     case DataType::SHORT_E:
       return QuantizeDataInternal<short>( min, max,
-        reinterpret_cast<short*>( src_data_block->get_data() ), dst_data_block );
+        reinterpret_cast<const short*>( src_data_block->get_const_data() ), dst_data_block );
     case DataType::USHORT_E:
       return QuantizeDataInternal<unsigned short>( min, max,
-        reinterpret_cast<unsigned short*>( src_data_block->get_data() ), dst_data_block );
+        reinterpret_cast<const unsigned short*>( src_data_block->get_const_data() ), dst_data_block );
     case DataType::INT_E:
       return QuantizeDataInternal<int>( min, max,
-        reinterpret_cast<int*>( src_data_block->get_data() ), dst_data_block );
+        reinterpret_cast<const int*>( src_data_block->get_const_data() ), dst_data_block );
     case DataType::UINT_E:
       return QuantizeDataInternal<unsigned int>( min, max,
-        reinterpret_cast<unsigned int*>( src_data_block->get_data() ), dst_data_block );
+        reinterpret_cast<const unsigned int*>( src_data_block->get_const_data() ), dst_data_block );
     case DataType::FLOAT_E:
       return QuantizeDataInternal<float>( min, max,
-        reinterpret_cast<float*>( src_data_block->get_data() ), dst_data_block );
+        reinterpret_cast<const float*>( src_data_block->get_const_data() ), dst_data_block );
     case DataType::DOUBLE_E:
       return QuantizeDataInternal<double>( min, max,
-        reinterpret_cast<double*>( src_data_block->get_data() ), dst_data_block );
+        reinterpret_cast<const double*>( src_data_block->get_const_data() ), dst_data_block );
     default:
       return false;
   }
@@ -1030,49 +1188,57 @@ bool DataBlock::Duplicate( const DataBlockHandle& src_data_block,
   // Step (1) : Check whether there is a source data block
   dst_data_block.reset();
   if ( !src_data_block ) return false;
+  if ( src_data_block->get_data_type() == DataType::UNKNOWN_E ) return false;
 
   // Step (2) : Lock the source
   shared_lock_type lock( src_data_block->get_mutex( ) );
 
-  // Step (3): Generate a new data block with the right type
-  dst_data_block = StdDataBlock::New( src_data_block->get_nx(),
-    src_data_block->get_ny(), src_data_block->get_nz(), src_data_block->get_data_type() );
-    
-  // Step (4): Copy the data  
-  size_t mem_size = src_data_block->get_size(); 
-  switch( src_data_block->get_data_type() )
+  // Step (3): If the source owns its data, share the data with the new data block. The data is
+  // only copied when either of them is written to.
+  dst_data_block = StdDataBlock::NewShared( src_data_block );
+
+  // Step (4): Mapped data does not need to fit in memory, hence it is copied into a scratch
+  // file. Scratch copies of scratch files are put next to them.
+  MappedDataBlock* mapped_data_block = dynamic_cast< MappedDataBlock* >( src_data_block.get() );
+  if ( !dst_data_block && mapped_data_block )
   {
-    case DataType::CHAR_E:
-      mem_size *= sizeof( signed char );
-      break;
-    case DataType::UCHAR_E:
-      mem_size *= sizeof( unsigned char );
-      break;
-    case DataType::SHORT_E:
-      mem_size *= sizeof( short );
-      break;
-    case DataType::USHORT_E:
-      mem_size *= sizeof( unsigned short );
-      break;
-    case DataType::INT_E:
-      mem_size *= sizeof( int );
-      break;
-    case DataType::UINT_E:
-      mem_size *= sizeof( unsigned int );
-      break;
-    case DataType::FLOAT_E:
-      mem_size *= sizeof( float );
-      break;
-    case DataType::DOUBLE_E:
-      mem_size *= sizeof( double );
-      break;
-    default:
-      return false;
+    boost::filesystem::path directory = boost::filesystem::temp_directory_path();
+    if ( mapped_data_block->is_scratch() )
+    {
+      directory = mapped_data_block->get_filename().parent_path();
+    }
+
+    std::string error;
+    dst_data_block = MappedDataBlock::NewScratch( directory, src_data_block->get_nx(),
+      src_data_block->get_ny(), src_data_block->get_nz(), src_data_block->get_data_type(), 
+      error );
+    if ( dst_data_block )
+    {
+      std::memcpy( dst_data_block->get_data(), src_data_block->get_const_data(), 
+        src_data_block->get_byte_size() );
+    }
+    else
+    {
+      CORE_LOG_WARNING( error );
+    }
+  }
+
+  // Step (5): Otherwise generate a new data block with the right type and copy the data
+  if ( !dst_data_block )
+  {
+    dst_data_block = StdDataBlock::New( src_data_block->get_nx(),
+      src_data_block->get_ny(), src_data_block->get_nz(), src_data_block->get_data_type() );
+    if ( !dst_data_block ) return false;
+
+    std::memcpy( dst_data_block->get_data(), src_data_block->get_const_data(), 
+      src_data_block->get_byte_size() );
   }
-  std::memcpy( dst_data_block->get_data(), src_data_block->get_data(), mem_size );
   
-  // Step (5) : Copy the histogram
-  dst_data_block->set_histogram( src_data_block->get_histogram() );
+  // Step (6) : Copy the histogram if it is available, otherwise it is computed when needed
+  if ( src_data_block->has_histogram() )
+  {
+    dst_data_block->set_histogram( src_data_block->get_histogram() );
+  }
 
   return true;
 }
@@ -1106,7 +1272,7 @@ bool ExtractSliceInternal( DataBlock* volume_data_block,
       if ( !slice_data_block ) return false;
       
       // Get the direct pointers to the data
-      T* volume_ptr = reinterpret_cast<T*>( volume_data_block->get_data() );
+      const T* volume_ptr = reinterpret_cast<const T*>( volume_data_block->get_const_data() );
       T* slice_ptr = reinterpret_cast<T*>( slice_data_block->get_data() );
       
       // Short cut so we do not need to recompute this one over and over again
@@ -1153,7 +1319,7 @@ bool ExtractSliceInternal( DataBlock* volume_data_block,
       if ( !slice_data_block ) return false;
       
       // Get the direct pointers to the data
-      T* volume_ptr = reinterpret_cast<T*>( volume_data_block->get_data() );
+      const T* volume_ptr = reinterpret_cast<const T*>( volume_data_block->get_const_data() );
       T* slice_ptr = reinterpret_cast<T*>( slice_data_block->get_data() );
       
       // Short cut so we do not need to recompute this one over and over again
@@ -1200,7 +1366,7 @@ bool ExtractSliceInternal( DataBlock* volume_data_block,
       if ( !slice_data_block ) return false;
       
       // Get direct pointers to the data
-      T* volume_ptr = reinterpret_cast<T*>( volume_data_block->get_data() );
+      const T* volume_ptr = reinterpret_cast<const T*>( volume_data_block->get_const_data() );
       T* slice_ptr = reinterpret_cast<T*>( slice_data_block->get_data() );
       
       // Copy the data as one block copy. As data is properly aligned in data, it can be
@@ -1276,7 +1442,7 @@ bool InsertSliceInternal( DataBlock* volume_data_block, const DataSliceHandle& s
     
       // Get the pointers for source and destination
       T* volume_ptr = reinterpret_cast<T*>( volume_data_block->get_data() );
-      T* slice_ptr = reinterpret_cast<T*>( slice_data_block->get_data() );
+      const T* slice_ptr = reinterpret_cast<const T*>( slice_data_block->get_const_data() );
       
       size_t nxy = nx * ny;
       // For loop unroll
@@ -1318,7 +1484,7 @@ bool InsertSliceInternal( DataBlock* volume_data_block, const DataSliceHandle& s
             
       // Get the pointers for source and destination
       T* volume_ptr = reinterpret_cast<T*>( volume_data_block->get_data() );
-      T* slice_ptr = reinterpret_cast<T*>( slice_data_block->get_data() );
+      const T* slice_ptr = reinterpret_cast<const T*>( slice_data_block->get_const_data() );
       
       size_t nxy = nx * ny;
       // For loop unroll
@@ -1360,7 +1526,7 @@ bool InsertSliceInternal( DataBlock* volume_data_block, const DataSliceHandle& s
           
       // Get the pointers for source and destination
       T* volume_ptr = reinterpret_cast<T*>( volume_data_block->get_data() );
-      T* slice_ptr = reinterpret_cast<T*>( slice_data_block->get_data() );
+      const T* slice_ptr = reinterpret_cast<const T*>( slice_data_block->get_const_data() );
       
       // Copy data as one memory block back
       std::memcpy( volume_ptr + index * ( nx * ny ), slice_ptr, nx * ny * sizeof( T ) );
@@ -1379,31 +1545,119 @@ bool InsertSliceInternal( DataBlock* volume_data_block, const DataSliceHandle& s
 bool DataBlock::insert_slice( const DataSliceHandle slice )
 {
   // Check whether slice and volume actually have data
-  if ( slice->get_data_type() != this->get_data_type() ) return false;
   if ( !slice ) return false;
+  if ( slice->get_data_type() != this->get_data_type() ) return false;
+
+  // Keep the current contents of the slice, so the histogram can be updated with the 
+  // difference instead of being recomputed
+  DataSliceHandle old_slice;
+  if ( this->has_histogram() )
+  {
+    this->extract_slice( slice->get_slice_type(), slice->get_index(), old_slice );
+  }
 
   // Jump to the right algorithm for each data type
+  bool success = false;
   switch( this->get_data_type() )
   { 
     case DataType::CHAR_E:
-      return InsertSliceInternal<signed char>( this, slice );
+      success = InsertSliceInternal<signed char>( this, slice );
+      break;
     case DataType::UCHAR_E:
-      return InsertSliceInternal<unsigned char>( this, slice );
+      success = InsertSliceInternal<unsigned char>( this, slice );
+      break;
     case DataType::SHORT_E:
-      return InsertSliceInternal<short>( this, slice );
+      success = InsertSliceInternal<short>( this, slice );
+      break;
     case DataType::USHORT_E:
-      return InsertSliceInternal<unsigned short>( this, slice );
+      success = InsertSliceInternal<unsigned short>( this, slice );
+      break;
     case DataType::INT_E:
-      return InsertSliceInternal<int>( this, slice );
+      success = InsertSliceInternal<int>( this, slice );
+      break;
     case DataType::UINT_E:
-      return InsertSliceInternal<unsigned int>( this, slice );
+      success = InsertSliceInternal<unsigned int>( this, slice );
+      break;
     case DataType::FLOAT_E:
-      return InsertSliceInternal<float>( this, slice );
+      success = InsertSliceInternal<float>( this, slice );
+      break;
     case DataType::DOUBLE_E:
-      return InsertSliceInternal<double>( this, slice );
+      success = InsertSliceInternal<double>( this, slice );
+      break;
     default:
       return false;
   }
+
+  if ( success ) this->update_histogram_for_slice( old_slice, slice );
+  return success;
+}
+
+template< class T >
+static bool UpdateHistogramForSlice( Histogram& histogram, const DataSliceHandle& old_slice,
+  const DataSliceHandle& new_slice )
+{
+  DataBlockHandle old_data_block = old_slice->get_data_block();
+  DataBlockHandle new_data_block = new_slice->get_data_block();
+  if ( old_data_block->get_size() != new_data_block->get_size() ) return false;
+
+  DataBlock::shared_lock_type slock( new_data_block->get_mutex() );
+  return histogram.update( reinterpret_cast< const T* >( old_data_block->get_const_data() ),
+    reinterpret_cast< const T* >( new_data_block->get_const_data() ), new_data_block->get_size() );
+}
+
+void DataBlock::update_histogram_for_slice( const DataSliceHandle& old_slice, 
+  const DataSliceHandle& new_slice )
+{
+  {
+    boost::mutex::scoped_lock lock( this->histogram_mutex_ );
+
+    // The histogram was out of date before the slice was inserted, or it was invalidated
+    // while the slice was inserted
+    if ( !old_slice || this->histogram_stamp_ != this->data_stamp_ )
+    {
+      this->data_stamp_++;
+      return;
+    }
+
+    bool updated = false;
+    switch( this->get_data_type() )
+    { 
+      case DataType::CHAR_E:
+        updated = UpdateHistogramForSlice<signed char>( this->histogram_, old_slice, new_slice );
+        break;
+      case DataType::UCHAR_E:
+        updated = UpdateHistogramForSlice<unsigned char>( this->histogram_, old_slice, new_slice );
+        break;
+      case DataType::SHORT_E:
+        updated = UpdateHistogramForSlice<short>( this->histogram_, old_slice, new_slice );
+        break;
+      case DataType::USHORT_E:
+        updated = UpdateHistogramForSlice<unsigned short>( this->histogram_, old_slice, 
+          new_slice );
+        break;
+      case DataType::INT_E:
+        updated = UpdateHistogramForSlice<int>( this->histogram_, old_slice, new_slice );
+        break;
+      case DataType::UINT_E:
+        updated = UpdateHistogramForSlice<unsigned int>( this->histogram_, old_slice, new_slice );
+        break;
+      case DataType::FLOAT_E:
+        updated = UpdateHistogramForSlice<float>( this->histogram_, old_slice, new_slice );
+        break;
+      case DataType::DOUBLE_E:
+        updated = UpdateHistogramForSlice<double>( this->histogram_, old_slice, new_slice );
+        break;
+    }
+
+    // The range of the data changed, the histogram is recomputed when it is needed next
+    if ( !updated )
+    {
+      this->data_stamp_++;
+      return;
+    }
+  }
+
+  this->histogram_changed_signal_();
 }
 
 bool DataBlock::IsBigEndian()
@@ -1420,67 +1674,89 @@ bool DataBlock::IsLittleEndian()
   if ( test_ptr[ 0 ] ) return true; else return false;
 }
 
-template<class T>
-bool PadInternal( DataBlockHandle src, DataBlockHandle dst, int pad, double val)
+// CLASS REGIONKERNEL:
+// Copies the source into the destination shifted by the same offset along each axis. Voxels of
+// the destination that fall outside the source are set to a fixed value. Work is split up by
+// destination slice and each row is filled with at most three contiguous copies.
+template< class T >
+class RegionKernel
 {
-    T* src_data = reinterpret_cast<T*>(src->get_data());
-    T* dst_data = reinterpret_cast<T*>(dst->get_data());
-    T typed_val = static_cast<T>(val);
+public:
+  typedef DataBlock::index_type index_type;
 
-    DataBlock::index_type nx = src->get_nx();
-    DataBlock::index_type ny = src->get_ny();
-    DataBlock::index_type nz = src->get_nz();
-    DataBlock::index_type pnx = dst->get_nx();
-    DataBlock::index_type pny = dst->get_ny();
-    DataBlock::index_type pnz = dst->get_nz();
+  RegionKernel( const DataBlockHandle& src, const DataBlockHandle& dst, index_type offset,
+    double value ) :
+    src_( reinterpret_cast< const T* >( src->get_const_data() ) ),
+    dst_( reinterpret_cast< T* >( dst->get_data() ) ),
+    snx_( static_cast< index_type >( src->get_nx() ) ),
+    sny_( static_cast< index_type >( src->get_ny() ) ),
+    snz_( static_cast< index_type >( src->get_nz() ) ),
+    dnx_( static_cast< index_type >( dst->get_nx() ) ),
+    dny_( static_cast< index_type >( dst->get_ny() ) ),
+    offset_( offset ),
+    value_( static_cast< T >( value ) )
+  {
+  }
 
-    DataBlock::index_type p = static_cast<DataBlock::index_type>(pad);
-    
-    if (p > 0)
-    {
-        size_t size = dst->get_size();
-        for(size_t j = 0; j< size; j++)
-        {
-            dst_data[j] = typed_val;
-        }
-    }
+  void process( size_t begin, size_t end ) const
+  {
+    // Range of each destination row that is covered by the source
+    index_type x_begin = std::min( std::max( this->offset_, index_type( 0 ) ), this->dnx_ );
+    index_type x_end = std::max( std::min( this->snx_ + this->offset_, this->dnx_ ), x_begin );
+    index_type dnxy = this->dnx_ * this->dny_;
 
-    if (p >= 0)
-    {
-        DataBlock::index_type k = 0;
-        DataBlock::index_type m = p + p * pnx + p * pnx * pny;
-        for(DataBlock::index_type z = 0; z < nz ; z++, m += 2*p*pnx )
-        {
-            for(DataBlock::index_type y = 0; y < ny; y++, m += 2*p )
-            {
-                for(DataBlock::index_type x = 0; x < nx; x++, k++, m++ )
-                {
-                    dst_data[m] = src_data[k];
-                }
-            }
-        }
-    }
-    else
+    for ( index_type z = static_cast< index_type >( begin ); 
+      z < static_cast< index_type >( end ); z++ )
     {
-        p = -p;
-        DataBlock::index_type k = p + p * nx + p * nx * ny;
-        DataBlock::index_type m = 0;
+      T* slice = this->dst_ + z * dnxy;
+      index_type sz = z - this->offset_;
+      if ( sz < 0 || sz >= this->snz_ )
+      {
+        std::fill( slice, slice + dnxy, this->value_ );
+        continue;
+      }
 
-        for(DataBlock::index_type z = 0; z < pnz ; z++, k += 2*p*nx )
+      for ( index_type y = 0; y < this->dny_; y++ )
+      {
+        T* row = slice + y * this->dnx_;
+        index_type sy = y - this->offset_;
+        if ( sy < 0 || sy >= this->sny_ )
         {
-            for(DataBlock::index_type y =0; y < pny; y++, k += 2*p )
-            {
-                for(DataBlock::index_type x = 0; x < pnx; x++, k++, m++ )
-                {
-                    dst_data[m] = src_data[k];
-                }
-            }
+          std::fill( row, row + this->dnx_, this->value_ );
+          continue;
         }
+
+        const T* src = this->src_ + ( sz * this->sny_ + sy ) * this->snx_ + 
+          ( x_begin - this->offset_ );
+        std::fill( row, row + x_begin, this->value_ );
+        std::copy( src, src + ( x_end - x_begin ), row + x_begin );
+        std::fill( row + x_end, row + this->dnx_, this->value_ );
+      }
     }
-    
-    return true;
+  }
+
+private:
+  const T* src_;
+  T* dst_;
+  index_type snx_;
+  index_type sny_;
+  index_type snz_;
+  index_type dnx_;
+  index_type dny_;
+  index_type offset_;
+  T value_;
+};
+
+template< class T >
+static bool CopyRegion( DataBlockHandle src, DataBlockHandle dst, int offset, double val )
+{
+  RegionKernel< T > kernel( src, dst, static_cast< DataBlock::index_type >( offset ), val );
+  Parallel::For( 0, dst->get_nz(), boost::bind( &RegionKernel< T >::process, &kernel, _1, _2 ),
+    GetGrainSize( dst->get_nx() * dst->get_ny() ) );
+  return true;
 }
 
+
 bool DataBlock::Pad( DataBlockHandle src_data_block,
     DataBlockHandle& dst_data_block, int pad, double val )
 {
@@ -1503,21 +1779,21 @@ bool DataBlock::Pad( DataBlockHandle src_data_block,
   switch( src_data_block->get_data_type() )
   {
     case DataType::CHAR_E:
-            return PadInternal<signed char>(src_data_block,dst_data_block,pad, val);
+            return CopyRegion<signed char>( src_data_block, dst_data_block, pad, val );
     case DataType::UCHAR_E:
-            return PadInternal<unsigned char>(src_data_block,dst_data_block,pad, val);
+            return CopyRegion<unsigned char>( src_data_block, dst_data_block, pad, val );
     case DataType::SHORT_E:
-            return PadInternal<short>(src_data_block,dst_data_block,pad, val);
+            return CopyRegion<short>( src_data_block, dst_data_block, pad, val );
     case DataType::USHORT_E:
-            return PadInternal<unsigned short>(src_data_block,dst_data_block,pad, val);
+            return CopyRegion<unsigned short>( src_data_block, dst_data_block, pad, val );
     case DataType::INT_E:
-            return PadInternal<int>(src_data_block,dst_data_block,pad, val);
+            return CopyRegion<int>( src_data_block, dst_data_block, pad, val );
     case DataType::UINT_E:
-            return PadInternal<unsigned int>(src_data_block,dst_data_block,pad, val);
+            return CopyRegion<unsigned int>( src_data_block, dst_data_block, pad, val );
     case DataType::FLOAT_E:
-            return PadInternal<float>(src_data_block,dst_data_block,pad, val);
+            return CopyRegion<float>( src_data_block, dst_data_block, pad, val );
     case DataType::DOUBLE_E:
-            return PadInternal<double>(src_data_block,dst_data_block,pad, val);
+            return CopyRegion<double>( src_data_block, dst_data_block, pad, val );
     default:
       return false;
   }
@@ -1525,61 +1801,6 @@ bool DataBlock::Pad( DataBlockHandle src_data_block,
 
 
 
-template<class T>
-bool ClipInternal( DataBlockHandle src, DataBlockHandle dst, double val)
-{
-    T* sdata = reinterpret_cast<T*>(src->get_data());
-    T* ddata = reinterpret_cast<T*>(dst->get_data());
-    T typed_val = static_cast<T>(val);
-
-    DataBlock::index_type snx = src->get_nx();
-    DataBlock::index_type sny = src->get_ny();
-    DataBlock::index_type snz = src->get_nz();
-    DataBlock::index_type dnx = dst->get_nx();
-    DataBlock::index_type dny = dst->get_ny();
-    DataBlock::index_type dnz = dst->get_nz();
-
-  DataBlock::index_type mnx = Min( snx, dnx );
-  DataBlock::index_type mny = Min( sny, dny );
-  DataBlock::index_type mnz = Min( snz, dnz );
-
-  DataBlock::index_type sk = 0;
-  DataBlock::index_type dk = 0;
-
-    DataBlock::index_type sx_offset = Max( DataBlock::index_type( 0 ) , snx - dnx );
-    DataBlock::index_type dx_offset = Max( DataBlock::index_type( 0 ), dnx - snx );
-
-    DataBlock::index_type sy_offset = Max( DataBlock::index_type( 0 ) , sny - dny ) * snx;
-    DataBlock::index_type dy_offset = Max( DataBlock::index_type( 0 ), dny - sny ) * dny;
-
-  DataBlock::index_type dz_offset = Max( DataBlock::index_type( 0 ),  dnz - snz ) * dny * dnx;
-
-  for ( DataBlock::index_type z = 0; z < mnz; z++,  sk += sy_offset)
-  {
-    for ( DataBlock::index_type y = 0; y < mny; y++, sk += sx_offset )
-    {
-      for ( DataBlock::index_type x = 0; x < mnx; x++, sk++, dk++ )
-      {
-        ddata[dk] = sdata[sk];
-      } 
-      for ( DataBlock::index_type x = 0; x < dx_offset; x++, dk++ )
-      {
-        ddata[dk] = typed_val;
-      }
-    } 
-    for ( DataBlock::index_type m = 0; m < dy_offset; m++, dk++ )
-    {
-      ddata[dk] = typed_val;
-    }
-  }
-  for ( DataBlock::index_type m = 0; m < dz_offset; m++, dk++ )
-  {
-    ddata[dk] = typed_val;
-  }
-    
-    return true;
-}
-
 bool DataBlock::Clip( DataBlockHandle src_data_block,
     DataBlockHandle& dst_data_block, int width, int height, int depth, double val )
 {
@@ -1599,21 +1820,21 @@ bool DataBlock::Clip( DataBlockHandle src_data_block,
   switch( src_data_block->get_data_type() )
   {
     case DataType::CHAR_E:
-            return ClipInternal<signed char>(src_data_block,dst_data_block, val);
+            return CopyRegion<signed char>( src_data_block, dst_data_block, 0, val );
     case DataType::UCHAR_E:
-            return ClipInternal<unsigned char>(src_data_block,dst_data_block, val);
+            return CopyRegion<unsigned char>( src_data_block, dst_data_block, 0, val );
     case DataType::SHORT_E:
-            return ClipInternal<short>(src_data_block,dst_data_block, val);
+            return CopyRegion<short>( src_data_block, dst_data_block, 0, val );
     case DataType::USHORT_E:
-            return ClipInternal<unsigned short>(src_data_block,dst_data_block, val);
+            return CopyRegion<unsigned short>( src_data_block, dst_data_block, 0, val );
     case DataType::INT_E:
-            return ClipInternal<int>(src_data_block,dst_data_block, val);
+            return CopyRegion<int>( src_data_block, dst_data_block, 0, val );
     case DataType::UINT_E:
-            return ClipInternal<unsigned int>(src_data_block,dst_data_block, val);
+            return CopyRegion<unsigned int>( src_data_block, dst_data_block, 0, val );
     case DataType::FLOAT_E:
-            return ClipInternal<float>(src_data_block,dst_data_block, val);
+            return CopyRegion<float>( src_data_block, dst_data_block, 0, val );
     case DataType::DOUBLE_E:
-            return ClipInternal<double>(src_data_block,dst_data_block, val);
+            return CopyRegion<double>( src_data_block, dst_data_block, 0, val );
     default:
       return false;
   }
@@ -146,12 +146,28 @@ public:
   }
 
   // GET_DATA:
-  /// Pointer to the block of data
-  void* get_data()
+  /// Pointer to the block of data, for reading and writing
+  /// NOTE: If the data is shared with a duplicate of this data block, a private copy of the
+  /// data is made first. Use get_const_data when the data is only read.
+  void* get_data();
+
+  // GET_CONST_DATA:
+  /// Pointer to the block of data, for reading only. This never copies shared data.
+  const void* get_const_data() const
   {
     return this->data_;
   }
 
+  // IS_SHARED:
+  /// Whether the data is shared with a duplicate of this data block
+  bool is_shared() const;
+
+  // DISABLE_SHARING:
+  /// Never share the memory of this data block with duplicates. This is needed when pointers
+  /// to the memory are kept outside of the data block, as a private copy made on a write would
+  /// leave them pointing to the memory of the duplicate. Duplicates get a copy of the data.
+  void disable_sharing();
+
   // GET_DATA_AT:
   /// Get data at a certain location in the data block
   inline double get_data_at( index_type x, index_type y, index_type z ) const
@@ -180,26 +196,36 @@ public:
 
   // GET_MAX:
   /// Get the maximum value of the data
-  /// NOTE: update_histogram needs to be called to ensure the data is accurate
+  /// NOTE: If the histogram is out of date, it is recomputed first
   double get_max() const;
 
   // GET_MIN:
   /// Get the minimum value of the data
-  /// NOTE: update_histogram needs to be called to ensure the data is accurate
+  /// NOTE: If the histogram is out of date, it is recomputed first
   double get_min() const;
 
   // GET_RANGE:
   /// Get the dynamic range of the data
-  /// NOTE: update_histogram needs to be called to ensure the data is accurate
+  /// NOTE: If the histogram is out of date, it is recomputed first
   double get_range() const;
 
   // GET_HISTOGRAM:
   /// Get the histogram of the underlying data
-  const Histogram& get_histogram() const;
+  /// NOTE: If the histogram is out of date, it is recomputed first
+  Histogram get_histogram() const;
+
+  // HAS_HISTOGRAM:
+  /// Whether the histogram is up to date, in which case getting it does not compute anything
+  bool has_histogram() const;
 
   // UPDATE_HISTOGRAM:
-  /// Recompute the histogram. This needs to be triggered each time the data is updated
+  /// Recompute the histogram now.
   bool update_histogram();
+
+  // INVALIDATE_HISTOGRAM:
+  /// Mark the histogram as out of date after the data was changed. It is recomputed when it
+  /// is needed next.
+  void invalidate_histogram();
   
   // UPDATE_DATA_TYPE:
   /// Reset the data type
@@ -240,9 +266,21 @@ protected:
   /// Set the type of the data
   void set_type( DataType type );
 
+  // ALLOCATE_DATA:
+  /// Allocate memory for data of the current type and size. The memory is owned by the data
+  /// block and can be shared with duplicates of it. Throws std::bad_alloc on failure.
+  void allocate_data();
+
+  // SHARE_DATA:
+  /// Share the memory owned by another data block of the same type and size. Whichever data
+  /// block is written to first makes a private copy. Returns false if the other data block does
+  /// not own its memory.
+  bool share_data( const DataBlock& src );
+
 public:
   // SET_DATA
   /// Set the data pointer of the data
+  /// NOTE: The memory is not owned by the data block and cannot be shared with duplicates.
   void set_data( void* data );
 
   // -- Signals and slots --
@@ -251,6 +289,10 @@ public:
   /// Triggered when data has been changed
   boost::signals2::signal<void ()> data_changed_signal_;
 
+  // HISTOGRAM_CHANGED_SIGNAL
+  /// Triggered when a histogram has been computed or updated, may be triggered from any thread
+  boost::signals2::signal<void ()> histogram_changed_signal_;
+
   // -- extracting slices and inserting slices
 public:
   // INSERT_SLICE:
@@ -277,8 +319,38 @@ private:
   /// Pointer to the data
   void* data_;
 
+  /// Ownership of the data if it was allocated by this data block, the memory is shared with
+  /// duplicates until one of them is written to
+  boost::shared_ptr< void > shared_data_;
+
+  /// Protects data_ and shared_data_ while a private copy is made
+  mutable boost::mutex data_mutex_;
+
+  /// Whether the memory can be shared with duplicates
+  bool sharing_disabled_;
+
   /// Histogram information for this data block
-  Histogram histogram_;
+  mutable Histogram histogram_;
+
+  /// The histogram is up to date if histogram_stamp_ matches data_stamp_, the data stamp is
+  /// increased each time the histogram is invalidated
+  size_t data_stamp_;
+  mutable size_t histogram_stamp_;
+
+  /// Protects the histogram and the stamps
+  mutable boost::mutex histogram_mutex_;
+
+  /// Only one thread computes the histogram, others wait for its result
+  mutable boost::mutex histogram_compute_mutex_;
+
+  // COMPUTE_HISTOGRAM:
+  /// Compute the histogram if it is out of date. Returns whether it was computed.
+  bool compute_histogram() const;
+
+  // UPDATE_HISTOGRAM_FOR_SLICE:
+  /// Update the histogram after a slice was inserted, or invalidate it if that is not possible.
+  void update_histogram_for_slice( const DataSliceHandle& old_slice, 
+    const DataSliceHandle& new_slice );
   
   /// Generation number
   generation_type generation_;
@@ -303,8 +375,15 @@ public:
   static bool QuantizeData( const DataBlockHandle& src_data_block, 
     DataBlockHandle& dst_data_block, DataType new_data_type );
 
+  // REQUESTHISTOGRAM:
+  /// Compute the histogram on the thread pool if it is out of date. histogram_changed_signal_
+  /// is triggered once it is available.
+  static void RequestHistogram( const DataBlockHandle& data_block );
+
   // DUPLICATE:
-  /// Clone the data in a datablock by generating a new one and copying the data into it.
+  /// Clone the data in a datablock by generating a new one. If the source owns its data the
+  /// data is shared, and only copied when either data block is written to. Mapped data is 
+  /// copied into a scratch file, so the copy does not need to fit in memory either.
   static bool Duplicate( const DataBlockHandle& src_data_block, DataBlockHandle& dst_data_block ); 
   
   // PAD:
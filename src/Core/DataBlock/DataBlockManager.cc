@@ -26,6 +26,9 @@
  DEALINGS IN THE SOFTWARE.
  */
 
+// STL includes
+#include <set>
+
 #include <Core/DataBlock/DataBlockManager.h>
 
 namespace Core 
@@ -149,4 +152,30 @@ void DataBlockManager::clear()
   this->private_->generation_ = 0;
 }
 
+void DataBlockManager::get_memory_usage( size_t& private_bytes, size_t& shared_bytes )
+{
+  lock_type lock( this->get_mutex() );
+
+  private_bytes = 0;
+  shared_bytes = 0;
+  std::set< const void* > shared_data;
+
+  DataBlockManagerPrivate::generation_map_type::const_iterator it =
+    this->private_->generation_map_.begin();
+  for ( ; it != this->private_->generation_map_.end(); ++it )
+  {
+    DataBlockHandle datablock = ( *it ).second.lock();
+    if ( !datablock ) continue;
+
+    if ( !datablock->is_shared() )
+    {
+      private_bytes += datablock->get_byte_size();
+    }
+    else if ( shared_data.insert( datablock->get_const_data() ).second )
+    {
+      shared_bytes += datablock->get_byte_size();
+    }
+  }
+}
+
 } // end namespace Core
@@ -76,6 +76,12 @@ public:
   /// Remove all the data blocks.
   void clear();
 
+  // GET_MEMORY_USAGE:
+  /// Get the number of bytes used by the registered data blocks. Memory that is shared between
+  /// duplicates is counted once in shared_bytes, memory owned by a single data block is counted
+  /// in private_bytes.
+  void get_memory_usage( size_t& private_bytes, size_t& shared_bytes );
+
 public:
   
   // GET_GENERATION_COUNT:
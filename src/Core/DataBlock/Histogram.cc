@@ -27,11 +27,13 @@
  */
 
 // STL includes
+#include <algorithm>
 #include <vector>
 #include <limits>
 
 // Boost includes
 #include <boost/algorithm/minmax_element.hpp>
+#include <boost/bind.hpp>
 
 // Core includes
 #include <Core/Utils/Parallel.h>
@@ -42,312 +44,392 @@
 namespace Core
 {
 
-Histogram::Histogram() 
-{
-  this->min_ = Core::Nan();
-  this->max_ = Core::Nan();
-  this->bin_start_ = Core::Nan();
-  this->bin_size_ = Core::Nan();
-  this->histogram_.resize( 0 );
-}
-
-Histogram::Histogram( const signed char* data, size_t size )
-{
-  this->compute( data, size );
-}
-  
-Histogram::Histogram( const unsigned char* data, size_t size )
-{
-  this->compute( data, size );
-}
-
-Histogram::Histogram( const short* data, size_t size )
-{
-  this->compute( data, size );
-}
-
-Histogram::Histogram( const unsigned short* data, size_t size )
-{
-  this->compute( data, size );
-}
+// Minimum number of values handled by one thread, splitting up less data costs more in
+// thread synchronization than it gains
+static const size_t MIN_CHUNK_SIZE_C = 0x40000;
 
-Histogram::Histogram( const int* data, size_t size )
+// Number of chunks the data is split into, each chunk gets its own partial result
+static size_t GetNumChunks( size_t size )
 {
-  this->compute( data, size );
+  size_t num_chunks = std::min( static_cast< size_t >( Parallel::GetNumThreads() ),
+    size / MIN_CHUNK_SIZE_C );
+  return std::max< size_t >( num_chunks, 1 );
 }
 
-Histogram::Histogram( const unsigned int* data, size_t size )
+// Only floating point data has values that are not finite
+template< class T >
+inline bool IsFiniteValue( T )
 {
-  this->compute( data, size );
+  return true;
 }
 
-Histogram::Histogram( const float* data, size_t size )
+inline bool IsFiniteValue( float value )
 {
-  this->compute( data, size );
+  return Core::IsFinite( value );
 }
 
-Histogram::Histogram( const double* data, size_t size )
+inline bool IsFiniteValue( double value )
 {
-  this->compute( data, size );
+  return Core::IsFinite( value );
 }
 
-Histogram::~Histogram()
+// Index of the bin a value falls into, which is ( value - bin_start ) / bin_size. The bin is
+// found with a multiplication instead of a division. Close to the border between two bins the
+// product can round differently than the quotient, there the division decides.
+inline size_t GetBinIndex( double value, double bin_start, double bin_size, 
+  double inv_bin_size, size_t last_bin )
 {
+  const double offset = value - bin_start;
+  const double scaled = offset * inv_bin_size;
+  size_t idx = static_cast< size_t >( scaled );
+  const double fraction = scaled - static_cast< double >( idx );
+  if ( fraction < 1.0e-9 || fraction > 1.0 - 1.0e-9 )
+  {
+    idx = static_cast< size_t >( offset / bin_size );
+  }
+  return idx < last_bin ? idx : last_bin;
 }
 
-// For char and short data we do a single pass over the data to speed up the computation. The
-// first pass is used to generate the histogram. In the next step we use this data to compute
-// min and max
-
-bool Histogram::compute( const signed char* data, size_t size )
+// CLASS MINMAXCHUNKS:
+// Min and max of the data, computed per chunk and combined afterwards.
+template< class T >
+class MinMaxChunks
 {
-  this->min_ = Core::Nan();
-  this->max_ = Core::Nan();
-  this->bin_start_ = Core::Nan();
-  this->bin_size_ = Core::Nan();
-  this->histogram_.resize( 0 );
-  if ( size == 0 ) return false;
-  
-  try
+public:
+  MinMaxChunks( const T* data, size_t size, size_t num_chunks ) :
+    data_( data ), 
+    size_( size ),
+    num_chunks_( num_chunks ),
+    min_( num_chunks ),
+    max_( num_chunks ),
+    valid_( num_chunks, 0 )
   {
-    std::vector<size_t> histogram;
-    histogram.resize( 0x100 , 0 );
+  }
 
-    for ( size_t j = 0 ; j < size ; j++ )
-    {
-      histogram[ static_cast<int>( data[ j ] ) + 0x80 ]++;
-    }
-    
-    size_t hist_begin = 0;
-    size_t hist_end = 0;
-    
-    for ( size_t j = 0 ; j < histogram.size() ; j++ )
+  void process( size_t chunk_begin, size_t chunk_end )
+  {
+    for ( size_t chunk = chunk_begin; chunk < chunk_end; chunk++ )
     {
-      if ( histogram[ j ] > 0 ) hist_end = j;
+      size_t begin = this->size_ * chunk / this->num_chunks_;
+      size_t end = this->size_ * ( chunk + 1 ) / this->num_chunks_;
+      this->valid_[ chunk ] = this->process_range( this->data_ + begin, end - begin, 
+        this->min_[ chunk ], this->max_[ chunk ] );
     }
+  }
 
-    size_t hsize = histogram.size();
-    for ( size_t j = 0 ; j < hsize; j++ )
+  bool combine( double& min, double& max ) const
+  {
+    bool valid = false;
+    for ( size_t j = 0; j < this->num_chunks_; j++ )
     {
-      if ( histogram[ hsize - 1 - j ] > 0 ) hist_begin = hsize - 1 - j;
+      if ( !this->valid_[ j ] ) continue;
+      if ( !valid || this->min_[ j ] < min ) min = static_cast< double >( this->min_[ j ] );
+      if ( !valid || this->max_[ j ] > max ) max = static_cast< double >( this->max_[ j ] );
+      valid = true;
     }
+    return valid;
+  }
 
-    this->min_ = static_cast<double>( hist_begin ) - static_cast<double>( 0x80 );
-    this->max_ = static_cast<double>( hist_end ) - static_cast<double>( 0x80 );
-
-    this->bin_size_  = 1.0;
-    this->bin_start_ = this->min_ - 0.5;
-
-    this->histogram_.resize( hist_end + 1 - hist_begin );
-    for ( size_t j = 0 ; j < histogram_.size() ; j++ )
+private:
+  // PROCESS_RANGE:
+  // The loop keeps eight independent minima and maxima and has no branches, so the compiler
+  // can map it onto SIMD min/max instructions. NaN never compares smaller or larger and drops
+  // out by itself, infinite values do not and are filtered out by a scalar pass in the rare
+  // case that they end up as the minimum or maximum.
+  static bool process_range( const T* data, size_t size, T& min_val, T& max_val )
+  {
+    const size_t LANES_C = 8;
+    T lane_min[ LANES_C ];
+    T lane_max[ LANES_C ];
+    for ( size_t k = 0; k < LANES_C; k++ )
     {
-      this->histogram_[ j ] = histogram[ j + hist_begin ];
+      lane_min[ k ] = std::numeric_limits< T >::max();
+      lane_max[ k ] = std::numeric_limits< T >::lowest();
     }
 
-    std::pair< std::vector<size_t>::iterator, std::vector<size_t>::iterator > min_max = 
-      boost::minmax_element( this->histogram_.begin(), this->histogram_.end() );
-    this->min_bin_ = (*min_max.first);
-    this->max_bin_ = (*min_max.second);
-  }
-  catch( ... )
-  {
-    this->min_ = Core::Nan();
-    this->max_ = Core::Nan();
-    this->bin_start_ = Core::Nan();
-    this->bin_size_ = Core::Nan();
-    this->histogram_.resize( 0 );
-    return false;
-  }
-  
-  return true;
-}
-
-bool Histogram::compute( const unsigned char* data, size_t size )
-{
-  this->min_ = Core::Nan();
-  this->max_ = Core::Nan();
-  this->bin_start_ = Core::Nan();
-  this->bin_size_ = Core::Nan();
-  this->histogram_.resize( 0 );
-  if ( size == 0 ) return false;
-
-  try
-  {
-    std::vector<size_t> histogram;
-    histogram.resize( 0x100, 0 );
-    
-    for ( size_t j = 0 ; j < size ; j++ )
+    size_t j = 0;
+    for ( ; j + LANES_C <= size; j += LANES_C )
     {
-      histogram[ static_cast<int>( data[ j ] ) ]++;
+      for ( size_t k = 0; k < LANES_C; k++ )
+      {
+        T val = data[ j + k ];
+        lane_min[ k ] = val < lane_min[ k ] ? val : lane_min[ k ];
+        lane_max[ k ] = val > lane_max[ k ] ? val : lane_max[ k ];
+      }
     }
-    
-    size_t hist_begin = 0;
-    size_t hist_end = 0;
-    
-    for ( size_t j = 0 ; j < histogram.size() ; j++ )
+    for ( ; j < size; j++ )
     {
-      if ( histogram[ j ] > 0 ) hist_end = j;
+      T val = data[ j ];
+      lane_min[ 0 ] = val < lane_min[ 0 ] ? val : lane_min[ 0 ];
+      lane_max[ 0 ] = val > lane_max[ 0 ] ? val : lane_max[ 0 ];
     }
 
-    size_t hsize = histogram.size();
-    for ( size_t j = 0 ; j < hsize; j++ )
+    min_val = lane_min[ 0 ];
+    max_val = lane_max[ 0 ];
+    for ( size_t k = 1; k < LANES_C; k++ )
     {
-      if ( histogram[ hsize - 1 - j ] > 0 ) hist_begin = hsize - 1 - j;
+      if ( lane_min[ k ] < min_val ) min_val = lane_min[ k ];
+      if ( lane_max[ k ] > max_val ) max_val = lane_max[ k ];
     }
 
-
-    this->min_ = static_cast<double>( hist_begin );
-    this->max_ = static_cast<double>( hist_end );
-
-    this->bin_size_  = 1.0;
-    this->bin_start_ = this->min_ - 0.5;
-
-    this->histogram_.resize( hist_end + 1 - hist_begin );
-
-    for ( size_t j = 0 ; j < histogram_.size() ; j++ )
+    if ( !IsFiniteValue( min_val ) || !IsFiniteValue( max_val ) )
     {
-      this->histogram_[ j ] = histogram[ j + hist_begin ];
+      min_val = std::numeric_limits< T >::max();
+      max_val = std::numeric_limits< T >::lowest();
+      for ( j = 0; j < size; j++ )
+      {
+        T val = data[ j ];
+        if ( !IsFiniteValue( val ) ) continue;
+        if ( val < min_val ) min_val = val;
+        if ( val > max_val ) max_val = val;
+      }
     }
 
-    std::pair< std::vector<size_t>::iterator, std::vector<size_t>::iterator > min_max = 
-      boost::minmax_element( this->histogram_.begin(), this->histogram_.end() );
-    this->min_bin_ = (*min_max.first);
-    this->max_bin_ = (*min_max.second);
+    // If all the data is NaN the minimum is still larger than the maximum
+    return size > 0 && !( min_val > max_val );
   }
-  catch( ... )
-  {
-    this->min_ = Core::Nan();
-    this->max_ = Core::Nan();
-    this->bin_start_ = Core::Nan();
-    this->bin_size_ = Core::Nan();
-    this->histogram_.resize( 0 );
-    return false;
-  }
-  
-  return true;  
-}
 
-bool Histogram::compute( const short* data, size_t size )
+  const T* data_;
+  size_t size_;
+  size_t num_chunks_;
+  std::vector< T > min_;
+  std::vector< T > max_;
+  std::vector< char > valid_;
+};
+
+template< class T >
+static bool ComputeMinMaxInternals( const T* data, size_t size, double& min, double& max )
 {
-  this->min_ = Core::Nan();
-  this->max_ = Core::Nan();
-  this->bin_start_ = Core::Nan();
-  this->bin_size_ = Core::Nan();
-  this->histogram_.resize( 0 );
   if ( size == 0 ) return false;
 
-  try
+  size_t num_chunks = GetNumChunks( size );
+  MinMaxChunks< T > chunks( data, size, num_chunks );
+  Parallel::For( 0, num_chunks, boost::bind( &MinMaxChunks< T >::process, &chunks, _1, _2 ), 1 );
+  return chunks.combine( min, max );
+}
+
+// CLASS TABLECHUNKS:
+// Count of every possible value of 8 and 16 bit data, computed per chunk and summed afterwards.
+template< class T >
+class TableChunks
+{
+public:
+  // 8 bit data alternates between four tables, so that runs of the same value do not stall on
+  // incrementing the same counter over and over
+  static const size_t NUM_TABLES_C = sizeof( T ) == 1 ? 4 : 1;
+  static const size_t TABLE_SIZE_C = static_cast< size_t >( 1 ) << ( 8 * sizeof( T ) );
+
+  TableChunks( const T* data, size_t size, size_t num_chunks ) :
+    data_( data ), 
+    size_( size ),
+    num_chunks_( num_chunks ),
+    tables_( num_chunks )
   {
-    std::vector<size_t> histogram;
-    histogram.resize( 0x10000 , 0 );
-    
-    for ( size_t j = 0 ; j < size ; j++ )
-    {
-      histogram[ static_cast<int>( data[ j ] ) + 0x8000 ]++;
-    }
-    
-    size_t hist_begin = 0;
-    size_t hist_end = 0;
-    
-    for ( size_t j = 0 ; j < histogram.size() ; j++ )
+  }
+
+  void process( size_t chunk_begin, size_t chunk_end )
+  {
+    const int offset = -static_cast< int >( std::numeric_limits< T >::lowest() );
+    for ( size_t chunk = chunk_begin; chunk < chunk_end; chunk++ )
     {
-      if ( histogram[ j ] > 0 ) hist_end = j;
+      std::vector< size_t >& table = this->tables_[ chunk ];
+      table.resize( NUM_TABLES_C * TABLE_SIZE_C, 0 );
+      size_t begin = this->size_ * chunk / this->num_chunks_;
+      size_t end = this->size_ * ( chunk + 1 ) / this->num_chunks_;
+      const T* data = this->data_;
+
+      size_t j = begin;
+      for ( ; j + NUM_TABLES_C <= end; j += NUM_TABLES_C )
+      {
+        for ( size_t k = 0; k < NUM_TABLES_C; k++ )
+        {
+          table[ k * TABLE_SIZE_C + static_cast< int >( data[ j + k ] ) + offset ]++;
+        }
+      }
+      for ( ; j < end; j++ )
+      {
+        table[ static_cast< int >( data[ j ] ) + offset ]++;
+      }
     }
+  }
 
-    size_t hsize = histogram.size();
-    for ( size_t j = 0 ; j < hsize; j++ )
+  void combine( std::vector< size_t >& histogram ) const
+  {
+    histogram.assign( TABLE_SIZE_C, 0 );
+    for ( size_t j = 0; j < this->num_chunks_; j++ )
     {
-      if ( histogram[ hsize - 1 - j ] > 0 ) hist_begin = hsize - 1 - j;
+      const std::vector< size_t >& table = this->tables_[ j ];
+      for ( size_t k = 0; k < table.size(); k++ )
+      {
+        histogram[ k % TABLE_SIZE_C ] += table[ k ];
+      }
     }
+  }
 
-    this->min_ = static_cast<double>( hist_begin ) - static_cast<double>( 0x8000 );
-    this->max_ = static_cast<double>( hist_end ) - static_cast<double>( 0x8000 );
+private:
+  const T* data_;
+  size_t size_;
+  size_t num_chunks_;
+  std::vector< std::vector< size_t > > tables_;
+};
+
+// CLASS BINCHUNKS:
+// Histogram of data with a known range, computed per chunk and summed afterwards. Values 
+// outside [min, max], which includes NaN and infinite values, are skipped.
+template< class T >
+class BinChunks
+{
+public:
+  BinChunks( const T* data, size_t size, size_t num_chunks, double min, double max, 
+    double bin_start, double bin_size, double inv_bin_size, size_t num_bins ) :
+    data_( data ), 
+    size_( size ),
+    num_chunks_( num_chunks ),
+    min_( min ),
+    max_( max ),
+    bin_start_( bin_start ),
+    bin_size_( bin_size ),
+    inv_bin_size_( inv_bin_size ),
+    num_bins_( num_bins ),
+    bins_( num_chunks )
+  {
+  }
 
-    size_t hist_length = hist_end + 1 - hist_begin;
-    if ( hist_length > 0x100 ) hist_length = 0x100;
-    
-    this->histogram_.resize( hist_length, 0 );
+  void process( size_t chunk_begin, size_t chunk_end )
+  {
+    const double min = this->min_;
+    const double max = this->max_;
+    const double bin_start = this->bin_start_;
+    const double bin_size = this->bin_size_;
+    const double inv_bin_size = this->inv_bin_size_;
+    const size_t last_bin = this->num_bins_ - 1;
 
-    if ( hist_length == 1 )
-    {
-      this->bin_size_  = 1.0;
-      this->bin_start_ = this->min_ - ( this->bin_size_ * 0.5 );
-    }
-    else
-    {
-      this->bin_size_ = ( this->max_ - this->min_ ) / static_cast<double>( hist_length - 1 );
-      this->bin_start_ = this->min_ - ( this->bin_size_ * 0.5 );
-    }
-    
-    for ( size_t j = 0 ; j < histogram_.size() ; j++ )
+    for ( size_t chunk = chunk_begin; chunk < chunk_end; chunk++ )
     {
-      double min_value = this->bin_start_ + j * this->bin_size_;
-      double max_value = this->bin_start_ + ( j + 1 ) * this->bin_size_;
+      std::vector< size_t >& bins = this->bins_[ chunk ];
+      bins.resize( this->num_bins_, 0 );
+      size_t begin = this->size_ * chunk / this->num_chunks_;
+      size_t end = this->size_ * ( chunk + 1 ) / this->num_chunks_;
 
-      for ( int k = Ceil( min_value ) ; k < Ceil( max_value ); k++ )
+      for ( size_t j = begin; j < end; j++ )
       {
-        int idx = static_cast<int>( k ) + 0x8000;
-        if ( idx >= 0 && idx < static_cast<int>( histogram.size() ) ) 
-        {
-          this->histogram_[ j ] += histogram[ idx ];
-        }
+        double val = static_cast< double >( this->data_[ j ] );
+        if ( !( val >= min && val <= max ) ) continue;
+        bins[ GetBinIndex( val, bin_start, bin_size, inv_bin_size, last_bin ) ]++;
       }
     }
-
-    std::pair< std::vector<size_t>::iterator, std::vector<size_t>::iterator > min_max = 
-      boost::minmax_element( this->histogram_.begin(), this->histogram_.end() );
-    this->min_bin_ = (*min_max.first);
-    this->max_bin_ = (*min_max.second);
   }
-  catch( ... )
+
+  void combine( std::vector< size_t >& histogram ) const
   {
-    this->min_ = Core::Nan();
-    this->max_ = Core::Nan();
-    this->bin_start_ = Core::Nan();
-    this->bin_size_ = Core::Nan();
-    this->histogram_.resize( 0 );
-    return false;
+    histogram.assign( this->num_bins_, 0 );
+    for ( size_t j = 0; j < this->num_chunks_; j++ )
+    {
+      const std::vector< size_t >& bins = this->bins_[ j ];
+      for ( size_t k = 0; k < bins.size(); k++ )
+      {
+        histogram[ k ] += bins[ k ];
+      }
+    }
   }
+
+private:
+  const T* data_;
+  size_t size_;
+  size_t num_chunks_;
+  double min_;
+  double max_;
+  double bin_start_;
+  double bin_size_;
+  double inv_bin_size_;
+  size_t num_bins_;
+  std::vector< std::vector< size_t > > bins_;
+};
+
+Histogram::Histogram() 
+{
+  this->clear();
+}
+
+Histogram::Histogram( const signed char* data, size_t size )
+{
+  this->compute( data, size );
+}
   
-  return true;  
+Histogram::Histogram( const unsigned char* data, size_t size )
+{
+  this->compute( data, size );
 }
 
+Histogram::Histogram( const short* data, size_t size )
+{
+  this->compute( data, size );
+}
 
-bool Histogram::compute( const unsigned short* data, size_t size )
+Histogram::Histogram( const unsigned short* data, size_t size )
+{
+  this->compute( data, size );
+}
+
+Histogram::Histogram( const int* data, size_t size )
+{
+  this->compute( data, size );
+}
+
+Histogram::Histogram( const unsigned int* data, size_t size )
+{
+  this->compute( data, size );
+}
+
+Histogram::Histogram( const float* data, size_t size )
+{
+  this->compute( data, size );
+}
+
+Histogram::Histogram( const double* data, size_t size )
+{
+  this->compute( data, size );
+}
+
+Histogram::~Histogram()
+{
+}
+
+void Histogram::clear()
 {
   this->min_ = Core::Nan();
   this->max_ = Core::Nan();
+  this->min_bin_ = 0;
+  this->max_bin_ = 0;
   this->bin_start_ = Core::Nan();
   this->bin_size_ = Core::Nan();
   this->histogram_.resize( 0 );
-  if ( size == 0 ) return false;
+}
 
+template< class T >
+bool Histogram::compute_table( const T* data, size_t size )
+{
+  this->clear();
+  if ( size == 0 ) return false;
+  
   try
   {
+    size_t num_chunks = GetNumChunks( size );
+    TableChunks< T > chunks( data, size, num_chunks );
+    Parallel::For( 0, num_chunks, boost::bind( &TableChunks< T >::process, &chunks, _1, _2 ), 1 );
+
     std::vector<size_t> histogram;
-    histogram.resize( 0x10000 , 0 );
-    
-    for ( size_t j = 0 ; j < size ; j++ )
-    {
-      histogram[ static_cast<int>( data[ j ] ) ]++;
-    }
+    chunks.combine( histogram );
     
     size_t hist_begin = 0;
-    size_t hist_end = 0;
-    
-    for ( size_t j = 0 ; j < histogram.size() ; j++ )
-    {
-      if ( histogram[ j ] > 0 ) hist_end = j;
-    }
-
-    size_t hsize = histogram.size();
-    for ( size_t j = 0 ; j < hsize; j++ )
-    {
-      if ( histogram[ hsize - 1 - j ] > 0 ) hist_begin = hsize - 1 - j;
-    }
+    while ( histogram[ hist_begin ] == 0 ) hist_begin++;
+    size_t hist_end = histogram.size() - 1;
+    while ( histogram[ hist_end ] == 0 ) hist_end--;
 
-    this->min_ = static_cast<double>( hist_begin );
-    this->max_ = static_cast<double>( hist_end );
+    // Index zero of the table is the lowest value of the data type
+    const double offset = static_cast<double>( std::numeric_limits< T >::lowest() );
+    this->min_ = static_cast<double>( hist_begin ) + offset;
+    this->max_ = static_cast<double>( hist_end ) + offset;
 
     size_t hist_length = hist_end + 1 - hist_begin;
     if ( hist_length > 0x100 ) hist_length = 0x100;
@@ -357,7 +439,7 @@ bool Histogram::compute( const unsigned short* data, size_t size )
     if ( hist_length == 1 )
     {
       this->bin_size_  = 1.0;
-      this->bin_start_ = min_ - ( this->bin_size_ * 0.5 );
+      this->bin_start_ = this->min_ - ( this->bin_size_ * 0.5 );
     }
     else
     {
@@ -365,19 +447,13 @@ bool Histogram::compute( const unsigned short* data, size_t size )
       this->bin_start_ = this->min_ - ( this->bin_size_ * 0.5 );
     }
     
-    for ( size_t j = 0 ; j < histogram_.size() ; j++ )
+    // Merge the table into the bins, the same way incremental updates bin values
+    double inv_bin_size = hist_length == 1 ? 0.0 : 1.0 / this->bin_size_;
+    for ( size_t j = hist_begin; j <= hist_end; j++ )
     {
-      double min_value = this->bin_start_ + j * this->bin_size_;
-      double max_value = this->bin_start_ + ( j + 1 ) * this->bin_size_;
-
-      for ( int k = Ceil( min_value ) ; k < Ceil( max_value ); k ++ )
-      {
-        int idx = static_cast<int>( k );
-        if ( idx >= 0 && idx < static_cast<int>( histogram.size() ) ) 
-        {
-          this->histogram_[ j ] += histogram[ idx ];
-        }
-      }
+      if ( histogram[ j ] == 0 ) continue;
+      this->histogram_[ GetBinIndex( static_cast<double>( j ) + offset, this->bin_start_, 
+        this->bin_size_, inv_bin_size, hist_length - 1 ) ] += histogram[ j ];
     }
 
     std::pair< std::vector<size_t>::iterator, std::vector<size_t>::iterator > min_max = 
@@ -387,69 +463,57 @@ bool Histogram::compute( const unsigned short* data, size_t size )
   }
   catch( ... )
   {
-    this->min_ = Core::Nan();
-    this->max_ = Core::Nan();
-    this->bin_start_ = Core::Nan();
-    this->bin_size_ = Core::Nan();
-    this->histogram_.resize( 0 );
+    this->clear();
     return false;
   }
   
-  return true;  
+  return true;
 }
 
-
-bool Histogram::compute( const int* data, size_t size )
+template< class T >
+bool Histogram::compute_range( const T* data, size_t size )
 {
-  this->min_ = Core::Nan();
-  this->max_ = Core::Nan();
-  this->bin_start_ = Core::Nan();
-  this->bin_size_ = Core::Nan();
-  this->histogram_.resize( 0 );
+  this->clear();
   if ( size == 0 ) return false;
 
   try
   {
-    int int_min = data[ 0 ];
-    int int_max = data[ 0 ];
-
-    for ( size_t j = 1 ; j < size ; j++ )
+    double min, max;
+    if ( !ComputeMinMaxInternals( data, size, min, max ) )
     {
-      if ( data[ j ] < int_min ) int_min = data[ j ];
-      if ( data[ j ] > int_max ) int_max = data[ j ];
+      // Most likely all the data is NaN
+      return false;
     }
     
-    this->min_ = static_cast<double>( int_min );
-    this->max_ = static_cast<double>( int_max );
+    this->min_ = min;
+    this->max_ = max;
 
+    size_t hist_size = 0x100;
     if ( this->min_ == this->max_ )
     {
-      this->bin_size_  = 1.0;
-      this->bin_start_ = this->min_ - ( this->bin_size_ * 0.5 );
-      this->histogram_.resize( 1, 0 );
+      hist_size = 1;
     }
-    else if ( ( this->max_ - this->min_ ) < 256.0 )
+    else if ( std::numeric_limits< T >::is_integer && ( this->max_ - this->min_ ) < 256.0 )
     {
-      size_t hist_size = static_cast<size_t>( this->max_ - this->min_ ) + 1;
-      this->histogram_.resize( hist_size, 0 );
-      this->bin_size_ = ( this->max_ - this->min_ ) / static_cast<double>( hist_size - 1 );
-      this->bin_start_ = this->min_ - ( this->bin_size_ * 0.5 );
+      hist_size = static_cast<size_t>( this->max_ - this->min_ ) + 1;
+    }
+
+    if ( hist_size == 1 )
+    {
+      this->bin_size_  = 1.0;
     }
     else
     {
-      size_t hist_size = 0x100;
-      this->histogram_.resize( hist_size, 0 );
       this->bin_size_ = ( this->max_ - this->min_ ) / static_cast<double>( hist_size - 1 );
-      this->bin_start_ = this->min_ - ( this->bin_size_ * 0.5 );  
     }
+    this->bin_start_ = this->min_ - ( this->bin_size_ * 0.5 );  
 
-    double inv_bin_size = 1.0 / this->bin_size_;
-    for ( size_t j = 1 ; j < size ; j++ )
-    {
-      size_t idx = static_cast<size_t>( ( static_cast<double>( data[j] ) - 
-        this->min_ ) * inv_bin_size );
-      this->histogram_[ idx ]++;
-    }
+    double inv_bin_size = hist_size == 1 ? 0.0 : 1.0 / this->bin_size_;
+    size_t num_chunks = GetNumChunks( size );
+    BinChunks< T > chunks( data, size, num_chunks, this->min_, this->max_, 
+      this->bin_start_, this->bin_size_, inv_bin_size, hist_size );
+    Parallel::For( 0, num_chunks, boost::bind( &BinChunks< T >::process, &chunks, _1, _2 ), 1 );
+    chunks.combine( this->histogram_ );
 
     std::pair< std::vector<size_t>::iterator, std::vector<size_t>::iterator > min_max = 
       boost::minmax_element( this->histogram_.begin(), this->histogram_.end() );
@@ -458,244 +522,189 @@ bool Histogram::compute( const int* data, size_t size )
   }
   catch( ... )
   {
-    this->min_ = Core::Nan();
-    this->max_ = Core::Nan();
-    this->bin_start_ = Core::Nan();
-    this->bin_size_ = Core::Nan();
-    this->histogram_.resize( 0 );
+    this->clear();
     return false;
   }
   
   return true;
 }
 
-
-bool Histogram::compute( const unsigned int* data, size_t size )
+template< class T >
+bool Histogram::update_range( const T* old_data, const T* new_data, size_t size )
 {
-  this->min_ = Core::Nan();
-  this->max_ = Core::Nan();
-  this->bin_start_ = Core::Nan();
-  this->bin_size_ = Core::Nan();
-  this->histogram_.resize( 0 );
-  if ( size == 0 ) return false;
+  if ( !this->is_valid() || this->histogram_.empty() ) return false;
 
-  try
+  // Removing the last values at the minimum or maximum shrinks the range and adding a value
+  // outside of it grows the range, both change all the bins.
+  size_t old_at_min = 0, old_at_max = 0, new_at_min = 0, new_at_max = 0;
+  for ( size_t j = 0; j < size; j++ )
   {
-    unsigned int int_min = data[ 0 ];
-    unsigned int int_max = data[ 0 ];
-
-    for ( size_t j = 1 ; j < size ; j++ )
-    {
-      if ( data[ j ] < int_min ) int_min = data[ j ];
-      if ( data[ j ] > int_max ) int_max = data[ j ];
-    }
-    
-    this->min_ = static_cast<double>( int_min );
-    this->max_ = static_cast<double>( int_max );
-
-    if ( this->min_ == this->max_ )
-    {
-      this->bin_size_  = 1.0;
-      this->bin_start_ = this->min_ - ( this->bin_size_ * 0.5 );
-      this->histogram_.resize( 1, 0 );
-    }
-    else if ( ( this->max_ - this->min_ ) < 256.0 )
-    {
-      size_t hist_size = static_cast<size_t>( this->max_ - this->min_ ) + 1;
-      this->histogram_.resize( hist_size, 0 );
-      this->bin_size_ = ( this->max_ - this->min_ ) / static_cast<double>( hist_size - 1 );
-      this->bin_start_ = this->min_ - ( this->bin_size_ * 0.5 );
-    }
-    else
-    {
-      size_t hist_size = 0x100;
-      this->histogram_.resize( hist_size, 0 );
-      this->bin_size_ = ( this->max_ - this->min_ ) / static_cast<double>( hist_size - 1 );
-      this->bin_start_ = this->min_ - ( this->bin_size_ * 0.5 );  
-    }
-
-    double inv_bin_size = 1.0 / this->bin_size_;
-    for ( size_t j = 1 ; j < size ; j++ )
-    {
-      size_t idx = static_cast<size_t>( ( static_cast<double>( data[j] ) - this->min_ ) * inv_bin_size );
-      this->histogram_[ idx ]++;
-    }
-
-    std::pair< std::vector<size_t>::iterator, std::vector<size_t>::iterator > min_max = 
-      boost::minmax_element( this->histogram_.begin(), this->histogram_.end() );
-    this->min_bin_ = (*min_max.first);
-    this->max_bin_ = (*min_max.second);
+    double val = static_cast< double >( old_data[ j ] );
+    if ( val == this->min_ ) old_at_min++;
+    if ( val == this->max_ ) old_at_max++;
   }
-  catch( ... )
+  for ( size_t j = 0; j < size; j++ )
   {
-    this->min_ = Core::Nan();
-    this->max_ = Core::Nan();
-    this->bin_start_ = Core::Nan();
-    this->bin_size_ = Core::Nan();
-    this->histogram_.resize( 0 );
-    return false;
+    double val = static_cast< double >( new_data[ j ] );
+    if ( !IsFiniteValue( new_data[ j ] ) ) continue;
+    if ( val < this->min_ || val > this->max_ ) return false;
+    if ( val == this->min_ ) new_at_min++;
+    if ( val == this->max_ ) new_at_max++;
+  }
+  if ( old_at_min > new_at_min || old_at_max > new_at_max ) return false;
+
+  // The minimum and maximum are written as often as they are removed, hence the range of the
+  // data is unchanged
+  std::vector< size_t > histogram( this->histogram_ );
+  size_t last_bin = histogram.size() - 1;
+  double inv_bin_size = last_bin == 0 ? 0.0 : 1.0 / this->bin_size_;
+  for ( size_t j = 0; j < size; j++ )
+  {
+    if ( !IsFiniteValue( old_data[ j ] ) ) continue;
+    size_t idx = GetBinIndex( static_cast< double >( old_data[ j ] ), this->bin_start_, 
+      this->bin_size_, inv_bin_size, last_bin );
+    // The histogram does not match the data
+    if ( histogram[ idx ] == 0 ) return false;
+    histogram[ idx ]--;
   }
+  for ( size_t j = 0; j < size; j++ )
+  {
+    if ( !IsFiniteValue( new_data[ j ] ) ) continue;
+    histogram[ GetBinIndex( static_cast< double >( new_data[ j ] ), this->bin_start_, 
+      this->bin_size_, inv_bin_size, last_bin ) ]++;
+  }
+
+  this->histogram_.swap( histogram );
+  std::pair< std::vector<size_t>::iterator, std::vector<size_t>::iterator > min_max = 
+    boost::minmax_element( this->histogram_.begin(), this->histogram_.end() );
+  this->min_bin_ = (*min_max.first);
+  this->max_bin_ = (*min_max.second);
   
   return true;
 }
 
+bool Histogram::compute( const signed char* data, size_t size )
+{
+  return this->compute_table( data, size );
+}
+
+bool Histogram::compute( const unsigned char* data, size_t size )
+{
+  return this->compute_table( data, size );
+}
+
+bool Histogram::compute( const short* data, size_t size )
+{
+  return this->compute_table( data, size );
+}
+
+bool Histogram::compute( const unsigned short* data, size_t size )
+{
+  return this->compute_table( data, size );
+}
+
+bool Histogram::compute( const int* data, size_t size )
+{
+  return this->compute_range( data, size );
+}
+
+bool Histogram::compute( const unsigned int* data, size_t size )
+{
+  return this->compute_range( data, size );
+}
 
 bool Histogram::compute( const float* data, size_t size )
 {
-  this->min_ = Core::Nan();
-  this->max_ = Core::Nan();
-  this->bin_start_ = Core::Nan();
-  this->bin_size_ = Core::Nan();
-  this->histogram_.resize( 0 );
-  if ( size == 0 ) return false;
+  return this->compute_range( data, size );
+}
 
-  try
-  {
-    float float_min = std::numeric_limits<float>::max();
-    float float_max = std::numeric_limits<float>::min();
+bool Histogram::compute( const double* data, size_t size )
+{
+  return this->compute_range( data, size );
+}
 
-    for ( size_t j = 0 ; j < size ; j++ )
-    {
-      float val = data[ j ];
-      if ( ! Core::IsFinite( val ) ) continue;
-      if ( val < float_min ) float_min = val;
-      if ( val > float_max ) float_max = val;
-    }
-    
-    if ( float_min > float_max )
-    {
-      // Most likely all the data is NaN
-      this->min_ = Core::Nan();
-      this->max_ = Core::Nan();
-      this->bin_start_ = Core::Nan();
-      this->bin_size_ = Core::Nan();
-      this->histogram_.resize( 0 );
-      return false;   
-    }
-    
-    this->min_ = static_cast<double>( float_min );
-    this->max_ = static_cast<double>( float_max );
+bool Histogram::update( const signed char* old_data, const signed char* new_data, size_t size )
+{
+  return this->update_range( old_data, new_data, size );
+}
 
-    if ( this->min_ == this->max_ )
-    {
-      this->bin_size_  = 1.0;
-      this->bin_start_ = this->min_ - ( this->bin_size_ * 0.5 );
-      this->histogram_.resize( 1, 0 );
-    }
-    else
-    {
-      size_t hist_size = 0x100;
-      this->histogram_.resize( hist_size, 0 );
-      this->bin_size_ = ( this->max_ - this->min_ ) / static_cast<double>( hist_size - 1 );
-      this->bin_start_ = this->min_ - ( this->bin_size_ * 0.5 );  
-    }
+bool Histogram::update( const unsigned char* old_data, const unsigned char* new_data, 
+  size_t size )
+{
+  return this->update_range( old_data, new_data, size );
+}
 
-    float inv_bin_size = static_cast< float >( 1.0f / this->bin_size_ );
-    for ( size_t j = 1 ; j < size ; j++ )
-    {
-      float val = data[ j ];
-      if ( Core::IsFinite( val ) )
-      {
-        size_t idx = static_cast<size_t>( ( val - float_min ) * inv_bin_size );
-        this->histogram_[ idx ]++;
-      }
-    }
+bool Histogram::update( const short* old_data, const short* new_data, size_t size )
+{
+  return this->update_range( old_data, new_data, size );
+}
 
-    std::pair< std::vector<size_t>::iterator, std::vector<size_t>::iterator > min_max = 
-      boost::minmax_element( this->histogram_.begin(), this->histogram_.end() );
-    this->min_bin_ = (*min_max.first);
-    this->max_bin_ = (*min_max.second);
-  }
-  catch( ... )
-  {
-    this->min_ = Core::Nan();
-    this->max_ = Core::Nan();
-    this->bin_start_ = Core::Nan();
-    this->bin_size_ = Core::Nan();
-    this->histogram_.resize( 0 );
-    return false;
-  }
-  
-  return true;
+bool Histogram::update( const unsigned short* old_data, const unsigned short* new_data, 
+  size_t size )
+{
+  return this->update_range( old_data, new_data, size );
 }
 
+bool Histogram::update( const int* old_data, const int* new_data, size_t size )
+{
+  return this->update_range( old_data, new_data, size );
+}
 
-bool Histogram::compute( const double* data, size_t size )
+bool Histogram::update( const unsigned int* old_data, const unsigned int* new_data, 
+  size_t size )
 {
-  this->min_ = Core::Nan();
-  this->max_ = Core::Nan();
-  this->bin_start_ = Core::Nan();
-  this->bin_size_ = Core::Nan();
-  this->histogram_.resize( 0 );
-  if ( size == 0 ) return false;
+  return this->update_range( old_data, new_data, size );
+}
 
-  try
-  {
-    this->min_ = std::numeric_limits<double>::max();
-    this->max_ = std::numeric_limits<double>::min();
+bool Histogram::update( const float* old_data, const float* new_data, size_t size )
+{
+  return this->update_range( old_data, new_data, size );
+}
 
-    for ( size_t j = 0 ; j < size ; j++ )
-    {
-      double val = data[ j ];
-      if ( ! Core::IsFinite( val ) ) continue;
-      if ( val < this->min_ ) this->min_ = val;
-      if ( val > this->max_ ) this->max_ = val;
-    }
-    
-    if ( this->min_ > this->max_ )
-    {
-      // Most likely all the data is NaN
-      this->min_ = Core::Nan();
-      this->max_ = Core::Nan();
-      this->bin_start_ = Core::Nan();
-      this->bin_size_ = Core::Nan();
-      this->histogram_.resize( 0 );
-      return false;   
-    }
-      
-    if ( this->min_ == this->max_ )
-    {
-      this->bin_size_  = 1.0;
-      this->bin_start_ = this->min_ - ( this->bin_size_ * 0.5 );
-      this->histogram_.resize( 1, 0 );
-    }
-    else
-    {
-      size_t hist_size = 0x100;
-      this->histogram_.resize( hist_size, 0 );
-      this->bin_size_ = ( this->max_ - this->min_ ) / static_cast<double>( hist_size - 1 );
-      this->bin_start_ = this->min_ - ( this->bin_size_ * 0.5 );  
-    }
+bool Histogram::update( const double* old_data, const double* new_data, size_t size )
+{
+  return this->update_range( old_data, new_data, size );
+}
 
-    double inv_bin_size = 1.0 / bin_size_;
+bool Histogram::ComputeMinMax( const signed char* data, size_t size, double& min, double& max )
+{
+  return ComputeMinMaxInternals( data, size, min, max );
+}
 
+bool Histogram::ComputeMinMax( const unsigned char* data, size_t size, double& min, double& max )
+{
+  return ComputeMinMaxInternals( data, size, min, max );
+}
 
-    for ( size_t j = 1 ; j < size ; j++ )
-    {
-      double val = data[ j ];
-      if ( Core::IsFinite( val ) )
-      {
-        size_t idx = static_cast<size_t>( ( val - this->min_ ) * inv_bin_size );
-        this->histogram_[ idx ]++;
-      }   
-    }
-    
-    std::pair< std::vector<size_t>::iterator, std::vector<size_t>::iterator > min_max = 
-      boost::minmax_element( this->histogram_.begin(), this->histogram_.end() );
-    this->min_bin_ = (*min_max.first);
-    this->max_bin_ = (*min_max.second);
-  }
-  catch( ... )
-  {
-    this->min_ = Core::Nan();
-    this->max_ = Core::Nan();
-    this->bin_start_ = Core::Nan();
-    this->bin_size_ = Core::Nan();
-    this->histogram_.resize( 0 );
-    return false;
-  }
-  
-  return true;  
+bool Histogram::ComputeMinMax( const short* data, size_t size, double& min, double& max )
+{
+  return ComputeMinMaxInternals( data, size, min, max );
+}
+
+bool Histogram::ComputeMinMax( const unsigned short* data, size_t size, double& min, 
+  double& max )
+{
+  return ComputeMinMaxInternals( data, size, min, max );
+}
+
+bool Histogram::ComputeMinMax( const int* data, size_t size, double& min, double& max )
+{
+  return ComputeMinMaxInternals( data, size, min, max );
+}
+
+bool Histogram::ComputeMinMax( const unsigned int* data, size_t size, double& min, double& max )
+{
+  return ComputeMinMaxInternals( data, size, min, max );
+}
+
+bool Histogram::ComputeMinMax( const float* data, size_t size, double& min, double& max )
+{
+  return ComputeMinMaxInternals( data, size, min, max );
+}
+
+bool Histogram::ComputeMinMax( const double* data, size_t size, double& min, double& max )
+{
+  return ComputeMinMaxInternals( data, size, min, max );
 }
 
 double Histogram::get_min() const
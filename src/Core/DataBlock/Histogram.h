@@ -66,6 +66,32 @@ public:
   bool compute( const unsigned int* data, size_t size );
   bool compute( const float* data, size_t size );
   bool compute( const double* data, size_t size );
+
+  // UPDATE:
+  /// Update the histogram for a part of the data whose values changed from old_data to
+  /// new_data. Returns false if the histogram cannot be updated incrementally, because the
+  /// minimum or maximum of the data may have changed. The histogram is left unchanged in that
+  /// case and needs to be recomputed.
+  bool update( const signed char* old_data, const signed char* new_data, size_t size );
+  bool update( const unsigned char* old_data, const unsigned char* new_data, size_t size );
+  bool update( const short* old_data, const short* new_data, size_t size );
+  bool update( const unsigned short* old_data, const unsigned short* new_data, size_t size );
+  bool update( const int* old_data, const int* new_data, size_t size );
+  bool update( const unsigned int* old_data, const unsigned int* new_data, size_t size );
+  bool update( const float* old_data, const float* new_data, size_t size );
+  bool update( const double* old_data, const double* new_data, size_t size );
+
+  // COMPUTEMINMAX:
+  /// Compute the minimum and maximum of the finite values in the data. Large arrays are split
+  /// over the threads of the thread pool. Returns false if the data has no finite values.
+  static bool ComputeMinMax( const signed char* data, size_t size, double& min, double& max );
+  static bool ComputeMinMax( const unsigned char* data, size_t size, double& min, double& max );
+  static bool ComputeMinMax( const short* data, size_t size, double& min, double& max );
+  static bool ComputeMinMax( const unsigned short* data, size_t size, double& min, double& max );
+  static bool ComputeMinMax( const int* data, size_t size, double& min, double& max );
+  static bool ComputeMinMax( const unsigned int* data, size_t size, double& min, double& max );
+  static bool ComputeMinMax( const float* data, size_t size, double& min, double& max );
+  static bool ComputeMinMax( const double* data, size_t size, double& min, double& max );
   
   // GET_MIN:
   /// Get the minimum value of the data
@@ -112,6 +138,27 @@ public:
   bool is_valid() const;
         
 private:
+  // COMPUTE_TABLE:
+  // Histogram of 8 and 16 bit data: a table with a count for every possible value is built
+  // first, min and max follow from the table.
+  template< class T >
+  bool compute_table( const T* data, size_t size );
+
+  // COMPUTE_RANGE:
+  // Histogram of 32 and 64 bit data: a pass computing min and max, followed by a pass that
+  // bins the finite values.
+  template< class T >
+  bool compute_range( const T* data, size_t size );
+
+  // UPDATE_RANGE:
+  // Incremental update of the bins, used by all the update functions.
+  template< class T >
+  bool update_range( const T* old_data, const T* new_data, size_t size );
+
+  // CLEAR:
+  // Reset the histogram to the invalid state.
+  void clear();
+
   friend std::string ExportToString( const Histogram& value );
   friend bool ImportFromString( const std::string& str, Histogram& value );
   
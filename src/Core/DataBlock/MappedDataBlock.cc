@@ -0,0 +1,129 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+// Boost includes
+#include <boost/filesystem.hpp>
+
+// Core includes
+#include <Core/DataBlock/MappedDataBlock.h>
+
+namespace Core
+{
+
+MappedDataBlock::MappedDataBlock( size_t nx, size_t ny, size_t nz, DataType type ) :
+  scratch_( false )
+{
+  set_nx( nx );
+  set_ny( ny );
+  set_nz( nz );
+  set_type( type );
+}
+
+MappedDataBlock::~MappedDataBlock()
+{
+  this->file_.close();
+  
+  if ( this->scratch_ )
+  {
+    boost::system::error_code ec;
+    boost::filesystem::remove( this->filename_, ec );
+  }
+}
+
+const boost::filesystem::path& MappedDataBlock::get_filename() const
+{
+  return this->filename_;
+}
+
+bool MappedDataBlock::is_scratch() const
+{
+  return this->scratch_;
+}
+
+bool MappedDataBlock::flush()
+{
+  return this->file_.flush();
+}
+
+DataBlockHandle MappedDataBlock::New( const boost::filesystem::path& filename, long long offset,
+  size_t nx, size_t ny, size_t nz, DataType type, bool write_back, std::string& error )
+{
+  if ( type == DataType::UNKNOWN_E || nx * ny * nz == 0 )
+  {
+    error = "Cannot map a data block without data.";
+    return DataBlockHandle();
+  }
+
+  MappedDataBlockHandle data_block( new MappedDataBlock( nx, ny, nz, type ) );
+  if ( !data_block->file_.open( filename, 
+    write_back ? MappedFile::READ_WRITE_E : MappedFile::COPY_ON_WRITE_E, error, offset, 
+    data_block->get_byte_size() ) )
+  {
+    return DataBlockHandle();
+  }
+
+  data_block->filename_ = filename;
+  data_block->set_data( data_block->file_.get_data() );
+  return data_block;
+}
+
+DataBlockHandle MappedDataBlock::NewScratch( const boost::filesystem::path& directory, 
+  size_t nx, size_t ny, size_t nz, DataType type, std::string& error )
+{
+  if ( type == DataType::UNKNOWN_E || nx * ny * nz == 0 )
+  {
+    error = "Cannot map a data block without data.";
+    return DataBlockHandle();
+  }
+
+  MappedDataBlockHandle data_block( new MappedDataBlock( nx, ny, nz, type ) );
+  try
+  {
+    if ( !boost::filesystem::exists( directory ) ) boost::filesystem::create_directories( directory );
+    data_block->filename_ = directory / 
+      boost::filesystem::unique_path( "MappedDataBlock-%%%%-%%%%-%%%%.raw" );
+  }
+  catch ( ... )
+  {
+    error = "Could not create scratch directory '" + directory.string() + "'.";
+    return DataBlockHandle();
+  }
+
+  // Mark the file as scratch first, so it is removed if mapping it fails
+  data_block->scratch_ = true;
+  if ( !data_block->file_.create( data_block->filename_, 
+    static_cast< long long >( data_block->get_byte_size() ), error ) )
+  {
+    return DataBlockHandle();
+  }
+  
+  data_block->set_data( data_block->file_.get_data() );
+  return data_block;
+}
+
+} // end namespace Core
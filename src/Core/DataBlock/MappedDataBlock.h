@@ -0,0 +1,105 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef CORE_DATABLOCK_MAPPEDDATABLOCK_H
+#define CORE_DATABLOCK_MAPPEDDATABLOCK_H
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1020)
+# pragma once
+#endif 
+
+// STL includes
+#include <string>
+
+// Boost includes
+#include <boost/filesystem/path.hpp>
+
+// Core includes
+#include <Core/DataBlock/DataBlock.h>
+#include <Core/Utils/MappedFile.h>
+
+namespace Core
+{
+
+// Forward Declaration
+class MappedDataBlock;
+typedef boost::shared_ptr< MappedDataBlock > MappedDataBlockHandle;
+
+// CLASS MAPPEDDATABLOCK:
+/// A data block whose data lives in a file that is mapped into memory. The operating system
+/// pages the data in and out, hence the volume can be larger than the physical memory.
+/// NOTE: The data needs to be stored uncompressed, in x-y-z order and in the byte order of the
+/// current architecture.
+
+class MappedDataBlock : public DataBlock
+{
+  // -- Constructor/destructor --
+private:
+  MappedDataBlock( size_t nx, size_t ny, size_t nz, DataType type );
+
+public: 
+  virtual ~MappedDataBlock();
+
+  // -- access --
+public:
+  // GET_FILENAME:
+  /// The file the data is mapped from.
+  const boost::filesystem::path& get_filename() const;
+
+  // IS_SCRATCH:
+  /// Whether the file is a scratch file that is removed with the data block.
+  bool is_scratch() const;
+
+  // FLUSH:
+  /// Write the changes back to the file, if the file is mapped for writing.
+  bool flush();
+
+  // -- factories --
+public:
+  // NEW:
+  /// Map the data of an existing file starting at offset. If write_back is false, changes to the
+  /// data stay in memory and the file is never modified, otherwise the changes are written
+  /// back to the file.
+  static DataBlockHandle New( const boost::filesystem::path& filename, long long offset,
+    size_t nx, size_t ny, size_t nz, DataType type, bool write_back, std::string& error );
+
+  // NEWSCRATCH:
+  /// Create a data block backed by a new scratch file in the given directory. The file is 
+  /// removed when the data block is destroyed.
+  static DataBlockHandle NewScratch( const boost::filesystem::path& directory, 
+    size_t nx, size_t ny, size_t nz, DataType type, std::string& error );
+
+private:
+  MappedFile file_;
+  boost::filesystem::path filename_;
+  bool scratch_;
+};
+
+} // end namespace Core
+
+#endif
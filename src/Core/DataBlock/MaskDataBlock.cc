@@ -28,6 +28,7 @@
 
 #include <Core/DataBlock/MaskDataBlock.h>
 #include <Core/DataBlock/MaskDataBlockManager.h>
+#include <Core/Math/MathFunctions.h>
 
 namespace Core
 {
@@ -39,29 +40,146 @@ MaskDataBlock::MaskDataBlock( DataBlockHandle data_block, unsigned int mask_bit
   data_block_( data_block ),
   mask_bit_( mask_bit ),
   mask_value_( 1 << mask_bit ),
-  not_mask_value_( ~( 1 << mask_bit ) ) 
+  not_mask_value_( ~( 1 << mask_bit ) ),
+  sparse_generation_( -1 ),
+  edit_count_( 0 ),
+  dirty_regions_start_( 0 )
 {
   this->data_ = reinterpret_cast<unsigned char*>( this->data_block_->get_data() );
 }
 
 MaskDataBlock::~MaskDataBlock()
 {
-  MaskDataBlockManager::Instance()->release( data_block_, mask_bit_ );
+  // A sparse mask does not occupy a bitplane
+  if ( this->data_block_ )
+  {
+    MaskDataBlockManager::Instance()->release( data_block_, mask_bit_ );
+  }
 }
 
 DataBlockHandle MaskDataBlock::get_data_block()
 {
+  if ( !this->data_ ) this->densify();
   return this->data_block_;
 }
 
 DataBlock::generation_type MaskDataBlock::get_generation() const
 {
-  return  this->data_block_->get_generation();
+  DataBlockHandle data_block;
+  {
+    boost::mutex::scoped_lock lock( this->sparse_mutex_ );
+    if ( this->sparse_data_ ) return this->sparse_generation_;
+    data_block = this->data_block_;
+  }
+  return  data_block->get_generation();
 }
 
 void MaskDataBlock::increase_generation()
 {
+  if ( !this->data_ ) this->densify();
+  this->data_block_->increase_generation();
+
+  // Changes before this one are not needed anymore, as everything changed
+  boost::mutex::scoped_lock lock( this->dirty_regions_mutex_ );
+  this->edit_count_++;
+  this->dirty_regions_.clear();
+  this->dirty_regions_start_ = this->edit_count_;
+}
+
+void MaskDataBlock::increase_generation( const IndexVector& min, const IndexVector& max )
+{
+  if ( !this->data_ ) this->densify();
   this->data_block_->increase_generation();
+
+  boost::mutex::scoped_lock lock( this->dirty_regions_mutex_ );
+  this->edit_count_++;
+  if ( min.x() > max.x() || min.y() > max.y() || min.z() > max.z() ) return;
+
+  DirtyRegion region;
+  region.edit_count_ = this->edit_count_;
+  region.min_ = min;
+  region.max_ = max;
+  this->dirty_regions_.push_back( region );
+
+  // Only keep a limited history, consumers that are further behind need to update completely
+  const size_t MAX_DIRTY_REGIONS_C = 256;
+  if ( this->dirty_regions_.size() > MAX_DIRTY_REGIONS_C )
+  {
+    this->dirty_regions_start_ = this->dirty_regions_.front().edit_count_;
+    this->dirty_regions_.pop_front();
+  }
+}
+
+size_t MaskDataBlock::get_edit_count() const
+{
+  boost::mutex::scoped_lock lock( this->dirty_regions_mutex_ );
+  return this->edit_count_;
+}
+
+bool MaskDataBlock::get_dirty_region( size_t edit_count, IndexVector& min, 
+  IndexVector& max ) const
+{
+  boost::mutex::scoped_lock lock( this->dirty_regions_mutex_ );
+  if ( edit_count < this->dirty_regions_start_ ) return false;
+
+  min = IndexVector( this->nx_, this->ny_, this->nz_ );
+  max = IndexVector( -1, -1, -1 );
+  for ( size_t j = 0; j < this->dirty_regions_.size(); j++ )
+  {
+    const DirtyRegion& region = this->dirty_regions_[ j ];
+    if ( region.edit_count_ <= edit_count ) continue;
+
+    min = IndexVector( Min( min.x(), region.min_.x() ), Min( min.y(), region.min_.y() ),
+      Min( min.z(), region.min_.z() ) );
+    max = IndexVector( Max( max.x(), region.max_.x() ), Max( max.y(), region.max_.y() ),
+      Max( max.z(), region.max_.z() ) );
+  }
+  return true;
+}
+
+size_t MaskDataBlock::get_byte_size() const
+{
+  SparseMaskDataHandle sparse_data = this->get_sparse_data();
+  if ( sparse_data ) return sparse_data->get_byte_size();
+  return ( this->get_size() >> 3 ) + 1;
+}
+
+bool MaskDataBlock::is_sparse() const
+{
+  return this->get_sparse_data().get() != 0;
+}
+
+bool MaskDataBlock::get_bitplane( DataBlockHandle& data_block, unsigned char& mask_value ) const
+{
+  boost::mutex::scoped_lock lock( this->sparse_mutex_ );
+  data_block = this->data_block_;
+  mask_value = this->mask_value_;
+  return data_block.get() != 0;
+}
+
+SparseMaskDataHandle MaskDataBlock::get_sparse_data() const
+{
+  boost::mutex::scoped_lock lock( this->sparse_mutex_ );
+  return this->sparse_data_;
+}
+
+bool MaskDataBlock::sparsify()
+{
+  return MaskDataBlockManager::Instance()->sparsify( this );
+}
+
+bool MaskDataBlock::densify()
+{
+  return MaskDataBlockManager::Instance()->densify( this );
+}
+
+bool MaskDataBlock::get_sparse_mask_at( size_t index ) const
+{
+  SparseMaskDataHandle sparse_data = this->get_sparse_data();
+  if ( sparse_data ) return sparse_data->get_mask_at( index );
+
+  // The mask was moved back into a bitplane in the mean time
+  return ( this->data_[ index ] & this->mask_value_ ) != 0;
 }
 
 bool MaskDataBlock::extract_slice( SliceType type, 
@@ -368,8 +486,9 @@ bool MaskDataBlock::insert_slice( const MaskDataSliceHandle slice )
         }
       }
 
-      // Generate a new generation number for the new volume
-      this->increase_generation();
+      // Generate a new generation number for the new volume, only the slice changed
+      this->increase_generation( IndexVector( index, 0, 0 ), 
+        IndexVector( index, ny - 1, nz - 1 ) );
 
       return true;
     }
@@ -431,8 +550,9 @@ bool MaskDataBlock::insert_slice( const MaskDataSliceHandle slice )
         }
       }
 
-      // Generate a new generation number for the new volume
-      this->increase_generation();
+      // Generate a new generation number for the new volume, only the slice changed
+      this->increase_generation( IndexVector( 0, index, 0 ), 
+        IndexVector( nx - 1, index, nz - 1 ) );
 
       return true;
     }
@@ -494,8 +614,9 @@ bool MaskDataBlock::insert_slice( const MaskDataSliceHandle slice )
         }
       }
       
-      // Generate a new generation number for the new volume
-      this->increase_generation();
+      // Generate a new generation number for the new volume, only the slice changed
+      this->increase_generation( IndexVector( 0, 0, index ), 
+        IndexVector( nx - 1, ny - 1, index ) );
 
       return true;
     }
@@ -33,14 +33,21 @@
 # pragma once
 #endif 
 
+// STL includes
+#include <deque>
+
 // Boost includes
 #include <boost/utility.hpp>
 #include <boost/smart_ptr.hpp>
+#include <boost/thread/mutex.hpp>
 
 // Core includes
+#include <Core/Geometry/GridTransform.h>
+#include <Core/Geometry/IndexVector.h>
 #include <Core/DataBlock/MaskDataBlockFWD.h>
 #include <Core/DataBlock/MaskDataSlice.h>
 #include <Core/DataBlock/DataBlock.h>
+#include <Core/DataBlock/SparseMaskData.h>
 
 namespace Core
 {
@@ -52,6 +59,11 @@ namespace Core
 /// When a new datablock is created, it is checked whether a similar mask with
 /// the same dimensions exists with an unassigned bit and used if possible,
 /// otherwise a new one is generated.
+/// A mask can also be stored sparse, in which case it does not occupy a bit in a datablock.
+/// Accessing the bitplane of a sparse mask (through get_mask_data(), get_mutex(), 
+/// get_data_block(), etc.) transparently converts it back into a bitplane.
+/// NOTE: Pointers into the bitplane and the inline accessors are only valid while the mutex
+/// of the mask is held, as a mask that is not locked can be moved out of its bitplane.
 class MaskDataBlock : public boost::noncopyable, 
   public boost::enable_shared_from_this< MaskDataBlock >
 {
@@ -95,20 +107,20 @@ public:
     return this->nx_ * this->ny_ * this->nz_;
   }
 
-  inline size_t get_byte_size() const
-  {
-    return ( this->get_size() >> 3 ) + 1;
-  }
+  // GET_BYTE_SIZE:
+  /// The amount of memory used by this mask
+  size_t get_byte_size() const;
 
   inline size_t to_index( size_t x, size_t y, size_t z ) const
   {
-    return this->data_block_->to_index( x, y, z );
+    return x + this->nx_ * ( y + this->ny_ * z );
   }
 
   // DATA
   /// Pointer to the block of data
   inline unsigned char* get_mask_data()
   {
+    if ( !this->data_ ) this->densify();
     return  this->data_;
   }
 
@@ -116,6 +128,7 @@ public:
   /// Get the bit that describes the mask
   inline unsigned int get_mask_bit()
   {
+    if ( !this->data_ ) this->densify();
     return this->mask_bit_;
   }
 
@@ -123,6 +136,7 @@ public:
   /// Get the value at which the mask is stored
   inline unsigned char get_mask_value()
   {
+    if ( !this->data_ ) this->densify();
     return this->mask_value_;
   }
 
@@ -140,8 +154,25 @@ public:
 
   // INCREASE_GENERATION:
   /// Increase the generation number to a new unique number.
+  /// NOTE: This marks the whole mask as changed.
   void increase_generation();
 
+  // INCREASE_GENERATION:
+  /// Increase the generation number and record that only the voxels in the index range
+  /// [ min, max ] were changed. If min is larger than max, nothing was changed.
+  void increase_generation( const IndexVector& min, const IndexVector& max );
+
+  // GET_EDIT_COUNT:
+  /// Number of times the mask was changed. Unlike the generation number, this number does not
+  /// change when other masks that share the datablock are changed.
+  size_t get_edit_count() const;
+
+  // GET_DIRTY_REGION:
+  /// Get the bounding box of the voxels that were changed after the mask had the given edit
+  /// count. If nothing changed, min is larger than max. Returns false if the changes are not
+  /// known anymore, in which case the whole mask needs to be treated as changed.
+  bool get_dirty_region( size_t edit_count, IndexVector& min, IndexVector& max ) const;
+
   // GET_MASK_AT:
   /// Get the mask value at a certain coordinate
   inline bool get_mask_at( size_t x, size_t y, size_t z ) const
@@ -160,6 +191,7 @@ public:
         return false;
     }
 
+    if ( !this->data_ ) return this->get_sparse_mask_at( index );
     return ( this->data_[ index ] & this->mask_value_ ) != 0;
   }
 
@@ -174,6 +206,7 @@ public:
   /// Set the mask value at a certain index
   inline void set_mask_at( size_t index )
   {
+    if ( !this->data_ ) this->densify();
     this->data_[ index ] |= this->mask_value_;
   }
   
@@ -186,6 +219,7 @@ public:
 
   inline void clear_mask_at( size_t index )
   {
+    if ( !this->data_ ) this->densify();
     this->data_[ index ] &= this->not_mask_value_;
   }
 
@@ -196,9 +230,40 @@ public:
   /// Get the mutex that locks the datablock
   mutex_type& get_mutex() const
   { 
+    if ( !this->data_ ) const_cast< MaskDataBlock* >( this )->densify();
     return data_block_->get_mutex();
   }
 
+  // -- sparse storage --
+public:
+  // IS_SPARSE:
+  /// Whether the mask is currently stored sparse
+  bool is_sparse() const;
+
+  // GET_BITPLANE:
+  /// Get the datablock and the value of the bitplane of the mask without moving a sparse mask
+  /// back into a bitplane. Returns false if the mask is sparse. After locking the datablock,
+  /// the caller needs to check whether the mask still uses the same bitplane.
+  bool get_bitplane( DataBlockHandle& data_block, unsigned char& mask_value ) const;
+
+  // GET_SPARSE_DATA:
+  /// Get the sparse data of the mask, or an empty handle if the mask is stored in a bitplane.
+  /// As the sparse data is never altered, it can be read without locking the mask.
+  SparseMaskDataHandle get_sparse_data() const;
+
+  // SPARSIFY:
+  /// Move the mask out of its bitplane into sparse storage if that uses considerably less 
+  /// memory. Returns true if the mask is stored sparse afterwards.
+  /// NOTE: This function can only be called on the application thread while the mask is not
+  /// in use by a filter or tool, as pointers into the bitplane become invalid. Threads that do
+  /// not lock the layer of the mask, such as the renderer, need to use get_bitplane().
+  bool sparsify();
+
+  // DENSIFY:
+  /// Move a sparse mask back into a bitplane. This is done automatically when the bitplane
+  /// is accessed.
+  bool densify();
+
   // -- Signals and slots --
 public:
 
@@ -222,24 +287,62 @@ public:
 
   // -- internals of the DataBlock --
 private:
+  friend class MaskDataBlockManager;
+
+  // GET_SPARSE_MASK_AT:
+  /// Look up a voxel of a sparse mask
+  bool get_sparse_mask_at( size_t index ) const;
+
   /// The dimensions of the datablock
   size_t nx_;
   size_t ny_;
   size_t nz_;
 
-  /// The datablock that is shared
+  /// The datablock that is shared, empty if the mask is sparse
   DataBlockHandle data_block_;
 
   /// The bit that is used for this mask
-  const unsigned int mask_bit_;
+  unsigned int mask_bit_;
 
   /// Values that have the maskbit set or all the other bits
-  const unsigned char mask_value_;
-  const unsigned char not_mask_value_;
+  unsigned char mask_value_;
+  unsigned char not_mask_value_;
 
-  /// Cached data pointer of the underlying DataBlock
+  /// Cached data pointer of the underlying DataBlock, null if the mask is sparse
   unsigned char* data_;
 
+  /// The mask when it is stored sparse
+  SparseMaskDataHandle sparse_data_;
+
+  /// Generation number and grid of a sparse mask, needed to find a bitplane when the mask
+  /// is moved back into a datablock
+  DataBlock::generation_type sparse_generation_;
+  GridTransform sparse_grid_transform_;
+
+  /// Protects switching between sparse and bitplane storage. This lock is only held briefly
+  /// and no other locks are acquired while holding it.
+  mutable boost::mutex sparse_mutex_;
+
+  /// A bounding box of changed voxels
+  struct DirtyRegion
+  {
+    size_t edit_count_;
+    IndexVector min_;
+    IndexVector max_;
+  };
+
+  /// The most recent changes, used by consumers such as the isosurface to only update the
+  /// part of their data that is affected by a change
+  std::deque< DirtyRegion > dirty_regions_;
+
+  /// The number of changes to the mask, and the edit count since which all changes are 
+  /// recorded in dirty_regions_
+  size_t edit_count_;
+  size_t dirty_regions_start_;
+
+  /// Protects the dirty regions, this is a leaf lock as well
+  mutable boost::mutex dirty_regions_mutex_;
+
 };
 
 } // end namespace Core
@@ -81,41 +81,38 @@ public:
   // List that maintains a list of which bits are used in
   typedef std::vector< MaskDataBlockEntry > mask_list_type;
   mask_list_type mask_list_;
-};
-
 
+  // ALLOCATE_BIT:
+  // Find an unused bit in a datablock with the given grid, or create a new datablock if none
+  // is available. The bit is not marked as being used yet.
+  bool allocate_bit( const GridTransform& grid_transform, DataBlockHandle& data_block,
+    unsigned int& mask_bit, size_t& mask_entry_index );
 
-MaskDataBlockManager::MaskDataBlockManager() :
-  private_( new MaskDataBlockManagerInternal )
-{
-}
-
-MaskDataBlockManager::~MaskDataBlockManager()
-{
-}
+  // RELEASE_BIT:
+  // Mark the bit of a datablock as being unused and release the datablock if none of its bits
+  // are used.
+  void release_bit( const DataBlockHandle& data_block, unsigned int mask_bit );
+};
 
-bool MaskDataBlockManager::create( GridTransform grid_transform, MaskDataBlockHandle& mask )
+bool MaskDataBlockManagerInternal::allocate_bit( const GridTransform& grid_transform, 
+  DataBlockHandle& data_block, unsigned int& mask_bit, size_t& mask_entry_index )
 {
-  lock_type lock( get_mutex() );
+  data_block.reset();
+  mask_bit = 0;
+  mask_entry_index = 0;
 
-  DataBlockHandle data_block;
-  unsigned int mask_bit = 0;
-  size_t mask_entry_index = 0;
-
-  MaskDataBlockManagerInternal::mask_list_type& mask_list = private_->mask_list_;
-
-  for (size_t j=0; j<mask_list.size(); j++)
+  for (size_t j=0; j<mask_list_.size(); j++)
   {
     // Find an empty location
-    if ( ( mask_list[ j ].bits_used_.count() != 8 ) &&
-      ( grid_transform == mask_list[ j ].grid_transform_ ) )
+    if ( ( mask_list_[ j ].bits_used_.count() != 8 ) &&
+      ( grid_transform == mask_list_[ j ].grid_transform_ ) )
     {
-      data_block = mask_list[ j ].data_block_;
+      data_block = mask_list_[ j ].data_block_;
       mask_entry_index = j;
 
       for ( size_t k = 0; k < 8; k++) 
       {
-        if ( !( mask_list[j].bits_used_.test( k ) ) )
+        if ( !( mask_list_[j].bits_used_.test( k ) ) )
         {
           mask_bit = static_cast<unsigned int>( k );
           // drop out of for loop
@@ -133,9 +130,64 @@ bool MaskDataBlockManager::create( GridTransform grid_transform, MaskDataBlockHa
     data_block = StdDataBlock::New( grid_transform.get_nx(), grid_transform.get_ny(), 
       grid_transform.get_nz(), DataType::UCHAR_E );
     if ( !data_block ) return false;        
+    // NOTE: The masks keep pointers to the data, hence it cannot be shared with duplicates
+    data_block->disable_sharing();
     mask_bit = 0;
-    mask_entry_index = mask_list.size();
-    mask_list.push_back( MaskDataBlockEntry( data_block, grid_transform ) );
+    mask_entry_index = mask_list_.size();
+    mask_list_.push_back( MaskDataBlockEntry( data_block, grid_transform ) );
+  }
+
+  return true;
+}
+
+void MaskDataBlockManagerInternal::release_bit( const DataBlockHandle& data_block, 
+  unsigned int mask_bit )
+{
+  // Remove the MaskDataBlock from the list
+  for ( size_t j = 0 ; j < mask_list_.size() ; j++ )
+  {
+    if ( mask_list_[ j ].data_block_ == data_block )
+    {
+      mask_list_[ j ].bits_used_[mask_bit] = 0;
+      mask_list_[ j ].data_masks_[mask_bit].reset();
+
+      // If the DataBlock is not used any more clear it
+      if ( mask_list_[ j ].bits_used_.count() == 0 )
+      {
+        DataBlockManager::Instance()->unregister_datablock( data_block->get_generation() );
+        mask_list_.erase( mask_list_.begin() + j );
+      }
+
+      break;
+    }
+  }
+}
+
+
+
+MaskDataBlockManager::MaskDataBlockManager() :
+  private_( new MaskDataBlockManagerInternal )
+{
+}
+
+MaskDataBlockManager::~MaskDataBlockManager()
+{
+}
+
+bool MaskDataBlockManager::create( GridTransform grid_transform, MaskDataBlockHandle& mask )
+{
+  lock_type lock( get_mutex() );
+
+  DataBlockHandle data_block;
+  unsigned int mask_bit = 0;
+  size_t mask_entry_index = 0;
+
+  MaskDataBlockManagerInternal::mask_list_type& mask_list = private_->mask_list_;
+
+  if ( !this->private_->allocate_bit( grid_transform, data_block, mask_bit, 
+    mask_entry_index ) )
+  {
+    return false;
   }
 
   // Generate the new mask
@@ -201,33 +253,141 @@ bool MaskDataBlockManager::create( DataBlock::generation_type generation, unsign
 void MaskDataBlockManager::release(DataBlockHandle& datablock, unsigned int mask_bit)
 {
   lock_type lock( get_mutex() );
+  this->private_->release_bit( datablock, mask_bit );
+}
 
-  MaskDataBlockManagerInternal::mask_list_type& mask_list = this->private_->mask_list_;
+bool MaskDataBlockManager::sparsify( MaskDataBlock* mask )
+{
+  lock_type lock( this->get_mutex() );
 
-  // Remove the MaskDataBlock from the list
-  for ( size_t j = 0 ; j < mask_list.size() ; j++ )
+  if ( !mask->data_ ) return true;
+
+  DataBlockHandle data_block = mask->data_block_;
+  GridTransform grid_transform;
+  bool found = false;
+  MaskDataBlockManagerInternal::mask_list_type& mask_list = this->private_->mask_list_;
+  for ( size_t j = 0; j < mask_list.size(); j++ )
   {
-    if ( mask_list[ j ].data_block_ == datablock )
+    if ( mask_list[ j ].data_block_ == data_block )
     {
-      mask_list[ j ].bits_used_[mask_bit] = 0;
-      mask_list[ j ].data_masks_[mask_bit].reset();
+      grid_transform = mask_list[ j ].grid_transform_;
+      found = true;
+      break;
+    }
+  }
+  if ( !found ) return false;
 
-      // If the DataBlock is not used any more clear it
-      if ( mask_list[ j ].bits_used_.count() == 0 )
-      {
-        DataBlockManager::Instance()->unregister_datablock( datablock->get_generation() );
-        mask_list.erase( mask_list.begin() + j );
-      }
+  // NOTE: The generation number is read without holding the lock of the datablock, as
+  // DataBlock::get_generation() locks it as well. If it changed while compressing, the mask
+  // was altered and is left alone.
+  DataBlock::generation_type generation = data_block->get_generation();
 
-      break;
+  // Skip masks that are being read or written at the moment
+  DataBlock::lock_type data_lock( data_block->get_mutex(), boost::try_to_lock );
+  if ( !data_lock.owns_lock() ) return false;
+
+  SparseMaskDataHandle sparse_data = SparseMaskData::Compress( mask->data_, 
+    mask->mask_value_, mask->nx_, mask->ny_, mask->nz_ );
+
+  // Only switch if the sparse mask uses less than half of the memory of a bitplane
+  if ( sparse_data->get_byte_size() > ( mask->get_size() >> 4 ) ) return false;
+
+  {
+    boost::mutex::scoped_lock sparse_lock( mask->sparse_mutex_ );
+    mask->sparse_data_ = sparse_data;
+    mask->sparse_generation_ = generation;
+    mask->sparse_grid_transform_ = grid_transform;
+    mask->data_ = 0;
+    mask->data_block_.reset();
+  }
+  data_lock.unlock();
+
+  if ( data_block->get_generation() != generation )
+  {
+    boost::mutex::scoped_lock sparse_lock( mask->sparse_mutex_ );
+    mask->sparse_data_.reset();
+    mask->data_block_ = data_block;
+    mask->data_ = reinterpret_cast< unsigned char* >( data_block->get_data() );
+    return false;
+  }
+
+  this->private_->release_bit( data_block, mask->mask_bit_ );
+  return true;
+}
+
+bool MaskDataBlockManager::densify( MaskDataBlock* mask )
+{
+  lock_type lock( this->get_mutex() );
+
+  if ( mask->data_ ) return true;
+
+  DataBlockHandle data_block;
+  unsigned int mask_bit = 0;
+  size_t mask_entry_index = 0;
+  if ( !this->private_->allocate_bit( mask->sparse_grid_transform_, data_block, mask_bit, 
+    mask_entry_index ) )
+  {
+    return false;
+  }
+
+  {
+    DataBlock::lock_type data_lock( data_block->get_mutex() );
+    unsigned char mask_value = static_cast< unsigned char >( 1 << mask_bit );
+    mask->sparse_data_->decompress( reinterpret_cast< unsigned char* >( 
+      data_block->get_data() ), mask_value );
+
+    boost::mutex::scoped_lock sparse_lock( mask->sparse_mutex_ );
+    mask->data_block_ = data_block;
+    mask->mask_bit_ = mask_bit;
+    mask->mask_value_ = mask_value;
+    mask->not_mask_value_ = static_cast< unsigned char >( ~mask_value );
+    mask->data_ = reinterpret_cast< unsigned char* >( data_block->get_data() );
+    mask->sparse_data_.reset();
+  }
+
+  // The generation number of a mask that has been registered needs to stay valid
+  if ( mask->sparse_generation_ != -1 )
+  {
+    if ( data_block->get_generation() == -1 )
+    {
+      DataBlockManager::Instance()->register_datablock( data_block );
+    }
+    else
+    {
+      data_block->increase_generation();
     }
   }
+
+  MaskDataBlockEntry& entry = this->private_->mask_list_[ mask_entry_index ];
+  entry.bits_used_[ mask_bit ] = 1;
+  entry.data_masks_[ mask_bit ] = mask->shared_from_this();
+
+  return true;
 }
 
 bool MaskDataBlockManager::compact()
 {
-  // TODO: Need to implement this
-  return false;
+  lock_type lock( this->get_mutex() );
+
+  // Collect the masks first, as sparsifying a mask alters the list
+  std::vector< MaskDataBlockHandle > masks;
+  MaskDataBlockManagerInternal::mask_list_type& mask_list = this->private_->mask_list_;
+  for ( size_t j = 0; j < mask_list.size(); j++ )
+  {
+    for ( size_t k = 0; k < 8; k++ )
+    {
+      MaskDataBlockHandle mask = mask_list[ j ].data_masks_[ k ].lock();
+      if ( mask ) masks.push_back( mask );
+    }
+  }
+
+  size_t num_blocks = mask_list.size();
+  for ( size_t j = 0; j < masks.size(); j++ )
+  {
+    this->sparsify( masks[ j ].get() );
+  }
+
+  return mask_list.size() < num_blocks;
 }
 
 void MaskDataBlockManager::register_data_block( DataBlockHandle data_block, 
@@ -235,6 +395,7 @@ void MaskDataBlockManager::register_data_block( DataBlockHandle data_block,
 {
   lock_type lock( get_mutex() );
 
+  data_block->disable_sharing();
   this->private_->mask_list_.push_back( MaskDataBlockEntry( data_block, grid_transform ) );
 }
 
@@ -642,6 +803,10 @@ bool MaskDataBlockManager::Duplicate( MaskDataBlockHandle src_mask_data_block,
     return false;
   }
 
+  // NOTE: A sparse source needs to be moved back into a bitplane before the destination is
+  // locked, as it may be moved into the data block of the destination.
+  src_mask_data_block->densify();
+
   // Step (2): Need to lock the source data
   MaskDataBlock::lock_type lock( dst_mask_data_block->get_mutex( ) );
   MaskDataBlock::shared_lock_type slock;
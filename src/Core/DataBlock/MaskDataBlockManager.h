@@ -93,8 +93,11 @@ public:
   void register_data_block( DataBlockHandle data_block, const GridTransform& grid_transform );
     
   // COMPACT:
-  /// Compact the masks into less memory if possible by moving them around
-  /// to compact the space required.
+  /// Compact the masks into less memory by moving masks that only cover a small part of the
+  /// volume into sparse storage. Datablocks of which no bitplane is used anymore are released.
+  /// Masks that are locked are skipped. Returns true if any datablock was released.
+  /// NOTE: Like MaskDataBlock::sparsify(), this can only be called on the application thread
+  /// while none of the masks is in use by a filter or tool.
   bool compact();
 
   // -- MaskDataBlock callbacks --
@@ -107,6 +110,15 @@ protected:
   /// released
   void release( DataBlockHandle& datablock, unsigned int mask_bit );
 
+  // SPARSIFY:
+  /// Move a mask out of its bitplane into sparse storage if it is worth it and the mask is
+  /// not locked.
+  bool sparsify( MaskDataBlock* mask );
+
+  // DENSIFY:
+  /// Move a sparse mask back into an unused bitplane.
+  bool densify( MaskDataBlock* mask );
+
   // -- internals of this class --
 private:
    MaskDataBlockManagerInternalHandle private_;
@@ -0,0 +1,802 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+// STL includes
+#include <algorithm>
+#include <cstring>
+
+// Boost includes
+#include <boost/bind.hpp>
+#include <boost/cstdint.hpp>
+
+// Core includes
+#include <Core/Utils/Parallel.h>
+#include <Core/DataBlock/MaskDataBlockOperations.h>
+
+namespace Core
+{
+
+// Every byte of a word with only its lowest bit set
+static const boost::uint64_t LSB_MASK_C = 0x0101010101010101ULL;
+
+static inline boost::uint64_t LoadWord( const unsigned char* data )
+{
+  boost::uint64_t word;
+  std::memcpy( &word, data, sizeof( word ) );
+  return word;
+}
+
+static inline void StoreWord( unsigned char* data, boost::uint64_t word )
+{
+  std::memcpy( data, &word, sizeof( word ) );
+}
+
+// EXTRACTBITS:
+// Move the bit of the mask down to the lowest bit of each byte
+static inline boost::uint64_t ExtractBits( boost::uint64_t word, unsigned int bit )
+{
+  return ( word >> bit ) & LSB_MASK_C;
+}
+
+// INSERTBITS:
+// Replace the bit of the mask in each byte with the lowest bit of each byte of bits
+static inline boost::uint64_t InsertBits( boost::uint64_t word, boost::uint64_t bits, 
+  unsigned int bit )
+{
+  return ( word & ~( LSB_MASK_C << bit ) ) | ( bits << bit );
+}
+
+// CLASS MaskOperationLock
+// Write locks the destination and read locks the sources. As the shared lock is not recursive,
+// only data blocks that are not locked already are locked.
+// NOTE: Sparse masks are moved back into a bitplane before any data block is locked. Moving a
+// mask locks the manager and the data block that receives it, which could be one of the data
+// blocks locked here.
+
+class MaskOperationLock : public boost::noncopyable
+{
+public:
+  MaskOperationLock( MaskDataBlockHandle dst, MaskDataBlockHandle src1, 
+    MaskDataBlockHandle src2 = MaskDataBlockHandle(), 
+    MaskDataBlockHandle src3 = MaskDataBlockHandle() )
+  {
+    if ( dst ) dst->densify();
+    if ( src1 ) src1->densify();
+    if ( src2 ) src2->densify();
+    if ( src3 ) src3->densify();
+
+    if ( dst )
+    {
+      MaskDataBlock::lock_type lock( dst->get_mutex() );
+      this->write_lock_.swap( lock );
+      this->locked_.push_back( dst->get_data_block() );
+    }
+
+    this->read_lock( src1 );
+    this->read_lock( src2 );
+    this->read_lock( src3 );
+  }
+
+private:
+  void read_lock( MaskDataBlockHandle src )
+  {
+    if ( !src ) return;
+    DataBlockHandle data_block = src->get_data_block();
+    if ( std::find( this->locked_.begin(), this->locked_.end(), data_block ) != 
+      this->locked_.end() ) return;
+
+    this->read_locks_.push_back( boost::shared_ptr< MaskDataBlock::shared_lock_type >( 
+      new MaskDataBlock::shared_lock_type( src->get_mutex() ) ) );
+    this->locked_.push_back( data_block );
+  }
+
+  MaskDataBlock::lock_type write_lock_;
+  std::vector< boost::shared_ptr< MaskDataBlock::shared_lock_type > > read_locks_;
+  std::vector< DataBlockHandle > locked_;
+};
+
+static bool HasSameSize( MaskDataBlockHandle mask1, MaskDataBlockHandle mask2 )
+{
+  return mask1 && mask2 && mask1->get_nx() == mask2->get_nx() &&
+    mask1->get_ny() == mask2->get_ny() && mask1->get_nz() == mask2->get_nz();
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Logical operations
+//////////////////////////////////////////////////////////////////////////
+
+struct AndOperation
+{
+  static boost::uint64_t Apply( boost::uint64_t a, boost::uint64_t b ) { return a & b; }
+};
+
+struct OrOperation
+{
+  static boost::uint64_t Apply( boost::uint64_t a, boost::uint64_t b ) { return a | b; }
+};
+
+struct XorOperation
+{
+  static boost::uint64_t Apply( boost::uint64_t a, boost::uint64_t b ) { return a ^ b; }
+};
+
+struct RemoveOperation
+{
+  static boost::uint64_t Apply( boost::uint64_t a, boost::uint64_t b ) { return a & ~b; }
+};
+
+struct InvertOperation
+{
+  static boost::uint64_t Apply( boost::uint64_t a, boost::uint64_t ) { return ~a; }
+};
+
+// CLASS BitPlaneOperation
+// Applies a word operation on the bitplanes of two source masks and writes the result into the
+// bitplane of the destination mask, eight voxels at a time.
+
+template< class OPERATION >
+class BitPlaneOperation
+{
+public:
+  BitPlaneOperation( MaskDataBlockHandle src1, MaskDataBlockHandle src2, 
+    MaskDataBlockHandle dst ) :
+    src1_( src1->get_mask_data() ),
+    src2_( src2->get_mask_data() ),
+    dst_( dst->get_mask_data() ),
+    src1_bit_( src1->get_mask_bit() ),
+    src2_bit_( src2->get_mask_bit() ),
+    dst_bit_( dst->get_mask_bit() ),
+    slice_size_( dst->get_nx() * dst->get_ny() ),
+    nz_( dst->get_nz() ),
+    size_( dst->get_size() )
+  {
+  }
+
+  // RUN_RANGE:
+  // Process the words [begin, end)
+  void run_range( size_t begin, size_t end )
+  {
+    for ( size_t j = begin * 8; j < end * 8; j += 8 )
+    {
+      boost::uint64_t bits = OPERATION::Apply( ExtractBits( LoadWord( this->src1_ + j ), 
+        this->src1_bit_ ), ExtractBits( LoadWord( this->src2_ + j ), this->src2_bit_ ) );
+      StoreWord( this->dst_ + j, InsertBits( LoadWord( this->dst_ + j ), 
+        bits & LSB_MASK_C, this->dst_bit_ ) );
+    }
+  }
+
+  void run( const MaskDataBlockOperations::progress_type& progress,
+    const MaskDataBlockOperations::check_abort_type& check_abort, bool& aborted )
+  {
+    size_t num_words = this->size_ / 8;
+
+    // Process the volume in slabs of slices, so progress can be reported and the operation
+    // can be aborted in between
+    size_t slab_size = std::max< size_t >( 1, ( this->nz_ + 19 ) / 20 );
+
+    aborted = false;
+    for ( size_t z = 0; z < this->nz_; z += slab_size )
+    {
+      if ( check_abort && check_abort() )
+      {
+        aborted = true;
+        return;
+      }
+
+      size_t z_end = std::min( this->nz_, z + slab_size );
+      size_t word_begin = z * this->slice_size_ / 8;
+      size_t word_end = z_end == this->nz_ ? num_words : z_end * this->slice_size_ / 8;
+      Parallel::For( word_begin, word_end, boost::bind( &BitPlaneOperation::run_range, 
+        this, _1, _2 ), 1 << 16 );
+
+      if ( progress ) progress( static_cast< double >( z_end ) / this->nz_ );
+    }
+
+    // Finish the voxels that do not fill a whole word
+    unsigned char dst_value = static_cast< unsigned char >( 1 << this->dst_bit_ );
+    for ( size_t j = num_words * 8; j < this->size_; j++ )
+    {
+      boost::uint64_t bits = OPERATION::Apply( ( this->src1_[ j ] >> this->src1_bit_ ) & 1,
+        ( this->src2_[ j ] >> this->src2_bit_ ) & 1 );
+      if ( bits & 1 ) this->dst_[ j ] |= dst_value;
+      else this->dst_[ j ] &= ~dst_value;
+    }
+  }
+
+private:
+  const unsigned char* src1_;
+  const unsigned char* src2_;
+  unsigned char* dst_;
+
+  unsigned int src1_bit_;
+  unsigned int src2_bit_;
+  unsigned int dst_bit_;
+
+  size_t slice_size_;
+  size_t nz_;
+  size_t size_;
+};
+
+template< class OPERATION >
+static bool RunBitPlaneOperation( MaskDataBlockHandle src1, MaskDataBlockHandle src2, 
+  MaskDataBlockHandle dst, const MaskDataBlockOperations::progress_type& progress,
+  const MaskDataBlockOperations::check_abort_type& check_abort )
+{
+  if ( !HasSameSize( src1, dst ) || !HasSameSize( src2, dst ) ) return false;
+  if ( dst == src1 || dst == src2 ) return false;
+
+  MaskOperationLock lock( dst, src1, src2 );
+  BitPlaneOperation< OPERATION > operation( src1, src2, dst );
+
+  bool aborted = false;
+  operation.run( progress, check_abort, aborted );
+  dst->increase_generation();
+
+  return !aborted;
+}
+
+bool MaskDataBlockOperations::And( MaskDataBlockHandle src1, MaskDataBlockHandle src2, 
+  MaskDataBlockHandle dst, const progress_type& progress, const check_abort_type& check_abort )
+{
+  return RunBitPlaneOperation< AndOperation >( src1, src2, dst, progress, check_abort );
+}
+
+bool MaskDataBlockOperations::Or( MaskDataBlockHandle src1, MaskDataBlockHandle src2, 
+  MaskDataBlockHandle dst, const progress_type& progress, const check_abort_type& check_abort )
+{
+  return RunBitPlaneOperation< OrOperation >( src1, src2, dst, progress, check_abort );
+}
+
+bool MaskDataBlockOperations::Xor( MaskDataBlockHandle src1, MaskDataBlockHandle src2, 
+  MaskDataBlockHandle dst, const progress_type& progress, const check_abort_type& check_abort )
+{
+  return RunBitPlaneOperation< XorOperation >( src1, src2, dst, progress, check_abort );
+}
+
+bool MaskDataBlockOperations::Remove( MaskDataBlockHandle src1, MaskDataBlockHandle src2, 
+  MaskDataBlockHandle dst, const progress_type& progress, const check_abort_type& check_abort )
+{
+  return RunBitPlaneOperation< RemoveOperation >( src1, src2, dst, progress, check_abort );
+}
+
+bool MaskDataBlockOperations::Invert( MaskDataBlockHandle src, MaskDataBlockHandle dst,
+  const progress_type& progress, const check_abort_type& check_abort )
+{
+  return RunBitPlaneOperation< InvertOperation >( src, src, dst, progress, check_abort );
+}
+
+static void CountRange( const unsigned char* data, unsigned int bit, size_t size,
+  size_t num_chunks, std::vector< size_t >* counts, size_t begin, size_t end )
+{
+  for ( size_t chunk = begin; chunk < end; chunk++ )
+  {
+    size_t start = ( size * chunk / num_chunks ) & ~size_t( 7 );
+    size_t stop = ( chunk + 1 == num_chunks ) ? size : 
+      ( size * ( chunk + 1 ) / num_chunks ) & ~size_t( 7 );
+
+    size_t count = 0;
+    size_t j = start;
+    for ( ; j + 8 <= stop; j += 8 )
+    {
+      // Multiplying by the byte mask sums all bytes into the highest byte
+      count += static_cast< size_t >( ( ExtractBits( LoadWord( data + j ), bit ) * 
+        LSB_MASK_C ) >> 56 );
+    }
+    for ( ; j < stop; j++ )
+    {
+      count += ( data[ j ] >> bit ) & 1;
+    }
+    ( *counts )[ chunk ] = count;
+  }
+}
+
+size_t MaskDataBlockOperations::Count( MaskDataBlockHandle mask )
+{
+  if ( !mask ) return 0;
+
+  // Sparse masks keep track of full bricks, hence do not need to visit every voxel
+  SparseMaskDataHandle sparse_data = mask->get_sparse_data();
+  if ( sparse_data ) return sparse_data->count();
+
+  MaskDataBlock::shared_lock_type lock( mask->get_mutex() );
+
+  size_t size = mask->get_size();
+  size_t num_chunks = std::max< size_t >( 1, std::min< size_t >( 
+    4 * static_cast< size_t >( Parallel::GetNumThreads() ), size >> 16 ) );
+  std::vector< size_t > counts( num_chunks, 0 );
+
+  Parallel::For( 0, num_chunks, boost::bind( &CountRange, mask->get_mask_data(), 
+    mask->get_mask_bit(), size, num_chunks, &counts, _1, _2 ), 1 );
+
+  size_t count = 0;
+  for ( size_t j = 0; j < num_chunks; j++ ) count += counts[ j ];
+  return count;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Morphology
+//////////////////////////////////////////////////////////////////////////
+
+// CLASS MorphologyOperation
+// Dilation (or erosion) with a sphere. Every voxel with the seed value that has a face neighbor
+// with the opposite value is an edge voxel, and the sphere around each edge voxel is stamped 
+// into the destination. For erosion the seed value is background and the stamp removes voxels.
+// The sphere is stored as a list of rows, so a stamp is a number of runs along x.
+// NOTE: The slices are processed in slabs, every slab only writes its own slices, hence slabs
+// can be processed in parallel without two threads touching the same byte.
+
+class MorphologyOperation
+{
+public:
+  typedef MaskDataBlock::index_type index_type;
+
+  struct Row
+  {
+    index_type dy_;
+    index_type dz_;
+    index_type half_width_;
+  };
+
+public:
+  MorphologyOperation( MaskDataBlockHandle src, MaskDataBlockHandle dst, bool dilate, 
+    int radius, bool only2d, SliceType slice_type, MaskDataBlockHandle constraint,
+    bool invert_constraint ) :
+    src_( src->get_mask_data() ),
+    dst_( dst->get_mask_data() ),
+    constraint_( constraint ? constraint->get_mask_data() : 0 ),
+    src_value_( src->get_mask_value() ),
+    dst_value_( dst->get_mask_value() ),
+    constraint_value_( constraint ? constraint->get_mask_value() : 0 ),
+    invert_constraint_( invert_constraint ),
+    dilate_( dilate ),
+    nx_( static_cast< index_type >( src->get_nx() ) ),
+    ny_( static_cast< index_type >( src->get_ny() ) ),
+    nz_( static_cast< index_type >( src->get_nz() ) )
+  {
+    index_type xr = radius;
+    index_type yr = radius;
+    index_type zr = radius;
+
+    this->use_x_ = this->use_y_ = this->use_z_ = true;
+    if ( only2d )
+    {
+      if ( slice_type == SliceType::AXIAL_E ) { zr = 0; this->use_z_ = false; }
+      if ( slice_type == SliceType::CORONAL_E ) { yr = 0; this->use_y_ = false; }
+      if ( slice_type == SliceType::SAGITTAL_E ) { xr = 0; this->use_x_ = false; }
+    }
+    this->zr_ = zr;
+
+    index_type r2 = static_cast< index_type >( radius ) * radius;
+    for ( index_type dz = -zr; dz <= zr; dz++ )
+    {
+      for ( index_type dy = -yr; dy <= yr; dy++ )
+      {
+        index_type remainder = r2 - dy * dy - dz * dz;
+        if ( remainder < 0 ) continue;
+
+        index_type half_width = 0;
+        while ( half_width < xr && ( half_width + 1 ) * ( half_width + 1 ) <= remainder )
+        {
+          half_width++;
+        }
+
+        Row row = { dy, dz, half_width };
+        this->rows_.push_back( row );
+      }
+    }
+  }
+
+  // RUN_SLAB:
+  // Compute the destination slices [z_begin, z_end)
+  void run_slab( size_t z_begin, size_t z_end )
+  {
+    const index_type nxy = this->nx_ * this->ny_;
+    const index_type zb = static_cast< index_type >( z_begin );
+    const index_type ze = static_cast< index_type >( z_end );
+
+    // Copy the source into the destination
+    for ( index_type j = zb * nxy; j < ze * nxy; j++ )
+    {
+      if ( this->src_[ j ] & this->src_value_ ) this->dst_[ j ] |= this->dst_value_;
+      else this->dst_[ j ] &= ~this->dst_value_;
+    }
+
+    // The end of the last run that was stamped for each row of the sphere, so runs are not
+    // stamped twice for consecutive edge voxels
+    std::vector< index_type > stamped( this->rows_.size() );
+
+    for ( index_type z = std::max< index_type >( 0, zb - this->zr_ ); 
+      z < std::min( this->nz_, ze + this->zr_ ); z++ )
+    {
+      for ( index_type y = 0; y < this->ny_; y++ )
+      {
+        std::fill( stamped.begin(), stamped.end(), -1 );
+        index_type index = y * this->nx_ + z * nxy;
+        for ( index_type x = 0; x < this->nx_; x++, index++ )
+        {
+          if ( !this->is_edge( x, y, z, index ) ) continue;
+
+          for ( size_t k = 0; k < this->rows_.size(); k++ )
+          {
+            const Row& row = this->rows_[ k ];
+            index_type tz = z + row.dz_;
+            if ( tz < zb || tz >= ze ) continue;
+            index_type ty = y + row.dy_;
+            if ( ty < 0 || ty >= this->ny_ ) continue;
+
+            index_type tx_begin = std::max( std::max< index_type >( 0, 
+              x - row.half_width_ ), stamped[ k ] + 1 );
+            index_type tx_end = std::min( this->nx_ - 1, x + row.half_width_ );
+            if ( tx_begin > tx_end ) continue;
+            stamped[ k ] = tx_end;
+
+            this->stamp( tx_begin + ty * this->nx_ + tz * nxy, tx_end - tx_begin + 1 );
+          }
+        }
+      }
+    }
+  }
+
+  void run( const MaskDataBlockOperations::progress_type& progress,
+    const MaskDataBlockOperations::check_abort_type& check_abort, bool& aborted )
+  {
+    size_t nz = static_cast< size_t >( this->nz_ );
+    size_t num_threads = static_cast< size_t >( Parallel::GetNumThreads() );
+    
+    // Process the volume in batches of slabs, so progress can be reported and the operation
+    // can be aborted in between
+    size_t batch_size = std::max( ( nz + 19 ) / 20, 2 * num_threads );
+    size_t grain_size = std::max< size_t >( 1, batch_size / num_threads );
+
+    aborted = false;
+    for ( size_t z = 0; z < nz; z += batch_size )
+    {
+      if ( check_abort && check_abort() )
+      {
+        aborted = true;
+        return;
+      }
+
+      Parallel::For( z, std::min( nz, z + batch_size ), boost::bind( 
+        &MorphologyOperation::run_slab, this, _1, _2 ), grain_size );
+
+      if ( progress ) progress( static_cast< double >( std::min( nz, z + batch_size ) ) / nz );
+    }
+  }
+
+private:
+  inline bool has_seed_value( index_type index ) const
+  {
+    return ( ( this->src_[ index ] & this->src_value_ ) != 0 ) == this->dilate_;
+  }
+
+  inline bool is_edge( index_type x, index_type y, index_type z, index_type index ) const
+  {
+    if ( !this->has_seed_value( index ) ) return false;
+
+    const index_type nxy = this->nx_ * this->ny_;
+    if ( this->use_x_ )
+    {
+      if ( x > 0 && !this->has_seed_value( index - 1 ) ) return true;
+      if ( x < this->nx_ - 1 && !this->has_seed_value( index + 1 ) ) return true;
+    }
+    if ( this->use_y_ )
+    {
+      if ( y > 0 && !this->has_seed_value( index - this->nx_ ) ) return true;
+      if ( y < this->ny_ - 1 && !this->has_seed_value( index + this->nx_ ) ) return true;
+    }
+    if ( this->use_z_ )
+    {
+      if ( z > 0 && !this->has_seed_value( index - nxy ) ) return true;
+      if ( z < this->nz_ - 1 && !this->has_seed_value( index + nxy ) ) return true;
+    }
+    return false;
+  }
+
+  // STAMP:
+  // Flip the voxels of the run that have the opposite value and are inside the constraint
+  inline void stamp( index_type index, index_type length )
+  {
+    const unsigned char* src = this->src_ + index;
+    unsigned char* dst = this->dst_ + index;
+    const unsigned char flip_value = this->dilate_ ? this->src_value_ : 0;
+
+    if ( this->constraint_ )
+    {
+      const unsigned char* constraint = this->constraint_ + index;
+      for ( index_type j = 0; j < length; j++ )
+      {
+        if ( ( src[ j ] & this->src_value_ ) == flip_value ) continue;
+        if ( ( ( constraint[ j ] & this->constraint_value_ ) != 0 ) == 
+          this->invert_constraint_ ) continue;
+        if ( this->dilate_ ) dst[ j ] |= this->dst_value_;
+        else dst[ j ] &= ~this->dst_value_;
+      }
+    }
+    else
+    {
+      for ( index_type j = 0; j < length; j++ )
+      {
+        if ( ( src[ j ] & this->src_value_ ) == flip_value ) continue;
+        if ( this->dilate_ ) dst[ j ] |= this->dst_value_;
+        else dst[ j ] &= ~this->dst_value_;
+      }
+    }
+  }
+
+private:
+  const unsigned char* src_;
+  unsigned char* dst_;
+  const unsigned char* constraint_;
+
+  unsigned char src_value_;
+  unsigned char dst_value_;
+  unsigned char constraint_value_;
+  bool invert_constraint_;
+
+  bool dilate_;
+
+  index_type nx_;
+  index_type ny_;
+  index_type nz_;
+  index_type zr_;
+
+  bool use_x_;
+  bool use_y_;
+  bool use_z_;
+
+  std::vector< Row > rows_;
+};
+
+static bool RunMorphologyOperation( MaskDataBlockHandle src, MaskDataBlockHandle dst, 
+  bool dilate, int radius, bool only2d, SliceType slice_type, MaskDataBlockHandle constraint, 
+  bool invert_constraint, const MaskDataBlockOperations::progress_type& progress,
+  const MaskDataBlockOperations::check_abort_type& check_abort )
+{
+  if ( !HasSameSize( src, dst ) || src == dst || radius < 0 ) return false;
+  if ( constraint && !HasSameSize( constraint, dst ) ) return false;
+
+  MaskOperationLock lock( dst, src, constraint );
+  MorphologyOperation operation( src, dst, dilate, radius, only2d, slice_type, 
+    constraint, invert_constraint );
+
+  bool aborted = false;
+  operation.run( progress, check_abort, aborted );
+  dst->increase_generation();
+  
+  return !aborted;
+}
+
+bool MaskDataBlockOperations::Dilate( MaskDataBlockHandle src, MaskDataBlockHandle dst, 
+  int radius, bool only2d, SliceType slice_type, MaskDataBlockHandle constraint, 
+  bool invert_constraint, const progress_type& progress, const check_abort_type& check_abort )
+{
+  return RunMorphologyOperation( src, dst, true, radius, only2d, slice_type, constraint,
+    invert_constraint, progress, check_abort );
+}
+
+bool MaskDataBlockOperations::Erode( MaskDataBlockHandle src, MaskDataBlockHandle dst, 
+  int radius, bool only2d, SliceType slice_type, MaskDataBlockHandle constraint, 
+  bool invert_constraint, const progress_type& progress, const check_abort_type& check_abort )
+{
+  return RunMorphologyOperation( src, dst, false, radius, only2d, slice_type, constraint,
+    invert_constraint, progress, check_abort );
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Connectivity
+//////////////////////////////////////////////////////////////////////////
+
+// CLASS FloodFillOperation
+// Scan line flood fill that marks the filled voxels in the destination bitplane. The 
+// destination doubles as the visited flag, hence no memory is needed apart from the stack of
+// runs that still need to be visited.
+
+class FloodFillOperation
+{
+public:
+  FloodFillOperation( MaskDataBlockHandle src, bool value, MaskDataBlockHandle dst ) :
+    src_( src->get_mask_data() ),
+    dst_( dst->get_mask_data() ),
+    src_value_( src->get_mask_value() ),
+    dst_value_( dst->get_mask_value() ),
+    value_( value ),
+    nx_( src->get_nx() ),
+    ny_( src->get_ny() ),
+    nz_( src->get_nz() )
+  {
+  }
+
+  inline bool is_fillable( size_t index ) const
+  {
+    return ( ( ( this->src_[ index ] & this->src_value_ ) != 0 ) == this->value_ ) &&
+      !( this->dst_[ index ] & this->dst_value_ );
+  }
+
+  // FILL:
+  // Fill the region connected to the seed, returns false if aborted
+  bool fill( size_t seed, const MaskDataBlockOperations::check_abort_type& check_abort )
+  {
+    if ( !this->is_fillable( seed ) ) return true;
+
+    const size_t nxy = this->nx_ * this->ny_;
+    size_t abort_count = 0;
+
+    this->stack_.push_back( seed );
+    while ( !this->stack_.empty() )
+    {
+      size_t index = this->stack_.back();
+      this->stack_.pop_back();
+      if ( !this->is_fillable( index ) ) continue;
+
+      if ( ++abort_count == 0x10000 )
+      {
+        abort_count = 0;
+        if ( check_abort && check_abort() )
+        {
+          this->stack_.clear();
+          return false;
+        }
+      }
+
+      size_t x = index % this->nx_;
+      size_t y = ( index / this->nx_ ) % this->ny_;
+      size_t z = index / nxy;
+      
+      // Extend the run along x in both directions
+      size_t row = index - x;
+      size_t x_begin = x;
+      while ( x_begin > 0 && this->is_fillable( row + x_begin - 1 ) ) x_begin--;
+      size_t x_end = x + 1;
+      while ( x_end < this->nx_ && this->is_fillable( row + x_end ) ) x_end++;
+
+      for ( size_t j = row + x_begin; j < row + x_end; j++ )
+      {
+        this->dst_[ j ] |= this->dst_value_;
+      }
+
+      // Queue one seed for each run in the neighboring rows
+      if ( y > 0 ) this->push_runs( row - this->nx_, x_begin, x_end );
+      if ( y + 1 < this->ny_ ) this->push_runs( row + this->nx_, x_begin, x_end );
+      if ( z > 0 ) this->push_runs( row - nxy, x_begin, x_end );
+      if ( z + 1 < this->nz_ ) this->push_runs( row + nxy, x_begin, x_end );
+    }
+
+    return true;
+  }
+
+private:
+  inline void push_runs( size_t row, size_t x_begin, size_t x_end )
+  {
+    bool in_run = false;
+    for ( size_t x = x_begin; x < x_end; x++ )
+    {
+      bool fillable = this->is_fillable( row + x );
+      if ( fillable && !in_run ) this->stack_.push_back( row + x );
+      in_run = fillable;
+    }
+  }
+
+private:
+  const unsigned char* src_;
+  unsigned char* dst_;
+
+  unsigned char src_value_;
+  unsigned char dst_value_;
+  bool value_;
+
+  size_t nx_;
+  size_t ny_;
+  size_t nz_;
+
+  std::vector< size_t > stack_;
+};
+
+static bool RunFloodFill( MaskDataBlockHandle src, bool value, 
+  const MaskDataBlockOperations::seed_list_type& seeds, MaskDataBlockHandle dst, 
+  MaskDataBlockHandle seed_mask, bool invert_seed_mask, 
+  const MaskDataBlockOperations::check_abort_type& check_abort )
+{
+  FloodFillOperation operation( src, value, dst );
+
+  // Clear the destination, it is used to track which voxels were visited
+  unsigned char* dst_data = dst->get_mask_data();
+  unsigned char not_dst_value = ~dst->get_mask_value();
+  size_t size = dst->get_size();
+  for ( size_t j = 0; j < size; j++ ) dst_data[ j ] &= not_dst_value;
+
+  for ( size_t j = 0; j < seeds.size(); j++ )
+  {
+    if ( seeds[ j ] < 0 || static_cast< size_t >( seeds[ j ] ) >= size ) continue;
+    if ( !operation.fill( static_cast< size_t >( seeds[ j ] ), check_abort ) ) return false;
+  }
+
+  if ( seed_mask )
+  {
+    const unsigned char* seed_data = seed_mask->get_mask_data();
+    unsigned char seed_value = seed_mask->get_mask_value();
+    for ( size_t j = 0; j < size; j++ )
+    {
+      if ( ( ( seed_data[ j ] & seed_value ) != 0 ) == invert_seed_mask ) continue;
+      if ( !operation.is_fillable( j ) ) continue;
+      if ( !operation.fill( j, check_abort ) ) return false;
+    }
+  }
+
+  return true;
+}
+
+bool MaskDataBlockOperations::FloodFill( MaskDataBlockHandle src, bool value, 
+  const seed_list_type& seeds, MaskDataBlockHandle dst, MaskDataBlockHandle seed_mask, 
+  bool invert_seed_mask, const check_abort_type& check_abort )
+{
+  if ( !HasSameSize( src, dst ) || src == dst ) return false;
+  if ( seed_mask && !HasSameSize( seed_mask, dst ) ) return false;
+
+  MaskOperationLock lock( dst, src, seed_mask );
+  bool success = RunFloodFill( src, value, seeds, dst, seed_mask, invert_seed_mask, 
+    check_abort );
+  dst->increase_generation();
+
+  return success;
+}
+
+bool MaskDataBlockOperations::FillHoles( MaskDataBlockHandle src, const seed_list_type& seeds, 
+  MaskDataBlockHandle dst, const check_abort_type& check_abort )
+{
+  if ( !HasSameSize( src, dst ) || src == dst ) return false;
+
+  // Anything that is connected to one of the corners is not a hole
+  seed_list_type background_seeds = seeds;
+  size_t nx = src->get_nx();
+  size_t ny = src->get_ny();
+  size_t nz = src->get_nz();
+  for ( size_t k = 0; k < 8; k++ )
+  {
+    background_seeds.push_back( static_cast< MaskDataBlock::index_type >( src->to_index( 
+      ( k & 1 ) ? nx - 1 : 0, ( k & 2 ) ? ny - 1 : 0, ( k & 4 ) ? nz - 1 : 0 ) ) );
+  }
+
+  MaskOperationLock lock( dst, src );
+  if ( !RunFloodFill( src, false, background_seeds, dst, MaskDataBlockHandle(), false, 
+    check_abort ) )
+  {
+    dst->increase_generation();
+    return false;
+  }
+
+  // Everything that was not reached from the outside is part of the filled mask
+  BitPlaneOperation< InvertOperation > operation( dst, dst, dst );
+  bool aborted = false;
+  operation.run( progress_type(), check_abort, aborted );
+  dst->increase_generation();
+
+  return !aborted;
+}
+
+} // end namespace Core
@@ -0,0 +1,151 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef CORE_DATABLOCK_MASKDATABLOCKOPERATIONS_H
+#define CORE_DATABLOCK_MASKDATABLOCKOPERATIONS_H
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1020)
+# pragma once
+#endif 
+
+// STL includes
+#include <vector>
+
+// Boost includes
+#include <boost/utility.hpp>
+#include <boost/function.hpp>
+
+// Core includes
+#include <Core/DataBlock/MaskDataBlock.h>
+#include <Core/DataBlock/SliceType.h>
+
+namespace Core
+{
+
+// CLASS MaskDataBlockOperations
+/// Kernels that work directly on the bitplane of a MaskDataBlock, so that mask filters do not
+/// need to expand a mask into a full DataBlock or ITK image and convert it back afterwards.
+/// The source masks are read locked and the destination mask is write locked by these
+/// functions, taking into account that the masks may share the same DataBlock. The
+/// destination needs to have the same dimensions as the sources and may not be one of them.
+/// NOTE: The logical operations and the voxel count process eight voxels per 64-bit word, the
+/// morphological operations are split into slabs of slices that are processed in parallel.
+class MaskDataBlockOperations : public boost::noncopyable
+{
+  // -- typedefs --
+public:
+  typedef boost::function< bool () > check_abort_type;
+  typedef boost::function< void ( double ) > progress_type;
+  typedef std::vector< MaskDataBlock::index_type > seed_list_type;
+
+  // -- logical operations --
+public:
+  // NOTE: The logical operations return false if the masks do not have the same size, if the
+  // destination is one of the sources, or if the operation was aborted. Progress is reported 
+  // and abort is checked once per slab of slices.
+
+  // AND:
+  /// dst = src1 AND src2
+  static bool And( MaskDataBlockHandle src1, MaskDataBlockHandle src2, 
+    MaskDataBlockHandle dst, const progress_type& progress = progress_type(), 
+    const check_abort_type& check_abort = check_abort_type() );
+
+  // OR:
+  /// dst = src1 OR src2
+  static bool Or( MaskDataBlockHandle src1, MaskDataBlockHandle src2, 
+    MaskDataBlockHandle dst, const progress_type& progress = progress_type(), 
+    const check_abort_type& check_abort = check_abort_type() );
+
+  // XOR:
+  /// dst = src1 XOR src2
+  static bool Xor( MaskDataBlockHandle src1, MaskDataBlockHandle src2, 
+    MaskDataBlockHandle dst, const progress_type& progress = progress_type(), 
+    const check_abort_type& check_abort = check_abort_type() );
+
+  // REMOVE:
+  /// dst = src1 AND NOT src2
+  static bool Remove( MaskDataBlockHandle src1, MaskDataBlockHandle src2, 
+    MaskDataBlockHandle dst, const progress_type& progress = progress_type(), 
+    const check_abort_type& check_abort = check_abort_type() );
+
+  // INVERT:
+  /// dst = NOT src
+  static bool Invert( MaskDataBlockHandle src, MaskDataBlockHandle dst,
+    const progress_type& progress = progress_type(), 
+    const check_abort_type& check_abort = check_abort_type() );
+
+  // COUNT:
+  /// Count the number of voxels that are set in the mask
+  static size_t Count( MaskDataBlockHandle mask );
+
+  // -- morphology --
+public:
+  // DILATE:
+  /// Dilate src with a sphere of the given radius and store the result in dst. If only2d is
+  /// set the sphere is replaced by a disk in the plane of slice_type. If a constraint mask is
+  /// given, only voxels inside it (or outside it if invert_constraint is set) are added.
+  /// Returns false if the operation was aborted.
+  static bool Dilate( MaskDataBlockHandle src, MaskDataBlockHandle dst, int radius, 
+    bool only2d = false, SliceType slice_type = SliceType::AXIAL_E,
+    MaskDataBlockHandle constraint = MaskDataBlockHandle(), bool invert_constraint = false,
+    const progress_type& progress = progress_type(), 
+    const check_abort_type& check_abort = check_abort_type() );
+
+  // ERODE:
+  /// Erode src with a sphere of the given radius and store the result in dst. If a constraint
+  /// mask is given, only voxels inside it (or outside it if invert_constraint is set) are 
+  /// removed. Returns false if the operation was aborted.
+  static bool Erode( MaskDataBlockHandle src, MaskDataBlockHandle dst, int radius, 
+    bool only2d = false, SliceType slice_type = SliceType::AXIAL_E,
+    MaskDataBlockHandle constraint = MaskDataBlockHandle(), bool invert_constraint = false,
+    const progress_type& progress = progress_type(), 
+    const check_abort_type& check_abort = check_abort_type() );
+
+  // -- connectivity --
+public:
+  // FLOODFILL:
+  /// Set all voxels in dst that are face connected to a seed through voxels that have the
+  /// given value in src. Seeds are voxel indices, seeds that do not have the value in src are
+  /// ignored. If a seed mask is given, every voxel with the value in src that is inside the 
+  /// seed mask (or outside it if invert_seed_mask is set) is used as an additional seed.
+  /// Returns false if the operation was aborted.
+  static bool FloodFill( MaskDataBlockHandle src, bool value, const seed_list_type& seeds,
+    MaskDataBlockHandle dst, MaskDataBlockHandle seed_mask = MaskDataBlockHandle(), 
+    bool invert_seed_mask = false, const check_abort_type& check_abort = check_abort_type() );
+
+  // FILLHOLES:
+  /// Fill all the background regions of src that are not face connected to one of the
+  /// corners of the volume or to one of the seeds and store the result in dst.
+  /// Returns false if the operation was aborted.
+  static bool FillHoles( MaskDataBlockHandle src, const seed_list_type& seeds, 
+    MaskDataBlockHandle dst, const check_abort_type& check_abort = check_abort_type() );
+};
+
+} // end namespace Core
+
+#endif
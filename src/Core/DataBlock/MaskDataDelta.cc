@@ -0,0 +1,204 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+// STL includes
+#include <algorithm>
+
+// Core includes
+#include <Core/DataBlock/MaskDataBlock.h>
+#include <Core/DataBlock/MaskDataDelta.h>
+
+namespace Core
+{
+
+MaskDataDelta::MaskDataDelta() :
+  nx_( 0 ),
+  ny_( 0 ),
+  nz_( 0 ),
+  num_changed_( 0 )
+{
+  for ( size_t j = 0; j < 3; j++ )
+  {
+    this->min_[ j ] = 1;
+    this->max_[ j ] = 0;
+  }
+}
+
+MaskDataDelta::~MaskDataDelta()
+{
+}
+
+MaskDataDeltaHandle MaskDataDelta::Create( const MaskDataSliceHandle& old_slice, 
+  const MaskDataBlockHandle& mask )
+{
+  MaskDataBlockHandle old_mask = old_slice->get_mask_data_block();
+
+  // Find where the slice is located in the mask
+  size_t offset[ 3 ] = { 0, 0, 0 };
+  size_t axis;
+  switch ( old_slice->get_slice_type() )
+  {
+    case SliceType::SAGITTAL_E: axis = 0; break;
+    case SliceType::CORONAL_E: axis = 1; break;
+    case SliceType::AXIAL_E: axis = 2; break;
+    default: return MaskDataDeltaHandle();
+  }
+  if ( old_slice->get_index() < 0 ) return MaskDataDeltaHandle();
+  offset[ axis ] = static_cast< size_t >( old_slice->get_index() );
+
+  size_t nx = old_mask->get_nx();
+  size_t ny = old_mask->get_ny();
+  size_t nz = old_mask->get_nz();
+  if ( offset[ 0 ] + nx > mask->get_nx() || offset[ 1 ] + ny > mask->get_ny() ||
+    offset[ 2 ] + nz > mask->get_nz() )
+  {
+    return MaskDataDeltaHandle();
+  }
+
+  // Copy the old bits first, the slice may share its mutex with the mask
+  std::vector< unsigned char > changed( old_mask->get_size() );
+  {
+    MaskDataBlock::shared_lock_type lock( old_mask->get_mutex() );
+    for ( size_t k = 0; k < changed.size(); k++ ) changed[ k ] = old_mask->get_mask_at( k );
+  }
+
+  MaskDataDeltaHandle delta( new MaskDataDelta );
+  delta->nx_ = mask->get_nx();
+  delta->ny_ = mask->get_ny();
+  delta->nz_ = mask->get_nz();
+
+  size_t min[ 3 ] = { nx, ny, nz };
+  size_t max[ 3 ] = { 0, 0, 0 };
+  {
+    MaskDataBlock::shared_lock_type lock( mask->get_mutex() );
+    size_t k = 0;
+    for ( size_t z = 0; z < nz; z++ )
+    {
+      for ( size_t y = 0; y < ny; y++ )
+      {
+        for ( size_t x = 0; x < nx; x++, k++ )
+        {
+          bool new_value = mask->get_mask_at( x + offset[ 0 ], y + offset[ 1 ], z + offset[ 2 ] );
+          changed[ k ] = ( changed[ k ] != 0 ) != new_value;
+          if ( !changed[ k ] ) continue;
+
+          delta->num_changed_++;
+          min[ 0 ] = std::min( min[ 0 ], x ); max[ 0 ] = std::max( max[ 0 ], x );
+          min[ 1 ] = std::min( min[ 1 ], y ); max[ 1 ] = std::max( max[ 1 ], y );
+          min[ 2 ] = std::min( min[ 2 ], z ); max[ 2 ] = std::max( max[ 2 ], z );
+        }
+      }
+    }
+  }
+
+  if ( delta->num_changed_ == 0 ) return delta;
+
+  // Pack the changes inside the bounding box
+  size_t w = max[ 0 ] - min[ 0 ] + 1;
+  size_t h = max[ 1 ] - min[ 1 ] + 1;
+  size_t d = max[ 2 ] - min[ 2 ] + 1;
+  delta->bits_.resize( ( w * h * d + 7 ) / 8, 0 );
+  size_t bit = 0;
+  for ( size_t z = min[ 2 ]; z <= max[ 2 ]; z++ )
+  {
+    for ( size_t y = min[ 1 ]; y <= max[ 1 ]; y++ )
+    {
+      const unsigned char* row = &changed[ min[ 0 ] + nx * ( y + ny * z ) ];
+      for ( size_t x = 0; x < w; x++, bit++ )
+      {
+        if ( row[ x ] ) delta->bits_[ bit >> 3 ] |= 1 << ( bit & 7 );
+      }
+    }
+  }
+
+  for ( size_t j = 0; j < 3; j++ )
+  {
+    delta->min_[ j ] = min[ j ] + offset[ j ];
+    delta->max_[ j ] = max[ j ] + offset[ j ];
+  }
+
+  return delta;
+}
+
+bool MaskDataDelta::apply( const MaskDataBlockHandle& mask ) const
+{
+  if ( mask->get_nx() != this->nx_ || mask->get_ny() != this->ny_ || 
+    mask->get_nz() != this->nz_ )
+  {
+    return false;
+  }
+
+  if ( this->num_changed_ == 0 ) return true;
+
+  size_t w = this->max_[ 0 ] - this->min_[ 0 ] + 1;
+  size_t h = this->max_[ 1 ] - this->min_[ 1 ] + 1;
+
+  MaskDataBlock::lock_type lock( mask->get_mutex() );
+  unsigned char* data = mask->get_mask_data();
+  unsigned char mask_value = mask->get_mask_value();
+
+  for ( size_t b = 0; b < this->bits_.size(); b++ )
+  {
+    // Most of the bounding box is usually unchanged
+    if ( this->bits_[ b ] == 0 ) continue;
+
+    for ( size_t t = 0; t < 8; t++ )
+    {
+      if ( ( this->bits_[ b ] & ( 1 << t ) ) == 0 ) continue;
+      size_t k = b * 8 + t;
+      size_t x = k % w;
+      size_t y = ( k / w ) % h;
+      size_t z = k / ( w * h );
+      data[ mask->to_index( x + this->min_[ 0 ], y + this->min_[ 1 ], z + this->min_[ 2 ] ) ] ^= 
+        mask_value;
+    }
+  }
+
+  mask->increase_generation( 
+    IndexVector( this->min_[ 0 ], this->min_[ 1 ], this->min_[ 2 ] ),
+    IndexVector( this->max_[ 0 ], this->max_[ 1 ], this->max_[ 2 ] ) );
+
+  return true;
+}
+
+bool MaskDataDelta::is_empty() const
+{
+  return this->num_changed_ == 0;
+}
+
+size_t MaskDataDelta::get_num_changed() const
+{
+  return this->num_changed_;
+}
+
+size_t MaskDataDelta::get_byte_size() const
+{
+  return sizeof( MaskDataDelta ) + this->bits_.size();
+}
+
+} // end namespace Core
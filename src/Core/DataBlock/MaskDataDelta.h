@@ -0,0 +1,115 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef CORE_DATABLOCK_MASKDATADELTA_H
+#define CORE_DATABLOCK_MASKDATADELTA_H
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1020)
+# pragma once
+#endif 
+
+// STL includes
+#include <vector>
+
+// Boost includes
+#include <boost/utility.hpp>
+#include <boost/smart_ptr.hpp>
+
+// Core includes
+#include <Core/DataBlock/MaskDataBlockFWD.h>
+#include <Core/DataBlock/MaskDataSlice.h>
+
+namespace Core
+{
+
+// Forward Declaration
+class MaskDataDelta;
+typedef boost::shared_ptr< MaskDataDelta > MaskDataDeltaHandle;
+
+// CLASS MASKDATADELTA:
+/// Sparse record of a change to a mask. Only the bounding box of the voxels that changed is 
+/// stored, with one bit per voxel that is set if the voxel changed (the XOR of the old and the
+/// new mask). Applying the delta flips those voxels, hence the same delta reverts the change
+/// and makes it again.
+
+class MaskDataDelta : public boost::noncopyable
+{
+  // -- constructor/destructor --
+private:
+  MaskDataDelta();
+
+public:
+  ~MaskDataDelta();
+
+  // -- creation --
+public:
+  // CREATE:
+  /// Create the delta between a slice that was extracted from a mask before it was changed and
+  /// the current contents of the mask. Returns an empty handle if the slice does not fit.
+  static MaskDataDeltaHandle Create( const MaskDataSliceHandle& old_slice, 
+    const MaskDataBlockHandle& mask );
+
+  // -- applying the delta --
+public:
+  // APPLY:
+  /// Flip the voxels that changed. Returns false if the mask has different dimensions.
+  bool apply( const MaskDataBlockHandle& mask ) const;
+
+  // -- information --
+public:
+  // IS_EMPTY:
+  /// Whether no voxel changed
+  bool is_empty() const;
+
+  // GET_NUM_CHANGED:
+  /// Number of voxels that changed
+  size_t get_num_changed() const;
+
+  // GET_BYTE_SIZE:
+  /// Get the number of bytes used by the delta
+  size_t get_byte_size() const;
+
+  // -- internals --
+private:
+  // Dimensions of the mask
+  size_t nx_;
+  size_t ny_;
+  size_t nz_;
+
+  // Bounding box of the changed voxels, min is larger than max if nothing changed
+  size_t min_[ 3 ];
+  size_t max_[ 3 ];
+
+  // One bit per voxel in the bounding box, x changes fastest
+  std::vector< unsigned char > bits_;
+  size_t num_changed_;
+};
+
+} // end namespace Core
+
+#endif
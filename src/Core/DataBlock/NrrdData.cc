@@ -26,8 +26,18 @@
  DEALINGS IN THE SOFTWARE.
  */
  
+// STL includes
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+// zlib includes
+#include <zlib.h>
+
 // Core includes
 #include <Core/Utils/Log.h>
+#include <Core/Utils/Parallel.h>
 #include <Core/Utils/StringUtil.h>
 #include <Core/Utils/Exception.h>
 #include <Core/Math/MathFunctions.h>
@@ -35,6 +45,7 @@
 #include <Core/DataBlock/NrrdData.h>
 
 // Boost includes
+#include <boost/bind.hpp>
 #include <boost/filesystem.hpp>
 
 namespace Core
@@ -75,7 +86,8 @@ NrrdData::NrrdData( DataBlockHandle data_block ) :
 
   if ( this->private_->nrrd_ )
   {
-    nrrdWrap_va( this->private_->nrrd_, data_block->get_data(), 
+    // NOTE: The nrrd only reads the data, hence data shared with a duplicate is not copied
+    nrrdWrap_va( this->private_->nrrd_, const_cast< void* >( data_block->get_const_data() ), 
       GetNrrdDataType( data_block->get_data_type() ), 3,
       data_block->get_nx(), data_block->get_ny(),
       data_block->get_nz() );
@@ -97,7 +109,8 @@ NrrdData::NrrdData( DataBlockHandle data_block, GridTransform transform, bool no
 
   if ( this->private_->nrrd_ )
   {
-    nrrdWrap_va( this->private_->nrrd_, data_block->get_data(), 
+    // NOTE: The nrrd only reads the data, hence data shared with a duplicate is not copied
+    nrrdWrap_va( this->private_->nrrd_, const_cast< void* >( data_block->get_const_data() ), 
       GetNrrdDataType( data_block->get_data_type() ), 3,
       data_block->get_nx(), data_block->get_ny(),
       data_block->get_nz() );
@@ -393,22 +406,22 @@ void NrrdData::set_histogram( const Histogram& histogram )
   }
 }
 
+bool NrrdData::get_stored_histogram( Histogram& histogram ) const
+{
+  if ( !this->private_->nrrd_ ) return false;
+
+  char* value = nrrdKeyValueGet( this->private_->nrrd_, "seg3d-histogram" );
+  if ( !value ) return false;
+
+  bool success = ImportFromString( value, histogram );
+  free( value );
+  return success;
+}
+
 Histogram NrrdData::get_histogram( bool trust_meta_data )
 {
   Histogram result;
-  if ( trust_meta_data )
-  {
-    char* value = nrrdKeyValueGet( this->private_->nrrd_, "seg3d-histogram" );
-    if ( value )
-    {
-    if ( ImportFromString( value, result ) )
-    {
-      free( value );
-      return result;
-    }
-    free ( value );
-    }
-  }
+  if ( trust_meta_data && this->get_stored_histogram( result ) ) return result;
   
   switch ( this->get_data_type() )
   {
@@ -502,7 +515,8 @@ bool NrrdData::get_originally_node_centered() const
 }
 
 
-bool NrrdData::LoadNrrd( const std::string& filename, NrrdDataHandle& nrrddata, std::string& error )
+bool NrrdData::LoadNrrd( const std::string& filename, NrrdDataHandle& nrrddata, std::string& error,
+  bool read_data )
 {
   // Lock down the Teem library
   lock_type lock( GetMutex() );
@@ -525,7 +539,13 @@ bool NrrdData::LoadNrrd( const std::string& filename, NrrdDataHandle& nrrddata,
         return false;
     }
 
-  if ( nrrdLoad( nrrd, filename_only.c_str(), 0 ) )
+  NrrdIoState* nio = nrrdIoStateNew();
+  if ( !read_data ) nrrdIoStateSet( nio, nrrdIoStateSkipData, AIR_TRUE );
+
+  int load_error = nrrdLoad( nrrd, filename_only.c_str(), nio );
+  nio = nrrdIoStateNix( nio );
+
+  if ( load_error )
   {
     char *err = biffGet( NRRD );
     error = std::string( "Could not open file: " ) + filename + " : " + std::string( err );
@@ -624,52 +644,335 @@ bool NrrdData::LoadNrrd( const std::string& filename, NrrdDataHandle& nrrddata,
   return true;
 }
 
+// Size of the blocks that are deflated in parallel
+static const size_t GZIP_BLOCK_SIZE_C = 1 << 20;
+
+// Number of compressed blocks that are kept in memory before they are written
+static const size_t GZIP_BATCH_SIZE_C = 64;
+
+// Size of the deflate window, each block is primed with the data preceding it
+static const size_t GZIP_WINDOW_SIZE_C = 32768;
+
+// CLASS DEFLATEKERNEL:
+// Deflates blocks of data independently. Every block but the last one ends with a sync flush,
+// which aligns it to a byte boundary, hence the blocks concatenate into a single deflate stream
+// that any gzip reader can inflate.
+class DeflateKernel
+{
+public:
+  DeflateKernel( const unsigned char* data, size_t size, int level ) :
+    data_( data ),
+    size_( size ),
+    level_( level ),
+    first_block_( 0 )
+  {
+  }
+
+  void set_batch( size_t first_block, size_t num_blocks )
+  {
+    this->first_block_ = first_block;
+    this->buffers_.resize( num_blocks );
+    this->crcs_.resize( num_blocks );
+    this->success_.assign( num_blocks, 0 );
+  }
+
+  size_t get_block_size( size_t block ) const
+  {
+    return std::min( GZIP_BLOCK_SIZE_C, this->size_ - block * GZIP_BLOCK_SIZE_C );
+  }
+
+  void process( size_t begin, size_t end )
+  {
+    for ( size_t j = begin; j < end; j++ )
+    {
+      size_t block = this->first_block_ + j;
+      size_t start = block * GZIP_BLOCK_SIZE_C;
+      size_t length = this->get_block_size( block );
+      bool last = start + length == this->size_;
+
+      this->crcs_[ j ] = crc32( crc32( 0L, Z_NULL, 0 ), this->data_ + start, 
+        static_cast< uInt >( length ) );
+
+      z_stream stream;
+      std::memset( &stream, 0, sizeof( stream ) );
+      if ( deflateInit2( &stream, this->level_, Z_DEFLATED, -15, 8, 
+        Z_DEFAULT_STRATEGY ) != Z_OK )
+      {
+        continue;
+      }
+
+      if ( start > 0 )
+      {
+        size_t window = std::min( start, GZIP_WINDOW_SIZE_C );
+        deflateSetDictionary( &stream, this->data_ + start - window, 
+          static_cast< uInt >( window ) );
+      }
+
+      std::vector< unsigned char >& buffer = this->buffers_[ j ];
+      buffer.resize( deflateBound( &stream, static_cast< uLong >( length ) ) + 16 );
+      stream.next_in = const_cast< Bytef* >( this->data_ + start );
+      stream.avail_in = static_cast< uInt >( length );
+
+      size_t written = 0;
+      while ( true )
+      {
+        stream.next_out = &buffer[ written ];
+        stream.avail_out = static_cast< uInt >( buffer.size() - written );
+        int result = deflate( &stream, last ? Z_FINISH : Z_SYNC_FLUSH );
+        written = buffer.size() - stream.avail_out;
+        if ( result == Z_STREAM_ERROR ) break;
+        if ( last ? result == Z_STREAM_END : ( stream.avail_in == 0 && stream.avail_out > 0 ) )
+        {
+          this->success_[ j ] = 1;
+          break;
+        }
+        buffer.resize( buffer.size() * 2 );
+      }
+
+      buffer.resize( written );
+      deflateEnd( &stream );
+    }
+  }
+
+  const unsigned char* data_;
+  size_t size_;
+  int level_;
+
+  size_t first_block_;
+  std::vector< std::vector< unsigned char > > buffers_;
+  std::vector< uLong > crcs_;
+  std::vector< unsigned char > success_;
+};
+
+static void WriteLittleEndian32( std::ostream& file, uLong value )
+{
+  for ( int j = 0; j < 4; j++ )
+  {
+    file.put( static_cast< char >( ( value >> ( 8 * j ) ) & 0xff ) );
+  }
+}
+
+// WRITEGZIPDATA:
+// Write the data as a single gzip member. The data is compressed in parallel in batches of
+// blocks, hence only a batch of compressed data is kept in memory.
+static bool WriteGzipData( std::ostream& file, const unsigned char* data, size_t size, 
+  int level, std::string& error )
+{
+  // Header: magic number, deflate, no flags, no time stamp, unknown operating system
+  static const char header[ 10 ] = { '\x1f', '\x8b', 8, 0, 0, 0, 0, 0, 0, '\xff' };
+  file.write( header, sizeof( header ) );
+
+  DeflateKernel kernel( data, size, level );
+  size_t num_blocks = std::max< size_t >( 1, ( size + GZIP_BLOCK_SIZE_C - 1 ) / 
+    GZIP_BLOCK_SIZE_C );
+  uLong crc = crc32( 0L, Z_NULL, 0 );
+
+  for ( size_t first_block = 0; first_block < num_blocks; first_block += GZIP_BATCH_SIZE_C )
+  {
+    size_t batch_size = std::min( GZIP_BATCH_SIZE_C, num_blocks - first_block );
+    kernel.set_batch( first_block, batch_size );
+    Parallel::For( 0, batch_size, boost::bind( &DeflateKernel::process, &kernel, _1, _2 ), 1 );
+
+    for ( size_t j = 0; j < batch_size; j++ )
+    {
+      if ( !kernel.success_[ j ] )
+      {
+        error = "Could not compress the data.";
+        return false;
+      }
+      
+      if ( !kernel.buffers_[ j ].empty() )
+      {
+        file.write( reinterpret_cast< const char* >( &kernel.buffers_[ j ][ 0 ] ), 
+          kernel.buffers_[ j ].size() );
+      }
+      crc = crc32_combine( crc, kernel.crcs_[ j ], 
+        static_cast< z_off_t >( kernel.get_block_size( first_block + j ) ) );
+    }
+  }
+
+  // Trailer: checksum and size modulo 2^32
+  WriteLittleEndian32( file, crc );
+  WriteLittleEndian32( file, static_cast< uLong >( size & 0xffffffff ) );
+
+  return true;
+}
+
 bool NrrdData::SaveNrrd( const std::string& filename,
                          NrrdDataHandle nrrddata,
                          std::string& error,
                          bool compress,
                          int level )
 {
-  // Lock down the Teem library
-  lock_type lock( GetMutex() );
+  const unsigned char* data = 0;
+  size_t size = 0;
+
+  // Teem only writes the header, the data is written without holding the lock so files can
+  // be saved concurrently and compressed on all cores
+  {
+    // Lock down the Teem library
+    lock_type lock( GetMutex() );
+
+    if ( ! nrrddata.get() )
+    {
+      error = "Error writing file: " + filename + " : no data volume available";
+      return false;
+    }
+
+    NrrdIoState* nio = nrrdIoStateNew();
+
+    // Turn on compression if the user wants it.
+    if ( compress )
+    { 
+      nrrdIoStateEncodingSet( nio, nrrdEncodingGzip );
+      nrrdIoStateSet( nio,  nrrdIoStateZlibLevel, level );
+    }
+    else
+    {
+      // guarantees consistent compression settings
+      nrrdIoStateEncodingSet( nio, nrrdEncodingRaw );
+      nrrdIoStateSet( nio,  nrrdIoStateZlibLevel, 0 );
+    }
+    nrrdIoStateSet( nio, nrrdIoStateSkipData, AIR_TRUE );
+
+    // teem library should check for valid nrrd (including file extension?)
+    if ( nrrdSave( filename.c_str(), nrrddata->nrrd(), nio ) )
+    {
+      char *err = biffGet( NRRD );
+      error = "Error writing file: " + filename + " : " + std::string( err );
+      free( err );
+      biffDone( NRRD );
+      nrrdIoStateNix( nio );
+
+      return false;
+    }
 
-  if ( ! nrrddata.get() )
+    nio = nrrdIoStateNix( nio );
+
+    data = reinterpret_cast< const unsigned char* >( nrrddata->nrrd()->data );
+    size = nrrdElementNumber( nrrddata->nrrd() ) * nrrdElementSize( nrrddata->nrrd() );
+  }
+
+  std::fstream file( filename.c_str(), std::ios::in | std::ios::out | std::ios::binary );
+  if ( !file )
   {
-    error = "Error writing file: " + filename + " : no data volume available";
+    error = "Error writing file: " + filename + " : could not open file";
     return false;
   }
 
-  NrrdIoState* nio = nrrdIoStateNew();
+  // The header is separated from the data by an empty line
+  char end[ 2 ] = { 0, 0 };
+  file.seekg( -2, std::ios::end );
+  file.read( end, 2 );
+  file.clear();
+  file.seekp( 0, std::ios::end );
+  if ( end[ 0 ] != '\n' || end[ 1 ] != '\n' ) file.put( '\n' );
 
-  // Turn on compression if the user wants it.
   if ( compress )
-  { 
-    nrrdIoStateEncodingSet( nio, nrrdEncodingGzip );
-    nrrdIoStateSet( nio,  nrrdIoStateZlibLevel, level );
+  {
+    if ( !WriteGzipData( file, data, size, level, error ) )
+    {
+      error = "Error writing file: " + filename + " : " + error;
+      return false;
+    }
   }
-  else
+  else if ( size > 0 )
   {
-    // guarantees consistent compression settings
-    nrrdIoStateSet( nio,  nrrdIoStateZlibLevel, 0 );
+    file.write( reinterpret_cast< const char* >( data ), size );
   }
 
-  // teem library should check for valid nrrd (including file extension?)
-  if ( nrrdSave( filename.c_str(), nrrddata->nrrd(), nio ) )
+  file.close();
+  if ( file.fail() )
   {
-    char *err = biffGet( NRRD );
-    error = "Error writing file: " + filename + " : " + std::string( err );
-    free( err );
-    biffDone( NRRD );
-
+    error = "Error writing file: " + filename + " : could not write data";
     return false;
   }
 
-  nio = nrrdIoStateNix( nio );
-
   error = "";
   return true;
 }
 
+bool NrrdData::FindRawData( const std::string& filename, size_t data_size, 
+  boost::filesystem::path& data_file, long long& offset )
+{
+  std::string native_endian = DataBlock::IsLittleEndian() ? "little" : "big";
+  boost::filesystem::path header_file( filename );
+  long long byte_skip = 0;
+  bool raw = false;
+
+  data_file = header_file;
+  offset = 0;
+
+  try
+  {
+    std::ifstream header( filename.c_str(), std::ios::binary );
+    std::string line;
+    if ( !std::getline( header, line ) || line.substr( 0, 4 ) != "NRRD" ) return false;
+    
+    // The header ends with an empty line, attached data starts right after it
+    while ( std::getline( header, line ) )
+    {
+      if ( !line.empty() && line[ line.size() - 1 ] == '\r' ) line.resize( line.size() - 1 );
+      if ( line.empty() ) break;
+      if ( line[ 0 ] == '#' ) continue;
+
+      std::string::size_type colon = line.find( ": " );
+      if ( colon == std::string::npos ) continue;
+      std::string field = line.substr( 0, colon );
+      std::string value = line.substr( colon + 2 );
+
+      if ( field == "encoding" )
+      {
+        raw = ( value == "raw" );
+      }
+      else if ( field == "endian" )
+      {
+        if ( value != native_endian ) return false;
+      }
+      else if ( field == "line skip" || field == "lineskip" )
+      {
+        if ( value != "0" ) return false;
+      }
+      else if ( field == "byte skip" || field == "byteskip" )
+      {
+        if ( !ImportFromString( value, byte_skip ) ) return false;
+      }
+      else if ( field == "data file" || field == "datafile" )
+      {
+        // Lists of files and file name patterns cannot be mapped as one block
+        if ( value.find( ' ' ) != std::string::npos || value == "LIST" ) return false;
+        data_file = boost::filesystem::path( value );
+        if ( !data_file.is_absolute() ) data_file = header_file.parent_path() / data_file;
+      }
+    }
+
+    if ( !raw ) return false;
+
+    if ( data_file == header_file )
+    {
+      if ( !header ) return false;
+      offset = static_cast< long long >( header.tellg() );
+    }
+
+    // A byte skip of -1 means that the data is at the end of the file
+    if ( byte_skip == -1 )
+    {
+      offset = static_cast< long long >( boost::filesystem::file_size( data_file ) ) - 
+        static_cast< long long >( data_size );
+    }
+    else
+    {
+      offset += byte_skip;
+    }
+  }
+  catch ( ... )
+  {
+    return false;
+  }
+
+  return offset >= 0;
+}
+
 NrrdData::mutex_type& NrrdData::GetMutex()
 {
   // Mutex protecting Teem calls like nrrdLoad and nrrdSave that are known
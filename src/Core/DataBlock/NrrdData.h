@@ -39,6 +39,7 @@
 // Boost includes
 #include <boost/utility.hpp>
 #include <boost/smart_ptr.hpp>
+#include <boost/filesystem/path.hpp>
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/recursive_mutex.hpp>
 
@@ -119,6 +120,11 @@ public:
   /// otherwise it is recomputed
   Histogram get_histogram( bool trust_meta_data = false );
 
+  // GET_STORED_HISTOGRAM:
+  /// Get the histogram from the meta data only. Returns false if the nrrd does not have one.
+  /// NOTE: This works for nrrds of which only the header was read
+  bool get_stored_histogram( Histogram& histogram ) const;
+
   // SET_HISTOGRAM:
   /// Insert a histogram into a nrrd's meta data
   void set_histogram( const Histogram& histogram );
@@ -152,14 +158,24 @@ private:
 public:
 
   // LOADNRRD:
-  /// Load a nrrd into the nrrd data structure
+  /// Load a nrrd into the nrrd data structure. If read_data is false only the header is read
+  /// and the nrrd has no data.
   static bool LoadNrrd( const std::string& filename, NrrdDataHandle& nrrddata, 
-    std::string& error );
+    std::string& error, bool read_data = true );
+
+  // FINDRAWDATA:
+  /// Find where the data of a nrrd file is stored, so it can be mapped into memory. This
+  /// succeeds only if the data is stored in a single file, uncompressed and in the byte order
+  /// of this architecture. data_size is the size of the data in bytes.
+  static bool FindRawData( const std::string& filename, size_t data_size, 
+    boost::filesystem::path& data_file, long long& offset );
 
   // SAVENRRD:
   /// Save a nrrd to file from nrrd data structure
   /// If compress is false, level will be overridden and set to 0, which
   /// corresponds to zlib setting for no compression
+  /// NOTE: Teem is only locked while the header is written, compressed data is deflated in
+  /// parallel into a single gzip stream.
   static bool SaveNrrd( const std::string& filename,
                         NrrdDataHandle nrrddata,
                         std::string& error,
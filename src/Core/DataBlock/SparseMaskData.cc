@@ -0,0 +1,390 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+// STL includes
+#include <algorithm>
+#include <cstring>
+
+// Boost includes
+#include <boost/bind.hpp>
+
+// Core includes
+#include <Core/Utils/Parallel.h>
+#include <Core/DataBlock/SparseMaskData.h>
+
+namespace Core
+{
+
+// Every byte of a word with only its lowest bit set
+static const boost::uint64_t LSB_MASK_C = 0x0101010101010101ULL;
+
+// PACKBYTES:
+// Gather the lowest bit of each of the eight bytes into a single byte, byte i ends up in bit i
+static inline unsigned int PackBytes( boost::uint64_t word )
+{
+  return static_cast< unsigned int >( ( ( word & LSB_MASK_C ) * 0x0102040810204080ULL ) >> 56 );
+}
+
+// SPREADBITS:
+// The inverse of PackBytes, bit i of bits ends up in the lowest bit of byte i
+static inline boost::uint64_t SpreadBits( unsigned int bits )
+{
+  boost::uint64_t word = bits & 0xffu;
+  word = ( word | ( word << 28 ) ) & 0x0000000f0000000fULL;
+  word = ( word | ( word << 14 ) ) & 0x0003000300030003ULL;
+  word = ( word | ( word << 7 ) ) & LSB_MASK_C;
+  return word;
+}
+
+static inline size_t PopCount( boost::uint64_t word )
+{
+  word = word - ( ( word >> 1 ) & 0x5555555555555555ULL );
+  word = ( word & 0x3333333333333333ULL ) + ( ( word >> 2 ) & 0x3333333333333333ULL );
+  word = ( word + ( word >> 4 ) ) & 0x0f0f0f0f0f0f0f0fULL;
+  return static_cast< size_t >( ( word * LSB_MASK_C ) >> 56 );
+}
+
+// LOADROW:
+// Pack a row of at most BRICK_SIZE_C voxels of one bitplane into bits
+static inline unsigned int LoadRow( const unsigned char* data, size_t length, unsigned int bit )
+{
+  unsigned int bits = 0;
+  size_t x = 0;
+  for ( ; x + 8 <= length; x += 8 )
+  {
+    boost::uint64_t word;
+    std::memcpy( &word, data + x, sizeof( word ) );
+    bits |= PackBytes( word >> bit ) << x;
+  }
+  for ( ; x < length; x++ )
+  {
+    bits |= ( ( data[ x ] >> bit ) & 1u ) << x;
+  }
+  return bits;
+}
+
+// STOREROW:
+// Write a row of at most BRICK_SIZE_C voxels into one bitplane
+static inline void StoreRow( unsigned char* data, size_t length, unsigned int bit, 
+  unsigned int bits )
+{
+  size_t x = 0;
+  const boost::uint64_t plane = LSB_MASK_C << bit;
+  for ( ; x + 8 <= length; x += 8 )
+  {
+    boost::uint64_t word;
+    std::memcpy( &word, data + x, sizeof( word ) );
+    word = ( word & ~plane ) | ( SpreadBits( bits >> x ) << bit );
+    std::memcpy( data + x, &word, sizeof( word ) );
+  }
+  for ( ; x < length; x++ )
+  {
+    data[ x ] = static_cast< unsigned char >( ( data[ x ] & ~( 1u << bit ) ) | 
+      ( ( ( bits >> x ) & 1u ) << bit ) );
+  }
+}
+
+static unsigned int GetBit( unsigned char mask_value )
+{
+  unsigned int bit = 0;
+  while ( bit < 8 && !( mask_value & ( 1u << bit ) ) ) bit++;
+  return bit;
+}
+
+// CLASS BrickSlab
+// The bricks of one layer of the brick grid, these are compressed independently and merged
+// afterwards.
+
+class BrickSlab
+{
+public:
+  std::vector< boost::uint32_t > table_;
+  std::vector< boost::uint64_t > pool_;
+};
+
+// CLASS CompressContext
+// The arguments shared by all the slabs that are compressed in parallel
+
+class CompressContext
+{
+public:
+  const unsigned char* data_;
+  unsigned int bit_;
+  size_t nx_, ny_, nz_;
+  size_t bnx_, bny_;
+  std::vector< BrickSlab > slabs_;
+};
+
+SparseMaskData::SparseMaskData( size_t nx, size_t ny, size_t nz ) :
+  nx_( nx ),
+  ny_( ny ),
+  nz_( nz ),
+  bnx_( ( nx + BRICK_SIZE_C - 1 ) >> BRICK_BITS_C ),
+  bny_( ( ny + BRICK_SIZE_C - 1 ) >> BRICK_BITS_C ),
+  bnz_( ( nz + BRICK_SIZE_C - 1 ) >> BRICK_BITS_C )
+{
+}
+
+static void CompressSlabs( CompressContext* context, size_t start, size_t end )
+{
+  const size_t bs = SparseMaskData::BRICK_SIZE_C;
+  const unsigned char* data = context->data_;
+  const unsigned int bit = context->bit_;
+  const size_t nx = context->nx_;
+  const size_t ny = context->ny_;
+  const size_t nz = context->nz_;
+  const size_t bnx = context->bnx_;
+  const size_t bny = context->bny_;
+  const size_t nxy = nx * ny;
+  boost::uint64_t words[ SparseMaskData::BRICK_WORDS_C ];
+
+  for ( size_t bz = start; bz < end; bz++ )
+  {
+    BrickSlab& slab = context->slabs_[ bz ];
+    slab.table_.resize( bnx * bny );
+
+    size_t z0 = bz * bs;
+    size_t ez = std::min( bs, nz - z0 );
+    for ( size_t by = 0; by < bny; by++ )
+    {
+      size_t y0 = by * bs;
+      size_t ey = std::min( bs, ny - y0 );
+      for ( size_t bx = 0; bx < bnx; bx++ )
+      {
+        size_t x0 = bx * bs;
+        size_t ex = std::min( bs, nx - x0 );
+
+        std::memset( words, 0, sizeof( words ) );
+        size_t set_count = 0;
+        for ( size_t lz = 0; lz < ez; lz++ )
+        {
+          for ( size_t ly = 0; ly < ey; ly++ )
+          {
+            unsigned int bits = LoadRow( data + x0 + ( y0 + ly ) * nx + ( z0 + lz ) * nxy,
+              ex, bit );
+            size_t row = ly + ( lz << SparseMaskData::BRICK_BITS_C );
+            words[ row >> 2 ] |= static_cast< boost::uint64_t >( bits ) << ( ( row & 3 ) << 4 );
+            set_count += PopCount( bits );
+          }
+        }
+
+        boost::uint32_t& entry = slab.table_[ bx + by * bnx ];
+        if ( set_count == 0 )
+        {
+          entry = SparseMaskData::EMPTY_BRICK_C;
+        }
+        else if ( set_count == ex * ey * ez )
+        {
+          entry = SparseMaskData::FULL_BRICK_C;
+        }
+        else
+        {
+          entry = static_cast< boost::uint32_t >( 
+            slab.pool_.size() / SparseMaskData::BRICK_WORDS_C + 2 );
+          slab.pool_.insert( slab.pool_.end(), words, words + SparseMaskData::BRICK_WORDS_C );
+        }
+      }
+    }
+  }
+}
+
+SparseMaskDataHandle SparseMaskData::Compress( const unsigned char* data, 
+  unsigned char mask_value, size_t nx, size_t ny, size_t nz )
+{
+  SparseMaskDataHandle sparse( new SparseMaskData( nx, ny, nz ) );
+
+  CompressContext context;
+  context.data_ = data;
+  context.bit_ = GetBit( mask_value );
+  context.nx_ = nx;
+  context.ny_ = ny;
+  context.nz_ = nz;
+  context.bnx_ = sparse->bnx_;
+  context.bny_ = sparse->bny_;
+  context.slabs_.resize( sparse->bnz_ );
+  Parallel::For( 0, sparse->bnz_, boost::bind( &CompressSlabs, &context, _1, _2 ), 1 );
+  std::vector< BrickSlab >& slabs = context.slabs_;
+
+  // Merge the slabs, the pool indices of each slab are offset by the bricks stored before it
+  size_t slab_size = sparse->bnx_ * sparse->bny_;
+  size_t pool_size = 0;
+  for ( size_t bz = 0; bz < slabs.size(); bz++ ) pool_size += slabs[ bz ].pool_.size();
+
+  sparse->brick_table_.resize( slab_size * sparse->bnz_ );
+  sparse->brick_pool_.reserve( pool_size );
+  for ( size_t bz = 0; bz < slabs.size(); bz++ )
+  {
+    boost::uint32_t offset = static_cast< boost::uint32_t >( 
+      sparse->brick_pool_.size() / BRICK_WORDS_C );
+    for ( size_t j = 0; j < slab_size; j++ )
+    {
+      boost::uint32_t entry = slabs[ bz ].table_[ j ];
+      sparse->brick_table_[ bz * slab_size + j ] = entry > FULL_BRICK_C ? entry + offset : entry;
+    }
+    sparse->brick_pool_.insert( sparse->brick_pool_.end(), slabs[ bz ].pool_.begin(), 
+      slabs[ bz ].pool_.end() );
+    std::vector< boost::uint64_t >().swap( slabs[ bz ].pool_ );
+  }
+
+  return sparse;
+}
+
+void SparseMaskData::decompress_range( unsigned char* data, unsigned int bit, 
+  size_t start, size_t end ) const
+{
+  const size_t bs = BRICK_SIZE_C;
+  const size_t nx = this->nx_;
+  const size_t ny = this->ny_;
+  const size_t nz = this->nz_;
+  const size_t bnx = this->bnx_;
+  const size_t bny = this->bny_;
+  const size_t nxy = nx * ny;
+
+  for ( size_t bz = start; bz < end; bz++ )
+  {
+    size_t z0 = bz * bs;
+    size_t ez = std::min( bs, nz - z0 );
+    for ( size_t by = 0; by < bny; by++ )
+    {
+      size_t y0 = by * bs;
+      size_t ey = std::min( bs, ny - y0 );
+      for ( size_t bx = 0; bx < bnx; bx++ )
+      {
+        size_t x0 = bx * bs;
+        size_t ex = std::min( bs, nx - x0 );
+        boost::uint32_t entry = this->brick_table_[ bx + bnx * ( by + bny * bz ) ];
+        const boost::uint64_t* words = entry > FULL_BRICK_C ?
+          &this->brick_pool_[ ( entry - 2 ) * BRICK_WORDS_C ] : 0;
+        unsigned int solid = entry == FULL_BRICK_C ? 0xffffu : 0u;
+
+        for ( size_t lz = 0; lz < ez; lz++ )
+        {
+          for ( size_t ly = 0; ly < ey; ly++ )
+          {
+            unsigned int bits = solid;
+            if ( words )
+            {
+              size_t row = ly + ( lz << BRICK_BITS_C );
+              bits = static_cast< unsigned int >( 
+                ( words[ row >> 2 ] >> ( ( row & 3 ) << 4 ) ) & 0xffffu );
+            }
+            StoreRow( data + x0 + ( y0 + ly ) * nx + ( z0 + lz ) * nxy, ex, bit, bits );
+          }
+        }
+      }
+    }
+  }
+}
+
+void SparseMaskData::decompress( unsigned char* data, unsigned char mask_value ) const
+{
+  Parallel::For( 0, this->bnz_, boost::bind( &SparseMaskData::decompress_range, this, data,
+    GetBit( mask_value ), _1, _2 ), 1 );
+}
+
+bool SparseMaskData::get_mask_at( size_t index ) const
+{
+  size_t nxy = this->nx_ * this->ny_;
+  if ( index >= nxy * this->nz_ ) return false;
+  size_t z = index / nxy;
+  index -= z * nxy;
+  return this->get_mask_at( index % this->nx_, index / this->nx_, z );
+}
+
+void SparseMaskData::copy_slice( size_t start, std::ptrdiff_t x_stride, 
+  std::ptrdiff_t y_stride, size_t slice_nx, size_t slice_ny, unsigned char* buffer, 
+  unsigned char value ) const
+{
+  // Convert the strides in the linear index into steps along the axes
+  const size_t nx = this->nx_;
+  const size_t nxy = this->nx_ * this->ny_;
+  std::ptrdiff_t step[ 2 ][ 3 ];
+  std::ptrdiff_t strides[ 2 ] = { x_stride, y_stride };
+  for ( int k = 0; k < 2; k++ )
+  {
+    size_t stride = static_cast< size_t >( strides[ k ] < 0 ? -strides[ k ] : strides[ k ] );
+    std::ptrdiff_t sign = strides[ k ] < 0 ? -1 : 1;
+    step[ k ][ 2 ] = sign * static_cast< std::ptrdiff_t >( stride / nxy );
+    stride %= nxy;
+    step[ k ][ 1 ] = sign * static_cast< std::ptrdiff_t >( stride / nx );
+    step[ k ][ 0 ] = sign * static_cast< std::ptrdiff_t >( stride % nx );
+  }
+
+  std::ptrdiff_t row[ 3 ];
+  row[ 2 ] = static_cast< std::ptrdiff_t >( start / nxy );
+  row[ 1 ] = static_cast< std::ptrdiff_t >( ( start % nxy ) / nx );
+  row[ 0 ] = static_cast< std::ptrdiff_t >( start % nx );
+
+  for ( size_t j = 0; j < slice_ny; j++ )
+  {
+    std::ptrdiff_t x = row[ 0 ], y = row[ 1 ], z = row[ 2 ];
+    unsigned char* dst = buffer + j * slice_nx;
+    for ( size_t i = 0; i < slice_nx; i++ )
+    {
+      dst[ i ] = this->get_mask_at( static_cast< size_t >( x ), static_cast< size_t >( y ), 
+        static_cast< size_t >( z ) ) ? value : 0;
+      x += step[ 0 ][ 0 ]; y += step[ 0 ][ 1 ]; z += step[ 0 ][ 2 ];
+    }
+    row[ 0 ] += step[ 1 ][ 0 ]; row[ 1 ] += step[ 1 ][ 1 ]; row[ 2 ] += step[ 1 ][ 2 ];
+  }
+}
+
+size_t SparseMaskData::count() const
+{
+  const size_t bs = BRICK_SIZE_C;
+  size_t count = 0;
+  for ( size_t bz = 0; bz < this->bnz_; bz++ )
+  {
+    size_t ez = std::min( bs, this->nz_ - bz * bs );
+    for ( size_t by = 0; by < this->bny_; by++ )
+    {
+      size_t ey = std::min( bs, this->ny_ - by * bs );
+      for ( size_t bx = 0; bx < this->bnx_; bx++ )
+      {
+        size_t ex = std::min( bs, this->nx_ - bx * bs );
+        boost::uint32_t entry = this->brick_table_[ bx + this->bnx_ * ( by + this->bny_ * bz ) ];
+        if ( entry == FULL_BRICK_C ) count += ex * ey * ez;
+      }
+    }
+  }
+
+  for ( size_t j = 0; j < this->brick_pool_.size(); j++ )
+  {
+    count += PopCount( this->brick_pool_[ j ] );
+  }
+
+  return count;
+}
+
+size_t SparseMaskData::get_byte_size() const
+{
+  return this->brick_table_.size() * sizeof( boost::uint32_t ) + 
+    this->brick_pool_.size() * sizeof( boost::uint64_t );
+}
+
+} // end namespace Core
@@ -0,0 +1,171 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef CORE_DATABLOCK_SPARSEMASKDATA_H
+#define CORE_DATABLOCK_SPARSEMASKDATA_H
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1020)
+# pragma once
+#endif 
+
+// STL includes
+#include <cstddef>
+#include <vector>
+
+// Boost includes
+#include <boost/utility.hpp>
+#include <boost/smart_ptr.hpp>
+#include <boost/cstdint.hpp>
+
+namespace Core
+{
+
+// Forward Declaration
+class SparseMaskData;
+typedef boost::shared_ptr< SparseMaskData > SparseMaskDataHandle;
+typedef boost::shared_ptr< const SparseMaskData > SparseMaskDataConstHandle;
+
+// CLASS SparseMaskData
+/// A compressed copy of a single mask bitplane. The volume is divided into bricks of 16x16x16
+/// voxels. Bricks that are completely empty or completely full are only recorded in the brick
+/// table, the other bricks are stored as packed bits (one bit per voxel) in a brick pool.
+/// Segmentations usually cover a small part of the volume and have large solid interiors,
+/// hence most bricks do not need to be stored.
+/// NOTE: The data is immutable once it has been compressed, so it can be read from multiple
+/// threads without locking. A mask that needs to be altered is decompressed into a bitplane
+/// first.
+class SparseMaskData : public boost::noncopyable
+{
+  // -- constants --
+public:
+  /// Number of bits in each dimension of the brick index
+  static const size_t BRICK_BITS_C = 4;
+  /// Size of a brick in each dimension
+  static const size_t BRICK_SIZE_C = 1 << BRICK_BITS_C;
+  /// Number of 64-bit words needed for one stored brick
+  static const size_t BRICK_WORDS_C = ( BRICK_SIZE_C * BRICK_SIZE_C * BRICK_SIZE_C ) >> 6;
+
+  /// Entries of the brick table that do not refer to the brick pool
+  static const boost::uint32_t EMPTY_BRICK_C = 0;
+  static const boost::uint32_t FULL_BRICK_C = 1;
+
+  // -- constructor --
+private:
+  SparseMaskData( size_t nx, size_t ny, size_t nz );
+
+public:
+  // COMPRESS:
+  /// Compress the bitplane selected by mask_value out of a mask data block
+  static SparseMaskDataHandle Compress( const unsigned char* data, unsigned char mask_value,
+    size_t nx, size_t ny, size_t nz );
+
+  // -- access --
+public:
+  // DECOMPRESS:
+  /// Write the mask into the bitplane selected by mask_value of a mask data block, the other
+  /// bitplanes are left untouched.
+  void decompress( unsigned char* data, unsigned char mask_value ) const;
+
+  // GET_MASK_AT:
+  /// Get the mask value at a certain coordinate
+  inline bool get_mask_at( size_t x, size_t y, size_t z ) const
+  {
+    size_t brick = this->to_brick_index( x, y, z );
+    boost::uint32_t entry = this->brick_table_[ brick ];
+    if ( entry <= FULL_BRICK_C ) return entry == FULL_BRICK_C;
+
+    size_t bit = ( x & ( BRICK_SIZE_C - 1 ) ) | 
+      ( ( y & ( BRICK_SIZE_C - 1 ) ) << BRICK_BITS_C ) | 
+      ( ( z & ( BRICK_SIZE_C - 1 ) ) << ( 2 * BRICK_BITS_C ) );
+    return ( ( this->brick_pool_[ ( entry - 2 ) * BRICK_WORDS_C + ( bit >> 6 ) ] >> 
+      ( bit & 63 ) ) & 1 ) != 0;
+  }
+
+  // GET_MASK_AT:
+  /// Get the mask value at a certain index
+  bool get_mask_at( size_t index ) const;
+
+  // COPY_SLICE:
+  /// Copy a two dimensional slice of the mask into buffer. The slice starts at voxel index
+  /// start and steps through the volume with x_stride and y_stride, which need to be one step
+  /// along one of the axes of the volume. Voxels that are set are written as value, the
+  /// others as zero.
+  void copy_slice( size_t start, std::ptrdiff_t x_stride, std::ptrdiff_t y_stride,
+    size_t slice_nx, size_t slice_ny, unsigned char* buffer, unsigned char value ) const;
+
+  // COUNT:
+  /// Count the number of voxels that are set
+  size_t count() const;
+
+  // GET_BYTE_SIZE:
+  /// Memory used by the brick table and brick pool
+  size_t get_byte_size() const;
+
+  // GET_NUM_STORED_BRICKS:
+  /// The number of bricks that are neither empty nor full
+  size_t get_num_stored_bricks() const
+  {
+    return this->brick_pool_.size() / BRICK_WORDS_C;
+  }
+
+  size_t get_nx() const { return this->nx_; }
+  size_t get_ny() const { return this->ny_; }
+  size_t get_nz() const { return this->nz_; }
+
+  // -- internals --
+private:
+  // DECOMPRESS_RANGE:
+  /// Decompress the layers [start, end) of the brick grid
+  void decompress_range( unsigned char* data, unsigned int bit, size_t start, size_t end ) const;
+
+  inline size_t to_brick_index( size_t x, size_t y, size_t z ) const
+  {
+    return ( x >> BRICK_BITS_C ) + this->bnx_ * ( ( y >> BRICK_BITS_C ) + 
+      this->bny_ * ( z >> BRICK_BITS_C ) );
+  }
+
+  /// Dimensions of the volume
+  size_t nx_;
+  size_t ny_;
+  size_t nz_;
+
+  /// Dimensions of the brick grid
+  size_t bnx_;
+  size_t bny_;
+  size_t bnz_;
+
+  /// One entry per brick: EMPTY_BRICK_C, FULL_BRICK_C or the index in the brick pool plus 2
+  std::vector< boost::uint32_t > brick_table_;
+
+  /// Packed bits of the stored bricks, BRICK_WORDS_C words per brick
+  std::vector< boost::uint64_t > brick_pool_;
+};
+
+} // end namespace Core
+
+#endif
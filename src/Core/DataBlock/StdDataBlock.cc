@@ -41,75 +41,31 @@ StdDataBlock::StdDataBlock( size_t nx, size_t ny, size_t nz, DataType dtype )
   set_type( dtype );
 
   // Allocate the memory block through C++'s std library
-  switch( get_data_type() )
+  if ( get_data_type() == DataType::UNKNOWN_E )
   {
-  case DataType::UNKNOWN_E:
     set_nx( 0 );
     set_ny( 0 );
     set_nz( 0 );
     set_data( 0 );
-    break;
-  case DataType::CHAR_E:
-    set_data( reinterpret_cast< void* > ( new char[ get_size() ] ) );
-    break;
-  case DataType::UCHAR_E:
-    set_data( reinterpret_cast<void*>( new unsigned char[ get_size() ] ) ); 
-    break;
-  case DataType::SHORT_E:
-    set_data( reinterpret_cast< void* > ( new short[ get_size() ] ) );
-    break;
-  case DataType::USHORT_E:
-    set_data(reinterpret_cast<void*>( new unsigned short[ get_size() ] ) ); 
-    break;
-  case DataType::INT_E:
-    set_data( reinterpret_cast< void* > ( new int[ get_size() ] ) );
-    break;
-  case DataType::UINT_E:
-    set_data( reinterpret_cast<void*>( new unsigned int[ get_size() ] ) ); 
-    break;
-  case DataType::FLOAT_E:
-    set_data( reinterpret_cast< void* > ( new float[ get_size() ] ) );
-    break;
-  case DataType::DOUBLE_E:
-    set_data( reinterpret_cast< void* > ( new double[ get_size() ] ) );
-    break;
+  }
+  else
+  {
+    allocate_data();
   }
 }
 
+StdDataBlock::StdDataBlock( const DataBlockHandle& src )
+{
+  // Set the properties of this datablock
+  set_nx( src->get_nx() );
+  set_ny( src->get_ny() );
+  set_nz( src->get_nz() );
+  set_type( src->get_data_type() );
+}
+
 StdDataBlock::~StdDataBlock()
 {
-  if ( get_data() )
-  {
-    switch( get_data_type() )
-    {
-    case DataType::UNKNOWN_E:
-      break;
-    case DataType::CHAR_E:
-      delete[] reinterpret_cast< char* > ( get_data() );
-      break;
-    case DataType::UCHAR_E:
-      delete[] reinterpret_cast<unsigned char*>( get_data() ); 
-      break;
-    case DataType::SHORT_E:
-      delete[] reinterpret_cast< short* > ( get_data() );
-      break;
-    case DataType::USHORT_E:
-      delete[] reinterpret_cast<unsigned short*>( get_data() ); 
-      break;
-    case DataType::INT_E:
-      delete[] reinterpret_cast< int* > ( get_data() );
-      break;
-    case DataType::UINT_E:
-      delete[] reinterpret_cast<unsigned int*>( get_data() ); 
-      break;
-    case DataType::FLOAT_E:
-      delete[] reinterpret_cast< float* > ( get_data() );
-      break;
-    case DataType::DOUBLE_E:
-      delete[] reinterpret_cast< double* > ( get_data() );
-      break;
-    }
-  }
+  // NOTE: The memory is owned by the base class, it is released once no duplicate refers to it
 }
 
 DataBlockHandle StdDataBlock::New( size_t nx, size_t ny, size_t nz, DataType type )
@@ -143,4 +99,15 @@ DataBlockHandle StdDataBlock::New( GridTransform transform, DataType type )
   }
 }
 
+DataBlockHandle StdDataBlock::NewShared( const DataBlockHandle& src )
+{
+  if ( !src ) return DataBlockHandle();
+
+  StdDataBlock* data_block = new StdDataBlock( src );
+  DataBlockHandle data_block_handle( data_block );
+  if ( !data_block->share_data( *src ) ) return DataBlockHandle();
+
+  return data_block_handle;
+}
+
 } // end namespace Core
@@ -50,6 +50,7 @@ class StdDataBlock : public DataBlock
   // -- Constructor/destructor --
 private:
   StdDataBlock( size_t nx, size_t ny, size_t nz, DataType type );
+  explicit StdDataBlock( const DataBlockHandle& src );
 
 public: 
   virtual ~StdDataBlock();
@@ -58,6 +59,11 @@ public:
   static DataBlockHandle New( size_t nx, size_t ny, size_t nz, DataType type );
 
   static DataBlockHandle New( GridTransform transform, DataType type );
+
+  // NEWSHARED:
+  /// Create a data block that shares the memory of src, the memory is copied once either of the
+  /// data blocks is written to. Returns an empty handle if src does not own its memory.
+  static DataBlockHandle NewShared( const DataBlockHandle& src );
 };
 
 } // end namespace Core
@@ -28,10 +28,14 @@
 
 #include <gtest/gtest.h>
 #include <algorithm>
+#include <limits>
 
 #include <Testing/Utils/DataBlockSource.h>
 #include <Testing/Utils/DummyDataBlock.h>
 
+#include <Core/DataBlock/StdDataBlock.h>
+#include <Core/DataBlock/DataBlockManager.h>
+
 
 using namespace Core;
 using namespace Testing::Utils;
@@ -104,3 +108,223 @@ TEST_F(DataBlockTest, SetData)
   EXPECT_EQ(dataBlock_->get_nz(), 3);
 }
 
+
+TEST(DataBlockHistogramTest, LazyAndIncrementalHistogram)
+{
+  DataBlockHandle data_block = StdDataBlock::New( 8, 8, 8, DataType::FLOAT_E );
+  float* data = reinterpret_cast< float* >( data_block->get_data() );
+  for ( size_t j = 0; j < data_block->get_size(); j++ ) data[ j ] = static_cast< float >( j % 100 );
+  data_block->invalidate_histogram();
+
+  // The histogram is computed when it is first needed
+  ASSERT_FALSE( data_block->has_histogram() );
+  ASSERT_EQ( data_block->get_min(), 0.0 );
+  ASSERT_EQ( data_block->get_max(), 99.0 );
+  ASSERT_TRUE( data_block->has_histogram() );
+
+  // Inserting a slice that does not hold the minimum or maximum and writes values inside the
+  // range updates the histogram
+  DataSliceHandle slice;
+  ASSERT_TRUE( data_block->extract_slice( SliceType::AXIAL_E, 2, slice ) );
+  float* slice_data = reinterpret_cast< float* >( slice->get_data_block()->get_data() );
+  for ( size_t j = 0; j < slice->get_data_block()->get_size(); j++ ) slice_data[ j ] = 42.0f;
+  ASSERT_TRUE( data_block->insert_slice( slice ) );
+  ASSERT_TRUE( data_block->has_histogram() );
+  Histogram recomputed( data, data_block->get_size() );
+  ASSERT_EQ( data_block->get_histogram().get_bins(), recomputed.get_bins() );
+
+  // A value outside the range needs a new histogram
+  slice_data[ 0 ] = 1000.0f;
+  ASSERT_TRUE( data_block->insert_slice( slice ) );
+  ASSERT_FALSE( data_block->has_histogram() );
+  ASSERT_EQ( data_block->get_max(), 1000.0 );
+}
+
+static DataBlockHandle CreateIndexDataBlock( size_t nx, size_t ny, size_t nz )
+{
+  DataBlockHandle data_block = StdDataBlock::New( nx, ny, nz, DataType::INT_E );
+  int* data = reinterpret_cast< int* >( data_block->get_data() );
+  for ( size_t j = 0; j < data_block->get_size(); j++ ) data[ j ] = static_cast< int >( j );
+  return data_block;
+}
+
+TEST(DataBlockKernelTest, ConvertDataType)
+{
+  DataBlockHandle src = StdDataBlock::New( 31, 7, 5, DataType::FLOAT_E );
+  float* src_data = reinterpret_cast< float* >( src->get_data() );
+  for ( size_t j = 0; j < src->get_size(); j++ ) 
+  {
+    src_data[ j ] = static_cast< float >( j ) * 0.75f - 300.0f;
+  }
+
+  DataBlockHandle dst;
+  ASSERT_TRUE( DataBlock::ConvertDataType( src, dst, DataType::SHORT_E ) );
+  ASSERT_EQ( dst->get_data_type(), DataType::SHORT_E );
+  short* dst_data = reinterpret_cast< short* >( dst->get_data() );
+  for ( size_t j = 0; j < src->get_size(); j++ )
+  {
+    ASSERT_EQ( dst_data[ j ], static_cast< short >( src_data[ j ] ) );
+  }
+}
+
+TEST(DataBlockKernelTest, QuantizeData)
+{
+  DataBlockHandle src = StdDataBlock::New( 16, 16, 4, DataType::FLOAT_E );
+  float* src_data = reinterpret_cast< float* >( src->get_data() );
+  for ( size_t j = 0; j < src->get_size(); j++ ) src_data[ j ] = static_cast< float >( j );
+
+  // The minimum and maximum map onto the ends of the range of the new type
+  DataBlockHandle dst;
+  ASSERT_TRUE( DataBlock::QuantizeData( src, dst, DataType::UCHAR_E ) );
+  unsigned char* dst_data = reinterpret_cast< unsigned char* >( dst->get_data() );
+  ASSERT_EQ( dst_data[ 0 ], 0 );
+  ASSERT_EQ( dst_data[ 4 ], 1 );
+  ASSERT_EQ( dst_data[ src->get_size() - 1 ], 255 );
+
+  ASSERT_TRUE( DataBlock::QuantizeData( src, dst, DataType::SHORT_E ) );
+  short* short_data = reinterpret_cast< short* >( dst->get_data() );
+  ASSERT_EQ( short_data[ 0 ], -32768 );
+  ASSERT_EQ( short_data[ src->get_size() - 1 ], 32767 );
+
+  ASSERT_TRUE( DataBlock::QuantizeData( src, dst, DataType::CHAR_E ) );
+  signed char* char_data = reinterpret_cast< signed char* >( dst->get_data() );
+  ASSERT_EQ( char_data[ 0 ], -128 );
+  ASSERT_EQ( char_data[ 4 ], -127 );
+  ASSERT_EQ( char_data[ src->get_size() - 1 ], 127 );
+
+  ASSERT_TRUE( DataBlock::QuantizeData( src, dst, DataType::INT_E ) );
+  int* int_data = reinterpret_cast< int* >( dst->get_data() );
+  ASSERT_EQ( int_data[ 0 ], std::numeric_limits< int >::min() );
+  ASSERT_EQ( int_data[ src->get_size() - 1 ], std::numeric_limits< int >::max() );
+}
+
+TEST(DataBlockKernelTest, PermuteData)
+{
+  // Larger than one tile along each axis, and not a multiple of the tile size
+  DataBlockHandle src = CreateIndexDataBlock( 37, 21, 18 );
+  const int* src_data = reinterpret_cast< const int* >( src->get_data() );
+  size_t sn[ 3 ] = { src->get_nx(), src->get_ny(), src->get_nz() };
+
+  int orders[ 6 ][ 3 ] = { { 1, 2, 3 }, { 1, 3, 2 }, { 2, 1, 3 }, { 2, 3, 1 }, { 3, 1, 2 }, 
+    { 3, 2, 1 } };
+  for ( int order = 0; order < 6; order++ )
+  {
+    for ( int signs = 0; signs < 8; signs++ )
+    {
+      std::vector< int > permutation( 3 );
+      for ( int j = 0; j < 3; j++ )
+      {
+        permutation[ j ] = ( signs & ( 1 << j ) ) ? -orders[ order ][ j ] : orders[ order ][ j ];
+      }
+
+      DataBlockHandle dst;
+      ASSERT_TRUE( DataBlock::PermuteData( src, dst, permutation ) );
+      const int* dst_data = reinterpret_cast< const int* >( dst->get_data() );
+
+      size_t d[ 3 ];
+      for ( d[ 2 ] = 0; d[ 2 ] < dst->get_nz(); d[ 2 ]++ )
+      {
+        for ( d[ 1 ] = 0; d[ 1 ] < dst->get_ny(); d[ 1 ]++ )
+        {
+          for ( d[ 0 ] = 0; d[ 0 ] < dst->get_nx(); d[ 0 ]++ )
+          {
+            size_t s[ 3 ];
+            for ( int j = 0; j < 3; j++ )
+            {
+              int axis = orders[ order ][ j ] - 1;
+              s[ axis ] = permutation[ j ] < 0 ? sn[ axis ] - 1 - d[ j ] : d[ j ];
+            }
+            ASSERT_EQ( dst_data[ dst->to_index( d[ 0 ], d[ 1 ], d[ 2 ] ) ], 
+              src_data[ src->to_index( s[ 0 ], s[ 1 ], s[ 2 ] ) ] );
+          }
+        }
+      }
+    }
+  }
+}
+
+TEST(DataBlockKernelTest, PadAndClip)
+{
+  DataBlockHandle src = CreateIndexDataBlock( 5, 4, 3 );
+
+  DataBlockHandle padded;
+  ASSERT_TRUE( DataBlock::Pad( src, padded, 2, -1.0 ) );
+  ASSERT_EQ( padded->get_nx(), 9u );
+  ASSERT_EQ( padded->get_nz(), 7u );
+  for ( size_t z = 0; z < 7; z++ )
+  {
+    for ( size_t y = 0; y < 8; y++ )
+    {
+      for ( size_t x = 0; x < 9; x++ )
+      {
+        bool inside = x >= 2 && x < 7 && y >= 2 && y < 6 && z >= 2 && z < 5;
+        double expected = inside ? src->get_data_at( x - 2, y - 2, z - 2 ) : -1.0;
+        ASSERT_EQ( padded->get_data_at( x, y, z ), expected );
+      }
+    }
+  }
+
+  // A negative pad removes the border again
+  DataBlockHandle cropped;
+  ASSERT_TRUE( DataBlock::Pad( padded, cropped, -2, 0.0 ) );
+  ASSERT_EQ( cropped->get_size(), src->get_size() );
+  for ( size_t j = 0; j < src->get_size(); j++ )
+  {
+    ASSERT_EQ( cropped->get_data_at( j ), src->get_data_at( j ) );
+  }
+
+  // Clipping keeps the origin in place and fills the new voxels
+  DataBlockHandle clipped;
+  ASSERT_TRUE( DataBlock::Clip( src, clipped, 3, 6, 4, 7.0 ) );
+  for ( size_t z = 0; z < 4; z++ )
+  {
+    for ( size_t y = 0; y < 6; y++ )
+    {
+      for ( size_t x = 0; x < 3; x++ )
+      {
+        double expected = ( y < 4 && z < 3 ) ? src->get_data_at( x, y, z ) : 7.0;
+        ASSERT_EQ( clipped->get_data_at( x, y, z ), expected );
+      }
+    }
+  }
+}
+
+TEST(DataBlockCopyOnWriteTest, DuplicateSharesDataUntilWritten)
+{
+  DataBlockHandle src = CreateIndexDataBlock( 6, 5, 4 );
+  DataBlockManager::Instance()->register_datablock( src );
+
+  DataBlockHandle dst;
+  ASSERT_TRUE( DataBlock::Duplicate( src, dst ) );
+  DataBlockManager::Instance()->register_datablock( dst );
+  ASSERT_TRUE( src->is_shared() );
+  ASSERT_TRUE( dst->is_shared() );
+  ASSERT_EQ( src->get_const_data(), dst->get_const_data() );
+
+  size_t private_bytes, shared_bytes;
+  DataBlockManager::Instance()->get_memory_usage( private_bytes, shared_bytes );
+  ASSERT_EQ( private_bytes, 0u );
+  ASSERT_EQ( shared_bytes, src->get_byte_size() );
+
+  // Writing to the duplicate gives it its own copy and leaves the source untouched
+  dst->set_data_at( 0, -1.0 );
+  ASSERT_FALSE( src->is_shared() );
+  ASSERT_FALSE( dst->is_shared() );
+  ASSERT_NE( src->get_const_data(), dst->get_const_data() );
+  ASSERT_EQ( src->get_data_at( 0 ), 0.0 );
+  ASSERT_EQ( dst->get_data_at( 0 ), -1.0 );
+  for ( size_t j = 1; j < src->get_size(); j++ )
+  {
+    ASSERT_EQ( dst->get_data_at( j ), src->get_data_at( j ) );
+  }
+
+  DataBlockManager::Instance()->get_memory_usage( private_bytes, shared_bytes );
+  ASSERT_EQ( private_bytes, 2 * src->get_byte_size() );
+  ASSERT_EQ( shared_bytes, 0u );
+
+  // Once the duplicate is gone the source writes in place
+  ASSERT_TRUE( DataBlock::Duplicate( src, dst ) );
+  dst.reset();
+  const void* data = src->get_const_data();
+  ASSERT_EQ( src->get_data(), data );
+}
@@ -0,0 +1,176 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+ 
+ The MIT License
+ 
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+ 
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+*/
+
+#include <gtest/gtest.h>
+
+#include <limits>
+#include <vector>
+
+#include <Core/DataBlock/Histogram.h>
+
+using namespace Core;
+
+// Large enough to be split over several threads
+static const size_t DATA_SIZE_C = 3000017;
+
+template< class T >
+static void CheckHistogram( const std::vector< T >& data, double min, double max )
+{
+  Histogram histogram( &data[ 0 ], data.size() );
+  ASSERT_TRUE( histogram.is_valid() );
+  ASSERT_EQ( histogram.get_min(), min );
+  ASSERT_EQ( histogram.get_max(), max );
+
+  // Every finite value ends up in the bin that contains it
+  std::vector< size_t > bins( histogram.get_size(), 0 );
+  for ( size_t j = 0; j < data.size(); j++ )
+  {
+    double value = static_cast< double >( data[ j ] );
+    if ( !( value >= min && value <= max ) ) continue;
+    size_t idx = static_cast< size_t >( ( value - histogram.get_bin_start() ) / 
+      histogram.get_bin_size() );
+    if ( idx >= bins.size() ) idx = bins.size() - 1;
+    bins[ idx ]++;
+  }
+  ASSERT_EQ( histogram.get_bins(), bins );
+
+  double minmax_min, minmax_max;
+  ASSERT_TRUE( Histogram::ComputeMinMax( &data[ 0 ], data.size(), minmax_min, minmax_max ) );
+  ASSERT_EQ( minmax_min, min );
+  ASSERT_EQ( minmax_max, max );
+}
+
+TEST(HistogramTest, UnsignedChar)
+{
+  std::vector< unsigned char > data( DATA_SIZE_C );
+  for ( size_t j = 0; j < data.size(); j++ ) data[ j ] = static_cast< unsigned char >( 3 + j % 97 );
+  CheckHistogram( data, 3.0, 99.0 );
+  Histogram histogram( &data[ 0 ], data.size() );
+  ASSERT_EQ( histogram.get_size(), size_t( 97 ) );
+}
+
+TEST(HistogramTest, Short)
+{
+  std::vector< short > data( DATA_SIZE_C );
+  for ( size_t j = 0; j < data.size(); j++ ) 
+  {
+    data[ j ] = static_cast< short >( static_cast< int >( ( j * 7919 ) % 20001 ) - 15000 );
+  }
+  CheckHistogram( data, -15000.0, 5000.0 );
+}
+
+TEST(HistogramTest, Int)
+{
+  std::vector< int > data( DATA_SIZE_C );
+  for ( size_t j = 0; j < data.size(); j++ ) data[ j ] = static_cast< int >( j % 200 ) - 150;
+  // The first value is the only one with the minimum
+  data[ 0 ] = -1000;
+  CheckHistogram( data, -1000.0, 49.0 );
+}
+
+TEST(HistogramTest, BinBorders)
+{
+  // Bins of 20, every value that is an odd multiple of 10 lies on the border of two bins
+  std::vector< int > int_data( DATA_SIZE_C );
+  for ( size_t j = 0; j < int_data.size(); j++ ) int_data[ j ] = static_cast< int >( j % 5101 );
+  CheckHistogram( int_data, 0.0, 5100.0 );
+
+  // Bins of 0.1, which has no exact binary representation. Apart from the minimum and the 
+  // maximum all values lie on the border of two bins.
+  const double max = 25.5;
+  const double bin_size = max / 255.0;
+  const double bin_start = -0.5 * bin_size;
+  std::vector< double > data( DATA_SIZE_C );
+  data[ 0 ] = 0.0;
+  data[ 1 ] = max;
+  for ( size_t j = 2; j < data.size(); j++ ) 
+  {
+    data[ j ] = bin_start + static_cast< double >( 1 + j % 255 ) * bin_size;
+  }
+  CheckHistogram( data, 0.0, max );
+}
+
+TEST(HistogramTest, FloatNonFinite)
+{
+  std::vector< float > data( DATA_SIZE_C );
+  for ( size_t j = 0; j < data.size(); j++ ) 
+  {
+    data[ j ] = -1000.0f - static_cast< float >( j % 1000 ) * 0.125f;
+  }
+  data[ 5 ] = std::numeric_limits< float >::quiet_NaN();
+  data[ 77 ] = std::numeric_limits< float >::infinity();
+  data[ data.size() - 1 ] = -std::numeric_limits< float >::infinity();
+  // All values are negative
+  CheckHistogram( data, -1124.875, -1000.0 );
+}
+
+TEST(HistogramTest, Constant)
+{
+  std::vector< double > data( 17, 3.5 );
+  CheckHistogram( data, 3.5, 3.5 );
+  Histogram histogram( &data[ 0 ], data.size() );
+  ASSERT_EQ( histogram.get_size(), size_t( 1 ) );
+}
+
+TEST(HistogramTest, AllNaN)
+{
+  std::vector< float > data( 100, std::numeric_limits< float >::quiet_NaN() );
+  Histogram histogram;
+  ASSERT_FALSE( histogram.compute( &data[ 0 ], data.size() ) );
+  ASSERT_FALSE( histogram.is_valid() );
+  double min, max;
+  ASSERT_FALSE( Histogram::ComputeMinMax( &data[ 0 ], data.size(), min, max ) );
+}
+
+TEST(HistogramTest, IncrementalUpdate)
+{
+  std::vector< float > data( DATA_SIZE_C );
+  for ( size_t j = 0; j < data.size(); j++ ) 
+  {
+    data[ j ] = static_cast< float >( j % 1013 ) * 0.25f;
+  }
+  Histogram histogram( &data[ 0 ], data.size() );
+
+  // Values inside the range update the bins
+  std::vector< float > old_values( data.begin() + 1013, data.begin() + 2000 );
+  std::vector< float > new_values( old_values.size() );
+  for ( size_t j = 0; j < new_values.size(); j++ ) new_values[ j ] = 17.0f + j % 3;
+  // The minimum is overwritten but written again
+  ASSERT_EQ( old_values[ 0 ], 0.0f );
+  new_values[ 5 ] = 0.0f;
+  std::copy( new_values.begin(), new_values.end(), data.begin() + 1013 );
+  ASSERT_TRUE( histogram.update( &old_values[ 0 ], &new_values[ 0 ], old_values.size() ) );
+  Histogram recomputed( &data[ 0 ], data.size() );
+  ASSERT_EQ( histogram.get_bins(), recomputed.get_bins() );
+  ASSERT_EQ( histogram.get_max_bin(), recomputed.get_max_bin() );
+
+  // Values outside the range cannot be added incrementally
+  std::vector< float > out_of_range( new_values.size(), 1000.0f );
+  ASSERT_FALSE( histogram.update( &new_values[ 0 ], &out_of_range[ 0 ], new_values.size() ) );
+  ASSERT_EQ( histogram.get_bins(), recomputed.get_bins() );
+}
@@ -0,0 +1,140 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+#include <gtest/gtest.h>
+
+#include <fstream>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include <Core/DataBlock/MappedDataBlock.h>
+
+using namespace Core;
+
+class MappedDataBlockTest : public ::testing::Test {
+protected:
+  virtual void SetUp()
+  {
+    directory_ = boost::filesystem::temp_directory_path() / 
+      boost::filesystem::unique_path( "MappedDataBlockTest-%%%%-%%%%" );
+    boost::filesystem::create_directories( directory_ );
+  }
+
+  virtual void TearDown()
+  {
+    boost::system::error_code ec;
+    boost::filesystem::remove_all( directory_, ec );
+  }
+
+  boost::filesystem::path directory_;
+};
+
+TEST_F(MappedDataBlockTest, MapFileWithOffset)
+{
+  const size_t nx = 7, ny = 5, nz = 3;
+  const long long offset = 16;
+  std::vector<float> values( nx * ny * nz );
+  for ( size_t j = 0; j < values.size(); j++ ) values[ j ] = static_cast<float>( j ) * 0.5f;
+
+  boost::filesystem::path filename = directory_ / "data.raw";
+  {
+    std::ofstream file( filename.string().c_str(), std::ios::binary );
+    std::vector<char> header( offset, 'h' );
+    file.write( &header[ 0 ], header.size() );
+    file.write( reinterpret_cast<const char*>( &values[ 0 ] ), values.size() * sizeof( float ) );
+  }
+
+  std::string error;
+  DataBlockHandle data_block = MappedDataBlock::New( filename, offset, nx, ny, nz, 
+    DataType::FLOAT_E, false, error );
+  ASSERT_TRUE( data_block ) << error;
+  ASSERT_EQ( data_block->get_size(), values.size() );
+
+  const float* data = static_cast<const float*>( data_block->get_const_data() );
+  for ( size_t j = 0; j < values.size(); j++ ) ASSERT_EQ( data[ j ], values[ j ] );
+
+  // Changes to the data should not reach the file
+  data_block->set_data_at( 0, 42.0 );
+  ASSERT_EQ( data_block->get_data_at( 0 ), 42.0 );
+  data_block.reset();
+
+  std::ifstream file( filename.string().c_str(), std::ios::binary );
+  file.seekg( offset );
+  float first_value = -1.0f;
+  file.read( reinterpret_cast<char*>( &first_value ), sizeof( float ) );
+  ASSERT_EQ( first_value, values[ 0 ] );
+}
+
+TEST_F(MappedDataBlockTest, MapFileTooSmall)
+{
+  boost::filesystem::path filename = directory_ / "small.raw";
+  {
+    std::ofstream file( filename.string().c_str(), std::ios::binary );
+    file << "too small";
+  }
+
+  std::string error;
+  DataBlockHandle data_block = MappedDataBlock::New( filename, 0, 10, 10, 10, 
+    DataType::INT_E, false, error );
+  ASSERT_FALSE( data_block );
+  ASSERT_FALSE( error.empty() );
+}
+
+TEST_F(MappedDataBlockTest, ScratchFileIsRemoved)
+{
+  std::string error;
+  DataBlockHandle data_block = MappedDataBlock::NewScratch( directory_, 16, 16, 16, 
+    DataType::USHORT_E, error );
+  ASSERT_TRUE( data_block ) << error;
+
+  boost::filesystem::path filename = 
+    boost::dynamic_pointer_cast<MappedDataBlock>( data_block )->get_filename();
+  ASSERT_TRUE( boost::filesystem::exists( filename ) );
+
+  data_block->set_data_at( 16 * 16 * 16 - 1, 1234.0 );
+  ASSERT_EQ( data_block->get_data_at( 16 * 16 * 16 - 1 ), 1234.0 );
+
+  // Duplicates get a scratch file of their own and stay valid once the scratch file is gone
+  DataBlockHandle copy;
+  ASSERT_TRUE( DataBlock::Duplicate( data_block, copy ) );
+  MappedDataBlockHandle mapped_copy = boost::dynamic_pointer_cast<MappedDataBlock>( copy );
+  ASSERT_TRUE( mapped_copy );
+  ASSERT_TRUE( mapped_copy->is_scratch() );
+  ASSERT_EQ( mapped_copy->get_filename().parent_path(), directory_ );
+  ASSERT_NE( mapped_copy->get_filename(), filename );
+
+  data_block.reset();
+  ASSERT_FALSE( boost::filesystem::exists( filename ) );
+  ASSERT_EQ( copy->get_data_at( 16 * 16 * 16 - 1 ), 1234.0 );
+
+  boost::filesystem::path copy_filename = mapped_copy->get_filename();
+  mapped_copy.reset();
+  copy.reset();
+  ASSERT_FALSE( boost::filesystem::exists( copy_filename ) );
+}
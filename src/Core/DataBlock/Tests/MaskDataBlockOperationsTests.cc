@@ -0,0 +1,240 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+ 
+ The MIT License
+ 
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+ 
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+*/
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include <boost/bind.hpp>
+
+#include <Core/DataBlock/MaskDataBlockManager.h>
+#include <Core/DataBlock/MaskDataBlockOperations.h>
+
+using namespace Core;
+
+static void RecordProgress( std::vector< double >* progress, double amount )
+{
+  progress->push_back( amount );
+}
+
+static bool AbortAfter( size_t* num_checks, size_t max_checks )
+{
+  return ++( *num_checks ) > max_checks;
+}
+
+class MaskDataBlockOperationsTest : public ::testing::Test {
+protected:
+  virtual void SetUp()
+  {
+    // Odd dimensions, so the voxels that do not fill a whole word are tested as well
+    GridTransform grid( 13, 11, 9 );
+    ASSERT_TRUE( MaskDataBlockManager::Instance()->create( grid, mask1_ ) );
+    ASSERT_TRUE( MaskDataBlockManager::Instance()->create( grid, mask2_ ) );
+    ASSERT_TRUE( MaskDataBlockManager::Instance()->create( grid, result_ ) );
+
+    for ( size_t z = 0; z < 9; z++ )
+    {
+      for ( size_t y = 0; y < 11; y++ )
+      {
+        for ( size_t x = 0; x < 13; x++ )
+        {
+          if ( x >= 3 && x < 8 && y >= 2 && y < 7 && z >= 2 && z < 6 ) 
+          {
+            mask1_->set_mask_at( x, y, z );
+          }
+          if ( ( x + y + z ) % 3 == 0 ) mask2_->set_mask_at( x, y, z );
+        }
+      }
+    }
+  }
+
+  virtual void TearDown()
+  {
+    mask1_.reset();
+    mask2_.reset();
+    result_.reset();
+    MaskDataBlockManager::Instance()->clear();
+  }
+
+  MaskDataBlockHandle mask1_;
+  MaskDataBlockHandle mask2_;
+  MaskDataBlockHandle result_;
+};
+
+TEST_F(MaskDataBlockOperationsTest, LogicalOperations)
+{
+  ASSERT_TRUE( MaskDataBlockOperations::And( mask1_, mask2_, result_ ) );
+  for ( size_t j = 0; j < result_->get_size(); j++ )
+  {
+    ASSERT_EQ( result_->get_mask_at( j ), mask1_->get_mask_at( j ) && mask2_->get_mask_at( j ) );
+  }
+
+  ASSERT_TRUE( MaskDataBlockOperations::Or( mask1_, mask2_, result_ ) );
+  for ( size_t j = 0; j < result_->get_size(); j++ )
+  {
+    ASSERT_EQ( result_->get_mask_at( j ), mask1_->get_mask_at( j ) || mask2_->get_mask_at( j ) );
+  }
+
+  ASSERT_TRUE( MaskDataBlockOperations::Xor( mask1_, mask2_, result_ ) );
+  for ( size_t j = 0; j < result_->get_size(); j++ )
+  {
+    ASSERT_EQ( result_->get_mask_at( j ), mask1_->get_mask_at( j ) != mask2_->get_mask_at( j ) );
+  }
+
+  ASSERT_TRUE( MaskDataBlockOperations::Remove( mask1_, mask2_, result_ ) );
+  for ( size_t j = 0; j < result_->get_size(); j++ )
+  {
+    ASSERT_EQ( result_->get_mask_at( j ), mask1_->get_mask_at( j ) && !mask2_->get_mask_at( j ) );
+  }
+
+  ASSERT_TRUE( MaskDataBlockOperations::Invert( mask1_, result_ ) );
+  for ( size_t j = 0; j < result_->get_size(); j++ )
+  {
+    ASSERT_EQ( result_->get_mask_at( j ), !mask1_->get_mask_at( j ) );
+  }
+}
+
+TEST_F(MaskDataBlockOperationsTest, LogicalProgressAndAbort)
+{
+  // Progress is reported per slab and ends at 1
+  std::vector< double > progress;
+  ASSERT_TRUE( MaskDataBlockOperations::And( mask1_, mask2_, result_, 
+    boost::bind( &RecordProgress, &progress, _1 ) ) );
+  ASSERT_EQ( progress.size(), size_t( 9 ) );
+  ASSERT_EQ( progress.back(), 1.0 );
+
+  // An abort stops the operation at the next slab
+  size_t num_checks = 0;
+  ASSERT_FALSE( MaskDataBlockOperations::Invert( mask1_, result_, 
+    MaskDataBlockOperations::progress_type(), boost::bind( &AbortAfter, &num_checks, 3 ) ) );
+  ASSERT_EQ( num_checks, size_t( 4 ) );
+
+  // Masks of a different size are refused
+  MaskDataBlockHandle other;
+  ASSERT_TRUE( MaskDataBlockManager::Instance()->create( GridTransform( 13, 11, 8 ), other ) );
+  ASSERT_FALSE( MaskDataBlockOperations::Or( mask1_, mask2_, other ) );
+}
+
+TEST_F(MaskDataBlockOperationsTest, Count)
+{
+  EXPECT_EQ( MaskDataBlockOperations::Count( mask1_ ), 5u * 5u * 4u );
+  EXPECT_EQ( MaskDataBlockOperations::Count( result_ ), 0u );
+}
+
+TEST_F(MaskDataBlockOperationsTest, DilateErode)
+{
+  ASSERT_TRUE( MaskDataBlockOperations::Dilate( mask1_, result_, 1 ) );
+  // The box grows by one voxel along each face, but not along the edges
+  EXPECT_EQ( MaskDataBlockOperations::Count( result_ ), 
+    5u * 5u * 4u + 2u * ( 5u * 5u + 5u * 4u + 5u * 4u ) );
+  EXPECT_TRUE( result_->get_mask_at( 2, 4, 4 ) );
+  EXPECT_FALSE( result_->get_mask_at( 2, 1, 4 ) );
+
+  MaskDataBlockHandle eroded;
+  ASSERT_TRUE( MaskDataBlockManager::Instance()->create( GridTransform( 13, 11, 9 ), eroded ) );
+  ASSERT_TRUE( MaskDataBlockOperations::Erode( result_, eroded, 1 ) );
+  for ( size_t j = 0; j < eroded->get_size(); j++ )
+  {
+    ASSERT_EQ( eroded->get_mask_at( j ), mask1_->get_mask_at( j ) );
+  }
+
+  // Voxels outside the constraint mask are not added
+  ASSERT_TRUE( MaskDataBlockOperations::Dilate( mask1_, result_, 2, false, 
+    SliceType::AXIAL_E, mask2_ ) );
+  for ( size_t j = 0; j < result_->get_size(); j++ )
+  {
+    if ( !mask1_->get_mask_at( j ) && !mask2_->get_mask_at( j ) )
+    {
+      ASSERT_FALSE( result_->get_mask_at( j ) );
+    }
+  }
+
+  // A 2D dilation does not grow across slices
+  ASSERT_TRUE( MaskDataBlockOperations::Dilate( mask1_, result_, 2, true, SliceType::AXIAL_E ) );
+  EXPECT_FALSE( result_->get_mask_at( 5, 4, 1 ) );
+  EXPECT_TRUE( result_->get_mask_at( 5, 8, 3 ) );
+}
+
+TEST_F(MaskDataBlockOperationsTest, FloodFillAndFillHoles)
+{
+  // Carve a closed cavity into the box
+  mask1_->clear_mask_at( 5, 4, 3 );
+  mask1_->clear_mask_at( 5, 4, 4 );
+  
+  MaskDataBlockOperations::seed_list_type seeds;
+  seeds.push_back( static_cast< MaskDataBlock::index_type >( mask1_->to_index( 0, 0, 0 ) ) );
+  ASSERT_TRUE( MaskDataBlockOperations::FloodFill( mask1_, false, seeds, result_ ) );
+  EXPECT_FALSE( result_->get_mask_at( 5, 4, 3 ) );
+  EXPECT_FALSE( result_->get_mask_at( 4, 4, 4 ) );
+  EXPECT_TRUE( result_->get_mask_at( 12, 10, 8 ) );
+  EXPECT_EQ( MaskDataBlockOperations::Count( result_ ), 13u * 11u * 9u - 5u * 5u * 4u );
+
+  ASSERT_TRUE( MaskDataBlockOperations::FillHoles( mask1_, 
+    MaskDataBlockOperations::seed_list_type(), result_ ) );
+  EXPECT_TRUE( result_->get_mask_at( 5, 4, 3 ) );
+  EXPECT_TRUE( result_->get_mask_at( 5, 4, 4 ) );
+  EXPECT_EQ( MaskDataBlockOperations::Count( result_ ), 5u * 5u * 4u );
+
+  // A seed inside the cavity keeps it open
+  seeds[ 0 ] = static_cast< MaskDataBlock::index_type >( mask1_->to_index( 5, 4, 3 ) );
+  ASSERT_TRUE( MaskDataBlockOperations::FillHoles( mask1_, seeds, result_ ) );
+  EXPECT_FALSE( result_->get_mask_at( 5, 4, 4 ) );
+  EXPECT_EQ( MaskDataBlockOperations::Count( result_ ), 5u * 5u * 4u - 2u );
+}
+
+TEST(MaskDataBlockOperationsSparseTest, SparseSource)
+{
+  GridTransform grid( 64, 64, 32 );
+  MaskDataBlockHandle src, dst;
+  ASSERT_TRUE( MaskDataBlockManager::Instance()->create( grid, src ) );
+  ASSERT_TRUE( MaskDataBlockManager::Instance()->create( grid, dst ) );
+  ASSERT_EQ( src->get_data_block(), dst->get_data_block() );
+  src->set_mask_at( 10, 20, 5 );
+  src->set_mask_at( 11, 20, 5 );
+
+  // The source gives up its bit, so moving it back into a bitplane picks the data block of
+  // the destination, which the operation locks
+  ASSERT_TRUE( src->sparsify() );
+  ASSERT_TRUE( MaskDataBlockOperations::Invert( src, dst ) );
+  ASSERT_FALSE( src->is_sparse() );
+  ASSERT_EQ( src->get_data_block(), dst->get_data_block() );
+  ASSERT_FALSE( dst->get_mask_at( 10, 20, 5 ) );
+  ASSERT_FALSE( dst->get_mask_at( 11, 20, 5 ) );
+  ASSERT_TRUE( dst->get_mask_at( 12, 20, 5 ) );
+
+  ASSERT_TRUE( src->sparsify() );
+  MaskDataBlockHandle copy;
+  ASSERT_TRUE( MaskDataBlockManager::Duplicate( src, grid, copy ) );
+  ASSERT_TRUE( copy->get_mask_at( 10, 20, 5 ) );
+  ASSERT_FALSE( copy->get_mask_at( 12, 20, 5 ) );
+
+  src.reset();
+  dst.reset();
+  copy.reset();
+  MaskDataBlockManager::Instance()->clear();
+}
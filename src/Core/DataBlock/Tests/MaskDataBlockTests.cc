@@ -0,0 +1,116 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+ 
+ The MIT License
+ 
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+ 
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+*/
+
+#include <gtest/gtest.h>
+
+#include <Core/DataBlock/MaskDataBlockManager.h>
+#include <Core/DataBlock/StdDataBlock.h>
+
+using namespace Core;
+
+TEST(MaskDataBlockTest, DirtyRegions)
+{
+  GridTransform grid( 32, 16, 8 );
+  MaskDataBlockHandle mask;
+  ASSERT_TRUE( MaskDataBlockManager::Instance()->create( grid, mask ) );
+  size_t edit_count = mask->get_edit_count();
+
+  IndexVector min, max;
+  ASSERT_TRUE( mask->get_dirty_region( edit_count, min, max ) );
+  ASSERT_GT( min.x(), max.x() );
+
+  mask->set_mask_at( 3, 4, 5 );
+  mask->increase_generation( IndexVector( 3, 4, 5 ), IndexVector( 3, 4, 5 ) );
+  mask->set_mask_at( 10, 2, 6 );
+  mask->increase_generation( IndexVector( 10, 1, 6 ), IndexVector( 12, 2, 6 ) );
+  ASSERT_EQ( mask->get_edit_count(), edit_count + 2 );
+
+  // The changes are combined into one bounding box
+  ASSERT_TRUE( mask->get_dirty_region( edit_count, min, max ) );
+  ASSERT_EQ( min, IndexVector( 3, 1, 5 ) );
+  ASSERT_EQ( max, IndexVector( 12, 4, 6 ) );
+
+  // Only the changes after the given edit count are included
+  ASSERT_TRUE( mask->get_dirty_region( edit_count + 1, min, max ) );
+  ASSERT_EQ( min, IndexVector( 10, 1, 6 ) );
+  ASSERT_EQ( max, IndexVector( 12, 2, 6 ) );
+
+  // A change of the whole mask makes earlier edit counts unusable
+  mask->increase_generation();
+  ASSERT_FALSE( mask->get_dirty_region( edit_count + 2, min, max ) );
+  ASSERT_TRUE( mask->get_dirty_region( edit_count + 3, min, max ) );
+  ASSERT_GT( min.x(), max.x() );
+
+  mask.reset();
+  MaskDataBlockManager::Instance()->clear();
+}
+
+TEST(MaskDataBlockTest, DuplicateWhileEditing)
+{
+  GridTransform grid( 16, 8, 4 );
+  MaskDataBlockHandle mask;
+  ASSERT_TRUE( MaskDataBlockManager::Instance()->create( grid, mask ) );
+  mask->set_mask_at( 1, 2, 3 );
+
+  // The masks write through a pointer to the memory, so a duplicate gets its own copy
+  DataBlockHandle data_block = mask->get_data_block();
+  ASSERT_FALSE( StdDataBlock::NewShared( data_block ) );
+  DataBlockHandle copy;
+  ASSERT_TRUE( DataBlock::Duplicate( data_block, copy ) );
+  ASSERT_FALSE( data_block->is_shared() );
+  ASSERT_NE( copy->get_const_data(), data_block->get_const_data() );
+
+  // Edits to the mask, and a new mask in the same data block, do not affect the copy
+  mask->set_mask_at( 4, 5, 2 );
+  MaskDataBlockHandle other;
+  ASSERT_TRUE( MaskDataBlockManager::Instance()->create( grid, other ) );
+  ASSERT_EQ( other->get_data_block(), data_block );
+  other->set_mask_at( 0, 0, 0 );
+  mask->set_mask_at( 7, 7, 1 );
+
+  const unsigned char* copy_data = 
+    reinterpret_cast< const unsigned char* >( copy->get_const_data() );
+  unsigned char mask_value = mask->get_mask_value();
+  ASSERT_TRUE( ( copy_data[ copy->to_index( 1, 2, 3 ) ] & mask_value ) != 0 );
+  ASSERT_FALSE( ( copy_data[ copy->to_index( 4, 5, 2 ) ] & mask_value ) != 0 );
+  ASSERT_FALSE( ( copy_data[ copy->to_index( 7, 7, 1 ) ] & mask_value ) != 0 );
+  ASSERT_FALSE( ( copy_data[ 0 ] & mask_value ) != 0 );
+
+  // The mask still writes into its own data block
+  const unsigned char* data = 
+    reinterpret_cast< const unsigned char* >( data_block->get_const_data() );
+  ASSERT_TRUE( ( data[ data_block->to_index( 7, 7, 1 ) ] & mask_value ) != 0 );
+  ASSERT_TRUE( ( data[ 0 ] & other->get_mask_value() ) != 0 );
+  ASSERT_TRUE( mask->get_mask_at( 4, 5, 2 ) );
+  ASSERT_TRUE( other->get_mask_at( 0, 0, 0 ) );
+
+  copy.reset();
+  mask.reset();
+  other.reset();
+  MaskDataBlockManager::Instance()->clear();
+}
@@ -0,0 +1,110 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+#include <gtest/gtest.h>
+
+#include <Core/DataBlock/MaskDataBlockManager.h>
+#include <Core/DataBlock/MaskDataDelta.h>
+
+using namespace Core;
+
+class MaskDataDeltaTest : public ::testing::Test {
+protected:
+  virtual void SetUp()
+  {
+    GridTransform grid( 13, 11, 9 );
+    ASSERT_TRUE( MaskDataBlockManager::Instance()->create( grid, mask_ ) );
+    for ( size_t j = 0; j < mask_->get_size(); j++ )
+    {
+      if ( j % 5 == 0 ) mask_->set_mask_at( j );
+    }
+  }
+
+  virtual void TearDown()
+  {
+    mask_.reset();
+    MaskDataBlockManager::Instance()->clear();
+  }
+
+  MaskDataBlockHandle mask_;
+};
+
+TEST_F(MaskDataDeltaTest, RevertAndRedo)
+{
+  std::vector< bool > before( mask_->get_size() );
+  for ( size_t j = 0; j < before.size(); j++ ) before[ j ] = mask_->get_mask_at( j );
+
+  MaskDataSliceHandle slice;
+  ASSERT_TRUE( mask_->extract_slice( SliceType::CORONAL_E, 4, slice ) );
+
+  // Paint a few voxels in the slice
+  mask_->set_mask_at( 2, 4, 3 );
+  mask_->set_mask_at( 3, 4, 3 );
+  mask_->set_mask_at( 6, 4, 5 );
+  mask_->clear_mask_at( 0, 4, 3 );
+  size_t num_changed = 0;
+  std::vector< bool > after( mask_->get_size() );
+  for ( size_t j = 0; j < after.size(); j++ ) 
+  {
+    after[ j ] = mask_->get_mask_at( j );
+    if ( after[ j ] != before[ j ] ) num_changed++;
+  }
+  ASSERT_GT( num_changed, 0u );
+
+  MaskDataDeltaHandle delta = MaskDataDelta::Create( slice, mask_ );
+  ASSERT_TRUE( delta );
+  EXPECT_FALSE( delta->is_empty() );
+  EXPECT_EQ( delta->get_num_changed(), num_changed );
+  // Only the bounding box of the changes is kept
+  EXPECT_LT( delta->get_byte_size(), sizeof( MaskDataDelta ) + 8u );
+
+  size_t edit_count = mask_->get_edit_count();
+  ASSERT_TRUE( delta->apply( mask_ ) );
+  EXPECT_GT( mask_->get_edit_count(), edit_count );
+  for ( size_t j = 0; j < before.size(); j++ ) ASSERT_EQ( mask_->get_mask_at( j ), before[ j ] );
+
+  ASSERT_TRUE( delta->apply( mask_ ) );
+  for ( size_t j = 0; j < after.size(); j++ ) ASSERT_EQ( mask_->get_mask_at( j ), after[ j ] );
+}
+
+TEST_F(MaskDataDeltaTest, NoChange)
+{
+  MaskDataSliceHandle slice;
+  ASSERT_TRUE( mask_->extract_slice( SliceType::AXIAL_E, 8, slice ) );
+  mask_->set_mask_at( 1, 1, 1 );
+
+  MaskDataDeltaHandle delta = MaskDataDelta::Create( slice, mask_ );
+  ASSERT_TRUE( delta );
+  EXPECT_TRUE( delta->is_empty() );
+  EXPECT_TRUE( delta->apply( mask_ ) );
+  EXPECT_TRUE( mask_->get_mask_at( 1, 1, 1 ) );
+
+  MaskDataBlockHandle other;
+  ASSERT_TRUE( MaskDataBlockManager::Instance()->create( GridTransform( 4, 4, 4 ), other ) );
+  EXPECT_FALSE( delta->apply( other ) );
+}
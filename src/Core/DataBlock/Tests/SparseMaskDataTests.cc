@@ -0,0 +1,166 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+ 
+ The MIT License
+ 
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+ 
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+*/
+
+#include <gtest/gtest.h>
+
+#include <Core/DataBlock/MaskDataBlockManager.h>
+#include <Core/DataBlock/SparseMaskData.h>
+
+using namespace Core;
+
+class SparseMaskDataTest : public ::testing::Test {
+protected:
+  virtual void SetUp()
+  {
+    // Dimensions that are not a multiple of the brick size, so partial bricks are tested
+    nx_ = 37;
+    ny_ = 23;
+    nz_ = 19;
+    data_.resize( nx_ * ny_ * nz_, 0 );
+    for ( size_t z = 0; z < nz_; z++ )
+    {
+      for ( size_t y = 0; y < ny_; y++ )
+      {
+        for ( size_t x = 0; x < nx_; x++ )
+        {
+          double dx = x - 20.0, dy = y - 11.0, dz = z - 9.0;
+          size_t index = x + nx_ * ( y + ny_ * z );
+          if ( dx * dx + dy * dy + dz * dz < 64.0 ) data_[ index ] |= 4;
+          if ( ( x + y + z ) % 5 == 0 ) data_[ index ] |= 1;
+        }
+      }
+    }
+  }
+
+  size_t nx_, ny_, nz_;
+  std::vector< unsigned char > data_;
+};
+
+TEST_F(SparseMaskDataTest, CompressDecompress)
+{
+  SparseMaskDataHandle sparse = SparseMaskData::Compress( &data_[ 0 ], 4, nx_, ny_, nz_ );
+
+  size_t count = 0;
+  for ( size_t j = 0; j < data_.size(); j++ )
+  {
+    bool value = ( data_[ j ] & 4 ) != 0;
+    if ( value ) count++;
+    ASSERT_EQ( sparse->get_mask_at( j ), value );
+  }
+  ASSERT_EQ( sparse->count(), count );
+  // The ball does not touch the bricks in the corners
+  ASSERT_LT( sparse->get_num_stored_bricks(), size_t( 3 * 2 * 2 ) );
+
+  // Decompressing only touches the bitplane of the mask
+  std::vector< unsigned char > result( data_.size(), 0xfb );
+  sparse->decompress( &result[ 0 ], 4 );
+  for ( size_t j = 0; j < data_.size(); j++ )
+  {
+    ASSERT_EQ( result[ j ], ( data_[ j ] & 4 ) | 0xfb );
+  }
+}
+
+TEST_F(SparseMaskDataTest, CopySlice)
+{
+  SparseMaskDataHandle sparse = SparseMaskData::Compress( &data_[ 0 ], 4, nx_, ny_, nz_ );
+
+  // Axial slice
+  std::vector< unsigned char > slice( nx_ * ny_ );
+  sparse->copy_slice( 9 * nx_ * ny_, 1, nx_, nx_, ny_, &slice[ 0 ], 1 );
+  for ( size_t y = 0; y < ny_; y++ )
+  {
+    for ( size_t x = 0; x < nx_; x++ )
+    {
+      ASSERT_EQ( slice[ x + y * nx_ ], ( data_[ x + nx_ * ( y + ny_ * 9 ) ] & 4 ) ? 1 : 0 );
+    }
+  }
+
+  // Sagittal slice that runs backwards through y
+  slice.resize( ny_ * nz_ );
+  sparse->copy_slice( 20 + nx_ * ( ny_ - 1 ), -static_cast< std::ptrdiff_t >( nx_ ), 
+    nx_ * ny_, ny_, nz_, &slice[ 0 ], 1 );
+  for ( size_t z = 0; z < nz_; z++ )
+  {
+    for ( size_t y = 0; y < ny_; y++ )
+    {
+      ASSERT_EQ( slice[ y + z * ny_ ], 
+        ( data_[ 20 + nx_ * ( ( ny_ - 1 - y ) + ny_ * z ) ] & 4 ) ? 1 : 0 );
+    }
+  }
+}
+
+TEST(SparseMaskDataBlockTest, SparsifyDensify)
+{
+  GridTransform grid( 64, 64, 32 );
+  MaskDataBlockHandle mask, other;
+  ASSERT_TRUE( MaskDataBlockManager::Instance()->create( grid, mask ) );
+  ASSERT_TRUE( MaskDataBlockManager::Instance()->create( grid, other ) );
+  ASSERT_EQ( mask->get_data_block(), other->get_data_block() );
+
+  for ( size_t z = 10; z < 14; z++ )
+  {
+    for ( size_t y = 20; y < 30; y++ )
+    {
+      for ( size_t x = 5; x < 12; x++ ) mask->set_mask_at( x, y, z );
+    }
+  }
+  other->set_mask_at( 1, 1, 1 );
+
+  DataBlockHandle data_block;
+  unsigned char mask_value = 0;
+  ASSERT_TRUE( mask->get_bitplane( data_block, mask_value ) );
+  ASSERT_EQ( data_block, other->get_data_block() );
+
+  ASSERT_TRUE( mask->sparsify() );
+  ASSERT_TRUE( mask->is_sparse() );
+  // Looking at the bitplane does not move the mask back
+  ASSERT_FALSE( mask->get_bitplane( data_block, mask_value ) );
+  ASSERT_TRUE( mask->is_sparse() );
+  ASSERT_LT( mask->get_byte_size(), mask->get_size() >> 4 );
+  ASSERT_TRUE( mask->get_mask_at( 5, 20, 10 ) );
+  ASSERT_FALSE( mask->get_mask_at( 4, 20, 10 ) );
+  ASSERT_TRUE( other->get_mask_at( 1, 1, 1 ) );
+
+  // Writing moves the mask back into a bitplane without losing the data
+  mask->set_mask_at( 0, 0, 0 );
+  ASSERT_FALSE( mask->is_sparse() );
+  ASSERT_TRUE( mask->get_mask_at( 0, 0, 0 ) );
+  ASSERT_TRUE( mask->get_mask_at( 11, 29, 13 ) );
+  ASSERT_FALSE( mask->get_mask_at( 12, 29, 13 ) );
+  ASSERT_TRUE( other->get_mask_at( 1, 1, 1 ) );
+
+  // Compacting moves both masks out, which releases the datablock
+  ASSERT_TRUE( MaskDataBlockManager::Instance()->compact() );
+  ASSERT_TRUE( mask->is_sparse() );
+  ASSERT_TRUE( other->is_sparse() );
+  ASSERT_TRUE( other->get_mask_at( 1, 1, 1 ) );
+
+  mask.reset();
+  other.reset();
+  MaskDataBlockManager::Instance()->clear();
+}
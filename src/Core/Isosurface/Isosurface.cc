@@ -27,15 +27,20 @@
 */
 
 // STL includes
+#include <cmath>
 #include <fstream>
+#include <limits>
 
 // Boost includes
 #include <boost/array.hpp>
+#include <boost/unordered_map.hpp>
  
 // Core includes
 #include <Core/DataBlock/StdDataBlock.h>
 #include <Core/Isosurface/Isosurface.h>
+#include <Core/Isosurface/IsosurfaceDecimator.h>
 #include <Core/Isosurface/IsosurfaceExporter.h>
+#include <Core/Math/MathFunctions.h>
 #include <Core/Utils/StackVector.h>
 #include <Core/Utils/Parallel.h>
 #include <Core/Utils/Log.h>
@@ -345,6 +350,78 @@ const CappingTableType CAPPING_TABLE_C[] = {
   {{7, 4, 3, 3, 4, 2, 4, 1, 2, -1, -1, -1}, 3},     // 14
   {{0, 1, 3, 3, 1, 2, -1, -1, -1, -1, -1, -1}, 2}};   // 15
 
+// GET_CUBE_TYPE:
+// Type of the (marching) cube with its first node at index in the back plane.
+static unsigned char GetCubeType( const unsigned char* back_data, const unsigned char* data, 
+  size_t index, size_t nx, unsigned char mask_value )
+{
+  unsigned char type = 0;
+  if ( back_data[ index ] & mask_value )            type |= 0x1;
+  if ( back_data[ index + 1 ] & mask_value )        type |= 0x2;
+  if ( back_data[ index + nx + 1 ] & mask_value )   type |= 0x4;
+  if ( back_data[ index + nx ] & mask_value )       type |= 0x8;
+  if ( data[ index ] & mask_value )                 type |= 0x10;
+  if ( data[ index + 1 ] & mask_value )             type |= 0x20;
+  if ( data[ index + nx + 1 ] & mask_value )        type |= 0x40;
+  if ( data[ index + nx ] & mask_value )            type |= 0x80;
+  return type;
+}
+
+// The edges of the (marching) cube that correspond to the cap edges 4 and 7 of a cap cell, 
+// which meet at node 0 of the cell, for each of the 6 caps (see translate_cap_coords)
+const int CAP_CORNER_EDGES_C[ 6 ][ 2 ] = { { 0, 3 }, { 0, 8 }, { 3, 8 }, { 4, 7 }, { 2, 10 }, 
+  { 1, 9 } };
+
+// GET_CAP_TRIANGLES:
+// Look up the triangles of a cell of cap cap_num and store the indices of their points in 
+// triangles. points holds the indices of the 4 nodes and 4 edge points of the cell in the order 
+// of CAPPING_TABLE_C, only the entries of nodes that are on and of split edges are used. 
+// cube_type is the type of the (marching) cube on the inside of the cell, the two diagonal 
+// nodes of an ambiguous cell are only joined if the cube joins them too, so the cap closes the 
+// surface of the cube. The triangles face out of the volume. Returns the number of triangles.
+static int GetCapTriangles( int cap_num, unsigned char cell_type, unsigned char cube_type, 
+  const unsigned int* points, unsigned int* triangles )
+{
+  if ( cell_type == 0x5 || cell_type == 0xA )
+  {
+    // Check whether the surface of the cube cuts off node 0 of the cell
+    const MarchingCubesTableType& table = MARCHING_CUBES_TABLE_C[ cube_type ];
+    bool corner_cut = false;
+    for ( int k = 0; k < table.num_triangles_ && !corner_cut; k++ )
+    {
+      int num_corner_edges = 0;
+      for ( int e = 0; e < 3; e++ )
+      {
+        int edge = table.edges_[ 3 * k + e ];
+        if ( edge == CAP_CORNER_EDGES_C[ cap_num ][ 0 ] || 
+          edge == CAP_CORNER_EDGES_C[ cap_num ][ 1 ] ) num_corner_edges++;
+      }
+      corner_cut = ( num_corner_edges == 2 );
+    }
+
+    // Separate the on nodes into two corners
+    if ( corner_cut == ( cell_type == 0x5 ) )
+    {
+      int num_triangles = GetCapTriangles( cap_num, cell_type & 0x3, cube_type, points, 
+        triangles );
+      return num_triangles + GetCapTriangles( cap_num, cell_type & 0xC, cube_type, points,
+        triangles + 3 * num_triangles );
+    }
+  }
+
+  // The table triangles are counterclockwise in the (i, j) plane of the cap, their normal 
+  // i x j only points out of the volume for caps 1, 3, and 5
+  bool flip = ( cap_num == 0 || cap_num == 2 || cap_num == 4 );
+  const CappingTableType& tesselation = CAPPING_TABLE_C[ cell_type ];
+  for ( int k = 0; k < tesselation.num_triangles_; k++ )
+  {
+    triangles[ 3 * k ] = points[ tesselation.points_[ 3 * k ] ];
+    triangles[ 3 * k + 1 ] = points[ tesselation.points_[ 3 * k + ( flip ? 2 : 1 ) ] ];
+    triangles[ 3 * k + 2 ] = points[ tesselation.points_[ 3 * k + ( flip ? 1 : 2 ) ] ];
+  }
+  return tesselation.num_triangles_;
+}
+
 class VertexBufferBatch
 {
 public:
@@ -357,13 +434,83 @@ public:
 typedef boost::shared_ptr< VertexBufferBatch > VertexBufferBatchHandle;
 
 #if defined (_WIN32) || defined(__APPLE__)
-const std::string Isosurface::EXPORT_FORMATS_C( "VTK (*.vtk);;ASCII (*.fac *.pts *.val);;ASCII STL (*.stl);;Binary STL (*.stl)" );
+const std::string Isosurface::EXPORT_FORMATS_C( "VTK (*.vtk);;Binary VTK (*.vtk);;VTK XML (*.vtp);;Binary PLY (*.ply);;OBJ (*.obj);;ASCII (*.fac *.pts *.val);;ASCII STL (*.stl);;Binary STL (*.stl)" );
 #else
-const std::string Isosurface::EXPORT_FORMATS_C( "VTK (*.vtk);;ASCII (*.fac *.pts *.val);;ASCII STL (*.stl);;Binary STL (*.stl *)" );
+const std::string Isosurface::EXPORT_FORMATS_C( "VTK (*.vtk);;Binary VTK (*.vtk *);;VTK XML (*.vtp);;Binary PLY (*.ply);;OBJ (*.obj);;ASCII (*.fac *.pts *.val);;ASCII STL (*.stl);;Binary STL (*.stl *)" );
 #endif
 
-// Binary STL handled as special case in LayerIOFunctions::ExportIsosurface
-const FilterMap Isosurface::EXPORT_FORMATS_MAP_C = { { "VTK (*.vtk)", ".vtk" }, { "ASCII (*.fac *.pts *.val)", ".fac" }, { "ASCII STL (*.stl)", ".stl" } };
+// Binary STL and binary VTK handled as special cases in LayerIOFunctions::ExportIsosurface
+const FilterMap Isosurface::EXPORT_FORMATS_MAP_C = { { "VTK (*.vtk)", ".vtk" }, { "VTK XML (*.vtp)", ".vtp" }, { "Binary PLY (*.ply)", ".ply" }, { "OBJ (*.obj)", ".obj" }, { "ASCII (*.fac *.pts *.val)", ".fac" }, { "ASCII STL (*.stl)", ".stl" } };
+
+// CLASS ISOSURFACEBLOCKMESH:
+// Decimated mesh of one spatial block for one level of detail. The points on the boundary of 
+// the block are not moved by the decimation, so the blocks still fit together.
+class IsosurfaceBlockMesh
+{
+public:
+  PointFVector points_;
+  VectorFVector normals_;
+  UIntVector faces_;
+  std::vector< std::pair< unsigned int, size_t > > shared_points_;
+};
+
+// CLASS ISOSURFACEBLOCK:
+// Marching cubes mesh of one spatial block of the mask. The blocks are kept between 
+// computations, so that only the blocks in which the mask changed need to be recomputed.
+class IsosurfaceBlock
+{
+public:
+  IsosurfaceBlock() : area_( 0.0f ) {}
+
+  void clear()
+  {
+    this->points_.clear();
+    this->normals_.clear();
+    this->faces_.clear();
+    this->shared_points_.clear();
+    this->area_ = 0.0f;
+    this->levels_.clear();
+  }
+
+  PointFVector points_;
+  // Normals are not normalized, so the contributions of neighboring blocks to points on the
+  // boundary can be added when the blocks are stitched together
+  VectorFVector normals_;
+  // Indices into points_, 3 per face
+  UIntVector faces_; 
+  // Points on the boundary of the block, which are shared with neighboring blocks. Each
+  // entry stores the index into points_ and a key that uniquely identifies the edge of the 
+  // mask the point is on.
+  std::vector< std::pair< unsigned int, size_t > > shared_points_;
+  float area_;
+
+  // Decimated meshes of the levels of detail, empty if the block has not been decimated since
+  // it was computed. Level 0 is left empty if the isosurface itself is not decimated.
+  std::vector< IsosurfaceBlockMesh > levels_;
+};
+
+// CLASS ISOSURFACELEVEL:
+// One level of detail of the isosurface and the buffers used to render it. The mesh of level 0
+// is stored in IsosurfacePrivate, the coarser levels store their own decimated mesh.
+class IsosurfaceLevel
+{
+public:
+  IsosurfaceLevel() : vbo_available_( false ), surface_changed_( false ) {}
+
+  PointFVector points_;
+  VectorFVector normals_;
+  UIntVector faces_;
+
+  std::vector< std::pair< unsigned int, unsigned int > > part_points_;
+  std::vector< std::pair< unsigned int, unsigned int > > part_faces_;
+  std::vector< UIntVector > part_indices_;
+
+  std::vector< VertexBufferBatchHandle > vbo_batches_;
+  bool vbo_available_;
+  bool surface_changed_;
+};
+
+typedef boost::shared_ptr< IsosurfaceLevel > IsosurfaceLevelHandle;
 
 class IsosurfacePrivate 
 {
@@ -374,7 +521,7 @@ public:
   // PARALLEL_DOWNSAMPLE:
   // Downsample mask prior to computing the isosurface in order to reduce the mesh to speed up
   // rendering.
-  void parallel_downsample_mask( int thread, int num_threads, boost::barrier& barrier, 
+  void parallel_downsample_mask( int thread, int num_threads, Barrier& barrier, 
     double quality_factor );
 
   // Copy values to members just to simplify and shorten code.  Must be called after downsample
@@ -387,7 +534,16 @@ public:
 
   // PARALLEL_COMPUTE_FACES:
   // Parallelized isosurface computation algorithm 
-  void parallel_compute_faces( int thread, int num_threads, boost::barrier& barrier );
+  void parallel_compute_faces( int thread, int num_threads, Barrier& barrier );
+
+  // ADD_CAP_TRIANGLES:
+  // Add the triangles of a cell of cap cap_num in the current slab to elements. cube_type is 
+  // the type of the cube next to the cell. cell_points holds the points of the cell as stored 
+  // in the edge and node buffers, tagged with the thread that created them, and back_points 
+  // marks the entries that belong to the back slice.
+  void add_cap_triangles( int thread, int cap_num, unsigned char cell_type, 
+    unsigned char cube_type, const unsigned int* cell_points, unsigned char back_points, 
+    std::vector< StackVector< size_t, 3 > >& elements );
 
   void translate_cap_coords( int cap_num, float i, float j, float& x, float& y, float& z );
 
@@ -396,18 +552,107 @@ public:
   // COMPUTE_CAP_FACES:
   // Compute the "cap" faces at the boundary of the mask volume to handle the case where the 
   // mask goes all the way to the boundary.  Otherwise, we end up with holes in the 
-  // isosurface at the boundary.  The cap faces are computed as separate geometry so that they can 
-  // be turned on/off independently from the rest of the isosurface.
+  // isosurface at the boundary.  Normally the caps are generated together with the rest of 
+  // the isosurface and share its points; this separate pass is only used for masks that are a 
+  // single voxel thick in some direction and have no (marching) cubes.
   void compute_cap_faces();
 
   // PARALLEL_COMPUTE_NORMALS:
   // Parallelized isosurface normal computation algorithm 
-  void parallel_compute_normals( int thread, int num_threads,  boost::barrier& barrier );
+  void parallel_compute_normals( int thread, int num_threads,  Barrier& barrier );
 
   // UPLOAD_TO_VERTEX_BUFFER:
-  void upload_to_vertex_buffer();
+  void upload_to_vertex_buffer( size_t level );
 
   void reset();
+
+  // DOWNSAMPLE_REGION:
+  // Update the downsampled mask for the voxels [min, max] of the original mask.
+  void downsample_region( const IndexVector& min, const IndexVector& max );
+
+  // COMPUTE_BLOCK:
+  // Compute the marching cubes mesh of one spatial block and store it with the block.
+  void compute_block( size_t block_index );
+
+  // ADD_BLOCK_CAP_TRIANGLES:
+  // Add the triangles of a cell of cap cap_num to a block. cube_type is the type of the cube 
+  // next to the cell and cell_points holds the indices of the points of the cell in the block.
+  void add_block_cap_triangles( IsosurfaceBlock& block, int cap_num, unsigned char cell_type, 
+    unsigned char cube_type, const unsigned int* cell_points );
+
+  // COMPUTE_BLOCK_RANGE:
+  // Compute the blocks dirty_block_list_[ begin, end ).
+  void compute_block_range( size_t begin, size_t end );
+
+  // DECIMATE_BLOCK:
+  // Compute the decimated meshes of the levels of detail of a block. The faces of level 0 are
+  // reduced to face_fraction of the faces of the block if the number of faces is limited.
+  void decimate_block( size_t block_index, double face_fraction );
+
+  // DECIMATE_BLOCK_RANGE:
+  // Decimate the blocks dirty_block_list_[ begin, end ).
+  void decimate_block_range( size_t begin, size_t end, double face_fraction );
+
+  // DECIMATE_BLOCKS:
+  // Decimate the blocks that have not been decimated since they were computed, so that the
+  // decimation is limited to the part of the isosurface that changed. Returns false if the 
+  // computation was aborted.
+  bool decimate_blocks();
+
+  // STITCH_BLOCKS:
+  // Merge the meshes of all the blocks for a level of detail into the output mesh of that
+  // level, joining the points on the boundaries of the blocks.
+  void stitch_blocks( size_t level );
+
+  // COMPUTE_NORMALS_RANGE:
+  // Compute the normals of the points starting at point_start from the faces starting at 
+  // face_start. These faces may only refer to points starting at point_start.
+  void compute_normals_range( size_t point_start, size_t face_start );
+
+  // COMPUTE_INCREMENTAL:
+  // Compute the isosurface from the spatial blocks, only recomputing the blocks in which the 
+  // mask changed since the last computation. Returns false if the computation was aborted.
+  bool compute_incremental( double quality_factor, bool capping_enabled );
+
+  // DECIMATE:
+  // Decimate the output mesh if requested and compute the coarser levels of detail from it.
+  // Isosurfaces computed per block are decimated per block instead. Returns false if the 
+  // computation was aborted.
+  bool decimate();
+
+  // IS_DECIMATED:
+  // Whether the isosurface (level 0) is decimated
+  bool is_decimated() const
+  {
+    return this->target_faces_ > 0 || this->max_error_ > 0.0;
+  }
+
+  // COMPUTE_PATCHES:
+  // Split the faces into consecutive patches and record the range of points each patch uses,
+  // for meshes that were not computed per slab or block.
+  void compute_patches( const UIntVector& faces );
+
+  // PARTITION_MESH:
+  // Split the mesh of a level into batches that are uploaded to the GPU separately. Returns 
+  // false if the computation was aborted.
+  bool partition_mesh( size_t level );
+
+  // GET_POINTS, GET_NORMALS, GET_FACES:
+  // Mesh of a level of detail
+  const PointFVector& get_points( size_t level ) const
+  {
+    return level == 0 ? this->points_ : this->levels_[ level ]->points_;
+  }
+
+  const VectorFVector& get_normals( size_t level ) const
+  {
+    return level == 0 ? this->normals_ : this->levels_[ level ]->normals_;
+  }
+
+  const UIntVector& get_faces( size_t level ) const
+  {
+    return level == 0 ? this->faces_ : this->levels_[ level ]->faces_;
+  }
   
 
   // Pointer to public Isosurface -- needed to give access to public signals
@@ -449,10 +694,6 @@ public:
   UIntVector min_face_index_;
   UIntVector max_face_index_;
 
-  std::vector< std::pair< unsigned int, unsigned int > > part_points_;
-  std::vector< std::pair< unsigned int, unsigned int > > part_faces_;
-  std::vector< UIntVector > part_indices_;
-
   std::vector< PointFVector > new_points_; 
   std::vector< std::vector< StackVector< size_t, 3 > > > new_elems_;
   FloatVector new_elem_areas_;
@@ -464,14 +705,44 @@ public:
   unsigned int prev_point_min_;
   unsigned int prev_point_max_;
 
-  std::vector< VertexBufferBatchHandle > vbo_batches_;
-  bool vbo_available_;
-  bool surface_changed_;
   bool values_changed_;
 
+  // Whether the caps are generated together with the faces
+  bool capping_enabled_;
+
   bool need_abort_;
   boost::function< bool () > check_abort_;
 
+  // Incremental computation
+  bool incremental_;
+  std::vector< IsosurfaceBlock > blocks_;
+  size_t block_nx_, block_ny_, block_nz_; // Number of blocks in each dimension
+  UCharVector dirty_blocks_; // Blocks that need to be recomputed
+  std::vector< size_t > dirty_block_list_;
+  double block_quality_factor_; // Quality factor the blocks were computed with
+  size_t block_edit_count_; // Edit count of the mask the blocks are up to date with
+  bool block_capping_enabled_; // Whether the blocks include the caps
+  size_t block_target_faces_; // Decimation the levels of the blocks were computed with
+  double block_max_error_;
+  size_t block_num_levels_;
+
+  // Decimation and levels of detail
+  size_t target_faces_; // Maximum number of faces of level 0, 0 if not limited
+  double max_error_; // Maximum quadric error of the decimation, 0 if not limited
+  size_t num_levels_;
+  std::vector< IsosurfaceLevelHandle > levels_;
+
+  // Number of threads of the Parallel parts of the computation, -1 for all the workers
+  int num_threads_;
+
+  // Number of faces that the coarser levels are not decimated below
+  const static size_t MIN_LEVEL_FACES_C;
+  // Number of faces per patch of a decimated mesh
+  const static size_t DECIMATED_PATCH_FACES_C;
+
+  // Number of elements (cubes) along each side of a block
+  const static size_t BLOCK_SIZE_C;
+
   const static double COMPUTE_PERCENT_PROGRESS_C;
   const static double NORMAL_PERCENT_PROGRESS_C;
   const static double PARTITION_PERCENT_PROGRESS_C;
@@ -481,6 +752,9 @@ public:
 const double IsosurfacePrivate::COMPUTE_PERCENT_PROGRESS_C = 0.8;
 const double IsosurfacePrivate::NORMAL_PERCENT_PROGRESS_C = 0.05;
 const double IsosurfacePrivate::PARTITION_PERCENT_PROGRESS_C = 0.15; 
+const size_t IsosurfacePrivate::BLOCK_SIZE_C = 64;
+const size_t IsosurfacePrivate::MIN_LEVEL_FACES_C = 1000;
+const size_t IsosurfacePrivate::DECIMATED_PATCH_FACES_C = 65536;
 
 void IsosurfacePrivate::downsample_setup( int num_threads, double quality_factor )
 {
@@ -545,7 +819,7 @@ neighborhood of nodes is downsampled to a single node.  If at least one neighbor
 result is "on".  This method was chosen to prevent holes in the downsampled data.
 */
 void IsosurfacePrivate::parallel_downsample_mask( int thread, int num_threads, 
-  boost::barrier& barrier, double quality_factor )
+  Barrier& barrier, double quality_factor )
 {
   // Only need to setup once 
   if( thread == 0 )
@@ -642,9 +916,11 @@ void IsosurfacePrivate::compute_faces_setup( int num_threads )
   // Why +1?  Maybe just padding for safety?
   this->type_buffer_.resize( ( this->nx_ + 1 ) * ( this->ny_ + 1 ) );
   // For each element (cube), holds edge ID (12 edges) back_buffer_x, back_buffer_y, 
-  // front_buffer_x, front_buffer_y, and side_buffer 
-  this->edge_buffer_.resize( 5 ); 
-  for ( size_t q = 0; q < 5; q++ )
+  // front_buffer_x, front_buffer_y, and side_buffer. With capping, the points of the nodes on 
+  // the back and front slice are stored in two additional buffers.
+  size_t num_buffers = this->capping_enabled_ ? 7 : 5;
+  this->edge_buffer_.resize( num_buffers ); 
+  for ( size_t q = 0; q < num_buffers; q++ )
   {
     this->edge_buffer_[ q ].resize( ( this->nx_ + 1 ) * ( this->ny_ + 1 ) );
   }
@@ -697,9 +973,13 @@ Basic ideas:
   use tables that directly correspond to elements.
 - Point of confusion: sometimes "element" is synonymous with "cube" and sometimes it refers
   to a triangle.
+- With capping, the "on" nodes on the boundary of the volume become points as well, numbered
+  in the same pass as the edges. The cap cells of the boundary planes that touch the slab are
+  triangulated in the same pass as the cubes, using the same point tables, so the caps share 
+  their points with the rest of the isosurface and the mesh is closed.
 */
 void IsosurfacePrivate::parallel_compute_faces( int thread, int num_threads, 
-  boost::barrier& barrier )
+  Barrier& barrier )
 {
   // Setup the algorithm and the buffers
   if ( thread == 0 ) // Only need to setup once 
@@ -766,6 +1046,8 @@ void IsosurfacePrivate::parallel_compute_faces( int thread, int num_threads,
   int front_buffer_x = 2;
   int front_buffer_y = 3;
   int side_buffer = 4;
+  int back_node_buffer = 5;
+  int front_node_buffer = 6;
 
   StackVector< size_t, 3 > elems( 3 );    
 
@@ -792,6 +1074,15 @@ void IsosurfacePrivate::parallel_compute_faces( int thread, int num_threads,
 
     UIntVector& side_edge = this->edge_buffer_[ side_buffer ];
 
+    // Points of the "on" nodes on the boundary of the volume, only used for capping
+    unsigned int* back_node = 0;
+    unsigned int* front_node = 0;
+    if ( this->capping_enabled_ )
+    {
+      back_node = &( this->edge_buffer_[ back_node_buffer ][ 0 ] );
+      front_node = &( this->edge_buffer_[ front_node_buffer ][ 0 ] );
+    }
+
     // Use relative offsets to find edges
     edge_table[ 0 ] = &( this->edge_buffer_[ back_buffer_x ][ 0 ] );
     edge_table[ 1 ] = &( this->edge_buffer_[ back_buffer_y ][ 1 ] );
@@ -816,6 +1107,30 @@ void IsosurfacePrivate::parallel_compute_faces( int thread, int num_threads,
     {
       for ( size_t x = 0; x < this->nx_; x++ )
       {
+        if ( this->capping_enabled_ )
+        {
+          size_t q = y * this->nx_ + x;
+          bool ring = ( x == 0 || y == 0 || x == this->nx_ - 1 || y == this->ny_ - 1 );
+
+          // The nodes of the first slice are only visited once
+          if ( z == 0 && ( data1[ q ] & this->mask_value_ ) )
+          {
+            points.push_back( grid_transform.project( PointF( static_cast< float >( x ),
+              static_cast< float >( y ), static_cast< float >( z ) ) ) );
+            back_node[ q ] = point_cnt;
+            point_cnt++;
+          }
+
+          // Only the nodes on the sides of the volume are needed, except in the last slice
+          if ( ( ring || z + 1 == this->elem_nz_ ) && ( data2[ q ] & this->mask_value_ ) )
+          {
+            points.push_back( grid_transform.project( PointF( static_cast< float >( x ),
+              static_cast< float >( y ), static_cast< float >( z + 1 ) ) ) );
+            front_node[ q ] = point_cnt;
+            point_cnt++;
+          }
+        }
+
         // There are dim - 1 elements (cubes)
         if ( x < this->elem_nx_ && y < this->elem_ny_ )
         {
@@ -1131,8 +1446,97 @@ void IsosurfacePrivate::parallel_compute_faces( int thread, int num_threads,
       }
     }
 
+    // Build the cap triangles of the boundary planes that touch this slab. The cap cells are 
+    // numbered as in CAPPING_TABLE_C: the 4 nodes and then the 4 edges of the cell.
+    if ( this->capping_enabled_ )
+    {
+      unsigned int cell_points[ 8 ];
+      size_t nx = this->nx_;
+      for ( size_t y = elem_nystart; y < elem_nyend; y++ )
+      {
+        for ( size_t x = 0; x < this->elem_nx_; x++ )
+        {
+          size_t q = y * nx + x;
+          unsigned char type1 = this->type_buffer_[ q ];
+          // Back plane (z = 0)
+          if ( z == 0 && ( type1 & 0x0F ) )
+          {
+            unsigned int nodes[ 8 ] = { back_node[ q ], back_node[ q + 1 ], 
+              back_node[ q + nx + 1 ], back_node[ q + nx ], back_edge_x[ q ], 
+              back_edge_y[ q + 1 ], back_edge_x[ q + nx ], back_edge_y[ q ] };
+            this->add_cap_triangles( thread, 0, type1 & 0x0F, type1, nodes, 0xFF, elements );
+          }
+          
+          // Front plane (z = nz - 1)
+          if ( z + 1 == this->elem_nz_ && ( type1 & 0xF0 ) )
+          {
+            unsigned int nodes[ 8 ] = { front_node[ q ], front_node[ q + 1 ], 
+              front_node[ q + nx + 1 ], front_node[ q + nx ], front_edge_x[ q ], 
+              front_edge_y[ q + 1 ], front_edge_x[ q + nx ], front_edge_y[ q ] };
+            this->add_cap_triangles( thread, 3, type1 >> 4, type1, nodes, 0x00, elements );
+          }
+        }
+
+        // Left (x = 0) and right (x = nx - 1) planes
+        for ( int side = 0; side < 2; side++ )
+        {
+          size_t q = y * nx + ( side == 0 ? 0 : nx - 1 );
+          unsigned char cube_type = this->type_buffer_[ side == 0 ? q : q - 1 ];
+          unsigned char cell_type = 0;
+          if ( data1[ q ] & this->mask_value_ )       cell_type |= 0x1;
+          if ( data1[ q + nx ] & this->mask_value_ )  cell_type |= 0x2;
+          if ( data2[ q + nx ] & this->mask_value_ )  cell_type |= 0x4;
+          if ( data2[ q ] & this->mask_value_ )       cell_type |= 0x8;
+          if ( cell_type == 0 ) continue;
+
+          cell_points[ 0 ] = back_node[ q ];
+          cell_points[ 1 ] = back_node[ q + nx ];
+          cell_points[ 2 ] = front_node[ q + nx ];
+          cell_points[ 3 ] = front_node[ q ];
+          cell_points[ 4 ] = back_edge_y[ q ];
+          cell_points[ 5 ] = side_edge[ q + nx ];
+          cell_points[ 6 ] = front_edge_y[ q ];
+          cell_points[ 7 ] = side_edge[ q ];
+          this->add_cap_triangles( thread, side == 0 ? 2 : 5, cell_type, cube_type, 
+            cell_points, 0x13, elements );
+        }
+      }
+
+      // Top (y = 0) and bottom (y = ny - 1) planes
+      for ( int side = 0; side < 2; side++ )
+      {
+        size_t y = ( side == 0 ) ? 0 : this->elem_ny_ - 1;
+        if ( y < elem_nystart || y >= elem_nyend ) continue;
+
+        size_t row = ( side == 0 ) ? 0 : ( this->ny_ - 1 ) * nx;
+        for ( size_t x = 0; x < this->elem_nx_; x++ )
+        {
+          size_t q = row + x;
+          unsigned char cube_type = this->type_buffer_[ side == 0 ? q : q - nx ];
+          unsigned char cell_type = 0;
+          if ( data1[ q ] & this->mask_value_ )      cell_type |= 0x1;
+          if ( data1[ q + 1 ] & this->mask_value_ )  cell_type |= 0x2;
+          if ( data2[ q + 1 ] & this->mask_value_ )  cell_type |= 0x4;
+          if ( data2[ q ] & this->mask_value_ )      cell_type |= 0x8;
+          if ( cell_type == 0 ) continue;
+
+          cell_points[ 0 ] = back_node[ q ];
+          cell_points[ 1 ] = back_node[ q + 1 ];
+          cell_points[ 2 ] = front_node[ q + 1 ];
+          cell_points[ 3 ] = front_node[ q ];
+          cell_points[ 4 ] = back_edge_x[ q ];
+          cell_points[ 5 ] = side_edge[ q + 1 ];
+          cell_points[ 6 ] = front_edge_x[ q ];
+          cell_points[ 7 ] = side_edge[ q ];
+          this->add_cap_triangles( thread, side == 0 ? 1 : 4, cell_type, cube_type, 
+            cell_points, 0x13, elements );
+        }
+      }
+    }
+
     std::swap( back_buffer_x, front_buffer_x );
     std::swap( back_buffer_y, front_buffer_y );
+    std::swap( back_node_buffer, front_node_buffer );
     barrier.wait();
 
     if ( thread == 0 )
@@ -1191,6 +1595,39 @@ void IsosurfacePrivate::parallel_compute_faces( int thread, int num_threads,
   barrier.wait();
 }
 
+void IsosurfacePrivate::add_cap_triangles( int thread, int cap_num, unsigned char cell_type, 
+  unsigned char cube_type, const unsigned int* cell_points, unsigned char back_points, 
+  std::vector< StackVector< size_t, 3 > >& elements )
+{
+  // Only the nodes that are on and the edges that are split have a point
+  unsigned int points[ 8 ];
+  for ( int k = 0; k < 8; k++ )
+  {
+    bool has_point = ( k < 4 ) ? ( ( cell_type >> k ) & 0x01 ) != 0 : 
+      ( ( ( cell_type >> ( k - 4 ) ) ^ ( cell_type >> ( ( k - 3 ) & 0x03 ) ) ) & 0x01 ) != 0;
+    if ( !has_point ) continue;
+
+    unsigned int p = cell_points[ k ];
+    const IVector& offset = ( ( back_points >> k ) & 0x01 ) ? this->back_offset_ : 
+      this->front_offset_;
+    points[ k ] = ( p & 0x00FFFFFF ) + offset[ p >> 24 ];
+  }
+
+  unsigned int triangles[ 12 ];
+  int num_triangles = GetCapTriangles( cap_num, cell_type, cube_type, points, triangles );
+  StackVector< size_t, 3 > elems( 3 );
+  for ( int k = 0; k < num_triangles; k++ )
+  {
+    elems[ 0 ] = triangles[ 3 * k ];
+    elems[ 1 ] = triangles[ 3 * k + 1 ];
+    elems[ 2 ] = triangles[ 3 * k + 2 ];
+    elements.push_back( elems );
+    this->new_elem_areas_[ thread ] += 0.5f * 
+      Cross( this->points_[ elems[ 1 ] ] - this->points_[ elems[ 0 ] ], 
+      this->points_[ elems[ 2 ] ] - this->points_[ elems[ 0 ] ] ).length();
+  }
+}
+
 //  Translates border face coords (i, j) to volume coords (x, y, z).  
 
 
@@ -1591,7 +2028,7 @@ void IsosurfacePrivate::compute_cap_faces()
 }
 
 void IsosurfacePrivate::parallel_compute_normals( int thread, int num_threads, 
-  boost::barrier& barrier )
+  Barrier& barrier )
 {
   size_t num_vertices = this->points_.size();
 
@@ -1666,28 +2103,35 @@ void IsosurfacePrivate::parallel_compute_normals( int thread, int num_threads,
   }
 }
 
-void IsosurfacePrivate::upload_to_vertex_buffer()
+void IsosurfacePrivate::upload_to_vertex_buffer( size_t level )
 {
-  if ( !this->surface_changed_ && !this->values_changed_ )
+  IsosurfaceLevel* lod = this->levels_[ level ].get();
+  // Values are only assigned to the vertices of level 0
+  bool values_changed = level == 0 && this->values_changed_;
+  if ( !lod->surface_changed_ && !values_changed )
   {
     return;
   }
 
-  size_t num_of_parts = this->part_points_.size();
-  bool has_values = this->values_.size() == this->points_.size();
+  const PointFVector& points = this->get_points( level );
+  const VectorFVector& normals = this->get_normals( level );
+
+  size_t num_of_parts = lod->part_points_.size();
+  bool has_values = level == 0 && this->values_.size() == this->points_.size();
 
   // Estimate the size of video memory required to upload the isosurface
   ptrdiff_t total_size = 0;
   for ( size_t i = 0; i < num_of_parts; ++i )
   {
-    unsigned int num_pts = this->part_points_[ i ].second - this->part_points_[ i ].first;
+    unsigned int num_pts = lod->part_points_[ i ].second - lod->part_points_[ i ].first;
     ptrdiff_t vertex_size = num_pts * sizeof( PointF );
     ptrdiff_t normal_size = num_pts * sizeof( VectorF );
     ptrdiff_t value_size = has_values ? num_pts * sizeof( float ) : 0;
-    unsigned int num_face_indices = this->part_faces_[ i ].second - this->part_faces_[ i ].first;
+    unsigned int num_face_indices = lod->part_faces_[ i ].second - lod->part_faces_[ i ].first;
     ptrdiff_t face_size = num_face_indices * sizeof( unsigned int );
     ptrdiff_t batch_size = vertex_size + normal_size + value_size + face_size;
-    CORE_LOG_MESSAGE( "Isosurface Batch " + ExportToString( i ) + ": " +
+    CORE_LOG_MESSAGE( "Isosurface level " + ExportToString( level ) + " batch " + 
+      ExportToString( i ) + ": " +
              ExportToString( num_pts ) + " vertices, " +
              ExportToString( num_face_indices / 3 ) + " triangles. Total memory: " + 
              ExportToString( batch_size ) );
@@ -1700,51 +2144,51 @@ void IsosurfacePrivate::upload_to_vertex_buffer()
     RenderResources::Instance()->get_vram_size() ) )
   {
     CORE_LOG_WARNING( "Could not fit the isosurface in GPU memory" );
-    this->vbo_batches_.clear();
-    this->surface_changed_ = false;
-    this->values_changed_ = false;
-    this->vbo_available_ = false;
+    lod->vbo_batches_.clear();
+    lod->surface_changed_ = false;
+    if ( level == 0 ) this->values_changed_ = false;
+    lod->vbo_available_ = false;
     return;
   }
   
   RenderResources::lock_type rr_lock( RenderResources::GetMutex() );
-  this->vbo_batches_.resize( num_of_parts );
+  lod->vbo_batches_.resize( num_of_parts );
   for ( size_t i = 0; i < num_of_parts; ++i )
   {
-    this->vbo_batches_[ i ].reset( new VertexBufferBatch );
-    this->vbo_batches_[ i ]->vertex_buffer_.reset( new Core::VertexAttribArrayBuffer );
-    this->vbo_batches_[ i ]->normal_buffer_.reset( new Core::VertexAttribArrayBuffer );
-    this->vbo_batches_[ i ]->faces_buffer_.reset( new Core::ElementArrayBuffer );
-    this->vbo_batches_[ i ]->vertex_buffer_->set_array( 
+    lod->vbo_batches_[ i ].reset( new VertexBufferBatch );
+    lod->vbo_batches_[ i ]->vertex_buffer_.reset( new Core::VertexAttribArrayBuffer );
+    lod->vbo_batches_[ i ]->normal_buffer_.reset( new Core::VertexAttribArrayBuffer );
+    lod->vbo_batches_[ i ]->faces_buffer_.reset( new Core::ElementArrayBuffer );
+    lod->vbo_batches_[ i ]->vertex_buffer_->set_array( 
       VertexAttribArrayType::VERTEX_E, 3, GL_FLOAT, 0, 0 );
-    this->vbo_batches_[ i ]->normal_buffer_->set_array( 
+    lod->vbo_batches_[ i ]->normal_buffer_->set_array( 
       VertexAttribArrayType::NORMAL_E, GL_FLOAT, 0, 0 );
 
-    unsigned int num_pts = this->part_points_[ i ].second - this->part_points_[ i ].first;
+    unsigned int num_pts = lod->part_points_[ i ].second - lod->part_points_[ i ].first;
     ptrdiff_t vertex_size = num_pts * sizeof( PointF );
     ptrdiff_t normal_size = num_pts * sizeof( VectorF );
-    unsigned int num_face_indices = this->part_faces_[ i ].second - this->part_faces_[ i ].first;
+    unsigned int num_face_indices = lod->part_faces_[ i ].second - lod->part_faces_[ i ].first;
     ptrdiff_t face_size = num_face_indices * sizeof( unsigned int );
 
-    this->vbo_batches_[ i ]->vertex_buffer_->set_buffer_data( vertex_size, 
-      &this->points_[ this->part_points_[ i ].first ], GL_STATIC_DRAW );
-    this->vbo_batches_[ i ]->normal_buffer_->set_buffer_data( normal_size, 
-      &this->normals_[ this->part_points_[ i ].first ], GL_STATIC_DRAW );
-    this->vbo_batches_[ i ]->faces_buffer_->set_buffer_data( face_size, 
-      &this->part_indices_[ i ][ 0 ], GL_STATIC_DRAW );
+    lod->vbo_batches_[ i ]->vertex_buffer_->set_buffer_data( vertex_size, 
+      &points[ lod->part_points_[ i ].first ], GL_STATIC_DRAW );
+    lod->vbo_batches_[ i ]->normal_buffer_->set_buffer_data( normal_size, 
+      &normals[ lod->part_points_[ i ].first ], GL_STATIC_DRAW );
+    lod->vbo_batches_[ i ]->faces_buffer_->set_buffer_data( face_size, 
+      &lod->part_indices_[ i ][ 0 ], GL_STATIC_DRAW );
     if ( has_values )
     {
-      this->vbo_batches_[ i ]->value_buffer_.reset( new Core::VertexAttribArrayBuffer );
-      this->vbo_batches_[ i ]->value_buffer_->set_generic_array( 1, 1, GL_FLOAT, 
+      lod->vbo_batches_[ i ]->value_buffer_.reset( new Core::VertexAttribArrayBuffer );
+      lod->vbo_batches_[ i ]->value_buffer_->set_generic_array( 1, 1, GL_FLOAT, 
         GL_FALSE, 0, 0 );
-      this->vbo_batches_[ i ]->value_buffer_->set_buffer_data( num_pts * sizeof( float ),
-        &this->values_[ this->part_points_[ i ].first ], GL_STATIC_DRAW );
+      lod->vbo_batches_[ i ]->value_buffer_->set_buffer_data( num_pts * sizeof( float ),
+        &this->values_[ lod->part_points_[ i ].first ], GL_STATIC_DRAW );
     }
   }
   
-  this->surface_changed_ = false;
-  this->values_changed_ = false;
-  this->vbo_available_ = true;
+  lod->surface_changed_ = false;
+  if ( level == 0 ) this->values_changed_ = false;
+  lod->vbo_available_ = true;
 }
 
 void IsosurfacePrivate::reset()
@@ -1753,181 +2197,1079 @@ void IsosurfacePrivate::reset()
   this->normals_.clear();
   this->faces_.clear();
   this->values_.clear();
+  this->levels_.resize( 1 );
 }
 
-Isosurface::Isosurface( const MaskVolumeHandle& mask_volume ) :
-  private_( new IsosurfacePrivate )
+void IsosurfacePrivate::downsample_region( const IndexVector& min, const IndexVector& max )
 {
-  this->private_->isosurface_ = this;
-  this->private_->orig_mask_volume_ = mask_volume;
-  this->private_->compute_mask_volume_ = mask_volume;
-  this->private_->surface_changed_ = false;
-  this->private_->values_changed_ = false;
-  this->private_->vbo_available_ = false;
+  MaskDataBlockHandle orig_mask_data_block = this->orig_mask_volume_->get_mask_data_block();
+  this->nx_ = orig_mask_data_block->get_nx();
+  this->ny_ = orig_mask_data_block->get_ny();
+  this->nz_ = orig_mask_data_block->get_nz();
+  this->data_ = orig_mask_data_block->get_mask_data();
+  this->mask_value_ = orig_mask_data_block->get_mask_value();
+  this->compute_mask_volume_ = this->downsample_mask_volume_;
 
-  // Test code -- set default colormap
-  //this->private_->color_map_ = ColorMapHandle( new ColorMap() );
+  MaskDataBlockHandle downsample_mask_data_block = 
+    this->downsample_mask_volume_->get_mask_data_block();
+  unsigned char* downsampled_data = downsample_mask_data_block->get_mask_data();
+  unsigned char downsampled_mask_value = downsample_mask_data_block->get_mask_value();
+  unsigned char downsampled_not_mask_value = ~downsampled_mask_value;
+  size_t downsampled_nx = downsample_mask_data_block->get_nx();
+  size_t downsampled_ny = downsample_mask_data_block->get_ny();
+  size_t downsampled_nz = downsample_mask_data_block->get_nz();
+  if ( downsampled_nx == 0 || downsampled_ny == 0 || downsampled_nz == 0 ) return;
+
+  // Neighborhoods that contain a changed voxel. Voxels beyond the last full neighborhood are
+  // chopped off by the downsampling.
+  size_t n = static_cast< size_t >( this->neighborhood_size_ );
+  size_t x_start = static_cast< size_t >( min.x() ) / n;
+  size_t y_start = static_cast< size_t >( min.y() ) / n;
+  size_t z_start = static_cast< size_t >( min.z() ) / n;
+  size_t x_end = Min( static_cast< size_t >( max.x() ) / n, downsampled_nx - 1 );
+  size_t y_end = Min( static_cast< size_t >( max.y() ) / n, downsampled_ny - 1 );
+  size_t z_end = Min( static_cast< size_t >( max.z() ) / n, downsampled_nz - 1 );
+
+  size_t z_offset = this->nx_ * this->ny_;
+  for ( size_t z = z_start; z <= z_end; z++ )
+  {
+    for ( size_t y = y_start; y <= y_end; y++ )
+    {
+      for ( size_t x = x_start; x <= x_end; x++ )
+      {
+        // If at least one neighborhood node is "on", result is "on"
+        bool node_on = false;
+        for ( size_t k = z * n; k < ( z + 1 ) * n && !node_on; k++ )
+        {
+          for ( size_t j = y * n; j < ( y + 1 ) * n && !node_on; j++ )
+          {
+            const unsigned char* data = this->data_ + k * z_offset + j * this->nx_;
+            for ( size_t i = x * n; i < ( x + 1 ) * n && !node_on; i++ )
+            {
+              node_on = ( data[ i ] & this->mask_value_ ) != 0;
+            }
+          }
+        }
+
+        size_t target_index = ( z * downsampled_ny + y ) * downsampled_nx + x;
+        if ( node_on )
+        {
+          downsampled_data[ target_index ] |= downsampled_mask_value;
+        }
+        else
+        {
+          downsampled_data[ target_index ] &= downsampled_not_mask_value;
+        }
+      }
+    }
+  }
 }
 
-void Isosurface::compute( double quality_factor, bool capping_enabled, 
-  boost::function< bool () > check_abort )
+/*
+Computes the same marching cubes mesh as parallel_compute_faces, restricted to the elements 
+(cubes) of one block. The block is processed two planes at a time, like the full algorithm, but 
+the edges of each plane are numbered in a fixed order so the block does not depend on any other 
+block. Points on the boundary of the block are recorded with a key identifying their edge, so 
+they can be joined with the same points of the neighboring blocks when stitching. Blocks on the 
+boundary of the volume also build the cap cells of the boundary planes they touch, from the 
+points of the "on" boundary nodes and the edges of the block.
+*/
+void IsosurfacePrivate::compute_block( size_t block_index )
 {
-  lock_type lock( this->get_mutex() );
-
-  this->private_->points_.clear();
-  this->private_->normals_.clear();
-  this->private_->faces_.clear();
-  this->private_->values_.clear();
-  this->private_->area_ = 0;
-  this->private_->values_changed_ = false;
-  this->private_->check_abort_ = check_abort;
+  IsosurfaceBlock& block = this->blocks_[ block_index ];
+  block.clear();
+
+  // Range of elements [x0, x1) x [y0, y1) x [z0, z1) in this block. The nodes of the block 
+  // range up to and including x1, y1, and z1.
+  size_t x0 = ( block_index % this->block_nx_ ) * BLOCK_SIZE_C;
+  size_t y0 = ( ( block_index / this->block_nx_ ) % this->block_ny_ ) * BLOCK_SIZE_C;
+  size_t z0 = ( block_index / ( this->block_nx_ * this->block_ny_ ) ) * BLOCK_SIZE_C;
+  size_t x1 = Min( x0 + BLOCK_SIZE_C, this->elem_nx_ );
+  size_t y1 = Min( y0 + BLOCK_SIZE_C, this->elem_ny_ );
+  size_t z1 = Min( z0 + BLOCK_SIZE_C, this->elem_nz_ );
+
+  // Edge buffers with indices into the points of the block, indexed by the node at the start
+  // of the edge
+  size_t block_nx = x1 - x0 + 1;
+  size_t block_ny = y1 - y0 + 1;
+  size_t plane_size = block_nx * block_ny;
+  UIntVector edge_buffer[ 7 ];
+  int num_buffers = this->capping_enabled_ ? 7 : 5;
+  for ( int k = 0; k < num_buffers; k++ )
+  {
+    edge_buffer[ k ].resize( plane_size );
+  }
+  UIntVector* back_edge_x = &edge_buffer[ 0 ];
+  UIntVector* back_edge_y = &edge_buffer[ 1 ];
+  UIntVector* front_edge_x = &edge_buffer[ 2 ];
+  UIntVector* front_edge_y = &edge_buffer[ 3 ];
+  UIntVector& side_edge = edge_buffer[ 4 ];
+  // Points of the "on" nodes on the boundary of the volume, only used for capping
+  UIntVector* back_node = &edge_buffer[ 5 ];
+  UIntVector* front_node = &edge_buffer[ 6 ];
+
+  // Since mask values are either on or off, no need to interpolate 
+  // between vertices along edges.  Always put point in center of edge.
+  const float INTERP_EDGE_OFFSET_C = 0.5f;
+  GridTransform grid_transform = this->compute_mask_volume_->get_grid_transform();
+  size_t volume_plane_size = this->nx_ * this->ny_;
+  size_t num_voxels = volume_plane_size * this->nz_;
+  unsigned char mask_value = this->mask_value_;
+  bool capping = this->capping_enabled_;
 
+  for ( size_t z = z0; z <= z1; z++ )
   {
-    Core::MaskVolume::shared_lock_type vol_lock( this->private_->orig_mask_volume_->get_mutex() );
+    const unsigned char* data = this->data_ + z * volume_plane_size;
+    bool z_boundary = ( z == z0 || z == z1 );
+
+    // Step 1: split edges within the plane
+    UIntVector& edge_x = ( z == z0 ) ? *back_edge_x : *front_edge_x;
+    UIntVector& edge_y = ( z == z0 ) ? *back_edge_y : *front_edge_y;
+    UIntVector& node_point = ( z == z0 ) ? *back_node : *front_node;
+    bool z_cap = ( z == 0 || z == this->elem_nz_ );
+    for ( size_t y = y0; y <= y1; y++ )
+    {
+      for ( size_t x = x0; x <= x1; x++ )
+      {
+        size_t index = y * this->nx_ + x;
+        size_t q = ( y - y0 ) * block_nx + ( x - x0 );
+        unsigned char node = data[ index ] & mask_value;
 
-    // Initially assume we're computing the isosurface for the original volume (not downsampled)
-    this->private_->compute_mask_volume_ = this->private_->orig_mask_volume_;
+        // Nodes on the boundary of the volume that are on are points of the caps
+        if ( capping && node && ( z_cap || x == 0 || y == 0 || x == this->elem_nx_ || 
+          y == this->elem_ny_ ) )
+        {
+          node_point[ q ] = static_cast< unsigned int >( block.points_.size() );
+          block.points_.push_back( grid_transform.project( PointF( static_cast< float >( x ), 
+            static_cast< float >( y ), static_cast< float >( z ) ) ) );
+          if ( z_boundary || x == x0 || x == x1 || y == y0 || y == y1 )
+          {
+            block.shared_points_.push_back( std::make_pair( node_point[ q ], 
+              num_voxels * 3 + z * volume_plane_size + index ) );
+          }
+        }
 
-    // Downsample mask if needed
-    if( quality_factor != 1.0 )
-    {
-      assert( quality_factor == 0.5 || quality_factor == 0.25 || quality_factor == 0.125 );
-      Parallel parallel_downsample( boost::bind( &IsosurfacePrivate::parallel_downsample_mask, 
-        this->private_, _1, _2, _3, quality_factor ) );
-      parallel_downsample.run();
+        if ( x < x1 && node != ( data[ index + 1 ] & mask_value ) )
+        {
+          edge_x[ q ] = static_cast< unsigned int >( block.points_.size() );
+          block.points_.push_back( grid_transform.project( PointF( 
+            static_cast< float >( x ) + INTERP_EDGE_OFFSET_C, static_cast< float >( y ), 
+            static_cast< float >( z ) ) ) );
+          if ( z_boundary || y == y0 || y == y1 )
+          {
+            block.shared_points_.push_back( std::make_pair( edge_x[ q ], 
+              ( z * volume_plane_size + index ) * 3 ) );
+          }
+        }
+
+        if ( y < y1 && node != ( data[ index + this->nx_ ] & mask_value ) )
+        {
+          edge_y[ q ] = static_cast< unsigned int >( block.points_.size() );
+          block.points_.push_back( grid_transform.project( PointF( 
+            static_cast< float >( x ), static_cast< float >( y ) + INTERP_EDGE_OFFSET_C, 
+            static_cast< float >( z ) ) ) );
+          if ( z_boundary || x == x0 || x == x1 )
+          {
+            block.shared_points_.push_back( std::make_pair( edge_y[ q ], 
+              ( z * volume_plane_size + index ) * 3 + 1 ) );
+          }
+        }
+      }
     }
 
-    if ( check_abort() )
+    // Cap of the first (z = 0) and last (z = nz - 1) plane of the volume
+    if ( capping && z_cap )
     {
-      // leave it in a decent state
-      this->private_->reset();
-      return;
+      for ( size_t y = y0; y < y1; y++ )
+      {
+        for ( size_t x = x0; x < x1; x++ )
+        {
+          size_t index = y * this->nx_ + x;
+          unsigned char cell_type = 0;
+          if ( data[ index ] & mask_value )                   cell_type |= 0x1;
+          if ( data[ index + 1 ] & mask_value )               cell_type |= 0x2;
+          if ( data[ index + this->nx_ + 1 ] & mask_value )   cell_type |= 0x4;
+          if ( data[ index + this->nx_ ] & mask_value )       cell_type |= 0x8;
+          if ( cell_type == 0 ) continue;
+
+          size_t q = ( y - y0 ) * block_nx + ( x - x0 );
+          unsigned int cell_points[ 8 ] = { node_point[ q ], node_point[ q + 1 ], 
+            node_point[ q + block_nx + 1 ], node_point[ q + block_nx ], edge_x[ q ], 
+            edge_y[ q + 1 ], edge_x[ q + block_nx ], edge_y[ q ] };
+          unsigned char cube_type = ( z == 0 ) ? 
+            GetCubeType( data, data + volume_plane_size, index, this->nx_, mask_value ) :
+            GetCubeType( data - volume_plane_size, data, index, this->nx_, mask_value );
+          this->add_block_cap_triangles( block, z == 0 ? 0 : 3, cell_type, cube_type, 
+            cell_points );
+        }
+      }
     }
 
-    // Copy values to members just to simplify and shorten code.
-    this->private_->compute_setup();
+    if ( z == z0 ) continue;
 
-    // Compute isosurface without caps
-    Parallel parallel_faces( boost::bind( &IsosurfacePrivate::parallel_compute_faces, 
-      this->private_, _1, _2, _3 ) );
-    parallel_faces.run();
+    // Step 2: split edges between the back and the front plane
+    const unsigned char* back_data = data - volume_plane_size;
+    for ( size_t y = y0; y <= y1; y++ )
+    {
+      for ( size_t x = x0; x <= x1; x++ )
+      {
+        size_t index = y * this->nx_ + x;
+        if ( ( back_data[ index ] ^ data[ index ] ) & mask_value )
+        {
+          size_t q = ( y - y0 ) * block_nx + ( x - x0 );
+          side_edge[ q ] = static_cast< unsigned int >( block.points_.size() );
+          block.points_.push_back( grid_transform.project( PointF( 
+            static_cast< float >( x ), static_cast< float >( y ), 
+            static_cast< float >( z - 1 ) + INTERP_EDGE_OFFSET_C ) ) );
+          if ( x == x0 || x == x1 || y == y0 || y == y1 )
+          {
+            block.shared_points_.push_back( std::make_pair( side_edge[ q ], 
+              ( ( z - 1 ) * volume_plane_size + index ) * 3 + 2 ) );
+          }
+        }
+      }
+    }
 
-    if ( check_abort() )
+    // Step 3: build the triangles of the elements between the two planes, using the same
+    // edge numbering as parallel_compute_faces
+    const unsigned int* edge_table[ 12 ] = 
     {
-      // leave it in a decent state
-      this->private_->reset();
-      return;
+      &( *back_edge_x )[ 0 ], &( *back_edge_y )[ 1 ], 
+      &( *back_edge_x )[ block_nx ], &( *back_edge_y )[ 0 ],
+      &( *front_edge_x )[ 0 ], &( *front_edge_y )[ 1 ],
+      &( *front_edge_x )[ block_nx ], &( *front_edge_y )[ 0 ],
+      &side_edge[ 0 ], &side_edge[ 1 ], &side_edge[ block_nx ], &side_edge[ block_nx + 1 ]
+    };
+
+    for ( size_t y = y0; y < y1; y++ )
+    {
+      for ( size_t x = x0; x < x1; x++ )
+      {
+        size_t index = y * this->nx_ + x;
+        unsigned char type = GetCubeType( back_data, data, index, this->nx_, mask_value );
+
+        // All points are inside or outside the cube -- does not contribute to the 
+        // isosurface 
+        if ( type == 0x00 || type == 0xFF ) 
+        {
+          continue;
+        }
+
+        size_t q = ( y - y0 ) * block_nx + ( x - x0 );
+        const MarchingCubesTableType& table = MARCHING_CUBES_TABLE_C[ type ];
+        for ( int k = 0; k < table.num_triangles_; k++ )
+        {
+          unsigned int p1 = edge_table[ table.edges_[ 3 * k ] ][ q ];
+          unsigned int p2 = edge_table[ table.edges_[ 3 * k + 1 ] ][ q ];
+          unsigned int p3 = edge_table[ table.edges_[ 3 * k + 2 ] ][ q ];
+          block.faces_.push_back( p1 );
+          block.faces_.push_back( p2 );
+          block.faces_.push_back( p3 );
+          block.area_ += 0.5f * Cross( block.points_[ p2 ] - block.points_[ p1 ], 
+            block.points_[ p3 ] - block.points_[ p1 ] ).length();
+        }
+      }
     }
 
-    // Compute isosurface caps
-    if( capping_enabled )
+    // Caps of the sides of the volume between the two planes
+    if ( capping )
     {
-      this->private_->compute_cap_faces();
+      // Top (y = 0) and bottom (y = ny - 1) planes
+      for ( int side = 0; side < 2; side++ )
+      {
+        if ( side == 0 ? y0 != 0 : y1 != this->elem_ny_ ) continue;
+        size_t y = ( side == 0 ) ? y0 : y1;
+        for ( size_t x = x0; x < x1; x++ )
+        {
+          size_t index = y * this->nx_ + x;
+          unsigned char cell_type = 0;
+          if ( back_data[ index ] & mask_value )      cell_type |= 0x1;
+          if ( back_data[ index + 1 ] & mask_value )  cell_type |= 0x2;
+          if ( data[ index + 1 ] & mask_value )       cell_type |= 0x4;
+          if ( data[ index ] & mask_value )           cell_type |= 0x8;
+          if ( cell_type == 0 ) continue;
+
+          size_t q = ( y - y0 ) * block_nx + ( x - x0 );
+          unsigned int cell_points[ 8 ] = { ( *back_node )[ q ], ( *back_node )[ q + 1 ], 
+            ( *front_node )[ q + 1 ], ( *front_node )[ q ], ( *back_edge_x )[ q ], 
+            side_edge[ q + 1 ], ( *front_edge_x )[ q ], side_edge[ q ] };
+          unsigned char cube_type = GetCubeType( back_data, data, 
+            side == 0 ? index : index - this->nx_, this->nx_, mask_value );
+          this->add_block_cap_triangles( block, side == 0 ? 1 : 4, cell_type, cube_type, 
+            cell_points );
+        }
+      }
+
+      // Left (x = 0) and right (x = nx - 1) planes
+      for ( int side = 0; side < 2; side++ )
+      {
+        if ( side == 0 ? x0 != 0 : x1 != this->elem_nx_ ) continue;
+        size_t x = ( side == 0 ) ? x0 : x1;
+        for ( size_t y = y0; y < y1; y++ )
+        {
+          size_t index = y * this->nx_ + x;
+          unsigned char cell_type = 0;
+          if ( back_data[ index ] & mask_value )              cell_type |= 0x1;
+          if ( back_data[ index + this->nx_ ] & mask_value )  cell_type |= 0x2;
+          if ( data[ index + this->nx_ ] & mask_value )       cell_type |= 0x4;
+          if ( data[ index ] & mask_value )                   cell_type |= 0x8;
+          if ( cell_type == 0 ) continue;
+
+          size_t q = ( y - y0 ) * block_nx + ( x - x0 );
+          unsigned int cell_points[ 8 ] = { ( *back_node )[ q ], ( *back_node )[ q + block_nx ],
+            ( *front_node )[ q + block_nx ], ( *front_node )[ q ], ( *back_edge_y )[ q ], 
+            side_edge[ q + block_nx ], ( *front_edge_y )[ q ], side_edge[ q ] };
+          unsigned char cube_type = GetCubeType( back_data, data, 
+            side == 0 ? index : index - 1, this->nx_, mask_value );
+          this->add_block_cap_triangles( block, side == 0 ? 2 : 5, cell_type, cube_type, 
+            cell_points );
+        }
+      }
     }
+
+    // The front plane becomes the back plane
+    std::swap( back_edge_x, front_edge_x );
+    std::swap( back_edge_y, front_edge_y );
+    std::swap( back_node, front_node );
   }
 
-  // Check for empty isosurface
-  if( this->private_->points_.size() == 0 ) 
+  // Accumulate the normals of the faces, the same way parallel_compute_normals does
+  block.normals_.resize( block.points_.size(), VectorF( 0, 0, 0 ) );
+  for ( size_t i = 0; i + 2 < block.faces_.size(); i += 3 )
   {
-    return;
+    const PointF& p1 = block.points_[ block.faces_[ i ] ];
+    const PointF& p2 = block.points_[ block.faces_[ i + 1 ] ];
+    const PointF& p3 = block.points_[ block.faces_[ i + 2 ] ];
+    VectorF n = Cross( p3 - p2, p1 - p2 );
+    block.normals_[ block.faces_[ i ] ] += n;
+    block.normals_[ block.faces_[ i + 1 ] ] += n;
+    block.normals_[ block.faces_[ i + 2 ] ] += n;
   }
+}
 
-  // Test code -- assign values to vertices in range [0, 1].  
-  /*size_t num_points = this->private_->points_.size();
-  for( size_t i = 0; i < num_points; i++ )
+void IsosurfacePrivate::add_block_cap_triangles( IsosurfaceBlock& block, int cap_num, 
+  unsigned char cell_type, unsigned char cube_type, const unsigned int* cell_points )
+{
+  unsigned int triangles[ 12 ];
+  int num_triangles = GetCapTriangles( cap_num, cell_type, cube_type, cell_points, triangles );
+  for ( int k = 0; k < num_triangles; k++ )
   {
-    float val = static_cast< float >( i ) / static_cast< float >( num_points );
-    this->private_->values_.push_back( val );
-  }*/
-
-  Parallel parallel_normals( boost::bind( &IsosurfacePrivate::parallel_compute_normals, 
-    this->private_, _1, _2, _3 ) );
-  parallel_normals.run();
+    unsigned int p1 = triangles[ 3 * k ];
+    unsigned int p2 = triangles[ 3 * k + 1 ];
+    unsigned int p3 = triangles[ 3 * k + 2 ];
+    block.faces_.push_back( p1 );
+    block.faces_.push_back( p2 );
+    block.faces_.push_back( p3 );
+    block.area_ += 0.5f * Cross( block.points_[ p2 ] - block.points_[ p1 ], 
+      block.points_[ p3 ] - block.points_[ p1 ] ).length();
+  }
+}
 
-  if ( check_abort() )
+void IsosurfacePrivate::compute_block_range( size_t begin, size_t end )
+{
+  for ( size_t j = begin; j < end; j++ )
   {
-    // leave it in a decent state
-    this->private_->reset();
-    return;
+    size_t block_index = this->dirty_block_list_[ j ];
+    this->compute_block( block_index );
+    this->dirty_blocks_[ block_index ] = 0;
   }
+}
 
-  this->update_progress_signal_( IsosurfacePrivate::COMPUTE_PERCENT_PROGRESS_C + 
-    IsosurfacePrivate::NORMAL_PERCENT_PROGRESS_C );
+void IsosurfacePrivate::decimate_block( size_t block_index, double face_fraction )
+{
+  IsosurfaceBlock& block = this->blocks_[ block_index ];
+  block.levels_.clear();
+  if ( block.faces_.empty() ) return;
+  block.levels_.resize( this->num_levels_ );
 
-  this->private_->type_buffer_.clear();
-  this->private_->edge_buffer_.clear();
-  this->private_->new_points_.clear();
-  this->private_->new_elems_.clear();
-  this->private_->new_elem_areas_.clear();
-  this->private_->front_offset_.clear();
-  this->private_->back_offset_.clear();
-  
-  this->private_->part_points_.clear();
-  this->private_->part_faces_.clear();
-  this->private_->part_indices_.clear();
-  
-  unsigned int num_faces = 0;
-  unsigned int min_point_index = 0;
-  unsigned int min_face_index = 0;
-  
-  for ( size_t j = 0; j < this->private_->min_point_index_.size(); j++ )
+  UIntVector point_map;
+  for ( size_t level = 0; level < this->num_levels_; level++ )
   {
-    if ( num_faces == 0 )
+    const PointFVector* points = &block.points_;
+    const UIntVector* faces = &block.faces_;
+    const std::vector< std::pair< unsigned int, size_t > >* shared_points = 
+      &block.shared_points_;
+    size_t target_faces = 0;
+    double max_error = 0.0;
+
+    if ( level == 0 )
     {
-      min_point_index = this->private_->min_point_index_[ j ];
-      min_face_index = this->private_->min_face_index_[ j ];
+      if ( !this->is_decimated() ) continue;
+      if ( this->target_faces_ > 0 )
+      {
+        target_faces = Max( static_cast< size_t >( std::ceil( face_fraction * 
+          static_cast< double >( block.faces_.size() / 3 ) ) ), size_t( 1 ) );
+      }
+      max_error = this->max_error_;
+    }
+    else
+    {
+      if ( level > 1 || this->is_decimated() )
+      {
+        points = &block.levels_[ level - 1 ].points_;
+        faces = &block.levels_[ level - 1 ].faces_;
+        shared_points = &block.levels_[ level - 1 ].shared_points_;
+      }
+      // Each coarser level has a quarter of the faces of the previous one
+      target_faces = faces->size() / 12;
+    }
+
+    // NOTE: The blocks are decimated in parallel, aborting is checked in between
+    IsosurfaceBlockMesh& mesh = block.levels_[ level ];
+    IsosurfaceDecimator::Decimate( *points, *faces, target_faces, max_error, mesh.points_, 
+      mesh.faces_, point_map, boost::function< bool () >() );
+    IsosurfaceDecimator::ComputeNormals( mesh.points_, mesh.faces_, mesh.normals_ );
+
+    for ( size_t j = 0; j < shared_points->size(); j++ )
+    {
+      unsigned int index = point_map[ ( *shared_points )[ j ].first ];
+      if ( index == std::numeric_limits< unsigned int >::max() ) continue;
+      mesh.shared_points_.push_back( std::make_pair( index, ( *shared_points )[ j ].second ) );
+    }
+  }
+}
+
+void IsosurfacePrivate::decimate_block_range( size_t begin, size_t end, double face_fraction )
+{
+  for ( size_t j = begin; j < end; j++ )
+  {
+    this->decimate_block( this->dirty_block_list_[ j ], face_fraction );
+  }
+}
+
+bool IsosurfacePrivate::decimate_blocks()
+{
+  // Blocks that were decimated with other settings need to be decimated again
+  if ( this->target_faces_ != this->block_target_faces_ || 
+    this->max_error_ != this->block_max_error_ || this->num_levels_ != this->block_num_levels_ )
+  {
+    for ( size_t b = 0; b < this->blocks_.size(); b++ )
+    {
+      this->blocks_[ b ].levels_.clear();
     }
+    this->block_target_faces_ = this->target_faces_;
+    this->block_max_error_ = this->max_error_;
+    this->block_num_levels_ = this->num_levels_;
+  }
+
+  if ( !this->is_decimated() && this->num_levels_ <= 1 ) return true;
+
+  // The faces of the isosurface are divided over the blocks in proportion to their faces
+  size_t num_faces = 0;
+  for ( size_t b = 0; b < this->blocks_.size(); b++ )
+  {
+    num_faces += this->blocks_[ b ].faces_.size() / 3;
+  }
+  double face_fraction = 1.0;
+  if ( this->target_faces_ > 0 && num_faces > this->target_faces_ )
+  {
+    face_fraction = static_cast< double >( this->target_faces_ ) / 
+      static_cast< double >( num_faces );
+  }
+
+  this->dirty_block_list_.clear();
+  for ( size_t b = 0; b < this->blocks_.size(); b++ )
+  {
+    const IsosurfaceBlock& block = this->blocks_[ b ];
+    if ( !block.faces_.empty() && block.levels_.empty() ) this->dirty_block_list_.push_back( b );
+  }
+
+  // Blocks that are not decimated because of an abort are decimated next time
+  size_t num_blocks = this->dirty_block_list_.size();
+  size_t batch_size = 4 * static_cast< size_t >( Parallel::GetNumThreads() );
+  for ( size_t start = 0; start < num_blocks; start += batch_size )
+  {
+    size_t end = Min( start + batch_size, num_blocks );
+    Parallel::For( start, end, boost::bind( &IsosurfacePrivate::decimate_block_range, 
+      this, _1, _2, face_fraction ), 1 );
+
+    if ( this->check_abort_() ) 
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void IsosurfacePrivate::stitch_blocks( size_t level )
+{
+  // Level 0 is stitched from the marching cubes meshes, unless it is decimated
+  bool use_block_mesh = level == 0 && !this->is_decimated();
+
+  PointFVector& points = level == 0 ? this->points_ : this->levels_[ level ]->points_;
+  VectorFVector& normals = level == 0 ? this->normals_ : this->levels_[ level ]->normals_;
+  UIntVector& faces = level == 0 ? this->faces_ : this->levels_[ level ]->faces_;
+
+  if ( level == 0 )
+  {
+    this->min_point_index_.clear();
+    this->max_point_index_.clear();
+    this->min_face_index_.clear();
+    this->max_face_index_.clear();
+  }
+
+  const unsigned int NEW_POINT_C = std::numeric_limits< unsigned int >::max();
+
+  // Index of the points on block boundaries in the output mesh, by edge key
+  boost::unordered_map< size_t, unsigned int > shared_points;
+  UIntVector point_index;
+
+  for ( size_t b = 0; b < this->blocks_.size(); b++ )
+  {
+    const IsosurfaceBlock& block = this->blocks_[ b ];
+    if ( block.faces_.empty() ) continue;
+    if ( !use_block_mesh && level >= block.levels_.size() ) continue;
+
+    const PointFVector& block_points = use_block_mesh ? block.points_ : 
+      block.levels_[ level ].points_;
+    const VectorFVector& block_normals = use_block_mesh ? block.normals_ : 
+      block.levels_[ level ].normals_;
+    const UIntVector& block_faces = use_block_mesh ? block.faces_ : 
+      block.levels_[ level ].faces_;
+    const std::vector< std::pair< unsigned int, size_t > >& block_shared_points = 
+      use_block_mesh ? block.shared_points_ : block.levels_[ level ].shared_points_;
+
+    // Points that were already added by a neighboring block are reused
+    point_index.assign( block_points.size(), NEW_POINT_C );
+    for ( size_t j = 0; j < block_shared_points.size(); j++ )
+    {
+      boost::unordered_map< size_t, unsigned int >::const_iterator it = 
+        shared_points.find( block_shared_points[ j ].second );
+      if ( it != shared_points.end() )
+      {
+        point_index[ block_shared_points[ j ].first ] = it->second;
+      }
+    }
+
+    for ( size_t j = 0; j < block_points.size(); j++ )
+    {
+      if ( point_index[ j ] == NEW_POINT_C )
+      {
+        point_index[ j ] = static_cast< unsigned int >( points.size() );
+        points.push_back( block_points[ j ] );
+        normals.push_back( block_normals[ j ] );
+      }
+      else
+      {
+        normals[ point_index[ j ] ] += block_normals[ j ];
+      }
+    }
+
+    for ( size_t j = 0; j < block_shared_points.size(); j++ )
+    {
+      shared_points.insert( std::make_pair( block_shared_points[ j ].second, 
+        point_index[ block_shared_points[ j ].first ] ) );
+    }
+
+    // Each block becomes a rendering "patch"; its faces may refer to points of earlier blocks
+    unsigned int min_point_index = NEW_POINT_C;
+    unsigned int max_point_index = 0;
+    size_t face_start = faces.size();
+    for ( size_t j = 0; j < block_faces.size(); j++ )
+    {
+      unsigned int index = point_index[ block_faces[ j ] ];
+      faces.push_back( index );
+      min_point_index = Min( min_point_index, index );
+      max_point_index = Max( max_point_index, index );
+    }
+
+    if ( level == 0 )
+    {
+      this->min_face_index_.push_back( static_cast< unsigned int >( face_start ) );
+      this->max_face_index_.push_back( static_cast< unsigned int >( faces.size() ) );
+      this->min_point_index_.push_back( min_point_index );
+      this->max_point_index_.push_back( max_point_index + 1 );
+      this->area_ += block.area_;
+    }
+  }
+
+  for ( size_t j = 0; j < normals.size(); j++ )
+  {
+    normals[ j ].normalize();
+  }
+}
+
+void IsosurfacePrivate::compute_normals_range( size_t point_start, size_t face_start )
+{
+  this->normals_.resize( this->points_.size(), VectorF( 0, 0, 0 ) );
+  for ( size_t i = face_start; i + 2 < this->faces_.size(); i += 3 )
+  {
+    const PointF& p1 = this->points_[ this->faces_[ i ] ];
+    const PointF& p2 = this->points_[ this->faces_[ i + 1 ] ];
+    const PointF& p3 = this->points_[ this->faces_[ i + 2 ] ];
+    VectorF n = Cross( p3 - p2, p1 - p2 );
+    this->normals_[ this->faces_[ i ] ] += n;
+    this->normals_[ this->faces_[ i + 1 ] ] += n;
+    this->normals_[ this->faces_[ i + 2 ] ] += n;
+  }
+
+  for ( size_t i = point_start; i < this->normals_.size(); i++ )
+  {
+    this->normals_[ i ].normalize();
+  }
+}
+
+bool IsosurfacePrivate::compute_incremental( double quality_factor, bool capping_enabled )
+{
+  MaskDataBlockHandle mask_data_block = this->orig_mask_volume_->get_mask_data_block();
+
+  // NOTE: The edit count is read before the mask is locked. A change made in between is 
+  // included in the data that is read now and will be recomputed once more next time.
+  size_t edit_count = mask_data_block->get_edit_count();
+
+  Core::MaskVolume::shared_lock_type vol_lock( this->orig_mask_volume_->get_mutex() );
+
+  IndexVector dirty_min, dirty_max;
+  bool update_all = quality_factor != this->block_quality_factor_ ||
+    capping_enabled != this->block_capping_enabled_ ||
+    !mask_data_block->get_dirty_region( this->block_edit_count_, dirty_min, dirty_max );
+  bool has_dirty_region = dirty_min.x() <= dirty_max.x() && dirty_min.y() <= dirty_max.y() &&
+    dirty_min.z() <= dirty_max.z();
+
+  // Downsample mask if needed
+  this->compute_mask_volume_ = this->orig_mask_volume_;
+  if ( quality_factor != 1.0 )
+  {
+    assert( quality_factor == 0.5 || quality_factor == 0.25 || quality_factor == 0.125 );
+    if ( update_all || !this->downsample_mask_volume_ )
+    {
+      update_all = true;
+      Parallel parallel_downsample( boost::bind( &IsosurfacePrivate::parallel_downsample_mask, 
+        this, _1, _2, _3, quality_factor ), this->num_threads_ );
+      parallel_downsample.run();
+    }
+    else
+    {
+      if ( has_dirty_region )
+      {
+        this->downsample_region( dirty_min, dirty_max );
+      }
+      this->compute_mask_volume_ = this->downsample_mask_volume_;
+
+      // Region in the downsampled mask
+      IndexVector::index_type n = this->neighborhood_size_;
+      dirty_min = IndexVector( dirty_min.x() / n, dirty_min.y() / n, dirty_min.z() / n );
+      dirty_max = IndexVector( dirty_max.x() / n, dirty_max.y() / n, dirty_max.z() / n );
+    }
+  }
+
+  // Copy values to members just to simplify and shorten code.
+  this->compute_setup();
+
+  this->elem_nx_ = this->nx_ - 1;
+  this->elem_ny_ = this->ny_ - 1;
+  this->elem_nz_ = this->nz_ - 1;
+  size_t block_nx = ( this->elem_nx_ + BLOCK_SIZE_C - 1 ) / BLOCK_SIZE_C;
+  size_t block_ny = ( this->elem_ny_ + BLOCK_SIZE_C - 1 ) / BLOCK_SIZE_C;
+  size_t block_nz = ( this->elem_nz_ + BLOCK_SIZE_C - 1 ) / BLOCK_SIZE_C;
+  size_t num_blocks = block_nx * block_ny * block_nz;
+  
+  if ( update_all || this->blocks_.size() != num_blocks || block_nx != this->block_nx_ ||
+    block_ny != this->block_ny_ )
+  {
+    this->block_nx_ = block_nx;
+    this->block_ny_ = block_ny;
+    this->block_nz_ = block_nz;
+    this->blocks_.clear();
+    this->blocks_.resize( num_blocks );
+    this->dirty_blocks_.assign( num_blocks, 1 );
+  }
+  else if ( has_dirty_region && num_blocks > 0 )
+  {
+    // Elements that have a changed voxel as one of their nodes
+    size_t elem_min[ 3 ], elem_max[ 3 ];
+    size_t elem_n[ 3 ] = { this->elem_nx_, this->elem_ny_, this->elem_nz_ };
+    for ( int k = 0; k < 3; k++ )
+    {
+      elem_min[ k ] = Min( static_cast< size_t >( Max( dirty_min[ k ] - 1, 
+        IndexVector::index_type( 0 ) ) ), elem_n[ k ] - 1 );
+      elem_max[ k ] = Min( static_cast< size_t >( dirty_max[ k ] ), elem_n[ k ] - 1 );
+    }
+
+    for ( size_t z = elem_min[ 2 ] / BLOCK_SIZE_C; z <= elem_max[ 2 ] / BLOCK_SIZE_C; z++ )
+    {
+      for ( size_t y = elem_min[ 1 ] / BLOCK_SIZE_C; y <= elem_max[ 1 ] / BLOCK_SIZE_C; y++ )
+      {
+        for ( size_t x = elem_min[ 0 ] / BLOCK_SIZE_C; x <= elem_max[ 0 ] / BLOCK_SIZE_C; x++ )
+        {
+          this->dirty_blocks_[ ( z * block_ny + y ) * block_nx + x ] = 1;
+        }
+      }
+    }
+  }
+
+  // Blocks that are not recomputed because of an abort stay marked as dirty
+  this->block_quality_factor_ = quality_factor;
+  this->block_edit_count_ = edit_count;
+  this->block_capping_enabled_ = capping_enabled;
+  this->capping_enabled_ = capping_enabled;
+
+  this->dirty_block_list_.clear();
+  for ( size_t b = 0; b < num_blocks; b++ )
+  {
+    if ( this->dirty_blocks_[ b ] ) this->dirty_block_list_.push_back( b );
+  }
+
+  // Compute the dirty blocks in batches, so progress can be reported and the computation can
+  // be aborted in between
+  size_t num_dirty_blocks = this->dirty_block_list_.size();
+  size_t batch_size = 4 * static_cast< size_t >( Parallel::GetNumThreads() );
+  for ( size_t start = 0; start < num_dirty_blocks; start += batch_size )
+  {
+    size_t end = Min( start + batch_size, num_dirty_blocks );
+    Parallel::For( start, end, boost::bind( &IsosurfacePrivate::compute_block_range, 
+      this, _1, _2 ), 1 );
+
+    if ( this->check_abort_() ) 
+    {
+      return false;
+    }
+
+    double compute_progress = static_cast< double >( end ) / 
+      static_cast< double >( num_dirty_blocks );
+    this->isosurface_->update_progress_signal_( compute_progress * 
+      COMPUTE_PERCENT_PROGRESS_C );
+  }
+
+  if ( !this->decimate_blocks() )
+  {
+    return false;
+  }
+
+  for ( size_t level = 0; level < this->levels_.size(); level++ )
+  {
+    this->stitch_blocks( level );
+  }
+
+  // The blocks include the caps, unless the mask has no (marching) cubes
+  if( capping_enabled && num_blocks == 0 )
+  {
+    size_t point_start = this->points_.size();
+    size_t face_start = this->faces_.size();
+    this->compute_cap_faces();
+    this->compute_normals_range( point_start, face_start );
+  }
+
+  return !this->check_abort_();
+}
+
+bool IsosurfacePrivate::decimate()
+{
+  // The blocks were decimated separately, so only the blocks that changed are decimated
+  if ( this->incremental_ && !this->blocks_.empty() ) return true;
+
+  if ( this->is_decimated() )
+  {
+    PointFVector points;
+    UIntVector faces;
+    if ( !IsosurfaceDecimator::Decimate( this->points_, this->faces_, this->target_faces_, 
+      this->max_error_, points, faces, this->check_abort_ ) )
+    {
+      return false;
+    }
+    this->points_.swap( points );
+    this->faces_.swap( faces );
+    
+    Parallel parallel_normals( boost::bind( &IsosurfacePrivate::parallel_compute_normals, 
+      this, _1, _2, _3 ), this->num_threads_ );
+    parallel_normals.run();
+
+    this->compute_patches( this->faces_ );
+  }
+
+  // Each coarser level has a quarter of the faces of the previous one
+  for ( size_t level = 1; level < this->levels_.size(); level++ )
+  {
+    const UIntVector& faces = this->get_faces( level - 1 );
+    size_t target_faces = Max( faces.size() / 12, MIN_LEVEL_FACES_C );
+    IsosurfaceLevel* lod = this->levels_[ level ].get();
+    if ( !IsosurfaceDecimator::Decimate( this->get_points( level - 1 ), faces, target_faces, 
+      0.0, lod->points_, lod->faces_, this->check_abort_ ) )
+    {
+      return false;
+    }
+    IsosurfaceDecimator::ComputeNormals( lod->points_, lod->faces_, lod->normals_ );
+  }
+
+  return true;
+}
+
+void IsosurfacePrivate::compute_patches( const UIntVector& faces )
+{
+  this->min_point_index_.clear();
+  this->max_point_index_.clear();
+  this->min_face_index_.clear();
+  this->max_face_index_.clear();
+
+  size_t num_faces = faces.size() / 3;
+  for ( size_t start = 0; start < num_faces; start += DECIMATED_PATCH_FACES_C )
+  {
+    size_t end = Min( start + DECIMATED_PATCH_FACES_C, num_faces );
+    unsigned int min_point_index = std::numeric_limits< unsigned int >::max();
+    unsigned int max_point_index = 0;
+    for ( size_t j = 3 * start; j < 3 * end; j++ )
+    {
+      min_point_index = Min( min_point_index, faces[ j ] );
+      max_point_index = Max( max_point_index, faces[ j ] + 1 );
+    }
+    this->min_point_index_.push_back( min_point_index );
+    this->max_point_index_.push_back( max_point_index );
+    this->min_face_index_.push_back( static_cast< unsigned int >( 3 * start ) );
+    this->max_face_index_.push_back( static_cast< unsigned int >( 3 * end ) );
+  }
+}
+
+bool IsosurfacePrivate::partition_mesh( size_t level )
+{
+  IsosurfaceLevel* lod = this->levels_[ level ].get();
+  const UIntVector& faces = this->get_faces( level );
+  if ( level > 0 )
+  {
+    this->compute_patches( faces );
+  }
+
+  lod->part_points_.clear();
+  lod->part_faces_.clear();
+  lod->part_indices_.clear();
+  
+  unsigned int num_faces = 0;
+  unsigned int min_point_index = 0;
+  unsigned int max_point_index = 0;
+  unsigned int min_face_index = 0;
+  
+  for ( size_t j = 0; j < this->min_point_index_.size(); j++ )
+  {
+    if ( num_faces == 0 )
+    {
+      min_point_index = this->min_point_index_[ j ];
+      max_point_index = this->max_point_index_[ j ];
+      min_face_index = this->min_face_index_[ j ];
+    }
+
+    // The faces of a patch computed per block can refer to points of earlier patches
+    min_point_index = Min( min_point_index, this->min_point_index_[ j ] );
+    max_point_index = Max( max_point_index, this->max_point_index_[ j ] );
     
-    num_faces += this->private_->max_face_index_[ j ] - this->private_->min_face_index_[ j ];
+    num_faces += this->max_face_index_[ j ] - this->min_face_index_[ j ];
     
-    if ( num_faces > 0 && (num_faces > 1000000 || j == this->private_->min_point_index_.size() - 1 ) )
+    if ( num_faces > 0 && (num_faces > 1000000 || j == this->min_point_index_.size() - 1 ) )
     {
-      this->private_->part_points_.push_back( std::make_pair(
-        min_point_index, this->private_->max_point_index_[ j ] ) );
-      this->private_->part_faces_.push_back( std::make_pair(
-        min_face_index, this->private_->max_face_index_[ j ] ) );
+      lod->part_points_.push_back( std::make_pair(
+        min_point_index, max_point_index ) );
+      lod->part_faces_.push_back( std::make_pair(
+        min_face_index, this->max_face_index_[ j ] ) );
       num_faces = 0;
     }
 
-    if ( check_abort() )
+    if ( this->check_abort_() )
     {
-      // leave it in a decent state
-      this->private_->reset();
-      return;
+      return false;
     }
 
+    if ( level > 0 ) continue;
+
     // Update progress
     double partition_progress = 
-      static_cast< double >( j + 1 ) / static_cast< double >( this->private_->min_point_index_.size() ); 
-    double total_progress = IsosurfacePrivate::COMPUTE_PERCENT_PROGRESS_C + 
-      IsosurfacePrivate::NORMAL_PERCENT_PROGRESS_C +
-      ( partition_progress * IsosurfacePrivate::PARTITION_PERCENT_PROGRESS_C );
-    this->update_progress_signal_( total_progress );
+      static_cast< double >( j + 1 ) / static_cast< double >( this->min_point_index_.size() ); 
+    double total_progress = COMPUTE_PERCENT_PROGRESS_C + 
+      NORMAL_PERCENT_PROGRESS_C +
+      ( partition_progress * PARTITION_PERCENT_PROGRESS_C );
+    this->isosurface_->update_progress_signal_( total_progress );
   }
-  size_t num_batches = this->private_->part_points_.size();
+  size_t num_batches = lod->part_points_.size();
   for ( size_t i = 0; i < num_batches; ++i )
   {
-    unsigned int num_face_indices = this->private_->part_faces_[ i ].second - 
-      this->private_->part_faces_[ i ].first;
+    unsigned int num_face_indices = lod->part_faces_[ i ].second - 
+      lod->part_faces_[ i ].first;
     UIntVector local_indices( num_face_indices );
     for ( size_t j = 0; j < num_face_indices; ++j )
     {
-      size_t pt_global_idx = this->private_->part_faces_[ i ].first + j;
-      local_indices[ j ] = this->private_->faces_[ pt_global_idx ] - 
-        this->private_->part_points_[ i ].first;
+      size_t pt_global_idx = lod->part_faces_[ i ].first + j;
+      local_indices[ j ] = faces[ pt_global_idx ] - 
+        lod->part_points_[ i ].first;
       assert( local_indices[ j ] >= 0 && 
-           local_indices[ j ] < ( this->private_->part_points_[ i ].second - 
-                     this->private_->part_points_[ i ].first ) );
+           local_indices[ j ] < ( lod->part_points_[ i ].second - 
+                     lod->part_points_[ i ].first ) );
+    }
+    lod->part_indices_.push_back( local_indices );
+  }
+  
+  this->min_point_index_.clear();
+  this->max_point_index_.clear();
+  this->min_face_index_.clear();
+  this->max_face_index_.clear();
+
+  lod->surface_changed_ = true;
+  return true;
+}
+
+Isosurface::Isosurface( const MaskVolumeHandle& mask_volume ) :
+  private_( new IsosurfacePrivate )
+{
+  this->private_->isosurface_ = this;
+  this->private_->orig_mask_volume_ = mask_volume;
+  this->private_->compute_mask_volume_ = mask_volume;
+  this->private_->values_changed_ = false;
+  this->private_->incremental_ = false;
+  this->private_->block_nx_ = 0;
+  this->private_->block_ny_ = 0;
+  this->private_->block_nz_ = 0;
+  this->private_->block_quality_factor_ = 0.0;
+  this->private_->block_edit_count_ = 0;
+  this->private_->block_capping_enabled_ = false;
+  this->private_->block_target_faces_ = 0;
+  this->private_->block_max_error_ = 0.0;
+  this->private_->block_num_levels_ = 1;
+  this->private_->capping_enabled_ = false;
+  this->private_->target_faces_ = 0;
+  this->private_->max_error_ = 0.0;
+  this->private_->num_levels_ = 1;
+  this->private_->num_threads_ = -1;
+  this->private_->levels_.push_back( IsosurfaceLevelHandle( new IsosurfaceLevel ) );
+
+  // Test code -- set default colormap
+  //this->private_->color_map_ = ColorMapHandle( new ColorMap() );
+}
+
+void Isosurface::compute( double quality_factor, bool capping_enabled, 
+  boost::function< bool () > check_abort )
+{
+  lock_type lock( this->get_mutex() );
+
+  this->private_->points_.clear();
+  this->private_->normals_.clear();
+  this->private_->faces_.clear();
+  this->private_->values_.clear();
+  this->private_->area_ = 0;
+  this->private_->values_changed_ = false;
+  this->private_->check_abort_ = check_abort;
+
+  this->private_->levels_.clear();
+  for ( size_t level = 0; level < this->private_->num_levels_; level++ )
+  {
+    this->private_->levels_.push_back( IsosurfaceLevelHandle( new IsosurfaceLevel ) );
+  }
+
+  if ( this->private_->incremental_ )
+  {
+    if ( !this->private_->compute_incremental( quality_factor, capping_enabled ) )
+    {
+      // leave it in a decent state
+      this->private_->reset();
+      return;
+    }
+
+    // Check for empty isosurface
+    if( this->private_->points_.size() == 0 ) 
+    {
+      return;
+    }
+  }
+  else
+  {
+    {
+      Core::MaskVolume::shared_lock_type vol_lock( this->private_->orig_mask_volume_->get_mutex() );
+
+      // Initially assume we're computing the isosurface for the original volume (not downsampled)
+      this->private_->compute_mask_volume_ = this->private_->orig_mask_volume_;
+
+      // Downsample mask if needed
+      if( quality_factor != 1.0 )
+      {
+        assert( quality_factor == 0.5 || quality_factor == 0.25 || quality_factor == 0.125 );
+        Parallel parallel_downsample( boost::bind( &IsosurfacePrivate::parallel_downsample_mask, 
+          this->private_, _1, _2, _3, quality_factor ), this->private_->num_threads_ );
+        parallel_downsample.run();
+      }
+
+      if ( check_abort() )
+      {
+        // leave it in a decent state
+        this->private_->reset();
+        return;
+      }
+
+      // Copy values to members just to simplify and shorten code.
+      this->private_->compute_setup();
+
+      // The caps are generated with the faces, unless the mask has no (marching) cubes
+      bool has_cubes = this->private_->nx_ > 1 && this->private_->ny_ > 1 && 
+        this->private_->nz_ > 1;
+      this->private_->capping_enabled_ = capping_enabled && has_cubes;
+
+      // Compute isosurface
+      Parallel parallel_faces( boost::bind( &IsosurfacePrivate::parallel_compute_faces, 
+        this->private_, _1, _2, _3 ), this->private_->num_threads_ );
+      parallel_faces.run();
+
+      if ( check_abort() )
+      {
+        // leave it in a decent state
+        this->private_->reset();
+        return;
+      }
+
+      // Compute isosurface caps of masks without cubes
+      if( capping_enabled && !has_cubes )
+      {
+        this->private_->compute_cap_faces();
+      }
+    }
+
+    // Check for empty isosurface
+    if( this->private_->points_.size() == 0 ) 
+    {
+      return;
+    }
+
+    // Test code -- assign values to vertices in range [0, 1].  
+    /*size_t num_points = this->private_->points_.size();
+    for( size_t i = 0; i < num_points; i++ )
+    {
+      float val = static_cast< float >( i ) / static_cast< float >( num_points );
+      this->private_->values_.push_back( val );
+    }*/
+
+    Parallel parallel_normals( boost::bind( &IsosurfacePrivate::parallel_compute_normals, 
+      this->private_, _1, _2, _3 ), this->private_->num_threads_ );
+    parallel_normals.run();
+
+    if ( check_abort() )
+    {
+      // leave it in a decent state
+      this->private_->reset();
+      return;
     }
-    this->private_->part_indices_.push_back( local_indices );
   }
+
+  this->update_progress_signal_( IsosurfacePrivate::COMPUTE_PERCENT_PROGRESS_C + 
+    IsosurfacePrivate::NORMAL_PERCENT_PROGRESS_C );
+
+  this->private_->type_buffer_.clear();
+  this->private_->edge_buffer_.clear();
+  this->private_->new_points_.clear();
+  this->private_->new_elems_.clear();
+  this->private_->new_elem_areas_.clear();
+  this->private_->front_offset_.clear();
+  this->private_->back_offset_.clear();
   
-  this->private_->min_point_index_.clear();
-  this->private_->max_point_index_.clear();
-  this->private_->min_face_index_.clear();
-  this->private_->max_face_index_.clear();
+  if ( !this->private_->decimate() )
+  {
+    // leave it in a decent state
+    this->private_->reset();
+    return;
+  }
 
-  this->private_->surface_changed_ = true;
+  for ( size_t level = 0; level < this->private_->levels_.size(); level++ )
+  {
+    if ( !this->private_->partition_mesh( level ) )
+    {
+      // leave it in a decent state
+      this->private_->reset();
+      return;
+    }
+  }
 
   if ( check_abort() )
   {
@@ -1942,19 +3284,83 @@ void Isosurface::compute( double quality_factor, bool capping_enabled,
   // this->export_legacy_isosurface( "", "test_isosurface" );
 }
 
-const PointFVector& Isosurface::get_points() const
+void Isosurface::set_decimation( size_t target_faces, double max_error )
+{
+  lock_type lock( this->get_mutex() );
+  this->private_->target_faces_ = target_faces;
+  this->private_->max_error_ = Max( max_error, 0.0 );
+}
+
+void Isosurface::set_num_levels_of_detail( size_t num_levels )
+{
+  lock_type lock( this->get_mutex() );
+  this->private_->num_levels_ = Max( num_levels, size_t( 1 ) );
+}
+
+void Isosurface::set_num_threads( int num_threads )
+{
+  lock_type lock( this->get_mutex() );
+  this->private_->num_threads_ = num_threads;
+}
+
+size_t Isosurface::get_num_levels_of_detail() const
+{
+  lock_type lock( this->get_mutex() );
+  return this->private_->levels_.size();
+}
+
+size_t Isosurface::get_num_faces( size_t level ) const
+{
+  lock_type lock( this->get_mutex() );
+  if ( level >= this->private_->levels_.size() ) return 0;
+  return this->private_->get_faces( level ).size() / 3;
+}
+
+size_t Isosurface::get_render_level_of_detail() const
+{
+  lock_type lock( this->get_mutex() );
+  size_t vram_size = RenderResources::Instance()->get_vram_size();
+  size_t num_levels = this->private_->levels_.size();
+  for ( size_t level = 0; level + 1 < num_levels; level++ )
+  {
+    size_t num_points = this->private_->get_points( level ).size();
+    size_t size = num_points * ( sizeof( PointF ) + sizeof( VectorF ) ) + 
+      this->private_->get_faces( level ).size() * sizeof( unsigned int );
+    if ( level == 0 && this->private_->values_.size() == num_points )
+    {
+      size += num_points * sizeof( float );
+    }
+    // Same margin as used when uploading the isosurface
+    if ( size + ( 20 << 20 ) <= vram_size ) return level;
+  }
+  return num_levels - 1;
+}
+
+void Isosurface::set_incremental( bool incremental )
+{
+  lock_type lock( this->get_mutex() );
+  this->private_->incremental_ = incremental;
+  if ( !incremental )
+  {
+    this->private_->blocks_.clear();
+    this->private_->dirty_blocks_.clear();
+    this->private_->block_quality_factor_ = 0.0;
+  }
+}
+
+const PointFVector& Isosurface::get_points( size_t level ) const
 {
-  return this->private_->points_;
+  return this->private_->get_points( level );
 }
 
-const UIntVector& Isosurface::get_faces() const
+const UIntVector& Isosurface::get_faces( size_t level ) const
 {
-  return this->private_->faces_;
+  return this->private_->get_faces( level );
 }
 
-const VectorFVector& Isosurface::get_normals() const
+const VectorFVector& Isosurface::get_normals( size_t level ) const
 { 
-  return this->private_->normals_;
+  return this->private_->get_normals( level );
 }
 
 const FloatVector& Isosurface::get_values() const
@@ -1986,19 +3392,27 @@ Core::ColorMapHandle Isosurface::get_color_map() const
   return this->private_->color_map_;
 }
 
-void Isosurface::redraw( bool use_colormap )
+void Isosurface::redraw( bool use_colormap, size_t level )
 {
   lock_type lock( this->get_mutex() );
 
+  if ( level >= this->private_->levels_.size() )
+  {
+    level = this->private_->levels_.size() - 1;
+  }
+  const PointFVector& points = this->private_->get_points( level );
+  const VectorFVector& normals = this->private_->get_normals( level );
+  IsosurfaceLevel* lod = this->private_->levels_[ level ].get();
+
   // Check for empty isosurface
-  if( this->private_->points_.size() == 0 ) 
+  if( points.size() == 0 ) 
   {
     return;
   }
   
-  this->private_->upload_to_vertex_buffer();
-  size_t num_batches = this->private_->part_points_.size();
-  bool has_values = this->private_->values_.size() == this->private_->points_.size();
+  this->private_->upload_to_vertex_buffer( level );
+  size_t num_batches = lod->part_points_.size();
+  bool has_values = level == 0 && this->private_->values_.size() == points.size();
   
   // Error checking
   if( use_colormap ) 
@@ -2014,24 +3428,24 @@ void Isosurface::redraw( bool use_colormap )
   }
 
   // Use the uploaded VBO for rendering if it's available
-  if ( this->private_->vbo_available_ )
+  if ( lod->vbo_available_ )
   {
     for ( size_t i = 0; i < num_batches; ++i )
     {
-      this->private_->vbo_batches_[ i ]->vertex_buffer_->enable_arrays();
-      this->private_->vbo_batches_[ i ]->normal_buffer_->enable_arrays();
+      lod->vbo_batches_[ i ]->vertex_buffer_->enable_arrays();
+      lod->vbo_batches_[ i ]->normal_buffer_->enable_arrays();
       if ( has_values && use_colormap )
       {
-        this->private_->vbo_batches_[ i ]->value_buffer_->enable_arrays();
+        lod->vbo_batches_[ i ]->value_buffer_->enable_arrays();
       }
-      this->private_->vbo_batches_[ i ]->faces_buffer_->draw_elements( GL_TRIANGLES, 
-        static_cast< GLsizei >( ( this->private_->part_faces_[ i ].second - 
-        this->private_->part_faces_[ i ].first ) ), GL_UNSIGNED_INT );
-      this->private_->vbo_batches_[ i ]->vertex_buffer_->disable_arrays();
-      this->private_->vbo_batches_[ i ]->normal_buffer_->disable_arrays();
+      lod->vbo_batches_[ i ]->faces_buffer_->draw_elements( GL_TRIANGLES, 
+        static_cast< GLsizei >( ( lod->part_faces_[ i ].second - 
+        lod->part_faces_[ i ].first ) ), GL_UNSIGNED_INT );
+      lod->vbo_batches_[ i ]->vertex_buffer_->disable_arrays();
+      lod->vbo_batches_[ i ]->normal_buffer_->disable_arrays();
       if ( has_values && use_colormap )
       {
-        this->private_->vbo_batches_[ i ]->value_buffer_->disable_arrays();
+        lod->vbo_batches_[ i ]->value_buffer_->disable_arrays();
       }
     }
     return;
@@ -2053,11 +3467,11 @@ void Isosurface::redraw( bool use_colormap )
   ElementArrayBufferHandle face_buffer( new ElementArrayBuffer );
   for ( size_t i = 0; i < num_batches; ++i )
   {
-    unsigned int num_pts = this->private_->part_points_[ i ].second - this->private_->part_points_[ i ].first;
+    unsigned int num_pts = lod->part_points_[ i ].second - lod->part_points_[ i ].first;
     ptrdiff_t vertex_size = num_pts * sizeof( PointF );
     ptrdiff_t normal_size = num_pts * sizeof( VectorF );
     ptrdiff_t value_size = has_values && use_colormap ? num_pts * sizeof( float ) : 0;
-    unsigned int num_face_indices = this->private_->part_faces_[ i ].second - this->private_->part_faces_[ i ].first;
+    unsigned int num_face_indices = lod->part_faces_[ i ].second - lod->part_faces_[ i ].first;
     ptrdiff_t face_size = num_face_indices * sizeof( unsigned int );
     
     vertex_buffer->set_buffer_data( vertex_size, 0, GL_STREAM_DRAW );
@@ -2068,7 +3482,7 @@ void Isosurface::redraw( bool use_colormap )
         " be incomplete!" );
       return;
     }
-    memcpy( buffer, &this->private_->points_[ this->private_->part_points_[ i ].first ], vertex_size );
+    memcpy( buffer, &points[ lod->part_points_[ i ].first ], vertex_size );
     vertex_buffer->unmap_buffer();
     
     normal_buffer->set_buffer_data( normal_size, 0, GL_STREAM_DRAW );
@@ -2079,7 +3493,7 @@ void Isosurface::redraw( bool use_colormap )
         " be incomplete!" );
       return;
     }
-    memcpy( buffer, &this->private_->normals_[ this->private_->part_points_[ i ].first ], normal_size );
+    memcpy( buffer, &normals[ lod->part_points_[ i ].first ], normal_size );
     normal_buffer->unmap_buffer();
     
     if ( has_values && use_colormap )
@@ -2092,7 +3506,7 @@ void Isosurface::redraw( bool use_colormap )
           " be incomplete!" );
         return;
       }
-      memcpy( buffer, &this->private_->values_[ this->private_->part_points_[ i ].first ], value_size );
+      memcpy( buffer, &this->private_->values_[ lod->part_points_[ i ].first ], value_size );
       value_buffer->unmap_buffer();
     }
 
@@ -2104,7 +3518,7 @@ void Isosurface::redraw( bool use_colormap )
         " be incomplete!" );
       return;
     }
-    memcpy( buffer, &this->private_->part_indices_[ i ][ 0 ], face_size );
+    memcpy( buffer, &lod->part_indices_[ i ][ 0 ], face_size );
     face_buffer->unmap_buffer();
 
     vertex_buffer->enable_arrays();
@@ -2114,8 +3528,8 @@ void Isosurface::redraw( bool use_colormap )
       value_buffer->enable_arrays();
     }
     face_buffer->draw_elements( GL_TRIANGLES, 
-      static_cast< GLsizei >( ( this->private_->part_faces_[ i ].second - 
-      this->private_->part_faces_[ i ].first ) ), GL_UNSIGNED_INT );
+      static_cast< GLsizei >( ( lod->part_faces_[ i ].second - 
+      lod->part_faces_[ i ].first ) ), GL_UNSIGNED_INT );
     vertex_buffer->disable_arrays();
     normal_buffer->disable_arrays();
     if ( has_values && use_colormap )
@@ -2125,47 +3539,151 @@ void Isosurface::redraw( bool use_colormap )
   } 
 }
 
+bool Isosurface::export_isosurface( const boost::filesystem::path& filename, 
+                                    const std::string& name, 
+                                    bool binary, 
+                                    bool compress, 
+                                    size_t level )
+{
+  std::string extension = filename.extension().string();
+  if ( extension == ".fac" || extension == ".pts" || extension == ".val" )
+  {
+    return this->export_legacy_isosurface( filename.parent_path(), filename.stem().string(), 
+      level );
+  }
+  else if ( extension == ".stl" )
+  {
+    return binary ? this->export_stl_binary_isosurface( filename, name, level ) :
+      this->export_stl_ascii_isosurface( filename, name, level );
+  }
+  else if ( extension == ".vtk" )
+  {
+    return binary ? this->export_vtk_binary_isosurface( filename, level ) :
+      this->export_vtk_isosurface( filename, level );
+  }
+  else if ( extension == ".vtp" )
+  {
+    return this->export_vtk_xml_isosurface( filename, compress, level );
+  }
+  else if ( extension == ".ply" )
+  {
+    return this->export_ply_isosurface( filename, level );
+  }
+  else if ( extension == ".obj" )
+  {
+    return this->export_obj_isosurface( filename, name, level );
+  }
+  return false;
+}
+
 bool Isosurface::export_legacy_isosurface( const boost::filesystem::path& path,
-                                           const std::string& file_prefix )
+                                           const std::string& file_prefix,
+                                           size_t level )
 {
   lock_type lock( this->get_mutex() );
+  if ( level >= this->private_->levels_.size() ) return false;
+  // Values are only assigned to the vertices of level 0
   bool result = IsosurfaceExporter::ExportLegacy( path, file_prefix,
-                                                  this->private_->points_,
-                                                  this->private_->faces_,
-                                                  this->private_->values_
+                                                  this->private_->get_points( level ),
+                                                  this->private_->get_faces( level ),
+                                                  level == 0 ? this->private_->values_ : 
+                                                    FloatVector()
                                                 );
   return result;
 }
 
 
-bool Isosurface::export_vtk_isosurface( const boost::filesystem::path& filename )
+bool Isosurface::export_vtk_isosurface( const boost::filesystem::path& filename, 
+                                        size_t level )
 {
   lock_type lock( this->get_mutex() );
+  if ( level >= this->private_->levels_.size() ) return false;
   bool result = IsosurfaceExporter::ExportVTKASCII( filename,
-                                                    this->private_->points_,
-                                                    this->private_->faces_
+                                                    this->private_->get_points( level ),
+                                                    this->private_->get_faces( level )
                                                   );
   return result;
 }
 
+bool Isosurface::export_vtk_binary_isosurface( const boost::filesystem::path& filename, 
+                                               size_t level )
+{
+  lock_type lock( this->get_mutex() );
+  if ( level >= this->private_->levels_.size() ) return false;
+  // Values are only assigned to the vertices of level 0
+  bool result = IsosurfaceExporter::ExportVTKBinary( filename,
+                                                     this->private_->get_points( level ),
+                                                     this->private_->get_faces( level ),
+                                                     level == 0 ? this->private_->values_ : 
+                                                       FloatVector()
+                                                   );
+  return result;
+}
+
+bool Isosurface::export_vtk_xml_isosurface( const boost::filesystem::path& filename, 
+                                            bool compress, size_t level )
+{
+  lock_type lock( this->get_mutex() );
+  if ( level >= this->private_->levels_.size() ) return false;
+  bool result = IsosurfaceExporter::ExportVTKXML( filename,
+                                                  this->private_->get_points( level ),
+                                                  this->private_->get_faces( level ),
+                                                  level == 0 ? this->private_->values_ : 
+                                                    FloatVector(),
+                                                  compress
+                                                );
+  return result;
+}
+
+bool Isosurface::export_ply_isosurface( const boost::filesystem::path& filename, 
+                                        size_t level )
+{
+  lock_type lock( this->get_mutex() );
+  if ( level >= this->private_->levels_.size() ) return false;
+  bool result = IsosurfaceExporter::ExportPLYBinary( filename,
+                                                     this->private_->get_points( level ),
+                                                     this->private_->get_faces( level ),
+                                                     level == 0 ? this->private_->values_ : 
+                                                       FloatVector()
+                                                   );
+  return result;
+}
+
+bool Isosurface::export_obj_isosurface( const boost::filesystem::path& filename,
+                                        const std::string& name,
+                                        size_t level )
+{
+  lock_type lock( this->get_mutex() );
+  if ( level >= this->private_->levels_.size() ) return false;
+  bool result = IsosurfaceExporter::ExportOBJ( filename, name,
+                                               this->private_->get_points( level ),
+                                               this->private_->get_faces( level )
+                                             );
+  return result;
+}
+
 bool Isosurface::export_stl_ascii_isosurface( const boost::filesystem::path& filename,
-                                              const std::string& name )
+                                              const std::string& name,
+                                              size_t level )
 {
   lock_type lock( this->get_mutex() );
+  if ( level >= this->private_->levels_.size() ) return false;
   bool result = IsosurfaceExporter::ExportSTLASCII( filename, name,
-                                                    this->private_->points_,
-                                                    this->private_->faces_
+                                                    this->private_->get_points( level ),
+                                                    this->private_->get_faces( level )
                                                   );
   return result;
 }
 
 bool Isosurface::export_stl_binary_isosurface( const boost::filesystem::path& filename,
-                                               const std::string& name )
+                                               const std::string& name,
+                                               size_t level )
 {
   lock_type lock( this->get_mutex() );
+  if ( level >= this->private_->levels_.size() ) return false;
   bool result = IsosurfaceExporter::ExportSTLBinary( filename, name,
-                                                     this->private_->points_,
-                                                     this->private_->faces_
+                                                     this->private_->get_points( level ),
+                                                     this->private_->get_faces( level )
                                                    );
   return result;
 }
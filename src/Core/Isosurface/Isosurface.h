@@ -74,30 +74,74 @@ public:
   /// Compute isosurface.  quality_factor must be one of: {0.125, 0.25, 0.5, 1.0} 
   void compute( double quality_factor, bool capping_enabled, boost::function< bool () > check_abort );
 
+  // SET_INCREMENTAL:
+  /// Keep the isosurface stored per spatial block, so that the next call to compute() only 
+  /// recomputes the blocks in which the mask changed. The change is taken from the dirty 
+  /// regions recorded by the MaskDataBlock; if these are not known the whole isosurface is 
+  /// recomputed. This needs additional memory for the blocks. By default the isosurface is
+  /// computed over the whole volume each time.
+  void set_incremental( bool incremental );
+
+  // SET_DECIMATION:
+  /// Simplify the isosurface after it has been computed, by collapsing edges in order of their
+  /// quadric error until it has at most target_faces faces or until the next collapse would
+  /// have an error larger than max_error (in world units). Zero disables either bound, by 
+  /// default the isosurface is not decimated. The surface area is the one of the isosurface 
+  /// before decimation. Takes effect on the next call to compute(). Incremental isosurfaces are
+  /// decimated per block, so only the blocks in which the mask changed are decimated again. The
+  /// points on the boundaries of the blocks are kept and target_faces is divided over the 
+  /// blocks, hence the number of faces is approximate.
+  void set_decimation( size_t target_faces, double max_error );
+
+  // SET_NUM_LEVELS_OF_DETAIL:
+  /// Set the number of levels of detail that compute() generates. Level 0 is the (decimated) 
+  /// isosurface, each next level is decimated to a quarter of the faces of the previous one.
+  /// By default only level 0 is generated.
+  void set_num_levels_of_detail( size_t num_levels );
+
+  // SET_NUM_THREADS:
+  /// Set the number of threads the slice by slice parts of compute() run on, -1 uses all the 
+  /// workers of the thread pool. Lowering this is useful when several isosurfaces are computed
+  /// at the same time.
+  void set_num_threads( int num_threads );
+
+  // GET_NUM_LEVELS_OF_DETAIL:
+  /// Get the number of levels of detail of the current isosurface.
+  size_t get_num_levels_of_detail() const;
+
+  // GET_NUM_FACES:
+  /// Get the number of faces of a level of detail.
+  size_t get_num_faces( size_t level ) const;
+
+  // GET_RENDER_LEVEL_OF_DETAIL:
+  /// Get the finest level of detail that fits in video memory, or the coarsest level if none
+  /// of them fit.
+  size_t get_render_level_of_detail() const;
+
   // GET_POINTS:
   /// Get 3D points for vertices, each stored only once
   /// NOTE: This function is not thread-safe, make sure you have the mutex
   /// allocated before using this array (use get_mutex())
-  const PointFVector& get_points() const;
+  const PointFVector& get_points( size_t level = 0 ) const;
 
   // GET_FACES:
   /// Indices into vertices, 3 per face
   /// NOTE: This function is not thread-safe, make sure you have the mutex
   /// allocated before using this array (use get_mutex())
-  const UIntVector& get_faces() const;
+  const UIntVector& get_faces( size_t level = 0 ) const;
 
   // GET_NORMALS:
   /// Get one normal per vertex, interpolated
   /// NOTE: This function is not thread-safe, make sure you have the mutex
   /// allocated before using this array (use get_mutex())
-  const VectorFVector& get_normals() const;
+  const VectorFVector& get_normals( size_t level = 0 ) const;
 
   // SURFACE_AREA:
   /// Return the area of the isosurface.
   float surface_area() const;
 
   // GET_VALUES:
-  /// Get values per vertex.  Returns empty vector if use has not set values.
+  /// Get values per vertex of level 0.  Returns empty vector if use has not set values.
   /// NOTE: This function is not thread-safe, make sure you have the mutex
   /// allocated before using this array (use get_mutex())
   const FloatVector& get_values() const;
@@ -120,9 +164,9 @@ public:
   ColorMapHandle get_color_map() const;
 
   // REDRAW:
-  /// Render the isosurface.  This function doesn't work in isolation -- it must be called from the 
-  /// Seg3D Renderer. 
-  void redraw( bool use_colormap );
+  /// Render a level of detail of the isosurface.  This function doesn't work in isolation -- it 
+  /// must be called from the Seg3D Renderer. Only level 0 has values for the colormap.
+  void redraw( bool use_colormap, size_t level = 0 );
 
   // EXPORT_LEGACY_ISOSURFACE:
   /// Write points to .pts file, faces to .fac file, and values (if assigned) to .val file.  
@@ -146,23 +190,61 @@ public:
   /// v2
   /// ...
   ///
+  /// Values are only written for level 0.
+  ///
   /// Note: can't call this function "export" because it is reserved by the Visual C++ compiler.
   bool export_legacy_isosurface( const boost::filesystem::path& path,
-                                 const std::string& file_prefix ); 
+                                 const std::string& file_prefix,
+                                 size_t level = 0 ); 
+
+  // EXPORT_ISOSURFACE:
+  /// Writes out a level of detail of the isosurface in the format that matches the extension of
+  /// the file name (see EXPORT_FORMATS_C). binary selects the binary variant of the VTK and STL
+  /// formats, compress is used for VTK XML files and name for STL and OBJ files. The legacy 
+  /// format writes the .fac, .pts, and .val files next to each other.
+  bool export_isosurface( const boost::filesystem::path& filename, 
+                          const std::string& name,
+                          bool binary,
+                          bool compress,
+                          size_t level = 0 );
 
   // EXPORT_VTK_ISOSURFACE:
-  /// Writes out an isosurface in ASCII VTK mesh format
-  bool export_vtk_isosurface( const boost::filesystem::path& filename );
+  /// Writes out a level of detail of the isosurface in ASCII VTK mesh format
+  bool export_vtk_isosurface( const boost::filesystem::path& filename, size_t level = 0 );
+
+  // EXPORT_VTK_BINARY_ISOSURFACE:
+  /// Writes out a level of detail of the isosurface in binary VTK mesh format, including the
+  /// values of level 0
+  bool export_vtk_binary_isosurface( const boost::filesystem::path& filename, size_t level = 0 );
+
+  // EXPORT_VTK_XML_ISOSURFACE:
+  /// Writes out a level of detail of the isosurface in VTK XML PolyData format (.vtp), including 
+  /// the values of level 0. The data is stored in binary form and optionally compressed.
+  bool export_vtk_xml_isosurface( const boost::filesystem::path& filename, bool compress,
+                                  size_t level = 0 );
+
+  // EXPORT_PLY_ISOSURFACE:
+  /// Writes out a level of detail of the isosurface in binary PLY format, including the values of
+  /// level 0
+  bool export_ply_isosurface( const boost::filesystem::path& filename, size_t level = 0 );
+
+  // EXPORT_OBJ_ISOSURFACE:
+  /// Writes out a level of detail of the isosurface in Wavefront OBJ format
+  bool export_obj_isosurface( const boost::filesystem::path& filename,
+                              const std::string& name,
+                              size_t level = 0 );
 
   // EXPORT_STL_ASCII_ISOSURFACE:
-  /// Writes out an isosurface in ASCII STL file format
+  /// Writes out a level of detail of the isosurface in ASCII STL file format
   bool export_stl_ascii_isosurface( const boost::filesystem::path& filename,
-                                    const std::string& name );
+                                    const std::string& name,
+                                    size_t level = 0 );
 
   // EXPORT_STL_BINARY_ISOSURFACE:
-  /// Writes out an isosurface in Binary STL file format
+  /// Writes out a level of detail of the isosurface in Binary STL file format
   bool export_stl_binary_isosurface( const boost::filesystem::path& filename,
-                                     const std::string& name );
+                                     const std::string& name,
+                                     size_t level = 0 );
 
   typedef boost::signals2::signal< void (double) > update_progress_signal_type;
 
@@ -0,0 +1,666 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+*/
+
+// STL includes
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <queue>
+
+// Core includes
+#include <Core/Isosurface/IsosurfaceDecimator.h>
+#include <Core/Geometry/Point.h>
+#include <Core/Geometry/Vector.h>
+
+namespace Core
+{
+
+// CLASS QUADRIC:
+// Sum of the squared distances to a set of planes, stored as the upper triangle of the 
+// symmetric 4x4 matrix.
+class Quadric
+{
+public:
+  Quadric()
+  {
+    std::fill( this->q_, this->q_ + 10, 0.0 );
+  }
+
+  // Quadric of the plane n.p + d = 0, n must be of unit length
+  Quadric( const Vector& n, double d )
+  {
+    this->q_[ 0 ] = n.x() * n.x(); this->q_[ 1 ] = n.x() * n.y(); 
+    this->q_[ 2 ] = n.x() * n.z(); this->q_[ 3 ] = n.x() * d;
+    this->q_[ 4 ] = n.y() * n.y(); this->q_[ 5 ] = n.y() * n.z(); 
+    this->q_[ 6 ] = n.y() * d;
+    this->q_[ 7 ] = n.z() * n.z(); this->q_[ 8 ] = n.z() * d;
+    this->q_[ 9 ] = d * d;
+  }
+
+  Quadric& operator+=( const Quadric& q )
+  {
+    for ( int j = 0; j < 10; j++ ) this->q_[ j ] += q.q_[ j ];
+    return *this;
+  }
+
+  double evaluate( const Point& p ) const
+  {
+    double x = p.x(), y = p.y(), z = p.z();
+    return x * ( this->q_[ 0 ] * x + 2.0 * ( this->q_[ 1 ] * y + this->q_[ 2 ] * z + 
+      this->q_[ 3 ] ) ) + y * ( this->q_[ 4 ] * y + 2.0 * ( this->q_[ 5 ] * z + 
+      this->q_[ 6 ] ) ) + z * ( this->q_[ 7 ] * z + 2.0 * this->q_[ 8 ] ) + this->q_[ 9 ];
+  }
+
+  // Find the point with the smallest error, returns false if it is not unique
+  bool minimize( Point& p ) const
+  {
+    double a00 = this->q_[ 0 ], a01 = this->q_[ 1 ], a02 = this->q_[ 2 ];
+    double a11 = this->q_[ 4 ], a12 = this->q_[ 5 ], a22 = this->q_[ 7 ];
+    double c0 = a11 * a22 - a12 * a12;
+    double c1 = a02 * a12 - a01 * a22;
+    double c2 = a01 * a12 - a02 * a11;
+    double det = a00 * c0 + a01 * c1 + a02 * c2;
+    // The entries are sums of products of unit normals, so this does not depend on the scale
+    // of the mesh
+    if ( std::abs( det ) < 1e-6 ) return false;
+
+    double b0 = -this->q_[ 3 ], b1 = -this->q_[ 6 ], b2 = -this->q_[ 8 ];
+    p = Point( ( c0 * b0 + c1 * b1 + c2 * b2 ) / det,
+      ( c1 * b0 + ( a00 * a22 - a02 * a02 ) * b1 + ( a01 * a02 - a00 * a12 ) * b2 ) / det,
+      ( c2 * b0 + ( a01 * a02 - a00 * a12 ) * b1 + ( a00 * a11 - a01 * a01 ) * b2 ) / det );
+    return true;
+  }
+
+private:
+  double q_[ 10 ];
+};
+
+// FACEQUALITY:
+// Quality of a face, 1 for an equilateral triangle and 0 for a degenerate one. The normal is
+// the cross product of two of its edges.
+static double FaceQuality( const Point& p0, const Point& p1, const Point& p2, 
+  const Vector& normal )
+{
+  double edges = ( p1 - p0 ).length2() + ( p2 - p1 ).length2() + ( p0 - p2 ).length2();
+  if ( edges == 0.0 ) return 0.0;
+  return 2.0 * std::sqrt( 3.0 ) * normal.length() / edges;
+}
+
+// Faces of lower quality are only created if they replace even worse faces
+const double MIN_FACE_QUALITY_C = 0.35;
+
+// CLASS EDGECOLLAPSE:
+// Candidate collapse of vertex v1_ into vertex v0_. The stamps record the versions of the 
+// vertices at the time the cost was computed, so outdated candidates can be skipped.
+class EdgeCollapse
+{
+public:
+  EdgeCollapse( double cost, unsigned int v0, unsigned int v1, unsigned int stamp0, 
+    unsigned int stamp1 ) :
+    cost_( cost ), v0_( v0 ), v1_( v1 ), stamp0_( stamp0 ), stamp1_( stamp1 )
+  {
+  }
+
+  bool operator>( const EdgeCollapse& other ) const
+  {
+    return this->cost_ > other.cost_;
+  }
+
+  double cost_;
+  unsigned int v0_;
+  unsigned int v1_;
+  unsigned int stamp0_;
+  unsigned int stamp1_;
+};
+
+// CLASS DECIMATIONMESH:
+// Mesh that is simplified in place. Faces keep their original indices and are marked as 
+// removed, vertices that are collapsed into each other form a group in a circular list, so 
+// the faces around a vertex are the faces of all the original vertices in its group.
+class DecimationMesh
+{
+public:
+  DecimationMesh( const PointFVector& points, const UIntVector& faces );
+
+  bool decimate( size_t target_faces, double max_error, 
+    const boost::function< bool () >& check_abort );
+  void extract( PointFVector& points, UIntVector& faces, UIntVector& point_map ) const;
+
+private:
+  void collect_faces( unsigned int v, UIntVector& faces ) const;
+  void collect_neighbors( unsigned int v, const UIntVector& faces, 
+    UIntVector& neighbors ) const;
+  double compute_collapse( unsigned int v0, unsigned int v1, Point& position ) const;
+  bool keeps_topology( unsigned int v0, unsigned int v1 );
+  bool keeps_orientation( const UIntVector& faces, unsigned int v, unsigned int other, 
+    const Point& position ) const;
+  bool keeps_orientation( unsigned int v0, unsigned int v1, const Point& position ) const;
+  bool find_edge_position( unsigned int v0, unsigned int v1, double max_cost, 
+    Point& position ) const;
+  void collapse( unsigned int v0, unsigned int v1, const Point& position );
+  void add_collapses( unsigned int v );
+  bool add_all_collapses( const boost::function< bool () >& check_abort );
+
+  enum vertex_state_type
+  {
+    FREE_E = 0,
+    LOCKED_E,
+    REMOVED_E
+  };
+
+  PointFVector points_;
+  UIntVector faces_;
+  UCharVector face_removed_;
+  size_t num_faces_;
+
+  std::vector< Quadric > quadrics_;
+  UCharVector vertex_state_;
+  UIntVector stamps_;
+
+  // Faces of each original vertex
+  UIntVector vertex_face_offsets_;
+  UIntVector vertex_faces_;
+  // Next vertex in the group of vertices that were collapsed together
+  UIntVector next_in_group_;
+
+  std::priority_queue< EdgeCollapse, std::vector< EdgeCollapse >, 
+    std::greater< EdgeCollapse > > collapses_;
+
+  // Buffers that are reused for each collapse
+  UIntVector faces0_;
+  UIntVector faces1_;
+  UIntVector neighbors0_;
+  UIntVector neighbors1_;
+};
+
+DecimationMesh::DecimationMesh( const PointFVector& points, const UIntVector& faces ) :
+  points_( points ),
+  faces_( faces ),
+  num_faces_( faces.size() / 3 )
+{
+  size_t num_points = points.size();
+  this->faces_.resize( this->num_faces_ * 3 );
+  this->face_removed_.resize( this->num_faces_, 0 );
+  this->quadrics_.resize( num_points );
+  this->vertex_state_.resize( num_points, FREE_E );
+  this->stamps_.resize( num_points, 0 );
+  this->next_in_group_.resize( num_points );
+  for ( size_t j = 0; j < num_points; j++ )
+  {
+    this->next_in_group_[ j ] = static_cast< unsigned int >( j );
+  }
+
+  // Build the list of faces per vertex and the quadrics of the planes of the faces
+  this->vertex_face_offsets_.resize( num_points + 1, 0 );
+  size_t num_faces = this->num_faces_;
+  for ( size_t f = 0; f < num_faces; f++ )
+  {
+    const unsigned int* face = &this->faces_[ 3 * f ];
+    if ( face[ 0 ] == face[ 1 ] || face[ 1 ] == face[ 2 ] || face[ 0 ] == face[ 2 ] )
+    {
+      this->face_removed_[ f ] = 1;
+      this->num_faces_--;
+      continue;
+    }
+
+    for ( int k = 0; k < 3; k++ ) this->vertex_face_offsets_[ face[ k ] + 1 ]++;
+
+    Point p0( this->points_[ face[ 0 ] ] );
+    Vector n = Cross( Point( this->points_[ face[ 1 ] ] ) - p0, 
+      Point( this->points_[ face[ 2 ] ] ) - p0 );
+    if ( n.length() > 0.0 )
+    {
+      n.normalize();
+      Quadric q( n, -Dot( n, p0 ) );
+      for ( int k = 0; k < 3; k++ ) this->quadrics_[ face[ k ] ] += q;
+    }
+  }
+
+  for ( size_t j = 0; j < num_points; j++ )
+  {
+    this->vertex_face_offsets_[ j + 1 ] += this->vertex_face_offsets_[ j ];
+  }
+  this->vertex_faces_.resize( this->vertex_face_offsets_[ num_points ] );
+  UIntVector fill( this->vertex_face_offsets_.begin(), this->vertex_face_offsets_.end() - 1 );
+  for ( size_t f = 0; f < num_faces; f++ )
+  {
+    if ( this->face_removed_[ f ] ) continue;
+    for ( int k = 0; k < 3; k++ )
+    {
+      this->vertex_faces_[ fill[ this->faces_[ 3 * f + k ] ]++ ] = static_cast< unsigned int >( f );
+    }
+  }
+
+  // Lock the vertices on the border of the mesh or on non-manifold edges. Every edge around
+  // such a vertex does not have exactly two faces.
+  for ( size_t j = 0; j < num_points; j++ )
+  {
+    unsigned int v = static_cast< unsigned int >( j );
+    this->collect_faces( v, this->faces0_ );
+    this->neighbors0_.clear();
+    for ( size_t i = 0; i < this->faces0_.size(); i++ )
+    {
+      const unsigned int* face = &this->faces_[ 3 * this->faces0_[ i ] ];
+      for ( int k = 0; k < 3; k++ )
+      {
+        if ( face[ k ] != v ) this->neighbors0_.push_back( face[ k ] );
+      }
+    }
+    std::sort( this->neighbors0_.begin(), this->neighbors0_.end() );
+    
+    for ( size_t i = 0; i < this->neighbors0_.size(); )
+    {
+      size_t count = 1;
+      while ( i + count < this->neighbors0_.size() && 
+        this->neighbors0_[ i + count ] == this->neighbors0_[ i ] ) count++;
+      if ( count != 2 )
+      {
+        this->vertex_state_[ j ] = LOCKED_E;
+        break;
+      }
+      i += count;
+    }
+  }
+}
+
+void DecimationMesh::collect_faces( unsigned int v, UIntVector& faces ) const
+{
+  faces.clear();
+  unsigned int u = v;
+  do
+  {
+    for ( unsigned int i = this->vertex_face_offsets_[ u ]; 
+      i < this->vertex_face_offsets_[ u + 1 ]; i++ )
+    {
+      unsigned int f = this->vertex_faces_[ i ];
+      if ( !this->face_removed_[ f ] ) faces.push_back( f );
+    }
+    u = this->next_in_group_[ u ];
+  }
+  while ( u != v );
+}
+
+void DecimationMesh::collect_neighbors( unsigned int v, const UIntVector& faces,
+  UIntVector& neighbors ) const
+{
+  neighbors.clear();
+  for ( size_t i = 0; i < faces.size(); i++ )
+  {
+    const unsigned int* face = &this->faces_[ 3 * faces[ i ] ];
+    for ( int k = 0; k < 3; k++ )
+    {
+      if ( face[ k ] != v ) neighbors.push_back( face[ k ] );
+    }
+  }
+  std::sort( neighbors.begin(), neighbors.end() );
+  neighbors.erase( std::unique( neighbors.begin(), neighbors.end() ), neighbors.end() );
+}
+
+double DecimationMesh::compute_collapse( unsigned int v0, unsigned int v1, 
+  Point& position ) const
+{
+  Quadric q = this->quadrics_[ v0 ];
+  q += this->quadrics_[ v1 ];
+
+  Point p0( this->points_[ v0 ] );
+  Point p1( this->points_[ v1 ] );
+  Point mid = Point( ( Vector( p0 ) + Vector( p1 ) ) * 0.5 );
+
+  // Use the optimal position, unless the planes are nearly parallel and it lies far away
+  // from the edge
+  if ( q.minimize( position ) && ( position - mid ).length2() <= ( p1 - p0 ).length2() )
+  {
+    return std::max( q.evaluate( position ), 0.0 );
+  }
+
+  position = p0;
+  double cost = q.evaluate( p0 );
+  double cost1 = q.evaluate( p1 );
+  if ( cost1 < cost )
+  {
+    cost = cost1;
+    position = p1;
+  }
+  double cost_mid = q.evaluate( mid );
+  if ( cost_mid < cost )
+  {
+    cost = cost_mid;
+    position = mid;
+  }
+  return std::max( cost, 0.0 );
+}
+
+bool DecimationMesh::keeps_orientation( const UIntVector& faces, unsigned int v, 
+  unsigned int other, const Point& position ) const
+{
+  for ( size_t i = 0; i < faces.size(); i++ )
+  {
+    const unsigned int* face = &this->faces_[ 3 * faces[ i ] ];
+    // Faces with both vertices are removed by the collapse
+    if ( face[ 0 ] == other || face[ 1 ] == other || face[ 2 ] == other ) continue;
+
+    Point p[ 3 ], q[ 3 ];
+    for ( int k = 0; k < 3; k++ )
+    {
+      p[ k ] = Point( this->points_[ face[ k ] ] );
+      q[ k ] = face[ k ] == v ? position : p[ k ];
+    }
+    Vector n_old = Cross( p[ 1 ] - p[ 0 ], p[ 2 ] - p[ 0 ] );
+    Vector n_new = Cross( q[ 1 ] - q[ 0 ], q[ 2 ] - q[ 0 ] );
+    if ( Dot( n_old, n_new ) <= 0.0 ) return false;
+
+    // Do not create thin faces, these block later collapses and fold over easily
+    double quality = FaceQuality( q[ 0 ], q[ 1 ], q[ 2 ], n_new );
+    if ( quality < MIN_FACE_QUALITY_C && quality < FaceQuality( p[ 0 ], p[ 1 ], p[ 2 ], n_old ) )
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool DecimationMesh::keeps_topology( unsigned int v0, unsigned int v1 )
+{
+  this->collect_faces( v0, this->faces0_ );
+  this->collect_faces( v1, this->faces1_ );
+
+  // An interior edge of a manifold mesh has two faces
+  size_t shared_faces = 0;
+  for ( size_t i = 0; i < this->faces0_.size(); i++ )
+  {
+    const unsigned int* face = &this->faces_[ 3 * this->faces0_[ i ] ];
+    if ( face[ 0 ] == v1 || face[ 1 ] == v1 || face[ 2 ] == v1 ) shared_faces++;
+  }
+  if ( shared_faces != 2 ) return false;
+
+  // Do not collapse the last faces of a closed component, e.g. a tetrahedron
+  if ( this->faces0_.size() + this->faces1_.size() < 7 ) return false;
+
+  // Link condition: the vertices only share the two vertices opposite to the edge, otherwise 
+  // the collapse would pinch the surface
+  this->collect_neighbors( v0, this->faces0_, this->neighbors0_ );
+  this->collect_neighbors( v1, this->faces1_, this->neighbors1_ );
+  size_t shared_neighbors = 0;
+  UIntVector::const_iterator it0 = this->neighbors0_.begin();
+  UIntVector::const_iterator it1 = this->neighbors1_.begin();
+  while ( it0 != this->neighbors0_.end() && it1 != this->neighbors1_.end() )
+  {
+    if ( *it0 < *it1 ) ++it0;
+    else if ( *it1 < *it0 ) ++it1;
+    else
+    {
+      shared_neighbors++;
+      ++it0;
+      ++it1;
+    }
+  }
+  return shared_neighbors == 2;
+}
+
+bool DecimationMesh::keeps_orientation( unsigned int v0, unsigned int v1, 
+  const Point& position ) const
+{
+  // NOTE: faces0_ and faces1_ hold the faces of the vertices from keeps_topology
+  return this->keeps_orientation( this->faces0_, v0, v1, position ) &&
+    this->keeps_orientation( this->faces1_, v1, v0, position );
+}
+
+bool DecimationMesh::find_edge_position( unsigned int v0, unsigned int v1, double max_cost,
+  Point& position ) const
+{
+  Quadric q = this->quadrics_[ v0 ];
+  q += this->quadrics_[ v1 ];
+
+  Point p0( this->points_[ v0 ] );
+  Point p1( this->points_[ v1 ] );
+  Point candidates[ 3 ] = { p0, p1, Point( ( Vector( p0 ) + Vector( p1 ) ) * 0.5 ) };
+  double costs[ 3 ];
+  for ( int k = 0; k < 3; k++ ) costs[ k ] = q.evaluate( candidates[ k ] );
+
+  // Try the candidates in order of increasing cost
+  for ( int n = 0; n < 3; n++ )
+  {
+    int best = -1;
+    for ( int k = 0; k < 3; k++ )
+    {
+      if ( costs[ k ] <= max_cost && ( best < 0 || costs[ k ] < costs[ best ] ) ) best = k;
+    }
+    if ( best < 0 ) return false;
+    if ( this->keeps_orientation( v0, v1, candidates[ best ] ) )
+    {
+      position = candidates[ best ];
+      return true;
+    }
+    costs[ best ] = std::numeric_limits< double >::max();
+  }
+  return false;
+}
+
+void DecimationMesh::collapse( unsigned int v0, unsigned int v1, const Point& position )
+{
+  // NOTE: faces1_ still holds the faces of v1 from keeps_topology
+  for ( size_t i = 0; i < this->faces1_.size(); i++ )
+  {
+    unsigned int f = this->faces1_[ i ];
+    unsigned int* face = &this->faces_[ 3 * f ];
+    if ( face[ 0 ] == v0 || face[ 1 ] == v0 || face[ 2 ] == v0 )
+    {
+      this->face_removed_[ f ] = 1;
+      this->num_faces_--;
+      continue;
+    }
+    for ( int k = 0; k < 3; k++ )
+    {
+      if ( face[ k ] == v1 ) face[ k ] = v0;
+    }
+  }
+
+  this->points_[ v0 ] = PointF( position );
+  this->quadrics_[ v0 ] += this->quadrics_[ v1 ];
+  std::swap( this->next_in_group_[ v0 ], this->next_in_group_[ v1 ] );
+  this->vertex_state_[ v1 ] = REMOVED_E;
+  this->stamps_[ v0 ]++;
+
+  this->add_collapses( v0 );
+}
+
+void DecimationMesh::add_collapses( unsigned int v )
+{
+  this->collect_faces( v, this->faces0_ );
+  this->collect_neighbors( v, this->faces0_, this->neighbors0_ );
+  for ( size_t i = 0; i < this->neighbors0_.size(); i++ )
+  {
+    unsigned int u = this->neighbors0_[ i ];
+    if ( this->vertex_state_[ u ] != FREE_E ) continue;
+    Point position;
+    double cost = this->compute_collapse( v, u, position );
+    this->collapses_.push( EdgeCollapse( cost, v, u, this->stamps_[ v ], this->stamps_[ u ] ) );
+  }
+}
+
+bool DecimationMesh::add_all_collapses( const boost::function< bool () >& check_abort )
+{
+  size_t num_points = this->points_.size();
+  for ( size_t j = 0; j < num_points; j++ )
+  {
+    unsigned int v = static_cast< unsigned int >( j );
+    if ( this->vertex_state_[ j ] != FREE_E ) continue;
+
+    // Add each edge once
+    this->collect_faces( v, this->faces0_ );
+    this->collect_neighbors( v, this->faces0_, this->neighbors0_ );
+    for ( size_t i = 0; i < this->neighbors0_.size(); i++ )
+    {
+      unsigned int u = this->neighbors0_[ i ];
+      if ( u < v || this->vertex_state_[ u ] != FREE_E ) continue;
+      Point position;
+      double cost = this->compute_collapse( v, u, position );
+      this->collapses_.push( EdgeCollapse( cost, v, u, this->stamps_[ v ], 
+        this->stamps_[ u ] ) );
+    }
+
+    if ( ( j & 0xffff ) == 0 && !check_abort.empty() && check_abort() ) return false;
+  }
+  return true;
+}
+
+bool DecimationMesh::decimate( size_t target_faces, double max_error, 
+  const boost::function< bool () >& check_abort )
+{
+  double max_cost = max_error > 0.0 ? max_error * max_error : 
+    std::numeric_limits< double >::max();
+  size_t count = 0;
+  bool done = false;
+
+  // Collapses that are rejected are only retried when the faces around them change. Once all
+  // candidates are used up, the remaining edges are tried again as long as this still removes
+  // a reasonable number of faces.
+  while ( !done )
+  {
+    size_t start_faces = this->num_faces_;
+    if ( !this->add_all_collapses( check_abort ) ) return false;
+
+    while ( !this->collapses_.empty() && this->num_faces_ > target_faces )
+    {
+      if ( ( ++count & 0xffff ) == 0 && !check_abort.empty() && check_abort() ) return false;
+
+      EdgeCollapse edge = this->collapses_.top();
+      this->collapses_.pop();
+      if ( this->vertex_state_[ edge.v0_ ] != FREE_E || 
+        this->vertex_state_[ edge.v1_ ] != FREE_E ||
+        this->stamps_[ edge.v0_ ] != edge.stamp0_ || this->stamps_[ edge.v1_ ] != edge.stamp1_ )
+      {
+        continue;
+      }
+
+      if ( edge.cost_ > max_cost )
+      {
+        done = true;
+        break;
+      }
+
+      if ( !this->keeps_topology( edge.v0_, edge.v1_ ) ) continue;
+
+      // If the optimal position flips a face, fall back to a point on the edge
+      Point position;
+      this->compute_collapse( edge.v0_, edge.v1_, position );
+      if ( !this->keeps_orientation( edge.v0_, edge.v1_, position ) &&
+        !this->find_edge_position( edge.v0_, edge.v1_, max_cost, position ) )
+      {
+        continue;
+      }
+      this->collapse( edge.v0_, edge.v1_, position );
+    }
+
+    // Free the memory of the remaining candidates
+    std::priority_queue< EdgeCollapse, std::vector< EdgeCollapse >, 
+      std::greater< EdgeCollapse > >().swap( this->collapses_ );
+
+    if ( this->num_faces_ <= target_faces || 
+      start_faces - this->num_faces_ < start_faces / 100 )
+    {
+      done = true;
+    }
+  }
+
+  return true;
+}
+
+void DecimationMesh::extract( PointFVector& points, UIntVector& faces, 
+  UIntVector& point_map ) const
+{
+  points.clear();
+  faces.clear();
+  faces.reserve( this->num_faces_ * 3 );
+
+  // Number the remaining vertices in the order in which they are first used by the faces, 
+  // which keeps the vertices of neighboring faces close together
+  UIntVector& new_index = point_map;
+  new_index.assign( this->points_.size(), std::numeric_limits< unsigned int >::max() );
+  size_t num_faces = this->face_removed_.size();
+  for ( size_t f = 0; f < num_faces; f++ )
+  {
+    if ( this->face_removed_[ f ] ) continue;
+    for ( int k = 0; k < 3; k++ )
+    {
+      unsigned int v = this->faces_[ 3 * f + k ];
+      if ( new_index[ v ] == std::numeric_limits< unsigned int >::max() )
+      {
+        new_index[ v ] = static_cast< unsigned int >( points.size() );
+        points.push_back( this->points_[ v ] );
+      }
+      faces.push_back( new_index[ v ] );
+    }
+  }
+}
+
+bool IsosurfaceDecimator::Decimate( const PointFVector& points, const UIntVector& faces, 
+  size_t target_faces, double max_error, PointFVector& decimated_points, 
+  UIntVector& decimated_faces, boost::function< bool () > check_abort )
+{
+  UIntVector point_map;
+  return Decimate( points, faces, target_faces, max_error, decimated_points, decimated_faces,
+    point_map, check_abort );
+}
+
+bool IsosurfaceDecimator::Decimate( const PointFVector& points, const UIntVector& faces, 
+  size_t target_faces, double max_error, PointFVector& decimated_points, 
+  UIntVector& decimated_faces, UIntVector& point_map, boost::function< bool () > check_abort )
+{
+  DecimationMesh mesh( points, faces );
+  if ( target_faces > 0 || max_error > 0.0 )
+  {
+    if ( !mesh.decimate( target_faces, max_error, check_abort ) ) return false;
+  }
+  mesh.extract( decimated_points, decimated_faces, point_map );
+  return true;
+}
+
+void IsosurfaceDecimator::ComputeNormals( const PointFVector& points, const UIntVector& faces,
+  VectorFVector& normals )
+{
+  normals.assign( points.size(), VectorF( 0, 0, 0 ) );
+  for ( size_t i = 0; i + 2 < faces.size(); i += 3 )
+  {
+    const PointF& p1 = points[ faces[ i ] ];
+    const PointF& p2 = points[ faces[ i + 1 ] ];
+    const PointF& p3 = points[ faces[ i + 2 ] ];
+    VectorF n = Cross( p3 - p2, p1 - p2 );
+    normals[ faces[ i ] ] += n;
+    normals[ faces[ i + 1 ] ] += n;
+    normals[ faces[ i + 2 ] ] += n;
+  }
+
+  for ( size_t j = 0; j < normals.size(); j++ )
+  {
+    normals[ j ].normalize();
+  }
+}
+
+} // end namespace Core
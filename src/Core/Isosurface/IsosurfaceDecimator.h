@@ -0,0 +1,74 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef CORE_ISOSURFACE_ISOSURFACEDECIMATOR_H
+#define CORE_ISOSURFACE_ISOSURFACEDECIMATOR_H
+
+// Boost includes
+#include <boost/function.hpp>
+
+// Core includes
+#include <Core/Isosurface/Isosurface.h>
+
+namespace Core
+{
+
+// Quadric error mesh simplification (Garland and Heckbert) for isosurfaces
+class IsosurfaceDecimator
+{
+public:
+  // DECIMATE:
+  /// Simplify a triangle mesh by collapsing edges in order of their quadric error, the sum of
+  /// squared distances of the new vertex to the planes of the original faces around it.
+  /// Collapsing stops when the mesh has no more than target_faces faces, or when the next 
+  /// collapse would have an error larger than max_error squared. Zero disables either bound.
+  /// Vertices on the border of an open mesh or on non-manifold edges are kept in place, and
+  /// collapses that would flip a face or change the topology are skipped. The orientation of
+  /// the faces is preserved. Returns false if check_abort returned true.
+  static bool Decimate( const PointFVector& points, const UIntVector& faces, 
+    size_t target_faces, double max_error, PointFVector& decimated_points, 
+    UIntVector& decimated_faces, boost::function< bool () > check_abort );
+
+  /// Same as above, point_map receives the index in the decimated mesh of each point of the 
+  /// original mesh, or std::numeric_limits< unsigned int >::max() if the point was removed.
+  /// Points on the border of the mesh keep their position, hence meshes that share a border
+  /// can be decimated separately and joined afterwards.
+  static bool Decimate( const PointFVector& points, const UIntVector& faces, 
+    size_t target_faces, double max_error, PointFVector& decimated_points, 
+    UIntVector& decimated_faces, UIntVector& point_map, boost::function< bool () > check_abort );
+
+  // COMPUTE_NORMALS:
+  /// Compute one normal per vertex, the normalized sum of the normals of the faces around it
+  /// weighted by their area.
+  static void ComputeNormals( const PointFVector& points, const UIntVector& faces,
+    VectorFVector& normals );
+};
+
+} // end namespace Core
+
+#endif
@@ -28,13 +28,27 @@
 
 #include <Core/Isosurface/IsosurfaceExporter.h>
 #include <Core/Geometry/Point.h>
+#include <Core/Utils/Parallel.h>
 
 #include <boost/filesystem.hpp>
 #include <boost/shared_array.hpp>
+#include <boost/bind.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
 
+#include <zlib.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
 #include <fstream>
 #include <string>
 
+#ifdef _WIN32
+#define snprintf _snprintf
+#endif
+
 namespace Core
 {
 
@@ -58,6 +72,154 @@ computeFaceNormal(const PointF& p1, const PointF& p2, const PointF& p3)
   return normal;
 }
 
+static bool IsLittleEndian()
+{
+  unsigned short test = 0xFF;
+  unsigned char* test_ptr = reinterpret_cast<unsigned char*>( &test );
+  return test_ptr[ 0 ] != 0;
+}
+
+// CLASS ISOSURFACEFILEWRITER:
+// Buffered writer used by all the exporters. Numbers are formatted directly into a large buffer
+// instead of going through iostreams, and the buffer is written to the file in large blocks.
+
+class IsosurfaceFileWriter : public boost::noncopyable
+{
+public:
+  explicit IsosurfaceFileWriter( const boost::filesystem::path& filename ) :
+    file_( filename.string().c_str(), std::ios::out | std::ios::binary ),
+    buffer_( BUFFER_SIZE_C ),
+    used_( 0 ),
+    little_endian_( IsLittleEndian() )
+  {
+  }
+
+  bool is_open() const
+  {
+    return this->file_.is_open();
+  }
+
+  // WRITE:
+  // Write raw bytes
+  void write( const void* data, size_t size )
+  {
+    const char* bytes = static_cast< const char* >( data );
+    if ( this->used_ + size > BUFFER_SIZE_C )
+    {
+      this->flush();
+      if ( size > BUFFER_SIZE_C )
+      {
+        this->file_.write( bytes, size );
+        return;
+      }
+    }
+    std::memcpy( &this->buffer_[ this->used_ ], bytes, size );
+    this->used_ += size;
+  }
+
+  void write_text( const std::string& text )
+  {
+    this->write( text.data(), text.size() );
+  }
+
+  void write_char( char c )
+  {
+    this->reserve( 1 );
+    this->buffer_[ this->used_++ ] = c;
+  }
+
+  // WRITE_NUMBER:
+  // Write a number as text
+  void write_number( size_t value )
+  {
+    char digits[ 20 ];
+    int num_digits = 0;
+    do
+    {
+      digits[ num_digits++ ] = static_cast< char >( '0' + value % 10 );
+      value /= 10;
+    } 
+    while ( value != 0 );
+
+    this->reserve( num_digits );
+    while ( num_digits > 0 )
+    {
+      this->buffer_[ this->used_++ ] = digits[ --num_digits ];
+    }
+  }
+
+  // Floats are written like an ostream would, in general or in fixed notation
+  void write_number( float value, bool fixed = false )
+  {
+    const int MAX_LENGTH_C = 64;
+    this->reserve( MAX_LENGTH_C );
+    char* text = &this->buffer_[ this->used_ ];
+    int length = snprintf( text, MAX_LENGTH_C, fixed ? "%f" : "%g", value );
+    if ( length < 0 ) return;
+
+    // The decimal point of the locale may be a comma
+    std::replace( text, text + length, ',', '.' );
+    this->used_ += length;
+  }
+
+  // WRITE_BIG_ENDIAN:
+  // Write values in big endian byte order
+  template< class T >
+  void write_big_endian( T value )
+  {
+    char* bytes = reinterpret_cast< char* >( &value );
+    if ( this->little_endian_ ) std::reverse( bytes, bytes + sizeof( T ) );
+    this->write( bytes, sizeof( T ) );
+  }
+
+  template< class T >
+  void write_big_endian( const T* values, size_t count )
+  {
+    if ( !this->little_endian_ )
+    {
+      this->write( values, count * sizeof( T ) );
+      return;
+    }
+
+    for ( size_t i = 0; i < count; i++ )
+    {
+      this->write_big_endian( values[ i ] );
+    }
+  }
+
+  // CLOSE:
+  // Write the remaining data and close the file. Returns whether all the data was written.
+  bool close()
+  {
+    this->flush();
+    this->file_.close();
+    return !this->file_.fail();
+  }
+
+private:
+  void reserve( size_t size )
+  {
+    if ( this->used_ + size > BUFFER_SIZE_C ) this->flush();
+  }
+
+  void flush()
+  {
+    if ( this->used_ > 0 )
+    {
+      this->file_.write( &this->buffer_[ 0 ], this->used_ );
+      this->used_ = 0;
+    }
+  }
+
+  std::ofstream file_;
+  std::vector< char > buffer_;
+  size_t used_;
+  bool little_endian_;
+
+  const static size_t BUFFER_SIZE_C;
+};
+
+const size_t IsosurfaceFileWriter::BUFFER_SIZE_C = 1 << 20;
 
 bool IsosurfaceExporter::ExportLegacy( const boost::filesystem::path& path,
                                        const std::string& file_prefix,
@@ -67,8 +229,7 @@ bool IsosurfaceExporter::ExportLegacy( const boost::filesystem::path& path,
                                      )
 {
   // Write points to .pts file
-  boost::filesystem::path points_path = path / ( file_prefix + ".pts" );
-  std::ofstream pts_file( points_path.string().c_str() );
+  IsosurfaceFileWriter pts_file( path / ( file_prefix + ".pts" ) );
   if ( ! pts_file.is_open() )
   {
     return false;
@@ -76,13 +237,20 @@ bool IsosurfaceExporter::ExportLegacy( const boost::filesystem::path& path,
 
   for ( auto &pt: points )
   {
-    pts_file << pt.x() << " " << pt.y() << " " << pt.z() << std::endl;
+    pts_file.write_number( pt.x() );
+    pts_file.write_char( ' ' );
+    pts_file.write_number( pt.y() );
+    pts_file.write_char( ' ' );
+    pts_file.write_number( pt.z() );
+    pts_file.write_char( '\n' );
+  }
+  if ( ! pts_file.close() )
+  {
+    return false;
   }
-  pts_file.close();
 
   // Write faces to .fac file
-  boost::filesystem::path faces_path = path / ( file_prefix + ".fac" );
-  std::ofstream fac_file( faces_path.string().c_str() );
+  IsosurfaceFileWriter fac_file( path / ( file_prefix + ".fac" ) );
   if ( ! fac_file.is_open() )
   {
     return false;
@@ -90,28 +258,36 @@ bool IsosurfaceExporter::ExportLegacy( const boost::filesystem::path& path,
 
   for ( size_t i = 0; i + 2 < faces.size(); i += 3 )
   {
-    fac_file << faces[ i ] << " " <<
-                faces[ i + 1 ] << " " <<
-                faces[ i + 2 ] << std::endl;
+    fac_file.write_number( static_cast< size_t >( faces[ i ] ) );
+    fac_file.write_char( ' ' );
+    fac_file.write_number( static_cast< size_t >( faces[ i + 1 ] ) );
+    fac_file.write_char( ' ' );
+    fac_file.write_number( static_cast< size_t >( faces[ i + 2 ] ) );
+    fac_file.write_char( '\n' );
+  }
+  if ( ! fac_file.close() )
+  {
+    return false;
   }
-  fac_file.close();
 
   // Write values to .val file
   if ( values.size() > 0 )
   {
-    boost::filesystem::path values_path = path / ( file_prefix + ".val" );
-    std::ofstream val_file( values_path.string().c_str() );
+    IsosurfaceFileWriter val_file( path / ( file_prefix + ".val" ) );
     if( ! val_file.is_open() )
     {
       return false;
     }
 
-//    for ( size_t i = 0; i < this->private_->values_.size(); i++ )
     for ( auto &value: values )
     {
-      val_file << value << std::endl;
+      val_file.write_number( value );
+      val_file.write_char( '\n' );
+    }
+    if ( ! val_file.close() )
+    {
+      return false;
     }
-    val_file.close();
   }
 
   return true;
@@ -123,40 +299,424 @@ bool IsosurfaceExporter::ExportVTKASCII( const boost::filesystem::path& filename
                                          const UIntVector& faces
                                         )
 {
-  std::ofstream vtk_file( filename.string().c_str() );
+  IsosurfaceFileWriter vtk_file( filename );
   if ( ! vtk_file.is_open() )
   {
     return false;
   }
 
   // write header
-  vtk_file << "# vtk DataFile Version 3.0\n";
-  vtk_file << "vtk output\n";
+  vtk_file.write_text( "# vtk DataFile Version 3.0\n" );
+  vtk_file.write_text( "vtk output\n" );
 
-  vtk_file << "ASCII\n";
-  vtk_file << "DATASET POLYDATA\n";
-  vtk_file << "POINTS " << points.size() << " float\n";
+  vtk_file.write_text( "ASCII\n" );
+  vtk_file.write_text( "DATASET POLYDATA\n" );
+  vtk_file.write_text( "POINTS " );
+  vtk_file.write_number( points.size() );
+  vtk_file.write_text( " float\n" );
 
   for ( auto &pt : points )
   {
-    vtk_file << pt.x() << " " << pt.y() << " " << pt.z() << std::endl;
+    vtk_file.write_number( pt.x() );
+    vtk_file.write_char( ' ' );
+    vtk_file.write_number( pt.y() );
+    vtk_file.write_char( ' ' );
+    vtk_file.write_number( pt.z() );
+    vtk_file.write_char( '\n' );
   }
 
-  unsigned int num_triangles = faces.size() / 3;
-  unsigned int triangle_list_size = num_triangles * 4;
+  size_t num_triangles = faces.size() / 3;
+  size_t triangle_list_size = num_triangles * 4;
 
-  vtk_file << "\nPOLYGONS " << num_triangles << " " << triangle_list_size << std::endl;
+  vtk_file.write_text( "\nPOLYGONS " );
+  vtk_file.write_number( num_triangles );
+  vtk_file.write_char( ' ' );
+  vtk_file.write_number( triangle_list_size );
+  vtk_file.write_char( '\n' );
 
   for( size_t i = 0; i + 2 < faces.size(); i += 3 )
   {
-    vtk_file << "3 " << faces[ i ] << " " <<
-                        faces[ i + 1 ] << " " <<
-                        faces[ i + 2 ] << std::endl;
+    vtk_file.write_text( "3 " );
+    vtk_file.write_number( static_cast< size_t >( faces[ i ] ) );
+    vtk_file.write_char( ' ' );
+    vtk_file.write_number( static_cast< size_t >( faces[ i + 1 ] ) );
+    vtk_file.write_char( ' ' );
+    vtk_file.write_number( static_cast< size_t >( faces[ i + 2 ] ) );
+    vtk_file.write_char( '\n' );
   }
 
-  vtk_file.close();
+  return vtk_file.close();
+}
 
-  return true;
+// Legacy VTK file format (http://vtk.org/VTK/img/file-formats.pdf), binary data is stored in
+// big endian byte order
+bool IsosurfaceExporter::ExportVTKBinary( const boost::filesystem::path& filename,
+                                          const PointFVector& points,
+                                          const UIntVector& faces,
+                                          const FloatVector& values
+                                        )
+{
+  IsosurfaceFileWriter vtk_file( filename );
+  if ( ! vtk_file.is_open() )
+  {
+    return false;
+  }
+
+  vtk_file.write_text( "# vtk DataFile Version 3.0\n" );
+  vtk_file.write_text( "vtk output\n" );
+  vtk_file.write_text( "BINARY\n" );
+  vtk_file.write_text( "DATASET POLYDATA\n" );
+  vtk_file.write_text( "POINTS " );
+  vtk_file.write_number( points.size() );
+  vtk_file.write_text( " float\n" );
+  if ( points.size() > 0 )
+  {
+    vtk_file.write_big_endian( reinterpret_cast< const float* >( &points[ 0 ] ), 
+      3 * points.size() );
+  }
+
+  size_t num_triangles = faces.size() / 3;
+  vtk_file.write_text( "\nPOLYGONS " );
+  vtk_file.write_number( num_triangles );
+  vtk_file.write_char( ' ' );
+  vtk_file.write_number( num_triangles * 4 );
+  vtk_file.write_char( '\n' );
+  for( size_t i = 0; i + 2 < faces.size(); i += 3 )
+  {
+    vtk_file.write_big_endian( 3 );
+    vtk_file.write_big_endian( static_cast< int >( faces[ i ] ) );
+    vtk_file.write_big_endian( static_cast< int >( faces[ i + 1 ] ) );
+    vtk_file.write_big_endian( static_cast< int >( faces[ i + 2 ] ) );
+  }
+
+  if ( values.size() == points.size() && values.size() > 0 )
+  {
+    vtk_file.write_text( "\nPOINT_DATA " );
+    vtk_file.write_number( values.size() );
+    vtk_file.write_text( "\nSCALARS values float 1\nLOOKUP_TABLE default\n" );
+    vtk_file.write_big_endian( &values[ 0 ], values.size() );
+  }
+  vtk_file.write_char( '\n' );
+
+  return vtk_file.close();
+}
+
+// CLASS VTKXMLDATAARRAY:
+// Data array of a VTK XML file that is stored in the appended data section. The data is
+// produced in pieces, so arrays that are computed on the fly never exist as a whole.
+
+class VTKXMLDataArray
+{
+public:
+  typedef boost::function< void ( size_t, size_t, char* ) > fill_function_type;
+
+  VTKXMLDataArray( const std::string& type, const std::string& name, int num_components,
+    size_t size, fill_function_type fill ) :
+    type_( type ),
+    name_( name ),
+    num_components_( num_components ),
+    size_( size ),
+    fill_( fill ),
+    offset_( 0 )
+  {
+  }
+
+  // Data type, name and number of components as written in the XML header
+  std::string type_;
+  std::string name_;
+  int num_components_;
+
+  // Size of the data in bytes
+  size_t size_;
+
+  // Copy the bytes [begin, end) of the data into the given buffer
+  fill_function_type fill_;
+
+  // Offset of the array in the appended data section
+  size_t offset_;
+
+  // Compressed blocks, only used for compressed files
+  std::vector< std::vector< unsigned char > > compressed_blocks_;
+};
+
+// Size of the blocks the arrays are compressed in, which is the default size used by VTK
+static const size_t VTK_XML_BLOCK_SIZE_C = 32768;
+
+template< class T >
+static const char* GetBytes( const std::vector< T >& data )
+{
+  return data.empty() ? 0 : reinterpret_cast< const char* >( &data[ 0 ] );
+}
+
+static void CopyBytes( const char* data, size_t begin, size_t end, char* buffer )
+{
+  std::memcpy( buffer, data + begin, end - begin );
+}
+
+// The offsets of the triangles into the connectivity array, generated on the fly
+static void FillTriangleOffsets( size_t begin, size_t end, char* buffer )
+{
+  unsigned int* offsets = reinterpret_cast< unsigned int* >( buffer );
+  for ( size_t i = begin / 4; i < end / 4; i++ )
+  {
+    *offsets++ = static_cast< unsigned int >( 3 * ( i + 1 ) );
+  }
+}
+
+static void CompressBlocks( VTKXMLDataArray* data_array, size_t begin, size_t end )
+{
+  std::vector< char > buffer( VTK_XML_BLOCK_SIZE_C );
+  for ( size_t block = begin; block < end; block++ )
+  {
+    size_t block_begin = block * VTK_XML_BLOCK_SIZE_C;
+    size_t block_end = std::min( block_begin + VTK_XML_BLOCK_SIZE_C, data_array->size_ );
+    data_array->fill_( block_begin, block_end, &buffer[ 0 ] );
+
+    std::vector< unsigned char >& compressed_block = data_array->compressed_blocks_[ block ];
+    uLongf compressed_size = compressBound( static_cast< uLong >( block_end - block_begin ) );
+    compressed_block.resize( compressed_size );
+    if ( compress2( &compressed_block[ 0 ], &compressed_size, 
+      reinterpret_cast< const Bytef* >( &buffer[ 0 ] ), 
+      static_cast< uLong >( block_end - block_begin ), Z_DEFAULT_COMPRESSION ) != Z_OK )
+    {
+      compressed_size = 0;
+    }
+    compressed_block.resize( compressed_size );
+  }
+}
+
+// VTK XML PolyData format (http://vtk.org/VTK/img/file-formats.pdf). All the arrays are stored
+// in the appended data section, either raw or compressed with zlib. Compressed arrays are 
+// compressed in blocks in parallel and kept in memory until they are written, as the XML 
+// header needs the size of each array.
+bool IsosurfaceExporter::ExportVTKXML( const boost::filesystem::path& filename,
+                                       const PointFVector& points,
+                                       const UIntVector& faces,
+                                       const FloatVector& values,
+                                       bool compress
+                                     )
+{
+  size_t num_triangles = faces.size() / 3;
+  bool has_values = values.size() == points.size() && values.size() > 0;
+
+  std::vector< VTKXMLDataArray > arrays;
+  arrays.push_back( VTKXMLDataArray( "Float32", "Points", 3, points.size() * sizeof( PointF ),
+    boost::bind( &CopyBytes, GetBytes( points ), _1, _2, _3 ) ) );
+  arrays.push_back( VTKXMLDataArray( "UInt32", "connectivity", 1, 
+    3 * num_triangles * sizeof( unsigned int ), 
+    boost::bind( &CopyBytes, GetBytes( faces ), _1, _2, _3 ) ) );
+  arrays.push_back( VTKXMLDataArray( "UInt32", "offsets", 1, 
+    num_triangles * sizeof( unsigned int ), &FillTriangleOffsets ) );
+  if ( has_values )
+  {
+    arrays.push_back( VTKXMLDataArray( "Float32", "values", 1, values.size() * sizeof( float ),
+      boost::bind( &CopyBytes, GetBytes( values ), _1, _2, _3 ) ) );
+  }
+
+  // Each array starts with a header with its (compressed) size, see the VTK file formats
+  size_t offset = 0;
+  for ( size_t j = 0; j < arrays.size(); j++ )
+  {
+    VTKXMLDataArray& data_array = arrays[ j ];
+    data_array.offset_ = offset;
+    if ( compress )
+    {
+      size_t num_blocks = ( data_array.size_ + VTK_XML_BLOCK_SIZE_C - 1 ) / 
+        VTK_XML_BLOCK_SIZE_C;
+      data_array.compressed_blocks_.resize( num_blocks );
+      Parallel::For( 0, num_blocks, boost::bind( &CompressBlocks, &data_array, _1, _2 ), 16 );
+
+      offset += ( 3 + num_blocks ) * sizeof( boost::uint64_t );
+      for ( size_t block = 0; block < num_blocks; block++ )
+      {
+        if ( data_array.compressed_blocks_[ block ].empty() )
+        {
+          return false;
+        }
+        offset += data_array.compressed_blocks_[ block ].size();
+      }
+    }
+    else
+    {
+      offset += sizeof( boost::uint64_t ) + data_array.size_;
+    }
+  }
+
+  IsosurfaceFileWriter vtk_file( filename );
+  if ( ! vtk_file.is_open() )
+  {
+    return false;
+  }
+
+  vtk_file.write_text( "<?xml version=\"1.0\"?>\n" );
+  vtk_file.write_text( std::string( "<VTKFile type=\"PolyData\" version=\"1.0\" byte_order=\"" ) +
+    ( IsLittleEndian() ? "LittleEndian" : "BigEndian" ) + "\" header_type=\"UInt64\"" + 
+    ( compress ? " compressor=\"vtkZLibDataCompressor\"" : "" ) + ">\n" );
+  vtk_file.write_text( "  <PolyData>\n" );
+  vtk_file.write_text( "    <Piece NumberOfPoints=\"" );
+  vtk_file.write_number( points.size() );
+  vtk_file.write_text( "\" NumberOfVerts=\"0\" NumberOfLines=\"0\" NumberOfStrips=\"0\" "
+    "NumberOfPolys=\"" );
+  vtk_file.write_number( num_triangles );
+  vtk_file.write_text( "\">\n" );
+
+  for ( size_t j = 0; j < arrays.size(); j++ )
+  {
+    const VTKXMLDataArray& data_array = arrays[ j ];
+    if ( j == 0 ) vtk_file.write_text( "      <Points>\n" );
+    if ( j == 1 ) vtk_file.write_text( "      <Polys>\n" );
+    if ( j == 3 ) vtk_file.write_text( "      <PointData Scalars=\"values\">\n" );
+
+    vtk_file.write_text( "        <DataArray type=\"" + data_array.type_ + "\" Name=\"" + 
+      data_array.name_ + "\" NumberOfComponents=\"" );
+    vtk_file.write_number( static_cast< size_t >( data_array.num_components_ ) );
+    vtk_file.write_text( "\" format=\"appended\" offset=\"" );
+    vtk_file.write_number( data_array.offset_ );
+    vtk_file.write_text( "\"/>\n" );
+
+    if ( j == 0 ) vtk_file.write_text( "      </Points>\n" );
+    if ( j == 2 ) vtk_file.write_text( "      </Polys>\n" );
+    if ( j == 3 ) vtk_file.write_text( "      </PointData>\n" );
+  }
+  vtk_file.write_text( "    </Piece>\n" );
+  vtk_file.write_text( "  </PolyData>\n" );
+  vtk_file.write_text( "  <AppendedData encoding=\"raw\">\n   _" );
+
+  std::vector< char > buffer( VTK_XML_BLOCK_SIZE_C );
+  for ( size_t j = 0; j < arrays.size(); j++ )
+  {
+    const VTKXMLDataArray& data_array = arrays[ j ];
+    if ( compress )
+    {
+      size_t num_blocks = data_array.compressed_blocks_.size();
+      boost::uint64_t header[ 3 ] = { num_blocks, VTK_XML_BLOCK_SIZE_C, 
+        data_array.size_ - ( num_blocks > 0 ? ( num_blocks - 1 ) * VTK_XML_BLOCK_SIZE_C : 0 ) };
+      vtk_file.write( header, sizeof( header ) );
+      for ( size_t block = 0; block < num_blocks; block++ )
+      {
+        boost::uint64_t compressed_size = data_array.compressed_blocks_[ block ].size();
+        vtk_file.write( &compressed_size, sizeof( compressed_size ) );
+      }
+      for ( size_t block = 0; block < num_blocks; block++ )
+      {
+        const std::vector< unsigned char >& compressed_block = 
+          data_array.compressed_blocks_[ block ];
+        vtk_file.write( &compressed_block[ 0 ], compressed_block.size() );
+      }
+    }
+    else
+    {
+      boost::uint64_t size = data_array.size_;
+      vtk_file.write( &size, sizeof( size ) );
+      for ( size_t begin = 0; begin < data_array.size_; begin += VTK_XML_BLOCK_SIZE_C )
+      {
+        size_t end = std::min( begin + VTK_XML_BLOCK_SIZE_C, data_array.size_ );
+        data_array.fill_( begin, end, &buffer[ 0 ] );
+        vtk_file.write( &buffer[ 0 ], end - begin );
+      }
+    }
+  }
+
+  vtk_file.write_text( "\n  </AppendedData>\n" );
+  vtk_file.write_text( "</VTKFile>\n" );
+
+  return vtk_file.close();
+}
+
+// Binary PLY format (http://paulbourke.net/dataformats/ply/) in the byte order of this machine
+bool IsosurfaceExporter::ExportPLYBinary( const boost::filesystem::path& filename,
+                                          const PointFVector& points,
+                                          const UIntVector& faces,
+                                          const FloatVector& values
+                                        )
+{
+  IsosurfaceFileWriter ply_file( filename );
+  if ( ! ply_file.is_open() )
+  {
+    return false;
+  }
+
+  bool has_values = values.size() == points.size() && values.size() > 0;
+  size_t num_triangles = faces.size() / 3;
+
+  ply_file.write_text( "ply\n" );
+  ply_file.write_text( IsLittleEndian() ? "format binary_little_endian 1.0\n" : 
+    "format binary_big_endian 1.0\n" );
+  ply_file.write_text( "comment Seg3D isosurface\n" );
+  ply_file.write_text( "element vertex " );
+  ply_file.write_number( points.size() );
+  ply_file.write_text( "\nproperty float x\nproperty float y\nproperty float z\n" );
+  if ( has_values )
+  {
+    ply_file.write_text( "property float value\n" );
+  }
+  ply_file.write_text( "element face " );
+  ply_file.write_number( num_triangles );
+  ply_file.write_text( "\nproperty list uchar uint vertex_indices\n" );
+  ply_file.write_text( "end_header\n" );
+
+  if ( has_values )
+  {
+    for ( size_t i = 0; i < points.size(); i++ )
+    {
+      ply_file.write( &points[ i ], sizeof( PointF ) );
+      ply_file.write( &values[ i ], sizeof( float ) );
+    }
+  }
+  else if ( points.size() > 0 )
+  {
+    ply_file.write( &points[ 0 ], points.size() * sizeof( PointF ) );
+  }
+
+  const unsigned char TRIANGLE_SIZE_C = 3;
+  for ( size_t i = 0; i + 2 < faces.size(); i += 3 )
+  {
+    ply_file.write( &TRIANGLE_SIZE_C, 1 );
+    ply_file.write( &faces[ i ], 3 * sizeof( unsigned int ) );
+  }
+
+  return ply_file.close();
+}
+
+// Wavefront OBJ format (https://en.wikipedia.org/wiki/Wavefront_.obj_file)
+bool IsosurfaceExporter::ExportOBJ( const boost::filesystem::path& filename,
+                                    const std::string& name,
+                                    const PointFVector& points,
+                                    const UIntVector& faces
+                                  )
+{
+  IsosurfaceFileWriter obj_file( filename );
+  if ( ! obj_file.is_open() )
+  {
+    return false;
+  }
+
+  obj_file.write_text( "# Seg3D isosurface\n" );
+  obj_file.write_text( "o " + name + "\n" );
+  for ( auto &pt : points )
+  {
+    obj_file.write_text( "v " );
+    obj_file.write_number( pt.x() );
+    obj_file.write_char( ' ' );
+    obj_file.write_number( pt.y() );
+    obj_file.write_char( ' ' );
+    obj_file.write_number( pt.z() );
+    obj_file.write_char( '\n' );
+  }
+
+  // Vertex indices start at 1
+  for ( size_t i = 0; i + 2 < faces.size(); i += 3 )
+  {
+    obj_file.write_text( "f " );
+    obj_file.write_number( static_cast< size_t >( faces[ i ] ) + 1 );
+    obj_file.write_char( ' ' );
+    obj_file.write_number( static_cast< size_t >( faces[ i + 1 ] ) + 1 );
+    obj_file.write_char( ' ' );
+    obj_file.write_number( static_cast< size_t >( faces[ i + 2 ] ) + 1 );
+    obj_file.write_char( '\n' );
+  }
+
+  return obj_file.close();
 }
 
 // ASCII STL format: https://en.wikipedia.org/wiki/STL_(file_format)
@@ -166,53 +726,46 @@ bool IsosurfaceExporter::ExportSTLASCII( const boost::filesystem::path& filename
                                          const UIntVector& faces
                                        )
 {
-  std::ofstream stl_file( filename.string().c_str() );
+  IsosurfaceFileWriter stl_file( filename );
   if ( ! stl_file.is_open() )
   {
     return false;
   }
 
-  const std::string delim(" ");
-  const std::string indent_level1("  ");
-  const std::string indent_level2("    ");
-  const std::string indent_level3("      ");
-  stl_file << "solid " << name << std::endl;
+  stl_file.write_text( "solid " + name + "\n" );
 
   for( size_t i = 0; i + 2 < faces.size(); i += 3 )
   {
-    size_t vertex_index1 = faces[ i ];
-    size_t vertex_index2 = faces[ i + 1 ];
-    size_t vertex_index3 = faces[ i + 2 ];
-
     // Get vertices of face
-    PointF p1 = points[ vertex_index1 ];
-    PointF p2 = points[ vertex_index2 ];
-    PointF p3 = points[ vertex_index3 ];
-
-    boost::shared_array<float> normal = computeFaceNormal(p1, p2, p3);
+    const PointF* vertices[ 3 ] = 
+      { &points[ faces[ i ] ], &points[ faces[ i + 1 ] ], &points[ faces[ i + 2 ] ] };
+
+    boost::shared_array<float> normal = computeFaceNormal( *vertices[ 0 ], *vertices[ 1 ], 
+      *vertices[ 2 ] );
+
+    stl_file.write_text( "  facet normal " );
+    stl_file.write_number( normal[ 0 ], true );
+    stl_file.write_char( ' ' );
+    stl_file.write_number( normal[ 1 ], true );
+    stl_file.write_char( ' ' );
+    stl_file.write_number( normal[ 2 ], true );
+    stl_file.write_text( "\n    outer loop\n" );
+    for ( int j = 0; j < 3; j++ )
+    {
+      stl_file.write_text( "      vertex " );
+      stl_file.write_number( vertices[ j ]->x(), true );
+      stl_file.write_char( ' ' );
+      stl_file.write_number( vertices[ j ]->y(), true );
+      stl_file.write_char( ' ' );
+      stl_file.write_number( vertices[ j ]->z(), true );
+      stl_file.write_char( '\n' );
+    }
+    stl_file.write_text( "    endloop\n" );
+    stl_file.write_text( "  endfacet\n" );
+  }
+  stl_file.write_text( "endsolid\n" );
 
-    stl_file << indent_level1 << "facet normal " << std::fixed <<
-                                 normal[0] << delim <<
-                                 normal[1] << delim <<
-                                 normal[2] << std::endl;
-    stl_file << indent_level2 << "outer loop" << std::endl;
-    stl_file << indent_level3 << "vertex " << std::fixed << p1.x() << delim <<
-                                                            p1.y() << delim <<
-                                                            p1.z() << std::endl;
-    stl_file << indent_level3 << "vertex " << std::fixed << p2.x() << delim <<
-                                                            p2.y() << delim <<
-                                                            p2.z() << std::endl;
-    stl_file << indent_level3 << "vertex " << std::fixed << p3.x() << delim <<
-                                                            p3.y() << delim <<
-                                                            p3.z() << std::endl;
-    stl_file << indent_level2 << "endloop" << std::endl;
-    stl_file << indent_level1 << "endfacet" << std::endl;
-  }
-  stl_file << "endsolid" << std::endl;
-
-  stl_file.close();
-  
-  return true;
+  return stl_file.close();
 }
 
 // Binary STL format: https://en.wikipedia.org/wiki/STL_(file_format)
@@ -226,63 +779,41 @@ bool IsosurfaceExporter::ExportSTLBinary( const boost::filesystem::path& filenam
   const unsigned short STL_HEADER_LENGTH = 80;
   // STL binary contains unsigned ints, floats
   const unsigned short STL_FIELD_LENGTH = 4;
-  const unsigned short POINT_LEN = 3;
   const unsigned short FIELD_LEN = 12;
   const unsigned short ATTRIBUTE_BYTE_COUNT = 2;
 
-  std::ofstream stl_file( filename.string().c_str() );
+  IsosurfaceFileWriter stl_file( filename );
   if ( ! stl_file.is_open() )
   {
     return false;
   }
 
   std::string header("STL header: Seg3D isosurface to STL Binary export");
-  char* headerBuffer = const_cast<char*>(header.c_str());
-  stl_file.write(headerBuffer, STL_HEADER_LENGTH);
+  header.resize( STL_HEADER_LENGTH, ' ' );
+  stl_file.write( header.data(), STL_HEADER_LENGTH );
 
-  unsigned int numTriangles = faces.size() / 3;
-  stl_file.write(reinterpret_cast<char*>(&numTriangles), STL_FIELD_LENGTH);
+  unsigned int numTriangles = static_cast< unsigned int >( faces.size() / 3 );
+  stl_file.write( &numTriangles, STL_FIELD_LENGTH );
 
   // 0 is an acceptable value for this field
   unsigned short byteAttributeCount = 0;
 
   for ( size_t i = 0; i + 2 < faces.size(); i += 3 )
   {
-    size_t vertex_index1 = faces[ i ];
-    size_t vertex_index2 = faces[ i + 1 ];
-    size_t vertex_index3 = faces[ i + 2 ];
-
     // Get vertices of face
-    PointF p1 = points[ vertex_index1 ];
-    PointF p2 = points[ vertex_index2 ];
-    PointF p3 = points[ vertex_index3 ];
+    const PointF& p1 = points[ faces[ i ] ];
+    const PointF& p2 = points[ faces[ i + 1 ] ];
+    const PointF& p3 = points[ faces[ i + 2 ] ];
 
     boost::shared_array<float> normal = computeFaceNormal(p1, p2, p3);
-    stl_file.write(reinterpret_cast<char*>(normal.get()), FIELD_LEN);
-
-    boost::shared_array<float> vertex1(new float[POINT_LEN]);
-    vertex1[0] = p1.x();
-    vertex1[1] = p1.y();
-    vertex1[2] = p1.z();
-    stl_file.write(reinterpret_cast<char*>(vertex1.get()), FIELD_LEN);
-
-    boost::shared_array<float> vertex2(new float[POINT_LEN]);
-    vertex2[0] = p2.x();
-    vertex2[1] = p2.y();
-    vertex2[2] = p2.z();
-    stl_file.write(reinterpret_cast<char*>(vertex2.get()), FIELD_LEN);
-
-    boost::shared_array<float> vertex3(new float[POINT_LEN]);
-    vertex3[0] = p3.x();
-    vertex3[1] = p3.y();
-    vertex3[2] = p3.z();
-    stl_file.write(reinterpret_cast<char*>(vertex3.get()), FIELD_LEN);
-
-    stl_file.write(reinterpret_cast<char*>(&byteAttributeCount), ATTRIBUTE_BYTE_COUNT);
+    stl_file.write( normal.get(), FIELD_LEN );
+    stl_file.write( &p1, FIELD_LEN );
+    stl_file.write( &p2, FIELD_LEN );
+    stl_file.write( &p3, FIELD_LEN );
+    stl_file.write( &byteAttributeCount, ATTRIBUTE_BYTE_COUNT );
   }
-  stl_file.close();
 
-  return true;
+  return stl_file.close();
 }
 
 }
@@ -50,6 +50,31 @@ class IsosurfaceExporter
                               const UIntVector& faces
                             );
 
+  static bool ExportVTKBinary( const boost::filesystem::path& filename,
+                               const PointFVector& points,
+                               const UIntVector& faces,
+                               const FloatVector& values
+                             );
+
+  static bool ExportVTKXML( const boost::filesystem::path& filename,
+                            const PointFVector& points,
+                            const UIntVector& faces,
+                            const FloatVector& values,
+                            bool compress
+                          );
+
+  static bool ExportPLYBinary( const boost::filesystem::path& filename,
+                               const PointFVector& points,
+                               const UIntVector& faces,
+                               const FloatVector& values
+                             );
+
+  static bool ExportOBJ( const boost::filesystem::path& filename,
+                         const std::string& name,
+                         const PointFVector& points,
+                         const UIntVector& faces
+                       );
+
   static bool ExportSTLASCII( const boost::filesystem::path& filename,
                               const std::string& name,
                               const PointFVector& points,
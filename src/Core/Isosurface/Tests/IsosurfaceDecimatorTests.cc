@@ -0,0 +1,246 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <limits>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include <Core/Isosurface/IsosurfaceDecimator.h>
+
+using namespace Core;
+
+// Flat grid of n x n points in the plane z = 0, with the faces facing +z
+static void CreateGrid( size_t n, PointFVector& points, UIntVector& faces )
+{
+  points.clear();
+  faces.clear();
+  for ( size_t y = 0; y < n; y++ )
+  {
+    for ( size_t x = 0; x < n; x++ )
+    {
+      points.push_back( PointF( static_cast< float >( x ), static_cast< float >( y ), 0.0f ) );
+    }
+  }
+
+  for ( size_t y = 0; y + 1 < n; y++ )
+  {
+    for ( size_t x = 0; x + 1 < n; x++ )
+    {
+      unsigned int p = static_cast< unsigned int >( y * n + x );
+      unsigned int q = static_cast< unsigned int >( n );
+      faces.push_back( p ); faces.push_back( p + 1 ); faces.push_back( p + q + 1 );
+      faces.push_back( p ); faces.push_back( p + q + 1 ); faces.push_back( p + q );
+    }
+  }
+}
+
+// Closed mesh of a sphere, made by projecting a cube with n x n squares per side onto a sphere
+// with the given radius. The faces face outward.
+static void CreateSphere( size_t n, float radius, PointFVector& points, UIntVector& faces )
+{
+  points.clear();
+  faces.clear();
+  std::map< std::pair< int, std::pair< int, int > >, unsigned int > index;
+
+  int m = static_cast< int >( n );
+  for ( int side = 0; side < 6; side++ )
+  {
+    int axis = side / 2;
+    int sign = ( side % 2 ) ? 1 : -1;
+
+    std::vector< unsigned int > side_points;
+    for ( int v = 0; v <= m; v++ )
+    {
+      for ( int u = 0; u <= m; u++ )
+      {
+        int c[ 3 ];
+        c[ axis ] = sign * m;
+        c[ ( axis + 1 ) % 3 ] = 2 * u - m;
+        c[ ( axis + 2 ) % 3 ] = 2 * v - m;
+        std::pair< int, std::pair< int, int > > key( c[ 0 ], std::make_pair( c[ 1 ], c[ 2 ] ) );
+        if ( index.find( key ) == index.end() )
+        {
+          float length = std::sqrt( static_cast< float >( c[ 0 ] * c[ 0 ] + c[ 1 ] * c[ 1 ] + 
+            c[ 2 ] * c[ 2 ] ) );
+          index[ key ] = static_cast< unsigned int >( points.size() );
+          points.push_back( PointF( radius * c[ 0 ] / length, radius * c[ 1 ] / length, 
+            radius * c[ 2 ] / length ) );
+        }
+        side_points.push_back( index[ key ] );
+      }
+    }
+
+    for ( int v = 0; v < m; v++ )
+    {
+      for ( int u = 0; u < m; u++ )
+      {
+        unsigned int p00 = side_points[ v * ( m + 1 ) + u ];
+        unsigned int p10 = side_points[ v * ( m + 1 ) + u + 1 ];
+        unsigned int p01 = side_points[ ( v + 1 ) * ( m + 1 ) + u ];
+        unsigned int p11 = side_points[ ( v + 1 ) * ( m + 1 ) + u + 1 ];
+        // The sides with a negative sign are mirrored
+        if ( sign < 0 ) std::swap( p10, p01 );
+        faces.push_back( p00 ); faces.push_back( p10 ); faces.push_back( p11 );
+        faces.push_back( p00 ); faces.push_back( p11 ); faces.push_back( p01 );
+      }
+    }
+  }
+}
+
+// Check that every edge of the mesh has exactly two faces, which use it in opposite directions
+static bool IsClosed( const UIntVector& faces )
+{
+  std::map< std::pair< unsigned int, unsigned int >, int > edges;
+  for ( size_t j = 0; j + 2 < faces.size(); j += 3 )
+  {
+    for ( int k = 0; k < 3; k++ )
+    {
+      edges[ std::make_pair( faces[ j + k ], faces[ j + ( k + 1 ) % 3 ] ) ]++;
+    }
+  }
+
+  std::map< std::pair< unsigned int, unsigned int >, int >::const_iterator it;
+  for ( it = edges.begin(); it != edges.end(); ++it )
+  {
+    if ( it->second != 1 ) return false;
+    if ( edges.find( std::make_pair( it->first.second, it->first.first ) ) == edges.end() )
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+TEST(IsosurfaceDecimatorTest, NoBoundsKeepsMesh)
+{
+  PointFVector points, decimated_points;
+  UIntVector faces, decimated_faces;
+  CreateGrid( 10, points, faces );
+
+  ASSERT_TRUE( IsosurfaceDecimator::Decimate( points, faces, 0, 0.0, decimated_points, 
+    decimated_faces, boost::function< bool () >() ) );
+  ASSERT_EQ( decimated_points.size(), points.size() );
+  ASSERT_EQ( decimated_faces.size(), faces.size() );
+}
+
+TEST(IsosurfaceDecimatorTest, TargetFacesOfClosedMesh)
+{
+  PointFVector points, decimated_points;
+  UIntVector faces, decimated_faces;
+  CreateSphere( 16, 10.0f, points, faces );
+  ASSERT_TRUE( IsClosed( faces ) );
+
+  size_t target_faces = faces.size() / 3 / 4;
+  ASSERT_TRUE( IsosurfaceDecimator::Decimate( points, faces, target_faces, 0.0, 
+    decimated_points, decimated_faces, boost::function< bool () >() ) );
+  ASSERT_LE( decimated_faces.size() / 3, target_faces );
+  ASSERT_GT( decimated_faces.size(), 0u );
+  ASSERT_TRUE( IsClosed( decimated_faces ) );
+
+  // The points stay close to the sphere
+  for ( size_t j = 0; j < decimated_points.size(); j++ )
+  {
+    const PointF& p = decimated_points[ j ];
+    float radius = std::sqrt( p.x() * p.x() + p.y() * p.y() + p.z() * p.z() );
+    ASSERT_NEAR( radius, 10.0f, 0.5f );
+  }
+}
+
+TEST(IsosurfaceDecimatorTest, MaxError)
+{
+  PointFVector points, small_error_points, large_error_points;
+  UIntVector faces, small_error_faces, large_error_faces;
+  CreateSphere( 16, 10.0f, points, faces );
+
+  ASSERT_TRUE( IsosurfaceDecimator::Decimate( points, faces, 0, 0.001, small_error_points, 
+    small_error_faces, boost::function< bool () >() ) );
+  ASSERT_TRUE( IsosurfaceDecimator::Decimate( points, faces, 0, 0.1, large_error_points, 
+    large_error_faces, boost::function< bool () >() ) );
+  ASSERT_LE( small_error_faces.size(), faces.size() );
+  ASSERT_LT( large_error_faces.size(), small_error_faces.size() );
+  ASSERT_TRUE( IsClosed( small_error_faces ) );
+  ASSERT_TRUE( IsClosed( large_error_faces ) );
+}
+
+TEST(IsosurfaceDecimatorTest, BorderIsKept)
+{
+  const size_t n = 20;
+  PointFVector points, decimated_points;
+  UIntVector faces, decimated_faces, point_map;
+  CreateGrid( n, points, faces );
+
+  // A flat mesh can be decimated without error, down to the points on its border
+  ASSERT_TRUE( IsosurfaceDecimator::Decimate( points, faces, 1, 0.01, decimated_points, 
+    decimated_faces, point_map, boost::function< bool () >() ) );
+  ASSERT_LT( decimated_faces.size(), faces.size() / 4 );
+  ASSERT_EQ( point_map.size(), points.size() );
+
+  for ( size_t y = 0; y < n; y++ )
+  {
+    for ( size_t x = 0; x < n; x++ )
+    {
+      size_t j = y * n + x;
+      bool border = x == 0 || y == 0 || x == n - 1 || y == n - 1;
+      if ( !border ) continue;
+      ASSERT_NE( point_map[ j ], std::numeric_limits< unsigned int >::max() );
+      ASSERT_EQ( decimated_points[ point_map[ j ] ], points[ j ] );
+    }
+  }
+
+  // The orientation of the faces is preserved
+  VectorFVector normals;
+  IsosurfaceDecimator::ComputeNormals( decimated_points, decimated_faces, normals );
+  ASSERT_EQ( normals.size(), decimated_points.size() );
+  for ( size_t j = 0; j < normals.size(); j++ )
+  {
+    ASSERT_NEAR( normals[ j ].z(), 1.0f, 1e-5f );
+  }
+}
+
+TEST(IsosurfaceDecimatorTest, ComputeNormals)
+{
+  PointFVector points;
+  UIntVector faces;
+  VectorFVector normals;
+  CreateSphere( 8, 5.0f, points, faces );
+  IsosurfaceDecimator::ComputeNormals( points, faces, normals );
+
+  ASSERT_EQ( normals.size(), points.size() );
+  for ( size_t j = 0; j < points.size(); j++ )
+  {
+    // The normals point outward and are normalized
+    VectorF direction( points[ j ].x(), points[ j ].y(), points[ j ].z() );
+    direction.normalize();
+    ASSERT_NEAR( normals[ j ].length(), 1.0f, 1e-5f );
+    ASSERT_GT( Dot( normals[ j ], direction ), 0.95f );
+  }
+}
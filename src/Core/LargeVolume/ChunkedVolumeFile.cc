@@ -0,0 +1,652 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+// STL includes
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+
+// Boost includes
+#include <boost/bind.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/thread/mutex.hpp>
+
+// Core includes
+#include <Core/DataBlock/StdDataBlock.h>
+#include <Core/LargeVolume/ChunkedVolumeFile.h>
+#include <Core/LargeVolume/LargeVolumeCodec.h>
+#include <Core/Utils/MappedFile.h>
+#include <Core/Utils/Parallel.h>
+#include <Core/Utils/StringUtil.h>
+
+namespace bfs = boost::filesystem;
+
+namespace Core
+{
+
+// First line of every chunked volume file
+static const char* CHUNKED_VOLUME_MAGIC_C = "SEG3D CHUNKED VOLUME 1";
+
+// Number of voxels along each edge of a chunk
+static const size_t CHUNK_SIZE_C = 64;
+
+// Number of bytes each chunk occupies in the index
+static const size_t INDEX_ENTRY_SIZE_C = 16;
+
+static void WriteUInt64( char* buffer, unsigned long long value )
+{
+  for ( size_t j = 0; j < 8; j++ )
+  {
+    buffer[ j ] = static_cast< char >( ( value >> ( 8 * j ) ) & 0xff );
+  }
+}
+
+static unsigned long long ReadUInt64( const char* buffer )
+{
+  unsigned long long value = 0;
+  for ( size_t j = 0; j < 8; j++ )
+  {
+    value |= static_cast< unsigned long long >( static_cast< unsigned char >( buffer[ j ] ) ) 
+      << ( 8 * j );
+  }
+  return value;
+}
+
+static void SwapBytes( char* data, size_t size, size_t elem_size )
+{
+  if ( elem_size < 2 ) return;
+  for ( size_t j = 0; j < size; j += elem_size )
+  {
+    std::reverse( data + j, data + j + elem_size );
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Class ChunkedVolumeLayout
+//////////////////////////////////////////////////////////////////////////
+
+// Subdivision of a volume into chunks, chunks are numbered with x varying fastest
+class ChunkedVolumeLayout
+{
+public:
+  ChunkedVolumeLayout() :
+    nx_( 0 ), ny_( 0 ), nz_( 0 ), elem_size_( 0 ), chunk_size_( CHUNK_SIZE_C ),
+    cx_( 0 ), cy_( 0 ), cz_( 0 )
+  {
+  }
+
+  void setup( size_t nx, size_t ny, size_t nz, size_t elem_size, size_t chunk_size )
+  {
+    this->nx_ = nx;
+    this->ny_ = ny;
+    this->nz_ = nz;
+    this->elem_size_ = elem_size;
+    this->chunk_size_ = chunk_size;
+    this->cx_ = ( nx + chunk_size - 1 ) / chunk_size;
+    this->cy_ = ( ny + chunk_size - 1 ) / chunk_size;
+    this->cz_ = ( nz + chunk_size - 1 ) / chunk_size;
+  }
+
+  size_t get_num_chunks() const
+  {
+    return this->cx_ * this->cy_ * this->cz_;
+  }
+
+  // Get the voxel range covered by a chunk
+  void get_chunk_box( size_t chunk, size_t start[ 3 ], size_t size[ 3 ] ) const
+  {
+    size_t index[ 3 ] = { chunk % this->cx_, ( chunk / this->cx_ ) % this->cy_,
+      chunk / ( this->cx_ * this->cy_ ) };
+    size_t dims[ 3 ] = { this->nx_, this->ny_, this->nz_ };
+    for ( int j = 0; j < 3; j++ )
+    {
+      start[ j ] = index[ j ] * this->chunk_size_;
+      size[ j ] = std::min( this->chunk_size_, dims[ j ] - start[ j ] );
+    }
+  }
+
+  // Copy the voxels of a chunk between the volume and a contiguous chunk buffer
+  void copy_chunk( size_t chunk, char* volume, char* buffer, bool to_buffer ) const
+  {
+    size_t start[ 3 ], size[ 3 ];
+    this->get_chunk_box( chunk, start, size );
+    size_t row_size = size[ 0 ] * this->elem_size_;
+    for ( size_t z = 0; z < size[ 2 ]; z++ )
+    {
+      for ( size_t y = 0; y < size[ 1 ]; y++ )
+      {
+        char* row = volume + ( ( ( start[ 2 ] + z ) * this->ny_ + start[ 1 ] + y ) * 
+          this->nx_ + start[ 0 ] ) * this->elem_size_;
+        if ( to_buffer ) std::memcpy( buffer, row, row_size );
+        else std::memcpy( row, buffer, row_size );
+        buffer += row_size;
+      }
+    }
+  }
+
+  size_t get_chunk_byte_size( size_t chunk ) const
+  {
+    size_t start[ 3 ], size[ 3 ];
+    this->get_chunk_box( chunk, start, size );
+    return size[ 0 ] * size[ 1 ] * size[ 2 ] * this->elem_size_;
+  }
+
+  size_t nx_;
+  size_t ny_;
+  size_t nz_;
+  size_t elem_size_;
+  size_t chunk_size_;
+
+  // Number of chunks along each axis
+  size_t cx_;
+  size_t cy_;
+  size_t cz_;
+};
+
+//////////////////////////////////////////////////////////////////////////
+// Class ChunkedVolumeEncoder
+//////////////////////////////////////////////////////////////////////////
+
+// Encodes a batch of chunks in parallel
+class ChunkedVolumeEncoder
+{
+public:
+  ChunkedVolumeEncoder( const ChunkedVolumeLayout& layout, const char* data, 
+    DataType data_type, BrickCodec codec, size_t first_chunk, 
+    std::vector< std::vector< char > >& buffers ) :
+    layout_( layout ),
+    data_( data ),
+    data_type_( data_type ),
+    codec_( codec ),
+    first_chunk_( first_chunk ),
+    buffers_( buffers ),
+    success_( true )
+  {
+  }
+
+  void process( size_t begin, size_t end )
+  {
+    std::vector< char > chunk_data;
+    for ( size_t j = begin; j < end; j++ )
+    {
+      size_t chunk = this->first_chunk_ + j;
+      chunk_data.resize( this->layout_.get_chunk_byte_size( chunk ) );
+      this->layout_.copy_chunk( chunk, const_cast< char* >( this->data_ ), &chunk_data[ 0 ], 
+        true );
+
+      std::string error;
+      if ( !LargeVolumeCodec::EncodeBrick( &chunk_data[ 0 ], chunk_data.size(), 
+        this->data_type_, DataBlock::IsLittleEndian(), this->codec_, BrickFilter::SHUFFLE_E,
+        this->buffers_[ j ], error ) )
+      {
+        boost::mutex::scoped_lock lock( this->mutex_ );
+        this->success_ = false;
+        this->error_ = error;
+        return;
+      }
+    }
+  }
+
+  const ChunkedVolumeLayout& layout_;
+  const char* data_;
+  DataType data_type_;
+  BrickCodec codec_;
+  size_t first_chunk_;
+  std::vector< std::vector< char > >& buffers_;
+
+  boost::mutex mutex_;
+  bool success_;
+  std::string error_;
+};
+
+//////////////////////////////////////////////////////////////////////////
+// Class ChunkedVolumeFilePrivate
+//////////////////////////////////////////////////////////////////////////
+
+class ChunkedVolumeFilePrivate
+{
+public:
+  ChunkedVolumeFilePrivate() :
+    data_type_( DataType::UNKNOWN_E ),
+    little_endian_( true ),
+    has_histogram_( false ),
+    open_( false )
+  {
+  }
+
+  // Decode chunks [begin, end) of the list into the volume
+  void decode_chunks( const std::vector< size_t >* chunks, char* volume, size_t begin, 
+    size_t end );
+
+  bfs::path filename_;
+  DataType data_type_;
+  bool little_endian_;
+  GridTransform grid_transform_;
+  bool has_histogram_;
+  Histogram histogram_;
+  ChunkedVolumeLayout layout_;
+  bool open_;
+
+  // Offset and length of each chunk in the file
+  std::vector< unsigned long long > offsets_;
+  std::vector< unsigned long long > lengths_;
+
+  // The file mapped into memory, if the file could not be mapped chunks are read from disk
+  MappedFile mapped_file_;
+
+  // Errors that occurred while decoding
+  boost::mutex error_mutex_;
+  std::string error_;
+};
+
+void ChunkedVolumeFilePrivate::decode_chunks( const std::vector< size_t >* chunks, 
+  char* volume, size_t begin, size_t end )
+{
+  const char* file_data = this->mapped_file_.get_data();
+  size_t elem_size = GetSizeDataType( this->data_type_ );
+
+  std::ifstream file;
+  std::vector< char > encoded;
+  std::vector< char > chunk_data;
+  for ( size_t j = begin; j < end; j++ )
+  {
+    size_t chunk = ( *chunks )[ j ];
+    size_t offset = static_cast< size_t >( this->offsets_[ chunk ] );
+    size_t length = static_cast< size_t >( this->lengths_[ chunk ] );
+
+    const char* data = file_data ? file_data + offset : 0;
+    if ( data == 0 )
+    {
+      if ( !file.is_open() )
+      {
+        file.open( this->filename_.string().c_str(), std::ios::in | std::ios::binary );
+      }
+      encoded.resize( length );
+      file.seekg( offset );
+      file.read( &encoded[ 0 ], length );
+      if ( !file )
+      {
+        boost::mutex::scoped_lock lock( this->error_mutex_ );
+        this->error_ = "Could not read from file '" + this->filename_.string() + "'.";
+        return;
+      }
+      data = &encoded[ 0 ];
+    }
+
+    std::string error;
+    chunk_data.resize( this->layout_.get_chunk_byte_size( chunk ) );
+    if ( !LargeVolumeCodec::DecodeBrick( data, length, &chunk_data[ 0 ], chunk_data.size(),
+      this->data_type_, this->little_endian_, error ) )
+    {
+      boost::mutex::scoped_lock lock( this->error_mutex_ );
+      this->error_ = "File '" + this->filename_.string() + "' is corrupt: " + error;
+      return;
+    }
+
+    if ( this->little_endian_ != DataBlock::IsLittleEndian() )
+    {
+      SwapBytes( &chunk_data[ 0 ], chunk_data.size(), elem_size );
+    }
+    this->layout_.copy_chunk( chunk, volume, &chunk_data[ 0 ], false );
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Class ChunkedVolumeFile
+//////////////////////////////////////////////////////////////////////////
+
+ChunkedVolumeFile::ChunkedVolumeFile() :
+  private_( new ChunkedVolumeFilePrivate )
+{
+}
+
+ChunkedVolumeFile::~ChunkedVolumeFile()
+{
+  this->close();
+}
+
+bool ChunkedVolumeFile::open( const bfs::path& filename, std::string& error )
+{
+  this->close();
+  this->private_->filename_ = filename;
+
+  std::ifstream file( filename.string().c_str(), std::ios::in | std::ios::binary );
+  if ( !file )
+  {
+    error = "Could not open file '" + filename.string() + "'.";
+    return false;
+  }
+
+  // Read the text header, which is terminated by an empty line
+  std::string line;
+  std::getline( file, line );
+  if ( line != CHUNKED_VOLUME_MAGIC_C )
+  {
+    error = "File '" + filename.string() + "' is not a chunked volume file.";
+    return false;
+  }
+
+  std::map< std::string, std::string > values;
+  while ( std::getline( file, line ) && !line.empty() )
+  {
+    std::string::size_type colon = line.find( ':' );
+    if ( colon == std::string::npos ) continue;
+    std::string value = line.substr( colon + 1 );
+    StripSurroundingSpaces( value );
+    values[ line.substr( 0, colon ) ] = value;
+  }
+
+  const std::string corrupt_error = "File '" + filename.string() + "' is corrupt.";
+  
+  std::vector< unsigned long long > sizes;
+  size_t chunk_size = 0;
+  size_t num_chunks = 0;
+  bool node_centered = false;
+  GridTransform grid_transform;
+  if ( !file || !ImportFromString( values[ "type" ], this->private_->data_type_ ) ||
+    !ImportFromString( values[ "sizes" ], sizes ) || sizes.size() != 3 ||
+    !ImportFromString( values[ "chunk size" ], chunk_size ) || chunk_size == 0 ||
+    !ImportFromString( values[ "chunks" ], num_chunks ) ||
+    !ImportFromString( values[ "node centered" ], node_centered ) ||
+    !ImportFromString( values[ "grid transform" ], grid_transform ) ||
+    ( values[ "endian" ] != "little" && values[ "endian" ] != "big" ) )
+  {
+    error = corrupt_error;
+    return false;
+  }
+
+  this->private_->little_endian_ = ( values[ "endian" ] == "little" );
+  grid_transform.set_originally_node_centered( node_centered );
+  this->private_->grid_transform_ = grid_transform;
+  this->private_->layout_.setup( static_cast< size_t >( sizes[ 0 ] ), 
+    static_cast< size_t >( sizes[ 1 ] ), static_cast< size_t >( sizes[ 2 ] ), 
+    GetSizeDataType( this->private_->data_type_ ), chunk_size );
+  if ( num_chunks != this->private_->layout_.get_num_chunks() )
+  {
+    error = corrupt_error;
+    return false;
+  }
+
+  this->private_->has_histogram_ = values.find( "histogram" ) != values.end() &&
+    ImportFromString( values[ "histogram" ], this->private_->histogram_ );
+
+  // Read the index
+  std::vector< char > index( num_chunks * INDEX_ENTRY_SIZE_C );
+  if ( num_chunks ) file.read( &index[ 0 ], index.size() );
+  if ( !file )
+  {
+    error = corrupt_error;
+    return false;
+  }
+
+  unsigned long long file_size = static_cast< unsigned long long >( bfs::file_size( filename ) );
+  this->private_->offsets_.resize( num_chunks );
+  this->private_->lengths_.resize( num_chunks );
+  for ( size_t j = 0; j < num_chunks; j++ )
+  {
+    this->private_->offsets_[ j ] = ReadUInt64( &index[ j * INDEX_ENTRY_SIZE_C ] );
+    this->private_->lengths_[ j ] = ReadUInt64( &index[ j * INDEX_ENTRY_SIZE_C + 8 ] );
+    if ( this->private_->offsets_[ j ] + this->private_->lengths_[ j ] > file_size )
+    {
+      error = corrupt_error;
+      return false;
+    }
+  }
+  file.close();
+
+  // Map the file if possible, if not the chunks are read from disk when they are decoded
+  std::string map_error;
+  if ( sizeof( void* ) == 8 || file_size < ( 1ULL << 30 ) )
+  {
+    this->private_->mapped_file_.open( filename, MappedFile::READ_ONLY_E, map_error );
+  }
+
+  this->private_->open_ = true;
+  return true;
+}
+
+void ChunkedVolumeFile::close()
+{
+  this->private_->mapped_file_.close();
+  this->private_->offsets_.clear();
+  this->private_->lengths_.clear();
+  this->private_->has_histogram_ = false;
+  this->private_->open_ = false;
+}
+
+bool ChunkedVolumeFile::is_open() const
+{
+  return this->private_->open_;
+}
+
+const GridTransform& ChunkedVolumeFile::get_grid_transform() const
+{
+  return this->private_->grid_transform_;
+}
+
+DataType ChunkedVolumeFile::get_data_type() const
+{
+  return this->private_->data_type_;
+}
+
+bool ChunkedVolumeFile::get_histogram( Histogram& histogram ) const
+{
+  if ( !this->private_->has_histogram_ ) return false;
+  histogram = this->private_->histogram_;
+  return true;
+}
+
+size_t ChunkedVolumeFile::get_num_chunks() const
+{
+  return this->private_->offsets_.size();
+}
+
+void ChunkedVolumeFile::get_slice_chunks( SliceType type, size_t index, 
+  std::vector< size_t >& chunks ) const
+{
+  chunks.clear();
+  const ChunkedVolumeLayout& layout = this->private_->layout_;
+  
+  // Axis that is perpendicular to the slice
+  int axis = 2;
+  if ( type == SliceType::CORONAL_E ) axis = 1;
+  else if ( type == SliceType::SAGITTAL_E ) axis = 0;
+
+  size_t dims[ 3 ] = { layout.nx_, layout.ny_, layout.nz_ };
+  if ( index >= dims[ axis ] ) return;
+
+  size_t slice_chunk = index / layout.chunk_size_;
+  for ( size_t k = 0; k < layout.cz_; k++ )
+  {
+    if ( axis == 2 && k != slice_chunk ) continue;
+    for ( size_t j = 0; j < layout.cy_; j++ )
+    {
+      if ( axis == 1 && j != slice_chunk ) continue;
+      for ( size_t i = 0; i < layout.cx_; i++ )
+      {
+        if ( axis == 0 && i != slice_chunk ) continue;
+        chunks.push_back( ( k * layout.cy_ + j ) * layout.cx_ + i );
+      }
+    }
+  }
+}
+
+bool ChunkedVolumeFile::read_chunks( const std::vector< size_t >& chunks, 
+  const DataBlockHandle& data_block, std::string& error ) const
+{
+  const ChunkedVolumeLayout& layout = this->private_->layout_;
+  if ( !this->private_->open_ || !data_block || data_block->get_nx() != layout.nx_ ||
+    data_block->get_ny() != layout.ny_ || data_block->get_nz() != layout.nz_ ||
+    data_block->get_data_type() != this->private_->data_type_ )
+  {
+    error = "Data block does not match the chunked volume.";
+    return false;
+  }
+
+  for ( size_t j = 0; j < chunks.size(); j++ )
+  {
+    if ( chunks[ j ] >= this->private_->offsets_.size() )
+    {
+      error = "Chunk index out of range.";
+      return false;
+    }
+  }
+
+  if ( chunks.empty() ) return true;
+
+  // Request write access once, so a shared data block is copied before the threads start
+  char* volume = reinterpret_cast< char* >( data_block->get_data() );
+
+  Parallel::For( 0, chunks.size(), boost::bind( &ChunkedVolumeFilePrivate::decode_chunks,
+    this->private_, &chunks, volume, _1, _2 ), 1 );
+
+  boost::mutex::scoped_lock lock( this->private_->error_mutex_ );
+  if ( !this->private_->error_.empty() )
+  {
+    error = this->private_->error_;
+    this->private_->error_.clear();
+    return false;
+  }
+  return true;
+}
+
+bool ChunkedVolumeFile::read( DataBlockHandle& data_block, std::string& error ) const
+{
+  data_block.reset();
+  if ( !this->private_->open_ )
+  {
+    error = "No chunked volume file is open.";
+    return false;
+  }
+
+  const ChunkedVolumeLayout& layout = this->private_->layout_;
+  DataBlockHandle block = StdDataBlock::New( layout.nx_, layout.ny_, layout.nz_, 
+    this->private_->data_type_ );
+  if ( !block )
+  {
+    error = "Could not allocate enough memory to read file '" + 
+      this->private_->filename_.string() + "'.";
+    return false;
+  }
+
+  std::vector< size_t > chunks( layout.get_num_chunks() );
+  for ( size_t j = 0; j < chunks.size(); j++ ) chunks[ j ] = j;
+  if ( !this->read_chunks( chunks, block, error ) ) return false;
+
+  if ( this->private_->has_histogram_ ) block->set_histogram( this->private_->histogram_ );
+  data_block = block;
+  return true;
+}
+
+bool ChunkedVolumeFile::Save( const bfs::path& filename, const DataBlockHandle& data_block,
+  const GridTransform& grid_transform, bool compress, bool save_histogram, std::string& error )
+{
+  ChunkedVolumeLayout layout;
+  layout.setup( data_block->get_nx(), data_block->get_ny(), data_block->get_nz(),
+    data_block->get_elem_size(), CHUNK_SIZE_C );
+  size_t num_chunks = layout.get_num_chunks();
+
+  std::ostringstream header;
+  header << CHUNKED_VOLUME_MAGIC_C << "\n";
+  header << "type: " << ExportToString( data_block->get_data_type() ) << "\n";
+  header << "sizes: " << layout.nx_ << " " << layout.ny_ << " " << layout.nz_ << "\n";
+  header << "chunk size: " << layout.chunk_size_ << "\n";
+  header << "chunks: " << num_chunks << "\n";
+  header << "endian: " << ( DataBlock::IsLittleEndian() ? "little" : "big" ) << "\n";
+  header << "node centered: " << 
+    ExportToString( grid_transform.get_originally_node_centered() ) << "\n";
+  header << "grid transform: " << ExportToString( grid_transform ) << "\n";
+  if ( save_histogram )
+  {
+    header << "histogram: " << ExportToString( data_block->get_histogram() ) << "\n";
+  }
+  header << "\n";
+
+  std::ofstream file( filename.string().c_str(), std::ios::out | std::ios::binary | 
+    std::ios::trunc );
+  if ( !file )
+  {
+    error = "Could not open file '" + filename.string() + "' for writing.";
+    return false;
+  }
+
+  // Reserve space for the index, it is filled in once all chunks have been written
+  std::string header_string = header.str();
+  std::vector< char > index( num_chunks * INDEX_ENTRY_SIZE_C, 0 );
+  file.write( header_string.c_str(), header_string.size() );
+  if ( num_chunks ) file.write( &index[ 0 ], index.size() );
+  unsigned long long offset = header_string.size() + index.size();
+
+  // Encode the chunks in batches on all cores and write each batch in order
+  const char* data = reinterpret_cast< const char* >( data_block->get_const_data() );
+  BrickCodec codec = compress ? BrickCodec::LZ4_E : BrickCodec::NONE_E;
+  size_t batch_size = 4 * static_cast< size_t >( Parallel::GetNumThreads() );
+  std::vector< std::vector< char > > buffers;
+  for ( size_t first = 0; first < num_chunks && file; first += batch_size )
+  {
+    size_t count = std::min( batch_size, num_chunks - first );
+    buffers.resize( count );
+    ChunkedVolumeEncoder encoder( layout, data, data_block->get_data_type(), codec, first,
+      buffers );
+    Parallel::For( 0, count, boost::bind( &ChunkedVolumeEncoder::process, &encoder, 
+      _1, _2 ), 1 );
+    if ( !encoder.success_ )
+    {
+      error = encoder.error_;
+      return false;
+    }
+
+    for ( size_t j = 0; j < count; j++ )
+    {
+      WriteUInt64( &index[ ( first + j ) * INDEX_ENTRY_SIZE_C ], offset );
+      WriteUInt64( &index[ ( first + j ) * INDEX_ENTRY_SIZE_C + 8 ], buffers[ j ].size() );
+      file.write( &buffers[ j ][ 0 ], buffers[ j ].size() );
+      offset += buffers[ j ].size();
+    }
+  }
+
+  file.seekp( header_string.size() );
+  if ( num_chunks ) file.write( &index[ 0 ], index.size() );
+  file.close();
+
+  if ( !file )
+  {
+    error = "Could not write file '" + filename.string() + "'.";
+    return false;
+  }
+  return true;
+}
+
+const std::string& ChunkedVolumeFile::GetFileExtension()
+{
+  static const std::string extension( ".s3dv" );
+  return extension;
+}
+
+} // end namespace Core
@@ -0,0 +1,137 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+#ifndef CORE_LARGEVOLUME_CHUNKEDVOLUMEFILE_H
+#define CORE_LARGEVOLUME_CHUNKEDVOLUMEFILE_H
+
+// STL includes
+#include <string>
+#include <vector>
+
+// Boost includes
+#include <boost/filesystem/path.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+// Core includes
+#include <Core/DataBlock/DataBlock.h>
+#include <Core/DataBlock/Histogram.h>
+#include <Core/DataBlock/SliceType.h>
+#include <Core/Geometry/GridTransform.h>
+
+namespace Core
+{
+
+class ChunkedVolumeFile;
+typedef boost::shared_ptr< ChunkedVolumeFile > ChunkedVolumeFileHandle;
+
+class ChunkedVolumeFilePrivate;
+typedef boost::shared_ptr< ChunkedVolumeFilePrivate > ChunkedVolumeFilePrivateHandle;
+
+// CLASS CHUNKEDVOLUMEFILE:
+/// Volume file that splits the data into cubic chunks that are compressed independently. The
+/// file starts with a text header describing the volume, followed by an index with the offset
+/// and length of every chunk and the encoded chunks themselves. As the chunks do not depend
+/// on each other they are encoded and decoded on all cores, and a single slice can be read
+/// without decoding the rest of the volume.
+
+class ChunkedVolumeFile : public boost::noncopyable
+{
+  // -- constructor/destructor --
+public:
+  ChunkedVolumeFile();
+  ~ChunkedVolumeFile();
+
+  // -- reading --
+public:
+  /// OPEN
+  /// Open a chunked volume file and read its header and index. The file is mapped into memory
+  /// when the address space allows for it.
+  bool open( const boost::filesystem::path& filename, std::string& error );
+
+  /// CLOSE
+  /// Close the file
+  void close();
+
+  /// IS_OPEN
+  /// Whether a file is open
+  bool is_open() const;
+
+  /// GET_GRID_TRANSFORM
+  /// Grid transform of the volume
+  const GridTransform& get_grid_transform() const;
+
+  /// GET_DATA_TYPE
+  /// Data type of the volume
+  DataType get_data_type() const;
+
+  /// GET_HISTOGRAM
+  /// Get the histogram that was stored with the volume. Returns false if there is none.
+  bool get_histogram( Histogram& histogram ) const;
+
+  /// GET_NUM_CHUNKS
+  /// Number of chunks in the file
+  size_t get_num_chunks() const;
+
+  /// GET_SLICE_CHUNKS
+  /// Get the chunks that contain a slice of the volume
+  void get_slice_chunks( SliceType type, size_t index, std::vector< size_t >& chunks ) const;
+
+  /// READ_CHUNKS
+  /// Decode a list of chunks into a data block with the dimensions and type of the volume. The
+  /// chunks are decoded in parallel. The caller needs to hold a write lock on the data block if
+  /// other threads can access it. This function can be called from multiple threads at once.
+  bool read_chunks( const std::vector< size_t >& chunks, const DataBlockHandle& data_block,
+    std::string& error ) const;
+
+  /// READ
+  /// Read the whole volume into a new data block. The histogram stored in the file is set on
+  /// the data block.
+  bool read( DataBlockHandle& data_block, std::string& error ) const;
+
+  // -- writing --
+public:
+  /// SAVE
+  /// Write a data block into a chunked volume file. The chunks are compressed with a fast codec
+  /// on all cores, or stored as is when compress is false. The histogram of the data block is
+  /// included if save_histogram is set.
+  /// NOTE: The caller needs to make sure the data block is not modified while it is written.
+  static bool Save( const boost::filesystem::path& filename, const DataBlockHandle& data_block,
+    const GridTransform& grid_transform, bool compress, bool save_histogram, 
+    std::string& error );
+
+  /// GET_FILE_EXTENSION
+  /// Extension used for chunked volume files
+  static const std::string& GetFileExtension();
+
+private:
+  ChunkedVolumeFilePrivateHandle private_;
+};
+
+} // end namespace Core
+
+#endif
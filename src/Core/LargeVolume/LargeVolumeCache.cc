@@ -26,60 +26,263 @@
  DEALINGS IN THE SOFTWARE.
  */
 
-#include <list>
 #include <queue>
+#include <vector>
 
 #include <boost/unordered_map.hpp>
+#include <boost/unordered_set.hpp>
+#include <boost/thread.hpp>
+#include <boost/weak_ptr.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
 
 #include <Core/Application/Application.h>
 #include <Core/Utils/ConnectionHandler.h>
+#include <Core/Utils/Log.h>
+#include <Core/Utils/StringUtil.h>
 #include <Core/DataBlock/DataBlock.h>
 #include <Core/LargeVolume/LargeVolumeCache.h>
+#include <Core/LargeVolume/LargeVolumeDiskCache.h>
 
 namespace Core
 {
 CORE_SINGLETON_IMPLEMENTATION( LargeVolumeCache );
 
-class LargeVolumeCachePrivate : ConnectionHandler, Lockable, public EventHandler
-{
-  typedef std::list<std::string> cache_access_list_type;
+typedef LargeVolumeSchema::brick_key_type brick_key_type;
+typedef std::vector<std::pair<brick_key_type, DataBlockHandle> > evicted_list_type;
+
+// CLASS LARGEVOLUMECACHESHARD:
+/// One shard of the memory tier. Each shard has its own lock, map and LRU list, so lookups of
+/// different bricks rarely contend. The LRU list is intrusive: entries are linked directly,
+/// hence a lookup does not allocate any memory.
 
+class LargeVolumeCacheShard : public boost::noncopyable
+{
   struct CacheEntry
   {
+    brick_key_type key_;
     DataBlockHandle data_block_;
-    cache_access_list_type::iterator access_record_;
+    CacheEntry* prev_;
+    CacheEntry* next_;
   };
 
+  typedef boost::unordered_map<brick_key_type, CacheEntry*> cache_map_type;
+
+public:
+  LargeVolumeCacheShard() :
+    cache_capacity_( 0 ),
+    cache_size_( 0 ),
+    hits_( 0 ),
+    misses_( 0 )
+  {
+    // The list is circular with a sentinel, the front is the most recently used entry
+    this->sentinel_.prev_ = &this->sentinel_;
+    this->sentinel_.next_ = &this->sentinel_;
+  }
+
+  ~LargeVolumeCacheShard()
+  {
+    this->clear();
+  }
+
+  void add_entry( brick_key_type key, DataBlockHandle data_block, evicted_list_type& evicted )
+  {
+    boost::mutex::scoped_lock lock( this->mutex_ );
+
+    cache_map_type::iterator it = this->cache_map_.find( key );
+    if ( it != this->cache_map_.end() )
+    {
+      this->unlink( it->second );
+      this->push_front( it->second );
+      return;
+    }
+
+    CacheEntry* entry = new CacheEntry;
+    entry->key_ = key;
+    entry->data_block_ = data_block;
+    this->push_front( entry );
+    this->cache_map_[ key ] = entry;
+    this->cache_size_ += data_block->get_byte_size();
+
+    this->constraint_cache_size( evicted );
+  }
+
+  bool get_entry( brick_key_type key, DataBlockHandle& data_block )
+  {
+    boost::mutex::scoped_lock lock( this->mutex_ );
+
+    cache_map_type::iterator it = this->cache_map_.find( key );
+    if ( it == this->cache_map_.end() ) 
+    {
+      this->misses_++;
+      return false;
+    }
+    this->hits_++;
+
+    this->unlink( it->second );
+    this->push_front( it->second );
+    data_block = it->second->data_block_;
+
+    return true;
+  }
+
+  void clear()
+  {
+    boost::mutex::scoped_lock lock( this->mutex_ );
+
+    for ( cache_map_type::iterator it = this->cache_map_.begin(); it != this->cache_map_.end(); ++it )
+    {
+      delete it->second;
+    }
+    this->cache_map_.clear();
+    this->sentinel_.prev_ = &this->sentinel_;
+    this->sentinel_.next_ = &this->sentinel_;
+    this->cache_size_ = 0;
+  }
+
+  void set_capacity( long long capacity )
+  {
+    boost::mutex::scoped_lock lock( this->mutex_ );
+    this->cache_capacity_ = capacity;
+  }
+
+  void add_statistics( LargeVolumeCacheStatistics& statistics )
+  {
+    boost::mutex::scoped_lock lock( this->mutex_ );
+    statistics.memory_hits_ += this->hits_;
+    statistics.memory_misses_ += this->misses_;
+    statistics.memory_size_ += this->cache_size_;
+    statistics.memory_capacity_ += this->cache_capacity_;
+  }
+
+private:
+  void unlink( CacheEntry* entry )
+  {
+    entry->prev_->next_ = entry->next_;
+    entry->next_->prev_ = entry->prev_;
+  }
+
+  void push_front( CacheEntry* entry )
+  {
+    entry->prev_ = &this->sentinel_;
+    entry->next_ = this->sentinel_.next_;
+    this->sentinel_.next_->prev_ = entry;
+    this->sentinel_.next_ = entry;
+  }
+
+  void constraint_cache_size( evicted_list_type& evicted )
+  {
+    while ( this->cache_size_ > this->cache_capacity_ && this->sentinel_.prev_ != &this->sentinel_ )
+    {
+      CacheEntry* entry = this->sentinel_.prev_;
+      this->unlink( entry );
+      this->cache_map_.erase( entry->key_ );
+      this->cache_size_ -= entry->data_block_->get_byte_size();
+      evicted.push_back( std::make_pair( entry->key_, entry->data_block_ ) );
+      delete entry;
+    }
+  }
+
+  boost::mutex mutex_;
+  cache_map_type cache_map_;
+  CacheEntry sentinel_;
+
+  long long cache_capacity_;
+  long long cache_size_;
+
+  long long hits_;
+  long long misses_;
+};
+
+class LargeVolumeCachePrivate : ConnectionHandler
+{
   struct LoadJob
   {
-    LoadJob( LargeVolumeSchemaHandle schema, BrickInfo bi ) :
-      schema_( schema ), bi_( bi )
+    LoadJob() : bi_( 0, 0 ), key_( 0 ), distance_( 0.0 )
+    {
+    }
+
+    LoadJob( LargeVolumeSchemaHandle schema, BrickInfo bi, double distance ) :
+      schema_( schema ), bi_( bi ), key_( schema->get_brick_key( bi ) ), distance_( distance )
     {
     };
 
+    // Ordering for the priority queue: the job that compares largest is loaded first, i.e.
+    // coarser levels first and then bricks closest to the focus point.
+    bool operator<( const LoadJob& rhs ) const
+    {
+      if ( this->bi_.level_ != rhs.bi_.level_ ) return this->bi_.level_ < rhs.bi_.level_;
+      return this->distance_ > rhs.distance_;
+    }
+
     LargeVolumeSchemaHandle schema_;
     BrickInfo bi_;
+    brick_key_type key_;
+    double distance_;
+  };
+
+  struct LoadQueue
+  {
+    std::priority_queue<LoadJob> jobs_;
+    Point focus_;
   };
 
-  typedef boost::unordered_map<std::string, CacheEntry> cache_map_type;
+  typedef boost::unordered_map<std::string, LoadQueue> load_queue_map_type;
+  typedef boost::unordered_map<brick_key_type, boost::weak_ptr<LargeVolumeSchema> > 
+    failed_brick_map_type;
 
 public:
-  long long cache_capacity_;
-  long long cache_size_;
-  cache_access_list_type cache_access_list_;
-  cache_map_type cache_map_;
+  // Memory tier, split in shards by brick key
+  static const size_t NUM_SHARDS_C = 16;
+  LargeVolumeCacheShard shards_[ NUM_SHARDS_C ];
 
   LargeVolumeCache* instance_;
 
-  boost::unordered_map<std::string,std::queue<LoadJob> > jobs_;
+  // Second tier for bricks evicted from memory
+  LargeVolumeDiskCache disk_cache_;
+
+  boost::mutex disk_statistics_mutex_;
+  long long disk_hits_;
+  long long disk_misses_;
+
+  // Mutex and condition variable protecting the load queues
+  boost::mutex load_mutex_;
+  boost::condition_variable load_available_;
+
+  // Pending loads per load key
+  load_queue_map_type load_queues_;
 
-  LargeVolumeCachePrivate()
+  // Bricks that are currently being read by one of the loaders
+  boost::unordered_set<brick_key_type> bricks_in_flight_;
+
+  // Bricks that could not be read, with the schema that tried to read them. These are not
+  // requested again, until the volume is loaded again and hence has a new schema.
+  failed_brick_map_type failed_bricks_;
+
+  // Bricks that were loaded since the last brick_loaded_signal_
+  size_t bricks_since_signal_;
+  boost::posix_time::ptime last_signal_time_;
+
+  std::vector<boost::thread*> loaders_;
+  bool done_;
+
+  // Maximum number of loaders that read and decompress bricks concurrently
+  static const int MAX_NUM_LOADERS_C;
+
+  // Minimum time between two brick_loaded_signal_ notifications while loads are still pending
+  static const long SIGNAL_INTERVAL_MS_C;
+
+  LargeVolumeCachePrivate() :
+    disk_hits_( 0 ),
+    disk_misses_( 0 ),
+    bricks_since_signal_( 0 ),
+    done_( false )
   {
+    long long cache_capacity;
     if (sizeof( void * ) == 4)
     {
       // For 32bit systems, do not exceed 1 GB of data usage.
       // On Windows, addressable space is 2 GB, hence this leaves enough space for the program itself.
-      this->cache_capacity_ = static_cast<long long>( 1 ) << 30;
+      cache_capacity = static_cast<long long>( 1 ) << 30;
     }
     else
     {
@@ -93,113 +296,303 @@ public:
       if (mem_size < ( static_cast<long long>( 1 ) << 30 )) mem_size = static_cast<long long>( 1 ) << 30;
 
       // Do not use more than 32 GB, unless explicity requested.
-      this->cache_capacity_ = Core::Min( static_cast<long long>( 32 ) << 30, mem_size );
+      cache_capacity = Core::Min( static_cast<long long>( 32 ) << 30, mem_size );
     }
 
-    this->cache_size_ = 0;
+    // Keys are spread uniformly over the shards, hence each gets an equal part
+    for ( size_t j = 0; j < NUM_SHARDS_C; j++ )
+    {
+      this->shards_[ j ].set_capacity( cache_capacity / NUM_SHARDS_C );
+    }
+
+    this->last_signal_time_ = boost::posix_time::microsec_clock::universal_time();
 
     this->add_connection( Application::Instance()->reset_signal_.connect(
       boost::bind( &LargeVolumeCachePrivate::clear_cache, this ) ) );
+
+    std::string disk_cache_dir;
+    if ( Application::Instance()->check_command_line_parameter( "large_volume_disk_cache", 
+      disk_cache_dir ) )
+    {
+      // Default to 32 GB of local scratch space
+      double disk_cache_size = 32.0;
+      std::string disk_cache_size_string;
+      if ( Application::Instance()->check_command_line_parameter( 
+        "large_volume_disk_cache_size", disk_cache_size_string ) )
+      {
+        ImportFromString( disk_cache_size_string, disk_cache_size );
+      }
+
+      std::string error;
+      if ( !this->disk_cache_.open( disk_cache_dir, 
+        static_cast<long long>( disk_cache_size * ( 1 << 30 ) ), error ) )
+      {
+        CORE_LOG_ERROR( error );
+      }
+    }
   }
 
   ~LargeVolumeCachePrivate()
   {
     this->disconnect_all();
+    this->stop_loaders();
   }
 
-  void add_entry(const std::string& brick_name, DataBlockHandle data_block)
+  void start_loaders()
   {
-    lock_type lock( this->get_mutex() );
+    // Loading is mostly bound by I/O and decompression, use a few threads even on small machines
+    int num_loaders = static_cast<int>( boost::thread::hardware_concurrency() );
+    num_loaders = Core::Max( 2, Core::Min( MAX_NUM_LOADERS_C, num_loaders ) );
 
-    this->cache_access_list_.push_front( brick_name );
-    this->cache_size_ += data_block->get_byte_size();
+    for ( int j = 0; j < num_loaders; j++ )
+    {
+      this->loaders_.push_back( new boost::thread( 
+        boost::bind( &LargeVolumeCachePrivate::run_loader, this ) ) );
+    }
+  }
 
-    CacheEntry entry;
-    entry.data_block_ = data_block;
-    entry.access_record_ = this->cache_access_list_.begin();
-    this->cache_map_[ brick_name ] = entry;
+  void stop_loaders()
+  {
+    {
+      boost::mutex::scoped_lock lock( this->load_mutex_ );
+      this->done_ = true;
+      this->load_available_.notify_all();
+    }
 
-    this->constraint_cache_size();
+    for ( size_t j = 0; j < this->loaders_.size(); j++ )
+    {
+      this->loaders_[ j ]->join();
+      delete this->loaders_[ j ];
+    }
+    this->loaders_.clear();
   }
 
-  void constraint_cache_size()
+  LargeVolumeCacheShard& get_shard( brick_key_type key )
   {
-    while (this->cache_size_ > this->cache_capacity_)
+    // Neighboring bricks have consecutive keys, mix the bits before picking a shard
+    return this->shards_[ ( key * 0x9E3779B97F4A7C15ULL ) >> 60 ];
+  }
+
+  void add_entry( brick_key_type key, DataBlockHandle data_block )
+  {
+    evicted_list_type evicted;
+    this->get_shard( key ).add_entry( key, data_block, evicted );
+
+    // Spill the evicted bricks to the second tier without holding up lookups
+    if ( this->disk_cache_.is_open() )
     {
-      std::string brick_name = this->cache_access_list_.back();
-      cache_map_type::iterator it = this->cache_map_.find( brick_name );
-      this->cache_size_ -= it->second.data_block_->get_byte_size();
-      this->cache_access_list_.pop_back();
-      this->cache_map_.erase( it );
+      for ( size_t j = 0; j < evicted.size(); j++ )
+      {
+        this->disk_cache_.put_brick( evicted[ j ].first, evicted[ j ].second );
+      }
     }
   }
 
-  bool get_entry( const std::string& brick_name, DataBlockHandle& data_block )
+  bool get_entry( brick_key_type key, DataBlockHandle& data_block )
   {
-    lock_type lock( this->get_mutex() );
+    return this->get_shard( key ).get_entry( key, data_block );
+  }
 
-    cache_map_type::iterator it = this->cache_map_.find( brick_name );
-    if (it == this->cache_map_.end()) 
-      return false;
+  void clear_cache()
+  {
+    {
+      boost::mutex::scoped_lock lock( this->load_mutex_ );
+      this->load_queues_.clear();
+      this->failed_bricks_.clear();
+    }
 
-    this->cache_access_list_.erase( it->second.access_record_ );
-    this->cache_access_list_.push_front( brick_name );
-    it->second.access_record_ = this->cache_access_list_.begin();
-    data_block = it->second.data_block_;
+    for ( size_t j = 0; j < NUM_SHARDS_C; j++ )
+    {
+      this->shards_[ j ].clear();
+    }
 
-    return true;
+    this->disk_cache_.clear();
   }
 
-  void clear_cache()
+  bool get_disk_entry( brick_key_type key, DataBlockHandle& data_block )
   {
-    lock_type lock( this->get_mutex() );
+    if ( !this->disk_cache_.is_open() ) return false;
 
-    this->cache_access_list_.clear();
-    this->cache_map_.clear();
-    this->cache_size_ = 0;
+    bool found = this->disk_cache_.get_brick( key, data_block );
+
+    boost::mutex::scoped_lock lock( this->disk_statistics_mutex_ );
+    if ( found ) this->disk_hits_++; else this->disk_misses_++;
+    return found;
   }
 
-  void load_brick( LargeVolumeSchemaHandle schema, BrickInfo bi, std::string load_key )
+  LargeVolumeCacheStatistics get_statistics()
   {
-    this->jobs_[ load_key ].push( LoadJob( schema, bi ) );
+    LargeVolumeCacheStatistics statistics;
+    statistics.memory_hits_ = 0;
+    statistics.memory_misses_ = 0;
+    statistics.memory_size_ = 0;
+    statistics.memory_capacity_ = 0;
+    for ( size_t j = 0; j < NUM_SHARDS_C; j++ )
+    {
+      this->shards_[ j ].add_statistics( statistics );
+    }
 
-    this->post_event( boost::bind( &LargeVolumeCachePrivate::process_load_job, this, load_key ) );
+    statistics.disk_size_ = this->disk_cache_.get_size();
+    statistics.disk_capacity_ = this->disk_cache_.get_capacity();
+
+    boost::mutex::scoped_lock lock( this->disk_statistics_mutex_ );
+    statistics.disk_hits_ = this->disk_hits_;
+    statistics.disk_misses_ = this->disk_misses_;
+
+    return statistics;
   }
 
-  void process_load_job( std::string load_key )
+  double compute_distance( LargeVolumeSchemaHandle schema, const BrickInfo& bi, 
+    const Point& focus )
   {
-    if (! this->jobs_[ load_key ].empty() )
+    GridTransform trans = schema->get_brick_grid_transform( bi );
+    Point center = trans * Point( 0.5 * trans.get_nx() - 0.5, 0.5 * trans.get_ny() - 0.5,
+      0.5 * trans.get_nz() - 0.5 );
+    return ( center - focus ).length2();
+  }
+
+  // HAS_FAILED:
+  /// Check whether reading the brick failed before for this schema. The load mutex needs to be
+  /// locked.
+  bool has_failed( LargeVolumeSchemaHandle schema, brick_key_type key )
+  {
+    failed_brick_map_type::iterator it = this->failed_bricks_.find( key );
+    if ( it == this->failed_bricks_.end() ) return false;
+    if ( it->second.lock() == schema ) return true;
+
+    // The brick failed for a schema that has been reloaded or released since
+    this->failed_bricks_.erase( it );
+    return false;
+  }
+
+  void load_brick( LargeVolumeSchemaHandle schema, BrickInfo bi, const std::string& load_key,
+    const Point* focus )
+  {
+    boost::mutex::scoped_lock lock( this->load_mutex_ );
+    if ( this->has_failed( schema, schema->get_brick_key( bi ) ) ) return;
+
+    LoadQueue& queue = this->load_queues_[ load_key ];
+    if ( focus ) queue.focus_ = *focus;
+
+    queue.jobs_.push( LoadJob( schema, bi, this->compute_distance( schema, bi, queue.focus_ ) ) );
+    this->load_available_.notify_one();
+  }
+
+  void clear_load_queue( const std::string& load_key )
+  {
+    boost::mutex::scoped_lock lock( this->load_mutex_ );
+
+    load_queue_map_type::iterator it = this->load_queues_.find( load_key );
+    if ( it != this->load_queues_.end() )
     {
-      LoadJob lj = this->jobs_[ load_key ].front();
-      this->jobs_[ load_key ].pop();
+      it->second.jobs_ = std::priority_queue<LoadJob>();
+    }
+  }
 
-      std::string brick_name = lj.schema_->get_brick_file_name( lj.bi_ ).string();
-      DataBlockHandle data_block;
-      if (! this->get_entry( brick_name, data_block )) 
+  // POP_LOAD_JOB:
+  /// Take the most urgent job over all the load keys. The load mutex needs to be locked.
+  bool pop_load_job( LoadJob& job )
+  {
+    load_queue_map_type::iterator best = this->load_queues_.end();
+    for ( load_queue_map_type::iterator it = this->load_queues_.begin(); 
+      it != this->load_queues_.end(); ++it )
+    {
+      if ( it->second.jobs_.empty() ) continue;
+      if ( best == this->load_queues_.end() || best->second.jobs_.top() < it->second.jobs_.top() )
       {
-        std::string error;
-        lj.schema_->read_brick( data_block, lj.bi_, error );
-        this->add_entry( brick_name, data_block );
-        this->instance_->brick_loaded_signal_();
+        best = it;
       }
     }
 
-    if (! this->jobs_[ load_key ].empty() )
+    if ( best == this->load_queues_.end() ) return false;
+
+    job = best->second.jobs_.top();
+    best->second.jobs_.pop();
+    return true;
+  }
+
+  bool has_pending_loads()
+  {
+    if ( !this->bricks_in_flight_.empty() ) return true;
+    for ( load_queue_map_type::iterator it = this->load_queues_.begin(); 
+      it != this->load_queues_.end(); ++it )
     {
-      this->post_event( boost::bind( &LargeVolumeCachePrivate::process_load_job, this, load_key ) );  
+      if ( !it->second.jobs_.empty() ) return true;
     }
+    return false;
   }
 
-  void clear_load_queue( std::string load_key )
+  void run_loader()
   {
-    this->jobs_[ load_key ] = std::queue<LoadJob>();
+    while ( true )
+    {
+      LoadJob job;
+      {
+        boost::mutex::scoped_lock lock( this->load_mutex_ );
+        while ( !this->done_ && !this->pop_load_job( job ) )
+        {
+          this->load_available_.wait( lock );
+        }
+        if ( this->done_ ) return;
+
+        // The same brick can be requested by multiple viewers, only read it once
+        if ( this->has_failed( job.schema_, job.key_ ) ||
+          !this->bricks_in_flight_.insert( job.key_ ).second ) continue;
+      }
+
+      bool loaded = false;
+      bool failed = false;
+      DataBlockHandle data_block;
+      if ( !this->get_entry( job.key_, data_block ) )
+      {
+        std::string error;
+        if ( this->get_disk_entry( job.key_, data_block ) )
+        {
+          this->add_entry( job.key_, data_block );
+          loaded = true;
+        }
+        else if ( job.schema_->read_brick( data_block, job.bi_, error ) )
+        {
+          this->add_entry( job.key_, data_block );
+          loaded = true;
+        }
+        else
+        {
+          CORE_LOG_ERROR( error );
+          failed = true;
+        }
+      }
+
+      bool signal = false;
+      {
+        boost::mutex::scoped_lock lock( this->load_mutex_ );
+        this->bricks_in_flight_.erase( job.key_ );
+        if ( failed ) this->failed_bricks_[ job.key_ ] = job.schema_;
+        if ( loaded ) this->bricks_since_signal_++;
+
+        // Notify once the queues run dry, or periodically while a lot of bricks are loading
+        boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+        if ( this->bricks_since_signal_ > 0 && ( !this->has_pending_loads() || 
+          ( now - this->last_signal_time_ ).total_milliseconds() >= SIGNAL_INTERVAL_MS_C ) )
+        {
+          this->bricks_since_signal_ = 0;
+          this->last_signal_time_ = now;
+          signal = true;
+        }
+      }
+
+      if ( signal ) this->instance_->brick_loaded_signal_();
+    }
   }
 };
 
+const int LargeVolumeCachePrivate::MAX_NUM_LOADERS_C = 8;
+const long LargeVolumeCachePrivate::SIGNAL_INTERVAL_MS_C = 50;
+
 LargeVolumeCache::LargeVolumeCache() : private_( new LargeVolumeCachePrivate )
 {
   this->private_->instance_ = this;
-  this->private_->start_eventhandler();
+  this->private_->start_loaders();
 }
 
 LargeVolumeCache::~LargeVolumeCache()
@@ -209,36 +602,49 @@ LargeVolumeCache::~LargeVolumeCache()
 
 bool LargeVolumeCache::mark_brick( LargeVolumeSchemaHandle schema, const BrickInfo& bi )
 {
-  std::string brick_name = schema->get_brick_file_name( bi ).string();
-
   DataBlockHandle data_block;
-  return this->private_->get_entry( brick_name, data_block );
+  return this->private_->get_entry( schema->get_brick_key( bi ), data_block );
 }
 
 bool LargeVolumeCache::get_brick( LargeVolumeSchemaHandle schema, const BrickInfo& bi, 
   const std::string& load_key, DataBlockHandle& data_block )
 {
-  std::string brick_name = schema->get_brick_file_name( bi ).string();
-
-  if (this->private_->get_entry( brick_name, data_block ))
+  if (this->private_->get_entry( schema->get_brick_key( bi ), data_block ))
   {
     return true;
   }
 
-  this->private_->post_event( boost::bind( &LargeVolumeCachePrivate::load_brick, this->private_, schema, bi, load_key ) );
+  // Use the focus of the last request with this key
+  this->private_->load_brick( schema, bi, load_key, 0 );
 
   return false;
 }
 
-void LargeVolumeCache::load_brick( LargeVolumeSchemaHandle schema, const BrickInfo& bi, const std::string& load_key )
+void LargeVolumeCache::load_brick( LargeVolumeSchemaHandle schema, const BrickInfo& bi, 
+  const std::string& load_key, const Point& focus )
 {
-  DataBlockHandle data_block;
-  this->get_brick( schema, bi, load_key, data_block ); 
+  this->private_->load_brick( schema, bi, load_key, &focus );
 }
 
 void LargeVolumeCache::clear_load_queue( const std::string& load_key )
 {
-  this->private_->post_event( boost::bind( &LargeVolumeCachePrivate::clear_load_queue, this->private_, load_key ) );
+  this->private_->clear_load_queue( load_key );
+}
+
+bool LargeVolumeCache::enable_disk_cache( const boost::filesystem::path& dir, 
+  long long capacity, std::string& error )
+{
+  return this->private_->disk_cache_.open( dir, capacity, error );
+}
+
+void LargeVolumeCache::disable_disk_cache()
+{
+  this->private_->disk_cache_.close();
+}
+
+LargeVolumeCacheStatistics LargeVolumeCache::get_statistics()
+{
+  return this->private_->get_statistics();
 }
 
 } // end namespace
@@ -45,6 +45,21 @@ typedef boost::shared_ptr< LargeVolumeCache > LargeVolumeCacheHandle;
 class LargeVolumeCachePrivate;
 typedef boost::shared_ptr< LargeVolumeCachePrivate > LargeVolumeCachePrivateHandle;
 
+// STRUCT LARGEVOLUMECACHESTATISTICS:
+/// Hit and miss counters and sizes of the memory and disk tiers of the cache.
+struct LargeVolumeCacheStatistics
+{
+  long long memory_hits_;
+  long long memory_misses_;
+  long long memory_size_;
+  long long memory_capacity_;
+
+  long long disk_hits_;
+  long long disk_misses_;
+  long long disk_size_;
+  long long disk_capacity_;
+};
+
 class LargeVolumeCache
 {
   CORE_SINGLETON( LargeVolumeCache );
@@ -55,16 +70,47 @@ private:
 
   // -- header --
 public:
+  // MARK_BRICK:
+  /// Check whether a brick is in the cache and mark it as recently used.
   bool mark_brick( LargeVolumeSchemaHandle schema, const BrickInfo& bi );
 
+  // GET_BRICK:
+  /// Get a brick from the cache. If it is not available, it is scheduled for loading and false
+  /// is returned. Bricks that could not be read are not scheduled again until the volume is
+  /// loaded again.
   bool get_brick( LargeVolumeSchemaHandle schema, const BrickInfo& bi, 
     const std::string& load_key, DataBlockHandle& data_block );
 
+  // LOAD_BRICK:
+  /// Schedule a brick for loading. Coarser levels are loaded first and within a level bricks
+  /// closer to the focus point, normally the center of the viewport, are loaded first.
   void load_brick( LargeVolumeSchemaHandle schema, const BrickInfo& bi, 
-    const std::string& load_key );
+    const std::string& load_key, const Point& focus );
 
+  // CLEAR_LOAD_QUEUE:
+  /// Cancel all the bricks that were scheduled for loading with this key, but that have not
+  /// been picked up by a loader yet.
   void clear_load_queue( const std::string& load_key );
 
+  // ENABLE_DISK_CACHE:
+  /// Use a cache file of the given size in dir as second tier. Bricks that are evicted from
+  /// memory are stored decompressed in this file, so they can be paged back in quickly.
+  /// NOTE: The disk cache can also be enabled on the command line with 
+  /// --large_volume_disk_cache=<dir> and --large_volume_disk_cache_size=<GB>.
+  bool enable_disk_cache( const boost::filesystem::path& dir, long long capacity, 
+    std::string& error );
+
+  // DISABLE_DISK_CACHE:
+  /// Stop using the second tier and remove its cache file.
+  void disable_disk_cache();
+
+  // GET_STATISTICS:
+  /// Get the hit/miss counters and sizes of both tiers.
+  LargeVolumeCacheStatistics get_statistics();
+
+  // BRICK_LOADED_SIGNAL_:
+  /// Triggered when new bricks are available. Loads are batched, hence one signal may cover
+  /// multiple bricks.
   boost::signals2::signal<void()> brick_loaded_signal_;
 
 private:
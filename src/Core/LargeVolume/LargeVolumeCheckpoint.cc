@@ -0,0 +1,220 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+#include <fstream>
+#include <map>
+
+#include <boost/filesystem.hpp>
+
+#include <Core/Utils/StringUtil.h>
+#include <Core/LargeVolume/LargeVolumeCheckpoint.h>
+
+namespace bfs=boost::filesystem;
+
+namespace Core
+{
+
+LargeVolumeCheckpoint::LargeVolumeCheckpoint() :
+  phase_( 2 ),
+  num_slices_( 0 ),
+  append_start_( 0 ),
+  append_setup_( false ),
+  next_slice_( 0 ),
+  min_( 0.0 ),
+  max_( 0.0 ),
+  packing_( false )
+{
+}
+
+bool LargeVolumeCheckpoint::load( const bfs::path& dir, std::string& error )
+{
+  bfs::path filename = GetFileName( dir );
+
+  if ( !bfs::exists( filename ) )
+  {
+    error = "Could not open checkpoint file '" + filename.string() + "'.";
+    return false;
+  }
+
+  std::map<std::string,std::string> values;
+  try
+  {
+    std::ifstream file_text( filename.string().c_str() );
+    std::string line;
+
+    while( !file_text.eof() )
+    {
+      std::getline( file_text, line );
+
+      std::vector<std::string> key_value = SplitString( line, ":" );
+      if ( key_value.size() == 2 )
+      {
+        std::string val = key_value[1];
+        StripSurroundingSpaces( val );
+        values[key_value[0]] = val;
+      }
+    }
+  }
+  catch (...)
+  {
+    error = "Could not read checkpoint file '" + filename.string() + "'.";
+    return false;
+  }
+
+  const std::string corrupt_error = "Checkpoint file '" + filename.string() + "' is corrupt.";
+  size_t num_levels = 0;
+  if ( !ImportFromString( values[ "phase" ], this->phase_ ) ||
+    !ImportFromString( values[ "slices" ], this->num_slices_ ) ||
+    !ImportFromString( values[ "appendstart" ], this->append_start_ ) ||
+    !ImportFromString( values[ "appendsetup" ], this->append_setup_ ) ||
+    !ImportFromString( values[ "nextslice" ], this->next_slice_ ) ||
+    !ImportFromString( values[ "min" ], this->min_ ) ||
+    !ImportFromString( values[ "max" ], this->max_ ) ||
+    !ImportFromString( values[ "packing" ], this->packing_ ) ||
+    !ImportFromString( values[ "levels" ], num_levels ) )
+  {
+    error = corrupt_error;
+    return false;
+  }
+
+  this->level_index_.resize( num_levels );
+  this->level_count_.resize( num_levels );
+  this->level_next_brick_.resize( num_levels );
+  for ( size_t j = 0; j < num_levels; j++ )
+  {
+    std::string level = "level" + ExportToString( j );
+    if ( !ImportFromString( values[ level + "index" ], this->level_index_[ j ] ) ||
+      !ImportFromString( values[ level + "count" ], this->level_count_[ j ] ) ||
+      !ImportFromString( values[ level + "nextbrick" ], this->level_next_brick_[ j ] ) )
+    {
+      error = corrupt_error;
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool LargeVolumeCheckpoint::save( const bfs::path& dir, std::string& error ) const
+{
+  bfs::path filename = GetFileName( dir );
+  bfs::path temp_filename = filename.string() + ".tmp";
+
+  try
+  {
+    std::ofstream text_file( temp_filename.string().c_str() );
+
+    text_file << "phase: " << ExportToString( this->phase_ ) << std::endl;
+    text_file << "slices: " << ExportToString( this->num_slices_ ) << std::endl;
+    text_file << "appendstart: " << ExportToString( this->append_start_ ) << std::endl;
+    text_file << "appendsetup: " << ExportToString( this->append_setup_ ) << std::endl;
+    text_file << "nextslice: " << ExportToString( this->next_slice_ ) << std::endl;
+    text_file << "min: " << ExportToString( this->min_ ) << std::endl;
+    text_file << "max: " << ExportToString( this->max_ ) << std::endl;
+    text_file << "packing: " << ExportToString( this->packing_ ) << std::endl;
+    text_file << "levels: " << ExportToString( this->level_index_.size() ) << std::endl;
+
+    for ( size_t j = 0; j < this->level_index_.size(); j++ )
+    {
+      text_file << "level" << j << "index: " << ExportToString( this->level_index_[ j ] ) << std::endl;
+      text_file << "level" << j << "count: " << ExportToString( this->level_count_[ j ] ) << std::endl;
+      text_file << "level" << j << "nextbrick: " << ExportToString( this->level_next_brick_[ j ] ) << std::endl;
+    }
+
+    if ( !text_file )
+    {
+      error = "Could not write checkpoint file '" + filename.string() + "'.";
+      return false;
+    }
+  }
+  catch (...)
+  {
+    error = "Could not write checkpoint file '" + filename.string() + "'.";
+    return false;
+  }
+
+  // Replace the old checkpoint in one step, so an interruption leaves a valid checkpoint behind
+  boost::system::error_code ec;
+  bfs::rename( temp_filename, filename, ec );
+  if ( ec )
+  {
+    error = "Could not write checkpoint file '" + filename.string() + "'.";
+    return false;
+  }
+
+  return true;
+}
+
+bool LargeVolumeCheckpoint::Exists( const bfs::path& dir )
+{
+  return bfs::exists( GetFileName( dir ) );
+}
+
+void LargeVolumeCheckpoint::Remove( const bfs::path& dir )
+{
+  boost::system::error_code ec;
+  bfs::remove( GetFileName( dir ), ec );
+  RemoveSlices( dir );
+}
+
+void LargeVolumeCheckpoint::RemoveSlices( const bfs::path& dir )
+{
+  std::vector<bfs::path> slice_files;
+
+  boost::system::error_code ec;
+  bfs::directory_iterator end;
+  for ( bfs::directory_iterator it( dir, ec ); !ec && it != end; it.increment( ec ) )
+  {
+    if ( it->path().filename().string().compare( 0, 11, "conversion_" ) == 0 )
+    {
+      slice_files.push_back( it->path() );
+    }
+  }
+
+  for ( size_t j = 0; j < slice_files.size(); j++ )
+  {
+    bfs::remove( slice_files[ j ], ec );
+  }
+}
+
+bfs::path LargeVolumeCheckpoint::GetFileName( const bfs::path& dir )
+{
+  return dir / "conversion.txt";
+}
+
+bfs::path LargeVolumeCheckpoint::GetSliceFileName( const bfs::path& dir, size_t next_slice, size_t level )
+{
+  return dir / ( "conversion_" + ExportToString( next_slice ) + "_level" + ExportToString( level ) + ".raw" );
+}
+
+bfs::path LargeVolumeCheckpoint::GetAppendDir( const bfs::path& dir )
+{
+  return dir / "append_backup";
+}
+
+} // end namespace Core
@@ -0,0 +1,128 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef CORE_LARGEVOLUME_LARGEVOLUMECHECKPOINT_H
+#define CORE_LARGEVOLUME_LARGEVOLUMECHECKPOINT_H
+
+// STL includes
+#include <string>
+#include <vector>
+
+// Boost includes
+#include <boost/filesystem/path.hpp>
+
+namespace Core
+{
+
+// CLASS LARGEVOLUMECHECKPOINT:
+/// Progress of a large volume conversion, stored in the output directory next to the volume
+/// file. Phase 2 records the last slice of which all bricks were written to disk together with
+/// the state of each level, phase 3 records how many bricks of each level have been processed.
+/// An interrupted conversion continues from the last checkpoint instead of starting over.
+
+class LargeVolumeCheckpoint
+{
+  // -- constructor --
+public:
+  LargeVolumeCheckpoint();
+
+  // -- state --
+public:
+  // Phase that was running, 2 for bricking and 3 for compressing the bricks
+  size_t phase_;
+
+  // Number of slices of the volume that is being built
+  size_t num_slices_;
+
+  // Number of slices the volume had before new slices were appended, these are read back from
+  // the bricks in the append backup directory. Zero if slices are not being appended.
+  size_t append_start_;
+
+  // Whether the bricks that are affected by appending slices still need to be prepared
+  bool append_setup_;
+
+  // -- phase 2 --
+  // Next slice that needs to be processed
+  size_t next_slice_;
+
+  double min_;
+  double max_;
+
+  // Number of slices processed for each level
+  std::vector<size_t> level_index_;
+
+  // Number of slices written to the bricks of each level, including the overlap
+  std::vector<size_t> level_count_;
+
+  // -- phase 3 --
+  // All bricks of a level before this index have been processed
+  std::vector<size_t> level_next_brick_;
+
+  // Whether part of the bricks has been written to the pack files
+  bool packing_;
+
+  // -- loading/saving --
+public:
+  /// LOAD
+  /// Load the checkpoint from a conversion directory
+  bool load( const boost::filesystem::path& dir, std::string& error );
+
+  /// SAVE
+  /// Replace the checkpoint in a conversion directory
+  bool save( const boost::filesystem::path& dir, std::string& error ) const;
+
+  /// EXISTS
+  /// Check whether a conversion directory contains a checkpoint
+  static bool Exists( const boost::filesystem::path& dir );
+
+  /// REMOVE
+  /// Remove the checkpoint and its slice files once the conversion is done
+  static void Remove( const boost::filesystem::path& dir );
+
+  /// REMOVE_SLICES
+  /// Remove the slice files that were stored with the checkpoints
+  static void RemoveSlices( const boost::filesystem::path& dir );
+
+  /// GET_FILE_NAME
+  /// Name of the checkpoint file
+  static boost::filesystem::path GetFileName( const boost::filesystem::path& dir );
+
+  /// GET_SLICE_FILE_NAME
+  /// Name of the file that holds the partially down sampled slice of a level at a checkpoint
+  static boost::filesystem::path GetSliceFileName( const boost::filesystem::path& dir,
+    size_t next_slice, size_t level );
+
+  /// GET_APPEND_DIR
+  /// Directory where the bricks that are rewritten when appending slices are kept until the
+  /// new slices have been bricked
+  static boost::filesystem::path GetAppendDir( const boost::filesystem::path& dir );
+};
+
+} // end namespace Core
+
+#endif
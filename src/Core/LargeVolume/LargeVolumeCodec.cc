@@ -0,0 +1,669 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+#include <zlib.h>
+
+#include <cstring>
+
+#include <boost/cstdint.hpp>
+#include <boost/algorithm/string.hpp>
+
+#include <Core/DataBlock/DataBlock.h>
+#include <Core/LargeVolume/LargeVolumeCodec.h>
+
+namespace Core
+{
+
+#ifdef Z_PREFIX
+  #define zlib_uLongf z_uLongf
+  #define zlib_Bytef z_Bytef
+  #define zlib_uncompress z_uncompress
+  #define zlib_compress2 z_compress2
+#else
+  #define zlib_uLongf uLongf
+  #define zlib_Bytef Bytef
+  #define zlib_uncompress uncompress
+  #define zlib_compress2 compress2
+#endif
+
+bool ImportFromString( const std::string& codec_string, BrickCodec& codec )
+{
+  std::string lower_codec = boost::to_lower_copy( codec_string ); 
+  boost::erase_all( lower_codec, " " );
+
+  if ( lower_codec == "none" )
+  {
+    codec = BrickCodec::NONE_E;
+    return true;
+  }
+  else if ( lower_codec == "lz4" )
+  {
+    codec = BrickCodec::LZ4_E;
+    return true;
+  }
+  else if ( lower_codec == "zlib" )
+  {
+    codec = BrickCodec::ZLIB_E;
+    return true;
+  }
+  else if ( lower_codec == "zlib-high" )
+  {
+    codec = BrickCodec::ZLIB_HIGH_E;
+    return true;
+  }
+
+  return false;
+}
+
+std::string ExportToString( BrickCodec codec )
+{
+  switch ( codec )
+  {
+    case BrickCodec::LZ4_E:
+      return "lz4";
+    case BrickCodec::ZLIB_E:
+      return "zlib";
+    case BrickCodec::ZLIB_HIGH_E:
+      return "zlib-high";
+    default:
+      return "none";
+  }
+}
+
+bool ImportFromString( const std::string& filter_string, BrickFilter& filter )
+{
+  std::string lower_filter = boost::to_lower_copy( filter_string ); 
+  boost::erase_all( lower_filter, " " );
+
+  if ( lower_filter == "none" )
+  {
+    filter = BrickFilter::NONE_E;
+    return true;
+  }
+  else if ( lower_filter == "shuffle" )
+  {
+    filter = BrickFilter::SHUFFLE_E;
+    return true;
+  }
+  else if ( lower_filter == "delta" )
+  {
+    filter = BrickFilter::DELTA_E;
+    return true;
+  }
+
+  return false;
+}
+
+std::string ExportToString( BrickFilter filter )
+{
+  switch ( filter )
+  {
+    case BrickFilter::SHUFFLE_E:
+      return "shuffle";
+    case BrickFilter::DELTA_E:
+      return "delta";
+    default:
+      return "none";
+  }
+}
+
+// Layout of the header in front of each brick:
+// 4 bytes magic "S3DB", 1 byte version, 1 byte codec, 1 byte filter, 1 byte element size,
+// 8 bytes little endian size of the decoded data
+static const char BRICK_MAGIC_C[ 4 ] = { 'S', '3', 'D', 'B' };
+static const unsigned char BRICK_VERSION_C = 1;
+static const size_t BRICK_HEADER_SIZE_C = 16;
+
+// -- filters --
+
+static void Shuffle( const char* input, char* output, size_t num_elems, size_t elem_size )
+{
+  for ( size_t b = 0; b < elem_size; b++ )
+  {
+    char* plane = output + b * num_elems;
+    const char* src = input + b;
+    for ( size_t j = 0; j < num_elems; j++, src += elem_size )
+    {
+      plane[ j ] = *src;
+    }
+  }
+}
+
+static void Unshuffle( const char* input, char* output, size_t num_elems, size_t elem_size )
+{
+  for ( size_t b = 0; b < elem_size; b++ )
+  {
+    const char* plane = input + b * num_elems;
+    char* dst = output + b;
+    for ( size_t j = 0; j < num_elems; j++, dst += elem_size )
+    {
+      *dst = plane[ j ];
+    }
+  }
+}
+
+template< class T >
+static T SwapBytes( T value, bool swap )
+{
+  if ( !swap ) return value;
+  T result;
+  const char* src = reinterpret_cast<const char*>( &value );
+  char* dst = reinterpret_cast<char*>( &result );
+  for ( size_t j = 0; j < sizeof( T ); j++ ) dst[ j ] = src[ sizeof( T ) - 1 - j ];
+  return result;
+}
+
+// The differences are computed with unsigned wrap around, so they can be undone exactly
+template< class T >
+static void DeltaEncode( char* data, size_t num_elems, bool swap )
+{
+  T previous = 0;
+  for ( size_t j = 0; j < num_elems; j++ )
+  {
+    T value;
+    std::memcpy( &value, data + j * sizeof( T ), sizeof( T ) );
+    value = SwapBytes( value, swap );
+    T delta = static_cast<T>( value - previous );
+    previous = value;
+    delta = SwapBytes( delta, swap );
+    std::memcpy( data + j * sizeof( T ), &delta, sizeof( T ) );
+  }
+}
+
+template< class T >
+static void DeltaDecode( char* data, size_t num_elems, bool swap )
+{
+  T previous = 0;
+  for ( size_t j = 0; j < num_elems; j++ )
+  {
+    T delta;
+    std::memcpy( &delta, data + j * sizeof( T ), sizeof( T ) );
+    T value = static_cast<T>( previous + SwapBytes( delta, swap ) );
+    previous = value;
+    value = SwapBytes( value, swap );
+    std::memcpy( data + j * sizeof( T ), &value, sizeof( T ) );
+  }
+}
+
+static bool Delta( char* data, size_t size, size_t elem_size, bool little_endian, bool encode )
+{
+  bool swap = ( little_endian != DataBlock::IsLittleEndian() );
+  size_t num_elems = size / elem_size;
+
+  switch ( elem_size )
+  {
+    case 1:
+      if ( encode ) DeltaEncode<boost::uint8_t>( data, num_elems, swap );
+      else DeltaDecode<boost::uint8_t>( data, num_elems, swap );
+      return true;
+    case 2:
+      if ( encode ) DeltaEncode<boost::uint16_t>( data, num_elems, swap );
+      else DeltaDecode<boost::uint16_t>( data, num_elems, swap );
+      return true;
+    case 4:
+      if ( encode ) DeltaEncode<boost::uint32_t>( data, num_elems, swap );
+      else DeltaDecode<boost::uint32_t>( data, num_elems, swap );
+      return true;
+    case 8:
+      if ( encode ) DeltaEncode<boost::uint64_t>( data, num_elems, swap );
+      else DeltaDecode<boost::uint64_t>( data, num_elems, swap );
+      return true;
+    default:
+      return false;
+  }
+}
+
+// -- LZ4 block format --
+
+static const size_t LZ4_MIN_MATCH_C = 4;
+static const size_t LZ4_LAST_LITERALS_C = 5;
+static const size_t LZ4_MF_LIMIT_C = 12;
+static const size_t LZ4_HASH_LOG_C = 16;
+static const size_t LZ4_MAX_DISTANCE_C = 65535;
+
+static inline boost::uint32_t LZ4Read32( const unsigned char* ptr )
+{
+  boost::uint32_t value;
+  std::memcpy( &value, ptr, 4 );
+  return value;
+}
+
+static inline size_t LZ4Hash( boost::uint32_t sequence )
+{
+  return static_cast<size_t>( ( sequence * 2654435761U ) >> ( 32 - LZ4_HASH_LOG_C ) );
+}
+
+static inline unsigned char* LZ4WriteLength( unsigned char* op, size_t length )
+{
+  while ( length >= 255 )
+  {
+    *op++ = 255;
+    length -= 255;
+  }
+  *op++ = static_cast<unsigned char>( length );
+  return op;
+}
+
+static inline unsigned char* LZ4WriteSequence( unsigned char* op, const unsigned char* literals, 
+  size_t num_literals, size_t offset, size_t match_length, bool last )
+{
+  unsigned char* token = op++;
+  
+  if ( num_literals >= 15 )
+  {
+    *token = 15 << 4;
+    op = LZ4WriteLength( op, num_literals - 15 );
+  }
+  else
+  {
+    *token = static_cast<unsigned char>( num_literals << 4 );
+  }
+
+  if ( num_literals > 0 ) std::memcpy( op, literals, num_literals );
+  op += num_literals;
+
+  if ( last ) return op;
+
+  *op++ = static_cast<unsigned char>( offset & 0xff );
+  *op++ = static_cast<unsigned char>( offset >> 8 );
+
+  size_t length = match_length - LZ4_MIN_MATCH_C;
+  if ( length >= 15 )
+  {
+    *token |= 15;
+    op = LZ4WriteLength( op, length - 15 );
+  }
+  else
+  {
+    *token |= static_cast<unsigned char>( length );
+  }
+
+  return op;
+}
+
+size_t LargeVolumeCodec::LZ4CompressBound( size_t size )
+{
+  return size + size / 255 + 16;
+}
+
+size_t LargeVolumeCodec::LZ4Compress( const char* data, size_t size, char* output )
+{
+  const unsigned char* const src = reinterpret_cast<const unsigned char*>( data );
+  const unsigned char* const src_end = src + size;
+  unsigned char* op = reinterpret_cast<unsigned char*>( output );
+
+  const unsigned char* ip = src;
+  const unsigned char* anchor = src;
+
+  if ( size > LZ4_MF_LIMIT_C )
+  {
+    // Matches may not start in the last 12 bytes and need to end 5 bytes before the end
+    const unsigned char* const match_start_limit = src_end - LZ4_MF_LIMIT_C;
+    const unsigned char* const match_end_limit = src_end - LZ4_LAST_LITERALS_C;
+
+    std::vector<boost::uint32_t> table( static_cast<size_t>( 1 ) << LZ4_HASH_LOG_C, 0 );
+    size_t misses = 0;
+
+    while ( ip < match_start_limit )
+    {
+      boost::uint32_t sequence = LZ4Read32( ip );
+      size_t hash = LZ4Hash( sequence );
+      const unsigned char* ref = src + table[ hash ];
+      table[ hash ] = static_cast<boost::uint32_t>( ip - src );
+
+      if ( ref >= ip || static_cast<size_t>( ip - ref ) > LZ4_MAX_DISTANCE_C || 
+        LZ4Read32( ref ) != sequence )
+      {
+        // Skip ahead faster through data that does not compress
+        ip += 1 + ( misses++ >> 6 );
+        continue;
+      }
+      misses = 0;
+
+      // Extend the match backwards over the pending literals
+      while ( ip > anchor && ref > src && ip[ -1 ] == ref[ -1 ] )
+      {
+        ip--;
+        ref--;
+      }
+
+      const unsigned char* match_end = ip + LZ4_MIN_MATCH_C;
+      const unsigned char* ref_end = ref + LZ4_MIN_MATCH_C;
+      while ( match_end < match_end_limit && *match_end == *ref_end )
+      {
+        match_end++;
+        ref_end++;
+      }
+
+      op = LZ4WriteSequence( op, anchor, ip - anchor, ip - ref, match_end - ip, false );
+      ip = match_end;
+      anchor = ip;
+    }
+  }
+
+  op = LZ4WriteSequence( op, anchor, src_end - anchor, 0, 0, true );
+  return static_cast<size_t>( op - reinterpret_cast<unsigned char*>( output ) );
+}
+
+bool LargeVolumeCodec::LZ4Decompress( const char* data, size_t length, char* output, size_t size )
+{
+  const unsigned char* ip = reinterpret_cast<const unsigned char*>( data );
+  const unsigned char* const ip_end = ip + length;
+  unsigned char* const dst = reinterpret_cast<unsigned char*>( output );
+  unsigned char* op = dst;
+  unsigned char* const op_end = dst + size;
+
+  while ( ip < ip_end )
+  {
+    unsigned char token = *ip++;
+
+    size_t num_literals = token >> 4;
+    if ( num_literals == 15 )
+    {
+      unsigned char extra;
+      do
+      {
+        if ( ip >= ip_end ) return false;
+        extra = *ip++;
+        num_literals += extra;
+      } while ( extra == 255 );
+    }
+
+    if ( num_literals > static_cast<size_t>( ip_end - ip ) || 
+      num_literals > static_cast<size_t>( op_end - op ) )
+    {
+      return false;
+    }
+    if ( num_literals > 0 ) std::memcpy( op, ip, num_literals );
+    ip += num_literals;
+    op += num_literals;
+
+    // The last sequence only contains literals
+    if ( ip == ip_end ) break;
+
+    if ( ip_end - ip < 2 ) return false;
+    size_t offset = ip[ 0 ] | ( static_cast<size_t>( ip[ 1 ] ) << 8 );
+    ip += 2;
+    if ( offset == 0 || offset > static_cast<size_t>( op - dst ) ) return false;
+
+    size_t match_length = token & 15;
+    if ( match_length == 15 )
+    {
+      unsigned char extra;
+      do
+      {
+        if ( ip >= ip_end ) return false;
+        extra = *ip++;
+        match_length += extra;
+      } while ( extra == 255 );
+    }
+    match_length += LZ4_MIN_MATCH_C;
+
+    if ( match_length > static_cast<size_t>( op_end - op ) ) return false;
+
+    const unsigned char* match = op - offset;
+    if ( offset >= match_length )
+    {
+      std::memcpy( op, match, match_length );
+      op += match_length;
+    }
+    else
+    {
+      // Overlapping copy repeats the last offset bytes
+      for ( size_t j = 0; j < match_length; j++ ) *op++ = *match++;
+    }
+  }
+
+  return op == op_end;
+}
+
+// -- bricks --
+
+size_t LargeVolumeCodec::GetHeaderSize()
+{
+  return BRICK_HEADER_SIZE_C;
+}
+
+// Compress input behind the header in buffer. Returns false unless the data including the header
+// gets smaller, which ensures an encoded brick never has the size of the raw brick.
+static bool Compress( const char* input, size_t size, BrickCodec codec, std::vector<char>& buffer )
+{
+  if ( codec == BrickCodec::LZ4_E )
+  {
+    buffer.resize( BRICK_HEADER_SIZE_C + LargeVolumeCodec::LZ4CompressBound( size ) );
+    size_t length = LargeVolumeCodec::LZ4Compress( input, size, &buffer[ BRICK_HEADER_SIZE_C ] );
+    if ( length + BRICK_HEADER_SIZE_C >= size ) return false;
+    buffer.resize( BRICK_HEADER_SIZE_C + length );
+    return true;
+  }
+  else if ( codec == BrickCodec::ZLIB_E || codec == BrickCodec::ZLIB_HIGH_E )
+  {
+    // Only results smaller than the input are of use, so a larger buffer is not needed
+    buffer.resize( BRICK_HEADER_SIZE_C + size );
+    zlib_uLongf length = size;
+    int level = ( codec == BrickCodec::ZLIB_HIGH_E ) ? Z_BEST_COMPRESSION : Z_DEFAULT_COMPRESSION;
+    if ( zlib_compress2( reinterpret_cast<zlib_Bytef*>( &buffer[ BRICK_HEADER_SIZE_C ] ), &length,
+      reinterpret_cast<const zlib_Bytef*>( input ), size, level ) != Z_OK || 
+      length + BRICK_HEADER_SIZE_C >= size )
+    {
+      return false;
+    }
+    buffer.resize( BRICK_HEADER_SIZE_C + length );
+    return true;
+  }
+
+  return false;
+}
+
+// Write the brick header in front of the payload in buffer
+static void WriteHeader( std::vector<char>& buffer, BrickCodec codec, BrickFilter filter,
+  size_t elem_size, size_t size )
+{
+  std::memcpy( &buffer[ 0 ], BRICK_MAGIC_C, 4 );
+  buffer[ 4 ] = static_cast<char>( BRICK_VERSION_C );
+  buffer[ 5 ] = static_cast<char>( static_cast<int>( codec ) );
+  buffer[ 6 ] = static_cast<char>( static_cast<int>( filter ) );
+  buffer[ 7 ] = static_cast<char>( elem_size );
+  boost::uint64_t size64 = size;
+  for ( size_t j = 0; j < 8; j++ )
+  {
+    buffer[ 8 + j ] = static_cast<char>( ( size64 >> ( 8 * j ) ) & 0xff );
+  }
+}
+
+bool LargeVolumeCodec::EncodeBrick( const char* data, size_t size, DataType data_type, 
+  bool little_endian, BrickCodec codec, BrickFilter filter, std::vector<char>& buffer, 
+  std::string& error )
+{
+  error = "";
+  size_t elem_size = GetSizeDataType( data_type );
+  if ( elem_size == 0 )
+  {
+    error = "Brick has an unknown data type.";
+    return false;
+  }
+
+  // An empty brick is only a header
+  if ( size == 0 )
+  {
+    buffer.resize( BRICK_HEADER_SIZE_C );
+    WriteHeader( buffer, BrickCodec::NONE_E, BrickFilter::NONE_E, elem_size, size );
+    return true;
+  }
+
+  try
+  {
+    // Skip the filters that do not apply to this data type
+    if ( codec == BrickCodec::NONE_E || size % elem_size != 0 ||
+      ( filter == BrickFilter::SHUFFLE_E && elem_size == 1 ) ||
+      ( filter == BrickFilter::DELTA_E && !IsInteger( data_type ) ) )
+    {
+      filter = BrickFilter::NONE_E;
+    }
+
+    const char* input = data;
+    std::vector<char> filtered;
+    if ( filter != BrickFilter::NONE_E )
+    {
+      std::vector<char> delta;
+      if ( filter == BrickFilter::DELTA_E )
+      {
+        delta.assign( data, data + size );
+        Delta( &delta[ 0 ], size, elem_size, little_endian, true );
+        input = &delta[ 0 ];
+      }
+
+      filtered.resize( size );
+      Shuffle( input, &filtered[ 0 ], size / elem_size, elem_size );
+      input = &filtered[ 0 ];
+    }
+
+    if ( !Compress( input, size, codec, buffer ) )
+    {
+      // Store bricks that do not compress as is
+      codec = BrickCodec::NONE_E;
+      filter = BrickFilter::NONE_E;
+      buffer.resize( BRICK_HEADER_SIZE_C + size );
+      std::memcpy( &buffer[ BRICK_HEADER_SIZE_C ], data, size );
+    }
+  }
+  catch ( ... )
+  {
+    error = "Could not allocate memory to encode brick.";
+    return false;
+  }
+
+  WriteHeader( buffer, codec, filter, elem_size, size );
+  return true;
+}
+
+bool LargeVolumeCodec::DecodeBrick( const char* data, size_t length, char* output, size_t size, 
+  DataType data_type, bool little_endian, std::string& error )
+{
+  if ( length < BRICK_HEADER_SIZE_C || std::memcmp( data, BRICK_MAGIC_C, 4 ) != 0 )
+  {
+    error = "Brick does not have a valid header.";
+    return false;
+  }
+
+  if ( static_cast<unsigned char>( data[ 4 ] ) > BRICK_VERSION_C )
+  {
+    error = "Brick was written by a newer version of the program.";
+    return false;
+  }
+
+  int codec = static_cast<unsigned char>( data[ 5 ] );
+  int filter = static_cast<unsigned char>( data[ 6 ] );
+  size_t elem_size = static_cast<unsigned char>( data[ 7 ] );
+  boost::uint64_t size64 = 0;
+  for ( size_t j = 0; j < 8; j++ )
+  {
+    size64 |= static_cast<boost::uint64_t>( static_cast<unsigned char>( data[ 8 + j ] ) ) << ( 8 * j );
+  }
+
+  if ( size64 != size || elem_size != GetSizeDataType( data_type ) )
+  {
+    error = "Brick has an incorrect size.";
+    return false;
+  }
+
+  const char* payload = data + BRICK_HEADER_SIZE_C;
+  size_t payload_length = length - BRICK_HEADER_SIZE_C;
+
+  // Filtered data is decompressed into a scratch buffer first
+  std::vector<char> filtered;
+  char* target = output;
+  if ( filter != BrickFilter::NONE_E )
+  {
+    if ( elem_size == 0 || size % elem_size != 0 )
+    {
+      error = "Brick has an incorrect size.";
+      return false;
+    }
+    filtered.resize( size );
+    target = size > 0 ? &filtered[ 0 ] : output;
+  }
+
+  switch ( codec )
+  {
+    case BrickCodec::NONE_E:
+      if ( payload_length != size )
+      {
+        error = "Brick has an incorrect size.";
+        return false;
+      }
+      if ( size > 0 ) std::memcpy( target, payload, size );
+      break;
+    case BrickCodec::LZ4_E:
+      if ( !LZ4Decompress( payload, payload_length, target, size ) )
+      {
+        error = "Could not decompress brick.";
+        return false;
+      }
+      break;
+    case BrickCodec::ZLIB_E:
+    case BrickCodec::ZLIB_HIGH_E:
+      {
+        zlib_uLongf size_ul = size;
+        if ( zlib_uncompress( reinterpret_cast<zlib_Bytef*>( target ), &size_ul,
+          reinterpret_cast<const zlib_Bytef*>( payload ), payload_length ) != Z_OK || 
+          size_ul != size )
+        {
+          error = "Could not decompress brick.";
+          return false;
+        }
+      }
+      break;
+    default:
+      error = "Brick uses an unknown codec.";
+      return false;
+  }
+
+  switch ( filter )
+  {
+    case BrickFilter::NONE_E:
+      break;
+    case BrickFilter::SHUFFLE_E:
+      Unshuffle( target, output, size / elem_size, elem_size );
+      break;
+    case BrickFilter::DELTA_E:
+      Unshuffle( target, output, size / elem_size, elem_size );
+      if ( !Delta( output, size, elem_size, little_endian, false ) )
+      {
+        error = "Brick uses a filter that does not apply to its data type.";
+        return false;
+      }
+      break;
+    default:
+      error = "Brick uses an unknown filter.";
+      return false;
+  }
+
+  return true;
+}
+
+} // end namespace Core
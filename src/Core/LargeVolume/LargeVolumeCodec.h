@@ -0,0 +1,132 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+#ifndef CORE_LARGEVOLUME_LARGEVOLUMECODEC_H
+#define CORE_LARGEVOLUME_LARGEVOLUMECODEC_H
+
+// STL includes
+#include <string>
+#include <vector>
+
+// Core includes
+#include <Core/Utils/EnumClass.h>
+#include <Core/DataBlock/DataType.h>
+
+namespace Core
+{
+
+// CLASS BrickCodec:
+/// Compression method of a brick
+/// NONE_E      - data is stored as is
+/// LZ4_E       - LZ4 block format, fast to compress and very fast to decompress
+/// ZLIB_E      - zlib at its default level, as used by older volumes
+/// ZLIB_HIGH_E - zlib at its highest level, best ratio but slow to compress
+
+CORE_ENUM_CLASS
+(
+  BrickCodec,
+  NONE_E = 0,
+  LZ4_E,
+  ZLIB_E,
+  ZLIB_HIGH_E
+)
+
+// IMPORTFROMSTRING:
+/// Import a BrickCodec from a string ("none", "lz4", "zlib" or "zlib-high")
+bool ImportFromString( const std::string& codec_string, BrickCodec& codec );
+
+// EXPORTTOSTRING:
+/// Export a BrickCodec to a string
+std::string ExportToString( BrickCodec codec );
+
+// CLASS BrickFilter:
+/// Transformation applied to the data before compression
+/// NONE_E    - no transformation
+/// SHUFFLE_E - group the bytes by significance, so the mostly constant high bytes of 16 bit
+///             data end up next to each other
+/// DELTA_E   - store the difference with the previous value and shuffle the result, which
+///             works well for smooth integer data such as EM stacks
+
+CORE_ENUM_CLASS
+(
+  BrickFilter,
+  NONE_E = 0,
+  SHUFFLE_E,
+  DELTA_E
+)
+
+// IMPORTFROMSTRING:
+/// Import a BrickFilter from a string ("none", "shuffle" or "delta")
+bool ImportFromString( const std::string& filter_string, BrickFilter& filter );
+
+// EXPORTTOSTRING:
+/// Export a BrickFilter to a string
+std::string ExportToString( BrickFilter filter );
+
+// CLASS LARGEVOLUMECODEC:
+/// Encoding of bricks on disk. Every encoded brick starts with a small header that records the
+/// codec and filter that were used, hence the choice can differ per brick: bricks that do not
+/// compress are stored uncompressed, and filters that do not apply to the data type are skipped.
+
+class LargeVolumeCodec
+{
+public:
+  // ENCODEBRICK:
+  /// Encode size bytes of brick data of the given type into buffer, including the header.
+  /// Little_endian indicates the byte order of the data. Fails if the data type is unknown or
+  /// the buffers cannot be allocated.
+  static bool EncodeBrick( const char* data, size_t size, DataType data_type, bool little_endian,
+    BrickCodec codec, BrickFilter filter, std::vector<char>& buffer, std::string& error );
+
+  // DECODEBRICK:
+  /// Decode an encoded brick into size bytes of output.
+  static bool DecodeBrick( const char* data, size_t length, char* output, size_t size, 
+    DataType data_type, bool little_endian, std::string& error );
+
+  // GETHEADERSIZE:
+  /// Number of bytes the header adds to each brick
+  static size_t GetHeaderSize();
+
+  // -- LZ4 block format --
+public:
+  // LZ4COMPRESSBOUND:
+  /// Worst case size of LZ4 compressed data
+  static size_t LZ4CompressBound( size_t size );
+
+  // LZ4COMPRESS:
+  /// Compress data into output, which needs to be at least LZ4CompressBound( size ) bytes.
+  /// Returns the compressed size.
+  static size_t LZ4Compress( const char* data, size_t size, char* output );
+
+  // LZ4DECOMPRESS:
+  /// Decompress data into exactly size bytes of output. Returns false on malformed input.
+  static bool LZ4Decompress( const char* data, size_t length, char* output, size_t size );
+};
+
+} // end namespace Core
+
+#endif
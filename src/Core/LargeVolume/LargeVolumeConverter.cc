@@ -26,16 +26,27 @@
  DEALINGS IN THE SOFTWARE.
  */
 
+#include <algorithm>
+#include <cstring>
 #include <string>
 #include <vector>
+#include <deque>
+#include <fstream>
 #include <iomanip>
+#include <limits>
+#include <sstream>
 
+#include <boost/thread.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include <Core/DataBlock/Histogram.h>
 #include <Core/DataBlock/ITKDataBlock.h>
 #include <Core/DataBlock/ITKImage2DData.h>
 #include <Core/DataBlock/StdDataBlock.h>
 #include <Core/Geometry/IndexVector.h>
 #include <Core/Utils/FileUtil.h>
 #include <Core/Utils/Parallel.h>
+#include <Core/Utils/ThreadPool.h>
 
 #include <itkPNGImageIO.h>
 #include <itkTIFFImageIO.h>
@@ -45,29 +56,77 @@
 
 #include <Core/LargeVolume/LargeVolumeConverter.h>
 #include <Core/LargeVolume/LargeVolumeSchema.h>
+#include <Core/LargeVolume/LargeVolumeCheckpoint.h>
 
 
 namespace Core
 {
 
+// Time spent and bytes processed by one stage of phase 2, used for the throughput report
+class LargeVolumeStageStatistics
+{
+public:
+  LargeVolumeStageStatistics() :
+    seconds_( 0.0 ),
+    bytes_( 0 )
+  {
+  }
+
+  void add( const boost::posix_time::ptime& start, long long bytes )
+  {
+    boost::posix_time::time_duration duration = 
+      boost::posix_time::microsec_clock::universal_time() - start;
+    boost::mutex::scoped_lock lock( this->mutex_ );
+    this->seconds_ += duration.total_microseconds() * 1e-6;
+    this->bytes_ += bytes;
+  }
+
+  std::string report( const std::string& name ) const
+  {
+    boost::mutex::scoped_lock lock( this->mutex_ );
+    double mb = this->bytes_ / ( 1024.0 * 1024.0 );
+    std::ostringstream oss;
+    oss << std::setiosflags( std::ios::fixed ) << std::setprecision( 1 );
+    oss << name << mb << " MB in " << this->seconds_ << " s ("
+      << ( this->seconds_ > 0.0 ? mb / this->seconds_ : 0.0 ) << " MB/s)";
+    return oss.str();
+  }
+
+private:
+  mutable boost::mutex mutex_;
+  double seconds_;
+  long long bytes_;
+};
+
 class LargeVolumeBrickLevel;
 typedef boost::shared_ptr<LargeVolumeBrickLevel> LargeVolumeBrickLevelHandle;
 
 class LargeVolumeBrickLevel
 {
 public:
-  LargeVolumeBrickLevel( LargeVolumeSchemaHandle schema, size_t level ) :
+  LargeVolumeBrickLevel( LargeVolumeSchemaHandle schema, size_t level,
+    LargeVolumeStageStatistics& write_statistics ) :
     level_( level ),
     buffer_start_( 0 ),
     buffer_size_( 0 ),
     buffer_index_( 0 ),
     buffer_count_( 0 ),
-    schema_( schema )
+    schema_( schema ),
+    flushing_( false ),
+    flush_failed_( false ),
+    write_statistics_( write_statistics )
   {
     this->layout_ = schema_->get_level_layout( this->level_ );
     this->buffers_.resize( this->layout_.x() * this->layout_.y() );
   }
 
+  ~LargeVolumeBrickLevel()
+  {
+    // Buffers that are still being written cannot be released
+    std::string error;
+    this->wait_for_flush( error );
+  }
+
   size_t level_;
   size_t buffer_start_;
   size_t buffer_size_;
@@ -79,6 +138,28 @@ public:
   std::vector<DataBlockHandle> buffers_;
   LargeVolumeSchemaHandle schema_;
 
+  // -- asynchronous flushing --
+  // The buffers that are being written to disk while the next slices are inserted in buffers_.
+  // Empty if there is not enough memory for a second set, in which case flushing is synchronous.
+  std::vector<DataBlockHandle> flush_buffers_;
+
+  boost::mutex flush_mutex_;
+  boost::condition_variable flush_done_;
+  bool flushing_;
+  bool flush_failed_;
+  std::string flush_error_;
+
+  LargeVolumeStageStatistics& write_statistics_;
+
+  // Part of the buffers that is appended to a row of bricks
+  struct FlushRange
+  {
+    IndexVector::index_type z_;
+    IndexVector::index_type start_;
+    IndexVector::index_type end_;
+    IndexVector::index_type offset_;
+  };
+
 public:
 
   size_t get_num_buffers() const
@@ -86,15 +167,41 @@ public:
     return this->buffers_.size();
   }
 
-  void allocate_buffers( size_t size );
+  void allocate_buffers( size_t size, bool double_buffered );
 
+  template<class T>
+  void insert_slice_rows( DataBlockHandle slice, size_t by_begin, size_t by_end );
   template<class T>
   bool insert_slice_internals( DataBlockHandle slice );
   bool insert_slice( DataBlockHandle slice );
   bool sync_buffers( bool done, std::string& error );
+
+  // WAIT_FOR_FLUSH:
+  /// Wait until the buffers that are being written are on disk
+  bool wait_for_flush( std::string& error );
+
+  // FLUSH_ALL:
+  /// Write the slices that are in the buffers to disk, even if the buffers are not full, and
+  /// wait until they are written
+  bool flush_all( std::string& error );
+
+  // RESTORE:
+  /// Continue after count slices have been written to the bricks at a checkpoint. Data that
+  /// was appended to the bricks after the checkpoint is removed.
+  bool restore( size_t count, std::string& error );
+
+private:
+  void get_row_range( IndexVector::index_type z, IndexVector::index_type& b_start,
+    IndexVector::index_type& b_end ) const;
+  bool write_buffers( std::string& error );
+  void flush( std::vector<FlushRange> ranges );
+  bool flush_buffers( const std::vector<DataBlockHandle>& buffers, 
+    const std::vector<FlushRange>& ranges, std::string& error );
+  void flush_brick( const std::vector<DataBlockHandle>* buffers, 
+    const std::vector<FlushRange>* ranges, size_t begin, size_t end );
 };
 
-void LargeVolumeBrickLevel::allocate_buffers( size_t size )
+void LargeVolumeBrickLevel::allocate_buffers( size_t size, bool double_buffered )
 {
   this->buffer_size_ = size;
 
@@ -104,16 +211,25 @@ void LargeVolumeBrickLevel::allocate_buffers( size_t size )
     IndexVector brick_size =  this->schema_->get_brick_size( bi );
     this->buffers_[ j ] = StdDataBlock::New( brick_size[0], brick_size[1], size, this->schema_->get_data_type() );
   }
+
+  this->flush_buffers_.clear();
+  if ( double_buffered )
+  {
+    for ( size_t j = 0; j < this->buffers_.size(); j++ )
+    {
+      this->flush_buffers_.push_back( StdDataBlock::New( this->buffers_[ j ]->get_nx(),
+        this->buffers_[ j ]->get_ny(), size, this->schema_->get_data_type() ) );
+    }
+  }
 }
 
 template<class T>
-bool LargeVolumeBrickLevel::insert_slice_internals( DataBlockHandle slice )
+void LargeVolumeBrickLevel::insert_slice_rows( DataBlockHandle slice, size_t by_begin, size_t by_end )
 {
   const IndexVector::index_type overlap = static_cast<IndexVector::index_type>( this->schema_->get_overlap() );
-  const IndexVector brick_size = this->schema_->get_brick_size();
   const IndexVector eff_brick_size =  this->schema_->get_effective_brick_size();
 
-  IndexVector::index_type k = 0;
+  IndexVector::index_type k = by_begin * this->layout_.x();
 
   if (slice)
   {
@@ -121,7 +237,7 @@ bool LargeVolumeBrickLevel::insert_slice_internals( DataBlockHandle slice )
     IndexVector::index_type snx = slice->get_nx();
     IndexVector::index_type sny = slice->get_ny();
 
-    for ( IndexVector::index_type by = 0; by < this->layout_.y(); by++ )
+    for ( IndexVector::index_type by = by_begin; by < static_cast<IndexVector::index_type>( by_end ); by++ )
     {
       for ( IndexVector::index_type bx = 0; bx < this->layout_.x(); bx++, k++ )
       {
@@ -180,7 +296,7 @@ bool LargeVolumeBrickLevel::insert_slice_internals( DataBlockHandle slice )
   } 
   else
   {
-    for ( IndexVector::index_type by = 0; by < this->layout_.y(); by++ )
+    for ( IndexVector::index_type by = by_begin; by < static_cast<IndexVector::index_type>( by_end ); by++ )
     {
       for ( IndexVector::index_type bx = 0; bx < this->layout_.x(); bx++, k++ )
       {
@@ -199,6 +315,14 @@ bool LargeVolumeBrickLevel::insert_slice_internals( DataBlockHandle slice )
       }
     }
   }
+}
+
+template<class T>
+bool LargeVolumeBrickLevel::insert_slice_internals( DataBlockHandle slice )
+{
+  // Each row of bricks has its own buffers, hence the rows can be filled in parallel
+  Parallel::For( 0, this->layout_.y(), boost::bind( 
+    &LargeVolumeBrickLevel::insert_slice_rows<T>, this, slice, _1, _2 ), 1 );
 
   buffer_index_++;
   buffer_count_++;
@@ -231,6 +355,17 @@ bool LargeVolumeBrickLevel::insert_slice( DataBlockHandle slice )
   return false;
 }
 
+void LargeVolumeBrickLevel::get_row_range( IndexVector::index_type z, 
+  IndexVector::index_type& b_start, IndexVector::index_type& b_end ) const
+{
+  IndexVector eff_brick_size = this->schema_->get_effective_brick_size();
+  IndexVector::index_type overlap = this->schema_->get_overlap();
+  IndexVector level_size = this->schema_->get_level_size( this->level_ );
+
+  b_start = ( z * eff_brick_size.z() );
+  b_end = ( Min( ( z + 1 ) * eff_brick_size.z(), level_size.z() ) ) + 2 * overlap;
+}
+
 bool LargeVolumeBrickLevel::sync_buffers( bool done, std::string& error )
 {
 
@@ -242,68 +377,234 @@ bool LargeVolumeBrickLevel::sync_buffers( bool done, std::string& error )
 
   if ( done || this->buffer_index_ == this->buffer_size_ )
   {
-    IndexVector::index_type buffer_start = this->buffer_count_ - this->buffer_index_;
-    IndexVector::index_type buffer_size = this->buffer_count_ - buffer_start;
-        
-    IndexVector brick_size = this->schema_->get_brick_size();
-    IndexVector eff_brick_size = this->schema_->get_effective_brick_size();
-    IndexVector::index_type overlap = this->schema_->get_overlap();
-    IndexVector level_size = this->schema_->get_level_size( this->level_ );
+    return this->write_buffers( error );
+  }
+
+  return true;
+}
+
+bool LargeVolumeBrickLevel::write_buffers( std::string& error )
+{
+  IndexVector::index_type buffer_start = this->buffer_count_ - this->buffer_index_;
+  IndexVector::index_type buffer_size = this->buffer_count_ - buffer_start;
+
+  std::vector<FlushRange> ranges;
+
+  for (IndexVector::index_type z = 0; z < this->layout_.z(); z++)
+  {
+    IndexVector::index_type b_start, b_end;
+    this->get_row_range( z, b_start, b_end );
+
+    IndexVector::index_type z_start = b_start - buffer_start;
+    IndexVector::index_type z_end = b_end - buffer_start;
+
+    IndexVector::index_type start = Max( IndexVector::index_type( 0 ), z_start );
+    IndexVector::index_type end = Min( z_end , buffer_size );
+
+    IndexVector::index_type offset = buffer_start + start - b_start;
+
+    if ( end >= 0 && start < buffer_size && start < end)
+    {
+      FlushRange range;
+      range.z_ = z;
+      range.start_ = start;
+      range.end_ = end;
+      range.offset_ = offset;
+      ranges.push_back( range );
+    }
+  }
 
-    for (IndexVector::index_type z = 0; z < this->layout_.z(); z++)
+  // The previous flush of this level needs to be done, as the appends to a brick file
+  // need to happen in order
+  if ( !this->wait_for_flush( error ) )
+  {
+    return false;
+  }
+
+  if ( this->flush_buffers_.empty() )
+  {
+    if ( !this->flush_buffers( this->buffers_, ranges, error ) )
+    {
+      return false;
+    }
+  }
+  else if ( !ranges.empty() )
+  {
+    // Write the filled buffers in the background and continue with the other set
+    this->buffers_.swap( this->flush_buffers_ );
     {
-      IndexVector::index_type b_start = ( z * eff_brick_size.z() );
-      IndexVector::index_type b_end = ( Min( ( z + 1 ) * eff_brick_size.z(), level_size.z() ) ) + 2 * overlap;
+      boost::mutex::scoped_lock lock( this->flush_mutex_ );
+      this->flushing_ = true;
+    }
+    ThreadPool::Instance()->post( boost::bind( &LargeVolumeBrickLevel::flush, this, ranges ) );
+  }
 
-      IndexVector::index_type z_start = b_start - buffer_start;
-      IndexVector::index_type z_end = b_end - buffer_start;
+  // reset ring buffer count
+  this->buffer_index_ = 0;
 
-      IndexVector::index_type start = Max( IndexVector::index_type( 0 ), z_start );
-      IndexVector::index_type end = Min( z_end , buffer_size );
+  return true;
+}
 
-            IndexVector::index_type offset = buffer_start + start - b_start;
-            
-      if ( end >= 0 && start < buffer_size && start < end)
-      {
+bool LargeVolumeBrickLevel::flush_all( std::string& error )
+{
+  if ( this->buffer_index_ > 0 && !this->write_buffers( error ) )
+  {
+    return false;
+  }
 
-        std::cout << "saving buffers level " << this->level_ << ": 000000/000000";
+  return this->wait_for_flush( error );
+}
 
-        for (size_t k = 0; k < this->buffers_.size(); k++ )
-        {
-          
+bool LargeVolumeBrickLevel::restore( size_t count, std::string& error )
+{
+  size_t element_size = GetSizeDataType( this->schema_->get_data_type() );
+  IndexVector::index_type num_row_bricks = this->layout_.x() * this->layout_.y();
+
+  for ( IndexVector::index_type z = 0; z < this->layout_.z(); z++ )
+  {
+    IndexVector::index_type b_start, b_end;
+    this->get_row_range( z, b_start, b_end );
 
-          IndexVector::index_type brick = k + z * (this->layout_.x() * this->layout_.y() );
-          BrickInfo bi( brick, this->level_ );
+    // Rows of bricks that were complete at the checkpoint are not written anymore
+    if ( b_end <= static_cast<IndexVector::index_type>( count ) ) continue;
 
-          std::cout << "\b\b\b\b\b\b\b\b\b\b\b\b\b" << std::setfill('0') << std::setw(6) << (k+1) << "/" << std::setfill('0') << std::setw(6) << this->buffers_.size();
-          std::cout.flush();
+    IndexVector::index_type num_slices = Max( IndexVector::index_type( 0 ), 
+      static_cast<IndexVector::index_type>( count ) - b_start );
 
-          if (! this->schema_->append_brick_buffer( this->buffers_[ k ], start, end, offset, bi, error ) )
-          {
-            return false;
-          }
-        }
-        std::cout << std::endl;
+    for ( IndexVector::index_type k = 0; k < num_row_bricks; k++ )
+    {
+      BrickInfo bi( k + z * num_row_bricks, this->level_ );
+      IndexVector brick_size = this->schema_->get_brick_size( bi );
+      boost::filesystem::path brick_file = this->schema_->get_brick_file_name( bi );
+      boost::uintmax_t length = static_cast<boost::uintmax_t>( num_slices ) * 
+        brick_size.x() * brick_size.y() * element_size;
+
+      boost::system::error_code ec;
+      if ( length == 0 )
+      {
+        boost::filesystem::remove( brick_file, ec );
+        continue;
+      }
+
+      boost::uintmax_t file_size = boost::filesystem::file_size( brick_file, ec );
+      if ( ec || file_size < length )
+      {
+        error = "Brick file '" + brick_file.string() + "' does not contain the data of the last checkpoint.";
+        return false;
       }
 
+      if ( file_size > length )
+      {
+        boost::filesystem::resize_file( brick_file, length, ec );
+        if ( ec )
+        {
+          error = "Could not truncate brick file '" + brick_file.string() + "'.";
+          return false;
+        }
+      }
     }
+  }
 
+  this->buffer_count_ = count;
+  this->buffer_index_ = 0;
+  return true;
+}
+
+bool LargeVolumeBrickLevel::wait_for_flush( std::string& error )
+{
+  boost::mutex::scoped_lock lock( this->flush_mutex_ );
+  while ( this->flushing_ )
+  {
+    this->flush_done_.wait( lock );
+  }
+
+  if ( this->flush_failed_ )
+  {
+    error = this->flush_error_;
+    return false;
+  }
+  return true;
+}
+
+void LargeVolumeBrickLevel::flush( std::vector<FlushRange> ranges )
+{
+  std::string error;
+  bool success = this->flush_buffers( this->flush_buffers_, ranges, error );
+
+  boost::mutex::scoped_lock lock( this->flush_mutex_ );
+  if ( !success )
+  {
+    this->flush_failed_ = true;
+    this->flush_error_ = error;
+  }
+  this->flushing_ = false;
+  this->flush_done_.notify_all();
+}
+
+bool LargeVolumeBrickLevel::flush_buffers( const std::vector<DataBlockHandle>& buffers, 
+  const std::vector<FlushRange>& ranges, std::string& error )
+{
+  boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
 
-    // reset ring buffer count
-    this->buffer_index_ = 0;
+  // Each brick is its own file, so the bricks can be appended in parallel
+  Parallel::For( 0, buffers.size(), boost::bind( &LargeVolumeBrickLevel::flush_brick, this, 
+    &buffers, &ranges, _1, _2 ), 1 );
 
+  long long bytes = 0;
+  for ( size_t j = 0; j < ranges.size(); j++ )
+  {
+    for ( size_t k = 0; k < buffers.size(); k++ )
+    {
+      bytes += static_cast<long long>( ranges[ j ].end_ - ranges[ j ].start_ ) * 
+        buffers[ k ]->get_nx() * buffers[ k ]->get_ny() * buffers[ k ]->get_elem_size();
+    }
   }
+  this->write_statistics_.add( start, bytes );
 
+  boost::mutex::scoped_lock lock( this->flush_mutex_ );
+  if ( this->flush_failed_ )
+  {
+    error = this->flush_error_;
+    return false;
+  }
   return true;
 }
 
+void LargeVolumeBrickLevel::flush_brick( const std::vector<DataBlockHandle>* buffers, 
+  const std::vector<FlushRange>* ranges, size_t begin, size_t end )
+{
+  std::string error;
+  for ( size_t k = begin; k < end; k++ )
+  {
+    for ( size_t j = 0; j < ranges->size(); j++ )
+    {
+      const FlushRange& range = ( *ranges )[ j ];
+      IndexVector::index_type brick = k + range.z_ * ( this->layout_.x() * this->layout_.y() );
+      BrickInfo bi( brick, this->level_ );
 
+      if (! this->schema_->append_brick_buffer( ( *buffers )[ k ], range.start_, range.end_, 
+        range.offset_, bi, error ) )
+      {
+        boost::mutex::scoped_lock lock( this->flush_mutex_ );
+        this->flush_failed_ = true;
+        this->flush_error_ = error;
+        return;
+      }
+    }
+  }
+}
 
 class LargeVolumeConverterPrivate {
 
 public:
   LargeVolumeConverterPrivate() :
-    data_type_( DataType::UNKNOWN_E )
+    data_type_( DataType::UNKNOWN_E ),
+    packed_( false ),
+    codec_( BrickCodec::ZLIB_E ),
+    filter_( BrickFilter::NONE_E ),
+    resume_( false ),
+    checkpoint_interval_( 256 ),
+    append_( false )
   {}
 
   // -- input parameters --
@@ -322,6 +623,13 @@ public:
 
   long long mem_limit_;
 
+  // Whether to write the bricks into pack files instead of one file per brick
+  bool packed_;
+
+  // How the bricks are compressed
+  BrickCodec codec_;
+  BrickFilter filter_;
+
   LargeVolumeSchemaHandle schema_;
 
   // -- loaders --
@@ -352,6 +660,12 @@ public:
     bool downsample_internals( DataBlockHandle input, DataBlockHandle output,
         const IndexVector& input_ratio, const IndexVector& output_ratio );
 
+    /// DOWNSAMPLE_ROWS
+    /// Compute the output rows [begin, end) of a down sampled slice
+    template<class T, class U>
+    void downsample_rows( DataBlockHandle input, DataBlockHandle output,
+        IndexVector input_ratio, IndexVector output_ratio, size_t begin, size_t end );
+
     /// DOWNSAMPLE_ADD
     /// Down sample a slice based on the level ratios and adds it to the existing slice
     bool downsample_add( DataBlockHandle input, DataBlockHandle output,
@@ -363,6 +677,21 @@ public:
     bool downsample_add_internals( DataBlockHandle input, DataBlockHandle output,
         const IndexVector& input_ratio, const IndexVector& output_ratio );
 
+    /// DOWNSAMPLE_ADD_ROWS
+    /// Compute the output rows [begin, end) of a down sampled slice that is added
+    template<class T, class U>
+    void downsample_add_rows( DataBlockHandle input, DataBlockHandle output,
+        IndexVector input_ratio, IndexVector output_ratio, size_t begin, size_t end );
+
+    /// GET_NUM_OUTPUT_ROWS
+    /// Number of rows in a down sampled slice
+    static size_t get_num_output_rows( DataBlockHandle input, const IndexVector& input_ratio,
+        const IndexVector& output_ratio )
+    {
+        if ( output_ratio.y() / input_ratio.y() == 2 ) return ( input->get_ny() + 1 ) / 2;
+        return input->get_ny();
+    }
+
     // -- min and max --
 public:
 
@@ -378,7 +707,13 @@ public:
 
     // -- slice processor --
 public:
-    bool process_slice( size_t level, std::string& error );
+    /// PROCESS_SLICE
+    /// Brick the current slice of a level and down sample it into the next level
+    bool process_slice( size_t level, bool last_slice, std::string& error );
+
+    /// DOWNSAMPLE_SLICE
+    /// Down sample the current slice of a level into the next level, without bricking it
+    bool downsample_slice( size_t level, bool last_slice, std::string& error );
     
 
     // slices at different resolution levels
@@ -387,29 +722,116 @@ public:
     std::vector<IndexVector::index_type> index_;
   std::vector<LargeVolumeBrickLevelHandle> brick_level_;
 
-  void run_phase3_parallel( int num_threads, int thread_num, boost::barrier& barrier  );
+  // -- prefetching --
+public:
+  // A slice that is loaded ahead of time on the thread pool
+  class PrefetchSlot
+  {
+  public:
+    PrefetchSlot() : min_( 0.0 ), max_( 0.0 ), ready_( false ) {}
+
+    DataBlockHandle slice_;
+    double min_;
+    double max_;
+    std::string error_;
+    bool ready_;
+  };
+  typedef boost::shared_ptr<PrefetchSlot> PrefetchSlotHandle;
+
+  /// PREFETCH_SLICE
+  /// Load, clip and scan a slice, called on the thread pool
+  void prefetch_slice( PrefetchSlotHandle slot, size_t slice_idx );
+
+  /// WAIT_FOR_SLOT
+  /// Wait until a slice has been loaded
+  void wait_for_slot( PrefetchSlotHandle slot );
+
+  boost::mutex prefetch_mutex_;
+  boost::condition_variable prefetch_done_;
+
+  // -- checkpoints --
+public:
+  /// WRITE_PHASE2_CHECKPOINT
+  /// Write the buffered slices to disk and record the state of the levels
+  bool write_phase2_checkpoint( size_t next_slice, double min, double max, std::string& error );
+
+  /// RESTORE_PHASE2_CHECKPOINT
+  /// Continue bricking from the last checkpoint
+  bool restore_phase2_checkpoint( std::string& error );
+
+  /// WRITE_PHASE3_CHECKPOINT
+  /// Record the bricks that have been processed
+  bool write_phase3_checkpoint( std::string& error );
+
+  // The progress of the conversion
+  LargeVolumeCheckpoint checkpoint_;
+
+  // Whether to continue an interrupted conversion
+  bool resume_;
+
+  // Number of slices (phase 2) or bricks (phase 3) between checkpoints
+  size_t checkpoint_interval_;
+
+  // -- appending --
+public:
+  /// SETUP_APPEND
+  /// Extend the schema of the volume in old_dir with the files and determine where bricking needs
+  /// to start again
+  bool setup_append( const boost::filesystem::path& old_dir, std::string& error );
+
+  /// PREPARE_APPEND
+  /// Move the bricks that change to the backup directory, cut them back to the part that stays
+  /// the same and compute the levels that are new
+  bool prepare_append( size_t chunk_size, std::string& error );
+
+  /// READ_APPEND_BRICK
+  /// Read the old brick of a column of bricks that contains a position along z
+  bool read_append_brick( size_t level, IndexVector::index_type column, IndexVector::index_type position,
+    DataBlockHandle& brick, IndexVector::index_type& brick_start, std::string& error );
+
+  /// READ_APPEND_SLICES
+  /// Assemble slices [begin, end) of a level from the old bricks
+  bool read_append_slices( size_t level, size_t begin, size_t end, std::vector<DataBlockHandle>& slices,
+    std::string& error );
+
+  // Whether to add the files to the existing volume
+  bool append_;
+
+  // The volume before the slices were appended, its bricks are in the backup directory
+  LargeVolumeSchemaHandle append_schema_;
+
+  // -- statistics --
+public:
+  LargeVolumeStageStatistics load_statistics_;
+  LargeVolumeStageStatistics bricking_statistics_;
+  LargeVolumeStageStatistics write_statistics_;
+
+  void run_phase3_parallel( int num_threads, int thread_num, Barrier& barrier  );
 
   bool success_;
 
+  // Bricks are handed out in order, so that the processed bricks form a prefix that can be
+  // recorded in a checkpoint
+  boost::mutex phase3_mutex_;
+  size_t phase3_next_brick_;
+  size_t phase3_done_brick_;
+  size_t phase3_num_done_;
+  std::vector<bool> phase3_done_;
+
 };
 
 template<class T>
 bool LargeVolumeConverterPrivate::compute_min_max_internals( DataBlockHandle slice, double& min, double& max )
 {
-  T* data = reinterpret_cast<T*>( slice->get_data() );
+  const T* data = reinterpret_cast<const T*>( slice->get_data() );
   size_t size = slice->get_size();
 
-  T min_val = std::numeric_limits<T>::max();
-  T max_val = std::numeric_limits<T>::min();
-
-  for (size_t k = 0; k < size; k++, data++ )
-  {
-    if (*data < min_val) min_val = *data;
-    if (*data > max_val) max_val = *data;
-  }
+  // A slice without finite values does not change the range
+  double slice_min, slice_max;
+  if ( !Histogram::ComputeMinMax( data, size, slice_min, slice_max ) ) return true;
 
-  min = Min( min, static_cast<double>( min_val ) );
-  max = Max( max, static_cast<double>( max_val ) );
+  min = Min( min, slice_min );
+  max = Max( max, slice_max );
 
   return true;
 }
@@ -439,9 +861,8 @@ bool LargeVolumeConverterPrivate::compute_min_max( DataBlockHandle slice, double
   return false;
 }
 
-bool LargeVolumeConverterPrivate::process_slice( size_t level, std::string& error )
+bool LargeVolumeConverterPrivate::process_slice( size_t level, bool last_slice, std::string& error )
 {
-  bool last_slice = ( this->files_.size() - 1 ) == this->index_[ 0 ];
   bool first_slice = ( this->index_[ level ] == 0);
 
     DataBlockHandle slice = slices_[ level ];
@@ -484,7 +905,19 @@ bool LargeVolumeConverterPrivate::process_slice( size_t level, std::string& erro
   {
     this->brick_level_[ level ]->sync_buffers( false, error );
   }
-    
+
+  if ( !this->downsample_slice( level, last_slice, error ) )
+  {
+    return false;
+  }
+
+  index_[ level ]++;
+
+  return true;
+}
+
+bool LargeVolumeConverterPrivate::downsample_slice( size_t level, bool last_slice, std::string& error )
+{
     // Down sample data for next level
     if ( level < this->schema_->get_num_levels() - 1 )
     {
@@ -500,7 +933,7 @@ bool LargeVolumeConverterPrivate::process_slice( size_t level, std::string& erro
                     error = "Failed to downsample slice.";
                     return false;
                 }
-                if (! this->process_slice( level + 1, error ) )
+                if (! this->process_slice( level + 1, last_slice, error ) )
                 {
                     return false;
                 }
@@ -515,7 +948,7 @@ bool LargeVolumeConverterPrivate::process_slice( size_t level, std::string& erro
 
         if ( last_slice )
         {
-          if (! this->process_slice( level + 1, error ) )
+          if (! this->process_slice( level + 1, last_slice, error ) )
           {
             return false;
           }       
@@ -530,7 +963,7 @@ bool LargeVolumeConverterPrivate::process_slice( size_t level, std::string& erro
                 return false;
             }
             
-            if (! this->process_slice( level + 1, error ) )
+            if (! this->process_slice( level + 1, last_slice, error ) )
             {
                 return false;
             }
@@ -538,8 +971,6 @@ bool LargeVolumeConverterPrivate::process_slice( size_t level, std::string& erro
         
     }
 
-  index_[ level ]++;
-
   return true;
 }
 
@@ -691,53 +1122,53 @@ bool LargeVolumeConverterPrivate::scan_file( const boost::filesystem::path& file
 
 
 template<class T, class U>
-bool LargeVolumeConverterPrivate::downsample_internals( DataBlockHandle input, DataBlockHandle output,
-    const IndexVector& input_ratio, const IndexVector& output_ratio )
+void LargeVolumeConverterPrivate::downsample_rows( DataBlockHandle input, DataBlockHandle output,
+    IndexVector input_ratio, IndexVector output_ratio, size_t begin, size_t end )
 {
     DataBlock::index_type ratio_x = output_ratio.x() / input_ratio.x();
     DataBlock::index_type ratio_y = output_ratio.y() / input_ratio.y();
 
-    T* src = reinterpret_cast<T*>( input->get_data() );
-    T* dst = reinterpret_cast<T*>( output->get_data() );
-
     DataBlock::index_type nx = input->get_nx();
     DataBlock::index_type ny = input->get_ny();
+    DataBlock::index_type onx = ( ratio_x == 2 && ( ratio_y == 2 || ratio_y == 1 ) ) ? ( nx + 1 ) / 2 : nx;
 
-    if ( ratio_x == 2 && ratio_y == 2 )
+    for ( DataBlock::index_type oy = begin; oy < static_cast<DataBlock::index_type>( end ); oy++ )
     {
-        for ( DataBlock::index_type y = 0; y < (ny-1); y += 2, src+= nx )
-        {
-            for ( DataBlock::index_type x = 0; x < (nx-1); x += 2, src += 2, dst++ )
-            {
-                *dst = static_cast<T>( ( static_cast<U>( src[0] ) + static_cast<U>( src[1] ) + static_cast<U>( src[nx] ) +  static_cast<U>( src[nx+1] ) ) / 4 );
-            }
-        
-            if (nx % 2)
-            {
-                *dst = static_cast<T>( ( static_cast<U>( src[0] ) + static_cast<U>( src[nx] ) ) / 2 );
-                dst++;
-                src++;
-            }
-        }
-        
-        if ( ny % 2 )
+        DataBlock::index_type y = ( ratio_y == 2 ) ? 2 * oy : oy;
+        T* src = reinterpret_cast<T*>( input->get_data() ) + y * nx;
+        T* dst = reinterpret_cast<T*>( output->get_data() ) + oy * onx;
+
+        // The last row is not paired if the number of rows is odd
+        bool pair_rows = ( y + 1 < ny );
+
+        if ( ratio_x == 2 && ratio_y == 2 )
         {
-            for ( DataBlock::index_type x = 0; x < (nx-1); x += 2, src += 2, dst++ )
+            if ( pair_rows )
             {
-                *dst = static_cast<T>( ( static_cast<U>( src[0] ) + static_cast<U>( src[1] ) ) / 2 );
+                for ( DataBlock::index_type x = 0; x < (nx-1); x += 2, src += 2, dst++ )
+                {
+                    *dst = static_cast<T>( ( static_cast<U>( src[0] ) + static_cast<U>( src[1] ) + static_cast<U>( src[nx] ) +  static_cast<U>( src[nx+1] ) ) / 4 );
+                }
+            
+                if (nx % 2)
+                {
+                    *dst = static_cast<T>( ( static_cast<U>( src[0] ) + static_cast<U>( src[nx] ) ) / 2 );
+                }
             }
-        
-            if (nx % 2)
+            else
             {
-                *dst = *src;
-                dst++;
-                src++;
+                for ( DataBlock::index_type x = 0; x < (nx-1); x += 2, src += 2, dst++ )
+                {
+                    *dst = static_cast<T>( ( static_cast<U>( src[0] ) + static_cast<U>( src[1] ) ) / 2 );
+                }
+            
+                if (nx % 2)
+                {
+                    *dst = *src;
+                }
             }
         }
-    }
-    else if ( ratio_x == 2 && ratio_y == 1 )
-    {
-        for ( DataBlock::index_type y = 0; y < ny; y ++)
+        else if ( ratio_x == 2 && ratio_y == 1 )
         {
             for ( DataBlock::index_type x = 0; x < (nx-1); x += 2, src += 2, dst++ )
             {
@@ -747,37 +1178,33 @@ bool LargeVolumeConverterPrivate::downsample_internals( DataBlockHandle input, D
             if (nx % 2)
             {
                 *dst = *src;
-                dst++;
-                src++;
             }
         }
-    }
-    else if ( ratio_x == 1 && ratio_y == 2 )
-    {
-        for ( DataBlock::index_type y = 0; y < (ny-1); y += 2, src+= nx )
+        else if ( ratio_x == 1 && ratio_y == 2 && pair_rows )
         {
             for ( DataBlock::index_type x = 0; x < nx; x++, src ++, dst++ )
             {
                 *dst = static_cast<T>( ( static_cast<U>( src[0] ) + static_cast<U>( src[nx] ) ) / 2 );
             }
         }
-        
-        if ( ny % 2 )
+        else
         {
-            for ( DataBlock::index_type x = 0; x < nx; x ++, src ++, dst++ )
+            for ( DataBlock::index_type x = 0; x < nx; x++, src++, dst++  )
             {
                 *dst = *src;
             }
         }
     }
-    else
-    {
-        DataBlock::index_type nxy = nx * ny;
-        for ( DataBlock::index_type k = 0; k < nxy; k++, src++, dst++  )
-        {
-            *dst = *src;
-        }
-    }
+}
+
+template<class T, class U>
+bool LargeVolumeConverterPrivate::downsample_internals( DataBlockHandle input, DataBlockHandle output,
+    const IndexVector& input_ratio, const IndexVector& output_ratio )
+{
+    // Output rows only depend on the input, hence they are computed in parallel
+    Parallel::For( 0, get_num_output_rows( input, input_ratio, output_ratio ), boost::bind( 
+        &LargeVolumeConverterPrivate::downsample_rows<T, U>, this, input, output, input_ratio, 
+        output_ratio, _1, _2 ) );
     
     return true;
 }
@@ -814,93 +1241,89 @@ bool LargeVolumeConverterPrivate::downsample( DataBlockHandle input, DataBlockHa
 }
 
 template<class T, class U>
-bool LargeVolumeConverterPrivate::downsample_add_internals( DataBlockHandle input, DataBlockHandle output,
-    const IndexVector& input_ratio, const IndexVector& output_ratio )
+void LargeVolumeConverterPrivate::downsample_add_rows( DataBlockHandle input, DataBlockHandle output,
+    IndexVector input_ratio, IndexVector output_ratio, size_t begin, size_t end )
 {
     DataBlock::index_type ratio_x = output_ratio.x() / input_ratio.x();
     DataBlock::index_type ratio_y = output_ratio.y() / input_ratio.y();
 
-    T* src = reinterpret_cast<T*>( input->get_data() );
-    T* dst = reinterpret_cast<T*>( output->get_data() );
-
     DataBlock::index_type nx = input->get_nx();
     DataBlock::index_type ny = input->get_ny();
+    DataBlock::index_type onx = ( ratio_x == 2 && ( ratio_y == 2 || ratio_y == 1 ) ) ? ( nx + 1 ) / 2 : nx;
 
-    if ( ratio_x == 2 && ratio_y == 2 )
+    for ( DataBlock::index_type oy = begin; oy < static_cast<DataBlock::index_type>( end ); oy++ )
     {
-        for ( DataBlock::index_type y = 0; y < (ny-1); y += 2, src+= nx )
+        DataBlock::index_type y = ( ratio_y == 2 ) ? 2 * oy : oy;
+        T* src = reinterpret_cast<T*>( input->get_data() ) + y * nx;
+        T* dst = reinterpret_cast<T*>( output->get_data() ) + oy * onx;
+
+        // The last row is not paired if the number of rows is odd
+        bool pair_rows = ( y + 1 < ny );
+
+        if ( ratio_x == 2 && ratio_y == 2 )
         {
-            for ( DataBlock::index_type x = 0; x < (nx-1); x += 2, src += 2, dst++ )
+            if ( pair_rows )
             {
-                *dst = static_cast<T>( ( static_cast<U>( dst[0] * 4 ) + static_cast<U>( src[0] ) + static_cast<U>( src[1] ) + static_cast<U>( src[nx] ) +  static_cast<U>( src[nx+1] ) ) / 8 );
+                for ( DataBlock::index_type x = 0; x < (nx-1); x += 2, src += 2, dst++ )
+                {
+                    *dst = static_cast<T>( ( static_cast<U>( dst[0] * 4 ) + static_cast<U>( src[0] ) + static_cast<U>( src[1] ) + static_cast<U>( src[nx] ) +  static_cast<U>( src[nx+1] ) ) / 8 );
+                }
+            
+                if (nx % 2)
+                {
+                    *dst = static_cast<T>( ( static_cast<U>( dst[0] * 2 ) + static_cast<U>( src[0] ) + static_cast<U>( src[nx] ) ) / 4 );
+                }
             }
-        
-            if (nx % 2)
+            else
             {
-                *dst = static_cast<T>( ( static_cast<U>( dst[0] * 2 ) + static_cast<U>( src[0] ) + static_cast<U>( src[nx] ) ) / 4 );
-                dst++;
-                src++;
+                for ( DataBlock::index_type x = 0; x < (nx-1); x += 2, src += 2, dst++ )
+                {
+                    *dst = static_cast<T>( ( static_cast<U>( dst[0] * 2 ) +  static_cast<U>( src[0] ) + static_cast<U>( src[1] ) ) / 4 );
+                }
+            
+                if (nx % 2)
+                {
+                    *dst = static_cast<T>( ( static_cast<U>( *dst ) + static_cast<U>( *src ) ) / 2 );
+                }
             }
         }
-        
-        if ( ny % 2 )
+        else if ( ratio_x == 2 && ratio_y == 1 )
         {
             for ( DataBlock::index_type x = 0; x < (nx-1); x += 2, src += 2, dst++ )
             {
-                *dst = static_cast<T>( ( static_cast<U>( dst[0] * 2 ) +  static_cast<U>( src[0] ) + static_cast<U>( src[1] ) ) / 4 );
+                *dst = static_cast<T>( ( static_cast<U>( dst[0] * 2 ) + static_cast<U>( src[0] ) + static_cast<U>( src[1] ) ) / 4 );
             }
         
             if (nx % 2)
             {
                 *dst = static_cast<T>( ( static_cast<U>( *dst ) + static_cast<U>( *src ) ) / 2 );
-                dst++;
-                src++;
             }
         }
-    }
-    else if ( ratio_x == 2 && ratio_y == 1 )
-    {
-        for ( DataBlock::index_type y = 0; y < ny; y ++)
-        {
-            for ( DataBlock::index_type x = 0; x < (nx-1); x += 2, src += 2, dst++ )
-            {
-                *dst = static_cast<T>( ( static_cast<U>( dst[0] * 2 ) + static_cast<U>( src[0] ) + static_cast<U>( src[1] ) ) / 4 );
-            }
-        
-            if (nx % 2)
-            {
-                *dst = static_cast<T>( ( static_cast<U>( *dst ) + static_cast<U>( *src ) ) / 2 );
-                dst++;
-                src++;
-            }
-        }
-    }
-    else if ( ratio_x == 1 && ratio_y == 2 )
-    {
-        for ( DataBlock::index_type y = 0; y < (ny-1); y += 2, src+= nx )
+        else if ( ratio_x == 1 && ratio_y == 2 && pair_rows )
         {
             for ( DataBlock::index_type x = 0; x < nx; x++, src++, dst++ )
             {
                 *dst = static_cast<T>( ( static_cast<U>( dst[0] * 2 ) + static_cast<U>( src[0] ) + static_cast<U>( src[nx] ) ) / 4 );
             }
         }
-        
-        if ( ny % 2 )
+        else
         {
-            for ( DataBlock::index_type x = 0; x < nx; x ++, src++, dst++ )
+            for ( DataBlock::index_type x = 0; x < nx; x++, src++, dst++  )
             {
                 *dst = static_cast<T>( ( static_cast<U>( *dst ) + static_cast<U>( *src ) ) / 2 );
             }
         }
     }
-    else
-    {
-        DataBlock::index_type nxy = nx * ny;
-        for ( DataBlock::index_type k = 0; k < nxy; k++, src++, dst++  )
-        {
-            *dst = static_cast<T>( ( static_cast<U>( *dst ) + static_cast<U>( *src ) ) / 2 );
-        }
-    }
+}
+
+template<class T, class U>
+bool LargeVolumeConverterPrivate::downsample_add_internals( DataBlockHandle input, DataBlockHandle output,
+    const IndexVector& input_ratio, const IndexVector& output_ratio )
+{
+    // Output rows only depend on the input and themselves, hence they are computed in parallel
+    Parallel::For( 0, get_num_output_rows( input, input_ratio, output_ratio ), boost::bind( 
+        &LargeVolumeConverterPrivate::downsample_add_rows<T, U>, this, input, output, input_ratio, 
+        output_ratio, _1, _2 ) );
     
     return true;
 }
@@ -968,6 +1391,21 @@ void LargeVolumeConverter::set_schema_parameters( const Vector& spacing, const P
   this->private_->overlap_ = overlap;
 }
 
+void LargeVolumeConverter::set_resume( bool resume )
+{
+  this->private_->resume_ = resume;
+}
+
+void LargeVolumeConverter::set_append( bool append )
+{
+  this->private_->append_ = append;
+}
+
+void LargeVolumeConverter::set_checkpoint_interval( size_t interval )
+{
+  this->private_->checkpoint_interval_ = Max( interval, static_cast<size_t>( 1 ) );
+}
+
 bool LargeVolumeConverter::run_phase1( std::string& error )
 {
   error = "";
@@ -987,12 +1425,105 @@ bool LargeVolumeConverter::run_phase1( std::string& error )
     return false;
   }
 
+  boost::filesystem::path dir = this->private_->schema_->get_dir();
+  boost::filesystem::path append_dir = LargeVolumeCheckpoint::GetAppendDir( dir );
+  LargeVolumeCheckpoint& checkpoint = this->private_->checkpoint_;
+
+  if ( this->private_->resume_ )
+  {
+    if ( !LargeVolumeCheckpoint::Exists( dir ) )
+    {
+      error = "Directory '" + dir.string() + "' does not contain an interrupted conversion.";
+      return false;
+    }
+
+    if ( !checkpoint.load( dir, error ) )
+    {
+      return false;
+    }
+
+    if ( checkpoint.append_start_ + this->private_->files_.size() != checkpoint.num_slices_ )
+    {
+      error = "The files do not match the interrupted conversion.";
+      return false;
+    }
+
+    // The bricks have not been touched yet, start appending again
+    if ( checkpoint.append_setup_ )
+    {
+      return this->private_->setup_append( append_dir, error );
+    }
+
+    if ( !this->private_->schema_->load( error ) )
+    {
+      return false;
+    }
+
+    if ( this->private_->schema_->get_data_type() != this->private_->data_type_ ||
+      this->private_->schema_->get_nx() != this->private_->data_size_.x() ||
+      this->private_->schema_->get_ny() != this->private_->data_size_.y() ||
+      this->private_->schema_->get_nz() != checkpoint.num_slices_ ||
+      this->private_->schema_->get_num_levels() != checkpoint.level_index_.size() )
+    {
+      error = "The files do not match the interrupted conversion.";
+      return false;
+    }
+
+    if ( checkpoint.append_start_ > 0 && checkpoint.phase_ == 2 )
+    {
+      this->private_->append_schema_.reset( new LargeVolumeSchema );
+      this->private_->append_schema_->set_dir( append_dir );
+      if ( !this->private_->append_schema_->load( error ) )
+      {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  if ( this->private_->append_ )
+  {
+    if ( LargeVolumeCheckpoint::Exists( dir ) )
+    {
+      error = "Directory '" + dir.string() + "' contains an interrupted conversion, which needs to be resumed first.";
+      return false;
+    }
+
+    // Keep the volume file, so an interrupted append can start over
+    boost::system::error_code ec;
+    boost::filesystem::remove_all( append_dir, ec );
+    boost::filesystem::create_directory( append_dir, ec );
+    if ( !ec ) boost::filesystem::copy_file( dir / "volume.txt", append_dir / "volume.txt", ec );
+    if ( ec )
+    {
+      error = "Could not create directory '" + append_dir.string() + "'.";
+      return false;
+    }
+
+    if ( !this->private_->setup_append( append_dir, error ) )
+    {
+      return false;
+    }
+
+    return checkpoint.save( dir, error );
+  }
+
   this->private_->schema_->set_parameters( this->private_->data_size_, this->private_->spacing_,
     this->private_->origin_, this->private_->brick_size_, this->private_->overlap_, this->private_->data_type_ );
 
-  this->private_->schema_->set_compression( true );
+  this->private_->schema_->set_codec( this->private_->codec_, this->private_->filter_ );
   this->private_->schema_->compute_levels();
 
+  size_t num_levels = this->private_->schema_->get_num_levels();
+  checkpoint = LargeVolumeCheckpoint();
+  checkpoint.num_slices_ = this->private_->files_.size();
+  checkpoint.min_ = std::numeric_limits<double>::max();
+  checkpoint.max_ = std::numeric_limits<double>::min();
+  checkpoint.level_index_.resize( num_levels, 0 );
+  checkpoint.level_count_.resize( num_levels, 0 );
+  checkpoint.level_next_brick_.resize( num_levels, 0 );
+
   return true;
 }
 
@@ -1001,17 +1532,36 @@ void LargeVolumeConverter::set_mem_limit( long long mem_limit )
   this->private_->mem_limit_ = mem_limit;
 }
 
+void LargeVolumeConverter::set_packed( bool packed )
+{
+  this->private_->packed_ = packed;
+}
+
+void LargeVolumeConverter::set_codec( BrickCodec codec, BrickFilter filter )
+{
+  this->private_->codec_ = codec;
+  this->private_->filter_ = filter;
+}
+
 
 bool LargeVolumeConverter::run_phase2( std::string& error )
 {
   error = "";
 
+  if ( this->private_->checkpoint_.phase_ == 3 )
+  {
+    std::cout << "Bricks were created before the conversion was interrupted." << std::endl;
+    return true;
+  }
+
   // Save schema file
   if (! this->private_->schema_->save(error) )
   {
     return false;
   }
 
+  boost::posix_time::ptime phase_start = boost::posix_time::microsec_clock::universal_time();
+
   // Start creating bricks
 
   // Calculate number of slice buffers
@@ -1032,6 +1582,25 @@ bool LargeVolumeConverter::run_phase2( std::string& error )
     }
 
     // Check total size
+  if ( slice_buffer_size > this->private_->mem_limit_ )
+  {
+    error = "Please allocate more memory to conversion process.";
+    return false;
+  }
+
+  // Slices are loaded ahead on the thread pool, each one needs space for the slice and for
+  // decompression. Keep at least one slice in flight, more if memory allows.
+  IndexVector full_size = this->private_->schema_->get_level_size( 0 );
+  size_t prefetch_slice_size = 2 * full_size.x() * full_size.y() * element_size;
+  size_t prefetch_depth = Min( static_cast<size_t>( 16 ), 
+    static_cast<size_t>( 2 * Parallel::GetNumThreads() ) );
+  while ( prefetch_depth > 1 && slice_buffer_size + prefetch_depth * prefetch_slice_size > 
+    static_cast<size_t>( this->private_->mem_limit_ ) )
+  {
+    prefetch_depth--;
+  }
+  slice_buffer_size += prefetch_depth * prefetch_slice_size;
+
   if ( slice_buffer_size > this->private_->mem_limit_ )
   {
     error = "Please allocate more memory to conversion process.";
@@ -1057,13 +1626,24 @@ bool LargeVolumeConverter::run_phase2( std::string& error )
         // NOTE: The first one will always be allocated by ITK
       this->private_->slices_[ j ] = StdDataBlock::New( level_size.x(), level_size.y(), 1, this->private_->schema_->get_data_type() );
     }
-    this->private_->brick_level_[ j ] = LargeVolumeBrickLevelHandle( new LargeVolumeBrickLevel( this->private_->schema_, j ) ) ;
+    this->private_->brick_level_[ j ] = LargeVolumeBrickLevelHandle( new LargeVolumeBrickLevel( 
+      this->private_->schema_, j, this->private_->write_statistics_ ) ) ;
 
     num_buffers += this->private_->brick_level_[ j ]->get_num_buffers();
     }
 
   IndexVector brick_size = this->private_->schema_->get_brick_size();
-  size_t buffer_size = Min( static_cast<size_t>( brick_size.z() ), static_cast<size_t>( (this->private_->mem_limit_ - slice_buffer_size ) / ( num_buffers * element_size * brick_size.x() * brick_size.y() ) ) );
+  size_t brick_slice_size = num_buffers * element_size * brick_size.x() * brick_size.y();
+  size_t buffer_memory = static_cast<size_t>( this->private_->mem_limit_ - slice_buffer_size );
+
+  // Prefer two sets of buffers, so one set can be written to disk while the other is filled
+  bool double_buffered = true;
+  size_t buffer_size = Min( static_cast<size_t>( brick_size.z() ), buffer_memory / ( 2 * brick_slice_size ) );
+  if ( buffer_size == 0 )
+  {
+    double_buffered = false;
+    buffer_size = Min( static_cast<size_t>( brick_size.z() ), buffer_memory / brick_slice_size );
+  }
 
   if ( buffer_size == 0 )
   {
@@ -1073,88 +1653,679 @@ bool LargeVolumeConverter::run_phase2( std::string& error )
 
     for ( size_t j = 0; j < num_levels; j++ )
     {
-    this->private_->brick_level_[ j ]->allocate_buffers( buffer_size );
+    this->private_->brick_level_[ j ]->allocate_buffers( buffer_size, double_buffered );
   }
 
-    // Main loading loop
-    size_t num_files = this->private_->files_.size();
-    double min = std::numeric_limits<double>::max();
-  double max = std::numeric_limits<double>::min();
-
-  IndexVector total_size = this->private_->schema_->get_size();
+  // Slices of a volume that slices are appended to are read back from its bricks in chunks
+  size_t append_chunk_size = Max( static_cast<size_t>( 1 ), static_cast<size_t>( 
+    prefetch_depth * prefetch_slice_size / ( full_size.x() * full_size.y() * element_size ) ) );
 
-    for ( IndexVector::index_type slice_idx = 0; slice_idx < num_files; slice_idx++)
+  LargeVolumeCheckpoint& checkpoint = this->private_->checkpoint_;
+  if ( checkpoint.append_setup_ )
+  {
+    if ( !this->private_->prepare_append( append_chunk_size, error ) )
     {
-
-        // indicate which slice is being processed
-        std::cout << "Processing file: " << this->private_->files_[ slice_idx ].string() << std::endl;
-    
-        // load slice
-        this->private_->slices_[ 0 ] = this->private_->load_file( this->private_->files_[ slice_idx ], error );
-    
-    if (! this->private_->slices_[ 0 ] ) 
+      return false;
+    }
+  }
+  else if ( this->private_->resume_ )
+  {
+    if ( !this->private_->restore_phase2_checkpoint( error ) )
     {
       return false;
     }
+  }
+  else if ( !this->private_->write_phase2_checkpoint( 0, checkpoint.min_, checkpoint.max_, error ) )
+  {
+    return false;
+  }
 
-    if ( this->private_->slices_[ 0 ]->get_nx() != total_size.x() ||  this->private_->slices_[ 0 ]->get_ny() != total_size.y() )
+    // Main loading loop
+  size_t num_slices = checkpoint.num_slices_;
+  size_t append_start = checkpoint.append_start_;
+    double min = checkpoint.min_;
+  double max = checkpoint.max_;
+
+  std::deque<LargeVolumeConverterPrivate::PrefetchSlotHandle> prefetch_queue;
+  size_t next_prefetch = Max( checkpoint.next_slice_, append_start );
+  std::deque<DataBlockHandle> append_queue;
+  size_t next_append = checkpoint.next_slice_;
+  long long total_bytes = 0;
+  bool success = true;
+
+    for ( size_t slice_idx = checkpoint.next_slice_; slice_idx < num_slices; slice_idx++)
     {
-      std::cout << "WARNING: Dimensions of the slices are not equal, clipping/padding image to fit dimensions of first image." <<std::endl;
-      DataBlock::Clip( this->private_->slices_[ 0 ], this->private_->slices_[ 0 ], total_size.x(), total_size.y(), 1, 0.0 );
-    } 
-  
-    
-    if (! this->private_->compute_min_max( this->private_->slices_[ 0 ], min, max ) )
+    if ( slice_idx < append_start )
     {
-      error = "Could not compute min and max.";
-      return false;
+      if ( append_queue.empty() )
+      {
+        std::vector<DataBlockHandle> slices;
+        if ( !this->private_->read_append_slices( 0, next_append, 
+          Min( next_append + append_chunk_size, append_start ), slices, error ) )
+        {
+          success = false;
+          break;
+        }
+        append_queue.insert( append_queue.end(), slices.begin(), slices.end() );
+        next_append += slices.size();
+      }
+
+      std::cout << "Processing slice of the volume: " << slice_idx << std::endl;
+      this->private_->slices_[ 0 ] = append_queue.front();
+      append_queue.pop_front();
     }
+    else
+    {
+      // Keep the prefetch queue filled
+      while ( next_prefetch < num_slices && prefetch_queue.size() < prefetch_depth )
+      {
+        LargeVolumeConverterPrivate::PrefetchSlotHandle slot( new LargeVolumeConverterPrivate::PrefetchSlot );
+        prefetch_queue.push_back( slot );
+        ThreadPool::Instance()->post( boost::bind( &LargeVolumeConverterPrivate::prefetch_slice,
+          this->private_, slot, next_prefetch - append_start ) );
+        next_prefetch++;
+      }
+
+      LargeVolumeConverterPrivate::PrefetchSlotHandle slot = prefetch_queue.front();
+      prefetch_queue.pop_front();
+      this->private_->wait_for_slot( slot );
+
+          // indicate which slice is being processed
+          std::cout << "Processing file: " << this->private_->files_[ slice_idx - append_start ].string() << std::endl;
+      
+      if (! slot->slice_ ) 
+      {
+        error = slot->error_;
+        success = false;
+        break;
+      }
 
-    this->private_->schema_->set_min_max( min, max );
+          this->private_->slices_[ 0 ] = slot->slice_;
 
-        if (! this->private_->process_slice( 0, error ) )
+      min = Min( min, slot->min_ );
+      max = Max( max, slot->max_ );
+      this->private_->schema_->set_min_max( min, max );
+    }
+
+    boost::posix_time::ptime bricking_start = boost::posix_time::microsec_clock::universal_time();
+    long long slice_bytes = this->private_->slices_[ 0 ]->get_byte_size();
+
+        if (! this->private_->process_slice( 0, slice_idx + 1 == num_slices, error ) )
         {
-            return false;
+      success = false;
+      break;
         }
+
+    this->private_->bricking_statistics_.add( bricking_start, slice_bytes );
+    total_bytes += slice_bytes;
+
+    if ( ( slice_idx + 1 ) % this->private_->checkpoint_interval_ == 0 && slice_idx + 1 < num_slices &&
+      !this->private_->write_phase2_checkpoint( slice_idx + 1, min, max, error ) )
+    {
+      success = false;
+      break;
     }
+    }
+
+  // Wait for the slices that are still being loaded and the buffers that are being written
+  while ( !prefetch_queue.empty() )
+  {
+    this->private_->wait_for_slot( prefetch_queue.front() );
+    prefetch_queue.pop_front();
+  }
+
+  for ( size_t j = 0; j < num_levels; j++ )
+  {
+    std::string flush_error;
+    if ( !this->private_->brick_level_[ j ]->wait_for_flush( flush_error ) && success )
+    {
+      error = flush_error;
+      success = false;
+    }
+  }
+
+  if ( !success )
+  {
+    return false;
+  }
 
   // Save schema file to update min and max
+  this->private_->schema_->set_min_max( min, max );
   if (! this->private_->schema_->save( error ) )
   {
     return false;
   }
 
+  // Bricking is done, the next checkpoints track the compression of the bricks
+  boost::filesystem::path dir = this->private_->schema_->get_dir();
+  checkpoint.phase_ = 3;
+  if ( !checkpoint.save( dir, error ) )
+  {
+    return false;
+  }
+  LargeVolumeCheckpoint::RemoveSlices( dir );
+
+  if ( append_start > 0 )
+  {
+    boost::system::error_code ec;
+    boost::filesystem::remove_all( LargeVolumeCheckpoint::GetAppendDir( dir ), ec );
+    this->private_->append_schema_.reset();
+  }
+
   this->private_->slices_.clear();
   this->private_->brick_level_.clear();
   this->private_->index_.clear();
 
+  LargeVolumeStageStatistics total_statistics;
+  total_statistics.add( phase_start, total_bytes );
+
+  std::cout << "Phase 2 throughput (time of the stages is summed over threads):" << std::endl;
+  std::cout << this->private_->load_statistics_.report( "  loading slices: " ) << std::endl;
+  std::cout << this->private_->bricking_statistics_.report( "  bricking:       " ) << std::endl;
+  std::cout << this->private_->write_statistics_.report( "  writing bricks: " ) << std::endl;
+  std::cout << total_statistics.report( "  total:          " ) << std::endl;
 
   return true;
 }
 
-void LargeVolumeConverterPrivate::run_phase3_parallel( int thread_num, int num_threads, boost::barrier& barrier )
+void LargeVolumeConverterPrivate::prefetch_slice( PrefetchSlotHandle slot, size_t slice_idx )
 {
+  boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+
   std::string error;
+  DataBlockHandle slice = this->load_file( this->files_[ slice_idx ], error );
+  
+  if ( slice )
+  {
+    if ( slice->get_nx() != this->data_size_.x() || slice->get_ny() != this->data_size_.y() )
+    {
+      std::cout << "WARNING: Dimensions of the slices are not equal, clipping/padding image to fit dimensions of first image." <<std::endl;
+      DataBlock::Clip( slice, slice, this->data_size_.x(), this->data_size_.y(), 1, 0.0 );
+    }
+
+    double min = std::numeric_limits<double>::max();
+    double max = std::numeric_limits<double>::min();
+    if ( !this->compute_min_max( slice, min, max ) )
+    {
+      error = "Could not compute min and max.";
+      slice.reset();
+    }
+    else
+    {
+      this->load_statistics_.add( start, slice->get_byte_size() );
+    }
+
+    slot->min_ = min;
+    slot->max_ = max;
+  }
+
+  boost::mutex::scoped_lock lock( this->prefetch_mutex_ );
+  slot->slice_ = slice;
+  slot->error_ = error;
+  slot->ready_ = true;
+  this->prefetch_done_.notify_all();
+}
+
+void LargeVolumeConverterPrivate::wait_for_slot( PrefetchSlotHandle slot )
+{
+  boost::mutex::scoped_lock lock( this->prefetch_mutex_ );
+  while ( !slot->ready_ )
+  {
+    this->prefetch_done_.wait( lock );
+  }
+}
+
+bool LargeVolumeConverterPrivate::write_phase2_checkpoint( size_t next_slice, double min, double max, 
+  std::string& error )
+{
+  boost::filesystem::path dir = this->schema_->get_dir();
+  size_t num_levels = this->brick_level_.size();
+
+  // Everything before the checkpoint needs to be on disk
+  for ( size_t j = 0; j < num_levels; j++ )
+  {
+    if ( !this->brick_level_[ j ]->flush_all( error ) )
+    {
+      return false;
+    }
+  }
+
+  // The coarser levels may contain half of a slice that is down sampled along z
+  for ( size_t j = 1; j < num_levels; j++ )
+  {
+    boost::filesystem::path slice_file = LargeVolumeCheckpoint::GetSliceFileName( dir, next_slice, j );
+    std::ofstream output( slice_file.string().c_str(), std::ios_base::trunc | std::ios_base::binary | std::ios_base::out );
+    output.write( reinterpret_cast<char*>( this->slices_[ j ]->get_data() ), this->slices_[ j ]->get_byte_size() );
+    if ( !output )
+    {
+      error = "Could not write to file '" + slice_file.string() + "'.";
+      return false;
+    }
+  }
+
+  size_t previous_slice = this->checkpoint_.next_slice_;
+
+  this->checkpoint_.phase_ = 2;
+  this->checkpoint_.next_slice_ = next_slice;
+  this->checkpoint_.min_ = min;
+  this->checkpoint_.max_ = max;
+  for ( size_t j = 0; j < num_levels; j++ )
+  {
+    this->checkpoint_.level_index_[ j ] = this->index_[ j ];
+    this->checkpoint_.level_count_[ j ] = this->brick_level_[ j ]->buffer_count_;
+  }
+
+  if ( !this->checkpoint_.save( dir, error ) )
+  {
+    return false;
+  }
+
+  if ( previous_slice != next_slice )
+  {
+    for ( size_t j = 1; j < num_levels; j++ )
+    {
+      boost::system::error_code ec;
+      boost::filesystem::remove( LargeVolumeCheckpoint::GetSliceFileName( dir, previous_slice, j ), ec );
+    }
+  }
+
+  return true;
+}
+
+bool LargeVolumeConverterPrivate::restore_phase2_checkpoint( std::string& error )
+{
+  boost::filesystem::path dir = this->schema_->get_dir();
+  size_t num_levels = this->brick_level_.size();
+
+  for ( size_t j = 0; j < num_levels; j++ )
+  {
+    if ( !this->brick_level_[ j ]->restore( this->checkpoint_.level_count_[ j ], error ) )
+    {
+      return false;
+    }
+    this->index_[ j ] = this->checkpoint_.level_index_[ j ];
+  }
+
+  for ( size_t j = 1; j < num_levels; j++ )
+  {
+    boost::filesystem::path slice_file = LargeVolumeCheckpoint::GetSliceFileName( dir, 
+      this->checkpoint_.next_slice_, j );
+    std::ifstream input( slice_file.string().c_str(), std::ios_base::in | std::ios_base::binary );
+    input.read( reinterpret_cast<char*>( this->slices_[ j ]->get_data() ), this->slices_[ j ]->get_byte_size() );
+    if ( !input )
+    {
+      error = "Could not read file '" + slice_file.string() + "'.";
+      return false;
+    }
+  }
+
+  std::cout << "Continuing conversion at slice " << this->checkpoint_.next_slice_ << "." << std::endl;
+  return true;
+}
+
+bool LargeVolumeConverterPrivate::write_phase3_checkpoint( std::string& error )
+{
+  // Packed bricks are only found through the index
+  if ( this->checkpoint_.packing_ && !this->schema_->checkpoint_packing( error ) )
+  {
+    return false;
+  }
 
+  return this->checkpoint_.save( this->schema_->get_dir(), error );
+}
+
+bool LargeVolumeConverterPrivate::setup_append( const boost::filesystem::path& old_dir, std::string& error )
+{
+  this->append_schema_.reset( new LargeVolumeSchema );
+  this->append_schema_->set_dir( old_dir );
+  if ( !this->append_schema_->load( error ) )
+  {
+    return false;
+  }
+
+  if ( this->append_schema_->is_packed() )
+  {
+    error = "Slices can only be appended to a volume that stores each brick in a separate file.";
+    return false;
+  }
+
+  if ( this->append_schema_->get_data_type() != this->data_type_ ||
+    this->append_schema_->get_nx() != this->data_size_.x() ||
+    this->append_schema_->get_ny() != this->data_size_.y() )
+  {
+    error = "The data type and size of the files do not match the volume.";
+    return false;
+  }
+
+  // The volume keeps its bricking and compression, only its size changes
+  boost::filesystem::path dir = this->schema_->get_dir();
+  this->schema_->set_dir( old_dir );
+  if ( !this->schema_->load( error ) )
+  {
+    return false;
+  }
+  this->schema_->set_dir( dir );
+
+  size_t old_num_slices = this->append_schema_->get_nz();
+  IndexVector size = this->schema_->get_size();
+  size.z( old_num_slices + this->files_.size() );
+  this->schema_->set_size( size );
+  this->schema_->compute_levels();
+
+  size_t old_num_levels = this->append_schema_->get_num_levels();
   size_t num_levels = this->schema_->get_num_levels();
+  bool same_levels = ( num_levels >= old_num_levels );
+  for ( size_t j = 0; same_levels && j < old_num_levels; j++ )
+  {
+    same_levels = ( this->schema_->get_level_downsample_ratio( j ) ==
+      this->append_schema_->get_level_downsample_ratio( j ) );
+  }
 
-    for ( size_t j = 0; j < num_levels; j ++ )
+  if ( !same_levels )
+  {
+    error = "The resolution levels of the volume change when appending these files.";
+    return false;
+  }
+
+  // Start again at a slice that starts a new slice in each level, so the down sampled slices
+  // are the same as the ones of a single conversion
+  size_t ratio = this->schema_->get_level_downsample_ratio( num_levels - 1 ).z();
+  size_t restart_slice = ( old_num_slices / ratio ) * ratio;
+
+  IndexVector eff_brick_size = this->schema_->get_effective_brick_size();
+  size_t overlap = this->schema_->get_overlap();
+
+  this->checkpoint_ = LargeVolumeCheckpoint();
+  this->checkpoint_.num_slices_ = size.z();
+  this->checkpoint_.append_start_ = old_num_slices;
+  this->checkpoint_.append_setup_ = true;
+  this->checkpoint_.next_slice_ = restart_slice;
+  this->checkpoint_.min_ = this->append_schema_->get_min();
+  this->checkpoint_.max_ = this->append_schema_->get_max();
+  this->checkpoint_.level_index_.resize( num_levels, 0 );
+  this->checkpoint_.level_count_.resize( num_levels, 0 );
+  this->checkpoint_.level_next_brick_.resize( num_levels, 0 );
+
+  for ( size_t j = 0; j < old_num_levels; j++ )
+  {
+    size_t index = restart_slice / this->schema_->get_level_downsample_ratio( j ).z();
+    this->checkpoint_.level_index_[ j ] = index;
+    this->checkpoint_.level_count_[ j ] = index + overlap;
+
+    // Only the rows of bricks that contain slices after the restart need to be compressed again
+    IndexVector layout = this->schema_->get_level_layout( j );
+    IndexVector::index_type level_z = this->schema_->get_level_size( j ).z();
+    IndexVector::index_type z = 0;
+    while ( z < layout.z() && Min( ( z + 1 ) * eff_brick_size.z(), level_z ) + 
+      2 * static_cast<IndexVector::index_type>( overlap ) <= static_cast<IndexVector::index_type>( index + overlap ) )
     {
-    if ( thread_num == 0 )
+      z++;
+    }
+    this->checkpoint_.level_next_brick_[ j ] = z * layout.x() * layout.y();
+  }
+
+  return true;
+}
+
+bool LargeVolumeConverterPrivate::prepare_append( size_t chunk_size, std::string& error )
+{
+  namespace bfs = boost::filesystem;
+
+  size_t old_num_levels = this->append_schema_->get_num_levels();
+  size_t num_levels = this->schema_->get_num_levels();
+  IndexVector eff_brick_size = this->schema_->get_effective_brick_size();
+  IndexVector::index_type overlap = this->schema_->get_overlap();
+
+  // Move the bricks that change to the backup directory, they provide the slices that are
+  // bricked again. The coarsest level is needed completely to compute the new levels.
+  for ( size_t j = 0; j < old_num_levels; j++ )
+  {
+    IndexVector layout = this->append_schema_->get_level_layout( j );
+    IndexVector::index_type level_z = this->append_schema_->get_level_size( j ).z();
+    IndexVector::index_type count = this->checkpoint_.level_count_[ j ];
+    bool complete_level = ( j + 1 == old_num_levels && num_levels > old_num_levels );
+
+    for ( IndexVector::index_type z = 0; z < layout.z(); z++ )
     {
-      std::cout << "processing level: " << ExportToString( j ) << std::endl; 
+      bool rewritten = ( Min( ( z + 1 ) * eff_brick_size.z(), level_z ) + 2 * overlap > count );
+      if ( !rewritten && !complete_level ) continue;
+
+      for ( IndexVector::index_type k = 0; k < layout.x() * layout.y(); k++ )
+      {
+        BrickInfo bi( k + z * layout.x() * layout.y(), j );
+        bfs::path brick_file = this->schema_->get_brick_file_name( bi );
+        bfs::path backup_file = this->append_schema_->get_brick_file_name( bi );
+
+        boost::system::error_code ec;
+        if ( bfs::exists( backup_file ) )
+        {
+          // Left behind by an earlier attempt
+          if ( rewritten ) bfs::remove( brick_file, ec );
+        }
+        else if ( rewritten )
+        {
+          bfs::rename( brick_file, backup_file, ec );
+        }
+        else
+        {
+          bfs::copy_file( brick_file, backup_file, ec );
+        }
+
+        if ( ec )
+        {
+          error = "Could not move brick file '" + brick_file.string() + "' to the backup directory.";
+          return false;
+        }
+      }
     }
+  }
+
+  // The slices before the restart are written back to the bricks that are rewritten
+  for ( size_t j = 0; j < old_num_levels; j++ )
+  {
+    IndexVector layout = this->schema_->get_level_layout( j );
+    IndexVector::index_type level_z = this->schema_->get_level_size( j ).z();
+    IndexVector::index_type count = this->checkpoint_.level_count_[ j ];
+
+    for ( IndexVector::index_type z = 0; z < layout.z(); z++ )
+    {
+      IndexVector::index_type b_start = z * eff_brick_size.z();
+      IndexVector::index_type b_end = Min( ( z + 1 ) * eff_brick_size.z(), level_z ) + 2 * overlap;
+      if ( b_end <= count ) continue;
+
+      for ( IndexVector::index_type k = 0; k < layout.x() * layout.y(); k++ )
+      {
+        BrickInfo bi( k + z * layout.x() * layout.y(), j );
+        boost::system::error_code ec;
+        bfs::remove( this->schema_->get_brick_file_name( bi ), ec );
 
+        IndexVector::index_type position = b_start;
+        while ( position < count )
+        {
+          DataBlockHandle brick;
+          IndexVector::index_type brick_start;
+          if ( !this->read_append_brick( j, k, position, brick, brick_start, error ) )
+          {
+            return false;
+          }
+
+          IndexVector::index_type end = Min( count, brick_start + static_cast<IndexVector::index_type>( brick->get_nz() ) );
+          if ( !this->schema_->append_brick_buffer( brick, position - brick_start, end - brick_start, 
+            0, bi, error ) )
+          {
+            return false;
+          }
+          position = end;
+        }
+      }
+    }
+  }
+
+  for ( size_t j = 0; j < num_levels; j++ )
+  {
+    if ( !this->brick_level_[ j ]->restore( this->checkpoint_.level_count_[ j ], error ) )
+    {
+      return false;
+    }
+    this->index_[ j ] = this->checkpoint_.level_index_[ j ];
+  }
+
+  // Levels that did not exist yet are computed from the coarsest old level
+  if ( num_levels > old_num_levels )
+  {
+    size_t level = old_num_levels - 1;
+    size_t num_slices = this->index_[ level ];
+    DataBlockHandle level_slice = this->slices_[ level ];
+
+    this->index_[ level ] = 0;
+    for ( size_t begin = 0; begin < num_slices; begin += chunk_size )
+    {
+      std::vector<DataBlockHandle> slices;
+      if ( !this->read_append_slices( level, begin, Min( begin + chunk_size, num_slices ), slices, error ) )
+      {
+        return false;
+      }
+
+      for ( size_t k = 0; k < slices.size(); k++ )
+      {
+        this->slices_[ level ] = slices[ k ];
+        if ( !this->downsample_slice( level, false, error ) )
+        {
+          return false;
+        }
+        this->index_[ level ]++;
+      }
+    }
+    this->slices_[ level ] = level_slice;
+  }
+
+  this->checkpoint_.append_setup_ = false;
+  return this->write_phase2_checkpoint( this->checkpoint_.next_slice_, this->checkpoint_.min_,
+    this->checkpoint_.max_, error );
+}
+
+bool LargeVolumeConverterPrivate::read_append_brick( size_t level, IndexVector::index_type column, 
+  IndexVector::index_type position, DataBlockHandle& brick, IndexVector::index_type& brick_start, 
+  std::string& error )
+{
+  IndexVector layout = this->append_schema_->get_level_layout( level );
+  IndexVector::index_type eff_brick_z = this->append_schema_->get_effective_brick_size().z();
+
+  // The overlap at the end of the last row contains the positions beyond it
+  IndexVector::index_type z = Min( position / eff_brick_z, layout.z() - 1 );
+  BrickInfo bi( column + z * layout.x() * layout.y(), level );
+
+  if ( !this->append_schema_->read_brick( brick, bi, error ) )
+  {
+    error = "Could not read brick '" + this->append_schema_->get_brick_file_name( bi ).string() + 
+      "': " + error;
+    return false;
+  }
+
+  brick_start = z * eff_brick_z;
+  if ( position >= brick_start + static_cast<IndexVector::index_type>( brick->get_nz() ) )
+  {
+    error = "Slices that are appended do not follow the volume.";
+    return false;
+  }
+
+  return true;
+}
+
+bool LargeVolumeConverterPrivate::read_append_slices( size_t level, size_t begin, size_t end,
+  std::vector<DataBlockHandle>& slices, std::string& error )
+{
+  IndexVector level_size = this->append_schema_->get_level_size( level );
+  IndexVector layout = this->append_schema_->get_level_layout( level );
+  IndexVector eff_brick_size = this->append_schema_->get_effective_brick_size();
+  IndexVector::index_type overlap = this->append_schema_->get_overlap();
+  size_t element_size = GetSizeDataType( this->append_schema_->get_data_type() );
+
+  slices.clear();
+  for ( size_t j = begin; j < end; j++ )
+  {
+    slices.push_back( StdDataBlock::New( level_size.x(), level_size.y(), 1, 
+      this->append_schema_->get_data_type() ) );
+  }
+
+  for ( IndexVector::index_type by = 0; by < layout.y(); by++ )
+  {
+    for ( IndexVector::index_type bx = 0; bx < layout.x(); bx++ )
+    {
+      IndexVector::index_type x_start = bx * eff_brick_size.x();
+      IndexVector::index_type x_end = Min( x_start + eff_brick_size.x(), level_size.x() );
+      IndexVector::index_type y_start = by * eff_brick_size.y();
+      IndexVector::index_type y_end = Min( y_start + eff_brick_size.y(), level_size.y() );
+
+      IndexVector::index_type position = begin + overlap;
+      while ( position < static_cast<IndexVector::index_type>( end ) + overlap )
+      {
+        DataBlockHandle brick;
+        IndexVector::index_type brick_start;
+        if ( !this->read_append_brick( level, bx + by * layout.x(), position, brick, brick_start, error ) )
+        {
+          return false;
+        }
+
+        IndexVector::index_type brick_nx = brick->get_nx();
+        IndexVector::index_type brick_ny = brick->get_ny();
+        IndexVector::index_type brick_end = Min( static_cast<IndexVector::index_type>( end ) + overlap,
+          brick_start + static_cast<IndexVector::index_type>( brick->get_nz() ) );
+
+        // Copy the part without overlap into the slices
+        for ( ; position < brick_end; position++ )
+        {
+          const char* src = reinterpret_cast<const char*>( brick->get_data() ) + 
+            ( position - brick_start ) * brick_nx * brick_ny * element_size;
+          char* dst = reinterpret_cast<char*>( slices[ position - overlap - begin ]->get_data() );
+
+          for ( IndexVector::index_type y = y_start; y < y_end; y++ )
+          {
+            std::memcpy( dst + ( y * level_size.x() + x_start ) * element_size, 
+              src + ( ( y - y_start + overlap ) * brick_nx + overlap ) * element_size,
+              ( x_end - x_start ) * element_size );
+          }
+        }
+      }
+    }
+  }
+
+  return true;
+}
+
+void LargeVolumeConverterPrivate::run_phase3_parallel( int thread_num, int num_threads, Barrier& barrier )
+{
+  std::string error;
+
+  size_t num_levels = this->schema_->get_num_levels();
+
+    for ( size_t j = 0; j < num_levels; j ++ )
+    {
         IndexVector layout = this->schema_->get_level_layout( j );
         IndexVector::index_type num_bricks = layout[0] * layout[1] * layout[2];
-        
+    size_t first_brick = this->checkpoint_.level_next_brick_[ j ];
+
     if ( thread_num == 0 )
     {
+      std::cout << "processing level: " << ExportToString( j ) << std::endl; 
       std::cout << "processing brick: 000000/000000";
+
+      this->phase3_next_brick_ = first_brick;
+      this->phase3_done_brick_ = first_brick;
+      this->phase3_num_done_ = 0;
+      this->phase3_done_.assign( num_bricks, false );
     }
+    barrier.wait();
 
-        for ( size_t k = thread_num;  k < num_bricks; k += num_threads )
+        while ( this->success_ )
         {
+      size_t k;
+      {
+        boost::mutex::scoped_lock lock( this->phase3_mutex_ );
+        k = this->phase3_next_brick_++;
+      }
+      if ( k >= static_cast<size_t>( num_bricks ) ) break;
+
       if ( thread_num == 0 )
       {
         std::cout << "\b\b\b\b\b\b\b\b\b\b\b\b\b" << std::setfill('0') << std::setw(6) << (k+1) << "/" << std::setfill('0') << std::setw(6) << num_bricks;
@@ -1168,6 +2339,24 @@ void LargeVolumeConverterPrivate::run_phase3_parallel( int thread_num, int num_t
                 this->success_ = false;
         break;
       }
+
+      boost::mutex::scoped_lock lock( this->phase3_mutex_ );
+      this->phase3_done_[ k ] = true;
+      while ( this->phase3_done_brick_ < static_cast<size_t>( num_bricks ) && 
+        this->phase3_done_[ this->phase3_done_brick_ ] )
+      {
+        this->phase3_done_brick_++;
+      }
+
+      if ( ++this->phase3_num_done_ % this->checkpoint_interval_ == 0 )
+      {
+        this->checkpoint_.level_next_brick_[ j ] = this->phase3_done_brick_;
+        if ( !this->write_phase3_checkpoint( error ) )
+        {
+          std::cerr << error << std::endl;
+          this->success_ = false;
+        }
+      }
         }
     barrier.wait();
 
@@ -1175,8 +2364,20 @@ void LargeVolumeConverterPrivate::run_phase3_parallel( int thread_num, int num_t
     {
       std::cout << "\b\b\b\b\b\b\b\b\b\b\b\b\b" << std::setfill('0') << std::setw(6) << num_bricks << "/" << std::setfill('0') << std::setw(6) << num_bricks;
       std::cout << std::endl;
-            
+
+      if ( this->success_ )
+      {
+        this->checkpoint_.level_next_brick_[ j ] = num_bricks;
+        if ( !this->write_phase3_checkpoint( error ) )
+        {
+          std::cerr << error << std::endl;
+          this->success_ = false;
+        }
+      }
     }
+    barrier.wait();
+
+    if ( !this->success_ ) break;
   }
 
 }
@@ -1186,15 +2387,53 @@ bool LargeVolumeConverter::run_phase3( std::string& error )
   error = "";
   this->private_->success_ = true;
 
+  LargeVolumeCheckpoint& checkpoint = this->private_->checkpoint_;
+  boost::filesystem::path dir = this->private_->schema_->get_dir();
+
+  // Rewritten bricks are appended to the pack files instead of going back to their own file
+  if ( this->private_->packed_ )
+  {
+    if ( checkpoint.packing_ )
+    {
+      if ( !this->private_->schema_->resume_packing( error ) )
+      {
+        return false;
+      }
+    }
+    else
+    {
+      // All bricks need to go into the pack, also the ones an append did not change
+      std::fill( checkpoint.level_next_brick_.begin(), checkpoint.level_next_brick_.end(), 0 );
+
+      if ( !this->private_->schema_->begin_packing( error ) )
+      {
+        return false;
+      }
+      checkpoint.packing_ = true;
+      if ( !this->private_->write_phase3_checkpoint( error ) )
+      {
+        return false;
+      }
+    }
+  }
+
   Parallel parallel( boost::bind( &LargeVolumeConverterPrivate::run_phase3_parallel, this->private_, _1, _2, _3 ) );
 
   parallel.run();
     if ( !this->private_->success_ )
     {
         error = "Could not compress bricks.";
+        return false;
     }
 
-  return this->private_->success_;
+  if ( this->private_->packed_ && !this->private_->schema_->finish_packing( error ) )
+  {
+    return false;
+  }
+
+  LargeVolumeCheckpoint::Remove( dir );
+
+  return true;
 }
 
 
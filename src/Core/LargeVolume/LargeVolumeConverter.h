@@ -77,6 +77,19 @@ public:
   /// Upload parameters for schema
   void set_schema_parameters( const Vector& spacing, const Point& origin, const IndexVector& brick_size, size_t overlap );
 
+  /// SET_RESUME
+  /// Continue the interrupted conversion in the output directory from its last checkpoint
+  void set_resume( bool resume );
+
+  /// SET_APPEND
+  /// Add the files as new slices to the volume in the output directory. Only the bricks that
+  /// contain the new slices and the down sampled versions of them are created again.
+  void set_append( bool append );
+
+  /// SET_CHECKPOINT_INTERVAL
+  /// Number of slices (phase 2) or bricks (phase 3) after which the progress is recorded
+  void set_checkpoint_interval( size_t interval );
+
   /// RUN_PHASE1
   /// Check files and determine size
   bool run_phase1( std::string& error );
@@ -85,12 +98,20 @@ public:
   /// How much meory to devote to the conversion process
   void set_mem_limit( long long mem_limit );
 
+  /// SET_PACKED
+  /// Store the bricks in a few pack files instead of one file per brick
+  void set_packed( bool packed );
+
+  /// SET_CODEC
+  /// Set the compression of the bricks, default is zlib without a filter
+  void set_codec( BrickCodec codec, BrickFilter filter );
+
   /// RUN_PHASE2
   /// Downsample and build bricks
   bool run_phase2( std::string& error );
 
     /// RUN_PHASE3
-    /// Compress bricks
+    /// Compress bricks and, if requested, pack them
     bool run_phase3( std::string& error );
 
   /// GET_SCHEMA
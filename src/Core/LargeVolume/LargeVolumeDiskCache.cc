@@ -0,0 +1,511 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+#include <cstring>
+#include <list>
+#include <vector>
+
+#include <boost/unordered_map.hpp>
+#include <boost/thread.hpp>
+#include <boost/filesystem.hpp>
+
+#include <Core/Utils/MappedFile.h>
+#include <Core/DataBlock/StdDataBlock.h>
+#include <Core/LargeVolume/LargeVolumeDiskCache.h>
+
+namespace bfs=boost::filesystem;
+
+namespace Core
+{
+
+class LargeVolumeDiskCachePrivate
+{
+public:
+  typedef LargeVolumeSchema::brick_key_type brick_key_type;
+  typedef std::list<brick_key_type> access_list_type;
+
+  struct Entry
+  {
+    Entry() : 
+      size_class_( -1 ), offset_( 0 ), nx_( 0 ), ny_( 0 ), nz_( 0 ), 
+      data_type_( DataType::UNKNOWN_E ), byte_size_( 0 ), readers_( 0 ), ready_( false )
+    {
+    }
+
+    int size_class_;
+    long long offset_;
+    size_t nx_;
+    size_t ny_;
+    size_t nz_;
+    DataType data_type_;
+    size_t byte_size_;
+
+    // Number of threads copying the brick out of the cache
+    int readers_;
+    // Whether the brick has been written completely
+    bool ready_;
+
+    access_list_type::iterator access_record_;
+  };
+
+  struct SizeClass
+  {
+    size_t slot_size_;
+    size_t num_chunks_;
+    std::vector<long long> free_slots_;
+    access_list_type access_list_;
+  };
+
+  struct Chunk
+  {
+    int size_class_;
+    MappedFileHandle mapping_;
+  };
+
+  typedef boost::unordered_map<brick_key_type, Entry> entry_map_type;
+
+public:
+  LargeVolumeDiskCachePrivate() :
+    capacity_( 0 ),
+    size_( 0 ),
+    num_pinned_( 0 )
+  {
+  }
+
+  int find_size_class( size_t byte_size ) const;
+  char* get_address( long long offset ) const;
+
+  void remove_entry( entry_map_type::iterator it );
+  void reset();
+
+  bool allocate_slot( int size_class, long long& offset );
+  bool assign_free_chunk( int size_class );
+  bool evict_from_class( int size_class );
+  bool reclaim_chunk( int size_class );
+  void give_chunk( size_t chunk, int size_class );
+
+  void unpin();
+
+  boost::mutex mutex_;
+  boost::condition_variable unpinned_;
+
+  bfs::path filename_;
+  long long capacity_;
+  long long size_;
+
+  std::vector<Chunk> chunks_;
+  std::vector<SizeClass> size_classes_;
+  entry_map_type entries_;
+
+  // Number of entries that are being read or written outside the lock
+  int num_pinned_;
+
+  static const long long CHUNK_SIZE_C;
+  static const size_t MIN_SLOT_SIZE_C;
+};
+
+const long long LargeVolumeDiskCachePrivate::CHUNK_SIZE_C = static_cast<long long>( 64 ) << 20;
+const size_t LargeVolumeDiskCachePrivate::MIN_SLOT_SIZE_C = static_cast<size_t>( 64 ) << 10;
+
+int LargeVolumeDiskCachePrivate::find_size_class( size_t byte_size ) const
+{
+  for ( size_t j = 0; j < this->size_classes_.size(); j++ )
+  {
+    if ( this->size_classes_[ j ].slot_size_ >= byte_size ) return static_cast<int>( j );
+  }
+  return -1;
+}
+
+char* LargeVolumeDiskCachePrivate::get_address( long long offset ) const
+{
+  const Chunk& chunk = this->chunks_[ static_cast<size_t>( offset / CHUNK_SIZE_C ) ];
+  return chunk.mapping_->get_data() + static_cast<size_t>( offset % CHUNK_SIZE_C );
+}
+
+void LargeVolumeDiskCachePrivate::remove_entry( entry_map_type::iterator it )
+{
+  SizeClass& size_class = this->size_classes_[ it->second.size_class_ ];
+  size_class.access_list_.erase( it->second.access_record_ );
+  size_class.free_slots_.push_back( it->second.offset_ );
+  if ( it->second.ready_ ) this->size_ -= it->second.byte_size_;
+  this->entries_.erase( it );
+}
+
+void LargeVolumeDiskCachePrivate::reset()
+{
+  this->entries_.clear();
+  this->size_ = 0;
+
+  for ( size_t j = 0; j < this->size_classes_.size(); j++ )
+  {
+    this->size_classes_[ j ].num_chunks_ = 0;
+    this->size_classes_[ j ].free_slots_.clear();
+    this->size_classes_[ j ].access_list_.clear();
+  }
+
+  for ( size_t j = 0; j < this->chunks_.size(); j++ )
+  {
+    this->chunks_[ j ].size_class_ = -1;
+  }
+}
+
+void LargeVolumeDiskCachePrivate::give_chunk( size_t chunk, int size_class )
+{
+  SizeClass& new_class = this->size_classes_[ size_class ];
+  this->chunks_[ chunk ].size_class_ = size_class;
+  new_class.num_chunks_++;
+
+  long long start = static_cast<long long>( chunk ) * CHUNK_SIZE_C;
+  long long num_slots = CHUNK_SIZE_C / static_cast<long long>( new_class.slot_size_ );
+  for ( long long j = num_slots - 1; j >= 0; j-- )
+  {
+    new_class.free_slots_.push_back( start + j * static_cast<long long>( new_class.slot_size_ ) );
+  }
+}
+
+bool LargeVolumeDiskCachePrivate::assign_free_chunk( int size_class )
+{
+  for ( size_t j = 0; j < this->chunks_.size(); j++ )
+  {
+    if ( this->chunks_[ j ].size_class_ == -1 )
+    {
+      this->give_chunk( j, size_class );
+      return true;
+    }
+  }
+  return false;
+}
+
+bool LargeVolumeDiskCachePrivate::evict_from_class( int size_class )
+{
+  access_list_type& access_list = this->size_classes_[ size_class ].access_list_;
+  for ( access_list_type::reverse_iterator rit = access_list.rbegin(); 
+    rit != access_list.rend(); ++rit )
+  {
+    entry_map_type::iterator it = this->entries_.find( *rit );
+    if ( it->second.ready_ && it->second.readers_ == 0 )
+    {
+      this->remove_entry( it );
+      return true;
+    }
+  }
+  return false;
+}
+
+bool LargeVolumeDiskCachePrivate::reclaim_chunk( int size_class )
+{
+  // Take a chunk away from the class that owns the most
+  int victim = -1;
+  for ( size_t j = 0; j < this->size_classes_.size(); j++ )
+  {
+    if ( static_cast<int>( j ) == size_class || this->size_classes_[ j ].num_chunks_ == 0 ) continue;
+    if ( victim == -1 || this->size_classes_[ j ].num_chunks_ > 
+      this->size_classes_[ victim ].num_chunks_ )
+    {
+      victim = static_cast<int>( j );
+    }
+  }
+  if ( victim == -1 ) return false;
+
+  for ( size_t chunk = 0; chunk < this->chunks_.size(); chunk++ )
+  {
+    if ( this->chunks_[ chunk ].size_class_ != victim ) continue;
+
+    long long start = static_cast<long long>( chunk ) * CHUNK_SIZE_C;
+    long long end = start + CHUNK_SIZE_C;
+
+    std::vector<entry_map_type::iterator> entries;
+    bool pinned = false;
+    for ( entry_map_type::iterator it = this->entries_.begin(); it != this->entries_.end(); ++it )
+    {
+      if ( it->second.offset_ < start || it->second.offset_ >= end ) continue;
+      if ( !it->second.ready_ || it->second.readers_ > 0 )
+      {
+        pinned = true;
+        break;
+      }
+      entries.push_back( it );
+    }
+    if ( pinned ) continue;
+
+    for ( size_t k = 0; k < entries.size(); k++ ) this->remove_entry( entries[ k ] );
+
+    SizeClass& victim_class = this->size_classes_[ victim ];
+    std::vector<long long> free_slots;
+    for ( size_t k = 0; k < victim_class.free_slots_.size(); k++ )
+    {
+      long long offset = victim_class.free_slots_[ k ];
+      if ( offset < start || offset >= end ) free_slots.push_back( offset );
+    }
+    victim_class.free_slots_.swap( free_slots );
+    victim_class.num_chunks_--;
+
+    this->give_chunk( chunk, size_class );
+    return true;
+  }
+
+  return false;
+}
+
+bool LargeVolumeDiskCachePrivate::allocate_slot( int size_class, long long& offset )
+{
+  SizeClass& slots = this->size_classes_[ size_class ];
+
+  if ( slots.free_slots_.empty() && !this->assign_free_chunk( size_class ) &&
+    !this->evict_from_class( size_class ) && !this->reclaim_chunk( size_class ) )
+  {
+    return false;
+  }
+
+  offset = slots.free_slots_.back();
+  slots.free_slots_.pop_back();
+  return true;
+}
+
+void LargeVolumeDiskCachePrivate::unpin()
+{
+  if ( --this->num_pinned_ == 0 ) this->unpinned_.notify_all();
+}
+
+LargeVolumeDiskCache::LargeVolumeDiskCache() :
+  private_( new LargeVolumeDiskCachePrivate )
+{
+  for ( size_t slot_size = LargeVolumeDiskCachePrivate::MIN_SLOT_SIZE_C; 
+    slot_size <= static_cast<size_t>( LargeVolumeDiskCachePrivate::CHUNK_SIZE_C ); slot_size *= 2 )
+  {
+    LargeVolumeDiskCachePrivate::SizeClass size_class;
+    size_class.slot_size_ = slot_size;
+    size_class.num_chunks_ = 0;
+    this->private_->size_classes_.push_back( size_class );
+  }
+}
+
+LargeVolumeDiskCache::~LargeVolumeDiskCache()
+{
+  this->close();
+}
+
+bool LargeVolumeDiskCache::open( const boost::filesystem::path& dir, long long capacity, 
+  std::string& error )
+{
+  this->close();
+
+  boost::mutex::scoped_lock lock( this->private_->mutex_ );
+
+  size_t num_chunks = static_cast<size_t>( capacity / LargeVolumeDiskCachePrivate::CHUNK_SIZE_C );
+  if ( num_chunks == 0 )
+  {
+    error = "Disk cache needs to be at least 64 MB.";
+    return false;
+  }
+
+  try
+  {
+    if ( !bfs::exists( dir ) ) bfs::create_directories( dir );
+    // Multiple instances of the program may share the same cache directory
+    this->private_->filename_ = dir / bfs::unique_path( "LargeVolumeCache-%%%%-%%%%-%%%%.dat" );
+  }
+  catch ( ... )
+  {
+    error = "Could not create cache directory '" + dir.string() + "'.";
+    return false;
+  }
+
+  // Size the file once, so that the chunks can be mapped independently
+  long long file_size = static_cast<long long>( num_chunks ) * 
+    LargeVolumeDiskCachePrivate::CHUNK_SIZE_C;
+  {
+    MappedFile file;
+    if ( !file.create( this->private_->filename_, file_size, error ) ) return false;
+  }
+
+  this->private_->chunks_.resize( num_chunks );
+  for ( size_t j = 0; j < num_chunks; j++ )
+  {
+    LargeVolumeDiskCachePrivate::Chunk& chunk = this->private_->chunks_[ j ];
+    chunk.size_class_ = -1;
+    chunk.mapping_.reset( new MappedFile );
+    if ( !chunk.mapping_->open( this->private_->filename_, MappedFile::READ_WRITE_E, error, 
+      static_cast<long long>( j ) * LargeVolumeDiskCachePrivate::CHUNK_SIZE_C, 
+      static_cast<size_t>( LargeVolumeDiskCachePrivate::CHUNK_SIZE_C ) ) )
+    {
+      this->private_->chunks_.clear();
+      boost::system::error_code ec;
+      bfs::remove( this->private_->filename_, ec );
+      return false;
+    }
+  }
+
+  this->private_->capacity_ = file_size;
+  this->private_->reset();
+  return true;
+}
+
+void LargeVolumeDiskCache::close()
+{
+  boost::mutex::scoped_lock lock( this->private_->mutex_ );
+  while ( this->private_->num_pinned_ > 0 ) this->private_->unpinned_.wait( lock );
+
+  if ( this->private_->chunks_.empty() ) return;
+
+  this->private_->reset();
+  this->private_->chunks_.clear();
+  this->private_->capacity_ = 0;
+
+  boost::system::error_code ec;
+  bfs::remove( this->private_->filename_, ec );
+}
+
+void LargeVolumeDiskCache::clear()
+{
+  boost::mutex::scoped_lock lock( this->private_->mutex_ );
+  while ( this->private_->num_pinned_ > 0 ) this->private_->unpinned_.wait( lock );
+
+  this->private_->reset();
+}
+
+bool LargeVolumeDiskCache::has_brick( LargeVolumeSchema::brick_key_type key )
+{
+  boost::mutex::scoped_lock lock( this->private_->mutex_ );
+
+  LargeVolumeDiskCachePrivate::entry_map_type::iterator it = 
+    this->private_->entries_.find( key );
+  if ( it == this->private_->entries_.end() || !it->second.ready_ ) return false;
+
+  LargeVolumeDiskCachePrivate::access_list_type& access_list = 
+    this->private_->size_classes_[ it->second.size_class_ ].access_list_;
+  access_list.splice( access_list.begin(), access_list, it->second.access_record_ );
+  return true;
+}
+
+bool LargeVolumeDiskCache::get_brick( LargeVolumeSchema::brick_key_type key, DataBlockHandle& data_block )
+{
+  LargeVolumeDiskCachePrivate::Entry entry;
+  {
+    boost::mutex::scoped_lock lock( this->private_->mutex_ );
+
+    LargeVolumeDiskCachePrivate::entry_map_type::iterator it = 
+      this->private_->entries_.find( key );
+    if ( it == this->private_->entries_.end() || !it->second.ready_ ) return false;
+
+    LargeVolumeDiskCachePrivate::access_list_type& access_list = 
+      this->private_->size_classes_[ it->second.size_class_ ].access_list_;
+    access_list.splice( access_list.begin(), access_list, it->second.access_record_ );
+
+    // Pin the entry, so it is not evicted while copying
+    it->second.readers_++;
+    this->private_->num_pinned_++;
+    entry = it->second;
+  }
+
+  data_block = StdDataBlock::New( entry.nx_, entry.ny_, entry.nz_, entry.data_type_ );
+  if ( data_block )
+  {
+    std::memcpy( data_block->get_data(), this->private_->get_address( entry.offset_ ), 
+      entry.byte_size_ );
+  }
+
+  boost::mutex::scoped_lock lock( this->private_->mutex_ );
+  this->private_->entries_[ key ].readers_--;
+  this->private_->unpin();
+
+  return data_block.get() != 0;
+}
+
+bool LargeVolumeDiskCache::put_brick( LargeVolumeSchema::brick_key_type key, DataBlockHandle data_block )
+{
+  size_t byte_size = data_block->get_byte_size();
+  char* address = 0;
+  {
+    boost::mutex::scoped_lock lock( this->private_->mutex_ );
+    if ( this->private_->chunks_.empty() ) return false;
+
+    LargeVolumeDiskCachePrivate::entry_map_type::iterator it = 
+      this->private_->entries_.find( key );
+    if ( it != this->private_->entries_.end() )
+    {
+      // Bricks are read-only, hence the copy in the cache is still valid
+      LargeVolumeDiskCachePrivate::access_list_type& access_list = 
+        this->private_->size_classes_[ it->second.size_class_ ].access_list_;
+      access_list.splice( access_list.begin(), access_list, it->second.access_record_ );
+      return true;
+    }
+
+    int size_class = this->private_->find_size_class( byte_size );
+    long long offset;
+    if ( size_class < 0 || !this->private_->allocate_slot( size_class, offset ) ) return false;
+
+    LargeVolumeDiskCachePrivate::Entry& entry = this->private_->entries_[ key ];
+    entry.size_class_ = size_class;
+    entry.offset_ = offset;
+    entry.nx_ = data_block->get_nx();
+    entry.ny_ = data_block->get_ny();
+    entry.nz_ = data_block->get_nz();
+    entry.data_type_ = data_block->get_data_type();
+    entry.byte_size_ = byte_size;
+    entry.readers_ = 0;
+    entry.ready_ = false;
+
+    LargeVolumeDiskCachePrivate::access_list_type& access_list = 
+      this->private_->size_classes_[ size_class ].access_list_;
+    access_list.push_front( key );
+    entry.access_record_ = access_list.begin();
+
+    this->private_->num_pinned_++;
+    address = this->private_->get_address( offset );
+  }
+
+  std::memcpy( address, data_block->get_data(), byte_size );
+
+  boost::mutex::scoped_lock lock( this->private_->mutex_ );
+  this->private_->entries_[ key ].ready_ = true;
+  this->private_->size_ += byte_size;
+  this->private_->unpin();
+
+  return true;
+}
+
+bool LargeVolumeDiskCache::is_open() const
+{
+  boost::mutex::scoped_lock lock( this->private_->mutex_ );
+  return !this->private_->chunks_.empty();
+}
+
+long long LargeVolumeDiskCache::get_capacity() const
+{
+  boost::mutex::scoped_lock lock( this->private_->mutex_ );
+  return this->private_->capacity_;
+}
+
+long long LargeVolumeDiskCache::get_size() const
+{
+  boost::mutex::scoped_lock lock( this->private_->mutex_ );
+  return this->private_->size_;
+}
+
+} // end namespace Core
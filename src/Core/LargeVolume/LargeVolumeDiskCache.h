@@ -0,0 +1,114 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef CORE_LARGEVOLUME_LARGEVOLUMEDISKCACHE_H
+#define CORE_LARGEVOLUME_LARGEVOLUMEDISKCACHE_H
+
+// Boost includes
+#include <boost/shared_ptr.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/filesystem/path.hpp>
+
+#include <Core/DataBlock/DataBlock.h>
+#include <Core/LargeVolume/LargeVolumeSchema.h>
+
+namespace Core
+{
+
+class LargeVolumeDiskCache;
+typedef boost::shared_ptr< LargeVolumeDiskCache > LargeVolumeDiskCacheHandle;
+
+class LargeVolumeDiskCachePrivate;
+typedef boost::shared_ptr< LargeVolumeDiskCachePrivate > LargeVolumeDiskCachePrivateHandle;
+
+// CLASS LARGEVOLUMEDISKCACHE:
+/// Second tier of the large volume cache. Decompressed bricks that are evicted from memory are
+/// stored in one memory mapped scratch file of a fixed size, ideally on a local SSD, so that a
+/// revisit only costs a page-in instead of a read from the volume directory plus decompression.
+///
+/// The file is divided into chunks that are assigned on demand to a size class. Each size class
+/// cuts its chunks into slots of a power of two size and keeps its own LRU list. When a class
+/// runs out of slots, its least recently used brick is evicted, or, if it does not own any
+/// slots yet, a chunk is taken over from the class that owns most chunks.
+/// NOTE: The index is kept in memory only, the cache file is scratch space that is removed
+/// when the cache is closed.
+
+class LargeVolumeDiskCache : public boost::noncopyable
+{
+  // -- constructor/destructor --
+public:
+  LargeVolumeDiskCache();
+  ~LargeVolumeDiskCache();
+
+public:
+  // OPEN:
+  /// Create a cache file of capacity bytes in the given directory.
+  bool open( const boost::filesystem::path& dir, long long capacity, std::string& error );
+
+  // CLOSE:
+  /// Drop all the bricks and remove the cache file.
+  void close();
+
+  // CLEAR:
+  /// Drop all the bricks, but keep the cache file.
+  void clear();
+
+  // HAS_BRICK:
+  /// Check whether a brick is stored in the cache and mark it as recently used.
+  bool has_brick( LargeVolumeSchema::brick_key_type key );
+
+  // GET_BRICK:
+  /// Copy a brick from the cache into a new data block.
+  bool get_brick( LargeVolumeSchema::brick_key_type key, DataBlockHandle& data_block );
+
+  // PUT_BRICK:
+  /// Store a brick in the cache, evicting older bricks if needed. Returns false if the brick
+  /// could not be stored.
+  bool put_brick( LargeVolumeSchema::brick_key_type key, DataBlockHandle data_block );
+
+  // -- information --
+public:
+  // IS_OPEN:
+  /// Whether a cache file is in use.
+  bool is_open() const;
+
+  // GET_CAPACITY:
+  /// The size of the cache file in bytes.
+  long long get_capacity() const;
+
+  // GET_SIZE:
+  /// The number of bytes used by bricks that are stored in the cache.
+  long long get_size() const;
+
+private:
+  LargeVolumeDiskCachePrivateHandle private_;
+};
+
+} // end namespace Core
+
+#endif
@@ -0,0 +1,573 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+#include <cstring>
+#include <fstream>
+
+#include <boost/thread.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/filesystem.hpp>
+
+#include <Core/Utils/MappedFile.h>
+#include <Core/Utils/StringUtil.h>
+#include <Core/LargeVolume/LargeVolumePack.h>
+
+namespace bfs=boost::filesystem;
+
+namespace Core
+{
+
+// Identifies the index file and its version
+static const char PACK_INDEX_MAGIC_C[ 8 ] = { 'S', '3', 'D', 'P', 'A', 'C', 'K', '1' };
+
+// Start a new pack file once the current one exceeds this size, so that the pack files can
+// still be stored on file systems with a file size limit
+static const long long PACK_FILE_SIZE_LIMIT_C = static_cast<long long>( 4 ) << 30;
+
+// The index is stored in little endian byte order, independent of the platform
+static void WriteUInt64( std::vector<char>& buffer, boost::uint64_t value )
+{
+  for ( size_t j = 0; j < 8; j++ )
+  {
+    buffer.push_back( static_cast<char>( ( value >> ( 8 * j ) ) & 0xff ) );
+  }
+}
+
+static boost::uint64_t ReadUInt64( const char* data )
+{
+  boost::uint64_t value = 0;
+  for ( size_t j = 0; j < 8; j++ )
+  {
+    value |= static_cast<boost::uint64_t>( static_cast<unsigned char>( data[ j ] ) ) << ( 8 * j );
+  }
+  return value;
+}
+
+class LargeVolumePackPrivate
+{
+public:
+  struct Entry
+  {
+    Entry() : file_( 0 ), offset_( 0 ), length_( 0 ) {}
+
+    boost::uint64_t file_;
+    boost::uint64_t offset_;
+    // A length of zero indicates that the brick is not stored in the pack
+    boost::uint64_t length_;
+  };
+
+  struct PackFile
+  {
+    // Used when the file is memory mapped
+    MappedFileHandle mapping_;
+
+    // Used when the file could not be mapped
+    boost::shared_ptr<std::ifstream> stream_;
+    boost::shared_ptr<boost::mutex> stream_mutex_;
+  };
+
+public:
+  LargeVolumePackPrivate() :
+    writing_( false ),
+    current_file_num_( 0 ),
+    current_file_size_( 0 )
+  {
+  }
+
+  bool find_entry( const BrickInfo& bi, size_t& entry_index ) const;
+  void set_levels( const std::vector<size_t>& level_num_bricks );
+  bool open_pack_file( size_t num, std::string& error );
+  bool open_new_pack_file( std::string& error );
+
+  // Index file, the caller needs to hold the write lock when writing
+  bool read_index( size_t& num_pack_files, std::string& error );
+  bool write_index( std::string& error );
+
+  bfs::path dir_;
+
+  // Index of the bricks, ordered by level and then brick index
+  std::vector<Entry> entries_;
+  std::vector<size_t> level_start_;
+  std::vector<size_t> level_num_bricks_;
+
+  // -- writing --
+  boost::mutex write_mutex_;
+  bool writing_;
+  std::ofstream current_file_;
+  size_t current_file_num_;
+  long long current_file_size_;
+
+  // -- reading --
+  std::vector<PackFile> pack_files_;
+};
+
+bool LargeVolumePackPrivate::find_entry( const BrickInfo& bi, size_t& entry_index ) const
+{
+  if ( bi.level_ < 0 || bi.index_ < 0 ) return false;
+
+  size_t level = static_cast<size_t>( bi.level_ );
+  size_t index = static_cast<size_t>( bi.index_ );
+  if ( level >= this->level_start_.size() || index >= this->level_num_bricks_[ level ] )
+  {
+    return false;
+  }
+  entry_index = this->level_start_[ level ] + index;
+  return true;
+}
+
+void LargeVolumePackPrivate::set_levels( const std::vector<size_t>& level_num_bricks )
+{
+  this->level_num_bricks_ = level_num_bricks;
+  this->level_start_.resize( level_num_bricks.size() );
+
+  size_t num_entries = 0;
+  for ( size_t j = 0; j < level_num_bricks.size(); j++ )
+  {
+    this->level_start_[ j ] = num_entries;
+    num_entries += level_num_bricks[ j ];
+  }
+
+  this->entries_.clear();
+  this->entries_.resize( num_entries );
+}
+
+bool LargeVolumePackPrivate::open_pack_file( size_t num, std::string& error )
+{
+  bfs::path filename = LargeVolumePack::GetPackFileName( this->dir_, num );
+  if ( !bfs::exists( filename ) )
+  {
+    error = "Could not find pack file '" + filename.string() + "'.";
+    return false;
+  }
+
+  PackFile pack_file;
+
+  // Empty files cannot be mapped, but do not contain any bricks either
+  if ( bfs::file_size( filename ) > 0 )
+  {
+    std::string map_error;
+    pack_file.mapping_.reset( new MappedFile );
+    if ( !pack_file.mapping_->open( filename, MappedFile::READ_ONLY_E, map_error ) )
+    {
+      pack_file.mapping_.reset();
+      pack_file.stream_.reset( new std::ifstream( filename.string().c_str(), 
+        std::ios_base::in | std::ios_base::binary ) );
+      if ( !( *pack_file.stream_ ) )
+      {
+        error = "Could not open pack file '" + filename.string() + "'.";
+        return false;
+      }
+      pack_file.stream_mutex_.reset( new boost::mutex );
+    }
+  }
+
+  this->pack_files_.push_back( pack_file );
+  return true;
+}
+
+bool LargeVolumePackPrivate::open_new_pack_file( std::string& error )
+{
+  bfs::path filename = LargeVolumePack::GetPackFileName( this->dir_, this->current_file_num_ );
+  this->current_file_.open( filename.string().c_str(), 
+    std::ios_base::trunc | std::ios_base::binary | std::ios_base::out );
+  if ( !this->current_file_ )
+  {
+    error = "Could not create pack file '" + filename.string() + "'.";
+    return false;
+  }
+
+  this->current_file_size_ = 0;
+  return true;
+}
+
+bool LargeVolumePackPrivate::read_index( size_t& num_pack_files, std::string& error )
+{
+  bfs::path filename = LargeVolumePack::GetIndexFileName( this->dir_ );
+  if ( !bfs::exists( filename ) )
+  {
+    error = "Could not find index file '" + filename.string() + "'.";
+    return false;
+  }
+
+  std::vector<char> buffer;
+  try
+  {
+    buffer.resize( static_cast<size_t>( bfs::file_size( filename ) ) );
+    std::ifstream index_file( filename.string().c_str(), std::ios_base::in | std::ios_base::binary );
+    if ( !buffer.empty() ) index_file.read( &buffer[ 0 ], buffer.size() );
+    if ( !index_file )
+    {
+      error = "Could not read index file '" + filename.string() + "'.";
+      return false;
+    }
+  }
+  catch ( ... )
+  {
+    error = "Could not read index file '" + filename.string() + "'.";
+    return false;
+  }
+
+  const std::string corrupt_error = "Index file '" + filename.string() + "' is corrupt.";
+  if ( buffer.size() < 24 || std::memcmp( &buffer[ 0 ], PACK_INDEX_MAGIC_C, 8 ) != 0 )
+  {
+    error = corrupt_error;
+    return false;
+  }
+
+  num_pack_files = static_cast<size_t>( ReadUInt64( &buffer[ 8 ] ) );
+  size_t num_levels = static_cast<size_t>( ReadUInt64( &buffer[ 16 ] ) );
+  size_t pos = 24;
+
+  if ( buffer.size() < pos + 8 * num_levels )
+  {
+    error = corrupt_error;
+    return false;
+  }
+
+  std::vector<size_t> level_num_bricks( num_levels );
+  for ( size_t j = 0; j < num_levels; j++, pos += 8 )
+  {
+    level_num_bricks[ j ] = static_cast<size_t>( ReadUInt64( &buffer[ pos ] ) );
+  }
+  this->set_levels( level_num_bricks );
+
+  if ( ( buffer.size() - pos ) / 24 != this->entries_.size() )
+  {
+    error = corrupt_error;
+    return false;
+  }
+
+  for ( size_t j = 0; j < this->entries_.size(); j++, pos += 24 )
+  {
+    Entry& entry = this->entries_[ j ];
+    entry.file_ = ReadUInt64( &buffer[ pos ] );
+    entry.offset_ = ReadUInt64( &buffer[ pos + 8 ] );
+    entry.length_ = ReadUInt64( &buffer[ pos + 16 ] );
+
+    if ( entry.length_ > 0 && entry.file_ >= num_pack_files )
+    {
+      error = corrupt_error;
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool LargeVolumePackPrivate::write_index( std::string& error )
+{
+  // The index may only refer to data that is on disk
+  this->current_file_.flush();
+  if ( !this->current_file_ )
+  {
+    error = "Could not write to pack file.";
+    return false;
+  }
+
+  std::vector<char> buffer( PACK_INDEX_MAGIC_C, PACK_INDEX_MAGIC_C + 8 );
+  WriteUInt64( buffer, this->current_file_num_ + 1 );
+  WriteUInt64( buffer, this->level_num_bricks_.size() );
+  for ( size_t j = 0; j < this->level_num_bricks_.size(); j++ )
+  {
+    WriteUInt64( buffer, this->level_num_bricks_[ j ] );
+  }
+
+  for ( size_t j = 0; j < this->entries_.size(); j++ )
+  {
+    const Entry& entry = this->entries_[ j ];
+    WriteUInt64( buffer, entry.file_ );
+    WriteUInt64( buffer, entry.offset_ );
+    WriteUInt64( buffer, entry.length_ );
+  }
+
+  // Replace the index in one step, so an interruption leaves either the old or the new index
+  bfs::path filename = LargeVolumePack::GetIndexFileName( this->dir_ );
+  bfs::path temp_filename = filename.string() + ".tmp";
+  {
+    std::ofstream index_file( temp_filename.string().c_str(), 
+      std::ios_base::trunc | std::ios_base::binary | std::ios_base::out );
+    index_file.write( &buffer[ 0 ], buffer.size() );
+    if ( !index_file )
+    {
+      error = "Could not write index file '" + filename.string() + "'.";
+      return false;
+    }
+  }
+
+  boost::system::error_code ec;
+  bfs::rename( temp_filename, filename, ec );
+  if ( ec )
+  {
+    error = "Could not write index file '" + filename.string() + "'.";
+    return false;
+  }
+
+  return true;
+}
+
+LargeVolumePack::LargeVolumePack() :
+  private_( new LargeVolumePackPrivate )
+{
+}
+
+LargeVolumePack::~LargeVolumePack()
+{
+  this->close();
+}
+
+bool LargeVolumePack::create( const bfs::path& dir, const std::vector<size_t>& level_num_bricks,
+  std::string& error )
+{
+  this->close();
+
+  this->private_->dir_ = dir;
+  this->private_->set_levels( level_num_bricks );
+
+  this->private_->current_file_num_ = 0;
+  if ( !this->private_->open_new_pack_file( error ) )
+  {
+    return false;
+  }
+
+  this->private_->writing_ = true;
+  return true;
+}
+
+bool LargeVolumePack::append_brick( const BrickInfo& bi, const char* data, size_t length, 
+  std::string& error )
+{
+  boost::mutex::scoped_lock lock( this->private_->write_mutex_ );
+
+  if ( !this->private_->writing_ )
+  {
+    error = "Pack is not opened for writing.";
+    return false;
+  }
+
+  size_t entry_index;
+  if ( !this->private_->find_entry( bi, entry_index ) )
+  {
+    error = "Brick is not part of the pack.";
+    return false;
+  }
+  LargeVolumePackPrivate::Entry& entry = this->private_->entries_[ entry_index ];
+
+  // Move on to the next pack file if this brick does not fit in the current one anymore
+  if ( this->private_->current_file_size_ > 0 && 
+    this->private_->current_file_size_ + static_cast<long long>( length ) > PACK_FILE_SIZE_LIMIT_C )
+  {
+    this->private_->current_file_.close();
+    this->private_->current_file_num_++;
+    if ( !this->private_->open_new_pack_file( error ) )
+    {
+      return false;
+    }
+  }
+
+  this->private_->current_file_.write( data, length );
+  if ( !this->private_->current_file_ )
+  {
+    error = "Could not write to pack file.";
+    return false;
+  }
+
+  entry.file_ = this->private_->current_file_num_;
+  entry.offset_ = this->private_->current_file_size_;
+  entry.length_ = length;
+  this->private_->current_file_size_ += length;
+
+  return true;
+}
+
+bool LargeVolumePack::checkpoint( std::string& error )
+{
+  boost::mutex::scoped_lock lock( this->private_->write_mutex_ );
+
+  if ( !this->private_->writing_ )
+  {
+    error = "Pack is not opened for writing.";
+    return false;
+  }
+
+  return this->private_->write_index( error );
+}
+
+bool LargeVolumePack::resume( const bfs::path& dir, const std::vector<size_t>& level_num_bricks,
+  std::string& error )
+{
+  this->close();
+  this->private_->dir_ = dir;
+
+  size_t num_pack_files = 0;
+  if ( !this->private_->read_index( num_pack_files, error ) )
+  {
+    return false;
+  }
+
+  if ( this->private_->level_num_bricks_ != level_num_bricks )
+  {
+    error = "Index file '" + GetIndexFileName( dir ).string() + "' does not match the volume.";
+    return false;
+  }
+
+  // Continue in a new file, so the data referenced by the index is never overwritten
+  this->private_->current_file_num_ = num_pack_files;
+  if ( !this->private_->open_new_pack_file( error ) )
+  {
+    return false;
+  }
+
+  this->private_->writing_ = true;
+  return true;
+}
+
+bool LargeVolumePack::finish( std::string& error )
+{
+  boost::mutex::scoped_lock lock( this->private_->write_mutex_ );
+
+  if ( !this->private_->writing_ )
+  {
+    error = "Pack is not opened for writing.";
+    return false;
+  }
+
+  bool success = this->private_->write_index( error );
+  this->private_->current_file_.close();
+  this->private_->writing_ = false;
+
+  return success;
+}
+
+bool LargeVolumePack::open( const bfs::path& dir, std::string& error )
+{
+  this->close();
+  this->private_->dir_ = dir;
+
+  size_t num_pack_files = 0;
+  if ( !this->private_->read_index( num_pack_files, error ) )
+  {
+    return false;
+  }
+
+  for ( size_t j = 0; j < num_pack_files; j++ )
+  {
+    if ( !this->private_->open_pack_file( j, error ) )
+    {
+      this->close();
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool LargeVolumePack::has_brick( const BrickInfo& bi ) const
+{
+  size_t entry_index;
+  if ( !this->private_->find_entry( bi, entry_index ) ) return false;
+
+  const LargeVolumePackPrivate::Entry& entry = this->private_->entries_[ entry_index ];
+  return entry.length_ > 0 && entry.file_ < this->private_->pack_files_.size();
+}
+
+bool LargeVolumePack::get_brick_data( const BrickInfo& bi, std::vector<char>& buffer, 
+  const char*& data, size_t& length, std::string& error ) const
+{
+  if ( !this->has_brick( bi ) )
+  {
+    error = "Brick is not stored in the pack.";
+    return false;
+  }
+
+  size_t entry_index;
+  this->private_->find_entry( bi, entry_index );
+  const LargeVolumePackPrivate::Entry* entry = &this->private_->entries_[ entry_index ];
+
+  const LargeVolumePackPrivate::PackFile& pack_file = this->private_->pack_files_[ entry->file_ ];
+  length = static_cast<size_t>( entry->length_ );
+
+  if ( pack_file.mapping_ )
+  {
+    if ( entry->offset_ + entry->length_ > pack_file.mapping_->get_size() )
+    {
+      error = "Brick is located beyond the end of the pack file.";
+      return false;
+    }
+    data = pack_file.mapping_->get_data() + entry->offset_;
+    return true;
+  }
+
+  if ( !pack_file.stream_ )
+  {
+    error = "Brick is located beyond the end of the pack file.";
+    return false;
+  }
+
+  buffer.resize( length );
+  {
+    boost::mutex::scoped_lock lock( *pack_file.stream_mutex_ );
+    pack_file.stream_->clear();
+    pack_file.stream_->seekg( static_cast<std::streamoff>( entry->offset_ ), std::ios_base::beg );
+    pack_file.stream_->read( &buffer[ 0 ], length );
+    if ( !( *pack_file.stream_ ) )
+    {
+      error = "Could not read brick from pack file.";
+      return false;
+    }
+  }
+
+  data = &buffer[ 0 ];
+  return true;
+}
+
+void LargeVolumePack::close()
+{
+  boost::mutex::scoped_lock lock( this->private_->write_mutex_ );
+
+  if ( this->private_->writing_ )
+  {
+    this->private_->current_file_.close();
+    this->private_->writing_ = false;
+  }
+
+  this->private_->pack_files_.clear();
+  this->private_->entries_.clear();
+  this->private_->level_start_.clear();
+  this->private_->level_num_bricks_.clear();
+}
+
+bfs::path LargeVolumePack::GetIndexFileName( const bfs::path& dir )
+{
+  return dir / "bricks.idx";
+}
+
+bfs::path LargeVolumePack::GetPackFileName( const bfs::path& dir, size_t num )
+{
+  return dir / ( "bricks" + ExportToString( num ) + ".pack" );
+}
+
+} // end namespace Core
@@ -0,0 +1,132 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+#ifndef CORE_LARGEVOLUME_LARGEVOLUMEPACK_H
+#define CORE_LARGEVOLUME_LARGEVOLUMEPACK_H
+
+// STL includes
+#include <string>
+#include <vector>
+
+// Boost includes
+#include <boost/shared_ptr.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/filesystem/path.hpp>
+
+#include <Core/LargeVolume/LargeVolumeSchema.h>
+
+namespace Core
+{
+
+class LargeVolumePack;
+typedef boost::shared_ptr< LargeVolumePack > LargeVolumePackHandle;
+
+class LargeVolumePackPrivate;
+typedef boost::shared_ptr< LargeVolumePackPrivate > LargeVolumePackPrivateHandle;
+
+// CLASS LARGEVOLUMEPACK:
+/// Packed layout of the bricks of a large volume. Instead of one file per brick, the (compressed)
+/// bricks are appended to a few large pack files (bricks0.pack, bricks1.pack, ...) and an index
+/// file (bricks.idx) records the pack file, offset and length of every brick. This keeps the
+/// number of files in a volume directory small, which matters a lot on network and parallel
+/// file systems.
+///
+/// For reading, the pack files are memory mapped. If a pack file cannot be mapped, e.g. due to a
+/// lack of address space, bricks are read from an open stream instead.
+
+class LargeVolumePack : public boost::noncopyable
+{
+  // -- constructor/destructor --
+public:
+  LargeVolumePack();
+  ~LargeVolumePack();
+
+  // -- writing --
+public:
+  // CREATE:
+  /// Start a new pack in the given directory. The number of bricks of each level is needed to
+  /// size the index.
+  bool create( const boost::filesystem::path& dir, const std::vector<size_t>& level_num_bricks,
+    std::string& error );
+
+  // APPEND_BRICK:
+  /// Append the data of a brick to the pack. This function can be called from multiple threads.
+  bool append_brick( const BrickInfo& bi, const char* data, size_t length, std::string& error );
+
+  // CHECKPOINT:
+  /// Flush the pack file and write the index of the bricks appended so far, so that the pack
+  /// can be resumed after an interruption.
+  bool checkpoint( std::string& error );
+
+  // RESUME:
+  /// Continue writing a pack of which a checkpoint was written. Bricks are appended to a new
+  /// pack file, data that was written after the checkpoint is not referenced anymore.
+  bool resume( const boost::filesystem::path& dir, const std::vector<size_t>& level_num_bricks,
+    std::string& error );
+
+  // FINISH:
+  /// Write the index to disk and close the pack files.
+  bool finish( std::string& error );
+
+  // -- reading --
+public:
+  // OPEN:
+  /// Open an existing pack for reading.
+  bool open( const boost::filesystem::path& dir, std::string& error );
+
+  // HAS_BRICK:
+  /// Check whether the pack contains data for a brick.
+  bool has_brick( const BrickInfo& bi ) const;
+
+  // GET_BRICK_DATA:
+  /// Get the stored bytes of a brick. Data points either into the mapped pack file or into
+  /// buffer, and remains valid as long as the pack is open and buffer is not changed.
+  /// This function can be called from multiple threads.
+  bool get_brick_data( const BrickInfo& bi, std::vector<char>& buffer, const char*& data,
+    size_t& length, std::string& error ) const;
+
+  // CLOSE:
+  /// Close the pack files.
+  void close();
+
+  // -- file names --
+public:
+  // GETINDEXFILENAME:
+  /// The name of the index file of a pack.
+  static boost::filesystem::path GetIndexFileName( const boost::filesystem::path& dir );
+
+  // GETPACKFILENAME:
+  /// The name of a pack file.
+  static boost::filesystem::path GetPackFileName( const boost::filesystem::path& dir, size_t num );
+
+private:
+  LargeVolumePackPrivateHandle private_;
+};
+
+} // end namespace Core
+
+#endif
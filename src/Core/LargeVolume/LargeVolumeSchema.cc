@@ -28,22 +28,30 @@
 
 #include <zlib.h>
 
+#include <ctime>
+#include <cstring>
 #include <limits>
 #include <fstream>
+#include <map>
 #include <set>
 #include <queue>
 
+#include <boost/thread/mutex.hpp>
+
 // test
 #include <iostream>
 // test
 
 #include <Core/Utils/FilesystemUtil.h>
+#include <Core/Utils/Log.h>
 #include <Core/Utils/StringUtil.h>
 #include <Core/Math/MathFunctions.h>
 #include <Core/DataBlock/StdDataBlock.h>
 
 #include <Core/LargeVolume/LargeVolumeSchema.h>
 #include <Core/LargeVolume/LargeVolumeCache.h>
+#include <Core/LargeVolume/LargeVolumePack.h>
+#include <Core/LargeVolume/LargeVolumeCodec.h>
 
 namespace bfs=boost::filesystem;
 
@@ -81,7 +89,12 @@ public:
     downsample_y_( true ),
     downsample_z_( true ),
     min_( 0.0 ),
-    max_( 0.0 )
+    max_( 0.0 ),
+    brick_headers_( false ),
+    codec_( BrickCodec::ZLIB_E ),
+    filter_( BrickFilter::NONE_E ),
+    packed_( false ),
+    packing_( false )
   {
   }
 
@@ -183,6 +196,18 @@ public:
   void load_and_substitue_missing_bricks( std::vector<BrickInfo>& want_to_render, SliceType slice, 
     double depth, const std::string& load_key, std::vector<BrickInfo>& current_render );
 
+  /// DECODE_BRICK
+  /// Fill in a brick from the bytes stored on disk, which are compressed if they are
+  /// smaller than the brick
+  bool decode_brick( const char* data, size_t length, DataBlockHandle brick,
+    const std::string& name, std::string& error ) const;
+
+  /// ENCODE_BRICK
+  /// Get the bytes that are stored on disk for a brick. Data points either to the brick
+  /// itself or to the compressed data in buffer.
+  bool encode_brick( DataBlockHandle brick, std::vector<char>& buffer, const char*& data,
+    size_t& length, std::string& error ) const;
+
   // -- contents in the text header --
 public:
   IndexVector size_;
@@ -210,7 +235,19 @@ public:
 
   double min_;
   double max_;
+
+  // Whether each brick starts with a header describing its encoding (see LargeVolumeCodec).
+  // Older volumes store zlib compressed or raw bricks without a header.
+  bool brick_headers_;
+  BrickCodec codec_;
+  BrickFilter filter_;
   
+  // Whether the bricks are stored in pack files instead of one file per brick
+  bool packed_;
+  // Whether bricks that are written are appended to the pack
+  bool packing_;
+  LargeVolumePackHandle pack_;
+
   bfs::path dir_;
   LargeVolumeSchema* schema_;
 };
@@ -321,13 +358,158 @@ bool LargeVolumeSchemaPrivate::insert_brick_internals( DataBlockHandle volume, D
   return true;
 }
 
+bool LargeVolumeSchemaPrivate::decode_brick( const char* data, size_t length, DataBlockHandle brick,
+  const std::string& name, std::string& error ) const
+{
+  size_t brick_size = brick->get_byte_size();
+
+  // Raw bricks, as written during conversion, have exactly the size of the brick. Encoded
+  // bricks never have that size.
+  if ( length == brick_size )
+  {
+    std::memcpy( brick->get_data(), data, brick_size );
+    return true;
+  }
+
+  if ( this->brick_headers_ )
+  {
+    if ( !LargeVolumeCodec::DecodeBrick( data, length, reinterpret_cast<char*>( brick->get_data() ),
+      brick_size, this->data_type_, this->little_endian_, error ) )
+    {
+      error = "Could not decode brick '" + name + "': " + error;
+      brick->clear();
+      return false;
+    }
+    return true;
+  }
+
+  if ( length > brick_size )
+  {
+    error = "Brick '" + name + "' is too large to be a brick.";
+    brick->clear();
+    return false;
+  }
+
+  zlib_uLongf brick_size_ul = brick_size;
+  if ( zlib_uncompress( reinterpret_cast<zlib_Bytef*>( brick->get_data() ), &brick_size_ul,
+    reinterpret_cast<const zlib_Bytef*>( data ), length ) != Z_OK)
+  {
+    error = "Could not decompress brick '" + name + "'.";
+    brick->clear();
+    return false;
+  }
+
+  if ( brick_size_ul != brick_size )
+  {
+    error = "Brick '" + name + "' contains invalid data.";
+    brick->clear();
+    return false;     
+  }
+
+  return true;
+}
+
+bool LargeVolumeSchemaPrivate::encode_brick( DataBlockHandle brick, std::vector<char>& buffer, 
+  const char*& data, size_t& length, std::string& error ) const
+{
+  size_t brick_size = brick->get_byte_size();
+
+  if ( this->brick_headers_ )
+  {
+    if ( !LargeVolumeCodec::EncodeBrick( reinterpret_cast<const char*>( brick->get_data() ), 
+      brick_size, this->data_type_, this->little_endian_, this->codec_, this->filter_, buffer, error ) )
+    {
+      return false;
+    }
+    data = &buffer[0];
+    length = buffer.size();
+    return true;
+  }
+
+  // Bricks that do not compress are stored as is
+  data = reinterpret_cast<const char*>( brick->get_data() );
+  length = brick_size;
+
+  if ( this->compression_ ) 
+  {
+    buffer.resize( brick_size + 12 );
+    zlib_uLongf brick_size_ul = brick_size + 12;
+
+    int result = zlib_compress2( reinterpret_cast<zlib_Bytef*>( &buffer[0] ), &brick_size_ul,
+      reinterpret_cast<zlib_Bytef*>( brick->get_data() ), brick_size, Z_DEFAULT_COMPRESSION );
+    if ( result != Z_OK )
+    {
+      error = "Could not compress file.";
+      return false;
+    }
+  
+    if ( brick_size_ul < brick_size )
+    {
+      data = &buffer[0];
+      length = brick_size_ul;
+    }
+  }
+
+  return true;
+}
+
+// Ids of the volumes that were loaded, by directory, size and modification time. A volume that
+// is opened again gets the id it had before, so its bricks are still found in the caches, and ids
+// are only used up by distinct volumes. A volume that was converted again in the same place gets
+// a new id, so stale bricks of the old version are not used. Id zero is used by schemas that have
+// not been loaded.
+static boost::mutex LargeVolumeSchemaIdMutex;
+static std::map< std::string, unsigned int > LargeVolumeSchemaIds;
+
+static std::string GetLastWriteTime( const bfs::path& filename )
+{
+  boost::system::error_code ec;
+  std::time_t write_time = bfs::last_write_time( filename, ec );
+  if ( ec ) return "";
+  return ExportToString( static_cast<long long>( write_time ) );
+}
+
+static unsigned int GetLargeVolumeSchemaId( const bfs::path& dir, const IndexVector& size,
+  const IndexVector& brick_size, const bfs::path& volume_file, bool packed )
+{
+  boost::system::error_code ec;
+  bfs::path canonical_dir = bfs::canonical( dir, ec );
+  if ( ec ) canonical_dir = bfs::absolute( dir );
+
+  // Converting writes the volume file last and packing rewrites the index, hence their times
+  // change whenever the bricks do
+  std::string identity = canonical_dir.string() + "|" + ExportToString( size ) + "|" + 
+    ExportToString( brick_size ) + "|" + GetLastWriteTime( volume_file );
+  if ( packed ) identity += "|" + GetLastWriteTime( LargeVolumePack::GetIndexFileName( dir ) );
+
+  boost::mutex::scoped_lock lock( LargeVolumeSchemaIdMutex );
+  std::map< std::string, unsigned int >::iterator it = LargeVolumeSchemaIds.find( identity );
+  if ( it != LargeVolumeSchemaIds.end() ) return it->second;
+
+  unsigned int id = static_cast<unsigned int>( LargeVolumeSchemaIds.size() + 1 );
+  if ( id > 0xffff )
+  {
+    // The brick keys only hold 16 bits of the id
+    CORE_LOG_ERROR( "Too many large volumes were opened, bricks of '" + 
+      canonical_dir.string() + "' may not be cached correctly." );
+  }
+  LargeVolumeSchemaIds[ identity ] = id;
+  return id;
+}
+
 LargeVolumeSchema::LargeVolumeSchema() :
   private_(new LargeVolumeSchemaPrivate),
-  VOLUME_FILE_NAME_("volume.txt")
+  VOLUME_FILE_NAME_("volume.txt"),
+  id_( 0 )
 {
   this->private_->schema_ = this;
 }
 
+unsigned int LargeVolumeSchema::get_id() const
+{
+  return this->id_;
+}
+
 
 bool LargeVolumeSchema::load( std::string& error)
 {
@@ -489,6 +671,7 @@ bool LargeVolumeSchema::load( std::string& error)
     }
 
     size_t level = 0;
+    this->private_->levels_.clear();
     
     while ( values.find( "level" + ExportToString(level)) != values.end() )
     {
@@ -507,6 +690,50 @@ bool LargeVolumeSchema::load( std::string& error)
     }
     
     this->private_->compute_cached_level_info();
+
+    // Volumes without a codec field store zlib compressed bricks without a header
+    this->private_->brick_headers_ = false;
+    if ( values.find( "codec" ) != values.end() )
+    {
+      if ( !ImportFromString( values[ "codec" ], this->private_->codec_ ) )
+      {
+        error = "Unknown codec '" + values[ "codec" ] + "'.";
+        return false;
+      }
+      this->private_->brick_headers_ = true;
+      this->private_->compression_ = ( this->private_->codec_ != BrickCodec::NONE_E );
+    }
+
+    if ( values.find( "filter" ) != values.end() && 
+      !ImportFromString( values[ "filter" ], this->private_->filter_ ) )
+    {
+      error = "Unknown filter '" + values[ "filter" ] + "'.";
+      return false;
+    }
+
+    // Volumes without a layout field store each brick in a separate file
+    this->private_->packed_ = false;
+    this->private_->pack_.reset();
+
+    if ( values.find( "layout" ) != values.end() && values[ "layout" ] != "files" )
+    {
+      if ( values[ "layout" ] != "packed" )
+      {
+        error = "Unknown brick layout '" + values[ "layout" ] + "'.";
+        return false;
+      }
+
+      this->private_->pack_.reset( new LargeVolumePack );
+      if ( !this->private_->pack_->open( this->private_->dir_, error ) )
+      {
+        this->private_->pack_.reset();
+        return false;
+      }
+      this->private_->packed_ = true;
+    }
+
+    this->id_ = GetLargeVolumeSchemaId( this->private_->dir_, this->private_->size_, 
+      this->private_->brick_size_, filename, this->private_->packed_ );
   }
   catch (...)
   {
@@ -541,6 +768,12 @@ bool LargeVolumeSchema::save( std::string& error ) const
     text_file << "endian: " << ( this->private_->little_endian_ ? "little" : "big" ) << std::endl;
     text_file << "min: " << ExportToString( this->private_->min_ ) << std::endl;
     text_file << "max: " << ExportToString( this->private_->max_ ) << std::endl;
+    text_file << "layout: " << ( this->private_->packed_ ? "packed" : "files" ) << std::endl;
+    if ( this->private_->brick_headers_ )
+    {
+      text_file << "codec: " << ExportToString( this->private_->codec_ ) << std::endl;
+      text_file << "filter: " << ExportToString( this->private_->filter_ ) << std::endl;
+    }
     
     for (size_t j = 0 ; j < this->private_->levels_.size(); j++ )
     {    
@@ -699,16 +932,40 @@ void LargeVolumeSchema::set_parameters( const IndexVector& size, const Vector& s
   this->private_->effective_brick_size_.z( brick_size.z() - 2 * overlap );
 }
 
+void LargeVolumeSchema::set_size( const IndexVector& size )
+{
+  this->private_->size_ = size;
+}
+
 void LargeVolumeSchema::set_compression( bool compression )
 {
   this->private_->compression_ = compression;
 }
 
+void LargeVolumeSchema::set_codec( BrickCodec codec, BrickFilter filter )
+{
+  this->private_->brick_headers_ = true;
+  this->private_->codec_ = codec;
+  this->private_->filter_ = filter;
+  this->private_->compression_ = ( codec != BrickCodec::NONE_E );
+}
+
+BrickCodec LargeVolumeSchema::get_codec() const
+{
+  return this->private_->codec_;
+}
+
+BrickFilter LargeVolumeSchema::get_filter() const
+{
+  return this->private_->filter_;
+}
+
 void LargeVolumeSchema::compute_levels()
 {
   // Insert level 0:
   int cur_level = 0;
   IndexVector ratio( 1, 1, 1);
+  this->private_->levels_.clear();
   this->private_->levels_.push_back( ratio );
 
   if ( !this->private_->downsample_x_ && !this->private_->downsample_y_ &&
@@ -784,69 +1041,74 @@ bool LargeVolumeSchema::read_brick( DataBlockHandle& brick, const BrickInfo& bi,
     return false;
   }
 
-  bfs::path brick_file = this->private_->get_brick_file_name( bi );
-
-  if ( !bfs::exists(brick_file ) )
+  if ( this->private_->packed_ )
   {
-    error = "Could not open brick.";
-    return false; 
-  }
-
-  size_t file_size = bfs::file_size( brick_file );
-  size_t brick_size = size[0] * size[1] * size[2] * GetSizeDataType( this->get_data_type() );
+    std::vector<char> buffer;
+    const char* data = 0;
+    size_t length = 0;
+    if ( !this->private_->pack_->get_brick_data( bi, buffer, data, length, error ) )
+    {
+      brick->clear();
+      return false;
+    }
 
-  if ( brick_size > file_size )
+    std::string brick_name = std::string() + static_cast<char>( 65 + static_cast<int>( bi.level_ ) ) +
+      ExportToString( bi.index_ );
+    if ( !this->private_->decode_brick( data, length, brick, brick_name, error ) )
+    {
+      return false;
+    }
+  }
+  else
   {
-    try
+    bfs::path brick_file = this->private_->get_brick_file_name( bi );
+
+    if ( !bfs::exists(brick_file ) )
     {
-      std::vector<char> buffer( file_size );
+      error = "Could not open brick.";
+      return false; 
+    }
 
-      std::ifstream input( brick_file.string().c_str(), std::ios_base::in | std::ios_base::binary );
-      input.read( &buffer[0],  file_size);
-      input.close();
+    size_t file_size = bfs::file_size( brick_file );
+    size_t brick_size = size[0] * size[1] * size[2] * GetSizeDataType( this->get_data_type() );
 
-      zlib_uLongf brick_size_ul = brick_size;
-      if ( zlib_uncompress( reinterpret_cast<zlib_Bytef*>( brick->get_data() ), &brick_size_ul,
-        reinterpret_cast<zlib_Bytef*>(&buffer[0]), file_size ) != Z_OK)
+    if ( brick_size == file_size )
+    {
+      try
       {
-        error = "Could not decompress file '" + brick_file.string() + "'.";
-        return false;
+        std::ifstream input( brick_file.string().c_str(), std::ios_base::in | std::ios_base::binary );
+        input.read( reinterpret_cast<char *>(brick->get_data()), brick_size );
+        input.close();
       }
-
-      if ( brick_size_ul != brick_size )
+      catch ( ... )
       {
-        error = "Brick '" + brick_file.string() + "' contains invalid data.";
+        error = "Error reading file '" + brick_file.string() + "'.";
         brick->clear();
-        return false;     
-      }
-    }
-    catch ( ... )
-    {
-      error = "Error reading file '" + brick_file.string() + "'.";
-      brick->clear();
-      return false;
+        return false;
+      } 
     }
-  }
-  else if ( brick_size == file_size )
-  {
-    try
+    else
     {
-      std::ifstream input( brick_file.string().c_str(), std::ios_base::in | std::ios_base::binary );
-      input.read( reinterpret_cast<char *>(brick->get_data()), brick_size );
-      input.close();
+      try
+      {
+        std::vector<char> buffer( file_size );
+
+        std::ifstream input( brick_file.string().c_str(), std::ios_base::in | std::ios_base::binary );
+        input.read( &buffer[0],  file_size);
+        input.close();
+
+        if ( !this->private_->decode_brick( &buffer[0], file_size, brick, brick_file.string(), error ) )
+        {
+          return false;
+        }
+      }
+      catch ( ... )
+      {
+        error = "Error reading file '" + brick_file.string() + "'.";
+        brick->clear();
+        return false;
+      }
     }
-    catch ( ... )
-    {
-      error = "Error reading file '" + brick_file.string() + "'.";
-      brick->clear();
-      return false;
-    } 
-  }
-  else 
-  {
-    error = "Brick file is too large to be a brick.";
-    brick->clear();
-    return false;
   }
 
   if ( DataBlock::IsLittleEndian() != this->private_->little_endian_ )
@@ -914,69 +1176,132 @@ bool LargeVolumeSchema::write_brick( DataBlockHandle data_block, const BrickInfo
     return false;
   }
 
+  std::vector<char> buffer;
+  const char* data = 0;
+  size_t length = 0;
+  if ( !this->private_->encode_brick( data_block, buffer, data, length, error ) )
+  {
+    return false;
+  }
+
+  // While packing, bricks go into the pack files instead of separate files
+  if ( this->private_->packing_ )
+  {
+    return this->private_->pack_->append_brick( bi, data, length, error );
+  }
+
   bfs::path brick_file = this->private_->get_brick_file_name( bi );
 
-  size_t brick_size = size[0] * size[1] * size[2] * GetSizeDataType( this->get_data_type() );
+  try
+  {
+    std::ofstream output( brick_file.string().c_str(), std::ios_base::trunc | std::ios_base::binary | std::ios_base::out );
+    output.write( data, length );
+  }
+  catch ( ... )
+  {
+    error = "Could not write to file '" + brick_file.string() + "'.";
+    return false;
+  }
+
+  return true;
+}
 
-  if ( this->private_->compression_) 
+bool LargeVolumeSchema::begin_packing( std::string& error )
+{
+  std::vector<size_t> level_num_bricks( this->get_num_levels() );
+  for ( size_t j = 0; j < level_num_bricks.size(); j++ )
   {
-    std::vector<char> buffer( brick_size + 12 );
-    zlib_uLongf brick_size_ul = brick_size + 12;
+    IndexVector layout = this->get_level_layout( j );
+    level_num_bricks[ j ] = layout.x() * layout.y() * layout.z();
+  }
 
-    int result = zlib_compress2( reinterpret_cast<zlib_Bytef*>( &buffer[0] ), &brick_size_ul,
-      reinterpret_cast<zlib_Bytef*>(data_block->get_data()), brick_size, Z_DEFAULT_COMPRESSION );
-    if (result != Z_OK )
-    {
-      error = "Could not compress file.";
-      return false;
-    }
-  
-    if ( brick_size_ul < brick_size )
-    {
-      // Compression succeeded
-      try
-      {
-        std::ofstream output( brick_file.string().c_str(), std::ios_base::trunc | std::ios_base::binary | std::ios_base::out );
-        output.write( &buffer[0], brick_size_ul );
-      }
-      catch ( ... )
-      {
-        error = "Could not write to file '" + brick_file.string() + "'.";
-        return false;
-      }
+  this->private_->pack_.reset( new LargeVolumePack );
+  if ( !this->private_->pack_->create( this->private_->dir_, level_num_bricks, error ) )
+  {
+    this->private_->pack_.reset();
+    return false;
+  }
 
-    } 
-    else 
-    {
-      try
-      {
-        std::ofstream output( brick_file.string().c_str(), std::ios_base::trunc | std::ios_base::binary | std::ios_base::out );
-        output.write( reinterpret_cast<char *>( data_block->get_data() ) , brick_size );
-      }
-      catch ( ... )
-      {
-        error = "Could not write to file '" + brick_file.string() + "'.";
-        return false;
-      }   
-    }
+  this->private_->packing_ = true;
+  return true;
+}
+
+bool LargeVolumeSchema::resume_packing( std::string& error )
+{
+  std::vector<size_t> level_num_bricks( this->get_num_levels() );
+  for ( size_t j = 0; j < level_num_bricks.size(); j++ )
+  {
+    IndexVector layout = this->get_level_layout( j );
+    level_num_bricks[ j ] = layout.x() * layout.y() * layout.z();
   }
-  else
+
+  this->private_->pack_.reset( new LargeVolumePack );
+  if ( !this->private_->pack_->resume( this->private_->dir_, level_num_bricks, error ) )
+  {
+    this->private_->pack_.reset();
+    return false;
+  }
+
+  this->private_->packing_ = true;
+  return true;
+}
+
+bool LargeVolumeSchema::checkpoint_packing( std::string& error )
+{
+  if ( !this->private_->packing_ )
   {
-    try
+    error = "Bricks are not being packed.";
+    return false;
+  }
+
+  return this->private_->pack_->checkpoint( error );
+}
+
+bool LargeVolumeSchema::finish_packing( std::string& error )
+{
+  if ( !this->private_->packing_ )
+  {
+    error = "Bricks are not being packed.";
+    return false;
+  }
+
+  this->private_->packing_ = false;
+  if ( !this->private_->pack_->finish( error ) )
+  {
+    return false;
+  }
+
+  if ( !this->private_->pack_->open( this->private_->dir_, error ) )
+  {
+    return false;
+  }
+
+  this->private_->packed_ = true;
+  if ( !this->save( error ) )
+  {
+    return false;
+  }
+
+  // Now that the volume refers to the pack, the separate brick files are not needed anymore
+  for ( size_t j = 0; j < this->get_num_levels(); j++ )
+  {
+    IndexVector layout = this->get_level_layout( j );
+    size_t num_bricks = layout.x() * layout.y() * layout.z();
+    for ( size_t k = 0; k < num_bricks; k++ )
     {
-      std::ofstream output( brick_file.string().c_str(), std::ios_base::trunc | std::ios_base::binary | std::ios_base::out );
-      output.write( reinterpret_cast<char *>( data_block->get_data() ) , brick_size );
+      boost::system::error_code ec;
+      bfs::remove( this->private_->get_brick_file_name( BrickInfo( k, j ) ), ec );
     }
-    catch ( ... )
-    {
-      error = "Could not write to file '" + brick_file.string() + "'.";
-      return false;
-    }   
   }
 
   return true;
 }
 
+bool LargeVolumeSchema::is_packed() const
+{
+  return this->private_->packed_;
+}
+
 
 bool LargeVolumeSchema::get_parent(const BrickInfo& bi, BrickInfo& parent)
 {
@@ -1399,10 +1724,22 @@ void LargeVolumeSchemaPrivate::load_and_substitue_missing_bricks( std::vector<Br
     current_render.insert( current_render.end(), bricks_to_render[ lev ].begin(), bricks_to_render[ lev ].end() );
   }
 
+  // Load the bricks closest to the center of the requested area first
+  BBox focus_box;
+  for (size_t k = 0; k < want_to_render.size(); k++)
+  {
+    GridTransform trans = this->schema_->get_brick_grid_transform( want_to_render[ k ] );
+    focus_box.extend( trans * Point( -0.5, -0.5, -0.5 ) );
+    focus_box.extend( trans * Point( trans.get_nx() - 0.5, trans.get_ny() - 0.5, 
+      trans.get_nz() - 0.5 ) );
+  }
+  Point focus = focus_box.valid() ? focus_box.center() : this->origin_;
+
+  // Bricks that are no longer needed for this view are cancelled
   cache->clear_load_queue( load_key );
   for (size_t k = 0; k < bricks_to_load.size(); k++)
   {
-    cache->load_brick( this->schema_->shared_from_this(), bricks_to_load[ k ], load_key );
+    cache->load_brick( this->schema_->shared_from_this(), bricks_to_load[ k ], load_key, focus );
   }
 }
 
@@ -1507,20 +1844,48 @@ bool LargeVolumeSchema::reprocess_brick( const BrickInfo& bi,
     return false;
   }
 
+  // While packing, the brick file is kept until the pack is finished, so that an interrupted
+  // conversion can still find it
+  if ( this->private_->packing_ )
+  {
+    return this->write_brick( data_block, bi, error );
+  }
+
+  std::vector<char> buffer;
+  const char* data = 0;
+  size_t length = 0;
+  if ( !this->private_->encode_brick( data_block, buffer, data, length, error ) )
+  {
+    return false;
+  }
 
-  // Delete file, so that when we write the file again it will be more likely
-  // to be in a continuous block, especially since we do it as one write, hence
-  // a good FS should give us contiguous blocks on disk
+  // Write the file as one entity to a new file, so that it is more likely to be in a
+  // continuous block. The new file replaces the old one in one step, hence an interruption
+  // never leaves the brick behind incomplete.
   bfs::path brick_file = this->private_->get_brick_file_name( bi );
-  if (! bfs::remove( brick_file ) )
+  bfs::path temp_file = brick_file.string() + ".tmp";
+
+  try
+  {
+    std::ofstream output( temp_file.string().c_str(), std::ios_base::trunc | std::ios_base::binary | std::ios_base::out );
+    output.write( data, length );
+    if ( !output )
+    {
+      error = "Could not write to file '" + temp_file.string() + "'.";
+      return false;
+    }
+  }
+  catch ( ... )
   {
-    error = "Could not remove brick file.";
+    error = "Could not write to file '" + temp_file.string() + "'.";
     return false;
   }
 
-  // Write the file as one entity back to disk
-  if (! this->write_brick( data_block, bi, error ) )
+  boost::system::error_code ec;
+  bfs::rename( temp_file, brick_file, ec );
+  if ( ec )
   {
+    error = "Could not replace brick file '" + brick_file.string() + "'.";
     return false;
   }
 
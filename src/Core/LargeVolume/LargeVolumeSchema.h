@@ -37,10 +37,12 @@
 #include <Core/Geometry/GridTransform.h>
 #include <Core/DataBlock/DataType.h>
 #include <Core/DataBlock/DataBlock.h>
+#include <Core/LargeVolume/LargeVolumeCodec.h>
 
 // Boost includes
 #include <boost/shared_ptr.hpp>
 #include <boost/filesystem.hpp>
+#include <boost/cstdint.hpp>
 
 namespace Core
 {
@@ -114,6 +116,17 @@ public:
   }
 };
 
+/// HASH_VALUE
+/// Hash function so BrickInfo can be used directly as key in a boost::unordered_map
+inline std::size_t hash_value( const BrickInfo& bi )
+{
+  boost::uint64_t key = ( static_cast<boost::uint64_t>( bi.level_ ) << 40 ) ^ 
+    static_cast<boost::uint64_t>( bi.index_ );
+  // Mix the bits, as neighboring bricks only differ in the lower bits
+  key *= 0x9E3779B97F4A7C15ULL;
+  return static_cast<std::size_t>( key ^ ( key >> 32 ) );
+}
+
 
 class LargeVolumeSchema;
 typedef boost::shared_ptr< LargeVolumeSchema > LargeVolumeSchemaHandle;
@@ -125,6 +138,9 @@ class LargeVolumeSchema : public boost::enable_shared_from_this<LargeVolumeSchem
 public:
   typedef IndexVector::index_type index_type;
 
+  // Compact key of a brick: schema id, level and brick index packed into 64 bits
+  typedef boost::uint64_t brick_key_type;
+
   // -- constructor --
 public:
   LargeVolumeSchema();
@@ -217,10 +233,28 @@ public:
   /// Set bricking parameters
   void set_parameters( const IndexVector& size, const Vector& spacing, const Point& origin, const IndexVector& brick_size, size_t overlap, DataType datatype );
 
+  /// SET_SIZE
+  /// Change the size of the volume, e.g. when slices are appended. The levels need to be
+  /// computed again afterwards.
+  void set_size( const IndexVector& size );
+
   /// SET_COMPRESSION
   /// Set whether data is compressed
   void set_compression( bool compression );
 
+  /// SET_CODEC
+  /// Set how bricks are encoded. Bricks are written with a header that records the codec and
+  /// filter, volumes written without a codec use headerless zlib bricks.
+  void set_codec( BrickCodec codec, BrickFilter filter );
+
+  /// GET_CODEC
+  /// Get the codec used for writing bricks
+  BrickCodec get_codec() const;
+
+  /// GET_FILTER
+  /// Get the filter applied to bricks before compression
+  BrickFilter get_filter() const;
+
   /// SET_MIN_MAX
   /// Set min and max values for the dataset
   void set_min_max( double min, double max ) const;
@@ -261,6 +295,21 @@ public:
   /// Get the file name of the brick
   boost::filesystem::path get_brick_file_name( const BrickInfo& bi );
 
+  /// GET_ID
+  /// Get the number that identifies the loaded volume within the program. Schemas that load the
+  /// same directory, as long as it was not written again in between, get the same id.
+  unsigned int get_id() const;
+
+  /// GET_BRICK_KEY
+  /// Get a key that identifies the brick over all the schemas, without building its file name
+  brick_key_type get_brick_key( const BrickInfo& bi ) const
+  {
+    // 16 bits schema id, 8 bits level, 40 bits brick index
+    return ( static_cast<brick_key_type>( this->id_ & 0xffff ) << 48 ) |
+      ( static_cast<brick_key_type>( bi.level_ & 0xff ) << 40 ) |
+      ( static_cast<brick_key_type>( bi.index_ ) & 0xffffffffffULL );
+  }
+
   /// GET_BRICK_SIZE
   /// Get the size + overlap of the brick
   IndexVector get_brick_size( const BrickInfo& bi ) const;
@@ -323,10 +372,35 @@ public:
   bool append_brick_buffer( DataBlockHandle data_block, size_t z_start, size_t z_end, const size_t offset,
     const BrickInfo& bi, std::string& error ) const;
 
+  // -- packed layout --
+public:
+  /// BEGIN_PACKING
+  /// Create the pack files. Bricks written after this call are appended to the pack files
+  /// instead of being written to a separate file.
+  bool begin_packing( std::string& error );
+
+  /// RESUME_PACKING
+  /// Continue packing from the last checkpoint of the pack index
+  bool resume_packing( std::string& error );
+
+  /// CHECKPOINT_PACKING
+  /// Write the index of the bricks that have been packed so far
+  bool checkpoint_packing( std::string& error );
+
+  /// FINISH_PACKING
+  /// Write the pack index, switch the volume over to the packed layout and remove the
+  /// separate brick files
+  bool finish_packing( std::string& error );
+
+  /// IS_PACKED
+  /// Check whether the bricks are stored in pack files (see LargeVolumePack)
+  bool is_packed() const;
+
   // -- internals --
 private:
   LargeVolumeSchemaPrivateHandle private_;
   const boost::filesystem::path VOLUME_FILE_NAME_;
+  unsigned int id_;
 };
 
 } // end namespace Core
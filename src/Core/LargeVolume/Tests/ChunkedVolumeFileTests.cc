@@ -0,0 +1,166 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include <Core/DataBlock/StdDataBlock.h>
+#include <Core/LargeVolume/ChunkedVolumeFile.h>
+
+using namespace Core;
+
+class ChunkedVolumeFileTest : public ::testing::Test {
+protected:
+  virtual void SetUp()
+  {
+    directory_ = boost::filesystem::temp_directory_path() / 
+      boost::filesystem::unique_path( "ChunkedVolumeFileTest-%%%%-%%%%" );
+    boost::filesystem::create_directories( directory_ );
+
+    // Not a multiple of the chunk size along any axis
+    data_block_ = StdDataBlock::New( NX_C, NY_C, NZ_C, DataType::USHORT_E );
+    unsigned short* data = reinterpret_cast< unsigned short* >( data_block_->get_data() );
+    for ( size_t j = 0; j < data_block_->get_size(); j++ )
+    {
+      data[ j ] = static_cast< unsigned short >( ( j * 7 ) % 1000 );
+    }
+  }
+
+  virtual void TearDown()
+  {
+    boost::system::error_code ec;
+    boost::filesystem::remove_all( directory_, ec );
+  }
+
+  // Check that the voxels of a slice match the original data
+  void check_slice( const ChunkedVolumeFile& file, SliceType type, size_t index )
+  {
+    std::vector< size_t > chunks;
+    file.get_slice_chunks( type, index, chunks );
+    ASSERT_FALSE( chunks.empty() );
+    ASSERT_LT( chunks.size(), file.get_num_chunks() );
+
+    DataBlockHandle slice_block = StdDataBlock::New( NX_C, NY_C, NZ_C, DataType::USHORT_E );
+    slice_block->clear();
+    std::string error;
+    ASSERT_TRUE( file.read_chunks( chunks, slice_block, error ) ) << error;
+
+    for ( size_t z = 0; z < NZ_C; z++ )
+    {
+      for ( size_t y = 0; y < NY_C; y++ )
+      {
+        for ( size_t x = 0; x < NX_C; x++ )
+        {
+          if ( type == SliceType::AXIAL_E && z != index ) continue;
+          if ( type == SliceType::CORONAL_E && y != index ) continue;
+          if ( type == SliceType::SAGITTAL_E && x != index ) continue;
+          ASSERT_EQ( slice_block->get_data_at( x, y, z ), data_block_->get_data_at( x, y, z ) );
+        }
+      }
+    }
+  }
+
+  static const size_t NX_C = 130;
+  static const size_t NY_C = 70;
+  static const size_t NZ_C = 65;
+
+  boost::filesystem::path directory_;
+  DataBlockHandle data_block_;
+};
+
+const size_t ChunkedVolumeFileTest::NX_C;
+const size_t ChunkedVolumeFileTest::NY_C;
+const size_t ChunkedVolumeFileTest::NZ_C;
+
+TEST_F(ChunkedVolumeFileTest, SaveAndRead)
+{
+  GridTransform grid_transform( NX_C, NY_C, NZ_C, Transform(), true );
+
+  for ( int compress = 0; compress < 2; compress++ )
+  {
+    boost::filesystem::path filename = directory_ / 
+      ( "volume" + ChunkedVolumeFile::GetFileExtension() );
+    std::string error;
+    ASSERT_TRUE( ChunkedVolumeFile::Save( filename, data_block_, grid_transform, 
+      compress != 0, true, error ) ) << error;
+
+    ChunkedVolumeFile file;
+    ASSERT_TRUE( file.open( filename, error ) ) << error;
+    ASSERT_EQ( file.get_data_type(), DataType::USHORT_E );
+    ASSERT_EQ( file.get_grid_transform().get_nx(), NX_C );
+    ASSERT_EQ( file.get_grid_transform().get_ny(), NY_C );
+    ASSERT_EQ( file.get_grid_transform().get_nz(), NZ_C );
+    ASSERT_TRUE( file.get_grid_transform().get_originally_node_centered() );
+
+    DataBlockHandle data_block;
+    ASSERT_TRUE( file.read( data_block, error ) ) << error;
+    ASSERT_EQ( data_block->get_nx(), NX_C );
+    ASSERT_EQ( data_block->get_ny(), NY_C );
+    ASSERT_EQ( data_block->get_nz(), NZ_C );
+    ASSERT_EQ( 0, std::memcmp( data_block->get_const_data(), data_block_->get_const_data(),
+      data_block_->get_byte_size() ) );
+    ASSERT_TRUE( data_block->has_histogram() );
+
+    // Slices in the last, partial chunk along each axis
+    check_slice( file, SliceType::AXIAL_E, NZ_C - 1 );
+    check_slice( file, SliceType::CORONAL_E, NY_C - 2 );
+    check_slice( file, SliceType::SAGITTAL_E, NX_C - 1 );
+    check_slice( file, SliceType::SAGITTAL_E, 3 );
+
+    file.close();
+    ASSERT_FALSE( file.is_open() );
+  }
+}
+
+TEST_F(ChunkedVolumeFileTest, SliceOutsideVolume)
+{
+  boost::filesystem::path filename = directory_ / 
+    ( "volume" + ChunkedVolumeFile::GetFileExtension() );
+  std::string error;
+  ASSERT_TRUE( ChunkedVolumeFile::Save( filename, data_block_, 
+    GridTransform( NX_C, NY_C, NZ_C ), true, false, error ) ) << error;
+
+  ChunkedVolumeFile file;
+  ASSERT_TRUE( file.open( filename, error ) ) << error;
+  std::vector< size_t > chunks;
+  file.get_slice_chunks( SliceType::AXIAL_E, NZ_C, chunks );
+  ASSERT_TRUE( chunks.empty() );
+}
+
+TEST_F(ChunkedVolumeFileTest, OpenMissingFile)
+{
+  ChunkedVolumeFile file;
+  std::string error;
+  ASSERT_FALSE( file.open( directory_ / "missing.s3dv", error ) );
+  ASSERT_FALSE( error.empty() );
+  ASSERT_FALSE( file.is_open() );
+}
@@ -0,0 +1,90 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include <Core/LargeVolume/LargeVolumeCodec.h>
+
+using namespace Core;
+
+static void CheckRoundTrip( const std::vector< char >& data, DataType data_type, 
+  BrickCodec codec, BrickFilter filter )
+{
+  const char* input = data.empty() ? 0 : &data[ 0 ];
+  std::vector< char > buffer;
+  std::string error;
+  ASSERT_TRUE( LargeVolumeCodec::EncodeBrick( input, data.size(), data_type, true, codec, 
+    filter, buffer, error ) ) << error;
+  ASSERT_TRUE( error.empty() );
+  ASSERT_GE( buffer.size(), LargeVolumeCodec::GetHeaderSize() );
+
+  std::vector< char > output( data.size() );
+  char* target = output.empty() ? 0 : &output[ 0 ];
+  ASSERT_TRUE( LargeVolumeCodec::DecodeBrick( &buffer[ 0 ], buffer.size(), target, 
+    output.size(), data_type, true, error ) ) << error;
+  ASSERT_EQ( data, output );
+}
+
+TEST(LargeVolumeCodecTest, RoundTrip)
+{
+  std::vector< char > data( 4096 );
+  for ( size_t j = 0; j < data.size(); j++ ) data[ j ] = static_cast< char >( ( j / 7 ) % 13 );
+
+  CheckRoundTrip( data, DataType::USHORT_E, BrickCodec::LZ4_E, BrickFilter::NONE_E );
+  CheckRoundTrip( data, DataType::USHORT_E, BrickCodec::LZ4_E, BrickFilter::SHUFFLE_E );
+  CheckRoundTrip( data, DataType::INT_E, BrickCodec::LZ4_E, BrickFilter::DELTA_E );
+  CheckRoundTrip( data, DataType::FLOAT_E, BrickCodec::ZLIB_E, BrickFilter::SHUFFLE_E );
+}
+
+TEST(LargeVolumeCodecTest, EmptyBrick)
+{
+  // Nothing is compressed or filtered, the brick is only a header
+  std::vector< char > data;
+  CheckRoundTrip( data, DataType::INT_E, BrickCodec::LZ4_E, BrickFilter::DELTA_E );
+  CheckRoundTrip( data, DataType::FLOAT_E, BrickCodec::ZLIB_E, BrickFilter::SHUFFLE_E );
+  CheckRoundTrip( data, DataType::UCHAR_E, BrickCodec::NONE_E, BrickFilter::NONE_E );
+
+  // Compressing nothing gives the last, empty sequence
+  std::vector< char > output( LargeVolumeCodec::LZ4CompressBound( 0 ) );
+  size_t length = LargeVolumeCodec::LZ4Compress( 0, 0, &output[ 0 ] );
+  ASSERT_EQ( length, size_t( 1 ) );
+  ASSERT_TRUE( LargeVolumeCodec::LZ4Decompress( &output[ 0 ], length, 0, 0 ) );
+}
+
+TEST(LargeVolumeCodecTest, UnknownDataType)
+{
+  std::vector< char > data( 16, 1 );
+  std::vector< char > buffer;
+  std::string error;
+  ASSERT_FALSE( LargeVolumeCodec::EncodeBrick( &data[ 0 ], data.size(), DataType::UNKNOWN_E, 
+    true, BrickCodec::LZ4_E, BrickFilter::NONE_E, buffer, error ) );
+  ASSERT_FALSE( error.empty() );
+}
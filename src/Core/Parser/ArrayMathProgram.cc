@@ -41,7 +41,7 @@ class ArrayMathProgramPrivate
 public:
 
   // For parallel code
-  void parallel_run( int thread, int num_threads, boost::barrier& barrier );
+  void parallel_run( int thread, int num_threads, Barrier& barrier );
 
   // General parameters that determine how many values are computed at
   // the same time and how many processors to use
@@ -83,7 +83,7 @@ public:
   update_progress_signal_type update_progress_signal_;
 };
 
-void ArrayMathProgramPrivate::parallel_run( int thread, int num_threads, boost::barrier& barrier )
+void ArrayMathProgramPrivate::parallel_run( int thread, int num_threads, Barrier& barrier )
 {
   index_type per_thread = this->array_size_ / num_threads;
   index_type start = thread * per_thread;
@@ -0,0 +1,70 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+// Core includes
+#include <Core/Utils/Barrier.h>
+
+namespace Core
+{
+
+Barrier::Barrier( unsigned int count ) :
+  count_( count ),
+  waiting_( 0 ),
+  generation_( 0 )
+{
+}
+
+bool Barrier::release()
+{
+  if ( this->waiting_ < this->count_ ) return false;
+
+  this->waiting_ = 0;
+  this->generation_++;
+  this->released_.notify_all();
+  return true;
+}
+
+bool Barrier::wait()
+{
+  boost::mutex::scoped_lock lock( this->mutex_ );
+  unsigned int generation = this->generation_;
+  this->waiting_++;
+  if ( this->release() ) return true;
+
+  while ( generation == this->generation_ ) this->released_.wait( lock );
+  return false;
+}
+
+void Barrier::leave()
+{
+  boost::mutex::scoped_lock lock( this->mutex_ );
+  if ( this->count_ > 0 ) this->count_--;
+  if ( this->waiting_ > 0 ) this->release();
+}
+
+} // end namespace Core
@@ -0,0 +1,82 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef CORE_UTILS_BARRIER_H
+#define CORE_UTILS_BARRIER_H
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1020)
+# pragma once
+#endif 
+
+// Boost includes
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+namespace Core
+{
+
+// CLASS BARRIER:
+/// Synchronization point for a group of threads, like boost::barrier. Unlike boost::barrier, a
+/// thread can leave the group, for instance when its task threw an exception, so that the other
+/// threads do not wait for it forever.
+
+class Barrier : public boost::noncopyable
+{
+public:
+  explicit Barrier( unsigned int count );
+
+  // WAIT:
+  /// Wait until all the threads in the group have reached the barrier. Returns true for one
+  /// of the threads.
+  bool wait();
+
+  // LEAVE:
+  /// Remove the calling thread from the group. Threads that are waiting are released if all
+  /// the remaining threads have reached the barrier.
+  void leave();
+
+private:
+  bool release();
+
+  boost::mutex mutex_;
+  boost::condition_variable released_;
+
+  /// Number of threads in the group
+  unsigned int count_;
+
+  /// Number of threads that are waiting at the barrier
+  unsigned int waiting_;
+
+  /// Increased every time the waiting threads are released
+  unsigned int generation_;
+};
+
+} // end namespace Core
+
+#endif
@@ -0,0 +1,297 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#endif
+
+// Boost includes
+#include <boost/filesystem.hpp>
+
+// Core includes
+#include <Core/Utils/MappedFile.h>
+
+namespace Core
+{
+
+class MappedFilePrivate
+{
+public:
+  MappedFilePrivate() :
+    mapping_( 0 ),
+    mapping_size_( 0 ),
+    data_( 0 ),
+    size_( 0 ),
+    mode_( MappedFile::READ_ONLY_E )
+  {
+  }
+
+  bool map( const boost::filesystem::path& filename, MappedFile::mode_type mode, 
+    long long offset, size_t length, long long resize, std::string& error );
+  void unmap();
+
+  // Start of the mapping, aligned to the page size
+  char* mapping_;
+  size_t mapping_size_;
+
+  // Start of the region that was requested
+  char* data_;
+  size_t size_;
+
+  MappedFile::mode_type mode_;
+};
+
+bool MappedFilePrivate::map( const boost::filesystem::path& filename, MappedFile::mode_type mode,
+  long long offset, size_t length, long long resize, std::string& error )
+{
+  const bool writable = ( mode == MappedFile::READ_WRITE_E );
+  const bool copy_on_write = ( mode == MappedFile::COPY_ON_WRITE_E );
+
+#ifdef _WIN32
+  HANDLE file = CreateFileW( filename.wstring().c_str(), 
+    writable ? ( GENERIC_READ | GENERIC_WRITE ) : GENERIC_READ, FILE_SHARE_READ, 0, 
+    resize >= 0 ? OPEN_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0 );
+  if ( file == INVALID_HANDLE_VALUE )
+  {
+    error = "Could not open file '" + filename.string() + "'.";
+    return false;
+  }
+
+  LARGE_INTEGER file_size;
+  if ( resize >= 0 )
+  {
+    file_size.QuadPart = resize;
+    if ( !SetFilePointerEx( file, file_size, 0, FILE_BEGIN ) || !SetEndOfFile( file ) )
+    {
+      CloseHandle( file );
+      error = "Could not resize file '" + filename.string() + "'.";
+      return false;
+    }
+  }
+  else if ( !GetFileSizeEx( file, &file_size ) )
+  {
+    CloseHandle( file );
+    error = "Could not determine size of file '" + filename.string() + "'.";
+    return false;
+  }
+  long long total_size = file_size.QuadPart;
+#else
+  int file = ::open( filename.string().c_str(), writable ? ( O_RDWR | O_CREAT ) : O_RDONLY, 0644 );
+  if ( file < 0 )
+  {
+    error = "Could not open file '" + filename.string() + "'.";
+    return false;
+  }
+
+  if ( resize >= 0 && ::ftruncate( file, static_cast< off_t >( resize ) ) != 0 )
+  {
+    ::close( file );
+    error = "Could not resize file '" + filename.string() + "'.";
+    return false;
+  }
+
+  struct stat file_stat;
+  if ( ::fstat( file, &file_stat ) != 0 )
+  {
+    ::close( file );
+    error = "Could not determine size of file '" + filename.string() + "'.";
+    return false;
+  }
+  long long total_size = static_cast< long long >( file_stat.st_size );
+#endif
+
+  if ( offset < 0 || offset > total_size || 
+    ( length > 0 && offset + static_cast< long long >( length ) > total_size ) )
+  {
+#ifdef _WIN32
+    CloseHandle( file );
+#else
+    ::close( file );
+#endif
+    error = "Requested region is outside file '" + filename.string() + "'.";
+    return false;
+  }
+
+  if ( length == 0 ) length = static_cast< size_t >( total_size - offset );
+
+  // Mappings need to start at a page boundary
+  long long page_size = static_cast< long long >( MappedFile::GetPageSize() );
+  long long aligned_offset = ( offset / page_size ) * page_size;
+  size_t mapping_size = static_cast< size_t >( offset - aligned_offset ) + length;
+
+  if ( mapping_size == 0 )
+  {
+    // Empty regions cannot be mapped, but are valid
+#ifdef _WIN32
+    CloseHandle( file );
+#else
+    ::close( file );
+#endif
+    this->mapping_ = 0;
+    this->mapping_size_ = 0;
+    this->data_ = 0;
+    this->size_ = 0;
+    this->mode_ = mode;
+    return true;
+  }
+
+#ifdef _WIN32
+  HANDLE mapping = CreateFileMapping( file, 0, 
+    writable ? PAGE_READWRITE : ( copy_on_write ? PAGE_WRITECOPY : PAGE_READONLY ), 0, 0, 0 );
+  CloseHandle( file );
+  if ( mapping == 0 )
+  {
+    error = "Could not map file '" + filename.string() + "'.";
+    return false;
+  }
+
+  void* address = MapViewOfFile( mapping, 
+    writable ? FILE_MAP_WRITE : ( copy_on_write ? FILE_MAP_COPY : FILE_MAP_READ ), 
+    static_cast< DWORD >( aligned_offset >> 32 ), 
+    static_cast< DWORD >( aligned_offset & 0xffffffff ), mapping_size );
+  CloseHandle( mapping );
+  if ( address == 0 )
+  {
+    error = "Could not map file '" + filename.string() + "'.";
+    return false;
+  }
+#else
+  void* address = ::mmap( 0, mapping_size, 
+    ( writable || copy_on_write ) ? ( PROT_READ | PROT_WRITE ) : PROT_READ,
+    copy_on_write ? MAP_PRIVATE : MAP_SHARED, file, static_cast< off_t >( aligned_offset ) );
+  ::close( file );
+  if ( address == MAP_FAILED )
+  {
+    error = "Could not map file '" + filename.string() + "'.";
+    return false;
+  }
+#endif
+
+  this->mapping_ = static_cast< char* >( address );
+  this->mapping_size_ = mapping_size;
+  this->data_ = this->mapping_ + ( offset - aligned_offset );
+  this->size_ = length;
+  this->mode_ = mode;
+  return true;
+}
+
+void MappedFilePrivate::unmap()
+{
+  if ( this->mapping_ )
+  {
+#ifdef _WIN32
+    UnmapViewOfFile( this->mapping_ );
+#else
+    ::munmap( this->mapping_, this->mapping_size_ );
+#endif
+  }
+
+  this->mapping_ = 0;
+  this->mapping_size_ = 0;
+  this->data_ = 0;
+  this->size_ = 0;
+}
+
+MappedFile::MappedFile() :
+  private_( new MappedFilePrivate )
+{
+}
+
+MappedFile::~MappedFile()
+{
+  this->close();
+}
+
+bool MappedFile::open( const boost::filesystem::path& filename, mode_type mode, 
+  std::string& error, long long offset, size_t length )
+{
+  this->close();
+  return this->private_->map( filename, mode, offset, length, -1, error );
+}
+
+bool MappedFile::create( const boost::filesystem::path& filename, long long size, 
+  std::string& error )
+{
+  this->close();
+  return this->private_->map( filename, READ_WRITE_E, 0, 0, size, error );
+}
+
+void MappedFile::close()
+{
+  this->private_->unmap();
+}
+
+bool MappedFile::flush()
+{
+  if ( this->private_->mapping_ == 0 || this->private_->mode_ != READ_WRITE_E ) return true;
+
+#ifdef _WIN32
+  return FlushViewOfFile( this->private_->mapping_, this->private_->mapping_size_ ) != 0;
+#else
+  return ::msync( this->private_->mapping_, this->private_->mapping_size_, MS_SYNC ) == 0;
+#endif
+}
+
+bool MappedFile::is_open() const
+{
+  return this->private_->mapping_ != 0;
+}
+
+char* MappedFile::get_data() const
+{
+  return this->private_->data_;
+}
+
+size_t MappedFile::get_size() const
+{
+  return this->private_->size_;
+}
+
+MappedFile::mode_type MappedFile::get_mode() const
+{
+  return this->private_->mode_;
+}
+
+size_t MappedFile::GetPageSize()
+{
+#ifdef _WIN32
+  SYSTEM_INFO system_info;
+  GetSystemInfo( &system_info );
+  return static_cast< size_t >( system_info.dwAllocationGranularity );
+#else
+  return static_cast< size_t >( ::sysconf( _SC_PAGESIZE ) );
+#endif
+}
+
+} // end namespace Core
@@ -0,0 +1,124 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef CORE_UTILS_MAPPEDFILE_H
+#define CORE_UTILS_MAPPEDFILE_H
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1020)
+# pragma once
+#endif 
+
+// STL includes
+#include <string>
+
+// Boost includes
+#include <boost/noncopyable.hpp>
+#include <boost/smart_ptr.hpp>
+#include <boost/filesystem/path.hpp>
+
+namespace Core
+{
+
+class MappedFile;
+typedef boost::shared_ptr< MappedFile > MappedFileHandle;
+
+class MappedFilePrivate;
+typedef boost::shared_ptr< MappedFilePrivate > MappedFilePrivateHandle;
+
+// CLASS MAPPEDFILE:
+/// Map (a region of) a file into memory. The operating system pages the data in and out, hence
+/// the mapped region can be larger than the physical memory.
+/// NOTE: Offsets do not need to be aligned to page boundaries, this is handled internally.
+
+class MappedFile : public boost::noncopyable
+{
+public:
+  enum mode_type
+  {
+    READ_ONLY_E,
+    READ_WRITE_E,
+    // Writable, but changes stay in memory and are never written to the file
+    COPY_ON_WRITE_E
+  };
+
+  // -- constructor/destructor --
+public:
+  MappedFile();
+  ~MappedFile();
+
+  // -- open/close --
+public:
+  // OPEN:
+  /// Map length bytes of an existing file starting at offset. If length is zero, the file is
+  /// mapped up to the end.
+  bool open( const boost::filesystem::path& filename, mode_type mode, std::string& error,
+    long long offset = 0, size_t length = 0 );
+
+  // CREATE:
+  /// Create a file of the given size, or resize an existing one, and map it for writing.
+  bool create( const boost::filesystem::path& filename, long long size, std::string& error );
+
+  // CLOSE:
+  /// Unmap the file. Changes to a writable mapping are written back by the operating system.
+  void close();
+
+  // FLUSH:
+  /// Write the changes in the mapped region back to disk.
+  bool flush();
+
+  // -- access --
+public:
+  // IS_OPEN:
+  /// Whether a region is currently mapped.
+  bool is_open() const;
+
+  // GET_DATA:
+  /// Pointer to the first byte of the requested region.
+  char* get_data() const;
+
+  // GET_SIZE:
+  /// Number of bytes in the requested region.
+  size_t get_size() const;
+
+  // GET_MODE:
+  /// Whether the region was mapped read-only, writable or copy-on-write.
+  mode_type get_mode() const;
+
+  // -- helpers --
+public:
+  // GETPAGESIZE:
+  /// The granularity at which the operating system maps files.
+  static size_t GetPageSize();
+
+private:
+  MappedFilePrivateHandle private_;
+};
+
+} // end namespace Core
+
+#endif
@@ -27,13 +27,17 @@
  */
 
 // STL includes
-#include <vector>
+#include <algorithm>
+#include <exception>
 
 // Boost includes
+#include <boost/bind.hpp>
 #include <boost/thread.hpp>
 
 // Core includes
 #include <Core/Utils/Parallel.h>
+#include <Core/Utils/ThreadPool.h>
+#include <Core/Utils/AtomicCounter.h>
 
 namespace Core
 {
@@ -42,17 +46,126 @@ class ParallelPrivate
 {
 public:
   int num_threads_;
-  boost::function< void ( int, int, boost::barrier&  ) > function_;
+  boost::function< void ( int, int, Barrier& ) > function_;
 };
 
-Parallel::Parallel( boost::function< void ( int, int, boost::barrier& ) > function, int num_threads ) :
+class ParallelRange;
+typedef boost::shared_ptr< ParallelRange > ParallelRangeHandle;
+
+// CLASS PARALLELRANGE:
+/// Shared state of one Parallel::For call. Helper tasks keep a handle to it, as they may only
+/// start after the call has already returned.
+
+class ParallelRange : public boost::noncopyable
+{
+public:
+  ParallelRange( size_t begin, size_t end, size_t grain_size, 
+    Parallel::range_function_type function ) :
+    begin_( begin ),
+    end_( end ),
+    grain_size_( grain_size ),
+    num_chunks_( ( end - begin + grain_size - 1 ) / grain_size ),
+    function_( function ),
+    next_chunk_( 0 ),
+    failed_( 0 ),
+    finished_chunks_( 0 )
+  {
+  }
+
+  // PROCESS:
+  /// Keep processing chunks until all of them have been handed out. Once a chunk has thrown,
+  /// the remaining chunks are only counted as finished.
+  void process()
+  {
+    size_t finished = 0;
+    while ( true )
+    {
+      size_t chunk = static_cast< size_t >( this->next_chunk_++ );
+      if ( chunk >= this->num_chunks_ ) break;
+      finished++;
+      if ( this->failed_ ) continue;
+
+      size_t chunk_begin = this->begin_ + chunk * this->grain_size_;
+      size_t chunk_end = std::min( chunk_begin + this->grain_size_, this->end_ );
+      try
+      {
+        this->function_( chunk_begin, chunk_end );
+      }
+      catch ( ... )
+      {
+        boost::mutex::scoped_lock lock( this->mutex_ );
+        if ( !this->exception_ ) this->exception_ = std::current_exception();
+        ++this->failed_;
+      }
+    }
+
+    if ( finished == 0 ) return;
+
+    boost::mutex::scoped_lock lock( this->mutex_ );
+    this->finished_chunks_ += finished;
+    if ( this->finished_chunks_ == this->num_chunks_ ) this->finished_.notify_all();
+  }
+
+  // WAIT:
+  /// Wait until every chunk has been processed and rethrow the exception of a chunk that
+  /// failed.
+  void wait()
+  {
+    boost::mutex::scoped_lock lock( this->mutex_ );
+    while ( this->finished_chunks_ < this->num_chunks_ ) this->finished_.wait( lock );
+    if ( this->exception_ ) std::rethrow_exception( this->exception_ );
+  }
+
+  static void Process( ParallelRangeHandle range )
+  {
+    range->process();
+  }
+
+  size_t begin_;
+  size_t end_;
+  size_t grain_size_;
+  size_t num_chunks_;
+  Parallel::range_function_type function_;
+
+  AtomicCounter next_chunk_;
+
+  // Number of chunks that threw
+  AtomicCounter failed_;
+
+  boost::mutex mutex_;
+  boost::condition_variable finished_;
+  size_t finished_chunks_;
+
+  // First exception thrown by a chunk
+  std::exception_ptr exception_;
+};
+
+// RUNINSTANCE:
+// Run one thread of Parallel::run(). The thread leaves the barrier when it is done, so an
+// exception does not leave the other threads waiting for it.
+static void RunInstance( boost::function< void ( int, int, Barrier& ) > function, int thread, 
+  int num_threads, Barrier* barrier )
+{
+  try
+  {
+    function( thread, num_threads, *barrier );
+  }
+  catch ( ... )
+  {
+    barrier->leave();
+    throw;
+  }
+  barrier->leave();
+}
+
+Parallel::Parallel( boost::function< void ( int, int, Barrier& ) > function, int num_threads ) :
   private_( new ParallelPrivate )
 {
   this->private_->function_ = function;
 
   if ( num_threads == -1 )
   {
-    this->private_->num_threads_ =  boost::thread::hardware_concurrency();
+    this->private_->num_threads_ = GetNumThreads();
   }
   else
   {
@@ -67,21 +180,45 @@ Parallel::Parallel( boost::function< void ( int, int, boost::barrier& ) > functi
 
 void Parallel::run()
 {
-  boost::barrier barrier( this->private_->num_threads_ );
+  Barrier barrier( this->private_->num_threads_ );
+
+  ThreadPool::Instance()->run_concurrently( boost::bind( &RunInstance, this->private_->function_,
+    _1, this->private_->num_threads_, &barrier ), this->private_->num_threads_ );
+}
+
+void Parallel::For( size_t begin, size_t end, range_function_type function, size_t grain_size )
+{
+  if ( end <= begin ) return;
 
-  std::vector< boost::thread* > threads( this->private_->num_threads_ );
+  size_t num_threads = static_cast< size_t >( GetNumThreads() );
+  if ( grain_size == 0 )
+  {
+    // Aim for a few chunks per thread, so threads that finish early can balance the load
+    grain_size = std::max< size_t >( 1, ( end - begin ) / ( 4 * num_threads ) );
+  }
 
-  for ( int i = 0; i < this->private_->num_threads_; i++ )
+  if ( end - begin <= grain_size || num_threads == 1 )
   {
-    threads[ i ] = new boost::thread( boost::bind( this->private_->function_, i, 
-      this->private_->num_threads_, boost::ref( barrier ) ) );
+    function( begin, end );
+    return;
   }
 
-  for ( int i = 0; i < this->private_->num_threads_; i++ )
+  ParallelRangeHandle range( new ParallelRange( begin, end, grain_size, function ) );
+
+  size_t num_helpers = std::min( num_threads, range->num_chunks_ - 1 );
+  ThreadPool* pool = ThreadPool::Instance();
+  for ( size_t j = 0; j < num_helpers; j++ )
   {
-    threads[ i ]->join();
-    delete threads[ i ];
+    pool->post( boost::bind( &ParallelRange::Process, range ) );
   }
+
+  range->process();
+  range->wait();
+}
+
+int Parallel::GetNumThreads()
+{
+  return ThreadPool::Instance()->get_num_workers();
 }
 
 } // end namespace Core
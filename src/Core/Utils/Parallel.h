@@ -37,7 +37,9 @@
 #include <boost/noncopyable.hpp>
 #include <boost/smart_ptr.hpp>
 #include <boost/function.hpp>
-#include <boost/thread/barrier.hpp>
+
+// Core includes
+#include <Core/Utils/Barrier.h>
 
 namespace Core
 {
@@ -45,15 +47,43 @@ namespace Core
 class ParallelPrivate;
 typedef boost::shared_ptr< ParallelPrivate > ParallelPrivateHandle;
 
+// CLASS PARALLEL:
+/// Run a function on a number of threads at the same time. The function is called with the
+/// thread number, the number of threads and a barrier shared between all the threads.
+/// NOTE: The threads are taken from the process wide ThreadPool, no threads are created when
+/// enough workers are idle.
+/// NOTE: A thread that throws leaves the barrier, so the other threads can finish. The first
+/// exception is rethrown by run() once all the threads have finished.
+
 class Parallel : public boost::noncopyable
 {
 
 public:
-  explicit Parallel( boost::function< void ( int, int, boost::barrier& ) > function, 
+  explicit Parallel( boost::function< void ( int, int, Barrier& ) > function, 
     int num_threads = -1 );
   
   void run();
 
+  // -- parallel range --
+public:
+  typedef boost::function< void ( size_t, size_t ) > range_function_type;
+
+  // FOR:
+  /// Split the range [begin, end) into chunks of grain_size elements and call the function for
+  /// each chunk [chunk_begin, chunk_end) on the thread pool. The calling thread participates
+  /// and the function returns when all chunks have been processed. If grain_size is zero, a
+  /// grain size is chosen based on the number of threads.
+  /// NOTE: Chunks are handed out dynamically and no barrier is available, hence chunks should
+  /// not depend on each other.
+  /// NOTE: If a chunk throws, the chunks that have not started yet are skipped and the first
+  /// exception is rethrown once the other chunks have finished.
+  static void For( size_t begin, size_t end, range_function_type function, 
+    size_t grain_size = 0 );
+
+  // GET_NUM_THREADS:
+  /// The number of threads that Parallel uses by default.
+  static int GetNumThreads();
+
 private:
   ParallelPrivateHandle private_;
 };
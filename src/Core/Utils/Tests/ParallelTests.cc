@@ -0,0 +1,134 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+ 
+ The MIT License
+ 
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+ 
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <gtest/gtest.h>
+
+#include <stdexcept>
+#include <vector>
+
+#include <boost/bind.hpp>
+
+#include <Core/Utils/Parallel.h>
+#include <Core/Utils/ThreadPool.h>
+
+namespace
+{
+
+void FillRange( std::vector< int >* data, size_t begin, size_t end )
+{
+  for ( size_t j = begin; j < end; j++ ) ( *data )[ j ]++;
+}
+
+void FillSlab( std::vector< int >* data, int thread, int num_threads, Core::Barrier& barrier )
+{
+  size_t size = data->size();
+  FillRange( data, thread * size / num_threads, ( thread + 1 ) * size / num_threads );
+  barrier.wait();
+  FillRange( data, thread * size / num_threads, ( thread + 1 ) * size / num_threads );
+}
+
+void NestedFor( std::vector< int >* data, size_t begin, size_t end )
+{
+  Core::Parallel::For( begin, end, boost::bind( &FillRange, data, _1, _2 ), 1 );
+}
+
+void ThrowInRange( size_t bad_index, size_t begin, size_t end )
+{
+  if ( bad_index >= begin && bad_index < end ) throw std::runtime_error( "bad chunk" );
+}
+
+void ThrowBeforeBarrier( std::vector< int >* data, int thread, int num_threads, 
+  Core::Barrier& barrier )
+{
+  if ( thread == 1 ) throw std::runtime_error( "bad thread" );
+  FillSlab( data, thread, num_threads, barrier );
+}
+
+}
+
+TEST(ParallelTests, ForVisitsEveryElementOnce)
+{
+  std::vector< int > data( 100003, 0 );
+  Core::Parallel::For( 0, data.size(), boost::bind( &FillRange, &data, _1, _2 ), 17 );
+  for ( size_t j = 0; j < data.size(); j++ ) ASSERT_EQ( 1, data[ j ] );
+}
+
+TEST(ParallelTests, ForDefaultGrainSize)
+{
+  std::vector< int > data( 1000, 0 );
+  Core::Parallel::For( 0, data.size(), boost::bind( &FillRange, &data, _1, _2 ) );
+  for ( size_t j = 0; j < data.size(); j++ ) ASSERT_EQ( 1, data[ j ] );
+}
+
+TEST(ParallelTests, NestedFor)
+{
+  std::vector< int > data( 4096, 0 );
+  Core::Parallel::For( 0, data.size(), boost::bind( &NestedFor, &data, _1, _2 ), 256 );
+  for ( size_t j = 0; j < data.size(); j++ ) ASSERT_EQ( 1, data[ j ] );
+}
+
+TEST(ParallelTests, RunWithBarrier)
+{
+  // Use more threads than workers to test the fall back on temporary threads
+  int num_threads = Core::ThreadPool::Instance()->get_num_workers() + 3;
+  for ( int k = 0; k < 10; k++ )
+  {
+    std::vector< int > data( 1000, 0 );
+    Core::Parallel parallel( boost::bind( &FillSlab, &data, _1, _2, _3 ), num_threads );
+    parallel.run();
+    for ( size_t j = 0; j < data.size(); j++ ) ASSERT_EQ( 2, data[ j ] );
+  }
+}
+
+TEST(ParallelTests, ForRethrowsException)
+{
+  for ( size_t k = 0; k < 10; k++ )
+  {
+    EXPECT_THROW( Core::Parallel::For( 0, 10000, boost::bind( &ThrowInRange, 
+      k * 997, _1, _2 ), 10 ), std::runtime_error );
+  }
+
+  // The pool is still usable afterwards
+  std::vector< int > data( 1000, 0 );
+  Core::Parallel::For( 0, data.size(), boost::bind( &FillRange, &data, _1, _2 ), 7 );
+  for ( size_t j = 0; j < data.size(); j++ ) ASSERT_EQ( 1, data[ j ] );
+}
+
+TEST(ParallelTests, RunRethrowsException)
+{
+  int num_threads = Core::ThreadPool::Instance()->get_num_workers() + 1;
+  for ( int k = 0; k < 10; k++ )
+  {
+    // The other threads do not wait at the barrier for the thread that threw
+    std::vector< int > data( 1000, 0 );
+    Core::Parallel parallel( boost::bind( &ThrowBeforeBarrier, &data, _1, _2, _3 ), 
+      num_threads );
+    EXPECT_THROW( parallel.run(), std::runtime_error );
+  }
+}
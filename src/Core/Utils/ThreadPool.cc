@@ -0,0 +1,384 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+// STL includes
+#include <algorithm>
+#include <deque>
+#include <exception>
+#include <vector>
+
+// Boost includes
+#include <boost/thread.hpp>
+#include <boost/thread/tss.hpp>
+#include <boost/bind.hpp>
+
+// Core includes
+#include <Core/Utils/ThreadPool.h>
+#include <Core/Utils/AtomicCounter.h>
+#include <Core/Utils/Log.h>
+
+namespace Core
+{
+
+CORE_SINGLETON_IMPLEMENTATION( ThreadPool );
+
+class ThreadPoolWorker : public boost::noncopyable
+{
+public:
+  ThreadPoolWorker() :
+    idle_( false ),
+    thread_( 0 )
+  {
+  }
+
+  // Mutex protecting the local task deque
+  boost::mutex deque_mutex_;
+
+  // Tasks posted by this worker. The worker pops from the back, thieves steal from the front.
+  std::deque< ThreadPool::task_type > tasks_;
+
+  // Task assigned by run_concurrently while the worker was idle. Protected by the pool mutex.
+  ThreadPool::task_type assigned_task_;
+
+  // Whether the worker is waiting for work. Protected by the pool mutex.
+  bool idle_;
+
+  boost::thread* thread_;
+};
+
+typedef boost::shared_ptr< ThreadPoolWorker > ThreadPoolWorkerHandle;
+
+class ConcurrentTaskState : public boost::noncopyable
+{
+public:
+  explicit ConcurrentTaskState( int remaining ) :
+    remaining_( remaining )
+  {
+  }
+
+  boost::mutex mutex_;
+  boost::condition_variable finished_;
+  int remaining_;
+
+  // First exception thrown by one of the instances
+  std::exception_ptr exception_;
+};
+
+class ThreadPoolPrivate
+{
+public:
+  // RUN_WORKER:
+  /// Main loop of a worker thread.
+  void run_worker( int index );
+
+  // POP_TASK:
+  /// Find a task for the worker: first its own deque, then the shared queue and finally the
+  /// deques of the other workers.
+  bool pop_task( int index, ThreadPool::task_type& task );
+
+  // EXECUTE:
+  /// Run a task and make sure an exception does not take down the worker.
+  static void Execute( const ThreadPool::task_type& task );
+
+  // RUN_CONCURRENT_TASK:
+  /// Run one instance of a concurrent task and report back that it finished. An exception is
+  /// handed to the thread that waits for the instances.
+  static void RunConcurrentTask( ThreadPool::concurrent_task_type task, int index,
+    ConcurrentTaskState* state );
+
+  std::vector< ThreadPoolWorkerHandle > workers_;
+
+  // Mutex protecting the shared queue and the idle administration
+  boost::mutex mutex_;
+  boost::condition_variable work_available_;
+
+  // Tasks posted from threads that are not part of the pool
+  std::deque< ThreadPool::task_type > shared_tasks_;
+
+  // Workers that are currently waiting for work
+  std::vector< int > idle_workers_;
+
+  // Number of tasks that have been posted but not yet picked up
+  AtomicCounter pending_;
+
+  // Index of the worker that belongs to the current thread
+  boost::thread_specific_ptr< int > current_worker_;
+
+  bool done_;
+};
+
+void ThreadPoolPrivate::Execute( const ThreadPool::task_type& task )
+{
+  try
+  {
+    task();
+  }
+  catch ( const std::exception& e )
+  {
+    CORE_LOG_ERROR( std::string( "Unhandled exception in parallel task: " ) + e.what() );
+  }
+  catch ( ... )
+  {
+    CORE_LOG_ERROR( "Unhandled exception in parallel task." );
+  }
+}
+
+void ThreadPoolPrivate::RunConcurrentTask( ThreadPool::concurrent_task_type task, int index,
+  ConcurrentTaskState* state )
+{
+  std::exception_ptr exception;
+  try
+  {
+    task( index );
+  }
+  catch ( ... )
+  {
+    exception = std::current_exception();
+  }
+
+  boost::mutex::scoped_lock lock( state->mutex_ );
+  if ( exception && !state->exception_ ) state->exception_ = exception;
+  if ( --state->remaining_ == 0 ) state->finished_.notify_all();
+}
+
+bool ThreadPoolPrivate::pop_task( int index, ThreadPool::task_type& task )
+{
+  const int num_workers = static_cast< int >( this->workers_.size() );
+
+  {
+    ThreadPoolWorker* worker = this->workers_[ index ].get();
+    boost::mutex::scoped_lock lock( worker->deque_mutex_ );
+    if ( !worker->tasks_.empty() )
+    {
+      task.swap( worker->tasks_.back() );
+      worker->tasks_.pop_back();
+      --this->pending_;
+      return true;
+    }
+  }
+
+  {
+    boost::mutex::scoped_lock lock( this->mutex_ );
+    if ( !this->shared_tasks_.empty() )
+    {
+      task.swap( this->shared_tasks_.front() );
+      this->shared_tasks_.pop_front();
+      --this->pending_;
+      return true;
+    }
+  }
+
+  for ( int j = 1; j < num_workers; j++ )
+  {
+    ThreadPoolWorker* victim = this->workers_[ ( index + j ) % num_workers ].get();
+    boost::mutex::scoped_lock lock( victim->deque_mutex_ );
+    if ( !victim->tasks_.empty() )
+    {
+      task.swap( victim->tasks_.front() );
+      victim->tasks_.pop_front();
+      --this->pending_;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void ThreadPoolPrivate::run_worker( int index )
+{
+  this->current_worker_.reset( new int( index ) );
+  ThreadPoolWorker* worker = this->workers_[ index ].get();
+
+  while ( true )
+  {
+    ThreadPool::task_type task;
+    if ( this->pop_task( index, task ) )
+    {
+      Execute( task );
+      continue;
+    }
+
+    boost::mutex::scoped_lock lock( this->mutex_ );
+    if ( this->done_ ) return;
+
+    // A task was posted, but another worker is still in the process of taking it
+    if ( this->pending_ > 0 )
+    {
+      lock.unlock();
+      boost::this_thread::yield();
+      continue;
+    }
+
+    worker->idle_ = true;
+    this->idle_workers_.push_back( index );
+
+    while ( worker->idle_ && this->pending_ == 0 && !this->done_ )
+    {
+      this->work_available_.wait( lock );
+    }
+
+    if ( worker->idle_ )
+    {
+      worker->idle_ = false;
+      this->idle_workers_.erase( std::find( this->idle_workers_.begin(), 
+        this->idle_workers_.end(), index ) );
+    }
+
+    // Tasks can only be assigned while the worker is idle, hence only check after waiting
+    if ( worker->assigned_task_ )
+    {
+      task.swap( worker->assigned_task_ );
+      lock.unlock();
+      Execute( task );
+    }
+  }
+}
+
+ThreadPool::ThreadPool() :
+  private_( new ThreadPoolPrivate )
+{
+  this->private_->done_ = false;
+
+  int num_workers = static_cast< int >( boost::thread::hardware_concurrency() );
+  if ( num_workers < 1 ) num_workers = 1;
+
+  for ( int j = 0; j < num_workers; j++ )
+  {
+    this->private_->workers_.push_back( ThreadPoolWorkerHandle( new ThreadPoolWorker ) );
+  }
+
+  // Start the threads only after all the workers exist, as they steal from each other
+  for ( int j = 0; j < num_workers; j++ )
+  {
+    this->private_->workers_[ j ]->thread_ = new boost::thread( boost::bind( 
+      &ThreadPoolPrivate::run_worker, this->private_.get(), j ) );
+  }
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    boost::mutex::scoped_lock lock( this->private_->mutex_ );
+    this->private_->done_ = true;
+    this->private_->work_available_.notify_all();
+  }
+
+  for ( size_t j = 0; j < this->private_->workers_.size(); j++ )
+  {
+    this->private_->workers_[ j ]->thread_->join();
+    delete this->private_->workers_[ j ]->thread_;
+  }
+}
+
+void ThreadPool::post( task_type task )
+{
+  int* current_worker = this->private_->current_worker_.get();
+  if ( current_worker )
+  {
+    ThreadPoolWorker* worker = this->private_->workers_[ *current_worker ].get();
+    boost::mutex::scoped_lock lock( worker->deque_mutex_ );
+    worker->tasks_.push_back( task );
+    ++this->private_->pending_;
+  }
+
+  boost::mutex::scoped_lock lock( this->private_->mutex_ );
+  if ( !current_worker )
+  {
+    this->private_->shared_tasks_.push_back( task );
+    ++this->private_->pending_;
+  }
+
+  if ( !this->private_->idle_workers_.empty() )
+  {
+    this->private_->work_available_.notify_one();
+  }
+}
+
+void ThreadPool::run_concurrently( concurrent_task_type task, int num_tasks )
+{
+  if ( num_tasks <= 1 )
+  {
+    task( 0 );
+    return;
+  }
+
+  ConcurrentTaskState state( num_tasks );
+  int index = 1;
+
+  // Hand the instances to idle workers. As these workers are not picking up any other work,
+  // the instances are guaranteed to start.
+  {
+    boost::mutex::scoped_lock lock( this->private_->mutex_ );
+    while ( index < num_tasks && !this->private_->idle_workers_.empty() )
+    {
+      ThreadPoolWorker* worker = 
+        this->private_->workers_[ this->private_->idle_workers_.back() ].get();
+      this->private_->idle_workers_.pop_back();
+      worker->idle_ = false;
+      worker->assigned_task_ = boost::bind( &ThreadPoolPrivate::RunConcurrentTask, task, 
+        index++, &state );
+    }
+
+    if ( index > 1 ) this->private_->work_available_.notify_all();
+  }
+
+  // Not enough workers available, start temporary threads for the remainder
+  std::vector< boost::thread* > extra_threads;
+  for ( ; index < num_tasks; index++ )
+  {
+    extra_threads.push_back( new boost::thread( boost::bind( 
+      &ThreadPoolPrivate::RunConcurrentTask, task, index, &state ) ) );
+  }
+
+  ThreadPoolPrivate::RunConcurrentTask( task, 0, &state );
+
+  {
+    boost::mutex::scoped_lock lock( state.mutex_ );
+    while ( state.remaining_ > 0 ) state.finished_.wait( lock );
+  }
+
+  for ( size_t j = 0; j < extra_threads.size(); j++ )
+  {
+    extra_threads[ j ]->join();
+    delete extra_threads[ j ];
+  }
+
+  if ( state.exception_ ) std::rethrow_exception( state.exception_ );
+}
+
+int ThreadPool::get_num_workers() const
+{
+  return static_cast< int >( this->private_->workers_.size() );
+}
+
+bool ThreadPool::is_worker_thread() const
+{
+  return this->private_->current_worker_.get() != 0;
+}
+
+} // end namespace Core
@@ -0,0 +1,105 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef CORE_UTILS_THREADPOOL_H
+#define CORE_UTILS_THREADPOOL_H
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1020)
+# pragma once
+#endif 
+
+// Boost includes
+#include <boost/noncopyable.hpp>
+#include <boost/smart_ptr.hpp>
+#include <boost/function.hpp>
+
+// Core includes
+#include <Core/Utils/Singleton.h>
+
+namespace Core
+{
+
+class ThreadPoolPrivate;
+typedef boost::shared_ptr< ThreadPoolPrivate > ThreadPoolPrivateHandle;
+
+// CLASS THREADPOOL:
+/// Process wide pool of persistent worker threads. Every worker owns a task deque; tasks posted
+/// from a worker go to its own deque, tasks posted from any other thread go to a shared queue,
+/// and idle workers steal from the deques of busy workers.
+/// NOTE: All the parallel code in Core (Parallel, Parallel::For) is executed on this pool, hence
+/// the threads are only created once per process.
+
+class ThreadPool : public boost::noncopyable
+{
+  CORE_SINGLETON( ThreadPool );
+
+  // -- constructor/destructor --
+private:
+  /// NOTE: This one is private, use the singleton Instance() function to access this class
+  ThreadPool();
+
+public:
+  ~ThreadPool();
+
+  // -- task scheduling --
+public:
+  typedef boost::function< void () > task_type;
+  typedef boost::function< void ( int ) > concurrent_task_type;
+
+  // POST:
+  /// Schedule a task to be executed on one of the workers. This function does not wait for the
+  /// task to be executed, hence an exception thrown by the task is only logged.
+  void post( task_type task );
+
+  // RUN_CONCURRENTLY:
+  /// Run num_tasks instances of the task, all of them at the same time, and wait until all of
+  /// them have finished. The task is called with its index, the calling thread runs index 0.
+  /// NOTE: The instances are guaranteed to run concurrently, so they may synchronize with each
+  /// other through a barrier. If not enough workers are idle, temporary threads are started for
+  /// the remaining instances.
+  /// If any of the instances throws, the first exception is rethrown in the calling thread
+  /// once all the instances have finished.
+  void run_concurrently( concurrent_task_type task, int num_tasks );
+
+  // -- information --
+public:
+  // GET_NUM_WORKERS:
+  /// The number of persistent worker threads in the pool.
+  int get_num_workers() const;
+
+  // IS_WORKER_THREAD:
+  /// Check whether the calling thread is one of the workers of this pool.
+  bool is_worker_thread() const;
+
+private:
+  ThreadPoolPrivateHandle private_;
+};
+
+} // end namespace Core
+
+#endif
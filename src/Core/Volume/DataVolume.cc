@@ -31,6 +31,7 @@
 #include <Core/Utils/Log.h>
 #include <Core/DataBlock/NrrdDataBlock.h>
 #include <Core/DataBlock/StdDataBlock.h>
+#include <Core/LargeVolume/ChunkedVolumeFile.h>
 #include <Core/Volume/DataVolume.h>
 #include <Core/DataBlock/DataBlockManager.h>
 #include <Core/Geometry/BBox.h>
@@ -84,7 +85,7 @@ void DataVolumePrivate::copy_typed_data( DST_TYPE* buffer, size_t width, size_t
   const double value_range = value_max - value_min;
   const double inv_value_range = ( numeric_max - numeric_min ) / value_range;
   const SRC_TYPE typed_value_min = static_cast< SRC_TYPE >( value_min );
-  const SRC_TYPE* src_data = static_cast< SRC_TYPE* >( this->data_block_->get_data() );
+  const SRC_TYPE* src_data = static_cast< const SRC_TYPE* >( this->data_block_->get_const_data() );
 
   size_t current_index;
   size_t dst_index = 0;
@@ -440,6 +441,16 @@ bool DataVolume::LoadDataVolume( const boost::filesystem::path& filename,
                 DataVolumeHandle& volume, std::string& error )
 {
   volume.reset();
+
+  if ( filename.extension().string() == ChunkedVolumeFile::GetFileExtension() )
+  {
+    ChunkedVolumeFile file;
+    DataBlockHandle datablock;
+    if ( !file.open( filename, error ) || !file.read( datablock, error ) ) return false;
+
+    volume = DataVolumeHandle( new DataVolume( file.get_grid_transform(), datablock ) );
+    return true;
+  }
   
   NrrdDataHandle nrrd;
   if ( ! ( NrrdData::LoadNrrd( filename.string(), nrrd, error ) ) ) return false;
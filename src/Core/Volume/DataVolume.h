@@ -130,7 +130,7 @@ private:
 public:
 
   // LOADDATAVOLUME:
-  /// Load a DataVolume from a nrrd file
+  /// Load a DataVolume from a nrrd file or a chunked volume file
   static bool LoadDataVolume( const boost::filesystem::path& filename, DataVolumeHandle& volume,
     std::string& error );
 
@@ -69,8 +69,10 @@ void CopyTypedData( DataVolumeSlice* slice, TYPE1* buffer, DataBlock* data_block
   const double numeric_max = static_cast<double>( std::numeric_limits< TYPE1 >::max() );
   const double value_min = data_block->get_min();
   const double value_max = data_block->get_max();
+  // The range comes from the histogram of the data block, constant data maps onto zero
   const double value_range = value_max - value_min;
-  const double inv_value_range = ( numeric_max - numeric_min ) / value_range;
+  const double inv_value_range = value_range > 0.0 ? 
+    ( numeric_max - numeric_min ) / value_range : 0.0;
 
   const TYPE2 typed_value_min = static_cast<TYPE2>( value_min );
 
@@ -83,7 +85,7 @@ void CopyTypedData( DataVolumeSlice* slice, TYPE1* buffer, DataBlock* data_block
   const size_t nx = slice->nx();
   const size_t ny = slice->ny();
   
-  TYPE2* data = static_cast<TYPE2*>( data_block->get_data() );
+  const TYPE2* data = static_cast<const TYPE2*>( data_block->get_const_data() );
   size_t row_start = current_index;
   for ( size_t j = 0; j < ny; j++ )
   {
@@ -236,7 +238,7 @@ void ThresholdTypedData( const DataVolumeSlice* slice, DataBlock* data_block,
   const size_t nx = slice->nx();
   const size_t ny = slice->ny();
 
-  T* data = static_cast< T* >( data_block->get_data() );
+  const T* data = static_cast< const T* >( data_block->get_const_data() );
   size_t row_start = current_index;
   bool in_range;
   for ( size_t j = 0; j < ny; j++ )
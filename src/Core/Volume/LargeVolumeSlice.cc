@@ -39,23 +39,10 @@
 namespace Core
 {
 
-struct BrickInfoHash
-{
-  std::size_t operator()(const Core::BrickInfo& bi) const
-  {
-    std::stringstream ss;
-    ss << 'l' << bi.level_ << 'i' << bi.index_;
-    return this->hasher_(ss.str());
-  }
-
-private:
-  boost::hash<std::string> hasher_;
-};
-
 class LargeVolumeSlicePrivate
 {
 public:
-  typedef boost::unordered_map<BrickInfo, LargeVolumeBrickSliceHandle, BrickInfoHash> tile_cache_type;
+  typedef boost::unordered_map<BrickInfo, LargeVolumeBrickSliceHandle> tile_cache_type;
   typedef boost::unordered_map<std::string, tile_cache_type> volume_view_tile_cache_type;
   tile_cache_type tiles_;
   volume_view_tile_cache_type volume_view_tiles_;
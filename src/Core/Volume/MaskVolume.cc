@@ -68,7 +68,7 @@ DataBlock::generation_type MaskVolume::get_generation() const
 {
   if ( this->mask_data_block_ )
   {
-    return this->mask_data_block_->get_data_block()->get_generation();
+    return this->mask_data_block_->get_generation();
   }
   else
   {
@@ -27,6 +27,7 @@
  */
 
 #include <algorithm>
+#include <limits>
 
 #include <boost/lambda/lambda.hpp>
 
@@ -34,6 +35,7 @@
 #include <Core/Volume/MaskVolumeSlice.h>
 #include <Core/RenderResources/RenderResources.h>
 #include <Core/Graphics/PixelBufferObject.h>
+#include <Core/Math/MathFunctions.h>
 
 namespace Core
 {
@@ -41,10 +43,48 @@ namespace Core
 class MaskVolumeSlicePrivate
 {
 public:
+  // ADD_DIRTY_REGION:
+  // Extend the region of changed voxels with the region [i0, i1] x [j0, j1] of the slice
+  void add_dirty_region( const MaskVolumeSlice* slice, size_t i0, size_t j0, 
+    size_t i1, size_t j1 );
+
+  // RESET_DIRTY_REGION:
+  // Mark that no voxels were changed
+  void reset_dirty_region();
+
   bool using_cache_;
   std::vector< unsigned char > cache_;
+
+  // Bounding box of the voxels that were changed and that have not been reported to the mask 
+  // yet, in index coordinates of the volume.
+  IndexVector dirty_min_;
+  IndexVector dirty_max_;
 };
 
+void MaskVolumeSlicePrivate::add_dirty_region( const MaskVolumeSlice* slice, size_t i0, 
+  size_t j0, size_t i1, size_t j1 )
+{
+  Point corner0, corner1;
+  slice->to_index( i0, j0, corner0 );
+  slice->to_index( i1, j1, corner1 );
+  for ( int k = 0; k < 3; k++ )
+  {
+    IndexVector::index_type min_index = static_cast< IndexVector::index_type >( 
+      Min( corner0[ k ], corner1[ k ] ) );
+    IndexVector::index_type max_index = static_cast< IndexVector::index_type >( 
+      Max( corner0[ k ], corner1[ k ] ) );
+    this->dirty_min_[ k ] = Min( this->dirty_min_[ k ], min_index );
+    this->dirty_max_[ k ] = Max( this->dirty_max_[ k ], max_index );
+  }
+}
+
+void MaskVolumeSlicePrivate::reset_dirty_region()
+{
+  IndexVector::index_type max_index = std::numeric_limits< IndexVector::index_type >::max();
+  this->dirty_min_ = IndexVector( max_index, max_index, max_index );
+  this->dirty_max_ = IndexVector( -1, -1, -1 );
+}
+
 MaskVolumeSlice::MaskVolumeSlice( const MaskVolumeHandle& mask_volume, 
                  VolumeSliceType type, size_t slice_num ) :
   VolumeSlice( mask_volume, type, slice_num ),
@@ -52,6 +92,7 @@ MaskVolumeSlice::MaskVolumeSlice( const MaskVolumeHandle& mask_volume,
   private_( new MaskVolumeSlicePrivate )
 {
   this->private_->using_cache_ = false;
+  this->private_->reset_dirty_region();
   if ( this->mask_data_block_ )
   {
     this->add_connection( this->mask_data_block_->mask_updated_signal_.connect( 
@@ -73,7 +114,8 @@ MaskVolumeSlice::~MaskVolumeSlice()
   this->disconnect_all();
 }
 
-static void CopyMaskData( const MaskVolumeSlice* slice, unsigned char* buffer, bool invert = false )
+static void CopyMaskData( const MaskVolumeSlice* slice, MaskDataBlock* mask_data_block, 
+  unsigned char* buffer, bool invert = false )
 {
   size_t current_index = slice->to_index( 0, 0 );
 
@@ -81,22 +123,45 @@ static void CopyMaskData( const MaskVolumeSlice* slice, unsigned char* buffer, b
   const int x_stride = slice->nx() > 1 ? static_cast< int >( slice->to_index( 1, 0 ) - current_index ) : 0;
   const int y_stride = slice->ny() > 1 ? static_cast< int >( slice->to_index( 0, 1 ) - current_index ) : 0;
 
-  unsigned char* mask_data = slice->get_mask_data_block()->get_mask_data();
-  unsigned char mask_value = slice->get_mask_data_block()->get_mask_value();
   const size_t nx = slice->nx();
   const size_t ny = slice->ny();
 
-  size_t row_start = current_index;
-  for ( size_t j = 0; j < ny; j++ )
+  // A sparse mask is read directly, so that showing it does not move it back into a bitplane.
+  // NOTE: The mask can be moved in or out of its bitplane by another thread until its datablock
+  // is locked, hence the bitplane is checked again once the lock is held.
+  for ( ;; )
   {
-    current_index = row_start;
-    for ( size_t i = 0; i < nx; i++ )
+    DataBlockHandle data_block;
+    unsigned char mask_value = 0;
+    if ( !mask_data_block->get_bitplane( data_block, mask_value ) )
     {
-      buffer[ j * nx + i ] = mask_data[ current_index ] & mask_value ;
+      SparseMaskDataHandle sparse_data = mask_data_block->get_sparse_data();
+      if ( !sparse_data ) continue;
+      sparse_data->copy_slice( current_index, x_stride, y_stride, nx, ny, buffer, 1 );
+      break;
+    }
 
-      current_index += x_stride;
+    MaskDataBlock::shared_lock_type volume_lock( data_block->get_mutex() );
+    DataBlockHandle locked_data_block;
+    unsigned char locked_mask_value = 0;
+    if ( !mask_data_block->get_bitplane( locked_data_block, locked_mask_value ) ||
+      locked_data_block != data_block || locked_mask_value != mask_value ) continue;
+
+    const unsigned char* mask_data = 
+      reinterpret_cast< const unsigned char* >( data_block->get_const_data() );
+    size_t row_start = current_index;
+    for ( size_t j = 0; j < ny; j++ )
+    {
+      current_index = row_start;
+      for ( size_t i = 0; i < nx; i++ )
+      {
+        buffer[ j * nx + i ] = mask_data[ current_index ] & mask_value ;
+
+        current_index += x_stride;
+      }
+      row_start += y_stride;
     }
-    row_start += y_stride;
+    break;
   }
 
   if ( invert )
@@ -148,11 +213,7 @@ void MaskVolumeSlice::upload_texture()
     unsigned char* buffer = reinterpret_cast<unsigned char*>(
       pixel_buffer->map_buffer( GL_WRITE_ONLY ) );
 
-    {
-      MaskDataBlock::shared_lock_type volume_lock( 
-        this->mask_data_block_->get_mutex() );
-      CopyMaskData( this, buffer );
-    }
+    CopyMaskData( this, this->mask_data_block_, buffer );
     
     // Step 2. copy from the pixel buffer to texture
     pixel_buffer->unmap_buffer();
@@ -212,11 +273,7 @@ unsigned char* MaskVolumeSlice::get_cached_data()
   {
     this->private_->cache_.resize( this->nx() * this->ny() );
     
-    {
-      MaskDataBlock::shared_lock_type volume_lock( 
-        this->mask_data_block_->get_mutex() );
-      CopyMaskData( this, &this->private_->cache_[ 0 ] );
-    }
+    CopyMaskData( this, this->mask_data_block_, &this->private_->cache_[ 0 ] );
 
     this->private_->using_cache_ = true;
   }
@@ -224,7 +281,8 @@ unsigned char* MaskVolumeSlice::get_cached_data()
   return &this->private_->cache_[ 0 ];
 }
 
-static void CopyCachedDataBack( MaskVolumeSlice* slice, const unsigned char* buffer )
+static void CopyCachedDataBack( MaskVolumeSlice* slice, const unsigned char* buffer,
+  MaskVolumeSlicePrivate* slice_private )
 {
   size_t current_index = slice->to_index( 0, 0 );
 
@@ -238,6 +296,9 @@ static void CopyCachedDataBack( MaskVolumeSlice* slice, const unsigned char* buf
   const size_t nx = slice->nx();
   const size_t ny = slice->ny();
 
+  // Keep track of the part of the slice that actually changed
+  size_t min_i = nx, min_j = ny, max_i = 0, max_j = 0;
+
   size_t row_start = current_index;
   for ( size_t j = 0; j < ny; j++ )
   {
@@ -245,6 +306,14 @@ static void CopyCachedDataBack( MaskVolumeSlice* slice, const unsigned char* buf
     for ( size_t i = 0; i < nx; i++ )
     {
       bool has_mask = buffer[ j * nx + i ] != 0;
+      if ( has_mask != ( ( mask_data[ current_index ] & mask_value ) != 0 ) )
+      {
+        min_i = Min( min_i, i );
+        max_i = Max( max_i, i );
+        min_j = Min( min_j, j );
+        max_j = Max( max_j, j );
+      }
+
       if ( has_mask )
       {
         mask_data[ current_index ] |= mask_value;
@@ -258,6 +327,11 @@ static void CopyCachedDataBack( MaskVolumeSlice* slice, const unsigned char* buf
     }
     row_start += y_stride;
   }
+
+  if ( min_i <= max_i && min_j <= max_j )
+  {
+    slice_private->add_dirty_region( slice, min_i, min_j, max_i, max_j );
+  }
 }
 
 void MaskVolumeSlice::release_cached_data()
@@ -279,8 +353,10 @@ void MaskVolumeSlice::release_cached_data()
   
   {
     MaskDataBlock::lock_type volume_lock( this->mask_data_block_->get_mutex() );
-    CopyCachedDataBack( this, &this->private_->cache_[ 0 ] );
-    this->mask_data_block_->increase_generation();
+    CopyCachedDataBack( this, &this->private_->cache_[ 0 ], this->private_.get() );
+    this->mask_data_block_->increase_generation( this->private_->dirty_min_, 
+      this->private_->dirty_max_ );
+    this->private_->reset_dirty_region();
   }
   
   this->private_->cache_.resize( 0 );
@@ -314,11 +390,7 @@ void MaskVolumeSlice::copy_slice_data( std::vector< unsigned char >& buffer, boo
   lock_type lock( this->get_mutex() );
 
   buffer.resize( this->nx() * this->ny() );
-  {
-    MaskDataBlock::shared_lock_type volume_lock( 
-      this->mask_data_block_->get_mutex() );
-    CopyMaskData( this, &buffer[ 0 ], invert );
-  }
+  CopyMaskData( this, this->mask_data_block_, &buffer[ 0 ], invert );
 }
 
 void MaskVolumeSlice::copy_slice_data( unsigned char* buffer, bool invert ) const
@@ -326,11 +398,7 @@ void MaskVolumeSlice::copy_slice_data( unsigned char* buffer, bool invert ) cons
   assert( buffer != 0 );
   lock_type lock( this->get_mutex() );
 
-  {
-    MaskDataBlock::shared_lock_type volume_lock( 
-      this->mask_data_block_->get_mutex() );
-    CopyMaskData( this, buffer, invert );
-  }
+  CopyMaskData( this, this->mask_data_block_, buffer, invert );
 }
 
 void MaskVolumeSlice::set_slice_data( const unsigned char* buffer, bool trigger_update )
@@ -340,10 +408,12 @@ void MaskVolumeSlice::set_slice_data( const unsigned char* buffer, bool trigger_
 
     {
       MaskDataBlock::lock_type volume_lock( this->mask_data_block_->get_mutex() );
-      CopyCachedDataBack( this, buffer );
+      CopyCachedDataBack( this, buffer, this->private_.get() );
       if ( trigger_update )
       {
-        this->mask_data_block_->increase_generation();
+        this->mask_data_block_->increase_generation( this->private_->dirty_min_, 
+          this->private_->dirty_max_ );
+        this->private_->reset_dirty_region();
       }
     }
   }
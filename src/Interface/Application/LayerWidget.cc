@@ -281,6 +281,12 @@ void LayerWidgetPrivate::update_widget_state( bool initialize )
     this->update_appearance( visual_lock,  active_layer, true, initialize );    
     this->ui_.selection_checkbox_->setVisible( true );
   }
+  else if ( data_state == Layer::INVALID_C )
+  {
+    // The layer can only be deleted, so show it like a locked layer
+    this->update_appearance( true,  active_layer, false, initialize );
+    this->ui_.selection_checkbox_->setVisible( false );
+  }
 }
 
 int LayerWidgetPrivate::get_volume_type()
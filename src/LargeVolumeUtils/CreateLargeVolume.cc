@@ -68,8 +68,18 @@ void printUsage()
   std::cout << "  --bricksize=VECTOR | SCALAR  - Brick size, default is 256,256,256." << std::endl
             << "                                 Size of bricks can be set with single number (--bricksize=512 for 512,512,512 brick)." << std::endl;
   std::cout << "  --overlap=SCALAR             - Overlap betweeen the bricks, default is 1." << std::endl;
-  std::cout << "  --nodownsample=CHAR          - Do not downsample in given direction (x,y, or z)." << std::endl << std::endl;
+  std::cout << "  --nodownsample=CHAR          - Do not downsample in given direction (x,y, or z)." << std::endl;
+  std::cout << "  --layout=files | packed      - Store each brick in a separate file or pack all bricks into a few" << std::endl
+            << "                                 large files with an index, default is files." << std::endl;
+  std::cout << "  --codec=STRING               - Brick compression: none, lz4 (fast), zlib or zlib-high (small)," << std::endl
+            << "                                 default is zlib." << std::endl;
+  std::cout << "  --filter=STRING              - Transformation before compression: none, shuffle or delta, default is none." << std::endl
+            << "                                 Delta works well for 16 bit EM data." << std::endl << std::endl;
   std::cout << "Tool parameters (optional):" << std::endl;
+  std::cout << "  --resume                     - Continue an interrupted conversion into output_volume, using the same" << std::endl
+            << "                                 input files and options." << std::endl;
+  std::cout << "  --append                     - Add the image stack as new slices to the existing output_volume." << std::endl
+            << "                                 The volume keeps its dataset parameters and compression." << std::endl;
   std::cout << "  --maxgb=SCALAR               - Maximum number of GB to use for conversion, default is based on available memory." << std::endl;
   std::cout << "  --silent                     - Do not wait for user input to continue." << std::endl;
 }
@@ -141,7 +151,26 @@ int main( int argc, char **argv )
     output_dir = boost::filesystem::path( output_dir.string() + ".s3dvol" );
   }
   
-  if (boost::filesystem::exists(output_dir))
+  bool resume = Core::Application::Instance()->is_command_line_parameter( "resume" );
+  bool append = Core::Application::Instance()->is_command_line_parameter( "append" );
+
+  if ( resume && append )
+  {
+    printUsage();
+    CORE_PRINT_AND_LOG_ERROR("An interrupted append is continued with --resume only.");
+    return -1;
+  }
+
+  if ( resume || append )
+  {
+    if (! boost::filesystem::exists( output_dir ) )
+    {
+      printUsage();
+      CORE_PRINT_AND_LOG_ERROR("Output directory '" + output_dir.string() + "' does not exist.");
+      return -1;
+    }
+  }
+  else if (boost::filesystem::exists(output_dir))
   {
     printUsage();
     CORE_PRINT_AND_LOG_ERROR("Output directory '" + output_dir.string() + "' already exists, please delete directory before starting conversion.");
@@ -249,6 +278,46 @@ int main( int argc, char **argv )
     if ( nodownsample == "z" ) down_sample_z = false;
   }
   
+  // -- brick layout --
+  bool packed = false;
+  std::string layout_string;
+  if ( Core::Application::Instance()->check_command_line_parameter( "layout" , layout_string ) )
+  {
+    if (! ( layout_string == "files" || layout_string == "packed" ) )
+    {
+      printUsage();
+      CORE_PRINT_AND_LOG_ERROR("Layout needs to be files or packed.");
+      return -1;
+    }
+    
+    packed = ( layout_string == "packed" );
+  }
+  
+  // -- compression --
+  Core::BrickCodec codec = Core::BrickCodec::ZLIB_E;
+  std::string codec_string;
+  if ( Core::Application::Instance()->check_command_line_parameter( "codec" , codec_string ) )
+  {
+    if (! Core::ImportFromString( codec_string, codec ) )
+    {
+      printUsage();
+      CORE_PRINT_AND_LOG_ERROR("Codec needs to be none, lz4, zlib or zlib-high.");
+      return -1;
+    }
+  }
+
+  Core::BrickFilter filter = Core::BrickFilter::NONE_E;
+  std::string filter_string;
+  if ( Core::Application::Instance()->check_command_line_parameter( "filter" , filter_string ) )
+  {
+    if (! Core::ImportFromString( filter_string, filter ) )
+    {
+      printUsage();
+      CORE_PRINT_AND_LOG_ERROR("Filter needs to be none, shuffle or delta.");
+      return -1;
+    }
+  }
+  
   long long mem_limit = 0;
   if ( sizeof(void *) == 4 )
   {
@@ -304,6 +373,10 @@ int main( int argc, char **argv )
   converter->set_schema_parameters( spacing, origin, brick_size, overlap );
   converter->get_schema()->enable_downsample( down_sample_x, down_sample_y, down_sample_z );
   converter->set_mem_limit( mem_limit );
+  converter->set_packed( packed );
+  converter->set_codec( codec, filter );
+  converter->set_resume( resume );
+  converter->set_append( append );
   
   // Scan files and compute schema
   std::string error;
@@ -326,6 +399,16 @@ int main( int argc, char **argv )
   std::cout << "Brick Size:         " << Core::ExportToString( schema->get_brick_size() ) << std::endl;
   std::cout << "Overlap:            " << Core::ExportToString( schema->get_overlap() ) << std::endl;
   std::cout << "Resolution Levels:  " << Core::ExportToString( schema->get_num_levels() ) << std::endl;
+  std::cout << "Brick Layout:       " << ( packed ? "packed" : "files" ) << std::endl;
+  std::cout << "Compression:        " << Core::ExportToString( schema->get_codec() ) << ", filter " << Core::ExportToString( schema->get_filter() ) << std::endl;
+  if ( resume )
+  {
+    std::cout << "Mode:               resume interrupted conversion" << std::endl;
+  }
+  else if ( append )
+  {
+    std::cout << "Mode:               append to volume" << std::endl;
+  }
   std::cout << "Memory Usage Limit: " << Core::ExportToString( mem_limit >> 30 ) << " GB" << std::endl;
   if (nodownsample.size())
   {
@@ -42,8 +42,6 @@ generate3x3x3StdDataBlockInternal( Core::DataBlockHandle& dataBlock,
                                    bool nodeCentered )
 {
   std::vector<T> vec = generate3x3x3Data<T>();
-  T* data = new T[27];
-  std::copy(vec.begin(), vec.end(), data);
 
   std::vector<size_t> dims;
   dims += 3, 3, 3;
@@ -57,7 +55,7 @@ generate3x3x3StdDataBlockInternal( Core::DataBlockHandle& dataBlock,
                                        gridTransform.get_ny(),
                                        gridTransform.get_nz(),
                                        type );
-  dataBlock->set_data(reinterpret_cast<void*>(data));
+  std::copy(vec.begin(), vec.end(), reinterpret_cast<T*>(dataBlock->get_data()));
   return std::make_tuple(dataBlock, gridTransform);
 }
 